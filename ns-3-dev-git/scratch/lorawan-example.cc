@@ -244,6 +244,10 @@ DeviceEnergyModelContainer deviceModels = radioHelper.Install (lorawanEDDevices,
 
   Ptr<Socket> recvSink = SetupPacketReceive (gatewayNodes.Get (0));
 
+  // project the battery lifetime of the end devices from their converged ADR settings
+  LoRaWANBatteryLifetimeHelper lifetimeHelper;
+  lifetimeHelper.Install (endDeviceNodes);
+
   Simulator::Stop (Seconds (600.0*250));
 
   Simulator::Run ();
@@ -260,6 +264,9 @@ DeviceEnergyModelContainer deviceModels = radioHelper.Install (lorawanEDDevices,
       }
   }
   
+  std::cout << "starting lifetime projection print out" << std::endl;
+  lifetimeHelper.Print (std::cout);
+
   //std::cout << nNodes << std::endl;
   std::cout << "starting destroy" << std::endl;
   Simulator::Destroy ();
@@ -80,7 +80,8 @@ BuildingsHelper::MakeConsistent (Ptr<MobilityModel> mm)
 {
   Ptr<MobilityBuildingInfo> bmm = mm->GetObject<MobilityBuildingInfo> ();
   bool found = false;
-  for (BuildingList::Iterator bit = BuildingList::Begin (); bit != BuildingList::End (); ++bit)
+  const std::vector<Ptr<Building> > &candidates = BuildingList::GetCandidateBuildings (mm->GetPosition ());
+  for (std::vector<Ptr<Building> >::const_iterator bit = candidates.begin (); bit != candidates.end (); ++bit)
     {
       NS_LOG_LOGIC ("checking building " << (*bit)->GetId () << " with boundaries " << (*bit)->GetBoundaries ());
       Vector pos = mm->GetPosition ();
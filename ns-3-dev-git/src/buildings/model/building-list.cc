@@ -27,6 +27,8 @@
 #include "ns3/assert.h"
 #include "building-list.h"
 #include "building.h"
+#include <algorithm>
+#include <cmath>
 
 namespace ns3 {
 
@@ -47,6 +49,9 @@ public:
   BuildingList::Iterator End (void) const;
   Ptr<Building> GetBuilding (uint32_t n);
   uint32_t GetNBuildings (void);
+  Ptr<Building> FindBuilding (const Vector &position);
+  const std::vector<Ptr<Building> > & GetCandidateBuildings (const Vector &position);
+  void InvalidateIndex (void);
 
   static Ptr<BuildingListPriv> Get (void);
 
@@ -54,7 +59,22 @@ private:
   virtual void DoDispose (void);
   static Ptr<BuildingListPriv> *DoGet (void);
   static void Delete (void);
+  void BuildIndex (void);
   std::vector<Ptr<Building> > m_buildings;
+
+  /*
+   * Grid index over the footprints of the buildings: the bounding box of
+   * all buildings is divided in square cells and every cell lists the
+   * buildings overlapping it, in the order they were added.
+   */
+  bool m_indexValid;
+  double m_xMin;
+  double m_yMin;
+  double m_cellSize;
+  uint32_t m_nCellsX;
+  uint32_t m_nCellsY;
+  std::vector<std::vector<Ptr<Building> > > m_cells;
+  std::vector<Ptr<Building> > m_noBuildings;
 };
 
 NS_OBJECT_ENSURE_REGISTERED (BuildingListPriv);
@@ -100,6 +120,12 @@ BuildingListPriv::Delete (void)
 
 
 BuildingListPriv::BuildingListPriv ()
+  : m_indexValid (false),
+    m_xMin (0),
+    m_yMin (0),
+    m_cellSize (1),
+    m_nCellsX (0),
+    m_nCellsY (0)
 {
   NS_LOG_FUNCTION_NOARGS ();
 }
@@ -118,6 +144,8 @@ BuildingListPriv::DoDispose (void)
       *i = 0;
     }
   m_buildings.erase (m_buildings.begin (), m_buildings.end ());
+  m_cells.clear ();
+  m_indexValid = false;
   Object::DoDispose ();
 }
 
@@ -127,6 +155,7 @@ BuildingListPriv::Add (Ptr<Building> building)
 {
   uint32_t index = m_buildings.size ();
   m_buildings.push_back (building);
+  m_indexValid = false;
   Simulator::ScheduleWithContext (index, TimeStep (0), &Building::Initialize, building);
   return index;
 
@@ -155,6 +184,106 @@ BuildingListPriv::GetBuilding (uint32_t n)
   return m_buildings.at (n);
 }
 
+void
+BuildingListPriv::InvalidateIndex (void)
+{
+  m_indexValid = false;
+}
+
+void
+BuildingListPriv::BuildIndex (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_cells.clear ();
+  m_nCellsX = 0;
+  m_nCellsY = 0;
+  m_indexValid = true;
+  if (m_buildings.empty ())
+    {
+      return;
+    }
+
+  double xMax = m_buildings.front ()->GetBoundaries ().xMax;
+  double yMax = m_buildings.front ()->GetBoundaries ().yMax;
+  m_xMin = m_buildings.front ()->GetBoundaries ().xMin;
+  m_yMin = m_buildings.front ()->GetBoundaries ().yMin;
+  double extent = 0;
+  for (std::vector<Ptr<Building> >::const_iterator i = m_buildings.begin (); i != m_buildings.end (); ++i)
+    {
+      Box box = (*i)->GetBoundaries ();
+      m_xMin = std::min (m_xMin, box.xMin);
+      m_yMin = std::min (m_yMin, box.yMin);
+      xMax = std::max (xMax, box.xMax);
+      yMax = std::max (yMax, box.yMax);
+      extent += std::max (box.xMax - box.xMin, box.yMax - box.yMin);
+    }
+
+  // cells at least as large as the average building, and not many more
+  // cells than buildings
+  const double n = m_buildings.size ();
+  m_cellSize = std::max (extent / n, std::sqrt ((xMax - m_xMin) * (yMax - m_yMin) / n));
+  m_cellSize = std::max (m_cellSize, std::max (xMax - m_xMin, yMax - m_yMin) / n);
+  if (!(m_cellSize > 0))
+    {
+      m_cellSize = 1;
+    }
+  m_nCellsX = static_cast<uint32_t> (std::floor ((xMax - m_xMin) / m_cellSize)) + 1;
+  m_nCellsY = static_cast<uint32_t> (std::floor ((yMax - m_yMin) / m_cellSize)) + 1;
+  m_cells.resize (m_nCellsX * m_nCellsY);
+
+  for (std::vector<Ptr<Building> >::const_iterator i = m_buildings.begin (); i != m_buildings.end (); ++i)
+    {
+      Box box = (*i)->GetBoundaries ();
+      uint32_t x0 = std::min (m_nCellsX - 1, static_cast<uint32_t> (std::floor ((box.xMin - m_xMin) / m_cellSize)));
+      uint32_t x1 = std::min (m_nCellsX - 1, static_cast<uint32_t> (std::floor ((box.xMax - m_xMin) / m_cellSize)));
+      uint32_t y0 = std::min (m_nCellsY - 1, static_cast<uint32_t> (std::floor ((box.yMin - m_yMin) / m_cellSize)));
+      uint32_t y1 = std::min (m_nCellsY - 1, static_cast<uint32_t> (std::floor ((box.yMax - m_yMin) / m_cellSize)));
+      for (uint32_t x = x0; x <= x1; x++)
+        {
+          for (uint32_t y = y0; y <= y1; y++)
+            {
+              m_cells[x * m_nCellsY + y].push_back (*i);
+            }
+        }
+    }
+  NS_LOG_LOGIC ("indexed " << m_buildings.size () << " buildings in " << m_nCellsX << "x" << m_nCellsY
+                << " cells of " << m_cellSize << " m");
+}
+
+const std::vector<Ptr<Building> > &
+BuildingListPriv::GetCandidateBuildings (const Vector &position)
+{
+  if (!m_indexValid)
+    {
+      BuildIndex ();
+    }
+  if (m_nCellsX == 0 || !(position.x >= m_xMin) || !(position.y >= m_yMin))
+    {
+      return m_noBuildings;
+    }
+  double x = std::floor ((position.x - m_xMin) / m_cellSize);
+  double y = std::floor ((position.y - m_yMin) / m_cellSize);
+  if (x >= m_nCellsX || y >= m_nCellsY)
+    {
+      return m_noBuildings;
+    }
+  return m_cells[static_cast<uint32_t> (x) * m_nCellsY + static_cast<uint32_t> (y)];
+}
+
+Ptr<Building>
+BuildingListPriv::FindBuilding (const Vector &position)
+{
+  const std::vector<Ptr<Building> > &candidates = GetCandidateBuildings (position);
+  for (std::vector<Ptr<Building> >::const_iterator i = candidates.begin (); i != candidates.end (); ++i)
+    {
+      if ((*i)->IsInside (position))
+        {
+          return *i;
+        }
+    }
+  return 0;
+}
+
 }
 
 /**
@@ -164,9 +293,12 @@ BuildingListPriv::GetBuilding (uint32_t n)
  */
 namespace ns3 {
 
+uint32_t BuildingList::m_generation = 0;
+
 uint32_t
 BuildingList::Add (Ptr<Building> building)
 {
+  NotifyBuildingChanged ();
   return BuildingListPriv::Get ()->Add (building);
 }
 BuildingList::Iterator
@@ -189,5 +321,30 @@ BuildingList::GetNBuildings (void)
 {
   return BuildingListPriv::Get ()->GetNBuildings ();
 }
+Ptr<Building>
+BuildingList::FindBuilding (const Vector &position)
+{
+  return BuildingListPriv::Get ()->FindBuilding (position);
+}
+const std::vector<Ptr<Building> > &
+BuildingList::GetCandidateBuildings (const Vector &position)
+{
+  return BuildingListPriv::Get ()->GetCandidateBuildings (position);
+}
+void
+BuildingList::InvalidateIndex (void)
+{
+  BuildingListPriv::Get ()->InvalidateIndex ();
+}
+void
+BuildingList::NotifyBuildingChanged (void)
+{
+  m_generation++;
+}
+uint32_t
+BuildingList::GetGeneration (void)
+{
+  return m_generation;
+}
 
 } // namespace ns3
@@ -25,6 +25,7 @@
 
 #include <vector>
 #include "ns3/ptr.h"
+#include "ns3/vector.h"
 
 namespace ns3 {
 
@@ -62,6 +63,50 @@ public:
    * \returns the number of buildings currently in the list.
    */
   static uint32_t GetNBuildings (void);
+
+  /**
+   * \param position a position
+   * \returns the building the position is inside of, or 0 if the
+   *          position is outdoor. If buildings overlap, the one that
+   *          was added first is returned.
+   *
+   * The buildings are looked up in a grid index over their footprints
+   * instead of by searching the whole list.
+   */
+  static Ptr<Building> FindBuilding (const Vector &position);
+
+  /**
+   * \param position a position
+   * \returns the buildings whose footprint overlaps the cell of the grid
+   *          index the position falls in. All the buildings the position
+   *          is inside of are among them.
+   */
+  static const std::vector< Ptr<Building> > & GetCandidateBuildings (const Vector &position);
+
+  /**
+   * Rebuild the grid index before the next lookup.
+   *
+   * This method is called automatically from Building::SetBoundaries.
+   */
+  static void InvalidateIndex (void);
+
+  /**
+   * Count a change of the buildings, see GetGeneration.
+   *
+   * This method is called automatically from Building::Building and from
+   * the setters of Building.
+   */
+  static void NotifyBuildingChanged (void);
+
+  /**
+   * \returns a counter incremented whenever a building is added or one of
+   *          its attributes changes, so that values derived from the
+   *          buildings can be cached until the next change.
+   */
+  static uint32_t GetGeneration (void);
+
+private:
+  static uint32_t m_generation;
 };
 
 } // namespace ns3
@@ -140,6 +140,8 @@ Building::SetBoundaries (Box boundaries)
 {
   NS_LOG_FUNCTION (this << boundaries);
   m_buildingBounds = boundaries;
+  BuildingList::InvalidateIndex ();
+  BuildingList::NotifyBuildingChanged ();
 }
 
 void
@@ -147,6 +149,7 @@ Building::SetBuildingType (Building::BuildingType_t t)
 {
   NS_LOG_FUNCTION (this << t);
   m_buildingType = t;
+  BuildingList::NotifyBuildingChanged ();
 }
 
 void 
@@ -154,6 +157,7 @@ Building::SetExtWallsType (Building::ExtWallsType_t t)
 {
   NS_LOG_FUNCTION (this << t);
   m_externalWalls = t;
+  BuildingList::NotifyBuildingChanged ();
 }
 
 void
@@ -161,6 +165,7 @@ Building::SetNFloors (uint16_t nfloors)
 {
   NS_LOG_FUNCTION (this << nfloors);
   m_floors = nfloors;
+  BuildingList::NotifyBuildingChanged ();
 }
 
 void
@@ -168,6 +173,7 @@ Building::SetNRoomsX (uint16_t nroomx)
 {
   NS_LOG_FUNCTION (this << nroomx);
   m_roomsX = nroomx;
+  BuildingList::NotifyBuildingChanged ();
 }
 
 void
@@ -175,6 +181,7 @@ Building::SetNRoomsY (uint16_t nroomy)
 {
   NS_LOG_FUNCTION (this << nroomy);
   m_roomsY = nroomy;
+  BuildingList::NotifyBuildingChanged ();
 }
 
 Box
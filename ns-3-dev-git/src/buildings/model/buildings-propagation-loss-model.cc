@@ -28,6 +28,7 @@
 #include <cmath>
 #include "buildings-propagation-loss-model.h"
 #include <ns3/mobility-building-info.h>
+#include <ns3/building-list.h>
 #include "ns3/enum.h"
 
 
@@ -145,14 +146,55 @@ BuildingsPropagationLossModel::InternalWallsLoss (Ptr<MobilityBuildingInfo> a, P
 
 
 
+size_t
+BuildingsPropagationLossModel::LinkHash::operator() (const std::pair<Ptr<MobilityModel>, Ptr<MobilityModel> >& link) const
+{
+  size_t a = reinterpret_cast<size_t> (PeekPointer (link.first));
+  size_t b = reinterpret_cast<size_t> (PeekPointer (link.second));
+  return a ^ (b + 0x9e3779b9 + (a << 6) + (a >> 2));
+}
+
+const BuildingsPropagationLossModel::LinkInfo&
+BuildingsPropagationLossModel::GetLinkInfo (Ptr<MobilityModel> a, Ptr<MobilityModel> b) const
+{
+  std::pair<Ptr<MobilityModel>, Ptr<MobilityModel> > key (a, b);
+  std::unordered_map<std::pair<Ptr<MobilityModel>, Ptr<MobilityModel> >, LinkInfo, LinkHash>::iterator it = m_linkInfo.find (key);
+  if (it != m_linkInfo.end ()
+      && it->second.m_aUpdateCount == it->second.m_a->GetUpdateCount ()
+      && it->second.m_bUpdateCount == it->second.m_b->GetUpdateCount ()
+      && it->second.m_buildingsGeneration == BuildingList::GetGeneration ())
+    {
+      return it->second;
+    }
+
+  LinkInfo& link = m_linkInfo[key];
+  if (link.m_a == 0)
+    {
+      link.m_a = a->GetObject <MobilityBuildingInfo> ();
+      link.m_b = b->GetObject <MobilityBuildingInfo> ();
+      NS_ASSERT_MSG ((link.m_a != 0) && (link.m_b != 0), "BuildingsPropagationLossModel only works with MobilityBuildingInfo");
+    }
+  Ptr<MobilityBuildingInfo> a1 = link.m_a;
+  Ptr<MobilityBuildingInfo> b1 = link.m_b;
+  link.m_aUpdateCount = a1->GetUpdateCount ();
+  link.m_bUpdateCount = b1->GetUpdateCount ();
+  link.m_buildingsGeneration = BuildingList::GetGeneration ();
+  link.m_aIndoor = a1->IsIndoor ();
+  link.m_bIndoor = b1->IsIndoor ();
+  link.m_sameBuilding = link.m_aIndoor && link.m_bIndoor && a1->GetBuilding () == b1->GetBuilding ();
+  link.m_aExternalWallLoss = link.m_aIndoor ? ExternalWallLoss (a1) : 0.0;
+  link.m_bExternalWallLoss = link.m_bIndoor ? ExternalWallLoss (b1) : 0.0;
+  link.m_aHeightLoss = link.m_aIndoor ? HeightLoss (a1) : 0.0;
+  link.m_bHeightLoss = link.m_bIndoor ? HeightLoss (b1) : 0.0;
+  link.m_internalWallsLoss = link.m_sameBuilding ? InternalWallsLoss (a1, b1) : 0.0;
+  NS_LOG_LOGIC (this << " link " << a << " " << b << " indoor " << link.m_aIndoor << " " << link.m_bIndoor);
+  return link;
+}
+
 double
 BuildingsPropagationLossModel::GetShadowing (Ptr<MobilityModel> a, Ptr<MobilityModel> b)
 const
 {
-    Ptr<MobilityBuildingInfo> a1 = a->GetObject <MobilityBuildingInfo> ();
-    Ptr<MobilityBuildingInfo> b1 = b->GetObject <MobilityBuildingInfo> ();
-    NS_ASSERT_MSG ((a1 != 0) && (b1 != 0), "BuildingsPropagationLossModel only works with MobilityBuildingInfo");
-  
   std::map<Ptr<MobilityModel>,  std::map<Ptr<MobilityModel>, ShadowingLoss> >::iterator ait = m_shadowingLossMap.find (a);
   if (ait != m_shadowingLossMap.end ())
     {
@@ -163,7 +205,8 @@ const
         }
       else
         {
-          double sigma = EvaluateSigma (a1, b1);
+          const LinkInfo& link = GetLinkInfo (a, b);
+          double sigma = EvaluateSigma (link.m_a, link.m_b);
           // side effect: will create new entry          
           // sigma is standard deviation, not variance
           double shadowingValue = m_randVariable->GetValue (0.0, (sigma*sigma));
@@ -173,7 +216,8 @@ const
     }
   else
     {
-      double sigma = EvaluateSigma (a1, b1);
+      const LinkInfo& link = GetLinkInfo (a, b);
+      double sigma = EvaluateSigma (link.m_a, link.m_b);
       // side effect: will create new entries in both maps
       // sigma is standard deviation, not variance
       double shadowingValue = m_randVariable->GetValue (0.0, (sigma*sigma));
@@ -28,6 +28,7 @@
 #include "ns3/random-variable-stream.h"
 #include <ns3/building.h>
 #include <ns3/mobility-building-info.h>
+#include <unordered_map>
 
 
 
@@ -78,6 +79,35 @@ protected:
   
   double GetShadowing (Ptr<MobilityModel> a, Ptr<MobilityModel> b) const;
 
+  /**
+   * The indoor/outdoor classification of a link and the penetration losses
+   * of its ends, cached until either end is marked indoor or outdoor again
+   * or a building changes, see BuildingList::GetGeneration
+   */
+  struct LinkInfo
+  {
+    Ptr<MobilityBuildingInfo> m_a;
+    Ptr<MobilityBuildingInfo> m_b;
+    uint32_t m_aUpdateCount;
+    uint32_t m_bUpdateCount;
+    uint32_t m_buildingsGeneration;
+    bool m_aIndoor;
+    bool m_bIndoor;
+    bool m_sameBuilding;
+    double m_aExternalWallLoss;
+    double m_bExternalWallLoss;
+    double m_aHeightLoss;
+    double m_bHeightLoss;
+    double m_internalWallsLoss;
+  };
+
+  /**
+   * \param a the mobility model of the source
+   * \param b the mobility model of the destination
+   * \returns the classification and penetration losses of the link
+   */
+  const LinkInfo& GetLinkInfo (Ptr<MobilityModel> a, Ptr<MobilityModel> b) const;
+
   double m_lossInternalWall; // in meters
 
   
@@ -94,6 +124,12 @@ protected:
   };
 
   mutable std::map<Ptr<MobilityModel>,  std::map<Ptr<MobilityModel>, ShadowingLoss> > m_shadowingLossMap;
+
+  struct LinkHash
+  {
+    size_t operator() (const std::pair<Ptr<MobilityModel>, Ptr<MobilityModel> >& link) const;
+  };
+  mutable std::unordered_map<std::pair<Ptr<MobilityModel>, Ptr<MobilityModel> >, LinkInfo, LinkHash> m_linkInfo;
   double EvaluateSigma (Ptr<MobilityBuildingInfo> a, Ptr<MobilityBuildingInfo> b) const;
 
 
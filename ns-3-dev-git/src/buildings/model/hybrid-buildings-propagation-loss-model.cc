@@ -147,16 +147,14 @@ HybridBuildingsPropagationLossModel::GetLoss (Ptr<MobilityModel> a, Ptr<Mobility
   
   double distance = a->GetDistanceFrom (b);
 
-  // get the MobilityBuildingInfo pointers
-  Ptr<MobilityBuildingInfo> a1 = a->GetObject<MobilityBuildingInfo> ();
-  Ptr<MobilityBuildingInfo> b1 = b->GetObject<MobilityBuildingInfo> ();
-  NS_ASSERT_MSG ((a1 != 0) && (b1 != 0), "HybridBuildingsPropagationLossModel only works with MobilityBuildingInfo");
+  // the indoor/outdoor classification and penetration losses of the link
+  const LinkInfo& link = GetLinkInfo (a, b);
 
   double loss = 0.0;
 
-  if (a1->IsOutdoor ())
+  if (!link.m_aIndoor)
     {
-      if (b1->IsOutdoor ())
+      if (!link.m_bIndoor)
         {
           if (distance > 1000)
             {
@@ -189,18 +187,18 @@ HybridBuildingsPropagationLossModel::GetLoss (Ptr<MobilityModel> a, Ptr<Mobility
               if ((a->GetPosition ().z < m_rooftopHeight)
                   && (b->GetPosition ().z < m_rooftopHeight))
                 {                  
-                  loss = ItuR1411 (a, b) + ExternalWallLoss (b1) + HeightLoss (b1);
+                  loss = ItuR1411 (a, b) + link.m_bExternalWallLoss + link.m_bHeightLoss;
                   NS_LOG_INFO (this << " 0-I (>1000): below rooftop -> ITUR1411 : " << loss);
                 }
               else
                 {
-                  loss = OkumuraHata (a, b) + ExternalWallLoss (b1);
+                  loss = OkumuraHata (a, b) + link.m_bExternalWallLoss;
                   NS_LOG_INFO (this << " O-I (>1000): above the rooftop -> OH : " << loss);
                 }
             }
           else
             {
-              loss = ItuR1411 (a, b) + ExternalWallLoss (b1) + HeightLoss (b1);
+              loss = ItuR1411 (a, b) + link.m_bExternalWallLoss + link.m_bHeightLoss;
               NS_LOG_INFO (this << " 0-I (<1000) ITUR1411 + BEL : " << loss);
             }
         } // end b1->isIndoor ()
@@ -208,19 +206,19 @@ HybridBuildingsPropagationLossModel::GetLoss (Ptr<MobilityModel> a, Ptr<Mobility
   else
     {
       // a is indoor
-      if (b1->IsIndoor ())
+      if (link.m_bIndoor)
         {
-          if (a1->GetBuilding () == b1->GetBuilding ())
+          if (link.m_sameBuilding)
             {
               // nodes are in same building -> indoor communication ITU-R P.1238
-              loss = ItuR1238 (a, b) + InternalWallsLoss (a1, b1);;
+              loss = ItuR1238 (a, b) + link.m_internalWallsLoss;;
               NS_LOG_INFO (this << " I-I (same building) ITUR1238 : " << loss);
 
             }
           else
             {
               // nodes are in different buildings
-              loss = ItuR1411 (a, b) + ExternalWallLoss (a1) + ExternalWallLoss (b1);
+              loss = ItuR1411 (a, b) + link.m_aExternalWallLoss + link.m_bExternalWallLoss;
               NS_LOG_INFO (this << " I-I (different) ITUR1238 + 2*BEL : " << loss);
             }
         }
@@ -232,19 +230,19 @@ HybridBuildingsPropagationLossModel::GetLoss (Ptr<MobilityModel> a, Ptr<Mobility
               if ((a->GetPosition ().z < m_rooftopHeight)
                   && (b->GetPosition ().z < m_rooftopHeight))
                 {
-                  loss = ItuR1411 (a, b) + ExternalWallLoss (a1) + HeightLoss (a1);
+                  loss = ItuR1411 (a, b) + link.m_aExternalWallLoss + link.m_aHeightLoss;
                   NS_LOG_INFO (this << " I-O (>1000): down rooftop -> ITUR1411 : " << loss);
                 }
               else
                 {
                   // above rooftop -> OH
-                  loss = OkumuraHata (a, b) + ExternalWallLoss (a1) + HeightLoss (a1);
+                  loss = OkumuraHata (a, b) + link.m_aExternalWallLoss + link.m_aHeightLoss;
                   NS_LOG_INFO (this << " =I-O (>1000) over rooftop OH + BEL + HG: " << loss);
                 }
             }
           else
             {
-              loss = ItuR1411 (a, b) + ExternalWallLoss (a1)  + HeightLoss (a1);
+              loss = ItuR1411 (a, b) + link.m_aExternalWallLoss  + link.m_aHeightLoss;
               NS_LOG_INFO (this << " I-O (<1000)  ITUR1411 + BEL + HG: " << loss);
             }
         } // end b1->IsIndoor ()
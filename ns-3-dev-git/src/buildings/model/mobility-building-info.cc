@@ -45,6 +45,7 @@ MobilityBuildingInfo::GetTypeId (void)
 
 
 MobilityBuildingInfo::MobilityBuildingInfo ()
+  : m_updateCount (0)
 {
   NS_LOG_FUNCTION (this);
   m_indoor = false;
@@ -55,7 +56,8 @@ MobilityBuildingInfo::MobilityBuildingInfo ()
 
 
 MobilityBuildingInfo::MobilityBuildingInfo (Ptr<Building> building)
-  : m_myBuilding (building)
+  : m_myBuilding (building),
+    m_updateCount (0)
 {
   NS_LOG_FUNCTION (this);
   m_indoor = false;
@@ -83,6 +85,7 @@ MobilityBuildingInfo::SetIndoor (Ptr<Building> building, uint8_t nfloor, uint8_t
 {
   NS_LOG_FUNCTION (this);
   m_indoor = true;
+  m_updateCount++;
   m_myBuilding = building;
   m_nFloor = nfloor;
   m_roomX = nroomx;
@@ -104,6 +107,7 @@ MobilityBuildingInfo::SetIndoor (uint8_t nfloor, uint8_t nroomx, uint8_t nroomy)
 {
   NS_LOG_FUNCTION (this);
   m_indoor = true;
+  m_updateCount++;
   m_nFloor = nfloor;
   m_roomX = nroomx;
   m_roomY = nroomy;
@@ -124,6 +128,7 @@ MobilityBuildingInfo::SetOutdoor (void)
 {
   NS_LOG_FUNCTION (this);
   m_indoor = false;
+  m_updateCount++;
 }
 
 uint8_t
@@ -155,5 +160,11 @@ MobilityBuildingInfo::GetBuilding ()
   return (m_myBuilding);
 }
 
+uint32_t
+MobilityBuildingInfo::GetUpdateCount (void) const
+{
+  return m_updateCount;
+}
+
   
 } // namespace
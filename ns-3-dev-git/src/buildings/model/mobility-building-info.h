@@ -107,6 +107,13 @@ public:
    */
   Ptr<Building> GetBuilding ();
 
+  /**
+   *
+   * \return the number of times this instance was marked indoor or
+   * outdoor, to tell whether values derived from its state are stale
+   */
+  uint32_t GetUpdateCount (void) const;
+
 
 
 private:
@@ -116,6 +123,7 @@ private:
   uint8_t m_nFloor;
   uint8_t m_roomX;
   uint8_t m_roomY;
+  uint32_t m_updateCount;
 
 };
 
@@ -67,16 +67,14 @@ OhBuildingsPropagationLossModel::GetLoss (Ptr<MobilityModel> a, Ptr<MobilityMode
 {
   NS_LOG_FUNCTION (this << a << b);
 
-  // get the MobilityBuildingInfo pointers
-  Ptr<MobilityBuildingInfo> a1 = a->GetObject<MobilityBuildingInfo> ();
-  Ptr<MobilityBuildingInfo> b1 = b->GetObject<MobilityBuildingInfo> ();
-  NS_ASSERT_MSG ((a1 != 0) && (b1 != 0), "OhBuildingsPropagationLossModel only works with MobilityBuildingInfo");
+  // the indoor/outdoor classification and penetration losses of the link
+  const LinkInfo& link = GetLinkInfo (a, b);
 
   double loss = 0.0;
 
-  if (a1->IsOutdoor ())
+  if (!link.m_aIndoor)
     {
-      if (b1->IsOutdoor ())
+      if (!link.m_bIndoor)
         {
           loss = m_okumuraHata->GetLoss (a, b);
           NS_LOG_INFO (this << " O-O : " << loss);
@@ -84,32 +82,32 @@ OhBuildingsPropagationLossModel::GetLoss (Ptr<MobilityModel> a, Ptr<MobilityMode
       else
         {
           // b indoor
-          loss = m_okumuraHata->GetLoss (a, b) + ExternalWallLoss (b1);
+          loss = m_okumuraHata->GetLoss (a, b) + link.m_bExternalWallLoss;
           NS_LOG_INFO (this << " O-I : " << loss);
         } // end b1->isIndoor ()
     }
   else
     {
       // a is indoor
-      if (b1->IsIndoor ())
+      if (link.m_bIndoor)
         {
-          if (a1->GetBuilding () == b1->GetBuilding ())
+          if (link.m_sameBuilding)
             {
               // nodes are in same building -> indoor communication ITU-R P.1238
-              loss = m_okumuraHata->GetLoss (a, b) + InternalWallsLoss (a1, b1);;
+              loss = m_okumuraHata->GetLoss (a, b) + link.m_internalWallsLoss;;
               NS_LOG_INFO (this << " I-I (same building)" << loss);
 
             }
           else
             {
               // nodes are in different buildings
-              loss = m_okumuraHata->GetLoss (a, b) + ExternalWallLoss (a1) + ExternalWallLoss (b1);
+              loss = m_okumuraHata->GetLoss (a, b) + link.m_aExternalWallLoss + link.m_bExternalWallLoss;
               NS_LOG_INFO (this << " I-O-I (different buildings): " << loss);
             }
         }
       else
         {
-          loss = m_okumuraHata->GetLoss (a, b) + ExternalWallLoss (a1);
+          loss = m_okumuraHata->GetLoss (a, b) + link.m_aExternalWallLoss;
           NS_LOG_INFO (this << " I-O : " << loss);
         } // end b1->IsIndoor ()
     } // end a1->IsOutdoor ()
@@ -0,0 +1,198 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+
+#include "ns3/log.h"
+#include "ns3/test.h"
+#include <ns3/building.h>
+#include <ns3/building-list.h>
+#include <ns3/buildings-helper.h>
+#include <ns3/mobility-building-info.h>
+#include <ns3/constant-position-mobility-model.h>
+#include <ns3/oh-buildings-propagation-loss-model.h>
+#include <ns3/random-variable-stream.h>
+#include <ns3/rng-seed-manager.h>
+#include <ns3/double.h>
+#include <ns3/simulator.h>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("BuildingListIndexTest");
+
+/**
+ * Check that the buildings found through the grid index of BuildingList
+ * are those found by searching the whole list
+ */
+class BuildingListIndexTestCase : public TestCase
+{
+public:
+  BuildingListIndexTestCase ();
+
+private:
+  virtual void DoRun (void);
+  Ptr<Building> FindLinear (const Vector &position);
+};
+
+BuildingListIndexTestCase::BuildingListIndexTestCase ()
+  : TestCase ("Grid index of BuildingList")
+{
+}
+
+Ptr<Building>
+BuildingListIndexTestCase::FindLinear (const Vector &position)
+{
+  for (BuildingList::Iterator bit = BuildingList::Begin (); bit != BuildingList::End (); ++bit)
+    {
+      if ((*bit)->IsInside (position))
+        {
+          return *bit;
+        }
+    }
+  return 0;
+}
+
+void
+BuildingListIndexTestCase::DoRun (void)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (1);
+  Ptr<UniformRandomVariable> uniform = CreateObject<UniformRandomVariable> ();
+
+  // buildings of random size on a 20 x 20 grid of 100 m blocks, a few of
+  // them spanning several blocks
+  for (uint32_t x = 0; x < 20; x++)
+    {
+      for (uint32_t y = 0; y < 20; y++)
+        {
+          double xMin = x * 100.0 + uniform->GetValue (0, 20);
+          double yMin = y * 100.0 + uniform->GetValue (0, 20);
+          double xMax = xMin + uniform->GetValue (10, 70);
+          double yMax = yMin + ((x + y) % 37 == 0 ? 350 : uniform->GetValue (10, 70));
+          Ptr<Building> building = CreateObject<Building> ();
+          building->SetBoundaries (Box (xMin, xMax, yMin, yMax, 0.0, 20.0));
+        }
+    }
+
+  uint32_t nIndoor = 0;
+  for (uint32_t i = 0; i < 5000; i++)
+    {
+      Vector position (uniform->GetValue (-100, 2100), uniform->GetValue (-100, 2100), uniform->GetValue (0, 25));
+      Ptr<Building> expected = FindLinear (position);
+      Ptr<Building> found = BuildingList::FindBuilding (position);
+      NS_TEST_ASSERT_MSG_EQ ((found == 0), (expected == 0), "Indoor position not found through the index at " << position);
+      if (found != 0)
+        {
+          NS_TEST_ASSERT_MSG_EQ (found->IsInside (position), true, "Position is not inside the building found");
+          nIndoor++;
+        }
+    }
+  NS_TEST_ASSERT_MSG_GT (nIndoor, 0, "No indoor position was drawn");
+
+  // moving a building must be seen by the index
+  Ptr<Building> moved = BuildingList::GetBuilding (BuildingList::GetNBuildings () - 1);
+  moved->SetBoundaries (Box (5000, 5010, 5000, 5010, 0.0, 10.0));
+  NS_TEST_ASSERT_MSG_EQ (BuildingList::FindBuilding (Vector (5005, 5005, 1)), moved, "Moved building not found");
+  NS_TEST_ASSERT_MSG_EQ (BuildingList::FindBuilding (Vector (4000, 4000, 1)), 0, "Position outside of all buildings is indoor");
+
+  Simulator::Destroy ();
+}
+
+/**
+ * Check that the per-link classification and penetration losses cached by
+ * BuildingsPropagationLossModel follow the nodes moving indoor and outdoor,
+ * and the changes of the buildings
+ */
+class BuildingsLinkCacheTestCase : public TestCase
+{
+public:
+  BuildingsLinkCacheTestCase ();
+
+private:
+  virtual void DoRun (void);
+  double GetUncachedLoss (Ptr<MobilityModel> a, Ptr<MobilityModel> b);
+};
+
+BuildingsLinkCacheTestCase::BuildingsLinkCacheTestCase ()
+  : TestCase ("Per-link cache of the buildings losses")
+{
+}
+
+double
+BuildingsLinkCacheTestCase::GetUncachedLoss (Ptr<MobilityModel> a, Ptr<MobilityModel> b)
+{
+  return CreateObject<OhBuildingsPropagationLossModel> ()->GetLoss (a, b);
+}
+
+void
+BuildingsLinkCacheTestCase::DoRun (void)
+{
+  Ptr<Building> building1 = CreateObject<Building> ();
+  building1->SetBoundaries (Box (0.0, 50.0, 0.0, 50.0, 0.0, 30.0));
+  building1->SetExtWallsType (Building::ConcreteWithWindows);
+  building1->SetNFloors (3);
+  building1->SetNRoomsX (5);
+  building1->SetNRoomsY (5);
+  Ptr<Building> building2 = CreateObject<Building> ();
+  building2->SetBoundaries (Box (2000.0, 2050.0, 0.0, 50.0, 0.0, 30.0));
+  building2->SetExtWallsType (Building::StoneBlocks);
+
+  Ptr<MobilityModel> a = CreateObject<ConstantPositionMobilityModel> ();
+  a->AggregateObject (CreateObject<MobilityBuildingInfo> ());
+  Ptr<MobilityModel> b = CreateObject<ConstantPositionMobilityModel> ();
+  b->AggregateObject (CreateObject<MobilityBuildingInfo> ());
+
+  Ptr<OhBuildingsPropagationLossModel> model = CreateObject<OhBuildingsPropagationLossModel> ();
+
+  // O-O, I-O, I-I in the same building, I-I in different buildings, O-I
+  Vector aPositions[] = { Vector (-500, 25, 1.5), Vector (25, 25, 15), Vector (25, 25, 15), Vector (25, 25, 15), Vector (-500, 25, 1.5) };
+  Vector bPositions[] = { Vector (1000, 25, 1.5), Vector (1000, 25, 1.5), Vector (5, 45, 1.5), Vector (2025, 25, 1.5), Vector (2025, 25, 1.5) };
+  for (uint32_t i = 0; i < 5; i++)
+    {
+      a->SetPosition (aPositions[i]);
+      b->SetPosition (bPositions[i]);
+      BuildingsHelper::MakeConsistent (a);
+      BuildingsHelper::MakeConsistent (b);
+      double loss = model->GetLoss (a, b);
+      NS_TEST_ASSERT_MSG_EQ (loss, GetUncachedLoss (a, b), "Stale cached loss for link " << i);
+      NS_TEST_ASSERT_MSG_EQ (model->GetLoss (a, b), loss, "Cached loss differs for link " << i);
+    }
+
+  // b is still in building2: changing its walls after the first evaluation must not leave the loss stale
+  double stoneLoss = model->GetLoss (a, b);
+  building2->SetExtWallsType (Building::Wood);
+  NS_TEST_ASSERT_MSG_EQ (model->GetLoss (a, b), GetUncachedLoss (a, b), "Stale cached loss after a change of the building");
+  NS_TEST_ASSERT_MSG_NE (model->GetLoss (a, b), stoneLoss, "The wall type of the building did not change the loss");
+
+  Simulator::Destroy ();
+}
+
+class BuildingListIndexTestSuite : public TestSuite
+{
+public:
+  BuildingListIndexTestSuite ();
+};
+
+BuildingListIndexTestSuite::BuildingListIndexTestSuite ()
+  : TestSuite ("building-list-index", UNIT)
+{
+  AddTestCase (new BuildingListIndexTestCase, TestCase::QUICK);
+  AddTestCase (new BuildingsLinkCacheTestCase, TestCase::QUICK);
+}
+
+static BuildingListIndexTestSuite buildingListIndexTestSuite;
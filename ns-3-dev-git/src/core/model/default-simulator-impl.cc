@@ -18,6 +18,7 @@
  * Author: Mathieu Lacage <mathieu.lacage@sophia.inria.fr>
  */
 
+#include "ns3/core-config.h"
 #include "simulator.h"
 #include "default-simulator-impl.h"
 #include "scheduler.h"
@@ -27,8 +28,25 @@
 #include "pointer.h"
 #include "assert.h"
 #include "log.h"
+#include "global-value.h"
+#include "uinteger.h"
 
+#include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef HAVE_DLFCN_H
+#include <dlfcn.h>
+#endif
+#if (__GNUC__ >= 3)
+#include <cxxabi.h>
+#endif
 
 
 /**
@@ -46,6 +64,86 @@ NS_LOG_COMPONENT_DEFINE ("DefaultSimulatorImpl");
 
 NS_OBJECT_ENSURE_REGISTERED (DefaultSimulatorImpl);
 
+/**
+ * \ingroup simulator
+ * The average number of events per sample of the event profiler,
+ * 0 to disable it.
+ */
+static GlobalValue g_eventProfilerSamplingPeriod
+  ("EventProfilerSamplingPeriod",
+   "Time about one in this many events and print where the wall time went at Simulator::Destroy, 0 to disable",
+   UintegerValue (0),
+   MakeUintegerChecker<uint32_t> ());
+
+namespace {
+
+/** Number of handlers and of contexts listed by the event profiler. */
+const uint32_t PROFILE_TOP = 20;
+
+/**
+ * Demangle a C++ symbol or type name.
+ * \param [in] mangled The mangled name.
+ * \returns The demangled name, or mangled if it can not be demangled.
+ */
+std::string
+ProfileDemangle (const char *mangled)
+{
+  std::string name = mangled;
+#if (__GNUC__ >= 3)
+  int status;
+  char *demangled = abi::__cxa_demangle (mangled, NULL, NULL, &status);
+  if (status == 0)
+    {
+      name = demangled;
+    }
+  std::free (demangled);
+#endif
+  return name;
+}
+
+/**
+ * Name an event handler of the event profiler.
+ * \param [in] function The address of the code the event invokes, or 0.
+ * \param [in] type The type of the event implementation.
+ * \returns The name of the function, or of the event type if the
+ * function can not be resolved.
+ */
+std::string
+ProfileHandlerName (const void *function, const std::type_info *type)
+{
+#ifdef HAVE_DLFCN_H
+  Dl_info info;
+  if (function != 0 && dladdr (function, &info) != 0 && info.dli_sname != 0)
+    {
+      return ProfileDemangle (info.dli_sname);
+    }
+#endif
+  std::ostringstream oss;
+  if (function != 0)
+    {
+      oss << function << " in ";
+    }
+  oss << ProfileDemangle (type->name ());
+  return oss.str ();
+}
+
+/** A line of the summary of the event profiler. */
+typedef std::pair<std::string, std::pair<uint64_t, double> > ProfileLine;
+
+/**
+ * Order lines by decreasing wall time.
+ * \param [in] a The first line.
+ * \param [in] b The second line.
+ * \returns \c true if a took more wall time than b.
+ */
+bool
+ProfileLineGreater (const ProfileLine &a, const ProfileLine &b)
+{
+  return a.second.second > b.second.second;
+}
+
+} // unnamed namespace
+
 TypeId
 DefaultSimulatorImpl::GetTypeId (void)
 {
@@ -73,6 +171,11 @@ DefaultSimulatorImpl::DefaultSimulatorImpl ()
   m_unscheduledEvents = 0;
   m_eventsWithContextEmpty = true;
   m_main = SystemThread::Self();
+  m_profilePeriod = 0;
+  m_profileCountdown = 0;
+  m_profileRng = 2463534242U;
+  m_profileEvents = 0;
+  m_profileSamples = 0;
 }
 
 DefaultSimulatorImpl::~DefaultSimulatorImpl ()
@@ -108,6 +211,15 @@ DefaultSimulatorImpl::Destroy ()
           ev->Invoke ();
         }
     }
+
+  if (m_profileSamples != 0)
+    {
+      PrintProfile (std::clog);
+      m_profileHandlers.clear ();
+      m_profileContexts.clear ();
+      m_profileEvents = 0;
+      m_profileSamples = 0;
+    }
 }
 
 void
@@ -146,7 +258,22 @@ DefaultSimulatorImpl::ProcessOneEvent (void)
   m_currentTs = next.key.m_ts;
   m_currentContext = next.key.m_context;
   m_currentUid = next.key.m_uid;
-  next.impl->Invoke ();
+  if (m_profilePeriod == 0)
+    {
+      next.impl->Invoke ();
+    }
+  else
+    {
+      m_profileEvents++;
+      if (--m_profileCountdown == 0)
+        {
+          ProfileEvent (next.impl);
+        }
+      else
+        {
+          next.impl->Invoke ();
+        }
+    }
   next.impl->Unref ();
 
   ProcessEventsWithContext ();
@@ -158,6 +285,126 @@ DefaultSimulatorImpl::IsFinished (void) const
   return m_events->IsEmpty () || m_stop;
 }
 
+void
+DefaultSimulatorImpl::ProfileEvent (EventImpl *event)
+{
+  const ProfileHandler handler (event->GetFunction (), &typeid (*event));
+  const uint32_t context = m_currentContext;
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+  event->Invoke ();
+  const double seconds = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+
+  ProfileEntry &byHandler = m_profileHandlers[handler];
+  byHandler.events++;
+  byHandler.seconds += seconds;
+  ProfileEntry &byContext = m_profileContexts[context];
+  byContext.events++;
+  byContext.seconds += seconds;
+  m_profileSamples++;
+
+  // Draw the distance to the next sample uniformly from [1, 2 * period - 1],
+  // so that periodic patterns in the events do not bias the samples.
+  m_profileRng ^= m_profileRng << 13;
+  m_profileRng ^= m_profileRng >> 17;
+  m_profileRng ^= m_profileRng << 5;
+  m_profileCountdown = 1 + m_profileRng % (2 * (uint64_t)m_profilePeriod - 1);
+}
+
+uint64_t
+DefaultSimulatorImpl::GetProfile (ProfileSummary &handlers) const
+{
+  handlers.clear ();
+  if (m_profileSamples == 0)
+    {
+      return m_profileEvents;
+    }
+
+  for (std::map<ProfileHandler, ProfileEntry>::const_iterator i = m_profileHandlers.begin ();
+       i != m_profileHandlers.end (); ++i)
+    {
+      // Events that bind different arguments to the same function are merged
+      std::pair<uint64_t, double> &line = handlers[ProfileHandlerName (i->first.first, i->first.second)];
+      line.first += i->second.events;
+      line.second += i->second.seconds;
+    }
+
+  // Every sample stands for this many events
+  const double scale = (double)m_profileEvents / m_profileSamples;
+  for (ProfileSummary::iterator i = handlers.begin (); i != handlers.end (); ++i)
+    {
+      i->second.first = (uint64_t)(i->second.first * scale + 0.5);
+      i->second.second *= scale;
+    }
+  return m_profileEvents;
+}
+
+void
+DefaultSimulatorImpl::PrintProfile (std::ostream &os) const
+{
+  ProfileSummary byName;
+  GetProfile (byName);
+  std::vector<ProfileLine> handlers (byName.begin (), byName.end ());
+  double total = 0;
+  for (std::vector<ProfileLine>::const_iterator i = handlers.begin (); i != handlers.end (); ++i)
+    {
+      total += i->second.second;
+    }
+
+  const double scale = (double)m_profileEvents / m_profileSamples;
+  std::vector<ProfileLine> contexts;
+  for (std::map<uint32_t, ProfileEntry>::const_iterator i = m_profileContexts.begin ();
+       i != m_profileContexts.end (); ++i)
+    {
+      std::ostringstream oss;
+      if (i->first == Simulator::NO_CONTEXT)
+        {
+          oss << "none";
+        }
+      else
+        {
+          oss << i->first;
+        }
+      contexts.push_back (ProfileLine (oss.str (), std::make_pair ((uint64_t)(i->second.events * scale + 0.5),
+                                                                   i->second.seconds * scale)));
+    }
+
+  std::ios_base::fmtflags flags = os.flags ();
+  std::streamsize precision = os.precision ();
+  os << std::fixed
+     << "Event profiler: " << m_profileSamples << " of " << m_profileEvents
+     << " events sampled, estimated wall time in events "
+     << std::setprecision (6) << total << " s" << std::endl;
+
+  const char *titles[2] = { "handler", "context" };
+  std::vector<ProfileLine> *tables[2] = { &handlers, &contexts };
+  for (uint32_t t = 0; t < 2; t++)
+    {
+      std::vector<ProfileLine> &lines = *tables[t];
+      const uint32_t n = std::min<std::size_t> (lines.size (), PROFILE_TOP);
+      std::partial_sort (lines.begin (), lines.begin () + n, lines.end (), ProfileLineGreater);
+
+      os << "  " << std::setw (7) << "share" << std::setw (14) << "events"
+         << std::setw (12) << "wall (s)" << std::setw (12) << "us/event"
+         << "  " << titles[t]
+         << " (top " << n << " of " << lines.size () << ")" << std::endl;
+      for (uint32_t i = 0; i < n; i++)
+        {
+          const ProfileLine &line = lines[i];
+          os << "  " << std::setw (6) << std::setprecision (2)
+             << (total > 0 ? 100 * line.second.second / total : 0) << "%"
+             << std::setw (14) << line.second.first
+             << std::setw (12) << std::setprecision (6) << line.second.second
+             << std::setw (12) << std::setprecision (2)
+             << (line.second.first > 0 ? 1e6 * line.second.second / line.second.first : 0)
+             << "  " << line.first << std::endl;
+        }
+    }
+
+  os.flags (flags);
+  os.precision (precision);
+}
+
 void
 DefaultSimulatorImpl::ProcessEventsWithContext (void)
 {
@@ -197,6 +444,14 @@ DefaultSimulatorImpl::Run (void)
   ProcessEventsWithContext ();
   m_stop = false;
 
+  UintegerValue profilePeriod;
+  g_eventProfilerSamplingPeriod.GetValue (profilePeriod);
+  if (profilePeriod.Get () != m_profilePeriod)
+    {
+      m_profilePeriod = profilePeriod.Get ();
+      m_profileCountdown = m_profilePeriod;
+    }
+
   while (!m_events->IsEmpty () && !m_stop) 
     {
       ProcessOneEvent ();
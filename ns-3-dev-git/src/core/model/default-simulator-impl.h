@@ -30,6 +30,11 @@
 #include "ptr.h"
 
 #include <list>
+#include <map>
+#include <ostream>
+#include <string>
+#include <typeinfo>
+#include <utility>
 
 /**
  * \file
@@ -43,6 +48,12 @@ namespace ns3 {
  * \ingroup simulator
  *
  * The default single process simulator implementation.
+ *
+ * When the global value EventProfilerSamplingPeriod is not 0, about one
+ * in that many events is timed while it is invoked. The wall time and
+ * the number of events are attributed to the function or method the
+ * event invokes and to the context (node) of the event, and a ranked
+ * summary of both is printed to std::clog at Simulator::Destroy().
  */
 class DefaultSimulatorImpl : public SimulatorImpl
 {
@@ -78,6 +89,21 @@ public:
   virtual uint32_t GetSystemId (void) const; 
   virtual uint32_t GetContext (void) const;
 
+  /**
+   * Estimated number of events and wall time in seconds, per name of
+   * the function or method the events invoke.
+   */
+  typedef std::map<std::string, std::pair<uint64_t, double> > ProfileSummary;
+  /**
+   * Get the estimates of the event profiler for the events processed so
+   * far, see EventProfilerSamplingPeriod.
+   *
+   * \param [out] handlers The estimates per event handler, empty if no
+   *   event was sampled.
+   * \returns The number of events processed while profiling.
+   */
+  uint64_t GetProfile (ProfileSummary &handlers) const;
+
 private:
   virtual void DoDispose (void);
 
@@ -85,6 +111,16 @@ private:
   void ProcessOneEvent (void);
   /** Move events from a different context into the main event queue. */
   void ProcessEventsWithContext (void);
+  /**
+   * Invoke an event, timing it for the event profiler.
+   * \param [in] event The event to invoke.
+   */
+  void ProfileEvent (EventImpl *event);
+  /**
+   * Print the ranked summary of the event profiler.
+   * \param [in] os The output stream.
+   */
+  void PrintProfile (std::ostream &os) const;
  
   /** Wrap an event with its execution context. */
   struct EventWithContext {
@@ -132,6 +168,34 @@ private:
 
   /** Main execution thread. */
   SystemThread::ThreadId m_main;
+
+  /** Events and wall time sampled by the event profiler. */
+  struct ProfileEntry
+  {
+    /** Number of sampled events. */
+    uint64_t events;
+    /** Wall time spent in the sampled events, in seconds. */
+    double seconds;
+  };
+  /**
+   * Key of an event handler: the address of the code it invokes (0 if
+   * not known) and the type of the event implementation.
+   */
+  typedef std::pair<const void *, const std::type_info *> ProfileHandler;
+  /** Samples per event handler. */
+  std::map<ProfileHandler, ProfileEntry> m_profileHandlers;
+  /** Samples per event context. */
+  std::map<uint32_t, ProfileEntry> m_profileContexts;
+  /** One in this many events is sampled on average, 0 if disabled. */
+  uint32_t m_profilePeriod;
+  /** Number of events until the next sample. */
+  uint32_t m_profileCountdown;
+  /** State of the generator of the distance between samples. */
+  uint32_t m_profileRng;
+  /** Number of events processed while profiling. */
+  uint64_t m_profileEvents;
+  /** Number of sampled events. */
+  uint64_t m_profileSamples;
 };
 
 } // namespace ns3
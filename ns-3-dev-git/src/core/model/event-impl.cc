@@ -66,4 +66,10 @@ EventImpl::IsCancelled (void)
   return m_cancel;
 }
 
+const void *
+EventImpl::GetFunction (void)
+{
+  return 0;
+}
+
 } // namespace ns3
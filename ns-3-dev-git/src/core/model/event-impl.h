@@ -65,6 +65,13 @@ public:
    * Checked by the simulation engine before calling Invoke().
    */
   bool IsCancelled (void);
+  /**
+   * \returns The address of the code of the function or method this
+   * event invokes, or 0 if it is not known.
+   *
+   * Only used to attribute events to their handler when profiling.
+   */
+  virtual const void * GetFunction (void);
 
 protected:
   /**
@@ -264,6 +264,9 @@ EventImpl * MakeEvent (void (*f)(U1,U2,U3,U4,U5), T1 a1, T2 a2, T3 a3, T4 a4, T5
 #include "event-impl.h"
 #include "type-traits.h"
 
+#include <cstddef>
+#include <cstring>
+
 namespace ns3 {
 
 /**
@@ -302,6 +305,60 @@ struct EventMemberImplObjTraits<T *>
   }
 };
 
+/**
+ * \ingroup makeeventmemptr
+ * Helper for EventImpl::GetFunction of the MakeEvent functions which
+ * take a class method.
+ *
+ * Decodes the Itanium C++ ABI representation of a pointer to member
+ * function, looking up virtual methods in the vtable of the object.
+ *
+ * \param [in] function The class method.
+ * \param [in] obj The object.
+ * \returns The address of the code that is invoked, or 0 for other ABIs.
+ */
+template <typename MEM, typename OBJ>
+const void * EventMemberImplGetFunction (MEM function, OBJ & obj)
+{
+#if defined (__GNUC__) && !defined (__arm__) && !defined (__aarch64__)
+  struct
+  {
+    uintptr_t ptr;
+    ptrdiff_t adj;
+  } rep;
+  if (sizeof (function) != sizeof (rep))
+    {
+      return 0;
+    }
+  std::memcpy (&rep, &function, sizeof (rep));
+  if ((rep.ptr & 1) == 0)
+    {
+      return reinterpret_cast<const void *> (rep.ptr);
+    }
+  const char *self = reinterpret_cast<const char *> (&EventMemberImplObjTraits<OBJ>::GetReference (obj)) + rep.adj;
+  const char *vtable = *reinterpret_cast<const char * const *> (self);
+  return *reinterpret_cast<const void * const *> (vtable + rep.ptr - 1);
+#else
+  return 0;
+#endif
+}
+
+/**
+ * \ingroup makeeventfnptr
+ * Helper for EventImpl::GetFunction of the MakeEvent functions which
+ * take a function pointer.
+ *
+ * \param [in] function The function pointer.
+ * \returns The address of the function.
+ */
+template <typename F>
+const void * EventFunctionImplGetFunction (F function)
+{
+  const void *address = 0;
+  std::memcpy (&address, &function, sizeof (function) < sizeof (address) ? sizeof (function) : sizeof (address));
+  return address;
+}
+
 template <typename MEM, typename OBJ>
 EventImpl * MakeEvent (MEM mem_ptr, OBJ obj)
 {
@@ -322,6 +379,10 @@ private:
     {
       (EventMemberImplObjTraits<OBJ>::GetReference (m_obj).*m_function)();
     }
+    virtual const void * GetFunction (void)
+    {
+      return EventMemberImplGetFunction (m_function, m_obj);
+    }
     OBJ m_obj;
     MEM m_function;
   } *ev = new EventMemberImpl0 (obj, mem_ptr);
@@ -352,6 +413,10 @@ private:
     {
       (EventMemberImplObjTraits<OBJ>::GetReference (m_obj).*m_function)(m_a1);
     }
+    virtual const void * GetFunction (void)
+    {
+      return EventMemberImplGetFunction (m_function, m_obj);
+    }
     OBJ m_obj;
     MEM m_function;
     typename TypeTraits<T1>::ReferencedType m_a1;
@@ -383,6 +448,10 @@ private:
     {
       (EventMemberImplObjTraits<OBJ>::GetReference (m_obj).*m_function)(m_a1, m_a2);
     }
+    virtual const void * GetFunction (void)
+    {
+      return EventMemberImplGetFunction (m_function, m_obj);
+    }
     OBJ m_obj;
     MEM m_function;
     typename TypeTraits<T1>::ReferencedType m_a1;
@@ -416,6 +485,10 @@ private:
     {
       (EventMemberImplObjTraits<OBJ>::GetReference (m_obj).*m_function)(m_a1, m_a2, m_a3);
     }
+    virtual const void * GetFunction (void)
+    {
+      return EventMemberImplGetFunction (m_function, m_obj);
+    }
     OBJ m_obj;
     MEM m_function;
     typename TypeTraits<T1>::ReferencedType m_a1;
@@ -451,6 +524,10 @@ private:
     {
       (EventMemberImplObjTraits<OBJ>::GetReference (m_obj).*m_function)(m_a1, m_a2, m_a3, m_a4);
     }
+    virtual const void * GetFunction (void)
+    {
+      return EventMemberImplGetFunction (m_function, m_obj);
+    }
     OBJ m_obj;
     MEM m_function;
     typename TypeTraits<T1>::ReferencedType m_a1;
@@ -489,6 +566,10 @@ private:
     {
       (EventMemberImplObjTraits<OBJ>::GetReference (m_obj).*m_function)(m_a1, m_a2, m_a3, m_a4, m_a5);
     }
+    virtual const void * GetFunction (void)
+    {
+      return EventMemberImplGetFunction (m_function, m_obj);
+    }
     OBJ m_obj;
     MEM m_function;
     typename TypeTraits<T1>::ReferencedType m_a1;
@@ -523,6 +604,10 @@ private:
     {
       (*m_function)(m_a1);
     }
+    virtual const void * GetFunction (void)
+    {
+      return EventFunctionImplGetFunction (m_function);
+    }
     F m_function;
     typename TypeTraits<T1>::ReferencedType m_a1;
   } *ev = new EventFunctionImpl1 (f, a1);
@@ -553,6 +638,10 @@ private:
     {
       (*m_function)(m_a1, m_a2);
     }
+    virtual const void * GetFunction (void)
+    {
+      return EventFunctionImplGetFunction (m_function);
+    }
     F m_function;
     typename TypeTraits<T1>::ReferencedType m_a1;
     typename TypeTraits<T2>::ReferencedType m_a2;
@@ -586,6 +675,10 @@ private:
     {
       (*m_function)(m_a1, m_a2, m_a3);
     }
+    virtual const void * GetFunction (void)
+    {
+      return EventFunctionImplGetFunction (m_function);
+    }
     F m_function;
     typename TypeTraits<T1>::ReferencedType m_a1;
     typename TypeTraits<T2>::ReferencedType m_a2;
@@ -621,6 +714,10 @@ private:
     {
       (*m_function)(m_a1, m_a2, m_a3, m_a4);
     }
+    virtual const void * GetFunction (void)
+    {
+      return EventFunctionImplGetFunction (m_function);
+    }
     F m_function;
     typename TypeTraits<T1>::ReferencedType m_a1;
     typename TypeTraits<T2>::ReferencedType m_a2;
@@ -658,6 +755,10 @@ private:
     {
       (*m_function)(m_a1, m_a2, m_a3, m_a4, m_a5);
     }
+    virtual const void * GetFunction (void)
+    {
+      return EventFunctionImplGetFunction (m_function);
+    }
     F m_function;
     typename TypeTraits<T1>::ReferencedType m_a1;
     typename TypeTraits<T2>::ReferencedType m_a2;
@@ -109,7 +109,8 @@ RandomVariableStream::SetStream (int64_t stream)
       NS_ASSERT(nextStream <= ((1ULL)<<63));
       m_rng = new RngStream (RngSeedManager::GetSeed (),
                              nextStream,
-                             RngSeedManager::GetRun ());
+                             RngSeedManager::GetRun (),
+                             RngSeedManager::GetRngType ());
     }
   else
     {
@@ -119,7 +120,8 @@ RandomVariableStream::SetStream (int64_t stream)
       uint64_t target = base + stream;
       m_rng = new RngStream (RngSeedManager::GetSeed (),
                              target,
-                             RngSeedManager::GetRun ());
+                             RngSeedManager::GetRun (),
+                             RngSeedManager::GetRngType ());
     }
   m_stream = stream;
 }
@@ -130,6 +132,20 @@ RandomVariableStream::GetStream(void) const
   return m_stream;
 }
 
+void
+RandomVariableStream::GetRngState (uint32_t state[6]) const
+{
+  NS_LOG_FUNCTION (this);
+  m_rng->GetState (state);
+}
+
+void
+RandomVariableStream::SetRngState (const uint32_t state[6])
+{
+  NS_LOG_FUNCTION (this);
+  m_rng->SetState (state);
+}
+
 RngStream *
 RandomVariableStream::Peek(void) const
 {
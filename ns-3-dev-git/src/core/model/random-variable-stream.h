@@ -149,6 +149,25 @@ public:
    */
   virtual uint32_t GetInteger (void) = 0;
 
+  /**
+   * \brief Get the current position of the underlying RNG stream.
+   *
+   * Together with SetRngState() this allows a simulation to save
+   * and later resume the sequence of values drawn from this stream.
+   * Values cached by a distribution (e.g. the second value of a
+   * normal pair) are not part of the state.
+   *
+   * \param [out] state The six components of the RNG state vector.
+   */
+  void GetRngState (uint32_t state[6]) const;
+
+  /**
+   * \brief Move the underlying RNG stream to a saved position.
+   * \param [in] state The six components of the RNG state vector,
+   * as obtained from GetRngState().
+   */
+  void SetRngState (const uint32_t state[6]);
+
 protected:
   /**
    * \brief Get the pointer to the underlying RNG stream.
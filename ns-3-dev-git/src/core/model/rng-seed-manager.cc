@@ -21,6 +21,7 @@
 #include "global-value.h"
 #include "attribute-helper.h"
 #include "integer.h"
+#include "enum.h"
 #include "config.h"
 #include "log.h"
 
@@ -67,6 +68,18 @@ static ns3::GlobalValue g_rngRun ("RngRun",
                                   ns3::IntegerValue (1),
                                   ns3::MakeIntegerChecker<int64_t> ());
 
+/**
+ * \relates RngSeedManager
+ * The generator behind all rng streams.
+ *
+ * This is accessible as "--RngType" from CommandLine.
+ */
+static ns3::GlobalValue g_rngType ("RngType",
+                                   "The generator behind all rng streams",
+                                   ns3::EnumValue (RngStream::MRG32K3A),
+                                   ns3::MakeEnumChecker (RngStream::MRG32K3A, "MRG32k3a",
+                                                         RngStream::PHILOX, "Philox"));
+
 
 uint32_t RngSeedManager::GetSeed (void)
 {
@@ -97,6 +110,20 @@ uint64_t RngSeedManager::GetRun ()
   return run;
 }
 
+void RngSeedManager::SetRngType (RngStream::Type type)
+{
+  NS_LOG_FUNCTION (type);
+  Config::SetGlobal ("RngType", EnumValue (type));
+}
+
+RngStream::Type RngSeedManager::GetRngType (void)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+  EnumValue value;
+  g_rngType.GetValue (value);
+  return static_cast<RngStream::Type> (value.Get ());
+}
+
 uint64_t RngSeedManager::GetNextStreamIndex (void)
 {
   NS_LOG_FUNCTION_NOARGS ();
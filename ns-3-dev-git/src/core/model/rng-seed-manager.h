@@ -21,6 +21,7 @@
 #define RNG_SEED_MANAGER_H
 
 #include <stdint.h>
+#include "rng-stream.h"
 
 /**
  * \file
@@ -99,6 +100,25 @@ public:
    */
   static uint64_t GetRun (void);
 
+  /**
+   * \brief Set the generator behind all subsequently created streams.
+   *
+   * MRG32k3a is the default. Streams of the Philox counter-based
+   * generator are cheaper to set up and draw from, but give different
+   * random numbers for the same seed, run and stream.
+   *
+   * This is accessible as "--RngType" from CommandLine.
+   *
+   * \param [in] type The generator type.
+   */
+  static void SetRngType (RngStream::Type type);
+  /**
+   * \brief Get the generator behind all subsequently created streams.
+   * \returns The generator type.
+   * \see SetRngType
+   */
+  static RngStream::Type GetRngType (void);
+
   /**
    * Get the next automatically assigned stream index.
    * \returns The next stream index.
@@ -22,13 +22,14 @@
 
 #include <cstdlib>
 #include <iostream>
+#include <limits>
 #include "rng-stream.h"
 #include "fatal-error.h"
 #include "log.h"
 
 /// \file
 /// \ingroup rngimpl
-/// Class RngStream and MRG32k3a implementation.
+/// Class RngStream, MRG32k3a and Philox4x32-10 implementation.
 
 namespace ns3 {
   
@@ -41,7 +42,7 @@ NS_LOG_COMPONENT_DEFINE ("RngStream");
 
 
 /// \ingroup rngimpl
-/// Unnamed namespace for MRG32k3a implementation details.
+/// Unnamed namespace for MRG32k3a and Philox implementation details.
 namespace
 {
 
@@ -84,6 +85,20 @@ const double two17 =      131072.0;
 /// \ingroup rngimpl
 /// IEEE-754 floating point precision, 2<sup>53</sup>
 const double two53 =      9007199254740992.0;
+
+/// \ingroup rngimpl
+/// Normalization of Philox words to obtain randoms on (0,1), 2<sup>-32</sup>.
+const double philoxNorm = 1.0 / 4294967296.0;
+
+/// \ingroup rngimpl
+/// Philox4x32 multipliers.
+const uint32_t philoxM0 = 0xD2511F53;
+const uint32_t philoxM1 = 0xCD9E8D57;  //!< \copydoc philoxM0
+
+/// \ingroup rngimpl
+/// Philox4x32 key schedule (Weyl sequence) increments.
+const uint32_t philoxW0 = 0x9E3779B9;
+const uint32_t philoxW1 = 0xBB67AE85;  //!< \copydoc philoxW0
   
 /// \ingroup rngimpl
 /// First component transition matrix.
@@ -337,6 +352,17 @@ namespace ns3 {
 //
 double RngStream::RandU01 ()
 {
+  if (m_type == PHILOX)
+    {
+      const uint64_t n = m_philox.m_next;
+      if (n < m_philox.m_bufferStart || n - m_philox.m_bufferStart >= 4 * PHILOX_BUFFER_BLOCKS)
+        {
+          FillPhiloxBuffer ();
+        }
+      m_philox.m_next++;
+      return (m_philox.m_buffer[n - m_philox.m_bufferStart] + 0.5) * philoxNorm;
+    }
+
   int32_t k;
   double p1, p2, u;
 
@@ -366,12 +392,112 @@ double RngStream::RandU01 ()
   return u;
 }
 
-RngStream::RngStream (uint32_t seedNumber, uint64_t stream, uint64_t substream)
+void
+RngStream::RandU01 (double *values, uint32_t n)
+{
+  if (m_type != PHILOX)
+    {
+      for (uint32_t i = 0; i < n; ++i)
+        {
+          values[i] = RandU01 ();
+        }
+      return;
+    }
+
+  uint32_t i = 0;
+  // Up to the next block boundary, and everything that is buffered already
+  while (i < n && ((m_philox.m_next & 3) != 0
+                   || (m_philox.m_next >= m_philox.m_bufferStart
+                       && m_philox.m_next - m_philox.m_bufferStart < 4 * PHILOX_BUFFER_BLOCKS)))
+    {
+      values[i++] = RandU01 ();
+    }
+
+  // Whole blocks, independent of each other
+  const uint32_t nBlocks = (n - i) / 4;
+  const uint64_t firstBlock = m_philox.m_next >> 2;
+  if (firstBlock + nBlocks > PHILOX_MAX_BLOCKS)
+    {
+      NS_FATAL_ERROR ("Philox stream exhausted after " << m_philox.m_next << " draws");
+    }
+  for (uint32_t b = 0; b < nBlocks; ++b)
+    {
+      uint32_t counter[4] = { static_cast<uint32_t> (firstBlock + b), m_philox.m_counterHigh[0],
+                              m_philox.m_counterHigh[1], m_philox.m_counterHigh[2] };
+      Philox4x32 (counter, m_philox.m_key);
+      for (uint32_t j = 0; j < 4; ++j)
+        {
+          values[i + 4 * b + j] = (counter[j] + 0.5) * philoxNorm;
+        }
+    }
+  i += 4 * nBlocks;
+  m_philox.m_next += 4 * nBlocks;
+
+  while (i < n)
+    {
+      values[i++] = RandU01 ();
+    }
+}
+
+void
+RngStream::Philox4x32 (uint32_t counter[4], const uint32_t key[2])
+{
+  uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+  uint32_t k0 = key[0], k1 = key[1];
+  for (int round = 0; round < 10; ++round)
+    {
+      const uint64_t p0 = static_cast<uint64_t> (philoxM0) * c0;
+      const uint64_t p1 = static_cast<uint64_t> (philoxM1) * c2;
+      const uint32_t n0 = static_cast<uint32_t> (p1 >> 32) ^ c1 ^ k0;
+      const uint32_t n2 = static_cast<uint32_t> (p0 >> 32) ^ c3 ^ k1;
+      c1 = static_cast<uint32_t> (p1);
+      c3 = static_cast<uint32_t> (p0);
+      c0 = n0;
+      c2 = n2;
+      k0 += philoxW0;
+      k1 += philoxW1;
+    }
+  counter[0] = c0; counter[1] = c1; counter[2] = c2; counter[3] = c3;
+}
+
+void
+RngStream::FillPhiloxBuffer (void)
+{
+  const uint64_t firstBlock = m_philox.m_next >> 2;
+  if (firstBlock + PHILOX_BUFFER_BLOCKS > PHILOX_MAX_BLOCKS)
+    {
+      NS_FATAL_ERROR ("Philox stream exhausted after " << m_philox.m_next << " draws");
+    }
+  for (uint32_t b = 0; b < PHILOX_BUFFER_BLOCKS; ++b)
+    {
+      uint32_t *counter = &m_philox.m_buffer[4 * b];
+      counter[0] = static_cast<uint32_t> (firstBlock + b);
+      counter[1] = m_philox.m_counterHigh[0];
+      counter[2] = m_philox.m_counterHigh[1];
+      counter[3] = m_philox.m_counterHigh[2];
+      Philox4x32 (counter, m_philox.m_key);
+    }
+  m_philox.m_bufferStart = firstBlock << 2;
+}
+
+RngStream::RngStream (uint32_t seedNumber, uint64_t stream, uint64_t substream, Type type)
+  : m_type (type)
 {
   if (seedNumber >= m1 || seedNumber >= m2 || seedNumber == 0)
     {
       NS_FATAL_ERROR ("invalid Seed " << seedNumber);
     }
+  if (m_type == PHILOX)
+    {
+      m_philox.m_key[0] = seedNumber;
+      m_philox.m_key[1] = static_cast<uint32_t> (stream >> 32);
+      m_philox.m_counterHigh[0] = static_cast<uint32_t> (substream >> 32);
+      m_philox.m_counterHigh[1] = static_cast<uint32_t> (substream);
+      m_philox.m_counterHigh[2] = static_cast<uint32_t> (stream);
+      m_philox.m_next = 0;
+      m_philox.m_bufferStart = std::numeric_limits<uint64_t>::max ();
+      return;
+    }
   for (int i = 0; i < 6; ++i)
     {
       m_currentState[i] = seedNumber;
@@ -381,13 +507,72 @@ RngStream::RngStream (uint32_t seedNumber, uint64_t stream, uint64_t substream)
 }
 
 RngStream::RngStream(const RngStream& r)
+  : m_type (r.m_type)
 {
+  if (m_type == PHILOX)
+    {
+      m_philox = r.m_philox;
+      return;
+    }
   for (int i = 0; i < 6; ++i)
     {
       m_currentState[i] = r.m_currentState[i];
     }
 }
 
+void
+RngStream::GetState (uint32_t state[6]) const
+{
+  if (m_type == PHILOX)
+    {
+      state[0] = m_philox.m_key[0];
+      state[1] = m_philox.m_key[1];
+      state[2] = m_philox.m_counterHigh[0];
+      state[3] = m_philox.m_counterHigh[1];
+      state[4] = m_philox.m_counterHigh[2];
+      state[5] = static_cast<uint32_t> (m_philox.m_next);
+      return;
+    }
+  for (int i = 0; i < 6; ++i)
+    {
+      state[i] = static_cast<uint32_t> (m_currentState[i]);
+    }
+}
+
+void
+RngStream::SetState (const uint32_t state[6])
+{
+  if (m_type == PHILOX)
+    {
+      // every counter and key is valid
+      m_philox.m_key[0] = state[0];
+      m_philox.m_key[1] = state[1];
+      m_philox.m_counterHigh[0] = state[2];
+      m_philox.m_counterHigh[1] = state[3];
+      m_philox.m_counterHigh[2] = state[4];
+      m_philox.m_next = state[5];
+      m_philox.m_bufferStart = std::numeric_limits<uint64_t>::max ();
+      return;
+    }
+  for (int i = 0; i < 3; ++i)
+    {
+      if (state[i] >= m1 || state[i + 3] >= m2)
+        {
+          NS_FATAL_ERROR ("invalid RngStream state");
+        }
+    }
+  for (int i = 0; i < 6; ++i)
+    {
+      m_currentState[i] = state[i];
+    }
+}
+
+RngStream::Type
+RngStream::GetType (void) const
+{
+  return m_type;
+}
+
 void 
 RngStream::AdvanceNthBy (uint64_t nth, int by, double state[6])
 {
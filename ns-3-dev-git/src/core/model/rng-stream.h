@@ -38,25 +38,47 @@ namespace ns3 {
 /**
  * \ingroup rngimpl
  *
- * \brief Combined Multiple-Recursive Generator MRG32k3a
+ * \brief Combined Multiple-Recursive Generator MRG32k3a, or the
+ * counter-based Philox4x32-10 generator
  *
  * This class is the combined multiple-recursive random number
  * generator called MRG32k3a.  The ns3::RandomVariableBase class
  * holds a static instance of this class.  The details of this
  * class are explained in:
  * http://www.iro.umontreal.ca/~lecuyer/myftp/papers/streams00.pdf
+ *
+ * Alternatively, the stream is generated by Philox4x32-10, see
+ * "Parallel random numbers: as easy as 1, 2, 3" (Salmon et al., SC'11).
+ * Philox is a keyed bijection of a counter: the key is derived from the
+ * seed and stream number and the counter from the run number and the
+ * index of the draw, so that a stream needs no jump-ahead to set up and
+ * any stream can be reproduced independently of all others, e.g. in
+ * parallel or distributed runs. Random numbers are generated in blocks
+ * of four, a few blocks at a time. A Philox stream provides 2^32 draws
+ * per run, and all 64 bits of the run number are used.
+ *
+ * The generator is selected per stream on construction, see the RngType
+ * global value of RngSeedManager.
  */
 class RngStream
 {
 public:
+  /** The generator behind a stream. */
+  enum Type
+  {
+    MRG32K3A, //!< Combined multiple-recursive generator, the default
+    PHILOX    //!< Philox4x32-10 counter-based generator
+  };
+
   /**
    * Construct from explicit seed, stream and substream values.
    *
    * \param [in] seed The starting seed.
    * \param [in] stream The stream number.
    * \param [in] substream The sub-stream number.
+   * \param [in] type The generator to use.
    */
-  RngStream (uint32_t seed, uint64_t stream, uint64_t substream);
+  RngStream (uint32_t seed, uint64_t stream, uint64_t substream, Type type = MRG32K3A);
   /**
    * Copy constructor.
    *
@@ -70,6 +92,49 @@ public:
    * \returns The next random.
    */
   double RandU01 (void);
+  /**
+   * Generate the next \p n random numbers for this stream.
+   *
+   * Gives the same numbers as \p n calls to RandU01 (void), but with
+   * Philox the blocks are generated in a loop the compiler can vectorize.
+   *
+   * \param [out] values The random numbers.
+   * \param [in] n The number of random numbers to generate.
+   */
+  void RandU01 (double *values, uint32_t n);
+
+  /**
+   * Get the current position of this stream.
+   *
+   * Every component of the MRG32k3a state is an integer smaller
+   * than 2^32, so the state can be stored without loss as six
+   * unsigned 32 bit integers. The Philox state is its key (two
+   * words), the run number (high word first) and the low word of
+   * the stream number, which make up the upper three words of the
+   * counter, and the index of the next draw.
+   *
+   * \param [out] state The six components of the state vector.
+   */
+  void GetState (uint32_t state[6]) const;
+  /**
+   * Move this stream to a position previously obtained with GetState().
+   *
+   * The state must have been obtained from a stream with the same type.
+   *
+   * \param [in] state The six components of the state vector.
+   */
+  void SetState (const uint32_t state[6]);
+
+  /** \returns The generator behind this stream. */
+  Type GetType (void) const;
+
+  /**
+   * Apply the Philox4x32-10 bijection.
+   *
+   * \param [in,out] counter The counter, replaced by the random block.
+   * \param [in] key The key.
+   */
+  static void Philox4x32 (uint32_t counter[4], const uint32_t key[2]);
 
 private:
   /**
@@ -81,8 +146,30 @@ private:
    */
   void AdvanceNthBy (uint64_t nth, int by, double state[6]);
 
-  /** The RNG state vector. */
-  double m_currentState[6];
+  /** Generate the Philox blocks that hold draw \p m_philox.m_next onwards. */
+  void FillPhiloxBuffer (void);
+
+  /** Number of Philox blocks generated at a time. */
+  static const uint32_t PHILOX_BUFFER_BLOCKS = 4;
+  /** Number of Philox blocks in a stream, so that the index of a draw fits in 32 bits. */
+  static const uint64_t PHILOX_MAX_BLOCKS = 1ULL << 30;
+
+  /** The generator behind this stream. */
+  Type m_type;
+  union
+  {
+    /** The RNG state vector. */
+    double m_currentState[6];
+    /** The Philox key, counter and a buffer of generated blocks. */
+    struct
+    {
+      uint32_t m_key[2];
+      uint32_t m_counterHigh[3]; //!< run number and low word of the stream number
+      uint64_t m_next;           //!< index of the next draw
+      uint64_t m_bufferStart;    //!< index of the first draw in m_buffer
+      uint32_t m_buffer[4 * PHILOX_BUFFER_BLOCKS];
+    } m_philox;
+  };
 };
 
 } // namespace ns3
@@ -25,6 +25,7 @@
 #include "ns3/double.h"
 #include "ns3/random-variable-stream.h"
 #include "ns3/rng-seed-manager.h"
+#include "ns3/rng-stream.h"
 
 using namespace ns3;
 
@@ -417,6 +418,106 @@ RngParetoTestCase::DoRun (void)
   NS_TEST_ASSERT_MSG_LT (sum, maxStatistic, "Chi-squared statistic out of range");
 }
 
+// ===========================================================================
+// Test case for the Philox counter-based generator
+// ===========================================================================
+class RngPhiloxTestCase : public TestCase
+{
+public:
+  static const uint32_t N_BINS = 50;
+  static const uint32_t N_MEASUREMENTS = 1000000;
+
+  RngPhiloxTestCase ();
+  virtual ~RngPhiloxTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+RngPhiloxTestCase::RngPhiloxTestCase ()
+  : TestCase ("Philox Random Number Generator")
+{
+}
+
+RngPhiloxTestCase::~RngPhiloxTestCase ()
+{
+}
+
+void
+RngPhiloxTestCase::DoRun (void)
+{
+  // Known answers of Philox4x32-10 (Random123)
+  uint32_t counter[4] = { 0, 0, 0, 0 };
+  uint32_t key[2] = { 0, 0 };
+  RngStream::Philox4x32 (counter, key);
+  NS_TEST_ASSERT_MSG_EQ (counter[0], 0x6627e8d5, "Wrong Philox block for zero counter and key");
+  NS_TEST_ASSERT_MSG_EQ (counter[3], 0x9b00dbd8, "Wrong Philox block for zero counter and key");
+
+  uint32_t counterPi[4] = { 0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344 };
+  uint32_t keyPi[2] = { 0xa4093822, 0x299f31d0 };
+  RngStream::Philox4x32 (counterPi, keyPi);
+  NS_TEST_ASSERT_MSG_EQ (counterPi[0], 0xd16cfe09, "Wrong Philox block for pi counter and key");
+  NS_TEST_ASSERT_MSG_EQ (counterPi[1], 0x94fdcceb, "Wrong Philox block for pi counter and key");
+  NS_TEST_ASSERT_MSG_EQ (counterPi[2], 0x5001e420, "Wrong Philox block for pi counter and key");
+  NS_TEST_ASSERT_MSG_EQ (counterPi[3], 0x24126ea1, "Wrong Philox block for pi counter and key");
+
+  // Batches and a restored state continue the same sequence
+  RngStream a (12, (1ULL << 63) + 5, 3, RngStream::PHILOX);
+  RngStream b (a);
+  uint32_t state[6];
+  double batch[103];
+  a.RandU01 ();
+  b.RandU01 ();
+  a.GetState (state);
+  a.RandU01 (batch, 103);
+  for (uint32_t i = 0; i < 103; ++i)
+    {
+      NS_TEST_ASSERT_MSG_EQ (batch[i], b.RandU01 (), "Batch differs from single draws at " << i);
+    }
+  RngStream c (1, 0, 0, RngStream::PHILOX);
+  c.SetState (state);
+  NS_TEST_ASSERT_MSG_EQ (c.RandU01 (), batch[0], "Restored stream does not continue the sequence");
+
+  // Streams and runs are independent sequences
+  RngStream otherStream (12, (1ULL << 63) + 6, 3, RngStream::PHILOX);
+  RngStream otherRun (12, (1ULL << 63) + 5, 4, RngStream::PHILOX);
+  RngStream first (12, (1ULL << 63) + 5, 3, RngStream::PHILOX);
+  const double u = first.RandU01 ();
+  NS_TEST_ASSERT_MSG_NE (otherStream.RandU01 (), u, "Different streams give the same numbers");
+  NS_TEST_ASSERT_MSG_NE (otherRun.RandU01 (), u, "Different runs give the same numbers");
+  // e.g. the link evaluator puts the run number into the upper half of the substream
+  RngStream highRun (12, (1ULL << 63) + 5, (1ULL << 32) + 3, RngStream::PHILOX);
+  RngStream otherHighRun (12, (1ULL << 63) + 5, (2ULL << 32) + 3, RngStream::PHILOX);
+  const double uHigh = highRun.RandU01 ();
+  NS_TEST_ASSERT_MSG_NE (uHigh, u, "Runs differing in the upper half of the run number give the same numbers");
+  NS_TEST_ASSERT_MSG_NE (otherHighRun.RandU01 (), uHigh, "Runs differing in the upper half of the run number give the same numbers");
+
+  // Uniformity through the global selection
+  RngSeedManager::SetRngType (RngStream::PHILOX);
+  Ptr<UniformRandomVariable> uniform = CreateObject<UniformRandomVariable> ();
+  uniform->SetStream (7);
+  RngSeedManager::SetRngType (RngStream::MRG32K3A);
+  RngStream reference (RngSeedManager::GetSeed (), (1ULL << 63) + 7, RngSeedManager::GetRun (), RngStream::PHILOX);
+  NS_TEST_ASSERT_MSG_EQ (uniform->GetValue (), reference.RandU01 (), "RngType not applied to new streams");
+
+  gsl_histogram * h = gsl_histogram_alloc (N_BINS);
+  gsl_histogram_set_ranges_uniform (h, 0., 1.);
+  for (uint32_t i = 0; i < N_MEASUREMENTS; ++i)
+    {
+      gsl_histogram_increment (h, uniform->GetValue ());
+    }
+  const double expected = ((double)N_MEASUREMENTS / (double)N_BINS);
+  double chiSquared = 0;
+  for (uint32_t i = 0; i < N_BINS; ++i)
+    {
+      const double d = gsl_histogram_get (h, i) - expected;
+      chiSquared += d * d / expected;
+    }
+  gsl_histogram_free (h);
+
+  NS_TEST_ASSERT_MSG_LT (chiSquared, gsl_cdf_chisq_Qinv (0.001, N_BINS), "Chi-squared statistic out of range");
+}
+
 class RngTestSuite : public TestSuite
 {
 public:
@@ -430,6 +531,7 @@ RngTestSuite::RngTestSuite ()
   AddTestCase (new RngNormalTestCase, TestCase::QUICK);
   AddTestCase (new RngExponentialTestCase, TestCase::QUICK);
   AddTestCase (new RngParetoTestCase, TestCase::QUICK);
+  AddTestCase (new RngPhiloxTestCase, TestCase::QUICK);
 }
 
 static RngTestSuite rngTestSuite;
@@ -23,6 +23,7 @@
 #include "ns3/heap-scheduler.h"
 #include "ns3/map-scheduler.h"
 #include "ns3/calendar-scheduler.h"
+#include "ns3/make-event.h"
 
 using namespace ns3;
 
@@ -459,6 +460,74 @@ SimulatorTemplateTestCase::DoRun (void)
   Simulator::Destroy ();
 }
 
+class SimulatorEventFunctionTestCase : public TestCase
+{
+public:
+  SimulatorEventFunctionTestCase ();
+private:
+  virtual void DoRun (void);
+
+  /** Event handlers to attribute events to. */
+  class Base
+  {
+  public:
+    virtual ~Base () {}
+    virtual void Handle (int) {}
+    void Other (void) {}
+  };
+  /** Overrides Base::Handle. */
+  class Derived : public Base
+  {
+  public:
+    virtual void Handle (int) {}
+  };
+
+  /**
+   * \param [in] event The event, released by this method.
+   * \returns The function of the event.
+   */
+  const void * GetFunction (EventImpl *event);
+};
+
+SimulatorEventFunctionTestCase::SimulatorEventFunctionTestCase ()
+  : TestCase ("Check that events know the function they invoke, for the event profiler")
+{
+}
+
+const void *
+SimulatorEventFunctionTestCase::GetFunction (EventImpl *event)
+{
+  const void *function = event->GetFunction ();
+  event->Unref ();
+  return function;
+}
+
+void
+SimulatorEventFunctionTestCase::DoRun (void)
+{
+  NS_TEST_ASSERT_MSG_EQ (GetFunction (MakeEvent (&foo1, 1)), (const void *)&foo1, "Wrong function of a function event");
+  NS_TEST_ASSERT_MSG_EQ (GetFunction (MakeEvent (&foo2, 1, 2)), (const void *)&foo2, "Wrong function of a function event");
+
+#if defined (__GNUC__) && !defined (__arm__) && !defined (__aarch64__)
+  Base base;
+  Derived derived;
+  Base *derivedAsBase = &derived;
+
+  const void *baseHandle = GetFunction (MakeEvent (&Base::Handle, &base, 1));
+  const void *derivedHandle = GetFunction (MakeEvent (&Base::Handle, derivedAsBase, 1));
+  NS_TEST_ASSERT_MSG_NE (baseHandle, (const void *)0, "Function of a virtual method event not known");
+  NS_TEST_ASSERT_MSG_NE (derivedHandle, baseHandle, "Virtual method event not attributed to the override");
+  NS_TEST_ASSERT_MSG_EQ (GetFunction (MakeEvent (&Derived::Handle, &derived, 2)), derivedHandle,
+                         "Same method should give the same function");
+
+  const void *other = GetFunction (MakeEvent (&Base::Other, &base));
+  NS_TEST_ASSERT_MSG_NE (other, (const void *)0, "Function of a method event not known");
+  NS_TEST_ASSERT_MSG_EQ (GetFunction (MakeEvent (&Base::Other, &derived)), other,
+                         "Same method should give the same function");
+  NS_TEST_ASSERT_MSG_NE (other, baseHandle, "Different methods should give different functions");
+#endif
+}
+
 class SimulatorTestSuite : public TestSuite
 {
 public:
@@ -475,5 +544,6 @@ public:
     AddTestCase (new SimulatorEventsTestCase (factory), TestCase::QUICK);
     factory.SetTypeId (CalendarScheduler::GetTypeId ());
     AddTestCase (new SimulatorEventsTestCase (factory), TestCase::QUICK);
+    AddTestCase (new SimulatorEventFunctionTestCase (), TestCase::QUICK);
   }
 } g_simulatorTestSuite;
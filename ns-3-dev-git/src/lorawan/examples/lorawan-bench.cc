@@ -0,0 +1,506 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+
+/*
+ * Scalability benchmark: sweeps the number of end devices, the number of
+ * gateways, the offered load (the period of the uplinks of every end device)
+ * and the spreading factor mix. Every combination is simulated in a process
+ * of its own, so that the peak RSS is that of the combination, and is printed
+ * as one JSON object per line (NDJSON) on stdout.
+ *
+ * Run e.g.:
+ *   ./waf --run "lorawan-bench --nEndDevices=1000,5000 --iat=600 --sfMix=uniform"
+ *   ./waf --run "lorawan-bench --baseline=src/lorawan/examples/lorawan-bench-baseline.ndjson"
+ *
+ * Reported per combination:
+ *   setupTime, wallTime   wall time of the topology setup and of Simulator::Run, in s
+ *   events, eventsPerSecond
+ *   peakRssKiB            peak resident set size
+ *   uplinks, received     uplinks sent by the end devices and received by the NS
+ *   eventsPerUplink
+ *   share*                share of the wall time of the events, by the module of the
+ *                         scheduled handler (sampled by the event profiler of the
+ *                         simulator, see EventProfilerSamplingPeriod). The time of a
+ *                         handler includes everything it calls, e.g. the channel
+ *                         work of a MAC state change that starts a transmission.
+ *
+ * With --baseline, every combination is compared with the line of the same
+ * combination in the baseline file. Events per uplink do not depend on the
+ * machine and are always compared; wall time and peak RSS only when the
+ * baseline was made with the same build profile. An increase beyond the
+ * tolerance is reported on stderr and makes the benchmark exit with 1. To
+ * update the baseline, redirect the output of a run without --baseline to the
+ * baseline file. lorawan-bench-baseline.ndjson is recorded with an optimized
+ * build, so that wall times compare against ./waf configure -d optimized.
+ */
+#include <ns3/core-module.h>
+#include <ns3/network-module.h>
+#include <ns3/mobility-module.h>
+#include <ns3/lorawan-module.h>
+#include <ns3/default-simulator-impl.h>
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("LoRaWANBench");
+
+#if defined (NS3_BUILD_PROFILE_DEBUG)
+static const char *g_build = "debug";
+#elif defined (NS3_BUILD_PROFILE_RELEASE)
+static const char *g_build = "release";
+#elif defined (NS3_BUILD_PROFILE_OPTIMIZED)
+static const char *g_build = "optimized";
+#else
+static const char *g_build = "unknown";
+#endif
+
+// Modules the wall time is attributed to, by a substring of the handler name
+static const char *g_shareNames[] = { "sharePhy", "shareMac", "shareChannel", "shareNs", "shareEndDevice" };
+static const char *g_shareHandlers[][3] = {
+  { "ns3::LoRaWANPhy::", 0, 0 },
+  { "ns3::LoRaWANMac::", 0, 0 },
+  { "SpectrumChannel::", 0, 0 },
+  { "ns3::LoRaWANNetworkServer::", "ns3::LoRaWANGatewayApplication::", "ns3::LoRaWANDownlinkScheduler::" },
+  { "ns3::LoRaWANEndDeviceApplication::", "ns3::LoRaWANTrafficGenerator::", "ns3::LoRaWANCompactEndDevice" },
+};
+static const uint32_t g_nShares = sizeof (g_shareNames) / sizeof (g_shareNames[0]);
+
+typedef std::map<std::string, std::string> BenchRecord;
+
+static void
+CountMessage (uint64_t* count, uint32_t devAddr, uint8_t msgType, Ptr<const Packet> packet)
+{
+  (*count)++;
+}
+
+static std::vector<std::string>
+SplitList (const std::string& list)
+{
+  std::vector<std::string> items;
+  std::istringstream iss (list);
+  std::string item;
+  while (std::getline (iss, item, ','))
+    {
+      if (!item.empty ())
+        {
+          items.push_back (item);
+        }
+    }
+  return items;
+}
+
+/*
+ * Parse a line of flat JSON as written by this benchmark: string and number
+ * values only, no commas or quotes inside strings
+ */
+static BenchRecord
+ParseRecord (const std::string& line)
+{
+  BenchRecord record;
+  std::string::size_type pos = 0;
+  while ((pos = line.find ('"', pos)) != std::string::npos)
+    {
+      const std::string::size_type keyEnd = line.find ('"', pos + 1);
+      const std::string::size_type colon = line.find (':', keyEnd);
+      if (keyEnd == std::string::npos || colon == std::string::npos)
+        {
+          break;
+        }
+      std::string::size_type valueEnd = line.find_first_of (",}", colon);
+      if (valueEnd == std::string::npos)
+        {
+          valueEnd = line.size ();
+        }
+
+      std::string value = line.substr (colon + 1, valueEnd - colon - 1);
+      if (value.size () >= 2 && value[0] == '"')
+        {
+          value = value.substr (1, value.size () - 2);
+        }
+      record[line.substr (pos + 1, keyEnd - pos - 1)] = value;
+      pos = valueEnd;
+    }
+  return record;
+}
+
+static std::string
+RecordKey (const BenchRecord& record)
+{
+  std::ostringstream oss;
+  const char *fields[] = { "nEndDevices", "nGateways", "iat", "sfMix", "duration" };
+  for (uint32_t i = 0; i < sizeof (fields) / sizeof (fields[0]); i++)
+    {
+      BenchRecord::const_iterator it = record.find (fields[i]);
+      oss << fields[i] << "=" << (it != record.end () ? it->second : "") << ";";
+    }
+  return oss.str ();
+}
+
+class LoRaWANBench
+{
+public:
+  LoRaWANBench ();
+
+  /*
+   * Simulate one combination, print its line and compare it with the baseline
+   * Returns 1 on a regression, 0 otherwise
+   */
+  int RunPoint (uint32_t nEndDevices, uint32_t nGateways, double iat, std::string sfMix);
+
+  bool LoadBaseline (std::string fileName);
+
+  double m_duration;
+  double m_discRadius;
+  double m_tolerance;
+  uint32_t m_samplingPeriod;
+
+private:
+  void Compare (const BenchRecord& baseline, const BenchRecord& record, std::string field, std::ostream& os, bool& regression);
+
+  std::map<std::string, BenchRecord> m_baseline;
+};
+
+LoRaWANBench::LoRaWANBench ()
+  : m_duration (1800.0),
+    m_discRadius (5000.0),
+    m_tolerance (0.25),
+    m_samplingPeriod (16)
+{
+}
+
+bool
+LoRaWANBench::LoadBaseline (std::string fileName)
+{
+  std::ifstream file (fileName.c_str ());
+  if (!file.is_open ())
+    {
+      return false;
+    }
+
+  std::string line;
+  while (std::getline (file, line))
+    {
+      const BenchRecord record = ParseRecord (line);
+      if (!record.empty ())
+        {
+          m_baseline[RecordKey (record)] = record;
+        }
+    }
+  return true;
+}
+
+void
+LoRaWANBench::Compare (const BenchRecord& baseline, const BenchRecord& record, std::string field, std::ostream& os, bool& regression)
+{
+  BenchRecord::const_iterator it = baseline.find (field);
+  if (it == baseline.end ())
+    {
+      return;
+    }
+
+  const double reference = std::atof (it->second.c_str ());
+  const double value = std::atof (record.find (field)->second.c_str ());
+  const double ratio = reference > 0.0 ? value / reference : 1.0;
+
+  os << ",\"" << field << "Ratio\":" << ratio;
+  if (ratio > 1.0 + m_tolerance)
+    {
+      std::cerr << "regression: " << RecordKey (record) << " " << field << " " << value
+                << " vs baseline " << reference << std::endl;
+      regression = true;
+    }
+}
+
+int
+LoRaWANBench::RunPoint (uint32_t nEndDevices, uint32_t nGateways, double iat, std::string sfMix)
+{
+  typedef std::chrono::steady_clock Clock;
+  const Clock::time_point setupStart = Clock::now ();
+
+  // The applications print their statistics on stdout, keep it for the results
+  std::streambuf* coutBuffer = std::cout.rdbuf (0);
+  std::ostream out (coutBuffer);
+
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (1);
+  Config::SetGlobal ("EventProfilerSamplingPeriod", UintegerValue (m_samplingPeriod));
+
+  NodeContainer endDeviceNodes;
+  NodeContainer gatewayNodes;
+  endDeviceNodes.Create (nEndDevices);
+  gatewayNodes.Create (nGateways);
+
+  MobilityHelper edMobility;
+  edMobility.SetPositionAllocator ("ns3::UniformDiscPositionAllocator",
+                                   "X", DoubleValue (0.0),
+                                   "Y", DoubleValue (0.0),
+                                   "rho", DoubleValue (m_discRadius));
+  edMobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  edMobility.Install (endDeviceNodes);
+  MobilityHelper gwMobility;
+  gwMobility.SetPositionAllocator ("ns3::UniformDiscPositionAllocator",
+                                   "X", DoubleValue (0.0),
+                                   "Y", DoubleValue (0.0),
+                                   "rho", DoubleValue (nGateways > 1 ? m_discRadius / 2 : 0.0));
+  gwMobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  gwMobility.Install (gatewayNodes);
+
+  LoRaWANHelper lorawanHelper;
+  lorawanHelper.SetNbRep (1);
+  lorawanHelper.Install (endDeviceNodes);
+  lorawanHelper.SetDeviceType (LORAWAN_DT_GATEWAY);
+  lorawanHelper.Install (gatewayNodes);
+
+  PacketSocketHelper packetSocket;
+  packetSocket.Install (endDeviceNodes);
+  packetSocket.Install (gatewayNodes);
+
+  std::ostringstream upstreamIAT, upstreamSend;
+  upstreamIAT << "ns3::ConstantRandomVariable[Constant=" << iat << "]";
+  upstreamSend << "ns3::UniformRandomVariable[Min=0.0|Max=" << iat << "]";
+
+  LoRaWANEndDeviceHelper enddevicehelper;
+  enddevicehelper.SetAttribute ("UpstreamIAT", StringValue (upstreamIAT.str ()));
+  enddevicehelper.SetAttribute ("UpstreamSend", StringValue (upstreamSend.str ()));
+  if (sfMix == "converged")
+    {
+      enddevicehelper.SetConvergedStart (true);
+      enddevicehelper.SetPropagationLossModel (lorawanHelper.GetPropagationLossModel ());
+    }
+  else if (sfMix.size () == 3 && sfMix.compare (0, 2, "dr") == 0 && sfMix[2] >= '0' && sfMix[2] <= '5')
+    {
+      enddevicehelper.SetAttribute ("DataRateIndex", UintegerValue (sfMix[2] - '0'));
+    }
+  else if (sfMix != "uniform")
+    {
+      NS_FATAL_ERROR ("Unknown SF mix " << sfMix << ", use dr0 .. dr5, uniform or converged");
+    }
+  ApplicationContainer enddeviceApps = enddevicehelper.Install (endDeviceNodes);
+  LoRaWANGatewayHelper gatewayhelper;
+  gatewayhelper.Install (gatewayNodes);
+
+  uint64_t uplinks = 0;
+  uint64_t received = 0;
+  for (uint32_t i = 0; i < enddeviceApps.GetN (); i++)
+    {
+      // an equal share of end devices on every data rate
+      if (sfMix == "uniform")
+        {
+          enddeviceApps.Get (i)->SetAttribute ("DataRateIndex", UintegerValue (i % 6));
+        }
+      enddeviceApps.Get (i)->TraceConnectWithoutContext ("USMsgTransmitted", MakeBoundCallback (&CountMessage, &uplinks));
+    }
+  LoRaWANNetworkServer::getLoRaWANNetworkServerPointer ()->TraceConnectWithoutContext ("USMsgReceived", MakeBoundCallback (&CountMessage, &received));
+
+  const Clock::time_point runStart = Clock::now ();
+  Simulator::Stop (Seconds (m_duration));
+  Simulator::Run ();
+  const Clock::time_point runEnd = Clock::now ();
+
+  DefaultSimulatorImpl::ProfileSummary handlers;
+  uint64_t events = 0;
+  Ptr<DefaultSimulatorImpl> impl = DynamicCast<DefaultSimulatorImpl> (Simulator::GetImplementation ());
+  if (impl)
+    {
+      events = impl->GetProfile (handlers);
+    }
+  else
+    {
+      NS_LOG_WARN ("Not running on the DefaultSimulatorImpl, no events and shares reported");
+    }
+
+  std::vector<double> shares (g_nShares + 1, 0.0);
+  double total = 0.0;
+  for (DefaultSimulatorImpl::ProfileSummary::const_iterator it = handlers.begin (); it != handlers.end (); ++it)
+    {
+      uint32_t share = g_nShares; // other
+      for (uint32_t i = 0; i < g_nShares && share == g_nShares; i++)
+        {
+          for (uint32_t k = 0; k < 3 && g_shareHandlers[i][k]; k++)
+            {
+              if (it->first.find (g_shareHandlers[i][k]) != std::string::npos)
+                {
+                  share = i;
+                }
+            }
+        }
+      shares[share] += it->second.second;
+      total += it->second.second;
+    }
+
+  struct rusage usage;
+  getrusage (RUSAGE_SELF, &usage);
+
+  const double setupTime = std::chrono::duration<double> (runStart - setupStart).count ();
+  const double wallTime = std::chrono::duration<double> (runEnd - runStart).count ();
+
+  std::ostringstream line;
+  line << "{\"bench\":\"lorawan\",\"build\":\"" << g_build << "\""
+       << ",\"nEndDevices\":" << nEndDevices
+       << ",\"nGateways\":" << nGateways
+       << ",\"iat\":" << iat
+       << ",\"sfMix\":\"" << sfMix << "\""
+       << ",\"duration\":" << m_duration
+       << ",\"offeredLoad\":" << nEndDevices / iat
+       << ",\"setupTime\":" << setupTime
+       << ",\"wallTime\":" << wallTime
+       << ",\"events\":" << events
+       << ",\"eventsPerSecond\":" << (wallTime > 0.0 ? events / wallTime : 0.0)
+       << ",\"peakRssKiB\":" << usage.ru_maxrss
+       << ",\"uplinks\":" << uplinks
+       << ",\"received\":" << received
+       << ",\"eventsPerUplink\":" << (uplinks > 0 ? (double)events / uplinks : 0.0);
+  for (uint32_t i = 0; i <= g_nShares; i++)
+    {
+      line << ",\"" << (i < g_nShares ? g_shareNames[i] : "shareOther") << "\":" << (total > 0.0 ? shares[i] / total : 0.0);
+    }
+
+  bool regression = false;
+  const BenchRecord record = ParseRecord (line.str () + "}");
+  std::map<std::string, BenchRecord>::const_iterator baseline = m_baseline.find (RecordKey (record));
+  if (baseline != m_baseline.end ())
+    {
+      Compare (baseline->second, record, "eventsPerUplink", line, regression);
+      BenchRecord::const_iterator build = baseline->second.find ("build");
+      if (build != baseline->second.end () && build->second == g_build)
+        {
+          Compare (baseline->second, record, "wallTime", line, regression);
+          Compare (baseline->second, record, "peakRssKiB", line, regression);
+        }
+      line << ",\"regression\":" << (regression ? "true" : "false");
+    }
+  else if (!m_baseline.empty ())
+    {
+      NS_LOG_WARN ("No baseline for " << RecordKey (record));
+    }
+  line << "}";
+  out << line.str () << std::endl;
+
+  LoRaWANNetworkServer::clearLoRaWANNetworkServerPointer ();
+  Simulator::Destroy ();
+  std::cout.rdbuf (coutBuffer);
+  std::cout.clear ();
+  return regression ? 1 : 0;
+}
+
+int main (int argc, char *argv[])
+{
+  std::string nEndDevicesList = "100,500";
+  std::string nGatewaysList = "1,2";
+  std::string iatList = "600,120";
+  std::string sfMixList = "dr5,uniform";
+  std::string baselineFile = "";
+  bool fork = true;
+  bool profileSummary = false;
+  LoRaWANBench bench;
+
+  CommandLine cmd;
+  cmd.AddValue ("nEndDevices", "Comma separated numbers of end devices", nEndDevicesList);
+  cmd.AddValue ("nGateways", "Comma separated numbers of gateways", nGatewaysList);
+  cmd.AddValue ("iat", "Comma separated periods of the uplinks of every end device, in seconds", iatList);
+  cmd.AddValue ("sfMix", "Comma separated SF mixes: dr0 .. dr5 for all end devices on one data rate, uniform for an equal share on every data rate, converged for the data rates ADR converges to", sfMixList);
+  cmd.AddValue ("duration", "Simulated time of every combination, in seconds", bench.m_duration);
+  cmd.AddValue ("discRadius", "Radius of the disc the end devices are placed in", bench.m_discRadius);
+  cmd.AddValue ("samplingPeriod", "One in this many events is timed to attribute the wall time", bench.m_samplingPeriod);
+  cmd.AddValue ("baseline", "NDJSON file with the results to compare with", baselineFile);
+  cmd.AddValue ("tolerance", "Relative increase over the baseline that is reported as a regression", bench.m_tolerance);
+  cmd.AddValue ("fork", "Simulate every combination in a process of its own (otherwise the peak RSS is that of the whole sweep)", fork);
+  cmd.AddValue ("profileSummary", "Print the summary of the event profiler of every combination on stderr", profileSummary);
+  cmd.Parse (argc, argv);
+
+  if (!baselineFile.empty () && !bench.LoadBaseline (baselineFile))
+    {
+      NS_FATAL_ERROR ("Can not read baseline " << baselineFile);
+    }
+
+  if (bench.m_samplingPeriod == 0)
+    {
+      NS_FATAL_ERROR ("The sampling period must be at least 1");
+    }
+
+  std::streambuf* clogBuffer = std::clog.rdbuf ();
+  if (!profileSummary)
+    {
+      std::clog.rdbuf (0);
+    }
+
+  int status = 0;
+  for (const std::string& nEndDevices : SplitList (nEndDevicesList))
+    for (const std::string& nGateways : SplitList (nGatewaysList))
+      for (const std::string& iat : SplitList (iatList))
+        for (const std::string& sfMix : SplitList (sfMixList))
+          {
+            const uint32_t ed = std::atoi (nEndDevices.c_str ());
+            const uint32_t gw = std::atoi (nGateways.c_str ());
+            const double period = std::atof (iat.c_str ());
+            if (ed == 0 || gw == 0 || period <= 0.0)
+              {
+                NS_FATAL_ERROR ("Invalid combination " << nEndDevices << " end devices, " << nGateways << " gateways, iat " << iat);
+              }
+
+            if (!fork)
+              {
+                status |= bench.RunPoint (ed, gw, period, sfMix);
+                continue;
+              }
+
+            std::cout.flush ();
+            std::cerr.flush ();
+            const pid_t pid = ::fork ();
+            if (pid == 0)
+              {
+                const int result = bench.RunPoint (ed, gw, period, sfMix);
+                std::cout.flush ();
+                std::cerr.flush ();
+                _exit (result);
+              }
+            if (pid < 0)
+              {
+                NS_FATAL_ERROR ("fork failed");
+              }
+
+            int childStatus;
+            waitpid (pid, &childStatus, 0);
+            if (!WIFEXITED (childStatus))
+              {
+                std::cerr << "combination " << ed << " end devices, " << gw << " gateways, iat " << period
+                          << ", " << sfMix << " did not finish" << std::endl;
+                status |= 2;
+              }
+            else
+              {
+                status |= WEXITSTATUS (childStatus);
+              }
+          }
+
+  std::clog.rdbuf (clogBuffer);
+  return status;
+}
@@ -0,0 +1,153 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+
+/*
+ * Memory-per-device benchmark for class A end devices.
+ *
+ * Builds nEndDevices end devices around a single gateway, either as regular
+ * end devices (Node, LoRaWANNetDevice, LoRaWANEndDeviceApplication, ...) or
+ * as a LoRaWANCompactEndDeviceFleet, and reports the growth of the resident
+ * set size per end device. Optionally the network is then simulated for
+ * simTime seconds.
+ *
+ * Run e.g.:
+ *   ./waf --run "lorawan-compact-enddevice-memory --nEndDevices=100000 --compact=1"
+ *   ./waf --run "lorawan-compact-enddevice-memory --nEndDevices=100000 --compact=0"
+ *
+ * The last line of the output is machine readable:
+ *   mode nEndDevices rssBeforeBytes rssAfterBytes bytesPerDevice setupSeconds
+ */
+#include <ns3/core-module.h>
+#include <ns3/network-module.h>
+#include <ns3/mobility-module.h>
+#include <ns3/lorawan-module.h>
+
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <unistd.h>
+
+using namespace ns3;
+
+static uint64_t g_nUplinks = 0;
+
+static void
+UplinkTransmitted (uint32_t devAddr, uint8_t msgType, Ptr<const Packet> packet)
+{
+  g_nUplinks++;
+}
+
+static uint64_t
+GetResidentSetSize (void)
+{
+  // second field of /proc/self/statm is the resident set size in pages
+  std::ifstream statm ("/proc/self/statm");
+  uint64_t size = 0;
+  uint64_t resident = 0;
+  statm >> size >> resident;
+  return resident * sysconf (_SC_PAGESIZE);
+}
+
+int main (int argc, char *argv[])
+{
+  uint32_t nEndDevices = 10000;
+  bool compact = true;
+  double simTime = 0.0;
+  double discRadius = 5000.0;
+
+  CommandLine cmd;
+  cmd.AddValue ("nEndDevices", "Number of end devices", nEndDevices);
+  cmd.AddValue ("compact", "Use a LoRaWANCompactEndDeviceFleet instead of regular end devices", compact);
+  cmd.AddValue ("simTime", "Number of seconds to simulate after building the network (0 to only build it)", simTime);
+  cmd.AddValue ("discRadius", "Radius of the disc the end devices are placed in", discRadius);
+  cmd.Parse (argc, argv);
+
+  // Build everything that does not scale with the number of end devices first
+  NodeContainer gatewayNodes;
+  gatewayNodes.Create (1);
+  MobilityHelper gwMobility;
+  gwMobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  gwMobility.Install (gatewayNodes);
+
+  LoRaWANHelper lorawanHelper;
+  lorawanHelper.SetNbRep (1);
+  lorawanHelper.SetDeviceType (LORAWAN_DT_GATEWAY);
+  lorawanHelper.Install (gatewayNodes);
+
+  PacketSocketHelper packetSocket;
+  packetSocket.Install (gatewayNodes);
+
+  LoRaWANGatewayHelper gatewayhelper;
+  ApplicationContainer gatewayApps = gatewayhelper.Install (gatewayNodes);
+
+  Ptr<UniformDiscPositionAllocator> positionAllocator = CreateObject<UniformDiscPositionAllocator> ();
+  positionAllocator->SetRho (discRadius);
+
+  const uint64_t rssBefore = GetResidentSetSize ();
+  const std::clock_t setupStart = std::clock ();
+
+  NodeContainer endDeviceNodes;
+  if (compact)
+    {
+      LoRaWANCompactEndDeviceHelper compactHelper;
+      compactHelper.SetChannel (lorawanHelper.GetChannel ());
+      compactHelper.SetPropagationLossModel (lorawanHelper.GetPropagationLossModel ());
+      Ptr<LoRaWANCompactEndDeviceFleet> fleet = compactHelper.Install (positionAllocator, nEndDevices);
+      fleet->TraceConnectWithoutContext ("USMsgTransmitted", MakeCallback (&UplinkTransmitted));
+    }
+  else
+    {
+      endDeviceNodes.Create (nEndDevices);
+      MobilityHelper edMobility;
+      edMobility.SetPositionAllocator (positionAllocator);
+      edMobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+      edMobility.Install (endDeviceNodes);
+
+      lorawanHelper.SetDeviceType (LORAWAN_DT_END_DEVICE_CLASS_A);
+      lorawanHelper.Install (endDeviceNodes);
+      packetSocket.Install (endDeviceNodes);
+
+      LoRaWANEndDeviceHelper enddevicehelper;
+      ApplicationContainer enddeviceApps = enddevicehelper.Install (endDeviceNodes);
+      for (ApplicationContainer::Iterator it = enddeviceApps.Begin (); it != enddeviceApps.End (); ++it)
+        {
+          (*it)->TraceConnectWithoutContext ("USMsgTransmitted", MakeCallback (&UplinkTransmitted));
+        }
+    }
+
+  const double setupSeconds = double (std::clock () - setupStart) / CLOCKS_PER_SEC;
+  const uint64_t rssAfter = GetResidentSetSize ();
+  const double bytesPerDevice = nEndDevices > 0 ? double (rssAfter - rssBefore) / nEndDevices : 0.0;
+
+  if (simTime > 0.0)
+    {
+      Simulator::Stop (Seconds (simTime));
+      Simulator::Run ();
+      std::cout << "Simulated " << simTime << "s, " << g_nUplinks << " uplinks transmitted" << std::endl;
+    }
+
+  LoRaWANNetworkServer::clearLoRaWANNetworkServerPointer ();
+  Simulator::Destroy ();
+
+  std::cout << "mode nEndDevices rssBeforeBytes rssAfterBytes bytesPerDevice setupSeconds" << std::endl;
+  std::cout << (compact ? "compact" : "regular") << " " << nEndDevices << " " << rssBefore << " "
+            << rssAfter << " " << bytesPerDevice << " " << setupSeconds << std::endl;
+  return 0;
+}
@@ -18,146 +18,251 @@
  * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
  */
 
-// This program produces a gnuplot file that plots the packet success rate
-// as a function of distance for the lorawan error model, assuming a default
-// LogDistance propagation loss model, the MATLAB exp2 error model, a
-// default transmit power of 0 dBm, and a default packet size of 20 bytes of
-// MACPayload.
-#include <ns3/test.h>
-#include <ns3/log.h>
-#include <ns3/callback.h>
-#include <ns3/packet.h>
-#include <ns3/simulator.h>
+// This program produces gnuplot files that plot the packet success rate (PSR)
+// as a function of distance for the lorawan error model, for all six
+// spreading factors and for one or more propagation loss models.
+//
+// The links are evaluated in batch by LoRaWANLinkEvaluator: the PSR curves
+// are calculated directly and, if nPackets > 0, nPackets packets are drawn
+// per link on all processors. For every loss model and spreading factor the
+// coverage, i.e. the largest distance with a PSR of at least minPsr, is
+// printed on a machine readable line:
+//   coverage <loss model> SF<sf> <distance>
+//
+// With --crossCheck=1 every crossCheckIncrement metres the same links are
+// also simulated through the event loop (end device MAC and PHY, spectrum
+// channel, gateway PHY and MAC) and both results are printed:
+//   crosscheck <loss model> SF<sf> <distance> <received event driven> <received batch> <expected>
+//
+// Run e.g.:
+//   ./waf --run "lorawan-error-distance-plot --lossModels=ns3::LogDistancePropagationLossModel,ns3::FriisPropagationLossModel"
+//   ./waf --run "lorawan-error-distance-plot --crossCheck=1"
+#include <ns3/core-module.h>
+#include <ns3/network-module.h>
+#include <ns3/mobility-module.h>
 #include <ns3/propagation-loss-model.h>
-#include <ns3/spectrum-value.h>
-#include <ns3/node.h>
-#include <ns3/net-device.h>
 #include <ns3/single-model-spectrum-channel.h>
-#include <ns3/multi-model-spectrum-channel.h>
-#include <ns3/mac16-address.h>
-#include <ns3/constant-position-mobility-model.h>
-#include <ns3/uinteger.h>
-#include <ns3/nstime.h>
-#include <ns3/abort.h>
-#include <ns3/command-line.h>
+#include <ns3/lorawan-module.h>
 #include <ns3/gnuplot.h>
 
+#include <ctime>
 #include <fstream>
 #include <iostream>
+#include <sstream>
 #include <string>
 #include <vector>
 
 using namespace ns3;
-using namespace std;
-
-static uint32_t g_received = 0;
 
 NS_LOG_COMPONENT_DEFINE ("LoRaWANErrorDistancePlot");
 
+static uint32_t g_received = 0;
+
 static void
 LoRaWANErrorDistanceCallback (LoRaWANDataIndicationParams params, Ptr<Packet> p)
 {
   g_received++;
 }
 
-int main (int argc, char *argv[])
+/*
+ * Send nPackets packets from an end device to a gateway at distance through
+ * the event loop and return the number of packets received by the gateway
+ */
+static uint32_t
+RunEventDriven (Ptr<PropagationLossModel> lossModel, double distance, uint8_t dataRateIndex, uint8_t codeRate,
+                uint8_t phyPayloadSize, uint8_t txPowerIndex, uint32_t nPackets)
 {
-  std::ostringstream os;
-  std::ofstream berfile ("lorawan-psr-distance.plt");
+  g_received = 0;
 
-  int minDistance = 1;
-  int maxDistance = 200;  // meters
-  int increment = 1;
-  int maxPackets = 1000;
-  int packetSize = 20;
-  double txPower = 0;
-  uint32_t channelIndex = 0;
+  Ptr<Node> n0 = CreateObject <Node> ();
+  Ptr<Node> n1 = CreateObject <Node> ();
+  Ptr<LoRaWANNetDevice> dev0 = CreateObject<LoRaWANNetDevice> (LORAWAN_DT_END_DEVICE_CLASS_A);
+  Ptr<LoRaWANNetDevice> devgw = CreateObject<LoRaWANNetDevice> (LORAWAN_DT_GATEWAY);
+  dev0->SetAddress (Ipv4Address (0x00000001));
 
-  CommandLine cmd;
+  Ptr<SingleModelSpectrumChannel> channel = CreateObject<SingleModelSpectrumChannel> ();
+  channel->AddPropagationLossModel (lossModel);
+  dev0->SetChannel (channel);
+  devgw->SetChannel (channel);
+  n0->AddDevice (dev0);
+  n1->AddDevice (devgw);
 
-  cmd.AddValue ("txPower", "transmit power (dBm)", txPower);
-  cmd.AddValue ("packetSize", "packet (MSDU) size (bytes)", packetSize);
-  cmd.AddValue ("channelIndex", "channel index", channelIndex);
+  Ptr<ConstantPositionMobilityModel> mob0 = CreateObject<ConstantPositionMobilityModel> ();
+  mob0->SetPosition (Vector (distance, 0, 0));
+  dev0->GetPhy ()->SetMobility (mob0);
+  Ptr<ConstantPositionMobilityModel> mob1 = CreateObject<ConstantPositionMobilityModel> ();
+  mob1->SetPosition (Vector (0, 0, 0));
+  for (auto &it : devgw->GetPhys ())
+    it->SetMobility (mob1);
+  for (auto &it : devgw->GetMacs ())
+    it->SetDataIndicationCallback (MakeCallback (&LoRaWANErrorDistanceCallback));
+
+  LoRaWANDataRequestParams params;
+  params.m_loraWANChannelIndex = 0;
+  params.m_loraWANDataRateIndex = dataRateIndex;
+  params.m_loraWANCodeRate = codeRate;
+  params.m_loraWANTxPowerIndex = txPowerIndex;
+  params.m_msgType = LORAWAN_UNCONFIRMED_DATA_UP;
+  params.m_requestHandle = 1;
+  params.m_numberOfTransmissions = 1;
+
+  // Leave room for the receive windows and the duty cycle off time
+  const uint8_t subBandIndex = LoRaWAN::m_supportedChannels [0].m_subBandIndex;
+  Ptr<LoRaWANMac::LoRaWANMacRDC> macRDC = CreateObject<LoRaWANMac::LoRaWANMacRDC> ();
+  const Time airTime = LoRaWANPhy::CalculateTxTime (phyPayloadSize, 0, dataRateIndex, codeRate, 8, true);
+  const Time interval = airTime * macRDC->GetDutyCycleLimitForSubBand (subBandIndex) + Seconds (4);
+
+  // The MAC adds a 1B MAC header and a 4B MIC to the MAC payload
+  for (uint32_t i = 0; i < nPackets; i++)
+    Simulator::Schedule (interval * i, &LoRaWANMac::sendMACPayloadRequest, dev0->GetMac (), params, Create<Packet> (phyPayloadSize - 5));
+
+  Simulator::Run ();
+  Simulator::Destroy ();
+  return g_received;
+}
+
+static std::string
+GetShortName (std::string typeName)
+{
+  // e.g. ns3::LogDistancePropagationLossModel -> LogDistance
+  std::string::size_type pos = typeName.rfind (':');
+  std::string name = pos == std::string::npos ? typeName : typeName.substr (pos + 1);
+  pos = name.find ("PropagationLossModel");
+  if (pos != std::string::npos)
+    name = name.substr (0, pos);
+  return name;
+}
 
+int main (int argc, char *argv[])
+{
+  double minDistance = 100;
+  double maxDistance = 15000;  // meters
+  double increment = 10;
+  uint32_t nPackets = 1000;
+  uint32_t phyPayloadSize = 25;
+  uint32_t codeRate = 1;
+  uint32_t txPowerIndex = 0;
+  double minPsr = 0.9;
+  std::string lossModels = "ns3::LogDistancePropagationLossModel,ns3::ThreeLogDistancePropagationLossModel,ns3::FriisPropagationLossModel";
+  bool crossCheck = false;
+  double crossCheckIncrement = 1000;
+  uint32_t crossCheckPackets = 100;
+
+  CommandLine cmd;
+  cmd.AddValue ("minDistance", "smallest distance (m)", minDistance);
+  cmd.AddValue ("maxDistance", "largest distance (m)", maxDistance);
+  cmd.AddValue ("increment", "distance step (m)", increment);
+  cmd.AddValue ("nPackets", "packets drawn per link, 0 to only calculate the PSR", nPackets);
+  cmd.AddValue ("phyPayloadSize", "PHY payload size, i.e. MAC header, MAC payload and MIC (bytes)", phyPayloadSize);
+  cmd.AddValue ("codeRate", "code rate: 1 for 4/5 or 3 for 4/7", codeRate);
+  cmd.AddValue ("txPowerIndex", "TX power index, the TX power is 14 dBm - 2 * txPowerIndex", txPowerIndex);
+  cmd.AddValue ("minPsr", "PSR that defines the coverage", minPsr);
+  cmd.AddValue ("lossModels", "comma separated list of propagation loss models", lossModels);
+  cmd.AddValue ("crossCheck", "also simulate the links through the event loop", crossCheck);
+  cmd.AddValue ("crossCheckIncrement", "distance step of the cross check (m)", crossCheckIncrement);
+  cmd.AddValue ("crossCheckPackets", "packets per link in the cross check", crossCheckPackets);
   cmd.Parse (argc, argv);
 
-  if (channelIndex >= LoRaWAN::m_supportedChannels.size())
-    NS_LOG_ERROR("Invalid channel index, supported channels vector size = " << LoRaWAN::m_supportedChannels.size());
+  NS_ABORT_MSG_IF (codeRate != 1 && codeRate != 3, "Only code rates 1 and 3 are supported by the error model");
+  NS_ABORT_MSG_IF (phyPayloadSize < 5 || phyPayloadSize > 255, "Invalid PHY payload size");
+  NS_ABORT_MSG_IF (increment <= 0 || crossCheckIncrement <= 0, "Invalid distance step");
 
-  LoRaWANChannel lorawanChannel = LoRaWAN::m_supportedChannels [channelIndex];
-  os << "Packet (MSDU) size = " << packetSize << " bytes; tx power = " << txPower << " dBm; channelIndex = " << channelIndex;
+  const uint8_t subBandIndex = LoRaWAN::m_supportedChannels [0].m_subBandIndex;
+  Ptr<LoRaWANMac::LoRaWANMacRDC> macRDC = CreateObject<LoRaWANMac::LoRaWANMacRDC> ();
+  const double txPower = macRDC->GetMaxPowerForSubBand (subBandIndex) - 2.0 * txPowerIndex;
 
-  Gnuplot psrplot = Gnuplot ("lorawan-distance.eps");
-  Gnuplot2dDataset psrdataset ("lorawan-psr-vs-distance");
+  std::vector<std::string> lossModelNames;
+  std::istringstream lossModelList (lossModels);
+  std::string lossModelName;
+  while (std::getline (lossModelList, lossModelName, ','))
+    lossModelNames.push_back (lossModelName);
 
-  Ptr<Node> n0 = CreateObject <Node> ();
-  Ptr<Node> n1 = CreateObject <Node> ();
-  Ptr<LoRaWANNetDevice> dev0 = CreateObject<LoRaWANNetDevice> ();
-  Ptr<LoRaWANNetDevice> dev1 = CreateObject<LoRaWANNetDevice> ();
-  //dev0->SetAddress (Mac16Address ("00:01"));
-  //dev1->SetAddress (Mac16Address ("00:02"));
-  Ptr<MultiModelSpectrumChannel> channel = CreateObject<MultiModelSpectrumChannel> ();
-  Ptr<LogDistancePropagationLossModel> model = CreateObject<LogDistancePropagationLossModel> ();
-  channel->AddPropagationLossModel (model);
-  dev0->SetChannel (channel);
-  dev1->SetChannel (channel);
-  n0->AddDevice (dev0);
-  n1->AddDevice (dev1);
-  Ptr<ConstantPositionMobilityModel> mob0 = CreateObject<ConstantPositionMobilityModel> ();
-  dev0->GetPhy ()->SetMobility (mob0);
-  Ptr<ConstantPositionMobilityModel> mob1 = CreateObject<ConstantPositionMobilityModel> ();
-  dev1->GetPhy ()->SetMobility (mob1);
-
-  LoRaWANSpectrumValueHelper svh;
-  Ptr<SpectrumValue> psd = svh.CreateTxPowerSpectralDensity (txPower, lorawanChannel.m_fc);
-  dev0->GetPhy ()->SetTxPowerSpectralDensity (psd);
-
-  McpsDataIndicationCallback cb0;
-  cb0 = MakeCallback (&LoRaWANErrorDistanceCallback);
-  dev1->GetMac ()->SetDataIndicationCallback (cb0);
-
-  McpsDataRequestParams params;
-  params.m_srcAddrMode = SHORT_ADDR;
-  params.m_dstAddrMode = SHORT_ADDR;
-  params.m_dstPanId = 0;
-  params.m_dstAddr = Mac16Address ("00:02");
-  params.m_msduHandle = 0;
-  params.m_txOptions = 0;
-
-  Ptr<Packet> p;
-  mob0->SetPosition (Vector (0,0,0));
-  mob1->SetPosition (Vector (minDistance,0,0));
-  for (int j = minDistance; j < maxDistance;  )
+  std::vector<double> distances;
+  for (double d = minDistance; d <= maxDistance; d += increment)
+    distances.push_back (d);
+
+  Ptr<LoRaWANLinkEvaluator> evaluator = CreateObject<LoRaWANLinkEvaluator> ();
+  for (const auto& name : lossModelNames)
     {
-      for (int i = 0; i < maxPackets; i++)
+      ObjectFactory factory;
+      factory.SetTypeId (name);
+      Ptr<PropagationLossModel> lossModel = factory.Create<PropagationLossModel> ();
+      evaluator->SetPropagationLossModel (lossModel);
+
+      // All six spreading factors in one batch
+      LoRaWANLinkBatch batch;
+      for (uint8_t dr = 0; dr <= 5; dr++)
+        for (const auto& d : distances)
+          batch.Add (d, dr, codeRate, phyPayloadSize, txPower);
+
+      const std::clock_t start = std::clock ();
+      if (nPackets > 0)
+        evaluator->Simulate (batch, nPackets);
+      else
+        evaluator->Evaluate (batch);
+      const double seconds = double (std::clock () - start) / CLOCKS_PER_SEC;
+      NS_LOG_UNCOND (name << ": " << batch.GetN () << " links, " << nPackets << " packets per link in " << seconds << "s CPU time");
+
+      std::ostringstream title;
+      title << GetShortName (name) << ", PHY payload = " << phyPayloadSize << " bytes; tx power = " << txPower << " dBm; code rate = 4/" << (codeRate + 4);
+      Gnuplot psrplot = Gnuplot ("lorawan-psr-distance-" + GetShortName (name) + ".eps");
+      psrplot.SetTitle (title.str ());
+      psrplot.SetTerminal ("postscript eps color enh \"Times-BoldItalic\"");
+      psrplot.SetLegend ("distance (m)", "Packet Success Rate (PSR)");
+      std::ostringstream extra;
+      extra << "set xrange [" << minDistance << ":" << maxDistance << "]\nset yrange [0:1]\nset grid";
+      psrplot.SetExtra (extra.str ());
+
+      for (uint8_t dr = 0; dr <= 5; dr++)
         {
-          p = Create<Packet> (packetSize);
-          Simulator::Schedule (Seconds (i),
-                               &LoRaWANMac::McpsDataRequest,
-                               dev0->GetMac (), params, p);
+          const uint32_t sf = LoRaWAN::m_supportedDataRates [dr].spreadingFactor;
+          std::ostringstream label;
+          label << "SF" << sf;
+          Gnuplot2dDataset psrdataset (label.str ());
+          psrdataset.SetStyle (Gnuplot2dDataset::LINES);
+          Gnuplot2dDataset mcdataset (label.str () + " (" + std::to_string (nPackets) + " packets)");
+          mcdataset.SetStyle (Gnuplot2dDataset::POINTS);
+
+          double coverage = 0.0;
+          for (uint32_t j = 0; j < distances.size (); j++)
+            {
+              const uint32_t i = dr * distances.size () + j;
+              psrdataset.Add (batch.m_distance[i], batch.m_successProbability[i]);
+              if (nPackets > 0)
+                mcdataset.Add (batch.m_distance[i], double (batch.m_nReceived[i]) / nPackets);
+              if (batch.m_successProbability[i] >= minPsr)
+                coverage = batch.m_distance[i];
+            }
+          psrplot.AddDataset (psrdataset);
+          if (nPackets > 0)
+            psrplot.AddDataset (mcdataset);
+          std::cout << "coverage " << name << " SF" << sf << " " << coverage << std::endl;
         }
-      Simulator::Run ();
-      NS_LOG_DEBUG ("Received " << g_received << " packets for distance " << j);
-      psrdataset.Add (j, g_received / 1000.0);
-      g_received = 0;
-      j += increment;
-      mob1->SetPosition (Vector (j,0,0));
-    }
 
-  psrplot.AddDataset (psrdataset);
+      std::ofstream psrfile ("lorawan-psr-distance-" + GetShortName (name) + ".plt");
+      psrplot.GenerateOutput (psrfile);
+      psrfile.close ();
 
-  psrplot.SetTitle (os.str ());
-  psrplot.SetTerminal ("postscript eps color enh \"Times-BoldItalic\"");
-  psrplot.SetLegend ("distance (m)", "Packet Success Rate (PSR)");
-  psrplot.SetExtra  ("set xrange [0:200]\n\
-set yrange [0:1]\n\
-set grid\n\
-set style line 1 linewidth 5\n\
-set style increment user");
-  psrplot.GenerateOutput (berfile);
-  berfile.close ();
+      if (!crossCheck)
+        continue;
+
+      // The same links through the event loop, every crossCheckIncrement metres
+      LoRaWANLinkBatch crossCheckBatch;
+      for (uint8_t dr = 0; dr <= 5; dr++)
+        for (double d = minDistance; d <= maxDistance; d += crossCheckIncrement)
+          crossCheckBatch.Add (d, dr, codeRate, phyPayloadSize, txPower);
+      evaluator->Simulate (crossCheckBatch, crossCheckPackets);
+
+      const std::clock_t crossCheckStart = std::clock ();
+      for (uint32_t i = 0; i < crossCheckBatch.GetN (); i++)
+        {
+          const uint8_t dr = crossCheckBatch.m_dataRateIndex[i];
+          const uint32_t received = RunEventDriven (lossModel, crossCheckBatch.m_distance[i], dr, codeRate, phyPayloadSize, txPowerIndex, crossCheckPackets);
+          std::cout << "crosscheck " << name << " SF" << (uint32_t)LoRaWAN::m_supportedDataRates [dr].spreadingFactor << " " << crossCheckBatch.m_distance[i]
+                    << " " << received << " " << crossCheckBatch.m_nReceived[i] << " " << crossCheckPackets * crossCheckBatch.m_successProbability[i] << std::endl;
+        }
+      NS_LOG_UNCOND (name << ": event driven cross check of " << crossCheckBatch.GetN () << " links in " << double (std::clock () - crossCheckStart) / CLOCKS_PER_SEC << "s CPU time");
+    }
 
-  Simulator::Destroy ();
   return 0;
 }
-
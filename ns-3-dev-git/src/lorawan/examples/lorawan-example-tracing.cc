@@ -46,6 +46,7 @@
 #include <ns3/spectrum-value.h>
 #include <ns3/spectrum-model.h>
 
+#include <ns3/lorawan-visual-trace-helper.h>
 #include <ns3/netanim-module.h>
 
 #include <iostream>
@@ -140,6 +141,8 @@ public:
   void SelectDRCalculationMethod (LoRaWANDataRateCalcMethodIndex loRaWANDataRateCalcMethodIndex);
   void SetDRCalcPerLimit (double drCalcPerLimit);
   void SetDrCalcFixedDrIndex (uint8_t fixedDataRateIndex);
+  void SetVisualTrace (std::string visualTraceFileName, bool binary, double binWidth, uint32_t packetSampling);
+  void SetNetAnim (bool netAnim);
 
   void WriteMiscStatsToFile ();
 private:
@@ -176,6 +179,12 @@ private:
 
   std::string m_nodesCSVFileName;
 
+  std::string m_visualTraceFileName; // <! Empty for no visual trace
+  bool m_visualTraceBinary;
+  double m_visualTraceBinWidth;
+  uint32_t m_visualTracePacketSampling;
+  bool m_netAnim;
+
   uint32_t m_nrRW1Sent;
   uint32_t m_nrRW2Sent;
   uint32_t m_nrRW1Missed;
@@ -235,6 +244,11 @@ int main (int argc, char *argv[])
   bool traceEdMsgs = false;
   bool traceNsDsMsgs = false;
   bool traceMisc = false;
+  bool visualTrace = true;
+  bool visualTraceBinary = false;
+  double visualTraceBinWidth = 60.0;
+  uint32_t visualTracePacketSampling = 0;
+  bool netAnim = false;
   std::string outputFileNamePrefix = "output/LoRaWAN-example-tracing";
 
   CommandLine cmd;
@@ -265,6 +279,11 @@ int main (int argc, char *argv[])
   cmd.AddValue ("traceEDMsgs", "Trace messages on end devices[Default:0]", traceEdMsgs);
   cmd.AddValue ("traceNSDSMsgs", "Trace NS downstream messages[Default:0]", traceNsDsMsgs);
   cmd.AddValue ("traceMisc", "Trace miscellanous stats[Default:0]", traceMisc);
+  cmd.AddValue ("visualTrace", "Write the aggregated visual trace of the network[Default:1]", visualTrace);
+  cmd.AddValue ("visualTraceBinary", "Write the visual trace in the binary format instead of NDJSON[Default:0]", visualTraceBinary);
+  cmd.AddValue ("visualTraceBinWidth", "Width of the time bins of the visual trace in Seconds[Default:60]", visualTraceBinWidth);
+  cmd.AddValue ("visualTracePacketSampling", "Add the transmission and receptions of one in every n uplinks to the visual trace, 0 for none[Default:0]", visualTracePacketSampling);
+  cmd.AddValue ("netAnim", "Write a NetAnim XML trace with packet metadata, slow for large networks[Default:0]", netAnim);
   cmd.AddValue ("outputFileNamePrefix", "The prefix for the names of the output files[Default:output/LoRaWAN-example-tracing]", outputFileNamePrefix);
   //cmd.AddValue ("phyMode", "Wifi Phy mode[Default:DsssRate11Mbps]", phyMode);
   //cmd.AddValue ("rate", "CBR traffic rate[Default:8kbps]", rate);
@@ -481,6 +500,10 @@ int main (int argc, char *argv[])
     example.SelectDRCalculationMethod (loRaWANDataRateCalcMethodIndex);
     example.SetDRCalcPerLimit (drCalcPerLimit);
     example.SetDrCalcFixedDrIndex (drCalcFixedDRIndex);
+    if (visualTrace)
+      example.SetVisualTrace (simRunFilesPrefix.str () + (visualTraceBinary ? "-visual.bin" : "-visual.ndjson"),
+                              visualTraceBinary, visualTraceBinWidth, visualTracePacketSampling);
+    example.SetNetAnim (netAnim);
     example.CaseRun (nEndDevices, nGateways, discRadius, totalTime,
         usPacketSize, usMaxBytes, usDataPeriod, usUnconfirmedDataNbRep, usConfirmedData,
         dsPacketSize, dsDataGenerate, dsDataExpMean, dsConfirmedData,
@@ -491,7 +514,7 @@ int main (int argc, char *argv[])
   return 0;
 }
 
-LoRaWANExampleTracing::LoRaWANExampleTracing () : m_nrRW1Sent(0), m_nrRW2Sent(0), m_nrRW1Missed(0), m_nrRW2Missed(0) {}
+LoRaWANExampleTracing::LoRaWANExampleTracing () : m_visualTraceBinary(false), m_visualTraceBinWidth(60.0), m_visualTracePacketSampling(0), m_netAnim(false), m_nrRW1Sent(0), m_nrRW2Sent(0), m_nrRW1Missed(0), m_nrRW2Missed(0) {}
 
 void
 LoRaWANExampleTracing::CaseRun (uint32_t nEndDevices, uint32_t nGateways, double discRadius, double totalTime,
@@ -541,29 +564,46 @@ LoRaWANExampleTracing::CaseRun (uint32_t nEndDevices, uint32_t nGateways, double
 
   Simulator::Stop (Seconds (m_totalTime));
 
-  // netamin:
-  AnimationInterface anim ("lorawan-netamin.xml");
-  // stationary nodes: "You should assign the ConstantPositionMobilityModel. Constant Position is a kind of mobility."
-  //for (NodeContainer::Iterator i = m_allNodes.Begin (); i != m_allNodes.End (); ++i)
-  //{
-  //  Ptr<Node> node = *i;
-  //  //Ptr<LoRaWANNetDevice> netDevice = DynamicCast<LoRaWANNetDevice> (node->GetDevice (0));
-  //  Ptr<MobilityModel> nodeMobility = node->GetObject<MobilityModel> ();
-  //  NS_ASSERT (nodeMobility);
-  //  Vector position = nodeMobility->GetPosition ();
-
-  //  anim.SetConstantPosition (node, position.x, position.y);
-  //}
-  anim.EnablePacketMetadata (true);
+  LoRaWANVisualTraceHelper visualTrace;
+  if (!m_visualTraceFileName.empty ()) {
+    visualTrace.SetBinWidth (Seconds (m_visualTraceBinWidth));
+    visualTrace.SetPacketSampling (m_visualTracePacketSampling);
+    if (visualTrace.Open (m_visualTraceFileName, m_visualTraceBinary ? LoRaWANVisualTraceHelper::BINARY : LoRaWANVisualTraceHelper::NDJSON))
+      visualTrace.Install (m_endDeviceNodes, m_gatewayNodes);
+  }
+
+  // netanim writes every packet on every PHY, so it is only enabled on request
+  AnimationInterface* anim = 0;
+  if (m_netAnim) {
+    anim = new AnimationInterface ("lorawan-netamin.xml");
+    anim->EnablePacketMetadata (true);
+  }
 
   Simulator::Run ();
 
   if (traceMisc) // write after simulation has ended
     WriteMiscStatsToFile ();
 
+  visualTrace.Close ();
+  delete anim;
   Simulator::Destroy ();
 }
 
+void
+LoRaWANExampleTracing::SetVisualTrace (std::string visualTraceFileName, bool binary, double binWidth, uint32_t packetSampling)
+{
+  m_visualTraceFileName = visualTraceFileName;
+  m_visualTraceBinary = binary;
+  m_visualTraceBinWidth = binWidth;
+  m_visualTracePacketSampling = packetSampling;
+}
+
+void
+LoRaWANExampleTracing::SetNetAnim (bool netAnim)
+{
+  m_netAnim = netAnim;
+}
+
 void
 LoRaWANExampleTracing::CreateNodes ()
 {
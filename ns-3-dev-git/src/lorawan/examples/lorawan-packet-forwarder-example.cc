@@ -0,0 +1,142 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+
+/*
+ * Forward the uplinks of a simulated LoRaWAN network to an external network
+ * server with the Semtech UDP packet forwarder protocol, in real time.
+ *
+ * Every gateway gets a LoRaWANPacketForwarder with its node id as gateway
+ * EUI. Downlinks sent by the server in PULL_RESP datagrams are transmitted
+ * by the gateways. Start a network server (or any UDP listener, e.g.
+ * "nc -ul 1700") before running:
+ *
+ *   ./waf --run "lorawan-packet-forwarder-example --nEndDevices=1000 --iat=10"
+ */
+#include <ns3/core-module.h>
+#include <ns3/network-module.h>
+#include <ns3/mobility-module.h>
+#include <ns3/lorawan-module.h>
+
+#include <iostream>
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("LoRaWANPacketForwarderExample");
+
+static void
+CountPushData (uint64_t* datagrams, uint64_t* rxpk, uint32_t size)
+{
+  (*datagrams)++;
+  *rxpk += size;
+}
+
+int main (int argc, char *argv[])
+{
+  std::string serverAddress = "127.0.0.1";
+  uint32_t serverPort = 1700;
+  uint32_t nEndDevices = 100;
+  uint32_t nGateways = 1;
+  double iat = 60.0;
+  double duration = 60.0;
+  uint32_t maxBatchSize = 16;
+  double batchInterval = 0.01;
+
+  CommandLine cmd;
+  cmd.AddValue ("serverAddress", "IPv4 address of the network server", serverAddress);
+  cmd.AddValue ("serverPort", "UDP port of the network server", serverPort);
+  cmd.AddValue ("nEndDevices", "Number of end devices", nEndDevices);
+  cmd.AddValue ("nGateways", "Number of gateways", nGateways);
+  cmd.AddValue ("iat", "Inter-arrival time of the uplinks of an end device, in seconds", iat);
+  cmd.AddValue ("duration", "Duration of the simulation, in seconds", duration);
+  cmd.AddValue ("maxBatchSize", "Maximum number of rxpk in a PUSH_DATA datagram", maxBatchSize);
+  cmd.AddValue ("batchInterval", "Longest time an rxpk waits for a PUSH_DATA datagram, in seconds", batchInterval);
+  cmd.Parse (argc, argv);
+
+  GlobalValue::Bind ("SimulatorImplementationType", StringValue ("ns3::RealtimeSimulatorImpl"));
+  // the simulation may fall behind wall clock time at high uplink rates
+  Config::SetDefault ("ns3::RealtimeSimulatorImpl::SynchronizationMode", StringValue ("BestEffort"));
+
+  NodeContainer endDeviceNodes;
+  NodeContainer gatewayNodes;
+  endDeviceNodes.Create (nEndDevices);
+  gatewayNodes.Create (nGateways);
+
+  MobilityHelper edMobility;
+  edMobility.SetPositionAllocator ("ns3::UniformDiscPositionAllocator",
+                                   "X", DoubleValue (0.0),
+                                   "Y", DoubleValue (0.0),
+                                   "rho", DoubleValue (2000.0));
+  edMobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  edMobility.Install (endDeviceNodes);
+  MobilityHelper gwMobility;
+  gwMobility.SetPositionAllocator ("ns3::UniformDiscPositionAllocator",
+                                   "X", DoubleValue (0.0),
+                                   "Y", DoubleValue (0.0),
+                                   "rho", DoubleValue (nGateways > 1 ? 1000.0 : 0.0));
+  gwMobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  gwMobility.Install (gatewayNodes);
+
+  LoRaWANHelper lorawanHelper;
+  lorawanHelper.Install (endDeviceNodes);
+  lorawanHelper.SetDeviceType (LORAWAN_DT_GATEWAY);
+  lorawanHelper.Install (gatewayNodes);
+
+  PacketSocketHelper packetSocket;
+  packetSocket.Install (endDeviceNodes);
+  packetSocket.Install (gatewayNodes);
+
+  std::ostringstream upstreamIAT, upstreamSend;
+  upstreamIAT << "ns3::ConstantRandomVariable[Constant=" << iat << "]";
+  upstreamSend << "ns3::UniformRandomVariable[Min=0.0|Max=" << iat << "]";
+
+  LoRaWANEndDeviceHelper enddevicehelper;
+  enddevicehelper.SetAttribute ("UpstreamIAT", StringValue (upstreamIAT.str ()));
+  enddevicehelper.SetAttribute ("UpstreamSend", StringValue (upstreamSend.str ()));
+  enddevicehelper.Install (endDeviceNodes);
+  LoRaWANGatewayHelper gatewayhelper;
+  ApplicationContainer gatewayApps = gatewayhelper.Install (gatewayNodes);
+
+  uint64_t datagrams = 0;
+  uint64_t rxpk = 0;
+  std::vector<Ptr<LoRaWANPacketForwarder> > forwarders;
+  for (uint32_t i = 0; i < gatewayApps.GetN (); i++)
+    {
+      Ptr<LoRaWANPacketForwarder> forwarder = CreateObject<LoRaWANPacketForwarder> ();
+      forwarder->SetAttribute ("ServerAddress", Ipv4AddressValue (serverAddress.c_str ()));
+      forwarder->SetAttribute ("ServerPort", UintegerValue (serverPort));
+      forwarder->SetAttribute ("MaxBatchSize", UintegerValue (maxBatchSize));
+      forwarder->SetAttribute ("BatchInterval", TimeValue (Seconds (batchInterval)));
+      forwarder->TraceConnectWithoutContext ("PushData", MakeBoundCallback (&CountPushData, &datagrams, &rxpk));
+      if (!forwarder->Install (DynamicCast<LoRaWANGatewayApplication> (gatewayApps.Get (i))))
+        NS_FATAL_ERROR ("Unable to connect to the network server at " << serverAddress << ":" << serverPort);
+      forwarders.push_back (forwarder);
+    }
+
+  Simulator::Stop (Seconds (duration));
+  Simulator::Run ();
+
+  std::cout << "Forwarded " << rxpk << " uplinks in " << datagrams << " PUSH_DATA datagrams" << std::endl;
+
+  for (auto& forwarder : forwarders)
+    forwarder->Dispose ();
+  Simulator::Destroy ();
+  return 0;
+}
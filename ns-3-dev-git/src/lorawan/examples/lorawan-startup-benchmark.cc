@@ -0,0 +1,138 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+
+/*
+ * Startup time benchmark: builds the usual ADR topology (end devices on a
+ * disc around the gateways, packet sockets, end device applications, energy
+ * sources and radio energy models) and reports the time spent in every setup
+ * phase per end device, up to and including the first simulated event.
+ *
+ * Run e.g.:
+ *   ./waf --run "lorawan-startup-benchmark --nEndDevices=50000"
+ *
+ * Every phase is printed on its own machine readable line:
+ *   phase <name> <seconds> <microseconds per end device>
+ */
+#include <ns3/core-module.h>
+#include <ns3/network-module.h>
+#include <ns3/mobility-module.h>
+#include <ns3/energy-module.h>
+#include <ns3/lorawan-module.h>
+
+#include <ctime>
+#include <iostream>
+
+using namespace ns3;
+
+static std::clock_t g_phaseStart;
+static double g_total = 0.0;
+static uint32_t g_nEndDevices = 0;
+
+static void
+EndPhase (std::string name)
+{
+  const std::clock_t now = std::clock ();
+  const double seconds = double (now - g_phaseStart) / CLOCKS_PER_SEC;
+  g_total += seconds;
+  std::cout << "phase " << name << " " << seconds << " " << (seconds * 1e6 / g_nEndDevices) << std::endl;
+  g_phaseStart = std::clock ();
+}
+
+int main (int argc, char *argv[])
+{
+  uint32_t nEndDevices = 10000;
+  uint32_t nGateways = 1;
+  bool energy = true;
+  double discRadius = 5000.0;
+
+  CommandLine cmd;
+  cmd.AddValue ("nEndDevices", "Number of end devices", nEndDevices);
+  cmd.AddValue ("nGateways", "Number of gateways", nGateways);
+  cmd.AddValue ("energy", "Install energy sources and radio energy models on the end devices", energy);
+  cmd.AddValue ("discRadius", "Radius of the disc the end devices are placed in", discRadius);
+  cmd.Parse (argc, argv);
+
+  g_nEndDevices = nEndDevices > 0 ? nEndDevices : 1;
+  g_phaseStart = std::clock ();
+
+  NodeContainer endDeviceNodes;
+  NodeContainer gatewayNodes;
+  endDeviceNodes.Create (nEndDevices);
+  gatewayNodes.Create (nGateways);
+  EndPhase ("nodes");
+
+  MobilityHelper edMobility;
+  edMobility.SetPositionAllocator ("ns3::UniformDiscPositionAllocator",
+                                   "X", DoubleValue (0.0),
+                                   "Y", DoubleValue (0.0),
+                                   "rho", DoubleValue (discRadius));
+  edMobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  edMobility.Install (endDeviceNodes);
+  MobilityHelper gwMobility;
+  gwMobility.SetPositionAllocator ("ns3::UniformDiscPositionAllocator",
+                                   "X", DoubleValue (0.0),
+                                   "Y", DoubleValue (0.0),
+                                   "rho", DoubleValue (discRadius / 2));
+  gwMobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  gwMobility.Install (gatewayNodes);
+  EndPhase ("mobility");
+
+  LoRaWANHelper lorawanHelper;
+  lorawanHelper.SetNbRep (1);
+  NetDeviceContainer lorawanEDDevices = lorawanHelper.Install (endDeviceNodes);
+  lorawanHelper.SetDeviceType (LORAWAN_DT_GATEWAY);
+  lorawanHelper.Install (gatewayNodes);
+  EndPhase ("netdevices");
+
+  PacketSocketHelper packetSocket;
+  packetSocket.Install (endDeviceNodes);
+  packetSocket.Install (gatewayNodes);
+  EndPhase ("packetsockets");
+
+  if (energy)
+    {
+      BasicEnergySourceHelper sourceHelper;
+      sourceHelper.Set ("BasicEnergySourceInitialEnergyJ", DoubleValue (18000)); // = 5Wh
+      EnergySourceContainer energySources = sourceHelper.Install (endDeviceNodes);
+
+      LoRaWANRadioEnergyModelHelper radioHelper;
+      radioHelper.SetCurrentModel ("ns3::SX1272LoRaWANCurrentModel");
+      radioHelper.Install (lorawanEDDevices, energySources);
+      EndPhase ("energy");
+    }
+
+  LoRaWANEndDeviceHelper enddevicehelper;
+  ApplicationContainer enddeviceApps = enddevicehelper.Install (endDeviceNodes);
+  LoRaWANGatewayHelper gatewayhelper;
+  ApplicationContainer gatewayApps = gatewayhelper.Install (gatewayNodes);
+  EndPhase ("applications");
+
+  // Node and application initialization, and the population of the NS
+  // device table, happen when the simulation starts
+  Simulator::Stop (Seconds (0));
+  Simulator::Run ();
+  EndPhase ("initialize");
+
+  std::cout << "total " << g_total << " " << (g_total * 1e6 / g_nEndDevices) << std::endl;
+
+  LoRaWANNetworkServer::clearLoRaWANNetworkServerPointer ();
+  Simulator::Destroy ();
+  return 0;
+}
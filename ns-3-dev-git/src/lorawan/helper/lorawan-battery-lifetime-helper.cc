@@ -0,0 +1,266 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+
+#include "lorawan-battery-lifetime-helper.h"
+#include "ns3/log.h"
+#include "ns3/node.h"
+#include "ns3/simulator.h"
+#include "ns3/energy-source-container.h"
+#include "ns3/lorawan-net-device.h"
+#include "ns3/lorawan-mac.h"
+
+#include <cmath>
+#include <limits>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("LoRaWANBatteryLifetimeHelper");
+
+namespace {
+
+// two-sided 95% quantile of the normal distribution
+const double g_z95 = 1.96;
+
+const double g_secondsPerYear = 365.25 * 24 * 3600;
+
+Time
+GetTxResidency (Ptr<LoRaWANRadioEnergyModel> model)
+{
+  return model->GetStateResidency (LORAWAN_PHY_TX_ON) + model->GetStateResidency (LORAWAN_PHY_BUSY_TX);
+}
+
+Time
+GetRxResidency (Ptr<LoRaWANRadioEnergyModel> model)
+{
+  return model->GetStateResidency (LORAWAN_PHY_RX_ON) + model->GetStateResidency (LORAWAN_PHY_BUSY_RX);
+}
+
+} // unnamed namespace
+
+LoRaWANBatteryLifetimeHelper::LoRaWANBatteryLifetimeHelper (void)
+  : m_convergenceUplinks (20)
+{
+}
+
+void
+LoRaWANBatteryLifetimeHelper::SetConvergenceUplinks (uint32_t n)
+{
+  m_convergenceUplinks = n;
+}
+
+void
+LoRaWANBatteryLifetimeHelper::Install (NodeContainer endDevices)
+{
+  NS_LOG_FUNCTION (this);
+
+  for (NodeContainer::Iterator n = endDevices.Begin (); n != endDevices.End (); ++n) {
+    Ptr<LoRaWANEndDeviceApplication> app;
+    for (uint32_t a = 0; a < (*n)->GetNApplications () && !app; a++)
+      app = DynamicCast<LoRaWANEndDeviceApplication> ((*n)->GetApplication (a));
+
+    Ptr<LoRaWANRadioEnergyModel> energyModel;
+    Ptr<EnergySource> source;
+    Ptr<EnergySourceContainer> sources = (*n)->GetObject<EnergySourceContainer> ();
+    for (uint32_t s = 0; sources && s < sources->GetN () && !energyModel; s++) {
+      DeviceEnergyModelContainer models = sources->Get (s)->FindDeviceEnergyModels ("ns3::LoRaWANRadioEnergyModel");
+      if (models.GetN () > 0) {
+        energyModel = DynamicCast<LoRaWANRadioEnergyModel> (models.Get (0));
+        source = sources->Get (s);
+      }
+    }
+
+    Ptr<LoRaWANNetDevice> device;
+    for (uint32_t d = 0; d < (*n)->GetNDevices () && !device; d++)
+      device = DynamicCast<LoRaWANNetDevice> ((*n)->GetDevice (d));
+
+    if (!app || !energyModel || !device) {
+      NS_LOG_WARN ("Node " << (*n)->GetId () << " has no LoRaWAN end device application, radio energy model or net device, skipped");
+      continue;
+    }
+
+    m_sinks.push_back (DeviceSink ());
+    DeviceSink& sink = m_sinks.back ();
+    sink.m_node = *n;
+    sink.m_app = app;
+    sink.m_energyModel = energyModel;
+    sink.m_source = source;
+    sink.m_started = false;
+    sink.m_dataRate = 0;
+    sink.m_txPowerIndex = 0.0;
+    sink.m_lastEnergy = 0.0;
+    sink.StartWindow ();
+
+    app->TraceConnectWithoutContext ("USMsgTransmitted", MakeCallback (&DeviceSink::UplinkTransmitted, &sink));
+    app->TraceConnectWithoutContext ("DSMsgReceived", MakeCallback (&DeviceSink::DownlinkReceived, &sink));
+    device->GetMac ()->TraceConnectWithoutContext ("MacSentPkt", MakeCallback (&DeviceSink::SentPacket, &sink));
+  }
+}
+
+void
+LoRaWANBatteryLifetimeHelper::DeviceSink::StartWindow (void)
+{
+  m_windowStart = Simulator::Now ();
+  m_lastUplink = m_windowStart;
+  m_txStart = GetTxResidency (m_energyModel);
+  m_rxStart = GetRxResidency (m_energyModel);
+  m_txResidency = m_txStart;
+  m_rxResidency = m_rxStart;
+  m_cycles = 0;
+  m_sumT = 0.0;
+  m_sumE = 0.0;
+  m_sumTT = 0.0;
+  m_sumEE = 0.0;
+  m_sumTE = 0.0;
+  m_uplinks = 0;
+  m_transmissions = 0;
+  m_sentPackets = 0;
+  m_downlinks = 0;
+}
+
+void
+LoRaWANBatteryLifetimeHelper::DeviceSink::UplinkTransmitted (uint32_t address, uint8_t msgType, Ptr<const Packet> packet)
+{
+  const Time now = Simulator::Now ();
+  const double energy = m_energyModel->GetEnergyConsumptionNow ();
+  const uint32_t dataRate = m_app->GetDataRateIndex ();
+  const double txPowerIndex = m_app->GetTxPowerIndex ();
+
+  if (!m_started || dataRate != m_dataRate || txPowerIndex != m_txPowerIndex) {
+    NS_LOG_LOGIC ("node " << m_node->GetId () << " settings DR" << dataRate << " tx power index " << txPowerIndex
+                  << " from " << now.GetSeconds () << " s");
+    m_started = true;
+    m_dataRate = dataRate;
+    m_txPowerIndex = txPowerIndex;
+    StartWindow ();
+  } else {
+    // the cycle from the previous uplink to this one
+    const double t = (now - m_lastUplink).GetSeconds ();
+    const double e = energy - m_lastEnergy;
+    m_cycles++;
+    m_sumT += t;
+    m_sumE += e;
+    m_sumTT += t * t;
+    m_sumEE += e * e;
+    m_sumTE += t * e;
+  }
+
+  m_uplinks++;
+  m_lastUplink = now;
+  m_lastEnergy = energy;
+  m_txResidency = GetTxResidency (m_energyModel);
+  m_rxResidency = GetRxResidency (m_energyModel);
+}
+
+void
+LoRaWANBatteryLifetimeHelper::DeviceSink::SentPacket (Ptr<const Packet> packet, uint8_t transmissions)
+{
+  m_sentPackets++;
+  m_transmissions += transmissions;
+}
+
+void
+LoRaWANBatteryLifetimeHelper::DeviceSink::DownlinkReceived (uint32_t address, uint8_t msgType, Ptr<const Packet> packet, uint8_t window)
+{
+  m_downlinks++;
+}
+
+LoRaWANBatteryLifetimeHelper::Projection
+LoRaWANBatteryLifetimeHelper::Project (const DeviceSink& sink) const
+{
+  Projection p;
+  p.m_node = sink.m_node->GetId ();
+  p.m_converged = sink.m_started && sink.m_cycles >= m_convergenceUplinks;
+  p.m_dataRate = sink.m_dataRate;
+  p.m_txPowerIndex = sink.m_txPowerIndex;
+  p.m_windowStart = sink.m_windowStart;
+  p.m_cycles = sink.m_cycles;
+  p.m_retransmissionRate = sink.m_sentPackets > 0 ? double (sink.m_transmissions - sink.m_sentPackets) / sink.m_sentPackets : 0.0;
+  p.m_downlinkRate = sink.m_uplinks > 0 ? double (sink.m_downlinks) / sink.m_uplinks : 0.0;
+
+  const double window = (sink.m_lastUplink - sink.m_windowStart).GetSeconds ();
+  p.m_txFraction = window > 0 ? (sink.m_txResidency - sink.m_txStart).GetSeconds () / window : 0.0;
+  p.m_rxFraction = window > 0 ? (sink.m_rxResidency - sink.m_rxStart).GetSeconds () / window : 0.0;
+
+  // ratio estimator of the average power over the cycles, with the variance
+  // of the residuals of the cycle energies (delta method)
+  p.m_power = sink.m_sumT > 0 ? sink.m_sumE / sink.m_sumT : 0.0;
+  p.m_powerLow = p.m_power;
+  p.m_powerHigh = p.m_power;
+  if (sink.m_cycles >= 2) {
+    const double n = sink.m_cycles;
+    const double r = p.m_power;
+    const double residuals = std::max (0.0, sink.m_sumEE - 2 * r * sink.m_sumTE + r * r * sink.m_sumTT);
+    const double se = std::sqrt (residuals / (n - 1) / n) / (sink.m_sumT / n);
+    p.m_powerLow = r - g_z95 * se;
+    p.m_powerHigh = r + g_z95 * se;
+  }
+
+  const double now = Simulator::Now ().GetSeconds ();
+  const double infinity = std::numeric_limits<double>::infinity ();
+  p.m_remainingEnergy = sink.m_source->GetRemainingEnergy ();
+  p.m_lifetime = p.m_power > 0 ? now + p.m_remainingEnergy / p.m_power : infinity;
+  p.m_lifetimeLow = p.m_powerHigh > 0 ? now + p.m_remainingEnergy / p.m_powerHigh : infinity;
+  p.m_lifetimeHigh = p.m_powerLow > 0 ? now + p.m_remainingEnergy / p.m_powerLow : infinity;
+  return p;
+}
+
+std::vector<LoRaWANBatteryLifetimeHelper::Projection>
+LoRaWANBatteryLifetimeHelper::GetProjections (void) const
+{
+  std::vector<Projection> projections;
+  for (std::deque<DeviceSink>::const_iterator it = m_sinks.begin (); it != m_sinks.end (); ++it)
+    projections.push_back (Project (*it));
+  return projections;
+}
+
+LoRaWANBatteryLifetimeHelper::Projection
+LoRaWANBatteryLifetimeHelper::GetProjection (Ptr<Node> node) const
+{
+  for (std::deque<DeviceSink>::const_iterator it = m_sinks.begin (); it != m_sinks.end (); ++it) {
+    if (it->m_node == node)
+      return Project (*it);
+  }
+
+  Projection p = Projection ();
+  p.m_node = std::numeric_limits<uint32_t>::max ();
+  return p;
+}
+
+void
+LoRaWANBatteryLifetimeHelper::Print (std::ostream& os) const
+{
+  std::vector<Projection> projections = GetProjections ();
+  for (std::vector<Projection>::const_iterator p = projections.begin (); p != projections.end (); ++p) {
+    os << "Node " << p->m_node
+       << " DR" << p->m_dataRate << " TxPowerIndex " << p->m_txPowerIndex
+       << (p->m_converged ? " converged" : " not converged")
+       << " since " << p->m_windowStart.GetSeconds () << " s (" << p->m_cycles << " uplinks)"
+       << " retransmissions/uplink " << p->m_retransmissionRate
+       << " downlinks/uplink " << p->m_downlinkRate
+       << " tx " << p->m_txFraction * 100 << "% rx " << p->m_rxFraction * 100 << "%"
+       << " power " << p->m_power << " W [" << p->m_powerLow << ", " << p->m_powerHigh << "]"
+       << " remaining " << p->m_remainingEnergy << " J"
+       << " lifetime " << p->m_lifetime / g_secondsPerYear << " years ["
+       << p->m_lifetimeLow / g_secondsPerYear << ", " << p->m_lifetimeHigh / g_secondsPerYear << "]"
+       << std::endl;
+  }
+}
+
+} // namespace ns3
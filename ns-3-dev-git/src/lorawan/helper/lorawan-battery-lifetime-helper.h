@@ -0,0 +1,180 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+
+#ifndef LORAWAN_BATTERY_LIFETIME_HELPER_H
+#define LORAWAN_BATTERY_LIFETIME_HELPER_H
+
+#include <deque>
+#include <ostream>
+#include <vector>
+
+#include "ns3/node-container.h"
+#include "ns3/nstime.h"
+#include "ns3/packet.h"
+#include "ns3/energy-source.h"
+#include "ns3/lorawan-radio-energy-model.h"
+#include "ns3/lorawan-enddevice-application.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup lorawan
+ *
+ * \brief Project the battery lifetime of LoRaWAN end devices from a short run
+ *
+ * Simulating until the batteries of the end devices are depleted takes years
+ * of simulated time. Once the ADR settings (data rate and tx power) of an end
+ * device stop changing, its energy use is periodic, so this helper instead
+ * extrapolates the energy use observed since the last settings change.
+ *
+ * Every uplink of an end device closes a cycle; the energy of a cycle is
+ * read from the state-residency statistics of its LoRaWANRadioEnergyModel,
+ * so it is priced by the current model of the device (e.g.
+ * SX1272LoRaWANCurrentModel) and includes the extra transmissions and receive
+ * windows of retransmissions and downlinks. The average power of the radio is
+ * the ratio of the energy to the duration of the cycles observed at the
+ * current settings, with a 95% confidence interval from the variance of the
+ * cycles. The projected lifetime is the time at which the energy source of
+ * the end device would be depleted at that power:
+ *
+ *   lifetime = now + remaining energy / average power
+ *
+ * The energy source must be the one the LoRaWANRadioEnergyModel was
+ * installed on. Other consumers on the source, non-linear battery effects
+ * and energy harvesting are not projected.
+ *
+ * Typical use:
+ * \code
+ *   LoRaWANBatteryLifetimeHelper lifetime;
+ *   lifetime.Install (endDeviceNodes);
+ *   Simulator::Stop (Days (2));
+ *   Simulator::Run ();
+ *   lifetime.Print (std::cout);
+ * \endcode
+ */
+class LoRaWANBatteryLifetimeHelper
+{
+public:
+  /** The projected lifetime of an end device */
+  struct Projection
+  {
+    uint32_t m_node;
+    bool m_converged;        //!< the settings did not change for the last ConvergenceUplinks uplinks
+    uint32_t m_dataRate;
+    double m_txPowerIndex;
+    Time m_windowStart;      //!< uplink at which the current settings were first used
+    uint32_t m_cycles;       //!< uplink cycles observed at the current settings
+    double m_retransmissionRate; //!< extra transmissions per uplink at the current settings
+    double m_downlinkRate;   //!< downlinks per uplink at the current settings
+    double m_txFraction;     //!< fraction of the cycles spent transmitting
+    double m_rxFraction;     //!< fraction of the cycles spent listening or receiving
+    double m_power;          //!< average power of the radio (W)
+    double m_powerLow;       //!< lower bound of the 95% confidence interval of m_power (W)
+    double m_powerHigh;      //!< upper bound of the 95% confidence interval of m_power (W)
+    double m_remainingEnergy; //!< remaining energy of the source now (J)
+    double m_lifetime;       //!< projected simulation time at which the source is depleted (s)
+    double m_lifetimeLow;    //!< m_lifetime at m_powerHigh (s)
+    double m_lifetimeHigh;   //!< m_lifetime at m_powerLow (s), infinity if m_powerLow is not positive
+  };
+
+  LoRaWANBatteryLifetimeHelper (void);
+
+  /**
+   * \brief Set the number of uplinks at unchanged settings after which an end
+   * device is considered converged, 20 by default
+   */
+  void SetConvergenceUplinks (uint32_t n);
+
+  /**
+   * \brief Observe the given end devices
+   *
+   * Should be called after the LoRaWANRadioEnergyModel and the
+   * LoRaWANEndDeviceApplication of the end devices have been installed.
+   * End devices without either are skipped.
+   */
+  void Install (NodeContainer endDevices);
+
+  /**
+   * \returns the projection of every observed end device, at the current
+   * simulation time
+   */
+  std::vector<Projection> GetProjections (void) const;
+
+  /**
+   * \returns the projection of the end device on the given node, m_node is
+   * set to the maximum uint32_t value if the node is not observed
+   */
+  Projection GetProjection (Ptr<Node> node) const;
+
+  /**
+   * \brief Write the projection of every observed end device, one per line
+   */
+  void Print (std::ostream& os) const;
+
+private:
+  /** The observation of a single end device */
+  class DeviceSink
+  {
+  public:
+    void UplinkTransmitted (uint32_t address, uint8_t msgType, Ptr<const Packet> packet);
+    void SentPacket (Ptr<const Packet> packet, uint8_t transmissions);
+    void DownlinkReceived (uint32_t address, uint8_t msgType, Ptr<const Packet> packet, uint8_t window);
+    void StartWindow (void);
+
+    Ptr<Node> m_node;
+    Ptr<LoRaWANEndDeviceApplication> m_app;
+    Ptr<LoRaWANRadioEnergyModel> m_energyModel;
+    Ptr<EnergySource> m_source;
+
+    bool m_started;          //!< the first uplink was seen
+    uint32_t m_dataRate;
+    double m_txPowerIndex;
+
+    Time m_windowStart;
+    Time m_lastUplink;
+    double m_lastEnergy;     //!< energy consumption of the radio at m_lastUplink
+    Time m_txStart;          //!< residency at m_windowStart
+    Time m_rxStart;
+
+    // sums over the cycles of the window
+    uint32_t m_cycles;
+    double m_sumT;
+    double m_sumE;
+    double m_sumTT;
+    double m_sumEE;
+    double m_sumTE;
+    Time m_txResidency;      //!< residency at m_lastUplink
+    Time m_rxResidency;
+
+    uint32_t m_uplinks;
+    uint32_t m_transmissions;
+    uint32_t m_sentPackets;
+    uint32_t m_downlinks;
+  };
+
+  Projection Project (const DeviceSink& sink) const;
+
+  uint32_t m_convergenceUplinks;
+  std::deque<DeviceSink> m_sinks;
+};
+
+} // namespace ns3
+
+#endif /* LORAWAN_BATTERY_LIFETIME_HELPER_H */
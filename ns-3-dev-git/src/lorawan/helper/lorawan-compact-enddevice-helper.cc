@@ -0,0 +1,98 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+
+#include "lorawan-compact-enddevice-helper.h"
+#include "lorawan-helper.h"
+#include <ns3/log.h>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("LoRaWANCompactEndDeviceHelper");
+
+LoRaWANCompactEndDeviceHelper::LoRaWANCompactEndDeviceHelper ()
+{
+  m_factory.SetTypeId ("ns3::LoRaWANCompactEndDeviceFleet");
+}
+
+LoRaWANCompactEndDeviceHelper::~LoRaWANCompactEndDeviceHelper ()
+{
+  m_channel = 0;
+  m_lossModel = 0;
+  m_fleet = 0;
+}
+
+void
+LoRaWANCompactEndDeviceHelper::SetAttribute (std::string name, const AttributeValue &value)
+{
+  if (m_fleet)
+    NS_LOG_WARN ("Attribute " << name << " is set after the fleet was created and is ignored");
+  m_factory.Set (name, value);
+}
+
+void
+LoRaWANCompactEndDeviceHelper::SetChannel (Ptr<SpectrumChannel> channel)
+{
+  m_channel = channel;
+}
+
+void
+LoRaWANCompactEndDeviceHelper::SetPropagationLossModel (Ptr<PropagationLossModel> loss)
+{
+  m_lossModel = loss;
+  if (m_fleet)
+    m_fleet->SetPropagationLossModel (loss);
+}
+
+Ptr<LoRaWANCompactEndDeviceFleet>
+LoRaWANCompactEndDeviceHelper::Install (Ptr<PositionAllocator> positionAllocator, uint32_t nEndDevices)
+{
+  if (!m_fleet)
+    {
+      NS_ASSERT_MSG (m_channel, "SetChannel must be called before Install");
+      m_fleet = m_factory.Create<LoRaWANCompactEndDeviceFleet> ();
+      m_fleet->SetPropagationLossModel (m_lossModel);
+      m_fleet->SetChannel (m_channel);
+    }
+
+  m_fleet->Reserve (m_fleet->GetNEndDevices () + nEndDevices);
+  for (uint32_t i = 0; i < nEndDevices; i++)
+    {
+      m_fleet->AddEndDevice (LoRaWANHelper::AllocateDeviceAddress (), positionAllocator->GetNext ());
+    }
+
+  return m_fleet;
+}
+
+Ptr<LoRaWANCompactEndDeviceFleet>
+LoRaWANCompactEndDeviceHelper::GetFleet (void) const
+{
+  return m_fleet;
+}
+
+int64_t
+LoRaWANCompactEndDeviceHelper::AssignStreams (int64_t stream)
+{
+  if (!m_fleet)
+    return 0;
+
+  return m_fleet->AssignStreams (stream);
+}
+
+} // namespace ns3
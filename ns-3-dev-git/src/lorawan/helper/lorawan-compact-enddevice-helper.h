@@ -0,0 +1,114 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+
+#ifndef LORAWAN_COMPACT_ENDDEVICE_HELPER_H
+#define LORAWAN_COMPACT_ENDDEVICE_HELPER_H
+
+#include <ns3/object-factory.h>
+#include <ns3/position-allocator.h>
+#include <ns3/spectrum-channel.h>
+#include <ns3/propagation-loss-model.h>
+#include <ns3/lorawan-compact-enddevice.h>
+
+namespace ns3 {
+
+/**
+ * \ingroup lorawan
+ *
+ * \brief Creates a LoRaWANCompactEndDeviceFleet and fills it with end devices
+ *
+ * Use this helper instead of LoRaWANHelper and LoRaWANEndDeviceHelper when the
+ * scenario has too many end devices to give each of them a Node. All calls to
+ * Install add devices to the same fleet, which is attached to the channel
+ * given to SetChannel. Gateways are still built with LoRaWANHelper on the same
+ * channel:
+ *
+ * \code
+ *   LoRaWANHelper lorawanHelper;
+ *   ...
+ *   LoRaWANCompactEndDeviceHelper compactHelper;
+ *   compactHelper.SetChannel (lorawanHelper.GetChannel ());
+ *   compactHelper.SetPropagationLossModel (lorawanHelper.GetPropagationLossModel ());
+ *   compactHelper.Install (positionAllocator, 100000);
+ * \endcode
+ */
+class LoRaWANCompactEndDeviceHelper
+{
+public:
+  LoRaWANCompactEndDeviceHelper ();
+  ~LoRaWANCompactEndDeviceHelper ();
+
+  /**
+   * \brief Set an attribute of the LoRaWANCompactEndDeviceFleet to create
+   *
+   * Has no effect once the fleet has been created by the first Install.
+   */
+  void SetAttribute (std::string name, const AttributeValue &value);
+
+  /**
+   * \brief Set the channel the end devices transmit on
+   * \param channel the channel, must be set before the first Install
+   */
+  void SetChannel (Ptr<SpectrumChannel> channel);
+
+  /**
+   * \brief Set the propagation loss model of the channel
+   *
+   * The fleet needs it to compute the received power of downlinks itself.
+   * Without it downlinks are received without path loss.
+   *
+   * \param loss the loss model that was added to the channel
+   */
+  void SetPropagationLossModel (Ptr<PropagationLossModel> loss);
+
+  /**
+   * \brief Add end devices to the fleet
+   *
+   * Device addresses are allocated by LoRaWANHelper::AllocateDeviceAddress,
+   * so they do not clash with end devices built through LoRaWANHelper.
+   *
+   * \param positionAllocator allocates the position of every new end device
+   * \param nEndDevices the number of end devices to add
+   * \returns the fleet holding the end devices
+   */
+  Ptr<LoRaWANCompactEndDeviceFleet> Install (Ptr<PositionAllocator> positionAllocator, uint32_t nEndDevices);
+
+  /**
+   * \returns the fleet created by this helper, or 0 before the first Install
+   */
+  Ptr<LoRaWANCompactEndDeviceFleet> GetFleet (void) const;
+
+  /**
+   * \brief Assign fixed random variable streams to the fleet
+   * \param stream first stream index to use
+   * \return the number of stream indices assigned
+   */
+  int64_t AssignStreams (int64_t stream);
+
+private:
+  ObjectFactory m_factory;
+  Ptr<SpectrumChannel> m_channel;
+  Ptr<PropagationLossModel> m_lossModel;
+  Ptr<LoRaWANCompactEndDeviceFleet> m_fleet;
+};
+
+} // namespace ns3
+
+#endif /* LORAWAN_COMPACT_ENDDEVICE_HELPER_H */
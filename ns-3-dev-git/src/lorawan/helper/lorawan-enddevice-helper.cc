@@ -1,10 +1,25 @@
 
 #include "ns3/names.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/node-list.h"
+#include "ns3/mobility-model.h"
+#include "ns3/lorawan-mac.h"
+#include "ns3/lorawan-gateway-application.h"
+#include "ns3/lorawan-spectrum-value-helper.h"
+#include "ns3/spectrum-value.h"
 #include "lorawan-enddevice-helper.h"
 
+#include <cmath>
+#include <limits>
+
 namespace ns3 {
 
+NS_LOG_COMPONENT_DEFINE ("LoRaWANEndDeviceHelper");
+
 LoRaWANEndDeviceHelper::LoRaWANEndDeviceHelper (/*Address address*/)
+  : m_convergedStart (false),
+    m_lossModel (0)
 {
 	m_factory.SetTypeId ("ns3::LoRaWANEndDeviceApplication");
 	//m_factory.Set ("Remote", AddressValue (address));
@@ -19,14 +34,14 @@ LoRaWANEndDeviceHelper::SetAttribute (std::string name, const AttributeValue &va
 ApplicationContainer 
 LoRaWANEndDeviceHelper::Install (Ptr<Node> node) const
 {
-	return ApplicationContainer (InstallPriv (node));
+	return ScheduleConvergedStart (ApplicationContainer (InstallPriv (node)));
 }
 
 ApplicationContainer
 LoRaWANEndDeviceHelper::Install (std::string nodeName) const
 {
 	Ptr<Node> node = Names::Find<Node> (nodeName);
-	return ApplicationContainer (InstallPriv (node));
+	return ScheduleConvergedStart (ApplicationContainer (InstallPriv (node)));
 }
 
 ApplicationContainer
@@ -38,7 +53,7 @@ LoRaWANEndDeviceHelper::Install (NodeContainer c) const
 		apps.Add (InstallPriv (*i));
 	}
 
-	return apps;
+	return ScheduleConvergedStart (apps);
 }
 
 Ptr<Application>
@@ -50,6 +65,117 @@ LoRaWANEndDeviceHelper::InstallPriv (Ptr<Node> node) const
 	return app;
 }
 
+ApplicationContainer
+LoRaWANEndDeviceHelper::ScheduleConvergedStart (ApplicationContainer c) const
+{
+	// At the start of the simulation rather than now, so that the gateways,
+	// their positions and the network server attributes are all known
+	if (m_convergedStart)
+		Simulator::Schedule (Seconds (0), &LoRaWANEndDeviceHelper::AssignConvergedDataRates, c, m_lossModel);
+
+	return c;
+}
+
+void
+LoRaWANEndDeviceHelper::SetConvergedStart (bool convergedStart)
+{
+	m_convergedStart = convergedStart;
+}
+
+void
+LoRaWANEndDeviceHelper::SetPropagationLossModel (Ptr<PropagationLossModel> loss)
+{
+	m_lossModel = loss;
+}
+
+void
+LoRaWANEndDeviceHelper::AssignConvergedDataRates (ApplicationContainer c, Ptr<PropagationLossModel> loss)
+{
+	NS_LOG_FUNCTION (c.GetN () << loss);
+
+	if (!loss) {
+		NS_LOG_ERROR ("No propagation loss model to predict the SNR of the end devices with, end devices keep their configured data rate");
+		return;
+	}
+
+	// Gateways are recognised as PopulateEndDevices does
+	std::vector<Ptr<MobilityModel> > gateways;
+	for (NodeList::Iterator it = NodeList::Begin (); it != NodeList::End (); ++it) {
+		if ((*it)->GetNDevices () == 0)
+			continue;
+
+		Address devAddr = (*it)->GetDevice (0)->GetAddress ();
+		if (Ipv4Address::IsMatchingType (devAddr) && Ipv4Address::ConvertFrom (devAddr).IsEqual (Ipv4Address (0xffffffff))) {
+			Ptr<MobilityModel> mobility = (*it)->GetObject<MobilityModel> ();
+			if (mobility)
+				gateways.push_back (mobility);
+		}
+	}
+	if (gateways.empty ()) {
+		NS_LOG_ERROR ("No gateways with a mobility model, end devices keep their configured data rate");
+		return;
+	}
+
+	// Link budget: maximum tx power on the uplink sub band and the noise power in the channel bandwidth of the PHY
+	Ptr<LoRaWANMac::LoRaWANMacRDC> macRDC = CreateObject<LoRaWANMac::LoRaWANMacRDC> ();
+	const double maxTxPower = macRDC->GetMaxPowerForSubBand (LoRaWAN::m_supportedChannels [0].m_subBandIndex);
+	LoRaWANSpectrumValueHelper psdHelper;
+	const uint32_t freq = LoRaWAN::m_supportedChannels [0].m_fc;
+	const double noisePower = 10.0 * std::log10 (LoRaWANSpectrumValueHelper::TotalAvgPower (psdHelper.CreateNoisePowerSpectralDensity (freq), freq)) + 30.0;
+
+	Ptr<LoRaWANNetworkServer> ns = LoRaWANNetworkServer::getLoRaWANNetworkServerPointer ();
+	ns->PopulateEndDevices (); // make sure the info structs exist
+
+	for (ApplicationContainer::Iterator i = c.Begin (); i != c.End (); ++i) {
+		Ptr<LoRaWANEndDeviceApplication> app = DynamicCast<LoRaWANEndDeviceApplication> (*i);
+		if (!app)
+			continue;
+
+		Ptr<MobilityModel> mobility = app->GetNode ()->GetObject<MobilityModel> ();
+		if (!mobility) {
+			NS_LOG_ERROR ("End device node " << app->GetNode ()->GetId () << " has no mobility model, keeping its configured data rate");
+			continue;
+		}
+
+		double gain = -std::numeric_limits<double>::infinity ();
+		for (auto& gateway : gateways)
+			gain = std::max (gain, loss->CalcRxPower (0.0, mobility, gateway));
+		const double snr = maxTxPower + gain - noisePower;
+
+		const uint32_t deviceAddr = Ipv4Address::ConvertFrom (app->GetNode ()->GetDevice (0)->GetAddress ()).Get ();
+		LoRaWANEndDeviceInfoNS* info = ns->GetEndDeviceInfo (deviceAddr);
+		const double marginDb = info ? info->m_marginDb : LoRaWANEndDeviceInfoNS ().m_marginDb;
+
+		uint8_t dr = app->GetDataRateIndex ();
+		uint8_t tx = 0;
+		while (dr > 0 && snr < ns->GetADRRequiredSNR (dr))
+			dr--;
+
+		// The NS only sends a LinkADRReq when the data rate changes (it records a
+		// new tx power index before comparing), so rounds that only change the
+		// tx power never reach the device
+		for (int n = 0; n < 16; n++) {
+			const double SNRmargin = snr - 2 * tx - ns->GetADRRequiredSNR (dr) - marginDb;
+			const uint8_t lastDr = dr;
+			const uint8_t lastTx = tx;
+			LoRaWANNetworkServer::ApplyADRSteps (int (SNRmargin / 3), dr, tx);
+			if (dr == lastDr) {
+				tx = lastTx;
+				break;
+			}
+		}
+
+		NS_LOG_INFO ("End device " << Ipv4Address (deviceAddr) << ": predicted SNR " << snr << " dB at maximum tx power, starting at DR" << (unsigned)dr << " with tx power index " << (unsigned)tx);
+
+		app->SetDataRateIndex (dr);
+		app->SetTxPowerIndex (tx);
+		if (info) {
+			info->m_lastDataRateIndex = dr;
+			info->m_lastTxPowerIndex = tx;
+		}
+	}
+}
+
 int64_t
 LoRaWANEndDeviceHelper::AssignStreams (ApplicationContainer c, int64_t stream)
 {
@@ -13,6 +13,7 @@
 #include "ns3/inet-socket-address.h"
 #include "ns3/packet-socket-address.h"
 #include "ns3/lorawan-enddevice-application.h"
+#include "ns3/propagation-loss-model.h"
 
 namespace ns3 {
 
@@ -31,10 +32,46 @@ public:
 
 	int64_t AssignStreams (ApplicationContainer c, int64_t stream);
 
+	/**
+	 * \brief Start the end devices at the data rate and tx power index ADR converges to
+	 *
+	 * When enabled, the applications installed by this helper get their data
+	 * rate and tx power index from AssignConvergedDataRates at the start of
+	 * the simulation, so that no simulated time is spent while ADR walks the
+	 * devices from the configured DataRateIndex to their final settings.
+	 * Requires the propagation loss model of the channel, see
+	 * SetPropagationLossModel.
+	 */
+	void SetConvergedStart (bool convergedStart);
+
+	void SetPropagationLossModel (Ptr<PropagationLossModel> loss);
+
+	/**
+	 * \brief Assign the data rate and tx power index ADR converges to
+	 *
+	 * The SNR of every end device is predicted from the loss model towards the
+	 * best gateway (every node whose first device has the gateway address),
+	 * the maximum tx power of the uplink sub band and the noise power of the
+	 * PHY. From the configured DataRateIndex and the maximum tx power, the
+	 * NS side ADR algorithm is then applied until it no longer changes the
+	 * data rate, with the SNR requirements and installation margin of the
+	 * network server (tx power changes without a data rate change are not
+	 * sent to the device by the network server). Devices that cannot close the link at their configured
+	 * data rate first back off to the highest data rate that can, as the
+	 * device side ADR would. The network server state of the devices is
+	 * updated to match.
+	 *
+	 * Random loss models are sampled once per end device and gateway.
+	 */
+	static void AssignConvergedDataRates (ApplicationContainer c, Ptr<PropagationLossModel> loss);
+
 private:
 	Ptr<Application> InstallPriv (Ptr<Node> node) const;
+	ApplicationContainer ScheduleConvergedStart (ApplicationContainer c) const;
 
 	ObjectFactory m_factory;
+	bool m_convergedStart;
+	Ptr<PropagationLossModel> m_lossModel;
 };
 
 } // namespace ns3
@@ -23,6 +23,7 @@
 #include <ns3/simulator.h>
 #include <ns3/mobility-model.h>
 #include <ns3/single-model-spectrum-channel.h>
+#include <ns3/lorawan-spectrum-channel.h>
 #include <ns3/multi-model-spectrum-channel.h>
 #include <ns3/propagation-loss-model.h>
 #include <ns3/propagation-delay-model.h>
@@ -34,13 +35,13 @@ namespace ns3 {
 NS_LOG_COMPONENT_DEFINE ("LoRaWANHelper");
 
 /* ... */
-LoRaWANHelper::LoRaWANHelper (void) : m_deviceType (LORAWAN_DT_END_DEVICE_CLASS_A)
+LoRaWANHelper::LoRaWANHelper (void) : m_deviceType (LORAWAN_DT_END_DEVICE_CLASS_A), m_nbRep (1)
 {
-  //old
-  m_channel = CreateObject<SingleModelSpectrumChannel> ();
+  m_channel = CreateObject<LoRaWANSpectrumChannel> ();
 
   Ptr<LogDistancePropagationLossModel> lossModel = CreateObject<LogDistancePropagationLossModel> ();
   m_channel->AddPropagationLossModel (lossModel);
+  m_lossModel = lossModel;
 
   Ptr<ConstantSpeedPropagationDelayModel> delayModel = CreateObject<ConstantSpeedPropagationDelayModel> ();
   m_channel->SetPropagationDelayModel (delayModel);
@@ -56,7 +57,7 @@ LoRaWANHelper::LoRaWANHelper (void) : m_deviceType (LORAWAN_DT_END_DEVICE_CLASS_
   
 }
 
-LoRaWANHelper::LoRaWANHelper (bool useMultiModelSpectrumChannel) : m_deviceType (LORAWAN_DT_END_DEVICE_CLASS_A)
+LoRaWANHelper::LoRaWANHelper (bool useMultiModelSpectrumChannel) : m_deviceType (LORAWAN_DT_END_DEVICE_CLASS_A), m_nbRep (1)
 {
   if (useMultiModelSpectrumChannel)
     {
@@ -64,10 +65,11 @@ LoRaWANHelper::LoRaWANHelper (bool useMultiModelSpectrumChannel) : m_deviceType
     }
   else
     {
-      m_channel = CreateObject<SingleModelSpectrumChannel> ();
+      m_channel = CreateObject<LoRaWANSpectrumChannel> ();
     }
   Ptr<LogDistancePropagationLossModel> lossModel = CreateObject<LogDistancePropagationLossModel> ();
   m_channel->AddPropagationLossModel (lossModel);
+  m_lossModel = lossModel;
 
   Ptr<ConstantSpeedPropagationDelayModel> delayModel = CreateObject<ConstantSpeedPropagationDelayModel> ();
   m_channel->SetPropagationDelayModel (delayModel);
@@ -77,6 +79,7 @@ LoRaWANHelper::~LoRaWANHelper (void)
 {
   //m_channel->Dispose ();
   m_channel = 0;
+  m_lossModel = 0;
 }
 
 void
@@ -120,7 +123,19 @@ NetDeviceContainer
 LoRaWANHelper::Install (NodeContainer c)
 {
   NetDeviceContainer devices;
-  static uint32_t addressCounter = 1;
+
+  // Resolve and check the NbRep attribute once for the whole batch, rather
+  // than looking it up by name on every end device
+  struct TypeId::AttributeInformation nbRepInfo;
+  Ptr<AttributeValue> nbRep;
+  if (m_deviceType != LORAWAN_DT_GATEWAY) {
+    bool found = LoRaWANNetDevice::GetTypeId ().LookupAttributeByName ("NbRep", &nbRepInfo);
+    NS_ASSERT (found);
+    nbRep = nbRepInfo.checker->CreateValidValue (UintegerValue (m_nbRep));
+    if (nbRep == 0)
+      NS_FATAL_ERROR ("Invalid number of repetitions " << (uint16_t)m_nbRep);
+  }
+
   for (NodeContainer::Iterator i = c.Begin (); i != c.End (); i++)
     {
       Ptr<Node> node = *i;
@@ -131,8 +146,8 @@ LoRaWANHelper::Install (NodeContainer c)
       netDevice->SetNode (node);
 
       if (m_deviceType != LORAWAN_DT_GATEWAY) {
-        netDevice->SetAddress (Ipv4Address(addressCounter++)); // will also set channel on underlying phy(s)
-        netDevice->SetAttribute ("NbRep", UintegerValue (m_nbRep)); // set number of repetitions
+        netDevice->SetAddress (AllocateDeviceAddress ()); // will also set channel on underlying phy(s)
+        nbRepInfo.accessor->Set (PeekPointer (netDevice), *nbRep); // set number of repetitions
       }
 
       node->AddDevice (netDevice);
@@ -142,16 +157,50 @@ LoRaWANHelper::Install (NodeContainer c)
 }
 
 
+Ipv4Address
+LoRaWANHelper::AllocateDeviceAddress (void)
+{
+  static uint32_t addressCounter = 1;
+  return Ipv4Address (addressCounter++);
+}
+
+void
+LoRaWANHelper::SetRegion (LoRaWANRegion region, uint8_t channelSubBand)
+{
+  LoRaWAN::SetRegion (region, channelSubBand);
+}
+
 Ptr<SpectrumChannel>
 LoRaWANHelper::GetChannel (void)
 {
   return m_channel;
 }
 
+Ptr<PropagationLossModel>
+LoRaWANHelper::GetPropagationLossModel (void)
+{
+  return m_lossModel;
+}
+
+void
+LoRaWANHelper::SetPropagationLossModel (Ptr<PropagationLossModel> lossModel)
+{
+  NS_ASSERT_MSG (m_channel != 0, "LoRaWANHelper has no channel");
+  Ptr<LoRaWANSpectrumChannel> lorawanChannel = DynamicCast<LoRaWANSpectrumChannel> (m_channel);
+  if (lorawanChannel) {
+    lorawanChannel->SetPropagationLossModel (lossModel);
+  } else {
+    // other channel types only accept a loss model when they have none yet
+    m_channel->AddPropagationLossModel (lossModel);
+  }
+  m_lossModel = lossModel;
+}
+
 void
 LoRaWANHelper::SetChannel (Ptr<SpectrumChannel> channel)
 {
   m_channel = channel;
+  m_lossModel = 0;
 }
 
 void
@@ -159,6 +208,7 @@ LoRaWANHelper::SetChannel (std::string channelName)
 {
   Ptr<SpectrumChannel> channel = Names::Find<SpectrumChannel> (channelName);
   m_channel = channel;
+  m_lossModel = 0;
 }
 
 int64_t
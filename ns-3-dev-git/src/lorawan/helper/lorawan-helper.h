@@ -25,10 +25,13 @@
 #include <ns3/lorawan-phy.h>
 #include <ns3/node-container.h>
 #include <ns3/net-device-container.h>
+#include <ns3/ipv4-address.h>
 #include <ns3/log.h>
 
 namespace ns3 {
 
+class PropagationLossModel;
+
 /**
  * \brief helps to create LoRaWANNetDevice objects
  *
@@ -40,8 +43,9 @@ class LoRaWANHelper {
 public:
   /**
    * \brief Create a LoRaWAN helper in an empty state.  By default, a
-   * SingleModelSpectrumChannel is created, with a 
+   * LoRaWANSpectrumChannel is created, with a 
    * LogDistancePropagationLossModel and a ConstantSpeedPropagationDelayModel.
+   * End device PHYs detach from this channel while they are not listening.
    *
    * To change the channel type, loss model, or delay model, the Get/Set
    * Channel methods may be used.
@@ -50,8 +54,8 @@ public:
 
   /**
    * \brief Create a LoRaWAN helper in an empty state with either a
-   * SingleModelSpectrumChannel or a MultiModelSpectrumChannel.
-   * \param useMultiModelSpectrumChannel use a MultiModelSpectrumChannel if true, a SingleModelSpectrumChannel otherwise
+   * LoRaWANSpectrumChannel or a MultiModelSpectrumChannel.
+   * \param useMultiModelSpectrumChannel use a MultiModelSpectrumChannel if true, a LoRaWANSpectrumChannel otherwise
    *
    * A LogDistancePropagationLossModel and a 
    * ConstantSpeedPropagationDelayModel are added to the channel.
@@ -66,6 +70,27 @@ public:
    */
   Ptr<SpectrumChannel> GetChannel (void);
 
+  /**
+   * \brief Get the propagation loss model that this helper added to its channel
+   * \returns the loss model, or 0 if the channel was replaced via SetChannel
+   */
+  Ptr<PropagationLossModel> GetPropagationLossModel (void);
+
+  /**
+   * \brief Replace the loss model of the channel of this helper
+   *
+   * The loss model is set on the existing channel, which keeps its delay
+   * model and attributes, so this should be called before Install. A
+   * channel passed to SetChannel that is not a LoRaWANSpectrumChannel must
+   * not have a loss model yet. Buildings-aware loss models (e.g.
+   * HybridBuildingsPropagationLossModel) can be used this way, they need
+   * BuildingsHelper::Install and BuildingsHelper::MakeMobilityModelConsistent
+   * to be called on the nodes.
+   *
+   * \param lossModel the loss model
+   */
+  void SetPropagationLossModel (Ptr<PropagationLossModel> lossModel);
+
   /**
    * \brief Set the channel associated to this helper
    * \param channel the channel
@@ -115,6 +140,28 @@ public:
    */
   int64_t AssignStreams (NetDeviceContainer c, int64_t stream);
 
+  /**
+   * \brief Allocate a new, unique end device address
+   *
+   * Shared by all helpers that create end devices, so that end devices built
+   * by different helpers never end up with the same address.
+   *
+   * \returns the allocated address
+   */
+  static Ipv4Address AllocateDeviceAddress (void);
+
+  /**
+   * \brief Select the regional parameters of the simulation, see
+   * LoRaWAN::SetRegion
+   *
+   * Must be called before any device or application is created.
+   *
+   * \param region the region
+   * \param channelSubBand the block of 8 uplink channels used by gateways
+   * and end devices (US915: 0-7)
+   */
+  static void SetRegion (LoRaWANRegion region, uint8_t channelSubBand = 0);
+
   void EnableLogComponents (enum LogLevel level = LOG_LEVEL_ALL);
 private:
   // Disable implicit constructors
@@ -130,6 +177,7 @@ private:
 
 private:
   Ptr<SpectrumChannel> m_channel; //!< channel to be used for the devices
+  Ptr<PropagationLossModel> m_lossModel; //!< loss model added to m_channel by this helper
   LoRaWANDeviceType m_deviceType; //!< the device type to use when creating new LoRaWANNetDevice objects
   uint8_t m_nbRep; //!< number of repetitions for unconfirmed us data (only for end devices)
 };
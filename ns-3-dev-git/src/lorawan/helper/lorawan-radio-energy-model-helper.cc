@@ -33,6 +33,13 @@ LoRaWANRadioEnergyModelHelper::LoRaWANRadioEnergyModelHelper ()
   m_radioEnergy.SetTypeId ("ns3::LoRaWANRadioEnergyModel");
   m_depletionCallback.Nullify ();
   m_rechargedCallback.Nullify ();
+
+  // Resolve the PHY trace sources once, instead of by name for every device
+  TypeId phyTid = LoRaWANPhy::GetTypeId ();
+  m_trxStateTrace = phyTid.LookupTraceSourceByName ("TrxState");
+  m_txPowerTrace = phyTid.LookupTraceSourceByName ("TxPower");
+  m_bandwidthTrace = phyTid.LookupTraceSourceByName ("BandwidthOfCurrentChannel");
+  NS_ASSERT (m_trxStateTrace && m_txPowerTrace && m_bandwidthTrace);
 }
 
 LoRaWANRadioEnergyModelHelper::~LoRaWANRadioEnergyModelHelper ()
@@ -80,23 +87,19 @@ LoRaWANRadioEnergyModelHelper::DoInstall (Ptr<NetDevice> device,
   NS_ASSERT (source != NULL);
 
   // check if device is LoRaWANNetDevice
-  std::string deviceName = device->GetInstanceTypeId ().GetName ();
-
-  if (deviceName.compare ("ns3::LoRaWANNetDevice") != 0)
+  Ptr<LoRaWANNetDevice> LoRaWANDevice = DynamicCast<LoRaWANNetDevice> (device);
+  if (LoRaWANDevice == 0)
   {
     NS_FATAL_ERROR ("NetDevice type is not LoRaWANNetDevice!");
   }
 
-  Ptr<Node> node = device->GetNode ();
-
-  Ptr<LoRaWANRadioEnergyModel> model = m_radioEnergy.Create ()->GetObject<LoRaWANRadioEnergyModel> ();
+  Ptr<LoRaWANRadioEnergyModel> model = m_radioEnergy.Create<LoRaWANRadioEnergyModel> ();
   NS_ASSERT (model != NULL);
 
   // set energy source pointer
   model->SetEnergySource (source);
   
 
-  Ptr<LoRaWANNetDevice> LoRaWANDevice = DynamicCast<LoRaWANNetDevice> (device);
   Ptr<LoRaWANPhy> LoRaWANPhy = LoRaWANDevice->GetPhy ();
 
   // TODO: leaving these commented out for now as current in the PHY model there is no distinction between TRX_OFF and (e.g.) DEVICE_DEAD
@@ -127,9 +130,9 @@ LoRaWANRadioEnergyModelHelper::DoInstall (Ptr<NetDevice> device,
   source->AppendDeviceEnergyModel (model);
 
   // create and register energy model phy listener
-  LoRaWANPhy -> TraceConnectWithoutContext ("TrxState",MakeCallback(&LoRaWANRadioEnergyModel::ChangeLoRaWANState, model));
-  LoRaWANPhy -> TraceConnectWithoutContext ("TxPower",MakeCallback(&LoRaWANRadioEnergyModel::SetTxCurrentA, model));
-  LoRaWANPhy -> TraceConnectWithoutContext ("BandwidthOfCurrentChannel",MakeCallback(&LoRaWANRadioEnergyModel::SetRxCurrentA, model));
+  m_trxStateTrace->ConnectWithoutContext (PeekPointer (LoRaWANPhy), MakeCallback (&LoRaWANRadioEnergyModel::ChangeLoRaWANState, model));
+  m_txPowerTrace->ConnectWithoutContext (PeekPointer (LoRaWANPhy), MakeCallback (&LoRaWANRadioEnergyModel::SetTxCurrentA, model));
+  m_bandwidthTrace->ConnectWithoutContext (PeekPointer (LoRaWANPhy), MakeCallback (&LoRaWANRadioEnergyModel::SetRxCurrentA, model));
 
   if (m_currentModel.GetTypeId ().GetUid ())
   { 
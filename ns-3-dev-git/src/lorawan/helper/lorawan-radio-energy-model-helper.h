@@ -23,6 +23,7 @@
 
 #include "ns3/energy-model-helper.h"
 #include "ns3/lorawan-radio-energy-model.h"
+#include "ns3/trace-source-accessor.h"
 
 namespace ns3 {
 
@@ -92,6 +93,9 @@ private:
   LoRaWANRadioEnergyModel::LoRaWANRadioEnergyDepletionCallback m_depletionCallback;
   LoRaWANRadioEnergyModel::LoRaWANRadioEnergyRechargedCallback m_rechargedCallback;
   ObjectFactory m_currentModel;
+  Ptr<const TraceSourceAccessor> m_trxStateTrace; //!< LoRaWANPhy::TrxState, resolved once per helper
+  Ptr<const TraceSourceAccessor> m_txPowerTrace; //!< LoRaWANPhy::TxPower, resolved once per helper
+  Ptr<const TraceSourceAccessor> m_bandwidthTrace; //!< LoRaWANPhy::BandwidthOfCurrentChannel, resolved once per helper
 
 };
 
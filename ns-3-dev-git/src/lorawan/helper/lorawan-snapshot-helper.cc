@@ -0,0 +1,392 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+
+#include "lorawan-snapshot-helper.h"
+#include "ns3/log.h"
+#include "ns3/node.h"
+#include "ns3/net-device.h"
+#include "ns3/ipv4-address.h"
+#include "ns3/pointer.h"
+#include "ns3/simulator.h"
+#include "ns3/rng-seed-manager.h"
+#include "ns3/random-variable-stream.h"
+#include "ns3/lorawan-enddevice-application.h"
+#include "ns3/lorawan-gateway-application.h"
+#include "ns3/lorawan-net-device.h"
+
+#include <fstream>
+#include <unordered_map>
+#include <cstring>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("LoRaWANSnapshotHelper");
+
+namespace {
+
+const char g_snapshotMagic[4] = {'L', 'W', 'S', 'S'};
+
+// the RNG streams of a LoRaWANEndDeviceApplication, in the order in which they are stored
+const char* g_endDeviceRngAttributes[] = {"ChannelRandomVariable", "UpstreamIAT", "UpstreamSend"};
+const uint8_t g_nEndDeviceRngAttributes = 3;
+
+template <typename T>
+void
+WriteValue (std::ostream &os, T value)
+{
+  os.write (reinterpret_cast<const char*> (&value), sizeof (T));
+}
+
+template <typename T>
+T
+ReadValue (std::istream &is)
+{
+  T value = T ();
+  is.read (reinterpret_cast<char*> (&value), sizeof (T));
+  return value;
+}
+
+void
+WriteRngState (std::ostream &os, Ptr<RandomVariableStream> rv)
+{
+  uint32_t state[6];
+  rv->GetRngState (state);
+  for (int i = 0; i < 6; ++i)
+    WriteValue<uint32_t> (os, state[i]);
+}
+
+void
+ReadRngState (std::istream &is, Ptr<RandomVariableStream> rv)
+{
+  uint32_t state[6];
+  for (int i = 0; i < 6; ++i)
+    state[i] = ReadValue<uint32_t> (is);
+
+  if (is && rv)
+    rv->SetRngState (state);
+}
+
+Ptr<RandomVariableStream>
+GetRandomVariable (Ptr<Object> object, std::string attribute)
+{
+  PointerValue ptr;
+  object->GetAttribute (attribute, ptr);
+  return ptr.Get<RandomVariableStream> ();
+}
+
+uint32_t
+GetDeviceAddress (Ptr<Node> node)
+{
+  return Ipv4Address::ConvertFrom (node->GetDevice (0)->GetAddress ()).Get ();
+}
+
+Ptr<LoRaWANEndDeviceApplication>
+GetEndDeviceApplication (Ptr<Node> node)
+{
+  for (uint32_t i = 0; i < node->GetNApplications (); i++)
+    {
+      Ptr<LoRaWANEndDeviceApplication> app = DynamicCast<LoRaWANEndDeviceApplication> (node->GetApplication (i));
+      if (app)
+        return app;
+    }
+  return nullptr;
+}
+
+} // anonymous namespace
+
+LoRaWANSnapshotHelper::LoRaWANSnapshotHelper (void)
+{
+}
+
+bool
+LoRaWANSnapshotHelper::Save (std::string filename, NodeContainer endDevices) const
+{
+  NS_LOG_FUNCTION (this << filename);
+
+  std::ofstream os (filename.c_str (), std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!os.is_open ())
+    {
+      NS_LOG_ERROR (this << " Unable to open snapshot file " << filename);
+      return false;
+    }
+
+  Ptr<LoRaWANNetworkServer> ns = nullptr;
+  if (LoRaWANNetworkServer::haveLoRaWANNetworkServerObject ())
+    ns = LoRaWANNetworkServer::getLoRaWANNetworkServerPointer ();
+
+  // Header
+  os.write (g_snapshotMagic, sizeof (g_snapshotMagic));
+  WriteValue<uint16_t> (os, LORAWAN_SNAPSHOT_VERSION);
+  WriteValue<uint32_t> (os, RngSeedManager::GetSeed ());
+  WriteValue<uint64_t> (os, RngSeedManager::GetRun ());
+  WriteValue<int64_t> (os, Simulator::Now ().GetNanoSeconds ());
+  WriteValue<uint32_t> (os, endDevices.GetN ());
+
+  // Network server wide state
+  WriteValue<uint8_t> (os, ns ? 1 : 0);
+  if (ns)
+    WriteRngState (os, GetRandomVariable (ns, "DownstreamIAT"));
+
+  // Per end device state
+  for (NodeContainer::Iterator n = endDevices.Begin (); n != endDevices.End (); ++n)
+    {
+      uint32_t deviceAddr = GetDeviceAddress (*n);
+      WriteValue<uint32_t> (os, deviceAddr);
+
+      Ptr<LoRaWANEndDeviceApplication> app = GetEndDeviceApplication (*n);
+      WriteValue<uint8_t> (os, app ? 1 : 0);
+      if (app)
+        {
+          WriteValue<uint8_t> (os, app->GetDataRateIndex ());
+          WriteValue<uint8_t> (os, app->GetTxPowerIndex ());
+          WriteValue<uint16_t> (os, app->GetChannelMask ());
+          Ptr<LoRaWANNetDevice> netDevice = DynamicCast<LoRaWANNetDevice> ((*n)->GetDevice (0));
+          WriteValue<uint8_t> (os, netDevice ? netDevice->GetNbRep () : 1);
+          WriteValue<uint32_t> (os, app->GetFrameCounterUp ());
+          WriteValue<uint32_t> (os, app->GetAdrAckCounter ());
+          for (uint8_t i = 0; i < g_nEndDeviceRngAttributes; i++)
+            WriteRngState (os, GetRandomVariable (app, g_endDeviceRngAttributes[i]));
+        }
+
+      LoRaWANEndDeviceInfoNS* info = ns ? ns->GetEndDeviceInfo (deviceAddr) : nullptr;
+      WriteValue<uint8_t> (os, info ? 1 : 0);
+      if (info)
+        {
+          uint8_t flags = (info->m_setAdr ? 0x01 : 0) | (info->m_framePending ? 0x02 : 0) | (info->m_setAck ? 0x04 : 0);
+          WriteValue<uint8_t> (os, info->m_rx1DROffset);
+          WriteValue<uint8_t> (os, info->m_marginDb);
+          WriteValue<uint8_t> (os, flags);
+          WriteValue<uint8_t> (os, info->m_lastTxPowerIndex);
+          WriteValue<uint8_t> (os, info->m_lastDataRateIndex);
+          WriteValue<uint8_t> (os, info->m_lastChannelIndex);
+          WriteValue<uint8_t> (os, info->m_lastCodeRate);
+          WriteValue<uint32_t> (os, info->m_fCntUp);
+          WriteValue<uint32_t> (os, info->m_fCntDown);
+          WriteValue<uint8_t> (os, info->m_nbTrans);
+          WriteValue<uint16_t> (os, info->m_channelMask);
+
+          WriteValue<uint32_t> (os, info->m_nUSPackets);
+          WriteValue<uint32_t> (os, info->m_nUniqueUSPackets);
+          WriteValue<uint32_t> (os, info->m_nUSRetransmission);
+          WriteValue<uint32_t> (os, info->m_nUSDuplicates);
+          WriteValue<uint32_t> (os, info->m_nUSAcks);
+          WriteValue<uint32_t> (os, info->m_nDSPacketsGenerated);
+          WriteValue<uint32_t> (os, info->m_nDSPacketsSent);
+          WriteValue<uint32_t> (os, info->m_nDSPacketsSentRW1);
+          WriteValue<uint32_t> (os, info->m_nDSPacketsSentRW2);
+          WriteValue<uint32_t> (os, info->m_nDSRetransmission);
+          WriteValue<uint32_t> (os, info->m_nDSAcks);
+
+          WriteValue<uint8_t> (os, info->m_frameSNRHistory.size ());
+          for (auto & row : info->m_frameSNRHistory)
+            {
+              WriteValue<uint16_t> (os, row.frameCounter);
+              WriteValue<double> (os, row.snrMax);
+              WriteValue<uint8_t> (os, row.gtwDiversity);
+              WriteValue<uint8_t> (os, row.nbTrans);
+              WriteValue<uint8_t> (os, row.nTransmissions);
+            }
+        }
+    }
+
+  if (!os.good ())
+    {
+      NS_LOG_ERROR (this << " Error while writing snapshot file " << filename);
+      return false;
+    }
+
+  NS_LOG_INFO ("At time " << Simulator::Now ().GetSeconds () << "s saved LoRaWAN snapshot of " << endDevices.GetN () << " end devices to " << filename);
+  return true;
+}
+
+bool
+LoRaWANSnapshotHelper::Restore (std::string filename, NodeContainer endDevices) const
+{
+  NS_LOG_FUNCTION (this << filename);
+
+  std::ifstream is (filename.c_str (), std::ios::in | std::ios::binary);
+  if (!is.is_open ())
+    {
+      NS_LOG_ERROR (this << " Unable to open snapshot file " << filename);
+      return false;
+    }
+
+  // Header
+  char magic[sizeof (g_snapshotMagic)];
+  is.read (magic, sizeof (magic));
+  uint16_t version = ReadValue<uint16_t> (is);
+  if (!is || std::memcmp (magic, g_snapshotMagic, sizeof (magic)) != 0 || version != LORAWAN_SNAPSHOT_VERSION)
+    {
+      NS_LOG_ERROR (this << " " << filename << " is not a LoRaWAN snapshot file of version " << LORAWAN_SNAPSHOT_VERSION);
+      return false;
+    }
+  uint32_t seed = ReadValue<uint32_t> (is);
+  uint64_t run = ReadValue<uint64_t> (is);
+  int64_t savedAt = ReadValue<int64_t> (is);
+  uint32_t nEndDevices = ReadValue<uint32_t> (is);
+  if (seed != RngSeedManager::GetSeed () || run != RngSeedManager::GetRun ())
+    {
+      NS_LOG_WARN (this << " Snapshot was taken with seed " << seed << " and run " << run << ", RNG streams that are not part of the snapshot will diverge");
+    }
+
+  // Index the end devices on their device address
+  std::unordered_map<uint32_t, Ptr<Node> > nodes;
+  for (NodeContainer::Iterator n = endDevices.Begin (); n != endDevices.End (); ++n)
+    nodes[GetDeviceAddress (*n)] = *n;
+
+  // Network server wide state
+  Ptr<LoRaWANNetworkServer> ns = nullptr;
+  uint8_t haveNS = ReadValue<uint8_t> (is);
+  if (haveNS)
+    {
+      ns = LoRaWANNetworkServer::getLoRaWANNetworkServerPointer ();
+      ns->PopulateEndDevices (); // make sure the info structs exist, draws from the DownstreamIAT stream so restore that afterwards
+      ReadRngState (is, GetRandomVariable (ns, "DownstreamIAT"));
+    }
+
+  // Per end device state
+  uint32_t nRestored = 0;
+  for (uint32_t d = 0; d < nEndDevices && is; d++)
+    {
+      uint32_t deviceAddr = ReadValue<uint32_t> (is);
+      auto n = nodes.find (deviceAddr);
+      if (n == nodes.end ())
+        NS_LOG_WARN (this << " End device " << Ipv4Address (deviceAddr) << " from snapshot not found in topology, skipping");
+
+      Ptr<LoRaWANEndDeviceApplication> app = n != nodes.end () ? GetEndDeviceApplication (n->second) : nullptr;
+      uint8_t haveApp = ReadValue<uint8_t> (is);
+      if (haveApp)
+        {
+          uint8_t dataRateIndex = ReadValue<uint8_t> (is);
+          uint8_t txPowerIndex = ReadValue<uint8_t> (is);
+          uint16_t channelMask = ReadValue<uint16_t> (is);
+          uint8_t nbRep = ReadValue<uint8_t> (is);
+          uint32_t fCntUp = ReadValue<uint32_t> (is);
+          uint32_t adrAckCnt = ReadValue<uint32_t> (is);
+          for (uint8_t i = 0; i < g_nEndDeviceRngAttributes; i++)
+            ReadRngState (is, app ? GetRandomVariable (app, g_endDeviceRngAttributes[i]) : nullptr);
+
+          if (app)
+            {
+              app->SetDataRateIndex (dataRateIndex);
+              app->SetTxPowerIndex (txPowerIndex);
+              app->SetChannelMask (channelMask);
+              Ptr<LoRaWANNetDevice> netDevice = DynamicCast<LoRaWANNetDevice> (n->second->GetDevice (0));
+              if (netDevice && nbRep >= 1 && nbRep <= 15)
+                netDevice->SetNbRep (nbRep);
+              app->SetFrameCounterUp (fCntUp);
+              app->SetAdrAckCounter (adrAckCnt);
+            }
+        }
+
+      uint8_t haveInfo = ReadValue<uint8_t> (is);
+      if (haveInfo)
+        {
+          LoRaWANEndDeviceInfoNS restored;
+          restored.m_rx1DROffset = ReadValue<uint8_t> (is);
+          restored.m_marginDb = ReadValue<uint8_t> (is);
+          uint8_t flags = ReadValue<uint8_t> (is);
+          restored.m_setAdr = flags & 0x01;
+          restored.m_framePending = flags & 0x02;
+          restored.m_setAck = flags & 0x04;
+          restored.m_lastTxPowerIndex = ReadValue<uint8_t> (is);
+          restored.m_lastDataRateIndex = ReadValue<uint8_t> (is);
+          restored.m_lastChannelIndex = ReadValue<uint8_t> (is);
+          restored.m_lastCodeRate = ReadValue<uint8_t> (is);
+          restored.m_fCntUp = ReadValue<uint32_t> (is);
+          restored.m_fCntDown = ReadValue<uint32_t> (is);
+          restored.m_nbTrans = ReadValue<uint8_t> (is);
+          restored.m_channelMask = ReadValue<uint16_t> (is);
+
+          restored.m_nUSPackets = ReadValue<uint32_t> (is);
+          restored.m_nUniqueUSPackets = ReadValue<uint32_t> (is);
+          restored.m_nUSRetransmission = ReadValue<uint32_t> (is);
+          restored.m_nUSDuplicates = ReadValue<uint32_t> (is);
+          restored.m_nUSAcks = ReadValue<uint32_t> (is);
+          restored.m_nDSPacketsGenerated = ReadValue<uint32_t> (is);
+          restored.m_nDSPacketsSent = ReadValue<uint32_t> (is);
+          restored.m_nDSPacketsSentRW1 = ReadValue<uint32_t> (is);
+          restored.m_nDSPacketsSentRW2 = ReadValue<uint32_t> (is);
+          restored.m_nDSRetransmission = ReadValue<uint32_t> (is);
+          restored.m_nDSAcks = ReadValue<uint32_t> (is);
+
+          uint8_t nRows = ReadValue<uint8_t> (is);
+          for (uint8_t r = 0; r < nRows; r++)
+            {
+              LoRaWANAdrSnrRow row;
+              row.frameCounter = ReadValue<uint16_t> (is);
+              row.snrMax = ReadValue<double> (is);
+              row.gtwDiversity = ReadValue<uint8_t> (is);
+              row.nbTrans = ReadValue<uint8_t> (is);
+              row.nTransmissions = ReadValue<uint8_t> (is);
+              restored.m_frameSNRHistory.push_back (row);
+            }
+
+          LoRaWANEndDeviceInfoNS* info = ns ? ns->GetEndDeviceInfo (deviceAddr) : nullptr;
+          if (info && is)
+            {
+              // Only copy the persistent ADR state: the address, gateway pointers, timers and the DS queue belong to this run
+              info->m_rx1DROffset = restored.m_rx1DROffset;
+              info->m_marginDb = restored.m_marginDb;
+              info->m_setAdr = restored.m_setAdr;
+              info->m_framePending = restored.m_framePending;
+              info->m_setAck = restored.m_setAck;
+              info->m_lastTxPowerIndex = restored.m_lastTxPowerIndex;
+              info->m_lastDataRateIndex = restored.m_lastDataRateIndex;
+              info->m_lastChannelIndex = restored.m_lastChannelIndex;
+              info->m_lastCodeRate = restored.m_lastCodeRate;
+              info->m_fCntUp = restored.m_fCntUp;
+              info->m_fCntDown = restored.m_fCntDown;
+              info->m_nbTrans = restored.m_nbTrans;
+              info->m_channelMask = restored.m_channelMask;
+              info->m_nUSPackets = restored.m_nUSPackets;
+              info->m_nUniqueUSPackets = restored.m_nUniqueUSPackets;
+              info->m_nUSRetransmission = restored.m_nUSRetransmission;
+              info->m_nUSDuplicates = restored.m_nUSDuplicates;
+              info->m_nUSAcks = restored.m_nUSAcks;
+              info->m_nDSPacketsGenerated = restored.m_nDSPacketsGenerated;
+              info->m_nDSPacketsSent = restored.m_nDSPacketsSent;
+              info->m_nDSPacketsSentRW1 = restored.m_nDSPacketsSentRW1;
+              info->m_nDSPacketsSentRW2 = restored.m_nDSPacketsSentRW2;
+              info->m_nDSRetransmission = restored.m_nDSRetransmission;
+              info->m_nDSAcks = restored.m_nDSAcks;
+              info->m_frameSNRHistory = restored.m_frameSNRHistory;
+            }
+          else if (n != nodes.end ())
+            {
+              NS_LOG_WARN (this << " No network server state for end device " << Ipv4Address (deviceAddr) << ", skipping");
+            }
+        }
+
+      if (n != nodes.end ())
+        nRestored++;
+    }
+
+  if (!is)
+    {
+      NS_LOG_ERROR (this << " Snapshot file " << filename << " is truncated");
+      return false;
+    }
+
+  NS_LOG_INFO ("Restored " << nRestored << " of " << nEndDevices << " end devices from snapshot " << filename << " taken at " << NanoSeconds (savedAt).GetSeconds () << "s");
+  return true;
+}
+
+} // namespace ns3
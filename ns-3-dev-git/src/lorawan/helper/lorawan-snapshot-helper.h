@@ -0,0 +1,93 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+
+#ifndef LORAWAN_SNAPSHOT_HELPER_H
+#define LORAWAN_SNAPSHOT_HELPER_H
+
+#include <string>
+
+#include "ns3/node-container.h"
+
+#define LORAWAN_SNAPSHOT_VERSION 2
+
+namespace ns3 {
+
+/**
+ * \ingroup lorawan
+ *
+ * \brief Save and restore the ADR state of a LoRaWAN network
+ *
+ * ADR studies spend most of their simulated time waiting for the end devices
+ * to converge to their final data rate and tx power. This helper writes the
+ * converged state to a compact binary file, so that later runs can start from
+ * it in a freshly built (but identical) topology:
+ *
+ * - per end device: data rate index, tx power index, channel mask, uplink
+ *   frame counter and ADR ack counter of the LoRaWANEndDeviceApplication, and
+ *   the NbRep of its LoRaWANNetDevice
+ * - per end device: the LoRaWANEndDeviceInfoNS kept by the network server,
+ *   including the SNR history used by the NS side ADR algorithm
+ * - the positions of the RNG streams of the end device applications and of
+ *   the network server
+ *
+ * End devices are matched on their device address, so the restored topology
+ * must assign the same addresses (i.e. be built in the same order). Pending
+ * events such as scheduled transmissions, receive windows and queued DS
+ * packets are not part of the snapshot. The file is written in host byte
+ * order.
+ *
+ * Typical use:
+ * \code
+ *   LoRaWANSnapshotHelper snapshotHelper;
+ *   Simulator::Schedule (Seconds (600*250), &LoRaWANSnapshotHelper::Save, &snapshotHelper, "adr.snap", endDeviceNodes);
+ *   ...
+ *   // in a later run, after installing the applications and before Simulator::Run ():
+ *   snapshotHelper.Restore ("adr.snap", endDeviceNodes);
+ * \endcode
+ */
+class LoRaWANSnapshotHelper
+{
+public:
+  LoRaWANSnapshotHelper (void);
+
+  /**
+   * \brief Write the state of the given end devices and the network server to a file
+   * \param filename the snapshot file to create
+   * \param endDevices the nodes running a LoRaWANEndDeviceApplication
+   * \return true when the snapshot was written successfully
+   */
+  bool Save (std::string filename, NodeContainer endDevices) const;
+
+  /**
+   * \brief Restore the state of the given end devices and the network server from a file
+   *
+   * Should be called after the applications have been installed and before
+   * Simulator::Run (). The network server singleton is created if needed.
+   *
+   * \param filename the snapshot file to read
+   * \param endDevices the nodes running a LoRaWANEndDeviceApplication
+   * \return true when the snapshot was read and applied successfully
+   */
+  bool Restore (std::string filename, NodeContainer endDevices) const;
+};
+
+} // namespace ns3
+
+#endif /* LORAWAN_SNAPSHOT_HELPER_H */
@@ -0,0 +1,446 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+
+#include "lorawan-visual-trace-helper.h"
+#include "ns3/log.h"
+#include "ns3/node.h"
+#include "ns3/simulator.h"
+#include "ns3/mobility-model.h"
+#include "ns3/lorawan.h"
+#include "ns3/lorawan-net-device.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("LoRaWANVisualTraceHelper");
+
+namespace {
+
+const char g_visualTraceMagic[4] = {'L', 'W', 'V', 'T'};
+
+const char* g_outcomeNames[] = {"received", "interfered", "busy", "weak", "off"};
+
+// Sampled packets are forgotten this long after they were sent, longer than any LoRaWAN airtime
+const Time g_sampledLifetime = Seconds (10);
+
+template <typename T>
+void
+WriteValue (std::ostream &os, T value)
+{
+  os.write (reinterpret_cast<const char*> (&value), sizeof (T));
+}
+
+} // unnamed namespace
+
+LoRaWANVisualTraceHelper::LoRaWANVisualTraceHelper (void)
+  : m_binWidth (Seconds (60)),
+    m_packetSampling (0),
+    m_format (NDJSON),
+    m_nUplinks (0)
+{
+}
+
+LoRaWANVisualTraceHelper::~LoRaWANVisualTraceHelper (void)
+{
+  Close ();
+}
+
+void
+LoRaWANVisualTraceHelper::SetBinWidth (Time binWidth)
+{
+  NS_ASSERT (binWidth.IsStrictlyPositive ());
+  m_binWidth = binWidth;
+}
+
+void
+LoRaWANVisualTraceHelper::SetPacketSampling (uint32_t n)
+{
+  m_packetSampling = n;
+}
+
+bool
+LoRaWANVisualTraceHelper::Open (std::string filename, Format format)
+{
+  NS_LOG_FUNCTION (this << filename << format);
+
+  m_format = format;
+  m_os.open (filename.c_str (), format == BINARY ? std::ios::out | std::ios::binary : std::ios::out);
+  if (!m_os.is_open ()) {
+    NS_LOG_ERROR ("Unable to open visual trace file " << filename);
+    return false;
+  }
+
+  if (m_format == BINARY) {
+    m_os.write (g_visualTraceMagic, sizeof (g_visualTraceMagic));
+    WriteValue<uint8_t> (m_os, LORAWAN_VISUAL_TRACE_VERSION);
+    WriteValue<int64_t> (m_os, m_binWidth.GetNanoSeconds ());
+  } else {
+    m_os.precision (10);
+    m_os << "{\"type\":\"header\",\"version\":" << LORAWAN_VISUAL_TRACE_VERSION
+         << ",\"binWidth\":" << m_binWidth.GetSeconds () << "}\n";
+  }
+  return m_os.good ();
+}
+
+void
+LoRaWANVisualTraceHelper::Install (NodeContainer endDevices, NodeContainer gateways)
+{
+  NS_LOG_FUNCTION (this);
+  NS_ASSERT_MSG (m_os.is_open (), "Open the visual trace before installing it");
+
+  for (uint32_t role = 0; role < 2; role++) {
+    const bool gateway = role == 1;
+    NodeContainer& nodes = gateway ? gateways : endDevices;
+    for (NodeContainer::Iterator n = nodes.Begin (); n != nodes.End (); ++n) {
+      WriteNode ((*n)->GetId (), gateway, *n);
+
+      for (uint32_t d = 0; d < (*n)->GetNDevices (); d++) {
+        Ptr<LoRaWANNetDevice> device = DynamicCast<LoRaWANNetDevice> ((*n)->GetDevice (d));
+        if (!device)
+          continue;
+
+        std::vector<Ptr<LoRaWANPhy> > phys;
+        if (device->GetDeviceType () == LORAWAN_DT_GATEWAY)
+          phys = device->GetPhys ();
+        else
+          phys.push_back (device->GetPhy ());
+        for (auto phy : phys) {
+          m_sinks.push_back (PhySink ());
+          PhySink& sink = m_sinks.back ();
+          sink.m_trace = this;
+          sink.m_phy = phy;
+          sink.m_node = (*n)->GetId ();
+          sink.m_gateway = gateway;
+          sink.m_receiving = false;
+          sink.m_transmitting = false;
+          sink.m_lastDataRate = -1;
+          sink.m_lastTxPower = 0.0;
+          sink.m_pendingId = 0;
+          sink.m_pendingOutcome = OUTCOME_RECEIVED;
+          sink.m_pendingScheduled = false;
+
+          phy->TraceConnectWithoutContext ("PhyTxBegin", MakeCallback (&PhySink::TxBegin, &sink));
+          if (gateway) {
+            phy->TraceConnectWithoutContext ("PhyTxEnd", MakeCallback (&PhySink::TxEnd, &sink));
+            phy->TraceConnectWithoutContext ("PhyRxBegin", MakeCallback (&PhySink::RxBegin, &sink));
+            phy->TraceConnectWithoutContext ("PhyRxEnd", MakeCallback (&PhySink::RxEnd, &sink));
+            phy->TraceConnectWithoutContext ("PhyRxDrop", MakeCallback (&PhySink::RxDrop, &sink));
+          }
+        }
+      }
+    }
+  }
+
+  if (!m_endBinEvent.IsRunning ()) {
+    m_binStart = Simulator::Now ();
+    m_endBinEvent = Simulator::Schedule (m_binWidth, &LoRaWANVisualTraceHelper::EndBin, this);
+  }
+}
+
+void
+LoRaWANVisualTraceHelper::Close (void)
+{
+  if (!m_os.is_open ())
+    return;
+
+  NS_LOG_FUNCTION (this);
+  m_endBinEvent.Cancel ();
+  for (auto& sink : m_sinks) {
+    if (sink.m_receiving)
+      AccountAirtime (sink, true, false);
+    if (sink.m_transmitting)
+      AccountAirtime (sink, false, false);
+  }
+  WriteCells ();
+  m_os.close ();
+}
+
+uint64_t
+LoRaWANVisualTraceHelper::GetPacketId (Ptr<const Packet> packet)
+{
+  LoRaWANPhyTraceIdTag tag;
+  if (packet->PeekPacketTag (tag))
+    return tag.GetFlowId ();
+  return packet->GetUid ();
+}
+
+LoRaWANVisualTraceHelper::Cell&
+LoRaWANVisualTraceHelper::GetCell (uint32_t gateway, uint8_t channel)
+{
+  std::map<std::pair<uint32_t, uint8_t>, Cell>::iterator it = m_cells.find (std::make_pair (gateway, channel));
+  if (it == m_cells.end ()) {
+    Cell cell = {0, 0, 0, 0, 0, 0.0, 0.0};
+    it = m_cells.insert (std::make_pair (std::make_pair (gateway, channel), cell)).first;
+  }
+  return it->second;
+}
+
+void
+LoRaWANVisualTraceHelper::AccountAirtime (PhySink& sink, bool rx, bool end)
+{
+  const Time now = Simulator::Now ();
+  Time& accounted = rx ? sink.m_rxAccounted : sink.m_txAccounted;
+  if (now > accounted) {
+    Cell& cell = GetCell (sink.m_node, sink.m_phy->GetCurrentChannelIndex ());
+    (rx ? cell.m_rxAirtime : cell.m_txAirtime) += (now - accounted).GetSeconds ();
+    accounted = now;
+  }
+  if (end)
+    (rx ? sink.m_receiving : sink.m_transmitting) = false;
+}
+
+void
+LoRaWANVisualTraceHelper::EndBin (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  // airtime of receptions and transmissions in progress up to the end of the bin
+  for (auto& sink : m_sinks) {
+    if (sink.m_receiving)
+      AccountAirtime (sink, true, false);
+    if (sink.m_transmitting)
+      AccountAirtime (sink, false, false);
+  }
+  WriteCells ();
+
+  const Time now = Simulator::Now ();
+  while (!m_sampled.empty () && m_sampled.begin ()->second + g_sampledLifetime < now) {
+    // ids increase with time, so the oldest are first
+    m_sampled.erase (m_sampled.begin ());
+  }
+
+  m_binStart = now;
+  m_endBinEvent = Simulator::Schedule (m_binWidth, &LoRaWANVisualTraceHelper::EndBin, this);
+}
+
+void
+LoRaWANVisualTraceHelper::WriteCells (void)
+{
+  const double t = m_binStart.GetSeconds ();
+  for (const auto& it : m_cells) {
+    const Cell& cell = it.second;
+    if (m_format == BINARY) {
+      WriteValue<char> (m_os, 'C');
+      WriteValue<double> (m_os, t);
+      WriteValue<uint32_t> (m_os, it.first.first);
+      WriteValue<uint8_t> (m_os, it.first.second);
+      WriteValue<uint32_t> (m_os, cell.m_rx);
+      WriteValue<uint32_t> (m_os, cell.m_interfered);
+      WriteValue<uint32_t> (m_os, cell.m_busy);
+      WriteValue<uint32_t> (m_os, cell.m_weak);
+      WriteValue<uint32_t> (m_os, cell.m_off);
+      WriteValue<double> (m_os, cell.m_rxAirtime);
+      WriteValue<double> (m_os, cell.m_txAirtime);
+    } else {
+      m_os << "{\"type\":\"cell\",\"t\":" << t << ",\"gw\":" << it.first.first
+           << ",\"ch\":" << (unsigned)it.first.second << ",\"rx\":" << cell.m_rx
+           << ",\"interfered\":" << cell.m_interfered << ",\"busy\":" << cell.m_busy
+           << ",\"weak\":" << cell.m_weak << ",\"off\":" << cell.m_off
+           << ",\"rxAirtime\":" << cell.m_rxAirtime << ",\"txAirtime\":" << cell.m_txAirtime << "}\n";
+    }
+  }
+  m_cells.clear ();
+}
+
+bool
+LoRaWANVisualTraceHelper::IsSampled (uint64_t id) const
+{
+  return m_packetSampling > 0 && m_sampled.find (id) != m_sampled.end ();
+}
+
+void
+LoRaWANVisualTraceHelper::WriteNode (uint32_t node, bool gateway, Ptr<Node> object)
+{
+  Vector position;
+  Ptr<MobilityModel> mobility = object->GetObject<MobilityModel> ();
+  if (mobility)
+    position = mobility->GetPosition ();
+
+  if (m_format == BINARY) {
+    WriteValue<char> (m_os, 'N');
+    WriteValue<uint32_t> (m_os, node);
+    WriteValue<uint8_t> (m_os, gateway);
+    WriteValue<double> (m_os, position.x);
+    WriteValue<double> (m_os, position.y);
+    WriteValue<double> (m_os, position.z);
+  } else {
+    m_os << "{\"type\":\"node\",\"node\":" << node << ",\"role\":\"" << (gateway ? "gw" : "ed")
+         << "\",\"x\":" << position.x << ",\"y\":" << position.y << ",\"z\":" << position.z << "}\n";
+  }
+}
+
+void
+LoRaWANVisualTraceHelper::WriteSetting (uint32_t node, uint8_t dataRate, double txPower)
+{
+  const double t = Simulator::Now ().GetSeconds ();
+  if (m_format == BINARY) {
+    WriteValue<char> (m_os, 'S');
+    WriteValue<double> (m_os, t);
+    WriteValue<uint32_t> (m_os, node);
+    WriteValue<uint8_t> (m_os, dataRate);
+    WriteValue<double> (m_os, txPower);
+  } else {
+    m_os << "{\"type\":\"setting\",\"t\":" << t << ",\"node\":" << node
+         << ",\"dr\":" << (unsigned)dataRate << ",\"txPower\":" << txPower << "}\n";
+  }
+}
+
+void
+LoRaWANVisualTraceHelper::WriteTx (uint32_t node, uint64_t id, uint8_t channel, uint8_t dataRate, uint32_t size)
+{
+  const double t = Simulator::Now ().GetSeconds ();
+  if (m_format == BINARY) {
+    WriteValue<char> (m_os, 'T');
+    WriteValue<double> (m_os, t);
+    WriteValue<uint32_t> (m_os, node);
+    WriteValue<uint64_t> (m_os, id);
+    WriteValue<uint8_t> (m_os, channel);
+    WriteValue<uint8_t> (m_os, dataRate);
+    WriteValue<uint32_t> (m_os, size);
+  } else {
+    m_os << "{\"type\":\"tx\",\"t\":" << t << ",\"node\":" << node << ",\"id\":" << id
+         << ",\"ch\":" << (unsigned)channel << ",\"dr\":" << (unsigned)dataRate << ",\"size\":" << size << "}\n";
+  }
+}
+
+void
+LoRaWANVisualTraceHelper::WriteRx (uint32_t gateway, uint64_t id, Outcome outcome)
+{
+  const double t = Simulator::Now ().GetSeconds ();
+  if (m_format == BINARY) {
+    WriteValue<char> (m_os, 'R');
+    WriteValue<double> (m_os, t);
+    WriteValue<uint32_t> (m_os, gateway);
+    WriteValue<uint64_t> (m_os, id);
+    WriteValue<uint8_t> (m_os, outcome);
+  } else {
+    m_os << "{\"type\":\"rx\",\"t\":" << t << ",\"gw\":" << gateway << ",\"id\":" << id
+         << ",\"outcome\":\"" << g_outcomeNames[outcome] << "\"}\n";
+  }
+}
+
+void
+LoRaWANVisualTraceHelper::PhySink::TxBegin (Ptr<const Packet> packet)
+{
+  if (m_gateway) {
+    m_transmitting = true;
+    m_txAccounted = Simulator::Now ();
+    return;
+  }
+
+  const uint8_t dataRate = m_phy->GetCurrentDataRateIndex ();
+  const double txPower = m_phy->GetTxPower ();
+  if (m_lastDataRate != dataRate || m_lastTxPower != txPower) {
+    m_trace->WriteSetting (m_node, dataRate, txPower);
+    m_lastDataRate = dataRate;
+    m_lastTxPower = txPower;
+  }
+
+  if (m_trace->m_packetSampling > 0 && m_trace->m_nUplinks++ % m_trace->m_packetSampling == 0) {
+    const uint64_t id = GetPacketId (packet);
+    m_trace->m_sampled[id] = Simulator::Now ();
+    m_trace->WriteTx (m_node, id, m_phy->GetCurrentChannelIndex (), dataRate, packet->GetSize ());
+  }
+}
+
+void
+LoRaWANVisualTraceHelper::PhySink::TxEnd (Ptr<const Packet> packet)
+{
+  if (m_transmitting)
+    m_trace->AccountAirtime (*this, false, true);
+}
+
+void
+LoRaWANVisualTraceHelper::PhySink::RxBegin (Ptr<const Packet> packet)
+{
+  m_receiving = true;
+  m_rxAccounted = Simulator::Now ();
+}
+
+void
+LoRaWANVisualTraceHelper::PhySink::RxEnd (Ptr<const Packet> packet, double lqi)
+{
+  if (m_receiving)
+    m_trace->AccountAirtime (*this, true, true);
+  m_trace->GetCell (m_node, m_phy->GetCurrentChannelIndex ()).m_rx++;
+
+  // The PHY reports a reception destroyed by interference right after its end,
+  // so the outcome of a sampled packet is only known once this event is done
+  const uint64_t id = GetPacketId (packet);
+  if (m_trace->IsSampled (id)) {
+    m_pendingId = id;
+    m_pendingOutcome = OUTCOME_RECEIVED;
+    if (!m_pendingScheduled) {
+      m_pendingScheduled = true;
+      Simulator::ScheduleNow (&PhySink::WritePendingOutcome, this);
+    }
+  }
+}
+
+void
+LoRaWANVisualTraceHelper::PhySink::RxDrop (Ptr<const Packet> packet, LoRaWANPhyDropRxReason reason)
+{
+  Cell& cell = m_trace->GetCell (m_node, m_phy->GetCurrentChannelIndex ());
+  const uint64_t id = GetPacketId (packet);
+
+  Outcome outcome;
+  switch (reason) {
+    case LORAWAN_RX_DROP_PACKET_DESTOYED:
+    case LORAWAN_RX_DROP_PACKET_ABORTED:
+    case LORAWAN_RX_DROP_ABORTED:
+      // reported after PhyRxEnd, which counted the packet as received
+      outcome = reason == LORAWAN_RX_DROP_PACKET_DESTOYED ? OUTCOME_INTERFERED : OUTCOME_OFF;
+      if (cell.m_rx > 0)
+        cell.m_rx--;
+      if (m_pendingScheduled && m_pendingId == id) {
+        m_pendingOutcome = outcome;
+        outcome == OUTCOME_INTERFERED ? cell.m_interfered++ : cell.m_off++;
+        return;
+      }
+      break;
+    case LORAWAN_RX_DROP_PHY_BUSY_RX:
+      outcome = OUTCOME_BUSY;
+      break;
+    case LORAWAN_RX_DROP_SINR_TOO_LOW:
+      outcome = OUTCOME_WEAK;
+      break;
+    default:
+      outcome = OUTCOME_OFF;
+      break;
+  }
+
+  switch (outcome) {
+    case OUTCOME_INTERFERED: cell.m_interfered++; break;
+    case OUTCOME_BUSY: cell.m_busy++; break;
+    case OUTCOME_WEAK: cell.m_weak++; break;
+    default: cell.m_off++; break;
+  }
+
+  if (m_trace->IsSampled (id))
+    m_trace->WriteRx (m_node, id, outcome);
+}
+
+void
+LoRaWANVisualTraceHelper::PhySink::WritePendingOutcome (void)
+{
+  m_pendingScheduled = false;
+  m_trace->WriteRx (m_node, m_pendingId, m_pendingOutcome);
+}
+
+} // namespace ns3
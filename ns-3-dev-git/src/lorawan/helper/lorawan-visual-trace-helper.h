@@ -0,0 +1,213 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+
+#ifndef LORAWAN_VISUAL_TRACE_HELPER_H
+#define LORAWAN_VISUAL_TRACE_HELPER_H
+
+#include <deque>
+#include <fstream>
+#include <map>
+#include <string>
+
+#include "ns3/node-container.h"
+#include "ns3/nstime.h"
+#include "ns3/event-id.h"
+#include "ns3/packet.h"
+#include "ns3/lorawan-phy.h"
+
+#define LORAWAN_VISUAL_TRACE_VERSION 1
+
+namespace ns3 {
+
+/**
+ * \ingroup lorawan
+ *
+ * \brief Write a compact, aggregated trace of a LoRaWAN network for visualization
+ *
+ * NetAnim writes an XML element for every packet on every PHY (every
+ * gateway has a PHY per channel and data rate) and needs packet metadata,
+ * which makes traced runs several times slower. This helper instead writes
+ * time binned aggregates:
+ *
+ * - node: the position and role of every end device and gateway, once
+ * - cell: per bin, gateway and channel, the number of uplinks received and
+ *   the number lost to interference (interfered), to a reception in
+ *   progress (busy), to a too low SINR (weak) and because the PHY was not
+ *   listening (off), and the receive and transmit airtime of the gateway on
+ *   the channel in seconds. Only cells with activity are written.
+ * - setting: the data rate and tx power (dBm) of an end device, written at
+ *   the first uplink and at every uplink where they changed
+ * - tx, rx: optionally, one in every SetPacketSampling uplinks, with the
+ *   outcome at every gateway (received, interfered, busy, weak or off)
+ *
+ * Records are written as one JSON object per line (NDJSON) or in a binary
+ * format: the magic "LWVT", a uint8 version, the bin width as int64 ns, and
+ * then records of a type byte followed by the fields of the record, in host
+ * byte order:
+ *
+ * - 'N' node:    uint32 node, uint8 gateway, double x, double y, double z
+ * - 'C' cell:    double t, uint32 gateway, uint8 channel, uint32 rx,
+ *                uint32 interfered, uint32 busy, uint32 weak, uint32 off,
+ *                double rx airtime, double tx airtime
+ * - 'S' setting: double t, uint32 node, uint8 data rate, double tx power
+ * - 'T' tx:      double t, uint32 node, uint64 id, uint8 channel,
+ *                uint8 data rate, uint32 size
+ * - 'R' rx:      double t, uint32 gateway, uint64 id, uint8 outcome
+ *                (0 received, 1 interfered, 2 busy, 3 weak, 4 off)
+ *
+ * Times are in seconds; the t of a cell is the start of its bin. Packets are
+ * identified by the trace id the PHY gives every transmission.
+ *
+ * Typical use:
+ * \code
+ *   LoRaWANVisualTraceHelper visualTrace;
+ *   visualTrace.SetBinWidth (Seconds (60));
+ *   visualTrace.SetPacketSampling (100);
+ *   visualTrace.Open ("lorawan-visual.ndjson", LoRaWANVisualTraceHelper::NDJSON);
+ *   visualTrace.Install (endDeviceNodes, gatewayNodes);
+ *   Simulator::Run ();
+ *   visualTrace.Close ();
+ * \endcode
+ *
+ * The helper must outlive Simulator::Run (); it closes the trace when it is
+ * destroyed.
+ */
+class LoRaWANVisualTraceHelper
+{
+public:
+  enum Format
+  {
+    NDJSON,
+    BINARY
+  };
+
+  LoRaWANVisualTraceHelper (void);
+  ~LoRaWANVisualTraceHelper (void);
+
+  /**
+   * \brief Set the width of the bins of the cells, 60 s by default
+   */
+  void SetBinWidth (Time binWidth);
+
+  /**
+   * \brief Write tx and rx records for one in every n uplinks, 0 (the default) for none
+   */
+  void SetPacketSampling (uint32_t n);
+
+  /**
+   * \brief Create the trace file
+   * \return true when the file was opened successfully
+   */
+  bool Open (std::string filename, Format format);
+
+  /**
+   * \brief Trace the given end devices and gateways
+   *
+   * Should be called after the LoRaWAN net devices have been installed and
+   * the nodes have been given their position.
+   */
+  void Install (NodeContainer endDevices, NodeContainer gateways);
+
+  /**
+   * \brief Write the cells of the bin in progress and close the trace file
+   */
+  void Close (void);
+
+private:
+  /** The counters of a gateway on a channel in the current bin */
+  struct Cell
+  {
+    uint32_t m_rx;
+    uint32_t m_interfered;
+    uint32_t m_busy;
+    uint32_t m_weak;
+    uint32_t m_off;
+    double m_rxAirtime;
+    double m_txAirtime;
+  };
+
+  enum Outcome
+  {
+    OUTCOME_RECEIVED = 0,
+    OUTCOME_INTERFERED = 1,
+    OUTCOME_BUSY = 2,
+    OUTCOME_WEAK = 3,
+    OUTCOME_OFF = 4
+  };
+
+  /** The trace sinks of a single PHY */
+  class PhySink
+  {
+  public:
+    void TxBegin (Ptr<const Packet> packet);
+    void TxEnd (Ptr<const Packet> packet);
+    void RxBegin (Ptr<const Packet> packet);
+    void RxEnd (Ptr<const Packet> packet, double lqi);
+    void RxDrop (Ptr<const Packet> packet, LoRaWANPhyDropRxReason reason);
+    void WritePendingOutcome (void);
+
+    LoRaWANVisualTraceHelper* m_trace;
+    Ptr<LoRaWANPhy> m_phy;
+    uint32_t m_node;
+    bool m_gateway;
+
+    bool m_receiving;
+    Time m_rxAccounted;  //!< airtime of the reception in progress is accounted up to here
+    bool m_transmitting;
+    Time m_txAccounted;
+
+    int m_lastDataRate;  //!< of the end device, -1 before its first uplink
+    double m_lastTxPower;
+
+    uint64_t m_pendingId;  //!< sampled packet whose reception outcome is about to be written
+    Outcome m_pendingOutcome;
+    bool m_pendingScheduled;
+  };
+
+  static uint64_t GetPacketId (Ptr<const Packet> packet);
+
+  Cell& GetCell (uint32_t gateway, uint8_t channel);
+  void AccountAirtime (PhySink& sink, bool rx, bool end);
+  void EndBin (void);
+  void WriteCells (void);
+  bool IsSampled (uint64_t id) const;
+
+  void WriteNode (uint32_t node, bool gateway, Ptr<Node> object);
+  void WriteSetting (uint32_t node, uint8_t dataRate, double txPower);
+  void WriteTx (uint32_t node, uint64_t id, uint8_t channel, uint8_t dataRate, uint32_t size);
+  void WriteRx (uint32_t gateway, uint64_t id, Outcome outcome);
+
+  Time m_binWidth;
+  uint32_t m_packetSampling;
+  Format m_format;
+  std::ofstream m_os;
+
+  Time m_binStart;
+  EventId m_endBinEvent;
+  std::map<std::pair<uint32_t, uint8_t>, Cell> m_cells;
+
+  std::deque<PhySink> m_sinks;
+  uint64_t m_nUplinks;
+  std::map<uint64_t, Time> m_sampled;  //!< ids of the sampled packets and when they were sent
+};
+
+} // namespace ns3
+
+#endif /* LORAWAN_VISUAL_TRACE_HELPER_H */
@@ -0,0 +1,484 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+
+#include "lorawan-adr-policy.h"
+#include "lorawan-phy.h"
+#include <ns3/log.h>
+#include <ns3/simulator.h>
+#include <ns3/double.h>
+#include <ns3/uinteger.h>
+#include <ns3/trace-source-accessor.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("LoRaWANAdrPolicy");
+
+NS_OBJECT_ENSURE_REGISTERED (LoRaWANAdrPolicy);
+NS_OBJECT_ENSURE_REGISTERED (LoRaWANSemtechAdrPolicy);
+NS_OBJECT_ENSURE_REGISTERED (LoRaWANGlobalAdrPolicy);
+
+TypeId
+LoRaWANAdrPolicy::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::LoRaWANAdrPolicy")
+    .SetParent<Object> ()
+    .SetGroupName ("LoRaWAN")
+  ;
+  return tid;
+}
+
+void
+LoRaWANAdrPolicy::NotifyUplink (LoRaWANNetworkServer& ns, uint32_t deviceAddr, LoRaWANEndDeviceInfoNS& info)
+{
+}
+
+TypeId
+LoRaWANSemtechAdrPolicy::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::LoRaWANSemtechAdrPolicy")
+    .SetParent<LoRaWANAdrPolicy> ()
+    .SetGroupName ("LoRaWAN")
+    .AddConstructor<LoRaWANSemtechAdrPolicy> ()
+  ;
+  return tid;
+}
+
+LoRaWANADRAlgoritmResult
+LoRaWANSemtechAdrPolicy::Run (LoRaWANNetworkServer& ns, uint32_t deviceAddr, LoRaWANEndDeviceInfoNS& info)
+{
+  //the algorithm from Semtech
+  /*
+  Each time a node performs an uplink transmission, the frame may be received by several gateways. Inside each of the gateways, the frame is tagged with its signal 
+  strength (RSSI) and Signal to Noise ratio in dB (SNR). The gateways then forward the tagged frame to the network server.
+
+So for a given frame the server will receive several copies, each coming from a different gateway and tagged with different RSSI and SNR values.
+
+For a given frame, the notation {gatewayID , frame_nb, SNR} represents the SNR measured by gateway ID.
+
+Each frame features a 16 bits frame counter (F) field which is incremented with every transmission.
+
+So for each transmission of a given node (DevAddr) we define the notation SNRmax(devAddr,F) where:
+
+* F is the value of the frame counter of the frame
+
+* DevAddr is the network address of the node as defined in the LoRaWAN spec
+
+* SNRmax is the maximum of the various SNRs reported by the different gateways who received this given frame.
+
+For each node taken into account by the algorithm, the following inputs must be available in memory.
+
+1. The frame counter values of the last 20 received frames Fn, Fn-1 .. , Fn-19
+
+2. The list of the 20 associated SNRmax(DevAddr, Fn to n-19)
+
+3. The number of gateway which received each of the frame (the receive diversity) GtwDiversity(devAddr,Fn to n-19) [not yet used by this algorithm , reserved for future use] 
+
+Each time a new frame with frame counter N+x reaches the server, the SNRmax(Nif,Fn-x) value is computed by analyzing the multiple instances of the frame reported by the different gateways.
+
+The triplet {N+x , SNRmax(devAddr,Fn-x) , GtwDiversity(devAddr,Fn+x)} is inserted at the end table. Each time a new line is inserted at the end of the table, the lines 2 to 19 are 
+shifted up and the first line is discarded so as to keep the length of the table constantly equal to 20. If a frame is retransmitted several time by the end-device (same frame counter) 
+only the best transmission is kept. That means that if a frame with the same frame counter value than the newly received frame already exists in the table (it can only be the last one) 
+then the SNRmax value is updated if the new frame SNRmax value is greater than the one already stored in the table. 
+
+Each time the server decides to send an ADR command to a node, it uses the previously described data structure to perform the following computations.
+
+First the Max (not average) SNR (SNRm) is computed over the middle column of the table. Then we compute:
+
+SNRmargin = SNRm – SNR(DR) - margin_db
+
+* Where margin_db is the installation margin of the network (typically 10dB in most networks), this is a device specific static parameter. This may be part of a device profile.
+
+* Where SNR(DR) is the required SNR to successfully demodulate as a function of Data Rate given in the following table. DR is the data rate of the end-device’s last received frame. 
+  */
+
+  //this function is called when the server decides to send an ADR command to a node.
+
+  if(info.m_lastDataRateIndex == LoRaWAN::m_maxUplinkDataRateIndex && info.m_lastTxPowerIndex == 7) 
+  {
+      NS_LOG_INFO("Running ADR, for device " << deviceAddr << " but device already uses the fastest DR and lowest TX power");
+      LoRaWANADRAlgoritmResult adrRes = {true, info.m_lastDataRateIndex, info.m_lastTxPowerIndex, ns.ComputeChannelMask (info), 0, ns.ComputeNbTrans (info)};
+      return adrRes;   
+  }
+
+  //calculate SNRm - the max SNR over the table
+  double snrM = -128.0;
+  for (auto & row : info.m_frameSNRHistory) {
+    if(row.snrMax > snrM) {
+      snrM = row.snrMax;
+    }
+
+    if(row.snrMax == 0.0) {
+      NS_LOG_ERROR(this << "snrMax was zero exactly.");
+    }
+  }
+  
+  //compute SNRmargin = SNRm - SNR(DR) - margin_db
+  //margin_db is the installation margin of the network, and is a device specific static parameter (typically 10dB but tunable. 5dB is default - lower margin_db uses higher data rates generally, so less reliability but more energy efficiency)
+  //SNR(DR) is as follows:
+  /*
+  Data Rate   | Required SNR
+  DR0         |   -20
+  DR1         |   -17.5
+  DR2         |   -15
+  DR3         |   -12.5
+  DR4         |   -10
+  DR5         |   -7.5
+  */ 
+  double snrDr = ns.GetADRRequiredSNR (info.m_lastDataRateIndex);
+
+  double SNRmargin = snrM - snrDr - info.m_marginDb;
+  
+  int nStep = int(SNRmargin/3);
+  
+
+  uint8_t dr = info.m_lastDataRateIndex;
+  uint8_t tx = info.m_lastTxPowerIndex; //The device is to presume the power level is 0 (max) unless it changes it. (This will go out of sync sometimes between ns and ed). 
+
+  NS_LOG_INFO ("ADR Info: snrM: " << snrM << " snrDr: " << snrDr << " SNRmargin " << SNRmargin << " nStep " << nStep << " dr " << dr << " tx " << tx);
+
+  //then run this algorithm:
+  LoRaWANNetworkServer::ApplyADRSteps (nStep, dr, tx);
+
+  // NbTrans and the channel mask are set with the same LinkADRReq
+  const uint8_t nbTrans = ns.ComputeNbTrans (info);
+  const uint16_t channelMask = ns.ComputeChannelMask (info);
+  NS_LOG_INFO ("ADR Info: frame loss " << LoRaWANNetworkServer::GetFrameLossRate (info.m_frameSNRHistory) << " nbTrans " << (uint16_t)nbTrans << " channelMask " << channelMask);
+
+  LoRaWANADRAlgoritmResult adrRes;
+  if(dr == info.m_lastDataRateIndex && tx == info.m_lastTxPowerIndex) {
+    //no change required
+    NS_LOG_INFO("ADR ran, no change required");
+    adrRes = {true, dr, tx, channelMask, 0, nbTrans};
+  }
+  else
+  {
+    info.m_lastTxPowerIndex = tx; //the tx power index is maintained on this side, the new dr will be saved after the next uplink is received.
+    NS_LOG_INFO ("ADR Info: new dr " << dr << " new tx " << tx);
+    adrRes = {true, dr, tx, channelMask, 0, nbTrans};
+  }
+   
+  return adrRes;
+}
+
+TypeId
+LoRaWANGlobalAdrPolicy::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::LoRaWANGlobalAdrPolicy")
+    .SetParent<LoRaWANSemtechAdrPolicy> ()
+    .SetGroupName ("LoRaWAN")
+    .AddConstructor<LoRaWANGlobalAdrPolicy> ()
+    .AddAttribute ("Interval",
+                   "The time between two optimization rounds, the first round is one Interval after the first uplink.",
+                   TimeValue (Hours (1)),
+                   MakeTimeAccessor (&LoRaWANGlobalAdrPolicy::m_interval),
+                   MakeTimeChecker (Seconds (1)))
+    .AddAttribute ("AirtimeWeight",
+                   "The cost of a second of airtime relative to a second of airtime lost in collisions. Higher values keep more end devices on their fastest data rate.",
+                   DoubleValue (0.1),
+                   MakeDoubleAccessor (&LoRaWANGlobalAdrPolicy::m_airtimeWeight),
+                   MakeDoubleChecker<double> (0.0))
+    .AddAttribute ("MaxPasses",
+                   "The maximum number of passes of the local search over all end devices in a round.",
+                   UintegerValue (10),
+                   MakeUintegerAccessor (&LoRaWANGlobalAdrPolicy::m_maxPasses),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddTraceSource ("nrMoves",
+                     "The number of times the optimizer changed the data rate of an end device",
+                     MakeTraceSourceAccessor (&LoRaWANGlobalAdrPolicy::m_nrMoves),
+                     "ns3::TracedValueCallback::Uint32")
+  ;
+  return tid;
+}
+
+LoRaWANGlobalAdrPolicy::LoRaWANGlobalAdrPolicy ()
+  : m_lastRound (Seconds (0)),
+    m_ns (nullptr),
+    m_nrMoves (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+LoRaWANGlobalAdrPolicy::~LoRaWANGlobalAdrPolicy ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+LoRaWANGlobalAdrPolicy::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_roundEvent.Cancel ();
+  m_ns = nullptr;
+  m_devices.clear ();
+  m_deviceIndex.clear ();
+  m_gatewayIndex.clear ();
+  m_cellLoad.clear ();
+  LoRaWANSemtechAdrPolicy::DoDispose ();
+}
+
+LoRaWANADRAlgoritmResult
+LoRaWANGlobalAdrPolicy::Run (LoRaWANNetworkServer& ns, uint32_t deviceAddr, LoRaWANEndDeviceInfoNS& info)
+{
+  auto it = m_deviceIndex.find (deviceAddr);
+  if (it == m_deviceIndex.end ())
+    return LoRaWANSemtechAdrPolicy::Run (ns, deviceAddr, info);
+
+  const Device& device = m_devices[it->second];
+
+  // The link may have degraded since the last round, leave it to the per device algorithm to raise the tx power
+  double snrM = -128.0;
+  for (auto & row : info.m_frameSNRHistory)
+    snrM = std::max (snrM, row.snrMax);
+  const double margin = snrM + 2.0 * info.m_lastTxPowerIndex - info.m_marginDb - ns.GetADRRequiredSNR (device.m_dataRateIndex) - 2.0 * device.m_txPowerIndex;
+  if (margin < 0.0) {
+    NS_LOG_INFO ("ADR Info: assignment of device " << deviceAddr << " is " << -margin << "dB short, running the per device algorithm");
+    return LoRaWANSemtechAdrPolicy::Run (ns, deviceAddr, info);
+  }
+
+  NS_LOG_INFO ("ADR Info: device " << deviceAddr << " assigned dr " << (uint16_t)device.m_dataRateIndex << " tx " << (uint16_t)device.m_txPowerIndex);
+  LoRaWANADRAlgoritmResult adrRes = {true, device.m_dataRateIndex, device.m_txPowerIndex, ns.ComputeChannelMask (info), 0, ns.ComputeNbTrans (info)};
+  return adrRes;
+}
+
+void
+LoRaWANGlobalAdrPolicy::NotifyUplink (LoRaWANNetworkServer& ns, uint32_t deviceAddr, LoRaWANEndDeviceInfoNS& info)
+{
+  if (m_ns)
+    return;
+
+  m_ns = &ns;
+  m_lastRound = Simulator::Now ();
+  m_roundEvent = Simulator::Schedule (m_interval, &LoRaWANGlobalAdrPolicy::OptimizeRound, this);
+}
+
+void
+LoRaWANGlobalAdrPolicy::OptimizeRound (void)
+{
+  NS_LOG_FUNCTION (this);
+  NS_ASSERT (m_ns);
+
+  Optimize (*m_ns);
+  m_roundEvent = Simulator::Schedule (m_interval, &LoRaWANGlobalAdrPolicy::OptimizeRound, this);
+}
+
+uint32_t
+LoRaWANGlobalAdrPolicy::Optimize (LoRaWANNetworkServer& ns)
+{
+  NS_LOG_FUNCTION (this);
+
+  const double elapsed = (Simulator::Now () - m_lastRound).GetSeconds ();
+  m_lastRound = Simulator::Now ();
+  const uint8_t nUplinkChannels = LoRaWAN::m_nUplinkChannels;
+  const uint8_t maxDataRateIndex = std::min<uint8_t> (LoRaWAN::m_maxUplinkDataRateIndex, ADR_N_DATA_RATES - 1);
+
+  // Refresh the margins, gateways and uplink rates of the end devices, the
+  // assignments of the previous round are the starting point of the search
+  for (auto & cell : m_cellLoad)
+    cell.fill (0.0);
+  for (auto & device : m_devices)
+    device.m_active = false;
+  const std::vector<uint32_t> deviceAddrs = ns.GetEndDeviceAddresses ();
+  for (uint32_t deviceAddr : deviceAddrs) {
+    const LoRaWANEndDeviceInfoNS* info = ns.GetEndDeviceInfo (deviceAddr);
+    if (info->m_frameSNRHistory.empty () || info->m_lastGWs.empty ())
+      continue;
+
+    auto it = m_deviceIndex.find (deviceAddr);
+    if (it == m_deviceIndex.end ()) {
+      Device device;
+      device.m_deviceAddr = deviceAddr;
+      device.m_dataRateIndex = std::min<uint8_t> (info->m_lastDataRateIndex, maxDataRateIndex);
+      device.m_txPowerIndex = info->m_lastTxPowerIndex;
+      device.m_nUSTransmissions = 0;
+      it = m_deviceIndex.insert (std::make_pair (deviceAddr, m_devices.size ())).first;
+      m_devices.push_back (device);
+    }
+    Device& device = m_devices[it->second];
+    device.m_active = true;
+
+    double snrM = -128.0;
+    for (auto & row : info->m_frameSNRHistory)
+      snrM = std::max (snrM, row.snrMax);
+    // every tx power index below the maximum costs 2dB of SNR
+    device.m_snrMargin = snrM + 2.0 * info->m_lastTxPowerIndex - info->m_marginDb;
+    device.m_maxDataRateIndex = 0; // DR0 when no data rate is feasible, it has the best chance
+    for (uint8_t dr = 1; dr <= maxDataRateIndex; dr++)
+      if (device.m_snrMargin >= ns.GetADRRequiredSNR (dr))
+        device.m_maxDataRateIndex = dr;
+    device.m_dataRateIndex = std::min (device.m_dataRateIndex, device.m_maxDataRateIndex);
+
+    device.m_gateways.clear ();
+    for (const auto& gateway : info->m_lastGWs)
+      device.m_gateways.push_back (GetGatewayIndex (gateway));
+
+    // m_nUSPackets counts every gateway copy, the duplicates are the copies after the first one. The transmissions
+    // include retransmissions, which use airtime as well. The counters of the NS go back when a snapshot is restored,
+    // then only the uplinks since the restore are known.
+    const uint32_t nUSTransmissions = info->m_nUSPackets >= info->m_nUSDuplicates ? info->m_nUSPackets - info->m_nUSDuplicates : 0;
+    const uint32_t nNewUSTransmissions = nUSTransmissions >= device.m_nUSTransmissions ? nUSTransmissions - device.m_nUSTransmissions : nUSTransmissions;
+    const double rate = elapsed > 0.0 ? nNewUSTransmissions / elapsed : 0.0;
+    device.m_nUSTransmissions = nUSTransmissions;
+    const uint8_t codeRate = info->m_lastCodeRate > 0 ? info->m_lastCodeRate : 1;
+    device.m_load.fill (0.0);
+    for (uint8_t dr = 0; dr <= maxDataRateIndex; dr++)
+      device.m_load[dr] = rate * LoRaWANPhy::CalculateTxTime (info->m_lastPhyPayloadSize, 0, dr, codeRate, 8, true).GetSeconds () / nUplinkChannels;
+
+    for (uint32_t g : device.m_gateways)
+      m_cellLoad[g][device.m_dataRateIndex] += device.m_load[device.m_dataRateIndex];
+  }
+
+  // Local search: move every end device to the data rate that lowers the cost most
+  std::vector<uint8_t> previous (m_devices.size ());
+  for (uint32_t i = 0; i < m_devices.size (); i++)
+    previous[i] = m_devices[i].m_dataRateIndex;
+  uint32_t nPasses = 0;
+  bool improved = true;
+  while (improved && nPasses < m_maxPasses) {
+    improved = false;
+    nPasses++;
+    for (auto & device : m_devices) {
+      // the gateways and load of an end device skipped by this round are stale, and are not in the cells
+      if (!device.m_active)
+        continue;
+      uint8_t best = device.m_dataRateIndex;
+      double bestDelta = 0.0;
+      for (uint8_t dr = 0; dr <= device.m_maxDataRateIndex; dr++) {
+        if (dr == device.m_dataRateIndex)
+          continue;
+        const double delta = MoveCost (device, dr);
+        if (delta < bestDelta) {
+          bestDelta = delta;
+          best = dr;
+        }
+      }
+      if (best != device.m_dataRateIndex) {
+        Move (device, device.m_dataRateIndex, best);
+        device.m_dataRateIndex = best;
+        improved = true;
+      }
+    }
+  }
+
+  // Spend the margin left at the assigned data rate on a lower tx power
+  uint32_t nChanged = 0;
+  for (uint32_t i = 0; i < m_devices.size (); i++) {
+    Device& device = m_devices[i];
+    if (!device.m_active)
+      continue;
+    if (device.m_dataRateIndex != previous[i])
+      m_nrMoves++;
+
+    const double margin = device.m_snrMargin - ns.GetADRRequiredSNR (device.m_dataRateIndex);
+    const uint8_t txPowerIndex = margin > 0.0 ? std::min (int (margin / 3), 7) : 0;
+    if (device.m_dataRateIndex != previous[i] || txPowerIndex != device.m_txPowerIndex)
+      nChanged++;
+    device.m_txPowerIndex = txPowerIndex;
+
+    // also repeated when the end device did not apply an earlier assignment
+    LoRaWANEndDeviceInfoNS* info = ns.GetEndDeviceInfo (device.m_deviceAddr);
+    if (device.m_dataRateIndex != info->m_lastDataRateIndex || txPowerIndex != info->m_lastTxPowerIndex)
+      info->m_setAdr = true; // sent with the next downlink
+  }
+
+  NS_LOG_INFO ("ADR Info: optimized " << m_devices.size () << " devices over " << m_cellLoad.size () << " gateways in " << nPasses << " passes, "
+               << nChanged << " changed, cost " << GetCost ());
+  return nChanged;
+}
+
+double
+LoRaWANGlobalAdrPolicy::CellCost (double load) const
+{
+  // airtime lost in collisions under pure ALOHA, plus the airtime itself
+  return load * (1.0 - std::exp (-2.0 * load)) + m_airtimeWeight * load;
+}
+
+double
+LoRaWANGlobalAdrPolicy::MoveCost (const Device& device, uint8_t dataRateIndex) const
+{
+  const uint8_t from = device.m_dataRateIndex;
+  double delta = 0.0;
+  for (uint32_t g : device.m_gateways) {
+    const double loadFrom = m_cellLoad[g][from];
+    const double loadTo = m_cellLoad[g][dataRateIndex];
+    delta += CellCost (loadFrom - device.m_load[from]) - CellCost (loadFrom)
+           + CellCost (loadTo + device.m_load[dataRateIndex]) - CellCost (loadTo);
+  }
+  return delta;
+}
+
+void
+LoRaWANGlobalAdrPolicy::Move (const Device& device, uint8_t from, uint8_t to)
+{
+  for (uint32_t g : device.m_gateways) {
+    m_cellLoad[g][from] = std::max (0.0, m_cellLoad[g][from] - device.m_load[from]);
+    m_cellLoad[g][to] += device.m_load[to];
+  }
+}
+
+uint32_t
+LoRaWANGlobalAdrPolicy::GetGatewayIndex (Ptr<LoRaWANGatewayApplication> gateway)
+{
+  auto it = m_gatewayIndex.find (PeekPointer (gateway));
+  if (it != m_gatewayIndex.end ())
+    return it->second;
+
+  const uint32_t index = m_cellLoad.size ();
+  m_gatewayIndex[PeekPointer (gateway)] = index;
+  m_cellLoad.push_back (std::array<double, ADR_N_DATA_RATES> ());
+  m_cellLoad.back ().fill (0.0);
+  return index;
+}
+
+bool
+LoRaWANGlobalAdrPolicy::GetAssignment (uint32_t deviceAddr, uint8_t& dataRateIndex, uint8_t& txPowerIndex) const
+{
+  auto it = m_deviceIndex.find (deviceAddr);
+  if (it == m_deviceIndex.end ())
+    return false;
+
+  dataRateIndex = m_devices[it->second].m_dataRateIndex;
+  txPowerIndex = m_devices[it->second].m_txPowerIndex;
+  return true;
+}
+
+double
+LoRaWANGlobalAdrPolicy::GetLoad (Ptr<LoRaWANGatewayApplication> gateway, uint8_t dataRateIndex) const
+{
+  NS_ASSERT (dataRateIndex < ADR_N_DATA_RATES);
+  auto it = m_gatewayIndex.find (PeekPointer (gateway));
+  if (it == m_gatewayIndex.end ())
+    return 0.0;
+  return m_cellLoad[it->second][dataRateIndex];
+}
+
+double
+LoRaWANGlobalAdrPolicy::GetCost (void) const
+{
+  double cost = 0.0;
+  for (const auto& cell : m_cellLoad)
+    for (double load : cell)
+      cost += CellCost (load);
+  return cost;
+}
+
+} // namespace ns3
@@ -0,0 +1,209 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+#ifndef LORAWAN_ADR_POLICY_H
+#define LORAWAN_ADR_POLICY_H
+
+#include "lorawan-gateway-application.h"
+#include <ns3/object.h>
+#include <ns3/nstime.h>
+#include <ns3/event-id.h>
+#include <ns3/traced-value.h>
+
+#include <array>
+#include <unordered_map>
+#include <vector>
+
+#define ADR_N_DATA_RATES 6 // DR0 up to DR5, the data rates ADR assigns (up to DR3 in US915)
+
+namespace ns3 {
+
+/**
+ * \ingroup lorawan
+ *
+ * The policy the network server uses to select the data rate, tx power,
+ * NbTrans and channel mask it sends to an end device in a LinkADRReq.
+ *
+ * The policy is run whenever the network server adds ADR settings to a
+ * downlink, i.e. every ADR_FREQUENCY new uplinks of an end device or when
+ * the policy sets m_setAdr of the end device itself. The network server only
+ * sends the LinkADRReq when the result differs from the settings of the end
+ * device.
+ */
+class LoRaWANAdrPolicy : public Object
+{
+public:
+  static TypeId GetTypeId (void);
+
+  /**
+   * \brief Select the ADR settings of an end device
+   *
+   * \param ns the network server
+   * \param deviceAddr the device address of the end device
+   * \param info the NS side state of the end device
+   */
+  virtual LoRaWANADRAlgoritmResult Run (LoRaWANNetworkServer& ns, uint32_t deviceAddr, LoRaWANEndDeviceInfoNS& info) = 0;
+
+  /**
+   * \brief Called for every new uplink frame processed by the network server,
+   * after it was added to the SNR history of the end device
+   */
+  virtual void NotifyUplink (LoRaWANNetworkServer& ns, uint32_t deviceAddr, LoRaWANEndDeviceInfoNS& info);
+};
+
+/**
+ * \ingroup lorawan
+ *
+ * The per device ADR algorithm of Semtech, with the steps of the Things
+ * Network implementation: the data rate is raised, and then the tx power
+ * lowered, by one step for every 3dB of SNR margin. The SNR margin is the
+ * best SNR in the history of the end device, minus the SNR required at its
+ * data rate and the installation margin. NbTrans and the channel mask are
+ * selected by the network server, see ComputeNbTrans and ComputeChannelMask.
+ *
+ * This is the default policy.
+ */
+class LoRaWANSemtechAdrPolicy : public LoRaWANAdrPolicy
+{
+public:
+  static TypeId GetTypeId (void);
+
+  virtual LoRaWANADRAlgoritmResult Run (LoRaWANNetworkServer& ns, uint32_t deviceAddr, LoRaWANEndDeviceInfoNS& info);
+};
+
+/**
+ * \ingroup lorawan
+ *
+ * Network wide ADR that balances the airtime load of the data rates at every
+ * gateway.
+ *
+ * The per device algorithm puts every end device with enough SNR margin on
+ * DR5, so that under load the collisions on DR5 limit the capacity, while the
+ * other data rates, which are nearly orthogonal to DR5, are idle. Every
+ * Interval, this policy reassigns the data rates of all end devices together.
+ *
+ * The offered load G of a (gateway, data rate) cell is the airtime per second
+ * per uplink channel of the end devices that were heard by the gateway and
+ * are assigned the data rate. The policy minimizes
+ *
+ *   sum over all cells of G (1 - exp (-2G)) + AirtimeWeight * G
+ *
+ * i.e. the airtime lost in collisions of pure ALOHA, plus a cost for the
+ * airtime itself so that end devices are only slowed down to relieve a
+ * congested cell. An end device may use the data rates at which its best SNR,
+ * at the maximum tx power, is at least the installation margin above the
+ * required SNR.
+ *
+ * The solver is a local search that starts from the assignment of the
+ * previous round: end devices are moved one at a time to the data rate that
+ * lowers the cost most, until no move lowers it or MaxPasses passes over the
+ * end devices were made. A move only changes the cells of the gateways that
+ * heard the end device, so it is evaluated in constant time per gateway and
+ * the load of the cells is updated incrementally. After the search, the tx
+ * power of every end device uses up the margin left at its data rate, in the
+ * steps of the Semtech algorithm.
+ *
+ * End devices whose data rate or tx power changed get a LinkADRReq with
+ * their next downlink. End devices that have not been assigned a data rate
+ * yet use the Semtech algorithm.
+ */
+class LoRaWANGlobalAdrPolicy : public LoRaWANSemtechAdrPolicy
+{
+public:
+  static TypeId GetTypeId (void);
+
+  LoRaWANGlobalAdrPolicy ();
+  virtual ~LoRaWANGlobalAdrPolicy ();
+
+  virtual LoRaWANADRAlgoritmResult Run (LoRaWANNetworkServer& ns, uint32_t deviceAddr, LoRaWANEndDeviceInfoNS& info);
+  /**
+   * Starts the periodic optimization at the first uplink
+   */
+  virtual void NotifyUplink (LoRaWANNetworkServer& ns, uint32_t deviceAddr, LoRaWANEndDeviceInfoNS& info);
+
+  /**
+   * \brief Run one optimization round over all end devices of a network server
+   *
+   * The uplink rate of an end device is measured over the time since the
+   * previous round, counting every transmission once whatever the number of
+   * gateways that received it. End devices without SNR history or without
+   * gateways for their last uplink are skipped and keep their assignment.
+   *
+   * \return the number of end devices whose data rate or tx power changed
+   */
+  uint32_t Optimize (LoRaWANNetworkServer& ns);
+
+  /**
+   * \brief The data rate and tx power assigned to an end device by the last round
+   * \return false if the end device has no assignment
+   */
+  bool GetAssignment (uint32_t deviceAddr, uint8_t& dataRateIndex, uint8_t& txPowerIndex) const;
+  /**
+   * \brief The offered load of a cell, in airtime per second per uplink channel
+   */
+  double GetLoad (Ptr<LoRaWANGatewayApplication> gateway, uint8_t dataRateIndex) const;
+  /**
+   * \brief The value of the cost function for the current assignment
+   */
+  double GetCost (void) const;
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  typedef struct
+  {
+    uint32_t m_deviceAddr;
+    std::vector<uint32_t> m_gateways;  //!< indices of the gateways that heard the last uplink
+    double m_snrMargin;                //!< best SNR at max tx power minus the installation margin
+    uint8_t m_maxDataRateIndex;        //!< fastest data rate the end device can use
+    uint8_t m_dataRateIndex;           //!< assigned data rate
+    uint8_t m_txPowerIndex;            //!< assigned tx power
+    std::array<double, ADR_N_DATA_RATES> m_load; //!< offered load per uplink channel at every data rate
+    uint32_t m_nUSTransmissions;       //!< uplink transmissions received up to the previous round, gateway copies counted once
+    bool m_active;                     //!< refreshed by the current round, only active end devices are moved by the search
+  } Device;
+
+  void OptimizeRound (void);
+  double CellCost (double load) const;
+  /**
+   * \brief The change of the cost when an end device moves to another data rate
+   */
+  double MoveCost (const Device& device, uint8_t dataRateIndex) const;
+  void Move (const Device& device, uint8_t from, uint8_t to);
+  uint32_t GetGatewayIndex (Ptr<LoRaWANGatewayApplication> gateway);
+
+  Time m_interval;
+  double m_airtimeWeight;
+  uint32_t m_maxPasses;
+
+  std::vector<Device> m_devices;
+  std::unordered_map<uint32_t, uint32_t> m_deviceIndex;  //!< device address to index in m_devices
+  std::unordered_map<const LoRaWANGatewayApplication*, uint32_t> m_gatewayIndex;
+  std::vector< std::array<double, ADR_N_DATA_RATES> > m_cellLoad; //!< per gateway index and data rate
+  Time m_lastRound;
+  LoRaWANNetworkServer* m_ns; //!< not owned, the network server owns its policy
+  EventId m_roundEvent;
+
+  TracedValue<uint32_t> m_nrMoves; //!< number of data rate changes made by the optimizer
+};
+
+} // namespace ns3
+
+#endif /* LORAWAN_ADR_POLICY_H */
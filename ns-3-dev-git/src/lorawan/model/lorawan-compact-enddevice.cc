@@ -0,0 +1,672 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+
+#include "lorawan-compact-enddevice.h"
+#include "lorawan-phy.h"
+#include "lorawan-mac-header.h"
+#include "lorawan-frame-header.h"
+#include "lorawan-frame-header-uplink.h"
+#include "lorawan-frame-header-downlink.h"
+#include "lorawan-error-model.h"
+#include "lorawan-spectrum-value-helper.h"
+#include "lorawan-phy-config-registry.h"
+#include "lorawan-spectrum-signal-parameters.h"
+#include "lorawan-enddevice-application.h"
+#include "lorawan-gateway-application.h"
+#include <ns3/log.h>
+#include <ns3/simulator.h>
+#include <ns3/packet.h>
+#include <ns3/spectrum-channel.h>
+#include <ns3/spectrum-value.h>
+#include <ns3/antenna-model.h>
+#include <ns3/propagation-loss-model.h>
+#include <ns3/constant-position-mobility-model.h>
+#include <ns3/random-variable-stream.h>
+#include <ns3/double.h>
+#include <ns3/uinteger.h>
+#include <ns3/boolean.h>
+#include <ns3/string.h>
+#include <ns3/pointer.h>
+#include <ns3/node-list.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("LoRaWANCompactEndDevice");
+
+NS_OBJECT_ENSURE_REGISTERED (LoRaWANCompactEndDeviceFleet);
+
+// Same limits as LoRaWANMac::maxMACPayloadSize, indexed on data rate
+static const uint8_t g_compactMaxMACPayloadSize[] = {59, 59, 59, 123, 230, 230, 230};
+
+struct CompactEndDeviceAddressLess
+{
+  bool operator() (const LoRaWANCompactEndDevice& dev, uint32_t devAddr) const
+  {
+    return dev.m_devAddr < devAddr;
+  }
+};
+
+TypeId
+LoRaWANCompactEndDeviceFleet::GetTypeId (void)
+{
+  // Same default channel selection as LoRaWANEndDeviceApplication
+  std::stringstream channelRandomVariableSS;
+  const uint32_t channelRandomVariableDefaultMax = LoRaWAN::m_nUplinkChannels - 1;
+  channelRandomVariableSS << "ns3::UniformRandomVariable[Min=0|Max=" << channelRandomVariableDefaultMax << "]";
+
+  static TypeId tid = TypeId ("ns3::LoRaWANCompactEndDeviceFleet")
+    .SetParent<SpectrumPhy> ()
+    .SetGroupName ("LoRaWAN")
+    .AddConstructor<LoRaWANCompactEndDeviceFleet> ()
+    .AddAttribute ("DataRateIndex",
+                   "DataRate index used for the first US transmissions of end devices added to the fleet.",
+                   UintegerValue (0), // default data rate is SF12
+                   MakeUintegerAccessor (&LoRaWANCompactEndDeviceFleet::m_dataRateIndex),
+                   MakeUintegerChecker<uint32_t> (0, LoRaWAN::m_supportedDataRates.size () - 1))
+    .AddAttribute ("PacketSize", "The size of packets sent by the end devices",
+                   UintegerValue (21),
+                   MakeUintegerAccessor (&LoRaWANCompactEndDeviceFleet::m_pktSize),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("ADR",
+                   "Adaptive Data Rate mode."
+                   "True means the Adaptive Data Rate mode is on.",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&LoRaWANCompactEndDeviceFleet::m_adr),
+                   MakeBooleanChecker ())
+    .AddAttribute ("ChannelRandomVariable", "A RandomVariableStream used to pick the channel for upstream transmissions.",
+                   StringValue (channelRandomVariableSS.str ()),
+                   MakePointerAccessor (&LoRaWANCompactEndDeviceFleet::m_channelRandomVariable),
+                   MakePointerChecker <RandomVariableStream>())
+    .AddAttribute ("UpstreamIAT", "A RandomVariableStream used to pick the time between subsequent US transmissions of an end device.",
+                   StringValue ("ns3::ConstantRandomVariable[Constant=600.0]"),
+                   MakePointerAccessor (&LoRaWANCompactEndDeviceFleet::m_upstreamIATRandomVariable),
+                   MakePointerChecker <RandomVariableStream>())
+    .AddAttribute ("UpstreamSend", "A RandomVariableStream used to pick the time of the first US transmission of an end device.",
+                   StringValue ("ns3::UniformRandomVariable[Min=0.0|Max=600.0]"),
+                   MakePointerAccessor (&LoRaWANCompactEndDeviceFleet::m_upstreamSendIATRandomVariable),
+                   MakePointerChecker <RandomVariableStream>())
+    .AddTraceSource ("USMsgTransmitted", "An US message is sent",
+                     MakeTraceSourceAccessor (&LoRaWANCompactEndDeviceFleet::m_usMsgTransmittedTrace),
+                     "ns3::Packet::TracedCallback")
+    .AddTraceSource ("DSMsgReceived", "A DS message has been received.",
+                     MakeTraceSourceAccessor (&LoRaWANCompactEndDeviceFleet::m_dsMsgReceivedTrace),
+                     "ns3::Packet::TracedCallback")
+  ;
+  return tid;
+}
+
+LoRaWANCompactEndDeviceFleet::LoRaWANCompactEndDeviceFleet ()
+  : m_transmitting (false),
+    m_started (false),
+    m_pktSize (21),
+    m_dataRateIndex (0),
+    m_adr (true)
+{
+  NS_LOG_FUNCTION (this);
+
+  m_mobility = CreateObject<ConstantPositionMobilityModel> ();
+  m_macRDC = CreateObject<LoRaWANMac::LoRaWANMacRDC> ();
+  m_errorModel = LoRaWANPhyConfigRegistry::GetErrorModel ();
+
+  m_random = CreateObject<UniformRandomVariable> ();
+  m_random->SetAttribute ("Min", DoubleValue (0.0));
+  m_random->SetAttribute ("Max", DoubleValue (1.0));
+
+  // The noise PSD is flat over all channels, so one noise power suffices for all devices and channels
+  LoRaWANSpectrumValueHelper psdHelper;
+  const uint32_t freq = LoRaWAN::m_supportedChannels [0].m_fc;
+  Ptr<SpectrumValue> noise = psdHelper.CreateNoisePowerSpectralDensity (freq);
+  m_rxSpectrumModel = noise->GetSpectrumModel ();
+  m_noisePowerDbm = 10.0 * std::log10 (LoRaWANSpectrumValueHelper::TotalAvgPower (noise, freq)) + 30.0;
+}
+
+LoRaWANCompactEndDeviceFleet::~LoRaWANCompactEndDeviceFleet ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+LoRaWANCompactEndDeviceFleet::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  m_devices.clear ();
+  m_channel = 0;
+  m_lossModel = 0;
+  m_mobility = 0;
+  m_macRDC = 0;
+  m_errorModel = 0;
+  m_rxSpectrumModel = 0;
+  m_channelRandomVariable = 0;
+  m_upstreamIATRandomVariable = 0;
+  m_upstreamSendIATRandomVariable = 0;
+  m_random = 0;
+
+  SpectrumPhy::DoDispose ();
+}
+
+void
+LoRaWANCompactEndDeviceFleet::SetDevice (Ptr<NetDevice> d)
+{
+  NS_LOG_ERROR (this << " a LoRaWANCompactEndDeviceFleet is not attached to a NetDevice");
+}
+
+Ptr<NetDevice>
+LoRaWANCompactEndDeviceFleet::GetDevice (void) const
+{
+  return 0;
+}
+
+void
+LoRaWANCompactEndDeviceFleet::SetMobility (Ptr<MobilityModel> m)
+{
+  NS_LOG_ERROR (this << " the positions of the end devices are set through AddEndDevice");
+}
+
+Ptr<MobilityModel>
+LoRaWANCompactEndDeviceFleet::GetMobility (void)
+{
+  // Only expose a position while one of the devices is transmitting, so that
+  // the channel applies path loss to uplinks but not to downlinks: the latter
+  // are meant for a device the channel does not know about.
+  if (m_transmitting)
+    return m_mobility;
+  else
+    return 0;
+}
+
+void
+LoRaWANCompactEndDeviceFleet::SetChannel (Ptr<SpectrumChannel> c)
+{
+  NS_LOG_FUNCTION (this << c);
+  NS_ASSERT_MSG (m_channel == 0, "A LoRaWANCompactEndDeviceFleet can only be attached to one channel");
+
+  m_channel = c;
+  m_channel->AddRx (this);
+
+  // The channel keeps a reference to the fleet, break the cycle at the end of
+  // the simulation. The event holds a reference of its own, as the channel may
+  // be disposed of first.
+  Simulator::ScheduleDestroy (&LoRaWANCompactEndDeviceFleet::Dispose, Ptr<LoRaWANCompactEndDeviceFleet> (this));
+}
+
+Ptr<const SpectrumModel>
+LoRaWANCompactEndDeviceFleet::GetRxSpectrumModel (void) const
+{
+  return m_rxSpectrumModel;
+}
+
+Ptr<AntennaModel>
+LoRaWANCompactEndDeviceFleet::GetRxAntenna (void)
+{
+  return 0;
+}
+
+void
+LoRaWANCompactEndDeviceFleet::SetPropagationLossModel (Ptr<PropagationLossModel> loss)
+{
+  m_lossModel = loss;
+}
+
+void
+LoRaWANCompactEndDeviceFleet::Reserve (uint32_t nEndDevices)
+{
+  m_devices.reserve (nEndDevices);
+}
+
+uint32_t
+LoRaWANCompactEndDeviceFleet::AddEndDevice (Ipv4Address devAddr, Vector position)
+{
+  NS_LOG_FUNCTION (this << devAddr << position);
+  NS_ASSERT_MSG (m_devices.empty () || m_devices.back ().m_devAddr < devAddr.Get (),
+                 "End devices must be added in increasing order of their address");
+
+  LoRaWANCompactEndDevice dev;
+  dev.m_position = position;
+  dev.m_devAddr = devAddr.Get ();
+  dev.m_fCntUp = 0;
+  dev.m_adrAckCnt = 0;
+  dev.m_lastUplinkEnd = Seconds (0);
+  dev.m_subBandAvailable = Seconds (0);
+  dev.m_dataRateIndex = m_dataRateIndex;
+  dev.m_txPowerIndex = 0;
+  dev.m_channelMask = LoRaWAN::GetDefaultUplinkChannelMask ();
+  dev.m_lastChannelIndex = 0;
+  dev.m_adrAckReq = false;
+  dev.m_setAck = false;
+  dev.m_doSendLinkAdrAns = false;
+  dev.m_linkAdrAnsPowerAck = false;
+  dev.m_linkAdrAnsDataRateAck = false;
+  dev.m_linkAdrAnsChannelMaskAck = false;
+  dev.m_rxBusy = false;
+  dev.m_txPending = false;
+
+  uint32_t index = m_devices.size ();
+  m_devices.push_back (dev);
+
+  if (m_started)
+    StartEndDevice (index);
+  else if (index == 0)
+    Simulator::ScheduleNow (&LoRaWANCompactEndDeviceFleet::Start, this);
+
+  return index;
+}
+
+uint32_t
+LoRaWANCompactEndDeviceFleet::GetNEndDevices (void) const
+{
+  return m_devices.size ();
+}
+
+const LoRaWANCompactEndDevice&
+LoRaWANCompactEndDeviceFleet::GetEndDevice (uint32_t index) const
+{
+  NS_ASSERT (index < m_devices.size ());
+  return m_devices[index];
+}
+
+uint32_t
+LoRaWANCompactEndDeviceFleet::FindEndDevice (uint32_t devAddr) const
+{
+  std::vector<LoRaWANCompactEndDevice>::const_iterator it =
+    std::lower_bound (m_devices.begin (), m_devices.end (), devAddr, CompactEndDeviceAddressLess ());
+  if (it == m_devices.end () || it->m_devAddr != devAddr)
+    return m_devices.size ();
+
+  return it - m_devices.begin ();
+}
+
+int64_t
+LoRaWANCompactEndDeviceFleet::AssignStreams (int64_t stream)
+{
+  NS_LOG_FUNCTION (this << stream);
+  m_channelRandomVariable->SetStream (stream);
+  m_upstreamIATRandomVariable->SetStream (stream + 1);
+  m_upstreamSendIATRandomVariable->SetStream (stream + 2);
+  m_random->SetStream (stream + 3);
+  return 4;
+}
+
+void
+LoRaWANCompactEndDeviceFleet::Start (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  // Started from an event rather than from AddEndDevice, so that AssignStreams
+  // can be called after the devices were installed
+  m_started = true;
+  LoRaWANNetworkServer::getLoRaWANNetworkServerPointer ()->ReserveEndDevices (m_devices.size () + NodeList::GetNNodes ());
+  for (uint32_t i = 0; i < m_devices.size (); i++)
+    {
+      StartEndDevice (i);
+    }
+}
+
+void
+LoRaWANCompactEndDeviceFleet::StartEndDevice (uint32_t index)
+{
+  LoRaWANNetworkServer::getLoRaWANNetworkServerPointer ()->AddEndDevice (Ipv4Address (m_devices[index].m_devAddr));
+
+  Time nextSendTime (Seconds (m_upstreamSendIATRandomVariable->GetValue ()));
+  ScheduleNextTx (index, nextSendTime);
+}
+
+void
+LoRaWANCompactEndDeviceFleet::ScheduleNextTx (uint32_t index, Time delay)
+{
+  Simulator::Schedule (delay, &LoRaWANCompactEndDeviceFleet::SendPacket, this, index);
+}
+
+Ptr<SpectrumValue>
+LoRaWANCompactEndDeviceFleet::GetTxPsd (int8_t power, uint8_t channelIndex)
+{
+  // the channel copies the PSD before applying the propagation loss
+  return ConstCast<SpectrumValue> (LoRaWANPhyConfigRegistry::GetTxPowerSpectralDensity (power, LoRaWAN::m_supportedChannels [channelIndex].m_fc));
+}
+
+void
+LoRaWANCompactEndDeviceFleet::SendPacket (uint32_t index)
+{
+  NS_LOG_FUNCTION (this << index);
+
+  LoRaWANCompactEndDevice& dev = m_devices[index];
+
+  // A downlink is being received: send when it has been received, as the MAC of a regular device would
+  if (dev.m_rxBusy)
+    {
+      dev.m_txPending = true;
+      return;
+    }
+
+  // Hold the uplink back until the receive windows of the previous uplink are
+  // closed and the duty cycle of the sub band allows a new transmission. All
+  // upstream channels are in the same sub band, so one timestamp suffices.
+  Time earliest = dev.m_subBandAvailable;
+  if (dev.m_fCntUp > 0)
+    {
+      Time rw2End = dev.m_lastUplinkEnd + MicroSeconds (RECEIVE_DELAY2)
+        + LoRaWANPhy::CalculatePreambleTime (LoRaWAN::m_RW2ChannelIndex, LoRaWAN::m_RW2DataRateIndex, 8);
+      earliest = std::max (earliest, rw2End);
+    }
+  if (earliest > Simulator::Now ())
+    {
+      NS_LOG_LOGIC (this << " deferring uplink of " << Ipv4Address (dev.m_devAddr) << " to " << earliest);
+      ScheduleNextTx (index, earliest - Simulator::Now ());
+      return;
+    }
+
+  LoRaWANFrameHeaderUplink fhdr;
+  fhdr.setDevAddr (Ipv4Address (dev.m_devAddr));
+  fhdr.setAdr (m_adr);
+  fhdr.setAck (dev.m_setAck);
+  fhdr.setClassB (false);
+
+  if (dev.m_doSendLinkAdrAns)
+    {
+      if (fhdr.AddLoRaADRAns (dev.m_linkAdrAnsPowerAck, dev.m_linkAdrAnsDataRateAck, dev.m_linkAdrAnsChannelMaskAck))
+        {
+          dev.m_doSendLinkAdrAns = false;
+          dev.m_linkAdrAnsPowerAck = false;
+          dev.m_linkAdrAnsDataRateAck = false;
+          dev.m_linkAdrAnsChannelMaskAck = false;
+        }
+      else
+        {
+          NS_LOG_INFO (this << " tried but failed to add ADRAns to frame");
+        }
+    }
+
+  dev.m_fCntUp++;
+  fhdr.setFrameCounter (dev.m_fCntUp);
+
+  if (m_adr)
+    {
+      dev.m_adrAckCnt++;
+      AdaptiveDataRate (dev);
+    }
+  fhdr.setAdrAckReq (dev.m_adrAckReq);
+  fhdr.setFramePort (0);
+
+  // Construct MACPayload: FHDR | FPort | FRMPayload
+  Ptr<Packet> packet;
+  uint8_t frmPayloadSize = m_pktSize - fhdr.GetSerializedSize () - 1 - 4; // subtract frame header, 1B for MAC header and 4B for MAC MIC
+  if (frmPayloadSize >= sizeof (uint64_t))
+    {
+      // send decrementing counter as payload (note: globally shared counter)
+      uint8_t* payload = new uint8_t[frmPayloadSize] ();
+      const uint64_t counter = LoRaWANCounterSingleton::GetCounter ();
+      ((uint64_t*)payload)[0] = counter;
+      packet = Create<Packet> (payload, frmPayloadSize);
+      delete[] payload;
+    }
+  else
+    {
+      packet = Create<Packet> (frmPayloadSize);
+    }
+  packet->AddHeader (fhdr);
+
+  uint8_t channelIndex = LoRaWAN::SelectUplinkChannel (m_channelRandomVariable, dev.m_channelMask);
+  NS_ASSERT (channelIndex < LoRaWAN::m_nUplinkChannels); // end devices do not use the high power channel for US traffic
+  NS_ASSERT_MSG (dev.m_dataRateIndex != 6, "in compact ED SendPacket");
+
+  m_usMsgTransmittedTrace (dev.m_devAddr, LORAWAN_UNCONFIRMED_DATA_UP, packet);
+
+  if (packet->GetSize () > g_compactMaxMACPayloadSize[dev.m_dataRateIndex])
+    {
+      NS_LOG_ERROR (this << " MACPayload of " << packet->GetSize () << " bytes is too large for DataRate " << (uint16_t)dev.m_dataRateIndex);
+      ScheduleNextTx (index, Seconds (m_upstreamIATRandomVariable->GetValue ()));
+      return;
+    }
+
+  // Construct PHYPayload: MHDR | MACPayload | MIC
+  LoRaWANMacHeader macHdr (LORAWAN_UNCONFIRMED_DATA_UP, 0);
+  packet->AddHeader (macHdr);
+  packet->AddPaddingAtEnd (4); // as MIC support is not implemented, we do not add a MIC trailer
+
+  LoRaWANPhyTraceIdTag traceIdTag;
+  traceIdTag.SetFlowId (LoRaWANPhyTraceIdTag::AllocateFlowId ());
+  packet->AddPacketTag (traceIdTag);
+
+  const uint8_t subBandIndex = LoRaWAN::m_supportedChannels [channelIndex].m_subBandIndex;
+  const int8_t txPower = m_macRDC->GetMaxPowerForSubBand (subBandIndex) - (2 * dev.m_txPowerIndex);
+
+  Ptr<LoRaWANSpectrumSignalParameters> txParams = Create<LoRaWANSpectrumSignalParameters> ();
+  txParams->duration = LoRaWANPhy::CalculateTxTime (packet->GetSize (), channelIndex, dev.m_dataRateIndex, 1, 8, true);
+  txParams->txPhy = this;
+  txParams->psd = GetTxPsd (txPower, channelIndex);
+  txParams->txAntenna = 0;
+  txParams->packet = packet;
+  txParams->channelIndex = channelIndex;
+  txParams->dataRateIndex = dev.m_dataRateIndex;
+  txParams->codeRate = 1;
+
+  m_mobility->SetPosition (dev.m_position);
+  m_transmitting = true;
+  m_channel->StartTx (txParams);
+  m_transmitting = false;
+
+  dev.m_lastUplinkEnd = Simulator::Now () + txParams->duration;
+  dev.m_lastChannelIndex = channelIndex;
+  dev.m_subBandAvailable = Simulator::Now () + txParams->duration * m_macRDC->GetDutyCycleLimitForSubBand (subBandIndex);
+  dev.m_setAck = false;
+
+  NS_LOG_INFO ("At time " << Simulator::Now ().GetSeconds ()
+               << "s compact end device " << Ipv4Address (dev.m_devAddr)
+               << " sent " << packet->GetSize () << " bytes on channel " << (uint16_t)channelIndex);
+
+  ScheduleNextTx (index, Seconds (m_upstreamIATRandomVariable->GetValue ()));
+}
+
+void
+LoRaWANCompactEndDeviceFleet::StartRx (Ptr<SpectrumSignalParameters> spectrumRxParams)
+{
+  NS_LOG_FUNCTION (this << spectrumRxParams);
+
+  Ptr<LoRaWANSpectrumSignalParameters> params = DynamicCast<LoRaWANSpectrumSignalParameters> (spectrumRxParams);
+  if (params == 0)
+    return; // not a LoRaWAN transmission
+
+  // Only downstream frames are of interest to class A end devices
+  LoRaWANMacHeader macHdr;
+  params->packet->PeekHeader (macHdr);
+  if (!macHdr.IsDownstream ())
+    return;
+
+  Ptr<Packet> pktCopy = params->packet->Copy ();
+  pktCopy->RemoveHeader (macHdr);
+  pktCopy->RemoveAtEnd (4); // MIC
+  LoRaWANFrameHeader frameHdr;
+  pktCopy->PeekHeader (frameHdr);
+
+  uint32_t index = FindEndDevice (frameHdr.getDevAddr ().Get ());
+  if (index == m_devices.size ())
+    return; // not addressed to a device of this fleet
+
+  LoRaWANCompactEndDevice& dev = m_devices[index];
+  if (dev.m_fCntUp == 0 || dev.m_rxBusy)
+    return;
+
+  // Did the preamble arrive while RW1 or RW2 of the last uplink was open?
+  const Time now = Simulator::Now ();
+  uint8_t window = 0;
+  const uint8_t rw1DataRateIndex = LoRaWAN::GetRX1DataRateIndex (dev.m_dataRateIndex, 0);
+  const Time rw1Open = dev.m_lastUplinkEnd + MicroSeconds (RECEIVE_DELAY1);
+  const Time rw2Open = dev.m_lastUplinkEnd + MicroSeconds (RECEIVE_DELAY2);
+  if (params->channelIndex == LoRaWAN::GetRX1ChannelIndex (dev.m_lastChannelIndex) && params->dataRateIndex == rw1DataRateIndex
+      && now >= rw1Open && now <= rw1Open + LoRaWANPhy::CalculatePreambleTime (params->channelIndex, params->dataRateIndex, 8))
+    {
+      window = 1;
+    }
+  else if (params->channelIndex == LoRaWAN::m_RW2ChannelIndex && params->dataRateIndex == LoRaWAN::m_RW2DataRateIndex
+           && now >= rw2Open && now <= rw2Open + LoRaWANPhy::CalculatePreambleTime (params->channelIndex, params->dataRateIndex, 8))
+    {
+      window = 2;
+    }
+  if (window == 0)
+    {
+      NS_LOG_LOGIC (this << " downlink for " << Ipv4Address (dev.m_devAddr) << " arrived outside of its receive windows");
+      return;
+    }
+
+  // The channel did not apply path loss, as it only sees the fleet
+  const uint32_t freq = LoRaWAN::m_supportedChannels [params->channelIndex].m_fc;
+  double rxPowerDbm = 10.0 * std::log10 (LoRaWANSpectrumValueHelper::TotalAvgPower (params->psd, freq)) + 30.0;
+  Ptr<MobilityModel> txMobility = params->txPhy->GetMobility ();
+  if (m_lossModel && txMobility)
+    {
+      m_mobility->SetPosition (dev.m_position);
+      rxPowerDbm = m_lossModel->CalcRxPower (rxPowerDbm, txMobility, m_mobility);
+    }
+  double snrDb = rxPowerDbm - m_noisePowerDbm;
+
+  const LoRaSpreadingFactor sf = LoRaWAN::m_supportedDataRates [params->dataRateIndex].spreadingFactor;
+  const uint32_t bw = LoRaWAN::m_supportedDataRates [params->dataRateIndex].bandWith;
+  if (snrDb <= m_errorModel->getSNRCutoffForRX (bw, sf, params->codeRate))
+    {
+      NS_LOG_LOGIC (this << " downlink for " << Ipv4Address (dev.m_devAddr) << " dropped, snr " << snrDb << " dB is too low");
+      return;
+    }
+
+  dev.m_rxBusy = true;
+  Simulator::Schedule (params->duration, &LoRaWANCompactEndDeviceFleet::EndRx, this, index, params, window, snrDb);
+}
+
+void
+LoRaWANCompactEndDeviceFleet::EndRx (uint32_t index, Ptr<LoRaWANSpectrumSignalParameters> params, uint8_t window, double snrDb)
+{
+  NS_LOG_FUNCTION (this << index << (uint16_t)window << snrDb);
+
+  LoRaWANCompactEndDevice& dev = m_devices[index];
+  dev.m_rxBusy = false;
+
+  const LoRaSpreadingFactor sf = LoRaWAN::m_supportedDataRates [params->dataRateIndex].spreadingFactor;
+  const uint32_t bw = LoRaWAN::m_supportedDataRates [params->dataRateIndex].bandWith;
+  double per = 1.0 - m_errorModel->GetChunkSuccessRate (snrDb, params->packet->GetSize () * 8, bw, sf, params->codeRate);
+  if (m_random->GetValue () < per)
+    {
+      NS_LOG_LOGIC (this << " downlink for " << Ipv4Address (dev.m_devAddr) << " destroyed");
+    }
+  else
+    {
+      Ptr<Packet> p = params->packet->Copy ();
+      LoRaWANMacHeader macHdr;
+      p->RemoveHeader (macHdr);
+      p->RemoveAtEnd (4); // MIC
+      HandleDSPacket (index, p, macHdr.getLoRaWANMsgType (), window);
+    }
+
+  if (dev.m_txPending)
+    {
+      dev.m_txPending = false;
+      ScheduleNextTx (index, Seconds (0));
+    }
+}
+
+void
+LoRaWANCompactEndDeviceFleet::HandleDSPacket (uint32_t index, Ptr<Packet> p, LoRaWANMsgType msgType, uint8_t window)
+{
+  NS_LOG_FUNCTION (this << index << p << (uint16_t)window);
+
+  LoRaWANCompactEndDevice& dev = m_devices[index];
+
+  if (m_adr)
+    { // received a packet, reset m_adrAckCnt and m_adrAckReq
+      dev.m_adrAckCnt = 0;
+      dev.m_adrAckReq = false;
+    }
+
+  LoRaWANFrameHeaderDownlink frmHdr;
+  frmHdr.setSerializeFramePort (true);
+  p->RemoveHeader (frmHdr);
+
+  // Same handling of LinkADRReq as LoRaWANEndDeviceApplication::HandleDSPacket
+  for (std::vector<LoRaWANMacCommandDownlink>::iterator it = frmHdr.m_macCommandsNS.begin (); it != frmHdr.m_macCommandsNS.end (); ++it)
+    {
+      if (!it->m_isBeingUsed || it->m_commandID != LinkADRReq)
+        continue;
+
+      uint8_t new_dr = frmHdr.m_dataRateIndex;
+      uint8_t new_tx = frmHdr.m_txPowerIndex;
+      NS_ASSERT_MSG (new_dr != 6, "dr6 not supported! compact ed side. dr: " << new_dr << "and tx: " << new_tx);
+
+      if (new_dr <= LoRaWAN::m_maxUplinkDataRateIndex)
+        {
+          dev.m_dataRateIndex = new_dr;
+          dev.m_linkAdrAnsDataRateAck = true;
+        }
+      else
+        {
+          dev.m_linkAdrAnsDataRateAck = (new_dr == 15);
+        }
+
+      if (new_tx < 8)
+        {
+          dev.m_txPowerIndex = new_tx;
+          dev.m_linkAdrAnsPowerAck = true;
+        }
+      else
+        {
+          dev.m_linkAdrAnsPowerAck = (new_tx == 15);
+        }
+
+      dev.m_linkAdrAnsChannelMaskAck = LoRaWAN::ApplyLinkADRChannelMask (dev.m_channelMask, frmHdr.m_channelMaskBytes, frmHdr.m_chMaskCntl);
+      dev.m_doSendLinkAdrAns = true;
+    }
+
+  if (msgType == LORAWAN_CONFIRMED_DATA_DOWN)
+    {
+      dev.m_setAck = true; // next packet should set Ack bit
+    }
+
+  m_dsMsgReceivedTrace (dev.m_devAddr, msgType, p, window);
+}
+
+void
+LoRaWANCompactEndDeviceFleet::AdaptiveDataRate (LoRaWANCompactEndDevice& dev)
+{
+  // Same as LoRaWANEndDeviceApplication::AdaptiveDataRate
+  if ((dev.m_txPowerIndex > 0) | (dev.m_dataRateIndex > 0) | (dev.m_channelMask != LoRaWAN::GetDefaultUplinkChannelMask ()))
+    {
+      if (dev.m_adrAckCnt == ADR_ACK_LIMIT)
+        {
+          dev.m_adrAckReq = true;
+        }
+      else if (dev.m_adrAckCnt == ADR_ACK_LIMIT + ADR_ACK_DELAY)
+        {
+          if (dev.m_txPowerIndex > 0)
+            dev.m_txPowerIndex = 0; // increase tx power back to default
+          else if (dev.m_dataRateIndex > 0)
+            dev.m_dataRateIndex--; // slow data rate by 1
+          else
+            dev.m_channelMask = LoRaWAN::GetDefaultUplinkChannelMask (); // enable all uplink channels
+          dev.m_adrAckCnt = ADR_ACK_LIMIT;
+        }
+    }
+  else
+    {
+      // link range cannot be improved
+      dev.m_adrAckReq = false;
+    }
+}
+
+} // namespace ns3
@@ -0,0 +1,205 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+
+#ifndef LORAWAN_COMPACT_ENDDEVICE_H
+#define LORAWAN_COMPACT_ENDDEVICE_H
+
+#include "lorawan.h"
+#include "lorawan-mac.h"
+#include <ns3/spectrum-phy.h>
+#include <ns3/traced-callback.h>
+#include <ns3/nstime.h>
+#include <ns3/vector.h>
+#include <ns3/ipv4-address.h>
+
+#include <map>
+#include <vector>
+
+namespace ns3 {
+
+class Packet;
+class SpectrumValue;
+class PropagationLossModel;
+class ConstantPositionMobilityModel;
+class RandomVariableStream;
+class LoRaWANErrorModel;
+struct LoRaWANSpectrumSignalParameters;
+
+/**
+ * \ingroup lorawan
+ *
+ * PHY, MAC and application state of one compact class A end device.
+ *
+ * This is a plain struct rather than an ns3::Object: it has no attribute or
+ * trace source tables of its own and is stored by value in a
+ * LoRaWANCompactEndDeviceFleet, which holds everything the devices share.
+ */
+typedef struct LoRaWANCompactEndDevice {
+  Vector          m_position;
+  uint32_t        m_devAddr;
+  uint32_t        m_fCntUp;             //!< Uplink frame counter
+  uint32_t        m_adrAckCnt;          //!< Number of uplinks sent since the last downlink
+  Time            m_lastUplinkEnd;      //!< End of the last uplink, the receive windows are relative to it
+  Time            m_subBandAvailable;   //!< Time at which the duty cycle allows the next uplink
+  uint8_t         m_dataRateIndex;
+  uint8_t         m_txPowerIndex;
+  uint16_t        m_channelMask;        //!< Uplink channels enabled by LinkADRReq
+  uint8_t         m_lastChannelIndex;
+  bool            m_adrAckReq : 1;
+  bool            m_setAck : 1;         //!< Set the Ack bit in the next uplink
+  bool            m_doSendLinkAdrAns : 1;
+  bool            m_linkAdrAnsPowerAck : 1;
+  bool            m_linkAdrAnsDataRateAck : 1;
+  bool            m_linkAdrAnsChannelMaskAck : 1;
+  bool            m_rxBusy : 1;         //!< A downlink is being received
+  bool            m_txPending : 1;      //!< An uplink waits for the end of the downlink reception
+} LoRaWANCompactEndDevice;
+
+/**
+ * \ingroup lorawan
+ *
+ * A memory-lean population of class A end devices.
+ *
+ * A regular end device consists of a Node, LoRaWANNetDevice, LoRaWANPhy,
+ * LoRaWANMac, LoRaWANMacRDC, LoRaWANInterferenceHelper, noise PSD, packet
+ * socket, LoRaWANEndDeviceApplication and mobility model. The fleet replaces
+ * all of these by one LoRaWANCompactEndDevice struct per device, while the
+ * fleet itself is the single SpectrumPhy that is attached to the channel on
+ * behalf of all of its devices:
+ *
+ * - Uplinks are built like LoRaWANEndDeviceApplication builds them, including
+ *   the ED side of the ADR algorithm and LinkADRAns, and are sent on the
+ *   channel with the position of the sending device. Gateways and the network
+ *   server handle them exactly like uplinks from regular end devices.
+ * - The receive windows are not modelled as MAC state changes. Instead, a
+ *   downlink is received when its preamble arrives within RW1 or RW2 (as seen
+ *   from the end of the last uplink) on the channel and data rate of that
+ *   window. This costs no events unless a downlink is actually sent.
+ * - There is no per-device interference PSD: a downlink is received based on
+ *   its SNR over the thermal noise floor only, using a shared error model.
+ *
+ * Only unconfirmed uplinks with NbRep = 1 are supported, the NbTrans of
+ * LinkADRReq is ignored. Energy consumption is
+ * not modelled. All end devices in the fleet use the attributes of the fleet,
+ * e.g. one UpstreamIAT stream is shared by all devices.
+ *
+ * Devices are added through LoRaWANCompactEndDeviceHelper, which also attaches
+ * the fleet to the channel.
+ */
+class LoRaWANCompactEndDeviceFleet : public SpectrumPhy
+{
+public:
+  static TypeId GetTypeId (void);
+
+  LoRaWANCompactEndDeviceFleet ();
+  virtual ~LoRaWANCompactEndDeviceFleet ();
+
+  // inherited from SpectrumPhy
+  virtual void SetDevice (Ptr<NetDevice> d);
+  virtual Ptr<NetDevice> GetDevice (void) const;
+  virtual void SetMobility (Ptr<MobilityModel> m);
+  virtual Ptr<MobilityModel> GetMobility (void);
+  virtual void SetChannel (Ptr<SpectrumChannel> c);
+  virtual Ptr<const SpectrumModel> GetRxSpectrumModel (void) const;
+  virtual Ptr<AntennaModel> GetRxAntenna (void);
+  virtual void StartRx (Ptr<SpectrumSignalParameters> params);
+
+  /**
+   * \brief Set the loss model used by the channel
+   *
+   * The channel does not apply path loss to signals for the fleet as it does
+   * not know which device they are meant for, the fleet applies it instead.
+   *
+   * \param loss the propagation loss model of the channel
+   */
+  void SetPropagationLossModel (Ptr<PropagationLossModel> loss);
+
+  /**
+   * \brief Reserve room for a number of end devices
+   * \param nEndDevices the expected total number of end devices in the fleet
+   */
+  void Reserve (uint32_t nEndDevices);
+
+  /**
+   * \brief Add an end device to the fleet and schedule its first uplink
+   *
+   * Devices must be added in increasing order of their address.
+   *
+   * \param devAddr the device address
+   * \param position the position of the end device
+   * \return the index of the end device in the fleet
+   */
+  uint32_t AddEndDevice (Ipv4Address devAddr, Vector position);
+
+  uint32_t GetNEndDevices (void) const;
+  const LoRaWANCompactEndDevice& GetEndDevice (uint32_t index) const;
+
+  /**
+   * \brief Look up an end device on its address
+   * \param devAddr the device address
+   * \return the index of the end device, or GetNEndDevices () if the address is not part of the fleet
+   */
+  uint32_t FindEndDevice (uint32_t devAddr) const;
+
+  int64_t AssignStreams (int64_t stream);
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  void SendPacket (uint32_t index);
+  void ScheduleNextTx (uint32_t index, Time delay);
+  void EndRx (uint32_t index, Ptr<LoRaWANSpectrumSignalParameters> params, uint8_t window, double snrDb);
+  void HandleDSPacket (uint32_t index, Ptr<Packet> p, LoRaWANMsgType msgType, uint8_t window);
+  void AdaptiveDataRate (LoRaWANCompactEndDevice& dev);
+  void Start (void);
+  void StartEndDevice (uint32_t index);
+  Ptr<SpectrumValue> GetTxPsd (int8_t power, uint8_t channelIndex);
+
+  std::vector<LoRaWANCompactEndDevice> m_devices; //!< sorted on device address
+
+  Ptr<SpectrumChannel> m_channel;
+  Ptr<PropagationLossModel> m_lossModel;
+  Ptr<ConstantPositionMobilityModel> m_mobility; //!< position of the device that is transmitting or receiving
+  bool m_transmitting;
+  Ptr<LoRaWANMac::LoRaWANMacRDC> m_macRDC; //!< only used to look up sub band limits
+  Ptr<LoRaWANErrorModel> m_errorModel;
+  Ptr<const SpectrumModel> m_rxSpectrumModel;
+  double m_noisePowerDbm; //!< thermal noise power over a 125 kHz channel
+  bool m_started; //!< the first uplinks have been scheduled and the devices are known to the NS
+
+  Ptr<RandomVariableStream> m_channelRandomVariable;
+  Ptr<RandomVariableStream> m_upstreamIATRandomVariable;
+  Ptr<RandomVariableStream> m_upstreamSendIATRandomVariable;
+  Ptr<RandomVariableStream> m_random; //!< rng for packet errors
+  uint32_t m_pktSize;
+  uint32_t m_dataRateIndex;
+  bool m_adr;
+
+  /// Traced Callback: transmitted packets, same signature as LoRaWANEndDeviceApplication::USMsgTransmitted
+  TracedCallback<uint32_t, uint8_t, Ptr<const Packet>> m_usMsgTransmittedTrace;
+
+  /// Traced Callback: received packets, same signature as LoRaWANEndDeviceApplication::DSMsgReceived
+  TracedCallback<uint32_t, uint8_t, Ptr<const Packet>, uint8_t> m_dsMsgReceivedTrace;
+};
+
+} // namespace ns3
+
+#endif /* LORAWAN_COMPACT_ENDDEVICE_H */
@@ -0,0 +1,205 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+
+#include "lorawan-downlink-scheduler.h"
+#include "lorawan.h"
+#include "lorawan-phy.h"
+#include "lorawan-gateway-application.h"
+#include <ns3/log.h>
+#include <ns3/simulator.h>
+#include <ns3/node.h>
+#include <ns3/trace-source-accessor.h>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("LoRaWANDownlinkScheduler");
+
+NS_OBJECT_ENSURE_REGISTERED (LoRaWANDownlinkScheduler);
+
+TypeId
+LoRaWANDownlinkScheduler::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::LoRaWANDownlinkScheduler")
+    .SetParent<Object> ()
+    .SetGroupName ("LoRaWAN")
+    .AddConstructor<LoRaWANDownlinkScheduler> ()
+    .AddTraceSource ("nrAdvanceReservations",
+                     "The number of downlinks that were reserved on a gateway before their start, e.g. for RW2",
+                     MakeTraceSourceAccessor (&LoRaWANDownlinkScheduler::m_nrAdvanceReservations),
+                     "ns3::TracedValueCallback::Uint32")
+    .AddTraceSource ("nrAlternativeGateway",
+                     "The number of downlinks that were not sent through the most preferred gateway as it was busy or out of duty cycle budget",
+                     MakeTraceSourceAccessor (&LoRaWANDownlinkScheduler::m_nrAlternativeGateway),
+                     "ns3::TracedValueCallback::Uint32")
+    .AddTraceSource ("nrUnschedulable",
+                     "The number of times no gateway was able to send a downlink",
+                     MakeTraceSourceAccessor (&LoRaWANDownlinkScheduler::m_nrUnschedulable),
+                     "ns3::TracedValueCallback::Uint32")
+    .AddTraceSource ("nrReservationBroken",
+                     "The number of RW2 reservations that the reserved gateway was not able to honour",
+                     MakeTraceSourceAccessor (&LoRaWANDownlinkScheduler::m_nrReservationBroken),
+                     "ns3::TracedValueCallback::Uint32")
+  ;
+  return tid;
+}
+
+LoRaWANDownlinkScheduler::LoRaWANDownlinkScheduler ()
+  : m_macRDC (CreateObject<LoRaWANMac::LoRaWANMacRDC> ()),
+    m_nrAdvanceReservations (0),
+    m_nrAlternativeGateway (0),
+    m_nrUnschedulable (0),
+    m_nrReservationBroken (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+LoRaWANDownlinkScheduler::~LoRaWANDownlinkScheduler ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+Time
+LoRaWANDownlinkScheduler::GetAirTime (uint8_t channelIndex, uint8_t dataRateIndex, uint32_t phyPayloadSize)
+{
+  return LoRaWANPhy::CalculateTxTime (phyPayloadSize, channelIndex, dataRateIndex, 1, 8, true);
+}
+
+std::vector<LoRaWANDownlinkReservation>&
+LoRaWANDownlinkScheduler::GetReservations (Ptr<LoRaWANGatewayApplication> gateway)
+{
+  std::vector<LoRaWANDownlinkReservation>& reservations = m_reservations[gateway->GetNode ()->GetId ()];
+
+  // Forget downlinks whose transmission and off time have both passed
+  const Time now = Simulator::Now ();
+  auto it = reservations.begin ();
+  while (it != reservations.end () && it->m_end <= now && it->m_subBandAvailable <= now)
+    ++it;
+  reservations.erase (reservations.begin (), it);
+
+  return reservations;
+}
+
+bool
+LoRaWANDownlinkScheduler::CanSend (Ptr<LoRaWANGatewayApplication> gateway, uint8_t channelIndex, uint8_t dataRateIndex, Time txStart, uint32_t phyPayloadSize)
+{
+  NS_LOG_FUNCTION (this << gateway << (unsigned)channelIndex << (unsigned)dataRateIndex << txStart << phyPayloadSize);
+
+  if (txStart <= Simulator::Now () && !gateway->CanSendImmediatelyOnChannel (channelIndex, dataRateIndex))
+    return false;
+
+  const uint8_t subBandIndex = LoRaWAN::m_supportedChannels [channelIndex].m_subBandIndex;
+  const Time airTime = GetAirTime (channelIndex, dataRateIndex, phyPayloadSize);
+  const Time txEnd = txStart + airTime;
+  const Time subBandAvailable = txStart + airTime * m_macRDC->GetDutyCycleLimitForSubBand (subBandIndex);
+
+  for (const auto& reservation : GetReservations (gateway)) {
+    if (reservation.m_start < txEnd && txStart < reservation.m_end) {
+      NS_LOG_LOGIC (this << " gateway is transmitting another downlink from " << reservation.m_start << " until " << reservation.m_end);
+      return false;
+    }
+
+    if (reservation.m_subBandIndex != subBandIndex)
+      continue;
+
+    if (reservation.m_start <= txStart && txStart < reservation.m_subBandAvailable) {
+      NS_LOG_LOGIC (this << " sub band " << (unsigned)subBandIndex << " is not available before " << reservation.m_subBandAvailable);
+      return false;
+    }
+    if (txStart < reservation.m_start && reservation.m_start < subBandAvailable) {
+      NS_LOG_LOGIC (this << " off time would overlap with the downlink at " << reservation.m_start);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+Ptr<LoRaWANGatewayApplication>
+LoRaWANDownlinkScheduler::SelectGateway (const std::vector<Ptr<LoRaWANGatewayApplication> >& gateways,
+                                         uint8_t channelIndex, uint8_t dataRateIndex, Time txStart, uint32_t phyPayloadSize)
+{
+  NS_LOG_FUNCTION (this << gateways.size () << (unsigned)channelIndex << (unsigned)dataRateIndex << txStart << phyPayloadSize);
+
+  for (auto it = gateways.cbegin (); it != gateways.cend (); ++it) {
+    if (CanSend (*it, channelIndex, dataRateIndex, txStart, phyPayloadSize)) {
+      if (it != gateways.cbegin ())
+        m_nrAlternativeGateway++;
+      return *it;
+    }
+  }
+
+  m_nrUnschedulable++;
+  return nullptr;
+}
+
+void
+LoRaWANDownlinkScheduler::Reserve (Ptr<LoRaWANGatewayApplication> gateway, uint8_t channelIndex, uint8_t dataRateIndex, Time txStart, uint32_t phyPayloadSize)
+{
+  NS_LOG_FUNCTION (this << gateway << (unsigned)channelIndex << (unsigned)dataRateIndex << txStart << phyPayloadSize);
+
+  Release (gateway, txStart);
+
+  const uint8_t subBandIndex = LoRaWAN::m_supportedChannels [channelIndex].m_subBandIndex;
+  const Time airTime = GetAirTime (channelIndex, dataRateIndex, phyPayloadSize);
+
+  LoRaWANDownlinkReservation reservation;
+  reservation.m_start = txStart;
+  reservation.m_end = txStart + airTime;
+  reservation.m_subBandIndex = subBandIndex;
+  reservation.m_subBandAvailable = txStart + airTime * m_macRDC->GetDutyCycleLimitForSubBand (subBandIndex);
+
+  std::vector<LoRaWANDownlinkReservation>& reservations = GetReservations (gateway);
+  auto it = reservations.begin ();
+  while (it != reservations.end () && it->m_start <= txStart)
+    ++it;
+  reservations.insert (it, reservation);
+
+  if (txStart > Simulator::Now ())
+    m_nrAdvanceReservations++;
+}
+
+bool
+LoRaWANDownlinkScheduler::Release (Ptr<LoRaWANGatewayApplication> gateway, Time txStart)
+{
+  NS_LOG_FUNCTION (this << gateway << txStart);
+
+  std::vector<LoRaWANDownlinkReservation>& reservations = GetReservations (gateway);
+  for (auto it = reservations.begin (); it != reservations.end (); ++it) {
+    if (it->m_start == txStart) {
+      reservations.erase (it);
+      return true;
+    }
+  }
+  return false;
+}
+
+void
+LoRaWANDownlinkScheduler::NotifyReservationBroken (void)
+{
+  m_nrReservationBroken++;
+}
+
+uint32_t
+LoRaWANDownlinkScheduler::GetNReservations (Ptr<LoRaWANGatewayApplication> gateway)
+{
+  return GetReservations (gateway).size ();
+}
+
+} // namespace ns3
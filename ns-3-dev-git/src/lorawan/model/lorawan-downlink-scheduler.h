@@ -0,0 +1,138 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+
+#ifndef LORAWAN_DOWNLINK_SCHEDULER_H
+#define LORAWAN_DOWNLINK_SCHEDULER_H
+
+#include "lorawan-mac.h"
+#include <ns3/object.h>
+#include <ns3/nstime.h>
+#include <ns3/traced-value.h>
+
+#include <unordered_map>
+#include <vector>
+
+namespace ns3 {
+
+class LoRaWANGatewayApplication;
+
+/**
+ * \ingroup lorawan
+ *
+ * A downlink that the network server has handed, or is going to hand, to a gateway
+ */
+typedef struct LoRaWANDownlinkReservation {
+  Time     m_start;
+  Time     m_end;
+  uint8_t  m_subBandIndex;
+  Time     m_subBandAvailable;  //!< end of the duty cycle off time that follows the downlink
+} LoRaWANDownlinkReservation;
+
+/**
+ * \ingroup lorawan
+ *
+ * Network server wide downlink scheduler.
+ *
+ * Gateways only transmit downlinks on request of the network server, so by
+ * recording every downlink that is handed to a gateway the scheduler knows the
+ * TX occupancy (a gateway transmits one frame at a time) and the duty cycle
+ * off time of every sub band of every gateway, also in the future. This allows
+ * the network server to:
+ * - pick the gateway for RW1 among all gateways that received the uplink,
+ *   rather than missing RW1 when the preferred gateway is busy;
+ * - reserve a gateway for RW2 as soon as RW1 is known to be missed, so that
+ *   RW1 downlinks to other end devices in the meantime do not take it.
+ *
+ * The scheduling efficiency is reported through trace sources.
+ */
+class LoRaWANDownlinkScheduler : public Object
+{
+public:
+  static TypeId GetTypeId (void);
+
+  LoRaWANDownlinkScheduler ();
+  virtual ~LoRaWANDownlinkScheduler ();
+
+  /**
+   * \brief Select a gateway for a downlink
+   *
+   * \param gateways candidate gateways, most preferred (e.g. best uplink SNR) first
+   * \param channelIndex channel of the downlink
+   * \param dataRateIndex data rate of the downlink
+   * \param txStart start of the downlink, now or in the future
+   * \param phyPayloadSize (estimated) size of the PHY payload of the downlink
+   * \return the first candidate that is able to send the downlink, or nullptr if there is none
+   */
+  Ptr<LoRaWANGatewayApplication> SelectGateway (const std::vector<Ptr<LoRaWANGatewayApplication> >& gateways,
+                                                uint8_t channelIndex, uint8_t dataRateIndex, Time txStart, uint32_t phyPayloadSize);
+
+  /**
+   * \brief Check whether a gateway is able to send a downlink
+   *
+   * A downlink is feasible when it does not overlap with another downlink on
+   * the gateway, does not start during the duty cycle off time of an earlier
+   * downlink on the same sub band and its own off time does not overlap with a
+   * later downlink on that sub band. Downlinks that start now are also checked
+   * against the actual state of the gateway.
+   */
+  bool CanSend (Ptr<LoRaWANGatewayApplication> gateway, uint8_t channelIndex, uint8_t dataRateIndex, Time txStart, uint32_t phyPayloadSize);
+
+  /**
+   * \brief Record a downlink on a gateway
+   *
+   * Replaces an earlier reservation on the gateway with the same start, e.g.
+   * one made with an estimated payload size. Reservations that start in the
+   * future are counted as advance reservations.
+   */
+  void Reserve (Ptr<LoRaWANGatewayApplication> gateway, uint8_t channelIndex, uint8_t dataRateIndex, Time txStart, uint32_t phyPayloadSize);
+
+  /**
+   * \brief Remove the reservation on a gateway that starts at txStart, if any
+   * \return true if a reservation was removed
+   */
+  bool Release (Ptr<LoRaWANGatewayApplication> gateway, Time txStart);
+
+  /**
+   * \brief Record that a gateway reserved for RW2 was not able to send in RW2
+   */
+  void NotifyReservationBroken (void);
+
+  uint32_t GetNReservations (Ptr<LoRaWANGatewayApplication> gateway);
+
+  /**
+   * \brief Time on air of a downlink, using the defaults of the gateway PHY
+   */
+  static Time GetAirTime (uint8_t channelIndex, uint8_t dataRateIndex, uint32_t phyPayloadSize);
+
+private:
+  std::vector<LoRaWANDownlinkReservation>& GetReservations (Ptr<LoRaWANGatewayApplication> gateway);
+
+  std::unordered_map<uint32_t, std::vector<LoRaWANDownlinkReservation> > m_reservations; //!< per gateway node id, ordered on start
+  Ptr<LoRaWANMac::LoRaWANMacRDC> m_macRDC; //!< only used to look up sub band limits
+
+  TracedValue<uint32_t> m_nrAdvanceReservations; //!< number of downlinks reserved before their start
+  TracedValue<uint32_t> m_nrAlternativeGateway; //!< number of downlinks not sent through the most preferred gateway
+  TracedValue<uint32_t> m_nrUnschedulable; //!< number of downlinks for which no gateway was able to send
+  TracedValue<uint32_t> m_nrReservationBroken; //!< number of RW2 reservations the reserved gateway was not able to honour
+};
+
+} // namespace ns3
+
+#endif /* LORAWAN_DOWNLINK_SCHEDULER_H */
@@ -101,6 +101,7 @@ Do some maths on the difference.
 #include "lorawan-enddevice-application.h"
 #include "lorawan-frame-header-uplink.h"
 #include "lorawan-frame-header-downlink.h"
+#include "lorawan-traffic-generator.h"
 #include "ns3/udp-socket-factory.h"
 #include "ns3/string.h"
 #include "ns3/pointer.h"
@@ -114,12 +115,15 @@ NS_OBJECT_ENSURE_REGISTERED (LoRaWANEndDeviceApplication);
 TypeId
 LoRaWANEndDeviceApplication::GetTypeId (void)
 {
-  // Construct default value for the channel random variable:
-  std::stringstream channelRandomVariableSS;
-  const uint32_t channelRandomVariableDefaultMin = 0;
-  const uint32_t channelRandomVariableDefaultMax = (LoRaWAN::m_supportedChannels.size () - 1) - 1; // additional -1 as not to use the 10% RDC channel as an upstream channel
-  channelRandomVariableSS << "ns3::UniformRandomVariable[Min=" << channelRandomVariableDefaultMin << "|Max=" << channelRandomVariableDefaultMax << "]";
-  //std::cout << "LoRaWANEndDeviceApplication::GetTypeId: " << channelRandomVariableSS.str() << std::endl;
+  // Construct default value for the channel random variable (once, GetTypeId is called for every new application):
+  static const std::string channelRandomVariableDefault = [] () {
+    std::stringstream channelRandomVariableSS;
+    const uint32_t channelRandomVariableDefaultMin = 0;
+    const uint32_t channelRandomVariableDefaultMax = LoRaWAN::m_nUplinkChannels - 1; // the uplink channels, e.g. not the 10% RDC channel in EU868, see LoRaWANHelper::SetRegion for other regions
+    channelRandomVariableSS << "ns3::UniformRandomVariable[Min=" << channelRandomVariableDefaultMin << "|Max=" << channelRandomVariableDefaultMax << "]";
+    return channelRandomVariableSS.str ();
+  } ();
+  //std::cout << "LoRaWANEndDeviceApplication::GetTypeId: " << channelRandomVariableDefault << std::endl;
 
   static TypeId tid = TypeId ("ns3::LoRaWANEndDeviceApplication")
     .SetParent<Application> ()
@@ -146,8 +150,14 @@ LoRaWANEndDeviceApplication::GetTypeId (void)
                    BooleanValue (true),
                    MakeBooleanAccessor (&LoRaWANEndDeviceApplication::m_adr),
                    MakeBooleanChecker ())
+    .AddAttribute ("ClassB",
+                   "Class B mode."
+                   "True means the end device sets the Class B bit in its uplinks, so that the network server can send it downlinks in ping slots.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&LoRaWANEndDeviceApplication::m_classB),
+                   MakeBooleanChecker ())
     .AddAttribute ("ChannelRandomVariable", "A RandomVariableStream used to pick the channel for upstream transmissions.",
-                   StringValue (channelRandomVariableSS.str ()),
+                   StringValue (channelRandomVariableDefault),
                    MakePointerAccessor (&LoRaWANEndDeviceApplication::m_channelRandomVariable),
                    MakePointerChecker <RandomVariableStream>())
     .AddAttribute ("UpstreamIAT", "A RandomVariableStream used to pick the time between subsequent US transmissions from this end device.",
@@ -158,6 +168,11 @@ LoRaWANEndDeviceApplication::GetTypeId (void)
                    StringValue ("ns3::UniformRandomVariable[Min=0.0|Max=600.0]"),
                    MakePointerAccessor (&LoRaWANEndDeviceApplication::m_upstreamSendIATRandomVariable),
                    MakePointerChecker <RandomVariableStream>())
+    .AddAttribute ("TrafficGenerator", "A LoRaWANTrafficGenerator shared with other end devices that generates the US transmissions of this end device. "
+                   "If not set, the end device schedules its own US transmissions.",
+                   PointerValue (),
+                   MakePointerAccessor (&LoRaWANEndDeviceApplication::m_trafficGenerator),
+                   MakePointerChecker <LoRaWANTrafficGenerator>())
     .AddAttribute ("MaxBytes",
                    "The total number of bytes to send. Once these bytes are sent, "
                    "no packet is sent again, even in on state. The value zero means "
@@ -179,6 +194,8 @@ LoRaWANEndDeviceApplication::GetTypeId (void)
 LoRaWANEndDeviceApplication::LoRaWANEndDeviceApplication ()
   : m_socket (0),
     m_connected (false),
+    m_trafficSourceId (0),
+    m_trafficSourceAdded (false),
     m_lastTxTime (Seconds (0)),
     m_totBytes (0),
     m_framePort (0),
@@ -194,6 +211,7 @@ LoRaWANEndDeviceApplication::LoRaWANEndDeviceApplication ()
     m_linkAdrAnsPowerAck(false),
     m_linkAdrAnsDataRateAck(false),
     m_linkAdrAnsChannelMaskAck(false),
+    m_channelMask(LoRaWAN::GetDefaultUplinkChannelMask ()),
     m_attemptedThroughput(0),
     m_lastChangedDR(0)
 {
@@ -234,6 +252,65 @@ LoRaWANEndDeviceApplication::SetDataRateIndex (uint32_t index)
     NS_LOG_ERROR (this << " " << index << " is an invalid data rate index");
 }
 
+uint16_t
+LoRaWANEndDeviceApplication::GetChannelMask (void) const
+{
+  return m_channelMask;
+}
+
+void
+LoRaWANEndDeviceApplication::SetChannelMask (uint16_t channelMask)
+{
+  NS_LOG_FUNCTION (this << channelMask);
+
+  if (!LoRaWAN::ApplyLinkADRChannelMask (m_channelMask, channelMask, 0))
+    NS_LOG_ERROR (this << " " << channelMask << " is an invalid channel mask");
+}
+
+double
+LoRaWANEndDeviceApplication::GetTxPowerIndex (void) const
+{
+  return m_txPowerIndex;
+}
+
+void
+LoRaWANEndDeviceApplication::SetTxPowerIndex (double index)
+{
+  NS_LOG_FUNCTION (this << index);
+
+  if (index >= 0 && index < 8)
+    m_txPowerIndex = index;
+  else
+    NS_LOG_ERROR (this << " " << index << " is an invalid tx power index");
+}
+
+uint32_t
+LoRaWANEndDeviceApplication::GetFrameCounterUp (void) const
+{
+  return m_fCntUp;
+}
+
+void
+LoRaWANEndDeviceApplication::SetFrameCounterUp (uint32_t fCntUp)
+{
+  NS_LOG_FUNCTION (this << fCntUp);
+  m_fCntUp = fCntUp;
+}
+
+uint32_t
+LoRaWANEndDeviceApplication::GetAdrAckCounter (void) const
+{
+  return m_adrAckCnt;
+}
+
+void
+LoRaWANEndDeviceApplication::SetAdrAckCounter (uint32_t adrAckCnt)
+{
+  NS_LOG_FUNCTION (this << adrAckCnt);
+  m_adrAckCnt = adrAckCnt;
+  m_adrAckReq = m_adr && m_adrAckCnt >= ADR_ACK_LIMIT;
+}
+
 Ptr<Socket>
 LoRaWANEndDeviceApplication::GetSocket (void) const
 {
@@ -257,6 +334,8 @@ LoRaWANEndDeviceApplication::DoDispose (void)
   NS_LOG_FUNCTION (this);
 
   m_socket = 0;
+  CancelEvents ();
+  m_trafficGenerator = 0;
   PrintFinalDetails();
   // chain up
   Application::DoDispose ();
@@ -298,6 +377,13 @@ void LoRaWANEndDeviceApplication::StartApplication () // Called at time specifie
 
   Time nextSendTime (Seconds (this->m_upstreamSendIATRandomVariable->GetValue ()));
   NS_LOG_LOGIC (this << " upstream nextTime = " << nextSendTime);
+  if (m_trafficGenerator)
+    {
+      m_trafficSourceId = m_trafficGenerator->AddSource (m_upstreamIATRandomVariable, nextSendTime,
+                                                         MakeCallback (&LoRaWANEndDeviceApplication::SendPacket, this));
+      m_trafficSourceAdded = true;
+      return;
+    }
   m_txEvent = Simulator::Schedule (nextSendTime,
                                        &LoRaWANEndDeviceApplication::SendPacket, this); 
 }
@@ -322,6 +408,11 @@ void LoRaWANEndDeviceApplication::CancelEvents ()
   NS_LOG_FUNCTION (this);
 
   Simulator::Cancel (m_txEvent);
+  if (m_trafficSourceAdded)
+    {
+      m_trafficGenerator->RemoveSource (m_trafficSourceId);
+      m_trafficSourceAdded = false;
+    }
 }
 
 
@@ -330,7 +421,11 @@ void LoRaWANEndDeviceApplication::ScheduleNextTx ()
 {
   NS_LOG_FUNCTION (this);
 
-  if (m_maxBytes == 0 || m_totBytes < m_maxBytes)
+  if ((m_maxBytes == 0 || m_totBytes < m_maxBytes) && m_trafficSourceAdded)
+    { // The traffic generator draws the next send time, if it needs one
+      m_trafficGenerator->ScheduleNext (m_trafficSourceId);
+    }
+  else if (m_maxBytes == 0 || m_totBytes < m_maxBytes)
     {
       Time nextTime (Seconds (this->m_upstreamIATRandomVariable->GetValue ()));
       NS_LOG_LOGIC (this << " nextTime = " << nextTime);
@@ -414,8 +509,8 @@ void LoRaWANEndDeviceApplication::SendPacket ()
   packet->AddHeader (fhdr); // Packet now represents MACPayload
 
   // Select channel to use:
-  uint32_t channelIndex = m_channelRandomVariable->GetInteger ();
-  NS_ASSERT (channelIndex <= LoRaWAN::m_supportedChannels.size () - 2); // -2 because end devices should not use the special high power channel for US traffic
+  uint32_t channelIndex = LoRaWAN::SelectUplinkChannel (m_channelRandomVariable, m_channelMask);
+  NS_ASSERT (channelIndex < LoRaWAN::m_nUplinkChannels); // end devices should not use the special high power channel (EU868) or downlink channels (US915) for US traffic
 
   LoRaWANPhyParamsTag phyParamsTag;
 
@@ -588,7 +683,7 @@ LoRaWANEndDeviceApplication::HandleDSPacket (Ptr<Packet> p, Address from)
           uint8_t new_tx = frmHdr.m_txPowerIndex;
           NS_ASSERT_MSG(new_dr != 6, "dr6 not supported! ed side. dr: " << new_dr << "and tx: " << new_tx << "and original val was: " << frmHdr.m_dataRateTXPowerByte);
 
-          if (new_dr < 6) { // 15 indicates no change, 8-14 are RFU, 7 is FSK (not supported in this simulator), and 6 is DR6 with bw=250kHz (not supported in err model yet)
+          if (new_dr <= LoRaWAN::m_maxUplinkDataRateIndex) { // 15 indicates no change, for EU868 8-14 are RFU, 7 is FSK (not supported in this simulator), and 6 is DR6 with bw=250kHz (not supported in err model yet)
             NS_LOG_INFO (this << "received ADR mac, changing data rate from " << m_dataRateIndex << " to " << new_dr);
             m_lastChangedDR = Simulator::Now ().GetSeconds ();
             m_dataRateIndex = new_dr;
@@ -622,8 +717,20 @@ LoRaWANEndDeviceApplication::HandleDSPacket (Ptr<Packet> p, Address from)
             }
           }
 
-          //TODO: support use of change of NbTrans and channel access
-          m_linkAdrAnsChannelMaskAck = true;
+          // NbTrans is applied together with the channel mask, an NbTrans of 0 keeps the current value
+          m_linkAdrAnsChannelMaskAck = LoRaWAN::ApplyLinkADRChannelMask (m_channelMask, frmHdr.m_channelMaskBytes, frmHdr.m_chMaskCntl);
+          if (m_linkAdrAnsChannelMaskAck) {
+            NS_LOG_INFO (this << "received ADR mac, channel mask " << m_channelMask << " nbTrans " << (uint16_t)frmHdr.m_nbTrans);
+            if (frmHdr.m_nbTrans > 0) {
+              Ptr<LoRaWANNetDevice> netDevice = DynamicCast<LoRaWANNetDevice> (GetNode ()->GetDevice (0));
+              if (netDevice)
+                netDevice->SetNbRep (frmHdr.m_nbTrans);
+              else
+                NS_LOG_ERROR (this << " Cannot get LoRaWANNetDevice pointer to apply NbTrans " << (uint16_t)frmHdr.m_nbTrans);
+            }
+          } else {
+            NS_LOG_INFO (this << "received ADR mac, err channel mask");
+          }
 
           //indicate to send MAC level response in next uplink.
           m_doSendLinkAdrAns = true;
@@ -652,7 +759,7 @@ LoRaWANEndDeviceApplication::HandleDSPacket (Ptr<Packet> p, Address from)
   Ptr<LoRaWANNetDevice> netDevice = DynamicCast<LoRaWANNetDevice> (GetNode ()->GetDevice (0));
   Ptr<LoRaWANMac> mac = netDevice->GetMac ();
   LoRaWANMacState state = mac->GetLoRaWANMacState ();
-  NS_ASSERT (state == MAC_RW1 || state == MAC_RW2);
+  NS_ASSERT (state == MAC_RW1 || state == MAC_RW2 || state == MAC_PINGSLOT);
 
   // Log packet reception
   Ipv4Address myAddress = Ipv4Address::ConvertFrom (GetNode ()->GetDevice (0)->GetAddress ());
@@ -661,6 +768,8 @@ LoRaWANEndDeviceApplication::HandleDSPacket (Ptr<Packet> p, Address from)
     m_dsMsgReceivedTrace (deviceAddress, msgTypeTag.GetMsgType(), p, 1);
   else if (state == MAC_RW2)
     m_dsMsgReceivedTrace (deviceAddress, msgTypeTag.GetMsgType(), p, 2);
+  else
+    m_dsMsgReceivedTrace (deviceAddress, msgTypeTag.GetMsgType(), p, 0); // class B ping slot
 }
 
 void LoRaWANEndDeviceApplication::ConnectionSucceeded (Ptr<Socket> socket)
@@ -683,10 +792,9 @@ void LoRaWANEndDeviceApplication::AdaptiveDataRate ()
   // in a nutshell, if the data rate or the tx power is set to below the default, the device periodically validates that messages are successfully being received.
  
  
-  //TODO: choice of available channels is always all of them right now. Implement channel switches
   //TODO: the table included in the LoRaWAN ADR definition contradicts the algorithm? Double check?
 
-  if( (m_txPowerIndex > 0) | (m_dataRateIndex > 0) /*| not all channels open*/)
+  if( (m_txPowerIndex > 0) | (m_dataRateIndex > 0) | (m_channelMask != LoRaWAN::GetDefaultUplinkChannelMask ()))
   {
       if (m_adrAckCnt == ADR_ACK_LIMIT) {
         NS_LOG_INFO (this << " at time " << Simulator::Now ().GetSeconds ()  <<  " node " << GetNode()->GetId() << " adrAckCnt hit ADR_ACK_LIMIT");
@@ -702,10 +810,10 @@ void LoRaWANEndDeviceApplication::AdaptiveDataRate ()
           m_dataRateIndex--; // slow data rate by 1
           NS_LOG_INFO (this << "... so slowing data rate to " << m_dataRateIndex << " on node " << GetNode()->GetId());
           m_lastChangedDR = Simulator::Now ().GetSeconds ();
-        } /* else if (not all channels open) {
-          //Note: in the current implementation of the simulator all channels are always available
-          //open all channels
-        }*/
+        } else { // all channels are not open
+          m_channelMask = LoRaWAN::GetDefaultUplinkChannelMask ();
+          NS_LOG_INFO (this << "... so enabling all uplink channels on node " << GetNode()->GetId());
+        }
         m_adrAckCnt = ADR_ACK_LIMIT;  
       }
 
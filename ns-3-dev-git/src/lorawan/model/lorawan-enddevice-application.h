@@ -41,6 +41,7 @@ namespace ns3 {
 class Address;
 class RandomVariableStream;
 class Socket;
+class LoRaWANTrafficGenerator;
 
 /**
  * \ingroup lorawan
@@ -77,6 +78,31 @@ public:
   uint32_t GetDataRateIndex (void) const;
   void SetDataRateIndex (uint32_t index);
 
+  double GetTxPowerIndex (void) const;
+  void SetTxPowerIndex (double index);
+
+  uint32_t GetFrameCounterUp (void) const;
+  void SetFrameCounterUp (uint32_t fCntUp);
+
+  /**
+   * \brief The uplink channels this end device may use, bit i enables channel i
+   *
+   * Set by the ChMask of LinkADRReq, all uplink channels are enabled by default.
+   */
+  uint16_t GetChannelMask (void) const;
+  void SetChannelMask (uint16_t channelMask);
+
+  uint32_t GetAdrAckCounter (void) const;
+  /**
+   * \brief Set the number of uplinks sent since the last downlink.
+   *
+   * The AdrAckReq bit is derived from the counter, so that a device that is
+   * restored past ADR_ACK_LIMIT keeps requesting a downlink.
+   *
+   * \param adrAckCnt the ADR acknowledgement counter
+   */
+  void SetAdrAckCounter (uint32_t adrAckCnt);
+
   /**
    * \brief Return a pointer to associated socket.
    * \return pointer to associated socket
@@ -122,6 +148,9 @@ private:
   Ptr<RandomVariableStream> m_channelRandomVariable;	//!< rng for channel selection for upstream TX
   Ptr<RandomVariableStream> m_upstreamIATRandomVariable;	//!< rng for inter arrival timing for upstream TX
   Ptr<RandomVariableStream> m_upstreamSendIATRandomVariable;
+  Ptr<LoRaWANTrafficGenerator> m_trafficGenerator; //!< if set, generates the uplinks instead of m_txEvent
+  uint32_t        m_trafficSourceId; //!< id of this application in m_trafficGenerator
+  bool            m_trafficSourceAdded;
   uint32_t        m_pktSize;      //!< Size of packets
   uint32_t 	  m_dataRateIndex;	//!< Data rate index to use for US transmissions
   Time            m_lastTxTime; //!< Time last packet sent
@@ -153,6 +182,7 @@ private:
   bool            m_linkAdrAnsPowerAck;
   bool            m_linkAdrAnsDataRateAck;
   bool            m_linkAdrAnsChannelMaskAck;
+  uint16_t        m_channelMask;  //!< Uplink channels enabled by LinkADRReq
 
   uint32_t    m_attemptedThroughput;
 
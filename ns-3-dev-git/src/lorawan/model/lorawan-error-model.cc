@@ -97,10 +97,12 @@ LoRaWANErrorModel::LoRaWANErrorModel (void)
 double
 LoRaWANErrorModel::getBER (double snr_db, uint32_t bandWidth, LoRaSpreadingFactor spreadingFactor, uint8_t codeRate) const
 {
-  NS_ASSERT( bandWidth == 125e3 );
+  NS_ASSERT( bandWidth == 125e3 || bandWidth == 250e3 || bandWidth == 500e3 );
   NS_ASSERT( spreadingFactor == LORAWAN_SF7 || spreadingFactor == LORAWAN_SF8 || spreadingFactor == LORAWAN_SF9 || spreadingFactor == LORAWAN_SF10 || spreadingFactor == LORAWAN_SF11 || spreadingFactor == LORAWAN_SF12);
   NS_ASSERT( codeRate == 1 || codeRate == 3 );
-  // Note only bandwidth 125kHz is supported
+  // Note the curves were fitted for 125kHz. The SNR is measured in the
+  // bandwidth of the channel, so that the higher noise floor of 250kHz and
+  // 500kHz channels is accounted for, the processing gain of a SF is the same.
 
   double snr_db_rounded = snr_db;
 
@@ -145,7 +147,7 @@ LoRaWANErrorModel::getBER (double snr_db, uint32_t bandWidth, LoRaSpreadingFacto
 double
 LoRaWANErrorModel::GetChunkSuccessRate (double snr_db, uint32_t nbits, uint32_t bandWidth, LoRaSpreadingFactor spreadingFactor, uint8_t codeRate) const
 {
-  NS_ASSERT( bandWidth == 125e3 );
+  NS_ASSERT( bandWidth == 125e3 || bandWidth == 250e3 || bandWidth == 500e3 );
   NS_ASSERT( spreadingFactor == LORAWAN_SF7 || spreadingFactor == LORAWAN_SF8 || spreadingFactor == LORAWAN_SF9 || spreadingFactor == LORAWAN_SF10 || spreadingFactor == LORAWAN_SF11 || spreadingFactor == LORAWAN_SF12);
   NS_ASSERT( codeRate == 1 || codeRate == 3 );
 
@@ -165,7 +167,7 @@ LoRaWANErrorModel::GetChunkSuccessRate (double snr_db, uint32_t nbits, uint32_t
 double
 LoRaWANErrorModel::getSNRCutoffForRX (uint32_t bandWidth, LoRaSpreadingFactor spreadingFactor, uint8_t codeRate) const
 {
-  NS_ASSERT( bandWidth == 125e3);
+  NS_ASSERT( bandWidth == 125e3 || bandWidth == 250e3 || bandWidth == 500e3 );
   NS_ASSERT( spreadingFactor == LORAWAN_SF7 || spreadingFactor == LORAWAN_SF8 || spreadingFactor == LORAWAN_SF9 || spreadingFactor == LORAWAN_SF10 || spreadingFactor == LORAWAN_SF11 || spreadingFactor == LORAWAN_SF12);
   NS_ASSERT( codeRate == 1 || codeRate == 3);
 
@@ -210,4 +212,30 @@ LoRaWANErrorModel::getSNRCutoffForRX (uint32_t bandWidth, LoRaSpreadingFactor sp
   NS_FATAL_ERROR (this << "Unsupported SF/CR parameters for SNR Cut off");
   return 0;
 }
+
+void
+LoRaWANErrorModel::GetBERCurve (LoRaSpreadingFactor spreadingFactor, uint8_t codeRate, double& a, double& b, double& snrMin) const
+{
+  NS_ASSERT( spreadingFactor == LORAWAN_SF7 || spreadingFactor == LORAWAN_SF8 || spreadingFactor == LORAWAN_SF9 || spreadingFactor == LORAWAN_SF10 || spreadingFactor == LORAWAN_SF11 || spreadingFactor == LORAWAN_SF12);
+  NS_ASSERT( codeRate == 1 || codeRate == 3 );
+
+  // Same limits and coefficient index as in getBER
+  if (spreadingFactor == LORAWAN_SF11)
+    snrMin = -23;
+  else if (spreadingFactor == LORAWAN_SF12)
+    snrMin = -26;
+  else
+    snrMin = -20;
+
+  uint8_t coefIndex = (spreadingFactor-7)*2;
+  if (codeRate == 3)
+    coefIndex+=1;
+
+  if (coefIndex >= LORAWAN_ERROR_MODEL_NR_COEFF) {
+    NS_FATAL_ERROR (this << "invalid coef index");
+  }
+
+  a = m_aCoefficients[coefIndex];
+  b = m_bCoefficients[coefIndex];
+}
 } // namespace ns3
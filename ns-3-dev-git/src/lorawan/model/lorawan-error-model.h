@@ -79,6 +79,15 @@ public:
    * \return SNR cutoff in dB
    */
   double getSNRCutoffForRX (uint32_t bandwidth, LoRaSpreadingFactor spreadingFactor, uint8_t codeRate) const;
+
+  /**
+   * Return the curve used by getBER: log10(BER) = a*exp(b*x) where x is the
+   * SNR in dB limited to [snrMin, 0]
+   *
+   * Allows callers that evaluate many links at once to hoist the curve lookup
+   * out of their loops.
+   */
+  void GetBERCurve (LoRaSpreadingFactor spreadingFactor, uint8_t codeRate, double& a, double& b, double& snrMin) const;
 private:
   /**
    * Array of precalculated curve fitting coefficients.
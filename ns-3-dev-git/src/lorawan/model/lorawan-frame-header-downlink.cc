@@ -281,6 +281,8 @@ LoRaWANFrameHeaderDownlink::Deserialize (Buffer::Iterator start)
       m_dataRateIndex = m_dataRateTXPowerByte & 0xF0;
       m_dataRateIndex = m_dataRateIndex >> 4; //TODO: double-check this works
       m_txPowerIndex = m_dataRateTXPowerByte & 0xF;
+      m_chMaskCntl = (m_redundancy >> 4) & 0x07;
+      m_nbTrans = m_redundancy & 0x0F;
 
       // TODO: use this data inside this class (currently done outside the class)
 
@@ -332,7 +334,7 @@ bool LoRaWANFrameHeaderDownlink::AddLoRaADRReq (uint8_t dataRateIndex, uint8_t t
     return false;
   } 
 
-  if(nbTrans > 7) {
+  if(nbTrans > 15) {
     //TODO: print err
     return false;
   } 
@@ -345,15 +347,15 @@ bool LoRaWANFrameHeaderDownlink::AddLoRaADRReq (uint8_t dataRateIndex, uint8_t t
   m_dataRateTXPowerByte |= txPower; //rest for TxPower
   
   // each bit in the channelMask represents a channel, a 1 indicates that channel can be used
-  m_channelMaskBytes = channelMask; //TODO: not implemented here, a static set of channels is always used (see lorawan.cc)
+  m_channelMaskBytes = channelMask;
 
   // last byte is the Redundancy
   // bits [6:4] are the chMaskCtrl, it controls the block of 16 channels to which chMask applies
   chMaskCtrl = chMaskCtrl << 4;
-  m_redundancy |= chMaskCtrl; //TODO: not implemented here, a static set of channels is always used (see lorawan.cc)
+  m_redundancy |= chMaskCtrl;
 
   // bits [3:0] are the NbTrans, it is the number of transmissions for each uplink message
-  m_redundancy |= nbTrans; //TODO: implement use of NbTrans
+  m_redundancy |= nbTrans;
 
   m_macCommandsNS[LinkADRReq].m_isBeingUsed = true;
 
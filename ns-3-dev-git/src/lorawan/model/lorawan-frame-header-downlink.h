@@ -143,6 +143,8 @@ public:
 
   uint8_t m_dataRateIndex; // part of LinkADRReq; only populated in deserialisation
   uint8_t m_txPowerIndex;  // part of txPowerIndex; only populated in deserialisation
+  uint8_t m_chMaskCntl;    // part of LinkADRReq; only populated in deserialisation
+  uint8_t m_nbTrans;       // part of LinkADRReq; only populated in deserialisation
   
 private:
   Ipv4Address m_devAddr; //!< Short device address of end-device
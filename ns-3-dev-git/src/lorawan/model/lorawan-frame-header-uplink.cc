@@ -230,6 +230,19 @@ LoRaWANFrameHeaderUplink::Serialize (Buffer::Iterator start) const
   
 }
 
+bool
+LoRaWANFrameHeaderUplink::PeekDevAddrAndFrameCounter (Ptr<const Packet> packet, uint32_t &devAddr, uint16_t &frameCounter)
+{
+  // DevAddr (4 bytes), FCtrl (1 byte) and FCnt (2 bytes), written LSB first by Serialize
+  uint8_t buffer[7];
+  if (packet->CopyData (buffer, 7) != 7)
+    return false;
+
+  devAddr = buffer[0] | (buffer[1] << 8) | (buffer[2] << 16) | ((uint32_t)buffer[3] << 24);
+  frameCounter = buffer[5] | (buffer[6] << 8);
+  return true;
+}
+
 uint32_t
 LoRaWANFrameHeaderUplink::Deserialize (Buffer::Iterator start)
 {
@@ -21,6 +21,7 @@
 #define LORAWAN_FRAME_HEADER_UPLINK_H
 
 #include <ns3/header.h>
+#include <ns3/packet.h>
 #include "ns3/ipv4-address.h"
 
 //common to both
@@ -86,7 +87,7 @@ public:
   bool getAdrAckReq() const;
   void setAdrAckReq(bool);
 
-  bool getClassB() const; //note: not currently used.
+  bool getClassB() const;
   void setClassB(bool); 
 
   uint16_t getFrameCounter() const;
@@ -113,6 +114,17 @@ public:
   bool IsAck() const;
   bool IsFramePending() const;
 
+  /**
+   * \brief Read the device address and frame counter of a serialized uplink
+   * frame header without deserializing it
+   *
+   * \param packet packet that starts with an uplink frame header
+   * \param devAddr set to the device address
+   * \param frameCounter set to the frame counter
+   * \return false if the packet is too short to hold a frame header
+   */
+  static bool PeekDevAddrAndFrameCounter (Ptr<const Packet> packet, uint32_t &devAddr, uint16_t &frameCounter);
+
   bool AddLoRaADRAns (bool powerAck, bool drAck, bool channelMaskAck);
 
   std::vector<LoRaWANMacCommandUplink> m_macCommandsED = { //MAC commands sent by ED
@@ -32,16 +32,22 @@
 #include "ns3/socket-factory.h"
 #include "ns3/packet.h"
 #include "ns3/uinteger.h"
+#include "ns3/double.h"
 #include "ns3/trace-source-accessor.h"
 #include "lorawan.h"
 #include "lorawan-net-device.h"
 #include "lorawan-gateway-application.h"
+#include "lorawan-adr-policy.h"
 #include "lorawan-frame-header-uplink.h"
 #include "lorawan-frame-header-downlink.h"
+#include "lorawan-mac-header.h"
 #include "ns3/udp-socket-factory.h"
 #include "ns3/string.h"
 #include "ns3/pointer.h"
 
+#include <algorithm>
+#include <cmath>
+
 namespace ns3 {
 
 NS_LOG_COMPONENT_DEFINE ("LoRaWANGatewayApplication");
@@ -69,7 +75,9 @@ const std::vector<LoRaWANAdrSnrDrRequirement> LoRaWANNetworkServer::m_adrSnrRequ
 
 Ptr<LoRaWANNetworkServer> LoRaWANNetworkServer::m_ptr = NULL;
 
-LoRaWANNetworkServer::LoRaWANNetworkServer () : m_endDevices(), m_pktSize(0), m_generateDataDown(false), m_confirmedData(false), m_endDevicesPopulated(false), m_downstreamIATRandomVariable(nullptr), m_nrRW1Sent(0), m_nrRW2Sent(0), m_nrRW1Missed(0), m_nrRW2Missed(0) {}
+LoRaWANNetworkServer::LoRaWANNetworkServer () : m_endDevices(), m_deduplicationWindow(), m_downlinkScheduler(CreateObject<LoRaWANDownlinkScheduler> ()), m_adrPolicy(CreateObject<LoRaWANSemtechAdrPolicy> ()), m_pktSize(0), m_generateDataDown(false), m_confirmedData(false), m_endDevicesPopulated(false), m_downstreamIATRandomVariable(nullptr), m_nrRW1Sent(0), m_nrRW2Sent(0), m_nrRW1Missed(0), m_nrRW2Missed(0), m_nrPingSlotSent(0), m_nrPingSlotMissed(0), m_pingSlotPeriodicity(7), m_channelLoad(LoRaWAN::m_supportedChannels.size (), 0.0), m_channelLoadUpdated(Seconds (0)) {}
+
+LoRaWANNetworkServer::~LoRaWANNetworkServer () {}
 
 TypeId
 LoRaWANNetworkServer::GetTypeId (void)
@@ -114,6 +122,19 @@ LoRaWANNetworkServer::GetTypeId (void)
                      "The number of times RW2 was missed for all end devics served by this network server",
                      MakeTraceSourceAccessor (&LoRaWANNetworkServer::m_nrRW2Missed),
                      "ns3::TracedValueCallback::Uint32")
+    .AddTraceSource ("nrPingSlotSent",
+                     "The number of times that a DS packet was sent in a class B ping slot by this network server",
+                     MakeTraceSourceAccessor (&LoRaWANNetworkServer::m_nrPingSlotSent),
+                     "ns3::TracedValueCallback::Uint32")
+    .AddTraceSource ("nrPingSlotMissed",
+                     "The number of times no gateway was available in the next ping slots of a class B end device",
+                     MakeTraceSourceAccessor (&LoRaWANNetworkServer::m_nrPingSlotMissed),
+                     "ns3::TracedValueCallback::Uint32")
+    .AddAttribute ("PingSlotPeriodicity",
+                   "The ping slot periodicity of class B end devices (0-7): they have 2^(7-PingSlotPeriodicity) ping slots per beacon period of 128 s.",
+                   UintegerValue (7),
+                   MakeUintegerAccessor (&LoRaWANNetworkServer::m_pingSlotPeriodicity),
+                   MakeUintegerChecker<uint8_t> (0, 7))
     .AddTraceSource ("DSMsgGenerated",
                      "A DS msg for an end device has been generated by this network server",
                      MakeTraceSourceAccessor (&LoRaWANNetworkServer::m_dsMsgGeneratedTrace),
@@ -139,6 +160,51 @@ LoRaWANNetworkServer::GetTypeId (void)
                    BooleanValue (false),
                    MakeBooleanAccessor (&LoRaWANNetworkServer::m_snrCutoffValuesSource),
                    MakeBooleanChecker ())
+    .AddAttribute ("AdrTargetFrameLoss",
+                   "The fraction of the frames of an end device that may be lost, the ADR algorithm sets NbTrans to the lowest value that meets it.",
+                   DoubleValue (0.05),
+                   MakeDoubleAccessor (&LoRaWANNetworkServer::m_adrTargetFrameLoss),
+                   MakeDoubleChecker<double> (0.0, 1.0))
+    .AddAttribute ("AdrMaxNbTrans",
+                   "The maximum NbTrans the ADR algorithm gives an end device, 1 disables the repetition of uplinks by ADR.",
+                   UintegerValue (1),
+                   MakeUintegerAccessor (&LoRaWANNetworkServer::m_adrMaxNbTrans),
+                   MakeUintegerChecker<uint8_t> (1, 15))
+    .AddAttribute ("AdrChannelMask",
+                   "Let the ADR algorithm disable congested uplink channels in the channel mask of end devices.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&LoRaWANNetworkServer::m_adrChannelMask),
+                   MakeBooleanChecker ())
+    .AddAttribute ("AdrChannelLoadMargin",
+                   "A channel is congested when its load is more than this fraction above the mean load of the uplink channels.",
+                   DoubleValue (0.5),
+                   MakeDoubleAccessor (&LoRaWANNetworkServer::m_adrChannelLoadMargin),
+                   MakeDoubleChecker<double> (0.0))
+    .AddAttribute ("AdrChannelMinLoad",
+                   "The fraction of time a channel has to be occupied by uplinks before it can be congested.",
+                   DoubleValue (0.01),
+                   MakeDoubleAccessor (&LoRaWANNetworkServer::m_adrChannelMinLoad),
+                   MakeDoubleChecker<double> (0.0, 1.0))
+    .AddAttribute ("ChannelLoadWindow",
+                   "The time constant of the exponentially decaying uplink airtime per channel that measures the load of the channels.",
+                   TimeValue (Hours (1)),
+                   MakeTimeAccessor (&LoRaWANNetworkServer::m_channelLoadWindow),
+                   MakeTimeChecker (Seconds (1)))
+    .AddAttribute ("DeduplicationWindow",
+                   "The time during which the NS collects the copies of an uplink received by different gateways before processing the uplink once. Must end before RW1 opens.",
+                   TimeValue (MilliSeconds (200)),
+                   MakeTimeAccessor (&LoRaWANNetworkServer::m_deduplicationWindow),
+                   MakeTimeChecker (Seconds (0), MicroSeconds (RECEIVE_DELAY1 - 1)))
+    .AddAttribute ("DownlinkScheduler",
+                   "The scheduler that selects the gateway and receive window for downlinks, and keeps track of the TX occupancy and duty cycle of all gateways.",
+                   PointerValue (),
+                   MakePointerAccessor (&LoRaWANNetworkServer::m_downlinkScheduler),
+                   MakePointerChecker<LoRaWANDownlinkScheduler> ())
+    .AddAttribute ("AdrPolicy",
+                   "The policy that selects the data rate, tx power, NbTrans and channel mask of end devices, by default the per device algorithm of Semtech. Without a policy the NS does not run ADR.",
+                   PointerValue (),
+                   MakePointerAccessor (&LoRaWANNetworkServer::m_adrPolicy),
+                   MakePointerChecker<LoRaWANAdrPolicy> ())
   ;
   return tid;
 }
@@ -158,10 +224,16 @@ LoRaWANNetworkServer::PopulateEndDevices (void)
   if (m_endDevicesPopulated)
     return;
 
+  // Size the table for all nodes up front, rather than rehashing while it grows
+  ReserveEndDevices (m_endDevices.size () + NodeList::GetNNodes ());
+
   // Populate m_endDevices based on ns3::NodeList
   for (NodeList::Iterator it = NodeList::Begin (); it != NodeList::End (); ++it)
   {
     Ptr<Node> nodePtr(*it);
+    if (nodePtr->GetNDevices () == 0)
+      continue;
+
     Address devAddr = nodePtr->GetDevice (0)->GetAddress();
     if (Ipv4Address::IsMatchingType (devAddr)) {
       Ipv4Address ipv4DevAddr = Ipv4Address::ConvertFrom (devAddr);
@@ -170,9 +242,15 @@ LoRaWANNetworkServer::PopulateEndDevices (void)
       }
 
       // Construct LoRaWANEndDeviceInfoNS object
-      LoRaWANEndDeviceInfoNS info = InitEndDeviceInfo (ipv4DevAddr);
       uint32_t key = ipv4DevAddr.Get ();
-      m_endDevices[key] = info; // store object
+      m_endDevices[key] = InitEndDeviceInfo (ipv4DevAddr); // store object, moved rather than copied
+
+      // Keep the MAC of the end device, so that it can be told to open a class B ping slot
+      Ptr<LoRaWANNetDevice> netDevice = DynamicCast<LoRaWANNetDevice> (nodePtr->GetDevice (0));
+      if (netDevice) {
+        m_endDevices[key].m_mac = netDevice->GetMac ();
+        m_endDevices[key].m_nbTrans = netDevice->GetNbRep ();
+      }
     } else {
       NS_LOG_ERROR (this << " Unable to allocate device address");
       continue;
@@ -181,6 +259,25 @@ LoRaWANNetworkServer::PopulateEndDevices (void)
   m_endDevicesPopulated = true;
 }
 
+void
+LoRaWANNetworkServer::AddEndDevice (Ipv4Address deviceAddr)
+{
+  NS_LOG_FUNCTION (this << deviceAddr);
+
+  uint32_t key = deviceAddr.Get ();
+  if (m_endDevices.find (key) != m_endDevices.end ())
+    return;
+
+  m_endDevices[key] = InitEndDeviceInfo (deviceAddr);
+}
+
+void
+LoRaWANNetworkServer::ReserveEndDevices (uint32_t nEndDevices)
+{
+  NS_LOG_FUNCTION (this << nEndDevices);
+  m_endDevices.reserve (nEndDevices);
+}
+
 void
 LoRaWANNetworkServer::DoDispose (void)
 {
@@ -188,6 +285,24 @@ LoRaWANNetworkServer::DoDispose (void)
 
   PrintFinalDetails();
 
+  for (auto it = m_pendingUplinks.begin (); it != m_pendingUplinks.end (); ++it)
+    it->second.m_timer.Cancel ();
+  m_pendingUplinks.clear ();
+  m_downlinkScheduler = nullptr;
+  if (m_adrPolicy)
+    m_adrPolicy->Dispose ();
+  m_adrPolicy = nullptr;
+
+  for (auto it = m_endDevices.begin (); it != m_endDevices.end (); ++it) {
+    it->second.m_downstreamQueue.Clear ();
+    it->second.m_pingSlotTimer.Cancel ();
+    it->second.m_pingSlotGW = nullptr;
+    it->second.m_mac = nullptr;
+  }
+  // the network server is the only owner of DS queue elements
+  NS_ASSERT_MSG (LoRaWANQueueElementPool<LoRaWANNSDSQueueElement>::GetNInUse () == 0,
+                 LoRaWANQueueElementPool<LoRaWANNSDSQueueElement>::GetNInUse () << " DS queue elements leaked");
+
   Object::DoDispose ();
 }
 
@@ -211,6 +326,26 @@ LoRaWANNetworkServer::InitEndDeviceInfo (Ipv4Address ipv4DevAddr)
   return info;
 }
 
+LoRaWANEndDeviceInfoNS*
+LoRaWANNetworkServer::GetEndDeviceInfo (uint32_t deviceAddr)
+{
+  auto it = m_endDevices.find (deviceAddr);
+  if (it == m_endDevices.end ())
+    return nullptr;
+
+  return &it->second;
+}
+
+std::vector<uint32_t>
+LoRaWANNetworkServer::GetEndDeviceAddresses (void) const
+{
+  std::vector<uint32_t> deviceAddrs;
+  deviceAddrs.reserve (m_endDevices.size ());
+  for (const auto& endDevice : m_endDevices)
+    deviceAddrs.push_back (endDevice.first);
+  return deviceAddrs;
+}
+
 Ptr<LoRaWANNetworkServer>
 LoRaWANNetworkServer::getLoRaWANNetworkServerPointer ()
 {
@@ -228,86 +363,150 @@ LoRaWANNetworkServer::HandleUSPacket (Ptr<LoRaWANGatewayApplication> lastGW, Add
   NS_LOG_FUNCTION(this);
   NS_LOG_INFO("In HandleUSPacket!");
 
-  // PacketSocketAddress fromAddress = PacketSocketAddress::ConvertFrom (from);
-
-  // Decode Frame header
-  //LoRaWANFrameHeader frmHdr;
-  LoRaWANFrameHeaderUplink frmHdr;
-  frmHdr.setSerializeFramePort (true); // Assume that frame Header contains Frame Port so set this to true so that RemoveHeader will deserialize the FPort
-  packet->RemoveHeader (frmHdr);
+  // Only read the key of the uplink here, the frame header is deserialized once per uplink in ProcessUSPacket
+  uint32_t key;
+  uint16_t frameCounter;
+  if (!LoRaWANFrameHeaderUplink::PeekDevAddrAndFrameCounter (packet, key, frameCounter)) {
+    NS_LOG_ERROR (this << " Received US packet that is too short to contain a frame header, dropping it");
+    return;
+  }
 
   // Find end device meta data:
-  Ipv4Address deviceAddr = frmHdr.getDevAddr ();
-
-  //NS_LOG_INFO(this << "Received packet from device addr = " << deviceAddr);
-  uint32_t key = deviceAddr.Get ();
   auto it = m_endDevices.find (key);
   if (it == m_endDevices.end ()) { // not found, so create a new struct and insert it (note this should have already happened in DoInitialize()):
+    Ipv4Address deviceAddr (key);
     NS_LOG_WARN (this << " end device with address = " << deviceAddr << " not found in m_endDevices, allocating");
 
-    LoRaWANEndDeviceInfoNS info = InitEndDeviceInfo (deviceAddr);
-    m_endDevices[key] = info;
+    m_endDevices[key] = InitEndDeviceInfo (deviceAddr);
     it = m_endDevices.find (key);
   }
 
   // Always update number of received upstream packets:
-  it->second.m_nUSPackets += 1;                      
+  it->second.m_nUSPackets += 1;
+
+  double snr = 0.0;
+  LoRaWANPhyParamsTag phyParamsTag;
+  bool haveSnr = packet->PeekPacketTag (phyParamsTag);
+  if (haveSnr) {
+    snr = phyParamsTag.GetSinrAvg ();
+  } else {
+    NS_LOG_WARN (this << " LoRaWANPhyParamsTag not found on packet.");
+  }
+
+  // Copy of an uplink whose deduplication window is still open: merge it
+  const uint64_t uplinkKey = ((uint64_t)key << 16) | frameCounter;
+  auto it_pending = m_pendingUplinks.find (uplinkKey);
+  if (it_pending != m_pendingUplinks.end ()) {
+    LoRaWANNSPendingUplink& pending = it_pending->second;
+    it->second.m_nUSDuplicates += 1;
+    NS_LOG_INFO (this << " Duplicate of frame " << frameCounter << " from device " << key << " received by another gateway, merging");
+
+    pending.m_gateways.push_back (std::make_pair (snr, lastGW));
+    if (haveSnr && (!pending.m_haveSnr || snr > pending.m_snrMax)) {
+      pending.m_snrMax = snr;
+      pending.m_haveSnr = true;
+      pending.m_packet = packet;
+    }
+    return;
+  }
 
-  // Always update last seen GWs:
-  if ((Simulator::Now () - it->second.m_lastSeen) > Seconds(1.0)) { // assume a new upstream transmission, so clear the vector of seenGWs
-    it->second.m_lastGWs.clear ();
+  // Copy of an uplink that was already processed, arriving after the window
+  // (iii) in ProcessUSPacket: the same transmission received by a second gateway
+  if (frameCounter <= it->second.m_fCntUp && it->second.m_nUSPackets > 1
+      && Simulator::Now () - it->second.m_lastSeen <= MicroSeconds (RECEIVE_DELAY1)) {
+    MergeLateDuplicate (it->second, lastGW, frameCounter, packet);
+    return;
   }
-  it->second.m_lastGWs.push_back (lastGW);
 
-  // if a packet is new, add it to the m_frameSNRHistory. If it's a duplicate, modify the original's SNR and GtwDiversity as needed.
+  // First copy of a new uplink, open the deduplication window
+  LoRaWANNSPendingUplink& pending = m_pendingUplinks[uplinkKey];
+  pending.m_packet = packet;
+  pending.m_firstSeen = Simulator::Now ();
+  pending.m_snrMax = snr;
+  pending.m_haveSnr = haveSnr;
+  pending.m_gateways.push_back (std::make_pair (snr, lastGW));
+  pending.m_timer = Simulator::Schedule (m_deduplicationWindow, &LoRaWANNetworkServer::ProcessUSPacket, this, uplinkKey);
+}
+
+void
+LoRaWANNetworkServer::MergeLateDuplicate (LoRaWANEndDeviceInfoNS& info, Ptr<LoRaWANGatewayApplication> gateway, uint16_t frameCounter, Ptr<Packet> packet)
+{
+  NS_LOG_FUNCTION (this << frameCounter);
+
+  info.m_nUSDuplicates += 1;
+  info.m_lastGWs.push_back (gateway);
+  NS_LOG_INFO (this << " Duplicate of frame " << frameCounter << " received after the deduplication window, t = " << Simulator::Now () - info.m_lastSeen);
+
+  //modify the original's SNR and GtwDiversity
+  //loop through vector (newest are at the start, so search should be quick)
+  for (auto & row : info.m_frameSNRHistory) {
+    if (row.frameCounter == frameCounter) {
+      row.gtwDiversity++;
+
+      LoRaWANPhyParamsTag phyParamsTag;
+      if (packet->PeekPacketTag (phyParamsTag)) {
+        if (row.snrMax < phyParamsTag.GetSinrAvg ()) {
+          row.snrMax = phyParamsTag.GetSinrAvg ();
+          NS_LOG_INFO("Modifying current row, the sinr was:" << phyParamsTag.GetSinrAvg ());
+        }
+      } else {
+        NS_LOG_WARN (this << " LoRaWANPhyParamsTag not found on packet.");
+      }
+      break;
+    }
+  }
+}
+
+void
+LoRaWANNetworkServer::ProcessUSPacket (uint64_t uplinkKey)
+{
+  NS_LOG_FUNCTION (this << uplinkKey);
+
+  auto it_pending = m_pendingUplinks.find (uplinkKey);
+  NS_ASSERT (it_pending != m_pendingUplinks.end ());
+  LoRaWANNSPendingUplink pending = std::move (it_pending->second);
+  m_pendingUplinks.erase (it_pending);
 
-  // Check for duplicate.
+  Ptr<Packet> packet = pending.m_packet;
+
+  // Decode Frame header
+  LoRaWANFrameHeaderUplink frmHdr;
+  frmHdr.setSerializeFramePort (true); // Assume that frame Header contains Frame Port so set this to true so that RemoveHeader will deserialize the FPort
+  packet->RemoveHeader (frmHdr);
+
+  Ipv4Address deviceAddr = frmHdr.getDevAddr ();
+  uint32_t key = deviceAddr.Get ();
+  auto it = m_endDevices.find (key);
+  NS_ASSERT (it != m_endDevices.end ()); // inserted by HandleUSPacket
+
+  // The gateways that received the uplink, best SNR first: RW1 and RW2 pick the first of these gateways that is able to send
+  std::stable_sort (pending.m_gateways.begin (), pending.m_gateways.end (),
+                    [] (const std::pair<double, Ptr<LoRaWANGatewayApplication> >& a,
+                        const std::pair<double, Ptr<LoRaWANGatewayApplication> >& b) { return a.first > b.first; });
+  it->second.m_lastGWs.clear ();
+  for (const auto& gateway : pending.m_gateways)
+    it->second.m_lastGWs.push_back (gateway.second);
+
+  // if a packet is new, add it to the m_frameSNRHistory, with the best SNR and the gateway diversity of all of its copies.
+
+  // Check for retransmission.
   // Depending on the frame counter and received time, we can classify the US Packet as:
   // i) The first time the NS sees the US Packet: i.e. new frame counter up value
   // ii) Retransmission of a previously transmitted US Packet (then the NS has to reply with an Ack): i.e. frame counter up already seen, seen longer than 1 second ago
-  // iii) The same transmission received by a second Gateway (in this case we can drop the packet): i.e. frame counter up already seen, seen shorter than 1 second ago
+  // iii) The same transmission received by a second Gateway: merged into this uplink during the deduplication window,
+  //      or by MergeLateDuplicate when it arrives after the window, so such copies never get here
   bool firstRX = it->second.m_nUSPackets == 0;
   bool processMACAck = true;
-  NS_LOG_INFO("check if retransmission or duplicate " << frmHdr.getFrameCounter () << " " << it->second.m_fCntUp << " " << firstRX);
-  if (frmHdr.getFrameCounter () <= it->second.m_fCntUp && !firstRX) {
-    NS_LOG_INFO("either retransmission or duplicate");
-
-    Time t = Simulator::Now () - it->second.m_lastSeen;
-    if (t <= Seconds (1.0)) { // assume US packet is really a duplicate received by a second gateway
-      // Duplicate, drop packet
-      it->second.m_nUSDuplicates += 1;
-      NS_LOG_INFO (this << " Duplicate detected: " << frmHdr.getFrameCounter () << " <= " << it->second.m_fCntUp << " &&  t = " << t << " < 1 second => dropping packet");
-      // TODO: add trace for dropping duplicate packets?
-
-      //this is a duplicate (arrived through multiple gateways), modify the original's SNR and GtwDiversity
-      //loop through vector (newest are at the start, so search should be quick)
-      //TODO: add a bool to define if ADR algorithm is in use
-      for (auto & row : it->second.m_frameSNRHistory) {
-        if (row.frameCounter == frmHdr.getFrameCounter ()) {
-          row.gtwDiversity++;
-
-          LoRaWANPhyParamsTag phyParamsTag;
-          if (packet->PeekPacketTag (phyParamsTag)) {
-            if (row.snrMax < phyParamsTag.GetSinrAvg ()) {
-              row.snrMax = phyParamsTag.GetSinrAvg ();
-              NS_LOG_INFO("Modifying current row, the sinr was:" << phyParamsTag.GetSinrAvg ());
-            }
-          } else {
-            NS_LOG_INFO("LoRaWANPhyParamsTag not found on packet");
-            NS_LOG_WARN (this << " LoRaWANPhyParamsTag not found on packet.");
-          }
-          break;
-        }
-      }
-      //TODO: what happens in the case of a retransmission?
-
-      return;
-    } else { // assume US packet is a retransmission
-      NS_LOG_INFO("it's a retransmission " << frmHdr.getFrameCounter () << " " << it->second.m_fCntUp << " " << firstRX);
-
-      it->second.m_nUSRetransmission += 1;
-      processMACAck = false; // as we have already receive this US packet is a retransmission, we should not process the Ack flag set in the MAC header (but we should still open a RW or reply with an Ack if necessary)
-    }
+  NS_LOG_INFO("check if retransmission " << frmHdr.getFrameCounter () << " " << it->second.m_fCntUp << " " << firstRX);
+  if (frmHdr.getFrameCounter () <= it->second.m_fCntUp && !firstRX) { // assume US packet is a retransmission
+    NS_LOG_INFO("it's a retransmission " << frmHdr.getFrameCounter () << " " << it->second.m_fCntUp << " " << firstRX);
+
+    it->second.m_nUSRetransmission += 1;
+    // count the transmissions of the frame, for the NbTrans selected by ADR
+    if (!it->second.m_frameSNRHistory.empty () && it->second.m_frameSNRHistory.front ().frameCounter == frmHdr.getFrameCounter ()
+        && it->second.m_frameSNRHistory.front ().nTransmissions < 255)
+      it->second.m_frameSNRHistory.front ().nTransmissions++;
+    processMACAck = false; // as we have already receive this US packet is a retransmission, we should not process the Ack flag set in the MAC header (but we should still open a RW or reply with an Ack if necessary)
   } else { // new US frame counter value -> update number of unique packets received and US frame counter
     NS_LOG_INFO("its a new packet");
     it->second.m_nUniqueUSPackets += 1;
@@ -324,10 +523,9 @@ LoRaWANNetworkServer::HandleUSPacket (Ptr<LoRaWANGatewayApplication> lastGW, Add
     if(it->second.m_frameSNRHistory.size() == 20) { //keep a max of 20
         it->second.m_frameSNRHistory.pop_back();
     }
-     LoRaWANPhyParamsTag phyParamsTag;
-    if (packet->PeekPacketTag (phyParamsTag)) {
-      LoRaWANAdrSnrRow newRow = {frmHdr.getFrameCounter(), phyParamsTag.GetSinrAvg (), 1}; //new packet, create a new row 
-      NS_LOG_INFO("Creating a new row, the sinr was:" << phyParamsTag.GetSinrAvg ());
+    if (pending.m_haveSnr) {
+      LoRaWANAdrSnrRow newRow = {frmHdr.getFrameCounter(), pending.m_snrMax, (uint8_t)pending.m_gateways.size (), it->second.m_nbTrans, 1}; //new packet, create a new row
+      NS_LOG_INFO("Creating a new row, the best sinr was:" << pending.m_snrMax << " over " << pending.m_gateways.size () << " gateways");
       it->second.m_frameSNRHistory.insert(it->second.m_frameSNRHistory.begin(), newRow);
     } else {
       NS_LOG_INFO("LoRaWANPhyParamsTag not found on packet");
@@ -335,8 +533,8 @@ LoRaWANNetworkServer::HandleUSPacket (Ptr<LoRaWANGatewayApplication> lastGW, Add
     }
   }
 
-  // Update fields in LoRaWANEndDeviceInfoNS:
-  it->second.m_lastSeen = Simulator::Now ();
+  // Update fields in LoRaWANEndDeviceInfoNS, the receive windows are relative to the reception of the uplink:
+  it->second.m_lastSeen = pending.m_firstSeen;
 
   // Parse PhyRx Packet Tag
   LoRaWANPhyParamsTag phyParamsTag;
@@ -344,10 +542,19 @@ LoRaWANNetworkServer::HandleUSPacket (Ptr<LoRaWANGatewayApplication> lastGW, Add
     it->second.m_lastChannelIndex = phyParamsTag.GetChannelIndex ();
     it->second.m_lastDataRateIndex = phyParamsTag.GetDataRateIndex ();
     it->second.m_lastCodeRate = phyParamsTag.GetCodeRate ();
+
+    // PHYPayload: MHDR | FHDR | FPort | FRMPayload | MIC
+    const uint32_t phyPayloadSize = 1 + frmHdr.GetSerializedSize () + packet->GetSize () + 4;
+    it->second.m_lastPhyPayloadSize = phyPayloadSize;
+    AddChannelLoad (phyParamsTag.GetChannelIndex (),
+                    LoRaWANPhy::CalculateTxTime (phyPayloadSize, phyParamsTag.GetChannelIndex (), phyParamsTag.GetDataRateIndex (), phyParamsTag.GetCodeRate (), 8, true));
   } else {
     NS_LOG_WARN (this << " LoRaWANPhyParamsTag not found on packet.");
   }
 
+  if (processMACAck && m_adrPolicy) // i.e. a new frame
+    m_adrPolicy->NotifyUplink (*this, key, it->second);
+
   // Parse MAC Message Type Packet Tag
   LoRaWANMsgTypeTag msgTypeTag;
   if (packet->RemovePacketTag (msgTypeTag)) {
@@ -368,9 +575,9 @@ LoRaWANNetworkServer::HandleUSPacket (Ptr<LoRaWANGatewayApplication> lastGW, Add
   if (processMACAck && frmHdr.getAck ()) {
     it->second.m_nUSAcks += 1;
 
-    if (!it->second.m_downstreamQueue.empty ()) { // there is a DS message in the queue
-      if (it->second.m_downstreamQueue.front()->m_downstreamMsgType == LORAWAN_CONFIRMED_DATA_DOWN) { // End device confirmed reception of DS packet, so we can remove it:
-        LoRaWANNSDSQueueElement* ptr = it->second.m_downstreamQueue.front();
+    if (!it->second.m_downstreamQueue.IsEmpty ()) { // there is a DS message in the queue
+      if (it->second.m_downstreamQueue.Front ()->m_downstreamMsgType == LORAWAN_CONFIRMED_DATA_DOWN) { // End device confirmed reception of DS packet, so we can remove it:
+        LoRaWANNSDSQueueElement* ptr = it->second.m_downstreamQueue.Front ();
 
         // LOG that network server received an Acknowledgment for a DS packet
         m_dsMsgAckdTrace (key, ptr->m_downstreamTransmissionsRemaining, ptr->m_downstreamMsgType, ptr->m_downstreamPacket);
@@ -379,7 +586,7 @@ LoRaWANNetworkServer::HandleUSPacket (Ptr<LoRaWANGatewayApplication> lastGW, Add
 
         NS_LOG_DEBUG (this << " Received Ack for Confirmed DS packet, removing packet from DS queue for end device " << deviceAddr);
       } else {
-        NS_LOG_ERROR (this << " Upstream frame has Ack bit set, but downstream frame msg type is not Confirmed (msgType = " << it->second.m_downstreamQueue.front()->m_downstreamMsgType << ")");
+        NS_LOG_ERROR (this << " Upstream frame has Ack bit set, but downstream frame msg type is not Confirmed (msgType = " << it->second.m_downstreamQueue.Front ()->m_downstreamMsgType << ")");
       }
     } else {
       // One occurence of this condition is when the NS receives a retransmission that re-acknowledges a previously send DS confirmed packet
@@ -389,7 +596,9 @@ LoRaWANNetworkServer::HandleUSPacket (Ptr<LoRaWANGatewayApplication> lastGW, Add
     }
   }
 
-  //TODO: parse AdrAckReq flag, Class B flag, ADR flag, m_macCommandsED data structure for included MAC commands.
+  it->second.m_classB = frmHdr.getClassB ();
+
+  //TODO: parse AdrAckReq flag, ADR flag, m_macCommandsED data structure for included MAC commands.
   if (frmHdr.getAdrAckReq ()) {
     //device is asking for a dl packet to be sent.
     //this is functionally the same as having a confirmed packet, so we can handle it the same way
@@ -399,16 +608,24 @@ LoRaWANNetworkServer::HandleUSPacket (Ptr<LoRaWANGatewayApplication> lastGW, Add
 
 
   //parse MAC commands
+  LoRaWANEndDeviceInfoNS& info = it->second;
   for(std::vector<LoRaWANMacCommandUplink>::iterator it = frmHdr.m_macCommandsED.begin(); it != frmHdr.m_macCommandsED.end(); ++it) {
     if(it->m_isBeingUsed) {
       //TODO: write functions inside the frame-header to extract the MAC command properly
       // for now, since the ADR command is the only one implemented, we will just check for that one.
       if(it->m_commandID == LinkADRAns) {
           uint8_t status = frmHdr.m_status;
-          //TODO: what to do with this? Indicates if tx, dr, and channel mask were set correctly.
-          //If not, resend?
-          //Just report failures for now
-          //TODO: report failures.
+          //TODO: what to do with the power and data rate acks? If not set, resend?
+          // The end device applies NbTrans together with the channel mask, bit 0 acknowledges both
+          if (info.m_linkAdrReqPending) {
+            if (status & 0x01) {
+              info.m_nbTrans = info.m_pendingNbTrans;
+              info.m_channelMask = info.m_pendingChannelMask;
+            } else {
+              NS_LOG_INFO (this << " LinkADRAns of " << deviceAddr << " rejected channel mask " << info.m_pendingChannelMask);
+            }
+            info.m_linkAdrReqPending = false;
+          }
       } else {
         //TODO: report unexpected behaviour
       }
@@ -423,7 +640,8 @@ LoRaWANNetworkServer::HandleUSPacket (Ptr<LoRaWANGatewayApplication> lastGW, Add
   if (it->second.m_rw1Timer.IsRunning()) {
     NS_LOG_ERROR (this << " Scheduling RW1 timer while RW1 timer was already scheduled for " << it->second.m_rw1Timer.GetTs ());
   }
-  Time receiveDelay = MicroSeconds (RECEIVE_DELAY1);
+  Time receiveDelay = (pending.m_firstSeen + MicroSeconds (RECEIVE_DELAY1)) - Simulator::Now ();
+  NS_ASSERT (receiveDelay > 0);
   it->second.m_rw1Timer = Simulator::Schedule (receiveDelay, &LoRaWANNetworkServer::RW1TimerExpired, this, key);
 }
 
@@ -433,7 +651,19 @@ LoRaWANNetworkServer::HaveSomethingToSendToEndDevice (uint32_t deviceAddr)
   uint32_t key = deviceAddr;
   auto it_ed = m_endDevices.find (key);
 
-  return it_ed->second.m_downstreamQueue.size() > 0 || it_ed->second.m_setAck;
+  return it_ed->second.m_downstreamQueue.GetSize () > 0 || it_ed->second.m_setAck;
+}
+
+uint32_t
+LoRaWANNetworkServer::EstimateDSPhyPayloadSize (const LoRaWANEndDeviceInfoNS& info) const
+{
+  // MHDR (1B), FHDR without FOpts (7B), FPort (1B) and MIC (4B)
+  uint32_t size = 13;
+  if (info.m_setAdr)
+    size += 5; // LinkADRReq in FOpts
+  if (!info.m_downstreamQueue.IsEmpty ())
+    size += info.m_downstreamQueue.Front ()->m_downstreamPacket->GetSize ();
+  return size;
 }
 
 void
@@ -444,35 +674,44 @@ LoRaWANNetworkServer::RW1TimerExpired (uint32_t deviceAddr)
   uint32_t key = deviceAddr;
   auto it_ed = m_endDevices.find (key);
 
-  // Check whether any GW in lastGWs can send a downstream transmission immediately (i.e. right now) in RW1
-  bool foundGW = false;
-  // The RW1 LoRa channel and data rate are the same as used in the last US transmission
-  const uint8_t dsChannelIndex = it_ed->second.m_lastChannelIndex;
-  const uint8_t dsDataRateIndex = it_ed->second.m_lastDataRateIndex;;
-  for (auto it_gw = it_ed->second.m_lastGWs.cbegin(); it_gw != it_ed->second.m_lastGWs.cend(); it_gw++) {
-    if ((*it_gw)->CanSendImmediatelyOnChannel (dsChannelIndex, dsDataRateIndex)) {
-      foundGW = true;
-      this->SendDSPacket (deviceAddr, *it_gw, true, false);
-      break;
-    }
+  // With no queued frame, no pending ack and no pending LinkADRReq, SendDSPacket would abort in RW1 and RW2 alike.
+  // RW2 only serves as the fallback for a frame that missed RW1, so neither an RW2 timer nor an RW2 gateway reservation
+  // is needed: a frame queued by DSTimerExpired after this point goes out in the receive windows of the next uplink.
+  const bool haveSomethingToSend = HaveSomethingToSendToEndDevice (deviceAddr) || it_ed->second.m_setAdr;
+  if (!haveSomethingToSend)
+    return;
+
+  // Let the downlink scheduler pick a gateway out of lastGWs (best uplink SNR first) that can send right now in RW1
+  // The RW1 LoRa channel and data rate are a function of the last US transmission (the same channel in EU868)
+  const uint8_t dsChannelIndex = LoRaWAN::GetRX1ChannelIndex (it_ed->second.m_lastChannelIndex);
+  const uint8_t dsDataRateIndex = LoRaWAN::GetRX1DataRateIndex (it_ed->second.m_lastDataRateIndex, it_ed->second.m_rx1DROffset);
+  const uint32_t phyPayloadSize = EstimateDSPhyPayloadSize (it_ed->second);
+  Ptr<LoRaWANGatewayApplication> gateway = m_downlinkScheduler->SelectGateway (it_ed->second.m_lastGWs, dsChannelIndex, dsDataRateIndex, Simulator::Now (), phyPayloadSize);
+  if (gateway) {
+    this->SendDSPacket (deviceAddr, gateway, true, false);
+    return;
   }
 
-  if (!foundGW) {
-    NS_LOG_DEBUG (this << " No gateway available for transmission in RW1, scheduling timer for DS transmission in RW2");
+  NS_LOG_DEBUG (this << " No gateway available for transmission in RW1, scheduling timer for DS transmission in RW2");
 
-    // Increment m_nrRW1Missed only if there is something to send:
-    if (HaveSomethingToSendToEndDevice (deviceAddr)) {
-      m_nrRW1Missed++;
-    }
+  // Increment m_nrRW1Missed only if there is something to send:
+  if (HaveSomethingToSendToEndDevice (deviceAddr)) {
+    m_nrRW1Missed++;
+  }
 
-    if (it_ed->second.m_rw2Timer.IsRunning()) {
-      NS_LOG_ERROR (this << " Scheduling RW2 timer while RW2 timer was already scheduled for " << it_ed->second.m_rw2Timer.GetTs ());
-    }
+  if (it_ed->second.m_rw2Timer.IsRunning()) {
+    NS_LOG_ERROR (this << " Scheduling RW2 timer while RW2 timer was already scheduled for " << it_ed->second.m_rw2Timer.GetTs ());
+  }
 
-    // Time receiveDelay = MicroSeconds (RECEIVE_DELAY2);
-    Time receiveDelay = (it_ed->second.m_lastSeen + MicroSeconds (RECEIVE_DELAY2)) - Simulator::Now ();
-    NS_ASSERT (receiveDelay > 0);
-    it_ed->second.m_rw2Timer = Simulator::Schedule (receiveDelay, &LoRaWANNetworkServer::RW2TimerExpired, this, key);
+  // Time receiveDelay = MicroSeconds (RECEIVE_DELAY2);
+  Time receiveDelay = (it_ed->second.m_lastSeen + MicroSeconds (RECEIVE_DELAY2)) - Simulator::Now ();
+  NS_ASSERT (receiveDelay > 0);
+  it_ed->second.m_rw2Timer = Simulator::Schedule (receiveDelay, &LoRaWANNetworkServer::RW2TimerExpired, this, key);
+
+  // Reserve a gateway for RW2 now, so that RW1 downlinks to other end devices do not take it in the meantime
+  it_ed->second.m_rw2GW = m_downlinkScheduler->SelectGateway (it_ed->second.m_lastGWs, LoRaWAN::m_RW2ChannelIndex, LoRaWAN::m_RW2DataRateIndex, Simulator::Now () + receiveDelay, phyPayloadSize);
+  if (it_ed->second.m_rw2GW) {
+    m_downlinkScheduler->Reserve (it_ed->second.m_rw2GW, LoRaWAN::m_RW2ChannelIndex, LoRaWAN::m_RW2DataRateIndex, Simulator::Now () + receiveDelay, phyPayloadSize);
   }
 }
 
@@ -484,20 +723,35 @@ LoRaWANNetworkServer::RW2TimerExpired (uint32_t deviceAddr)
   uint32_t key = deviceAddr;
   auto it_ed = m_endDevices.find (key);
 
-  // Check whether any GW in lastGWs can send a downstream transmission immediately (i.e. right now) in RW2
   // The RW2 LoRa channel is a fixed channel depending on the region, for EU this is the high power 869.525 MHz channel
   const uint8_t dsChannelIndex = LoRaWAN::m_RW2ChannelIndex;
   const uint8_t dsDataRateIndex = LoRaWAN::m_RW2DataRateIndex;
-  bool foundGW = false;
-  for (auto it_gw = it_ed->second.m_lastGWs.cbegin(); it_gw != it_ed->second.m_lastGWs.cend(); it_gw++) {
-    if ((*it_gw)->CanSendImmediatelyOnChannel (dsChannelIndex, dsDataRateIndex)) {
-      foundGW = true;
-      this->SendDSPacket (deviceAddr, *it_gw, false, true);
-      break;
-    }
+
+  // Try the gateway reserved for RW2 first, then the other gateways in lastGWs.
+  // The reservation is released, SendDSPacket records the actual downlink.
+  std::vector< Ptr<LoRaWANGatewayApplication> > gateways;
+  Ptr<LoRaWANGatewayApplication> reservedGW = it_ed->second.m_rw2GW;
+  it_ed->second.m_rw2GW = nullptr;
+  if (reservedGW) {
+    m_downlinkScheduler->Release (reservedGW, Simulator::Now ());
+    gateways.push_back (reservedGW);
+  }
+  for (const auto& gw : it_ed->second.m_lastGWs) {
+    if (gw != reservedGW)
+      gateways.push_back (gw);
+  }
+
+  if (!HaveSomethingToSendToEndDevice (deviceAddr) && !it_ed->second.m_setAdr)
+    return;
+
+  Ptr<LoRaWANGatewayApplication> gateway = m_downlinkScheduler->SelectGateway (gateways, dsChannelIndex, dsDataRateIndex, Simulator::Now (), EstimateDSPhyPayloadSize (it_ed->second));
+  if (reservedGW && gateway != reservedGW) {
+    m_downlinkScheduler->NotifyReservationBroken ();
   }
 
-  if (!foundGW) {
+  if (gateway) {
+    this->SendDSPacket (deviceAddr, gateway, false, true);
+  } else {
     // Increment m_nrRW2Missed only if there is something to send:
     if (HaveSomethingToSendToEndDevice (deviceAddr)) {
       m_nrRW2Missed++;
@@ -542,8 +796,8 @@ LoRaWANNetworkServer::SendDSPacket (uint32_t deviceAddr, Ptr<LoRaWANGatewayAppli
   // Figure out which DS packet to send
   LoRaWANNSDSQueueElement elementToSend;
   bool deleteQueueElement = false;
-  if (it->second.m_downstreamQueue.size() > 0) {
-    LoRaWANNSDSQueueElement* element = it->second.m_downstreamQueue.front ();
+  if (it->second.m_downstreamQueue.GetSize () > 0) {
+    LoRaWANNSDSQueueElement* element = it->second.m_downstreamQueue.Front ();
 
     // Bookkeeping for Confirmed packets:
     if (element->m_downstreamMsgType == LORAWAN_CONFIRMED_DATA_DOWN) {
@@ -600,8 +854,8 @@ LoRaWANNetworkServer::SendDSPacket (uint32_t deviceAddr, Ptr<LoRaWANGatewayAppli
       }
   }
 
-  // LOG DS msg transmission
-  uint8_t rwNumber = RW1 ? 1 : 2;
+  // LOG DS msg transmission, rwNumber 0 is a class B ping slot
+  uint8_t rwNumber = RW1 ? 1 : (RW2 ? 2 : 0);
   m_dsMsgTransmittedTrace (deviceAddr, elementToSend.m_downstreamTransmissionsRemaining, elementToSend.m_downstreamMsgType, elementToSend.m_downstreamPacket, rwNumber);
 
   // Make a copy here, this is u
@@ -638,7 +892,8 @@ LoRaWANNetworkServer::SendDSPacket (uint32_t deviceAddr, Ptr<LoRaWANGatewayAppli
     LoRaWANADRAlgoritmResult adrRes = AdaptiveDataRate(deviceAddr); //generates the dataRate, txPower, channelMask, chMaskCtrl, and nbTrans that the device should use. 
     if(adrRes.status) {
 
-      if(adrRes.dr == it->second.m_lastDataRateIndex && adrRes.txPower == it->second.m_lastTxPowerIndex) 
+      if(adrRes.dr == it->second.m_lastDataRateIndex && adrRes.txPower == it->second.m_lastTxPowerIndex
+         && adrRes.channelMask == it->second.m_channelMask && adrRes.nbTrans == it->second.m_nbTrans) 
       {
           NS_LOG_INFO ("No change: ADR algorithm (NS side) for device " << deviceAddr << " ran successfully at time " << Simulator::Now ().GetSeconds () << " but no change was required" ); 
       }
@@ -646,8 +901,13 @@ LoRaWANNetworkServer::SendDSPacket (uint32_t deviceAddr, Ptr<LoRaWANGatewayAppli
       {
           NS_LOG_INFO ("ADR algorithm (NS side) for device " << deviceAddr << " ran successfully at time " << Simulator::Now ().GetSeconds () <<
         ", old dr= " << it->second.m_lastDataRateIndex <<   
-        ", new dr= " << adrRes.dr << " new txPow= " << adrRes.txPower << " channelMask=" << adrRes.channelMask << " chMaskCtrl=" << adrRes.chMaskCtrl << " nbTrans=" << adrRes.nbTrans);
-        fhdr.AddLoRaADRReq(adrRes.dr, adrRes.txPower, adrRes.channelMask, adrRes.chMaskCtrl, adrRes.nbTrans); 
+        ", new dr= " << (uint16_t)adrRes.dr << " new txPow= " << (uint16_t)adrRes.txPower << " channelMask=" << adrRes.channelMask << " chMaskCtrl=" << (uint16_t)adrRes.chMaskCtrl << " nbTrans=" << (uint16_t)adrRes.nbTrans);
+        if (fhdr.AddLoRaADRReq(adrRes.dr, adrRes.txPower, adrRes.channelMask, adrRes.chMaskCtrl, adrRes.nbTrans)) {
+          it->second.m_lastTxPowerIndex = adrRes.txPower;
+          it->second.m_linkAdrReqPending = true;
+          it->second.m_pendingNbTrans = adrRes.nbTrans;
+          it->second.m_pendingChannelMask = adrRes.channelMask;
+        }
       }       
       it->second.m_setAdr = false;
     } else {
@@ -667,14 +927,14 @@ LoRaWANNetworkServer::SendDSPacket (uint32_t deviceAddr, Ptr<LoRaWANGatewayAppli
   uint8_t dsChannelIndex;
   uint8_t dsDataRateIndex;
   if (RW1) {
-    dsChannelIndex = it->second.m_lastChannelIndex;
+    dsChannelIndex = LoRaWAN::GetRX1ChannelIndex (it->second.m_lastChannelIndex);
     dsDataRateIndex = LoRaWAN::GetRX1DataRateIndex (it->second.m_lastDataRateIndex, it->second.m_rx1DROffset);
   } else if (RW2) {
     dsChannelIndex = LoRaWAN::m_RW2ChannelIndex;
     dsDataRateIndex = LoRaWAN::m_RW2DataRateIndex;
-  } else {
-    NS_FATAL_ERROR (this << " Either RW1 or RW2 should be true");
-    return;
+  } else { // class B ping slot
+    dsChannelIndex = LoRaWAN::m_classBChannelIndex;
+    dsDataRateIndex = LoRaWAN::m_classBDataRateIndex;
   }
 
   LoRaWANPhyParamsTag phyParamsTag;
@@ -696,19 +956,29 @@ LoRaWANNetworkServer::SendDSPacket (uint32_t deviceAddr, Ptr<LoRaWANGatewayAppli
   if (RW1) {
     m_nrRW1Sent++;
     it->second.m_nDSPacketsSentRW1 += 1;
+    it->second.m_lastDSWindow = 1;
   } else if (RW2) {
     it->second.m_nDSPacketsSentRW2 += 1;
     m_nrRW2Sent++;
+    it->second.m_lastDSWindow = 2;
+  } else {
+    it->second.m_nDSPacketsSentPingSlot += 1;
+    m_nrPingSlotSent++;
+    it->second.m_lastDSWindow = 0;
   }
   if (it->second.m_setAck)
     it->second.m_nDSAcks += 1;
+  it->second.m_lastDSAck = it->second.m_setAck;
 
   // Store gatewayPtr as last DS GW:
   it->second.m_lastDSGW = gatewayPtr;
 
+  // Record the downlink in the scheduler, the gateway adds the MAC header (1B) and MIC (4B):
+  m_downlinkScheduler->Reserve (gatewayPtr, dsChannelIndex, dsDataRateIndex, Simulator::Now (), p->GetSize () + 5);
+
   // Ask gateway application on lastseenGW to send the DS packet:
   gatewayPtr->SendDSPacket (p);
-  NS_LOG_INFO (this << " Sent DS Packet to device addr " << deviceAddr << " via GW #" << gatewayPtr->GetNode()->GetId() << " in RW" << (RW1 ? "1" : "2"));
+  NS_LOG_INFO (this << " Sent DS Packet to device addr " << deviceAddr << " via GW #" << gatewayPtr->GetNode()->GetId() << " in " << (RW1 ? "RW1" : (RW2 ? "RW2" : "ping slot")));
 
   // Reset data structures
   it->second.m_setAck = false; // we only sent an Ack once, see Note on page 75 of LoRaWAN std
@@ -717,6 +987,10 @@ LoRaWANNetworkServer::SendDSPacket (uint32_t deviceAddr, Ptr<LoRaWANGatewayAppli
   if (deleteQueueElement) {
     this->DeleteFirstDSQueueElement (deviceAddr);
   }
+
+  // Send the rest of the queue to a class B end device in its next ping slots
+  if (!it->second.m_downstreamQueue.IsEmpty ())
+    this->SchedulePingSlot (deviceAddr);
 }
 
 void
@@ -731,7 +1005,7 @@ LoRaWANNetworkServer::DSTimerExpired (uint32_t deviceAddr)
   }
 
   // Generate a Downstream packet
-  if (it->second.m_downstreamQueue.size () > 0)
+  if (it->second.m_downstreamQueue.GetSize () > 0)
     NS_LOG_INFO(this << " DS queue for end device " << Ipv4Address(deviceAddr) << " is not empty");
 
   NS_ASSERT (m_pktSize >= 8 + 1 + 4); // should be able to send at least frame header, MAC header and MAC MIC
@@ -760,7 +1034,7 @@ LoRaWANNetworkServer::DSTimerExpired (uint32_t deviceAddr)
       packet = Create<Packet> (frmPayloadSize);
     }
 
-    LoRaWANNSDSQueueElement* element = new LoRaWANNSDSQueueElement ();
+    LoRaWANNSDSQueueElement* element = it->second.m_downstreamQueue.Emplace ();
     element->m_downstreamPacket = packet;
     element->m_downstreamFramePort = 1;
     if (m_confirmedData) {
@@ -771,11 +1045,12 @@ LoRaWANNetworkServer::DSTimerExpired (uint32_t deviceAddr)
       element->m_downstreamTransmissionsRemaining = 1;
     }
     element->m_isRetransmission = false;
-    it->second.m_downstreamQueue.push_back (element);
     it->second.m_nDSPacketsGenerated += 1;
 
     m_dsMsgGeneratedTrace (deviceAddr, element->m_downstreamTransmissionsRemaining, element->m_downstreamMsgType, element->m_downstreamPacket);
-    NS_LOG_DEBUG (this << " Added downstream packet with size " << m_pktSize  << " to DS queue for end device " << Ipv4Address(deviceAddr) << ". queue size = " << it->second.m_downstreamQueue.size());
+    NS_LOG_DEBUG (this << " Added downstream packet with size " << m_pktSize  << " to DS queue for end device " << Ipv4Address(deviceAddr) << ". queue size = " << it->second.m_downstreamQueue.GetSize ());
+
+    this->SchedulePingSlot (deviceAddr);
   }
 
   // Reschedule timer:
@@ -793,9 +1068,132 @@ LoRaWANNetworkServer::DeleteFirstDSQueueElement (uint32_t deviceAddr)
     return;
   }
 
-  LoRaWANNSDSQueueElement* ptr = it->second.m_downstreamQueue.front ();
-  delete ptr;
-  it->second.m_downstreamQueue.pop_front ();
+  it->second.m_downstreamQueue.PopFront ();
+}
+
+void
+LoRaWANNetworkServer::SchedulePingSlot (uint32_t deviceAddr)
+{
+  NS_LOG_FUNCTION (this << deviceAddr);
+
+  auto it = m_endDevices.find (deviceAddr);
+  if (it == m_endDevices.end ())
+    return;
+  LoRaWANEndDeviceInfoNS& info = it->second;
+
+  if (!info.m_classB || !info.m_mac || info.m_pingSlotTimer.IsRunning () || info.m_lastGWs.empty ())
+    return;
+  if (info.m_downstreamQueue.IsEmpty ())
+    return;
+  // A confirmed downlink that was sent already waits for the Ack in the next uplink, it is retransmitted in RW1/RW2 as before
+  if (info.m_downstreamQueue.Front ()->m_isRetransmission)
+    return;
+
+  // Try the next ping slots until a gateway that received the last uplink is free
+  const uint8_t dsChannelIndex = LoRaWAN::m_classBChannelIndex;
+  const uint8_t dsDataRateIndex = LoRaWAN::m_classBDataRateIndex;
+  const uint32_t phyPayloadSize = EstimateDSPhyPayloadSize (info);
+  const uint32_t maxPingSlotsTried = 16;
+  Time slot = Simulator::Now ();
+  for (uint32_t i = 0; i < maxPingSlotsTried; i++) {
+    slot = LoRaWAN::GetNextPingSlot (slot, deviceAddr, m_pingSlotPeriodicity);
+    Ptr<LoRaWANGatewayApplication> gateway = m_downlinkScheduler->SelectGateway (info.m_lastGWs, dsChannelIndex, dsDataRateIndex, slot, phyPayloadSize);
+    if (gateway) {
+      m_downlinkScheduler->Reserve (gateway, dsChannelIndex, dsDataRateIndex, slot, phyPayloadSize);
+      info.m_pingSlotGW = gateway;
+      info.m_pingSlotStart = slot;
+
+      // Wake the end device up for this ping slot only
+      info.m_mac->SchedulePingSlot (slot, dsChannelIndex, dsDataRateIndex);
+      info.m_pingSlotTimer = Simulator::Schedule (slot - Simulator::Now (), &LoRaWANNetworkServer::PingSlotTimerExpired, this, deviceAddr);
+      NS_LOG_DEBUG (this << " Scheduled DS transmission to " << Ipv4Address (deviceAddr) << " in ping slot at " << slot.GetSeconds () << "s via GW #" << gateway->GetNode ()->GetId ());
+      return;
+    }
+    slot += MicroSeconds (PING_SLOT_LENGTH);
+  }
+
+  m_nrPingSlotMissed++;
+  NS_LOG_INFO (this << " No gateway available in the next " << maxPingSlotsTried << " ping slots of device addr " << deviceAddr);
+}
+
+void
+LoRaWANNetworkServer::PingSlotTimerExpired (uint32_t deviceAddr)
+{
+  NS_LOG_FUNCTION (this << deviceAddr);
+
+  auto it = m_endDevices.find (deviceAddr);
+  if (it == m_endDevices.end ())
+    return;
+  LoRaWANEndDeviceInfoNS& info = it->second;
+
+  // The reservation is released, SendDSPacket records the actual downlink
+  Ptr<LoRaWANGatewayApplication> gateway = info.m_pingSlotGW;
+  info.m_pingSlotGW = nullptr;
+  m_downlinkScheduler->Release (gateway, info.m_pingSlotStart);
+
+  if (info.m_downstreamQueue.IsEmpty ()) // e.g. sent in RW1/RW2 in the meantime
+    return;
+
+  // The end device does not open ping slots between its uplink and RW2
+  if (info.m_rw1Timer.IsRunning () || info.m_rw2Timer.IsRunning ()) {
+    this->SchedulePingSlot (deviceAddr);
+    return;
+  }
+
+  if (!m_downlinkScheduler->CanSend (gateway, LoRaWAN::m_classBChannelIndex, LoRaWAN::m_classBDataRateIndex, Simulator::Now (), EstimateDSPhyPayloadSize (info))) {
+    m_downlinkScheduler->NotifyReservationBroken ();
+    this->SchedulePingSlot (deviceAddr);
+    return;
+  }
+
+  this->SendDSPacket (deviceAddr, gateway, false, false);
+}
+
+void
+LoRaWANNetworkServer::DSPacketNotSent (uint32_t deviceAddr)
+{
+  NS_LOG_FUNCTION (this << deviceAddr);
+
+  auto it = m_endDevices.find (deviceAddr);
+  if (it == m_endDevices.end ())
+    return;
+  LoRaWANEndDeviceInfoNS& info = it->second;
+
+  // The gateway MAC drops the packet when it takes it from its queue, at the time SendDSPacket handed it over,
+  // so the last DS packet of the end device is the dropped one
+  NS_ASSERT (info.m_nDSPacketsSent > 0);
+  info.m_nDSPacketsSent -= 1;
+  if (info.m_lastDSWindow == 1) {
+    info.m_nDSPacketsSentRW1 -= 1;
+    m_nrRW1Sent--;
+    m_nrRW1Missed++;
+  } else if (info.m_lastDSWindow == 2) {
+    info.m_nDSPacketsSentRW2 -= 1;
+    m_nrRW2Sent--;
+    m_nrRW2Missed++;
+  } else {
+    info.m_nDSPacketsSentPingSlot -= 1;
+    m_nrPingSlotSent--;
+    m_nrPingSlotMissed++;
+  }
+  if (info.m_lastDSAck) {
+    NS_ASSERT (info.m_nDSAcks > 0);
+    info.m_nDSAcks -= 1;
+    info.m_lastDSAck = false;
+  }
+  NS_LOG_INFO (this << " DS packet to device addr " << deviceAddr << " was dropped by the gateway, its front-end was transmitting");
+}
+
+Ptr<LoRaWANDownlinkScheduler>
+LoRaWANNetworkServer::GetDownlinkScheduler (void) const
+{
+  return m_downlinkScheduler;
+}
+
+Ptr<LoRaWANAdrPolicy>
+LoRaWANNetworkServer::GetAdrPolicy (void) const
+{
+  return m_adrPolicy;
 }
 
 int64_t
@@ -824,129 +1222,55 @@ LoRaWANNetworkServer::GetConfirmedDataDown (void) const
 LoRaWANADRAlgoritmResult
 LoRaWANNetworkServer::AdaptiveDataRate (uint32_t deviceAddr)
 {
- 
   NS_LOG_INFO ("At time " << Simulator::Now ().GetSeconds () << " running ADR algorithm (NS side) for device " << deviceAddr);
 
-  //the algorithm from Semtech
-  /*
-  Each time a node performs an uplink transmission, the frame may be received by several gateways. Inside each of the gateways, the frame is tagged with its signal 
-  strength (RSSI) and Signal to Noise ratio in dB (SNR). The gateways then forward the tagged frame to the network server.
-
-So for a given frame the server will receive several copies, each coming from a different gateway and tagged with different RSSI and SNR values.
-
-For a given frame, the notation {gatewayID , frame_nb, SNR} represents the SNR measured by gateway ID.
-
-Each frame features a 16 bits frame counter (F) field which is incremented with every transmission.
-
-So for each transmission of a given node (DevAddr) we define the notation SNRmax(devAddr,F) where:
-
-* F is the value of the frame counter of the frame
-
-* DevAddr is the network address of the node as defined in the LoRaWAN spec
-
-* SNRmax is the maximum of the various SNRs reported by the different gateways who received this given frame.
-
-For each node taken into account by the algorithm, the following inputs must be available in memory.
-
-1. The frame counter values of the last 20 received frames Fn, Fn-1 .. , Fn-19
-
-2. The list of the 20 associated SNRmax(DevAddr, Fn to n-19)
-
-3. The number of gateway which received each of the frame (the receive diversity) GtwDiversity(devAddr,Fn to n-19) [not yet used by this algorithm , reserved for future use] 
-
-Each time a new frame with frame counter N+x reaches the server, the SNRmax(Nif,Fn-x) value is computed by analyzing the multiple instances of the frame reported by the different gateways.
-
-The triplet {N+x , SNRmax(devAddr,Fn-x) , GtwDiversity(devAddr,Fn+x)} is inserted at the end table. Each time a new line is inserted at the end of the table, the lines 2 to 19 are 
-shifted up and the first line is discarded so as to keep the length of the table constantly equal to 20. If a frame is retransmitted several time by the end-device (same frame counter) 
-only the best transmission is kept. That means that if a frame with the same frame counter value than the newly received frame already exists in the table (it can only be the last one) 
-then the SNRmax value is updated if the new frame SNRmax value is greater than the one already stored in the table. 
-
-Each time the server decides to send an ADR command to a node, it uses the previously described data structure to perform the following computations.
-
-First the Max (not average) SNR (SNRm) is computed over the middle column of the table. Then we compute:
-
-SNRmargin = SNRm – SNR(DR) - margin_db
-
-* Where margin_db is the installation margin of the network (typically 10dB in most networks), this is a device specific static parameter. This may be part of a device profile.
-
-* Where SNR(DR) is the required SNR to successfully demodulate as a function of Data Rate given in the following table. DR is the data rate of the end-device’s last received frame. 
-  */
-
-  //the ADR algorithm is called on a particular device.
- // Search device in m_endDevices:
   auto it = m_endDevices.find (deviceAddr);
   if (it == m_endDevices.end ()) { // end device not found
     NS_LOG_ERROR (this << " Could not find device info struct in m_endDevices for dev addr " << deviceAddr << ". Aborting ADR algorithm");
     LoRaWANADRAlgoritmResult adrResFailure = {false, 0, 0, 0, 0, 0};
     return adrResFailure;
   }
-  //this function is called when the server decides to send an ADR command to a node.
 
-  if(it->second.m_lastDataRateIndex == 5 && it->second.m_lastTxPowerIndex == 7) 
-  {
-      NS_LOG_INFO("Running ADR, for device " << deviceAddr << " but device already uses the fastest DR and lowest TX power");
-      LoRaWANADRAlgoritmResult adrRes = {true, it->second.m_lastDataRateIndex, it->second.m_lastTxPowerIndex, 0, 0, 0}; //TODO: ChannelMask, chMaskCtrl, and NbTrans are not currently implemented.
-      return adrRes;   
+  if (!m_adrPolicy) { // ADR disabled
+    NS_LOG_INFO (this << " No ADR policy set, not running ADR for dev addr " << deviceAddr);
+    LoRaWANADRAlgoritmResult adrResFailure = {false, 0, 0, 0, 0, 0};
+    return adrResFailure;
   }
 
-  //calculate SNRm - the max SNR over the table
-  double snrM = -128.0;
-  for (auto & row : it->second.m_frameSNRHistory) {
-    if(row.snrMax > snrM) {
-      snrM = row.snrMax;
-    }
+  return m_adrPolicy->Run (*this, deviceAddr, it->second);
+}
 
-    if(row.snrMax == 0.0) {
-      NS_LOG_ERROR(this << "snrMax was zero exactly.");
-    }
-  }
-  
-  //compute SNRmargin = SNRm - SNR(DR) - margin_db
-  //margin_db is the installation margin of the network, and is a device specific static parameter (typically 10dB but tunable. 5dB is default - lower margin_db uses higher data rates generally, so less reliability but more energy efficiency)
-  //SNR(DR) is as follows:
-  /*
-  Data Rate   | Required SNR
-  DR0         |   -20
-  DR1         |   -17.5
-  DR2         |   -15
-  DR3         |   -12.5
-  DR4         |   -10
-  DR5         |   -7.5
-  */ 
-  double snrDr;
+double
+LoRaWANNetworkServer::GetADRRequiredSNR (uint8_t dataRateIndex) const
+{
+  // the requirements are listed per EU868 data rate, i.e. from SF12 down to SF7
+  const uint8_t index = LORAWAN_SF12 - LoRaWAN::m_supportedDataRates[dataRateIndex].spreadingFactor;
   if(m_snrCutoffValuesSource) {
-      snrDr = m_adrSnrRequirementsSemtech[it->second.m_lastDataRateIndex].snr;
+      return m_adrSnrRequirementsSemtech[index].snr;
   } else {
-      snrDr = m_adrSnrRequirementsVDA[it->second.m_lastDataRateIndex].snr;
+      return m_adrSnrRequirementsVDA[index].snr;
   }
+}
 
-  double SNRmargin = snrM - snrDr - it->second.m_marginDb;
-  
-  int nStep = int(SNRmargin/3);
-  
-
-  uint8_t dr = it->second.m_lastDataRateIndex;
-  uint8_t tx = it->second.m_lastTxPowerIndex; //The device is to presume the power level is 0 (max) unless it changes it. (This will go out of sync sometimes between ns and ed). 
-
-  NS_LOG_INFO ("ADR Info: snrM: " << snrM << " snrDr: " << snrDr << " SNRmargin " << SNRmargin << " nStep " << nStep << " dr " << dr << " tx " << tx);
-
-  //then run this algorithm:
-  //this algorithm is based on Things Network implementation. only EU868 band for now.
+void
+LoRaWANNetworkServer::ApplyADRSteps (int nStep, uint8_t& dataRateIndex, uint8_t& txPowerIndex)
+{
+  //this algorithm is based on Things Network implementation. The highest data rate depends on the region.
   while (nStep!=0) {
     if (nStep > 0) {
-      if(dr < 5) {
-        dr += 1; //dr index
+      if(dataRateIndex < LoRaWAN::m_maxUplinkDataRateIndex) {
+        dataRateIndex += 1; //dr index
       } else {
-        if (tx == 7) { //i.e if tx power is the min already
+        if (txPowerIndex == 7) { //i.e if tx power is the min already
           break;
         }
-        tx += 1; //i.e. drop tx power by 2dB
+        txPowerIndex += 1; //i.e. drop tx power by 2dB
       }
       nStep -= 1;
 
     } else {
-      if (tx > 0) { //i.e. tx power is less than max
-        tx -= 1; //i.e. increase tx power by 2dB
+      if (txPowerIndex > 0) { //i.e. tx power is less than max
+        txPowerIndex -= 1; //i.e. increase tx power by 2dB
         nStep += 1;
       } else {
         //tx power is already the max
@@ -954,24 +1278,125 @@ SNRmargin = SNRm – SNR(DR) - margin_db
       }
     }
   }
+}
 
-  LoRaWANADRAlgoritmResult adrRes;
-  if(dr == it->second.m_lastDataRateIndex && tx == it->second.m_lastTxPowerIndex) {
-    //no change required
-    NS_LOG_INFO("ADR ran, no change required");
-    adrRes = {true, dr, tx, 0, 0, 0}; //TODO: ChannelMask, chMaskCtrl, and NbTrans are not currently implemented.    
+double
+LoRaWANNetworkServer::GetFrameLossRate (const std::vector<LoRaWANAdrSnrRow>& history)
+{
+  if (history.size () < 2)
+    return 0.0;
+
+  // frame counters are 16 bit on air, the newest frame is at the front
+  const uint32_t expected = static_cast<uint16_t> (history.front ().frameCounter - history.back ().frameCounter) + 1;
+  if (expected <= history.size ())
+    return 0.0;
+  return double (expected - history.size ()) / expected;
+}
+
+uint8_t
+LoRaWANNetworkServer::ComputeNbTrans (const LoRaWANEndDeviceInfoNS& info) const
+{
+  const uint8_t current = std::min (info.m_nbTrans, m_adrMaxNbTrans);
+  if (info.m_frameSNRHistory.size () < 2)
+    return current;
+
+  // The loss of a single transmission: every frame in the history was sent
+  // NbTrans times, frames missing from the history lost all of their transmissions
+  uint32_t sent = 0;
+  uint32_t received = 0;
+  for (auto & row : info.m_frameSNRHistory) {
+    const uint8_t nbTrans = std::max<uint8_t> (row.nbTrans, 1);
+    sent += nbTrans;
+    received += std::min (row.nTransmissions, nbTrans);
   }
-  else
-  {
-    it->second.m_lastTxPowerIndex = tx; //the tx power index is maintained on this side, the new dr will be saved after the next uplink is received.
-    NS_LOG_INFO ("ADR Info: new dr " << dr << " new tx " << tx);
-    adrRes = {true, dr, tx, 0, 0, 0}; //TODO: ChannelMask, chMaskCtrl, and NbTrans are not currently implemented.  
+  const uint32_t expected = static_cast<uint16_t> (info.m_frameSNRHistory.front ().frameCounter - info.m_frameSNRHistory.back ().frameCounter) + 1;
+  if (expected > info.m_frameSNRHistory.size ())
+    sent += (expected - info.m_frameSNRHistory.size ()) * info.m_nbTrans;
+  // smoothed, so that a history without losses does not pass for a perfect link
+  const double txLoss = (sent - received + 0.5) / (sent + 1);
+
+  uint8_t required = 1;
+  while (required < m_adrMaxNbTrans && std::pow (txLoss, required) > m_adrTargetFrameLoss)
+    required++;
+
+  NS_LOG_INFO ("ADR Info: tx loss " << txLoss << " over " << sent << " transmissions, nbTrans " << (uint16_t)current << " required " << (uint16_t)required);
+  // lower NbTrans one step at a time
+  if (required < current)
+    return current - 1;
+  return required;
+}
+
+uint16_t
+LoRaWANNetworkServer::ComputeChannelMask (const LoRaWANEndDeviceInfoNS& info) const
+{
+  const uint16_t defaultMask = LoRaWAN::GetDefaultUplinkChannelMask ();
+  if (!m_adrChannelMask)
+    return defaultMask;
+
+  const uint8_t nUplinkChannels = LoRaWAN::m_nUplinkChannels;
+  double meanLoad = 0.0;
+  for (uint8_t i = 0; i < nUplinkChannels; i++)
+    meanLoad += GetChannelLoad (i);
+  meanLoad /= nUplinkChannels;
+  if (meanLoad <= 0.0)
+    return defaultMask;
+
+  // the decayed airtime of a channel that is occupied a fraction u of the time approaches u * ChannelLoadWindow
+  const double minLoad = m_adrChannelMinLoad * m_channelLoadWindow.GetSeconds ();
+  const double congestedLoad = std::max ((1.0 + m_adrChannelLoadMargin) * meanLoad, minLoad);
+  const uint32_t address = info.m_deviceAddress.Get ();
+  uint16_t channelMask = 0;
+  for (uint8_t i = 0; i < nUplinkChannels; i++) {
+    const double load = GetChannelLoad (i);
+    bool enabled;
+    if (info.m_channelMask & (1 << i)) {
+      // Move only the share of the devices on a congested channel that brings its load down to congestedLoad, the same
+      // devices for as long as the channel stays congested. Moving all of them would just congest the other channels.
+      const double excess = load > congestedLoad ? (load - congestedLoad) / load : 0.0;
+      enabled = GetDeviceChannelShare (address, i) >= excess;
+    } else {
+      // Devices move back once the channel is down to the mean load, the margin in between keeps the masks from oscillating
+      enabled = load <= std::max (meanLoad, minLoad);
+    }
+    if (enabled)
+      channelMask |= (1 << i);
   }
-   
-  return adrRes;
+
+  NS_ASSERT (channelMask != 0); // the least loaded channel is never above the mean
+  return channelMask;
 }
 
+double
+LoRaWANNetworkServer::GetDeviceChannelShare (uint32_t deviceAddr, uint8_t channelIndex)
+{
+  // murmur3 finalizer, spreads consecutive addresses evenly over [0, 1)
+  uint32_t h = deviceAddr ^ (channelIndex * 0x9e3779b9u);
+  h ^= h >> 16;
+  h *= 0x85ebca6bu;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35u;
+  h ^= h >> 16;
+  return h / 4294967296.0;
+}
 
+double
+LoRaWANNetworkServer::GetChannelLoad (uint8_t channelIndex) const
+{
+  NS_ASSERT (channelIndex < m_channelLoad.size ());
+  const double age = (Simulator::Now () - m_channelLoadUpdated).GetSeconds ();
+  return m_channelLoad[channelIndex] * std::exp (-age / m_channelLoadWindow.GetSeconds ());
+}
+
+void
+LoRaWANNetworkServer::AddChannelLoad (uint8_t channelIndex, Time airtime)
+{
+  NS_ASSERT (channelIndex < m_channelLoad.size ());
+  const double decay = std::exp (-(Simulator::Now () - m_channelLoadUpdated).GetSeconds () / m_channelLoadWindow.GetSeconds ());
+  for (auto & load : m_channelLoad)
+    load *= decay;
+  m_channelLoadUpdated = Simulator::Now ();
+  m_channelLoad[channelIndex] += airtime.GetSeconds ();
+}
 
 void
 LoRaWANNetworkServer::PrintFinalDetails ()
@@ -988,6 +1413,8 @@ LoRaWANNetworkServer::PrintFinalDetails ()
 LoRaWANGatewayApplication::LoRaWANGatewayApplication ()
   : m_socket (0),
     m_connected (false),
+    m_sendBeacons (false),
+    m_nBeaconsSent (0),
     m_totalRx (0)
 {
   NS_LOG_FUNCTION (this);
@@ -1000,6 +1427,11 @@ LoRaWANGatewayApplication::GetTypeId (void)
     .SetParent<Application> ()
     .SetGroupName("Applications")
     .AddConstructor<LoRaWANGatewayApplication> ()
+    .AddAttribute ("Beacons",
+                   "Send a class B beacon at the start of every beacon period of 128 s.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&LoRaWANGatewayApplication::m_sendBeacons),
+                   MakeBooleanChecker ())
     .AddTraceSource ("Tx", "A new packet is created and is sent",
                      MakeTraceSourceAccessor (&LoRaWANGatewayApplication::m_txTrace),
                      "ns3::Packet::TracedCallback")
@@ -1029,6 +1461,8 @@ LoRaWANGatewayApplication::DoDispose (void)
   NS_LOG_FUNCTION (this);
 
   m_socket = 0;
+  m_uplinkCallback = MakeNullCallback<void, Ptr<Packet> > ();
+  m_beaconEvent.Cancel ();
   this->m_lorawanNSPtr = nullptr;
   // clear ref count in static member, as to destroy the LoRaWANNetworkServer object.
   // Note we should only destroy the NS object when the simulation is stopped and all gateway applications are destroyed.
@@ -1104,6 +1538,92 @@ void LoRaWANGatewayApplication::SendDSPacket (Ptr<Packet> p)
                 <<  p->GetSize ());
 }
 
+void
+LoRaWANGatewayApplication::DSPacketDropped (Ptr<const Packet> p)
+{
+  NS_LOG_FUNCTION (this << p);
+
+  // Downlinks of an external network server are not counted by the in-process network server
+  if (!m_uplinkCallback.IsNull () || !m_lorawanNSPtr)
+    return;
+
+  Ptr<Packet> packet = p->Copy ();
+  LoRaWANMacHeader macHdr;
+  packet->RemoveHeader (macHdr);
+  if (!macHdr.IsDownstream ()) // beacon
+    return;
+
+  LoRaWANFrameHeaderDownlink frmHdr;
+  frmHdr.setSerializeFramePort (true);
+  packet->RemoveHeader (frmHdr);
+  m_lorawanNSPtr->DSPacketNotSent (frmHdr.getDevAddr ().Get ());
+}
+
+void
+LoRaWANGatewayApplication::SetUplinkCallback (Callback<void, Ptr<Packet> > uplinkCallback)
+{
+  NS_LOG_FUNCTION (this);
+  m_uplinkCallback = uplinkCallback;
+}
+
+uint32_t
+LoRaWANGatewayApplication::GetNBeaconsSent (void) const
+{
+  return m_nBeaconsSent;
+}
+
+void
+LoRaWANGatewayApplication::ScheduleNextBeacon ()
+{
+  NS_LOG_FUNCTION (this);
+
+  // Beacons are sent at the start of every beacon period, i.e. at multiples of 128 s (GPS time in the spec)
+  int64_t next = (Simulator::Now ().GetMicroSeconds () / BEACON_PERIOD + 1) * BEACON_PERIOD;
+  Time beaconTime = MicroSeconds (next);
+
+  // Reserve the gateway for the beacon, so that the network server does not plan downlinks over it
+  const uint32_t beaconPhyPayloadSize = 17;
+  if (m_lorawanNSPtr)
+    m_lorawanNSPtr->GetDownlinkScheduler ()->Reserve (this, LoRaWAN::m_classBChannelIndex, LoRaWAN::m_classBDataRateIndex, beaconTime, beaconPhyPayloadSize);
+
+  m_beaconEvent = Simulator::Schedule (beaconTime - Simulator::Now (), &LoRaWANGatewayApplication::SendBeacon, this);
+}
+
+void
+LoRaWANGatewayApplication::SendBeacon ()
+{
+  NS_LOG_FUNCTION (this);
+
+  if (CanSendImmediatelyOnChannel (LoRaWAN::m_classBChannelIndex, LoRaWAN::m_classBDataRateIndex)) {
+    // Beacon payload: the time of the beacon in seconds, followed by zeroed CRC and gateway specific fields.
+    // The gateway adds the MAC header and MIC, so that the beacon has the size of an EU868 beacon (17 bytes)
+    uint8_t payload[12] = {};
+    uint32_t beaconTime = Simulator::Now ().GetSeconds ();
+    for (uint8_t i = 0; i < 4; i++)
+      payload[i] = (beaconTime >> (8 * i)) & 0xff;
+    Ptr<Packet> p = Create<Packet> (payload, sizeof (payload));
+
+    LoRaWANPhyParamsTag phyParamsTag;
+    phyParamsTag.SetChannelIndex (LoRaWAN::m_classBChannelIndex);
+    phyParamsTag.SetDataRateIndex (LoRaWAN::m_classBDataRateIndex);
+    phyParamsTag.SetCodeRate (1);
+    phyParamsTag.SetSinrAvg (0);
+    phyParamsTag.SetTxPowerIndex (0);
+    p->AddPacketTag (phyParamsTag);
+
+    LoRaWANMsgTypeTag msgTypeTag;
+    msgTypeTag.SetMsgType (LORAWAN_PROPRIETARY);
+    p->AddPacketTag (msgTypeTag);
+
+    SendDSPacket (p);
+    m_nBeaconsSent++;
+  } else {
+    NS_LOG_WARN (this << " Gateway #" << GetNode ()->GetId () << " is unable to send the beacon at " << Simulator::Now ().GetSeconds () << "s");
+  }
+
+  ScheduleNextBeacon ();
+}
+
 // Application Methods
 void LoRaWANGatewayApplication::StartApplication () // Called at time specified by Start
 {
@@ -1123,17 +1643,29 @@ void LoRaWANGatewayApplication::StartApplication () // Called at time specified
       //m_socket->SetAllowBroadcast (true); // TODO: does not work on packet socket?
       m_socket->SetRecvCallback (MakeCallback (&LoRaWANGatewayApplication::HandleRead, this));
 
+      // Count the downlinks dropped by the MACs of the gateway as missed
+      Ptr<LoRaWANNetDevice> netDevice = DynamicCast<LoRaWANNetDevice> (GetNode ()->GetDevice (0));
+      if (netDevice) {
+        std::vector<Ptr<LoRaWANMac> > macs = netDevice->GetMacs ();
+        for (std::vector<Ptr<LoRaWANMac> >::iterator it = macs.begin (); it != macs.end (); ++it)
+          (*it)->TraceConnectWithoutContext ("MacTxDrop", MakeCallback (&LoRaWANGatewayApplication::DSPacketDropped, this));
+      }
     }
 
   // instruct Network Server to populate end devices data structure:
   // NOTE that we call PopulateEndDevices in StartApplication and not in DoInitialize as the attributes for the NetworkServer object have not yet been set at the of DoInitialize()
   this->m_lorawanNSPtr->PopulateEndDevices ();
+
+  if (m_sendBeacons)
+    ScheduleNextBeacon ();
 }
 
 void LoRaWANGatewayApplication::StopApplication () // Called at time specified by Stop
 {
   NS_LOG_FUNCTION (this);
 
+  m_beaconEvent.Cancel ();
+
   if(m_socket != 0)
     {
       m_socket->Close ();
@@ -1166,7 +1698,10 @@ void LoRaWANGatewayApplication::HandleRead (Ptr<Socket> socket)
                        << PacketSocketAddress::ConvertFrom(from).GetPhysicalAddress () 
                        << ", total Rx " << m_totalRx << " bytes");
 
-          this->m_lorawanNSPtr->HandleUSPacket (this, from, packet);
+          if (!m_uplinkCallback.IsNull ())
+            m_uplinkCallback (packet);
+          else
+            this->m_lorawanNSPtr->HandleUSPacket (this, from, packet);
         }
       else
         {
@@ -26,6 +26,7 @@ TODO: try to separate out gateway and network server again
 #include "ns3/address.h"
 #include "ns3/application.h"
 #include "ns3/event-id.h"
+#include "ns3/nstime.h"
 #include "ns3/ptr.h"
 #include "ns3/data-rate.h"
 #include "ns3/traced-callback.h"
@@ -33,9 +34,13 @@ TODO: try to separate out gateway and network server again
 #include "ns3/simple-ref-count.h"
 #include "ns3/random-variable-stream.h"
 #include "lorawan.h"
+#include "lorawan-downlink-scheduler.h"
+#include "lorawan-queue-pool.h"
 
 #include <unordered_map>
 #include <deque>
+#include <utility>
+#include <vector>
 
 #define ADR_FREQUENCY 20 //the amount of uplink packets received from a device before the NS runs the NS-side ADR algorithm  
 
@@ -71,6 +76,7 @@ class Address;
 class RandomVariableStream;
 class Socket;
 class LoRaWANGatewayApplication;
+class LoRaWANAdrPolicy;
 
 typedef struct LoRaWANNSDSQueueElement {
   Ptr<Packet>     m_downstreamPacket;
@@ -78,15 +84,31 @@ typedef struct LoRaWANNSDSQueueElement {
   LoRaWANMsgType  m_downstreamMsgType;
   uint8_t 	  m_downstreamTransmissionsRemaining;
   bool 		  m_isRetransmission;
+  struct LoRaWANNSDSQueueElement* m_next; //!< next element in the downstream queue
 } LoRaWANNSDSQueueElement;
 
 typedef struct LoRaWANAdrSnrRow {
   uint16_t frameCounter;
   double snrMax;
   uint8_t gtwDiversity; //currently not used.
+  uint8_t nbTrans;        //!< NbTrans of the end device when the frame was received
+  uint8_t nTransmissions; //!< number of transmissions of the frame received
 
 } LoRaWANAdrSnrRow;
 
+/**
+ * All gateway copies of one uplink that the NS has received so far, collected
+ * during the deduplication window and merged into one uplink when it ends.
+ */
+typedef struct LoRaWANNSPendingUplink {
+  Ptr<Packet>     m_packet;     //!< copy of the uplink received with the highest SNR
+  Time            m_firstSeen;  //!< reception time of the first copy
+  double          m_snrMax;
+  bool            m_haveSnr;    //!< at least one copy carried a LoRaWANPhyParamsTag
+  std::vector< std::pair<double, Ptr<LoRaWANGatewayApplication> > > m_gateways; //!< receiving gateways with the SNR of their copy
+  EventId         m_timer;      //!< end of the deduplication window
+} LoRaWANNSPendingUplink;
+
 typedef struct
 {
     uint8_t dataRateIndex;
@@ -104,17 +126,20 @@ typedef struct
 } LoRaWANADRAlgoritmResult;
 
 typedef struct LoRaWANEndDeviceInfoNS {
-  LoRaWANEndDeviceInfoNS () : m_deviceAddress(), m_rx1DROffset(0), m_lastDSGW(nullptr), m_lastGWs(), m_frameSNRHistory(), m_marginDb(5), m_setAdr(false), m_lastTxPowerIndex(0), //last 4 added by Joe
-	m_lastDataRateIndex(0), m_lastChannelIndex(0), m_lastCodeRate(0), m_lastSeen(0),
+  LoRaWANEndDeviceInfoNS () : m_deviceAddress(), m_rx1DROffset(0), m_lastDSGW(nullptr), m_lastGWs(), m_rw2GW(nullptr), m_frameSNRHistory(), m_marginDb(5), m_setAdr(false), m_lastTxPowerIndex(0), //last 4 added by Joe
+	m_lastDataRateIndex(0), m_lastChannelIndex(0), m_lastCodeRate(0), m_lastPhyPayloadSize(0), m_lastSeen(0),
 	m_framePending(false),m_setAck(false), m_fCntUp(0), m_fCntDown(0),
 	m_nUSPackets(0), m_nUniqueUSPackets(0), m_nUSRetransmission(0), m_nUSDuplicates(0), m_nUSAcks(0),
-	m_nDSPacketsGenerated(0), m_nDSPacketsSent(0), m_nDSPacketsSentRW1(0), m_nDSPacketsSentRW2(0), m_nDSRetransmission(0), m_nDSAcks(0),
-	m_rw1Timer(), m_rw2Timer(), m_downstreamQueue(),m_downstreamTimer() {}
+	m_nDSPacketsGenerated(0), m_nDSPacketsSent(0), m_nDSPacketsSentRW1(0), m_nDSPacketsSentRW2(0), m_nDSPacketsSentPingSlot(0), m_nDSRetransmission(0), m_nDSAcks(0), m_lastDSWindow(0), m_lastDSAck(false),
+	m_rw1Timer(), m_rw2Timer(), m_downstreamQueue(),m_downstreamTimer(),
+	m_classB(false), m_mac(nullptr), m_pingSlotTimer(), m_pingSlotGW(nullptr), m_pingSlotStart(),
+	m_nbTrans(1), m_channelMask(LoRaWAN::GetDefaultUplinkChannelMask ()), m_linkAdrReqPending(false), m_pendingNbTrans(1), m_pendingChannelMask(LoRaWAN::GetDefaultUplinkChannelMask ()) {}
 
   Ipv4Address     m_deviceAddress;
   uint8_t 	  m_rx1DROffset;
   Ptr<LoRaWANGatewayApplication> m_lastDSGW;
   std::vector< Ptr<LoRaWANGatewayApplication> > m_lastGWs;
+  Ptr<LoRaWANGatewayApplication> m_rw2GW; //!< gateway reserved for RW2 when RW1 was missed
 
   /// ADR-related
   std::vector< LoRaWANAdrSnrRow> m_frameSNRHistory;  
@@ -125,6 +150,7 @@ typedef struct LoRaWANEndDeviceInfoNS {
   uint8_t         m_lastDataRateIndex;
   uint8_t         m_lastChannelIndex;
   uint8_t         m_lastCodeRate;
+  uint8_t         m_lastPhyPayloadSize;
   Time            m_lastSeen;
   bool            m_framePending;
   bool            m_setAck;
@@ -141,16 +167,33 @@ typedef struct LoRaWANEndDeviceInfoNS {
   uint32_t 	  m_nDSPacketsSent;   //!< The total number of sent DS packets
   uint32_t 	  m_nDSPacketsSentRW1;   //!< The number of sent DS packets in RW1
   uint32_t 	  m_nDSPacketsSentRW2;   //!< The number of sent DS packets in RW2
+  uint32_t 	  m_nDSPacketsSentPingSlot;   //!< The number of sent DS packets in class B ping slots
   uint32_t 	  m_nDSRetransmission;   //!< Number of retransmissions sent for of DS packets
   uint32_t        m_nDSAcks;  //!< Number of downstream acks sent
+  uint8_t         m_lastDSWindow;  //!< Window of the last sent DS packet: 1 for RW1, 2 for RW2, 0 for a ping slot
+  bool            m_lastDSAck;  //!< Whether the last sent DS packet carried an ack
 
   EventId	  m_rw1Timer;
   EventId	  m_rw2Timer;
 
-  // Pending downstream traffic
-  std::deque<LoRaWANNSDSQueueElement* > m_downstreamQueue;
+  // Pending downstream traffic, its elements are pooled across all end devices
+  LoRaWANIntrusiveQueue<LoRaWANNSDSQueueElement> m_downstreamQueue;
 
   EventId 	  m_downstreamTimer; // DS traffic generator timer
+
+  /// Class B
+  bool            m_classB;        //!< Class B bit of the last uplink
+  Ptr<LoRaWANMac> m_mac;           //!< MAC of the end device, told when to open a ping slot. Null for end devices without a node
+  EventId         m_pingSlotTimer; //!< start of the ping slot in which the next downlink is sent
+  Ptr<LoRaWANGatewayApplication> m_pingSlotGW; //!< gateway reserved for the ping slot
+  Time            m_pingSlotStart;
+
+  /// NbTrans and channel mask, as acknowledged by the end device in LinkADRAns
+  uint8_t         m_nbTrans;
+  uint16_t        m_channelMask;
+  bool            m_linkAdrReqPending;   //!< a LinkADRReq was sent and no LinkADRAns was received yet
+  uint8_t         m_pendingNbTrans;      //!< NbTrans of the pending LinkADRReq
+  uint16_t        m_pendingChannelMask;  //!< ChMask of the pending LinkADRReq
 } LoRaWANEndDeviceInfoNS;
 
 //class LoRaWANNetworkServer : public SimpleRefCount<LoRaWANNetworkServer>
@@ -158,13 +201,43 @@ class LoRaWANNetworkServer : public Object
 {
 public:
   LoRaWANNetworkServer ();
+  virtual ~LoRaWANNetworkServer ();
 
   static TypeId GetTypeId (void);
   virtual void DoInitialize (void);
   virtual void DoDispose (void);
 
   void PopulateEndDevices (void);
+  /**
+   * \brief Register an end device that is not backed by an ns3::Node
+   *
+   * PopulateEndDevices only finds end devices through ns3::NodeList, end
+   * devices that live outside of it (e.g. LoRaWANCompactEndDeviceFleet) are
+   * registered through this function instead. Known devices are left untouched.
+   *
+   * \param deviceAddr the device address of the end device
+   */
+  void AddEndDevice (Ipv4Address deviceAddr);
+  /**
+   * \brief Size the end device table for a number of end devices
+   *
+   * Avoids rehashing the table while large numbers of end devices are
+   * registered. PopulateEndDevices reserves room for every node by itself.
+   *
+   * \param nEndDevices the total number of end devices expected
+   */
+  void ReserveEndDevices (uint32_t nEndDevices);
   LoRaWANEndDeviceInfoNS InitEndDeviceInfo (Ipv4Address);
+  /**
+   * \brief Look up the NS side state of an end device
+   * \param deviceAddr the device address of the end device
+   * \return pointer to the stored info struct, or nullptr if the device is unknown
+   */
+  LoRaWANEndDeviceInfoNS* GetEndDeviceInfo (uint32_t deviceAddr);
+  /**
+   * \brief The device addresses of all end devices known to the NS
+   */
+  std::vector<uint32_t> GetEndDeviceAddresses (void) const;
 
   static void clearLoRaWANNetworkServerPointer () { LoRaWANNetworkServer::m_ptr = nullptr; }
   static bool haveLoRaWANNetworkServerObject () { return LoRaWANNetworkServer::m_ptr != NULL; }
@@ -173,23 +246,122 @@ public:
   void SetConfirmedDataDown (bool confirmedData);
   bool GetConfirmedDataDown (void) const;
 
+  /**
+   * \brief Receive one gateway copy of an uplink
+   *
+   * Copies are collected per (device address, frame counter) for the
+   * duration of the DeduplicationWindow, after which they are processed once
+   * as a single uplink, see ProcessUSPacket. Copies arriving after the window
+   * only add to the gateway diversity and SNR of the processed uplink.
+   */
   void HandleUSPacket (Ptr<LoRaWANGatewayApplication>, Address from, Ptr<Packet> packet);
   void RW1TimerExpired (uint32_t deviceAddr);
   void RW2TimerExpired (uint32_t deviceAddr);
   void SendDSPacket (uint32_t deviceAddr, Ptr<LoRaWANGatewayApplication> gatewayPtr, bool RW1, bool RW2);
+  /**
+   * \brief Called by a gateway application when its MAC dropped the last DS packet sent to an end device
+   *
+   * The gateway drops a downlink when another of its MACs started transmitting
+   * in the meantime. The packet is counted as a missed RW1, RW2 or ping slot
+   * instead of a sent one, and its ack is not counted as sent.
+   */
+  void DSPacketNotSent (uint32_t deviceAddr);
   bool HaveSomethingToSendToEndDevice (uint32_t deviceAddr);
   void DSTimerExpired (uint32_t deviceAddr);
   void DeleteFirstDSQueueElement (uint32_t deviceAddr);
+  /**
+   * \brief Place the first queued downlink of a class B end device in one of its next ping slots
+   *
+   * Looks for the first ping slot of the end device in which a gateway that
+   * received its last uplink is able to send, reserves that gateway and tells
+   * the end device to open the ping slot. Ping slots are only scheduled while
+   * there is a downlink queued, so idle class B end devices cost no events.
+   * Downlinks that are not placed are sent in RW1/RW2 after the next uplink.
+   */
+  void SchedulePingSlot (uint32_t deviceAddr);
+  void PingSlotTimerExpired (uint32_t deviceAddr);
 
   int64_t AssignStreams (int64_t stream);
 
+  Ptr<LoRaWANDownlinkScheduler> GetDownlinkScheduler (void) const;
+  Ptr<LoRaWANAdrPolicy> GetAdrPolicy (void) const;
+
+  /**
+   * \brief Run the ADR policy for an end device, see LoRaWANAdrPolicy
+   *
+   * Fails when the end device is unknown or no ADR policy is set.
+   */
   LoRaWANADRAlgoritmResult AdaptiveDataRate (uint32_t deviceAddr);
+  /**
+   * \brief The SNR the ADR algorithm requires at a data rate, from the table selected by SnrCutoffValuesSource
+   */
+  double GetADRRequiredSNR (uint8_t dataRateIndex) const;
+  /**
+   * \brief Move data rate and tx power index nStep steps of 3dB, as the ADR algorithm does
+   *
+   * Positive steps first raise the data rate up to the highest uplink data
+   * rate of the region (DR5 in EU868) and then lower the tx power, negative
+   * steps raise the tx power up to the maximum.
+   */
+  static void ApplyADRSteps (int nStep, uint8_t& dataRateIndex, uint8_t& txPowerIndex);
+  /**
+   * \brief The fraction of the frames of an end device that were lost, from the gaps in the frame counters of its SNR history
+   *
+   * The history holds one row per frame received, newest first. A frame is
+   * only lost when all of its NbTrans transmissions are lost.
+   */
+  static double GetFrameLossRate (const std::vector<LoRaWANAdrSnrRow>& history);
+  /**
+   * \brief The NbTrans the ADR algorithm selects for an end device
+   *
+   * The loss rate of a single transmission is estimated from the number of
+   * transmissions of every frame in the SNR history that were received, and
+   * from the frames that were lost altogether. NbTrans is set to the lowest value that
+   * brings the frame loss down to AdrTargetFrameLoss, so that no more airtime
+   * is spent on repetitions than needed. NbTrans is lowered by one step at a
+   * time, and never above AdrMaxNbTrans.
+   */
+  uint8_t ComputeNbTrans (const LoRaWANEndDeviceInfoNS& info) const;
+  /**
+   * \brief The uplink channel mask the ADR algorithm selects for an end device
+   *
+   * A channel is congested when its load is more than AdrChannelLoadMargin
+   * above the mean load of the uplink channels, and it is occupied more than
+   * AdrChannelMinLoad of the time. Only a share of the end devices on a
+   * congested channel, enough to bring its load down to that limit, get the
+   * channel disabled; which end devices is given by GetDeviceChannelShare. A
+   * channel disabled in the current mask of the end device is enabled again
+   * once its load is down to the mean. All uplink channels are enabled when
+   * AdrChannelMask is false.
+   */
+  uint16_t ComputeChannelMask (const LoRaWANEndDeviceInfoNS& info) const;
+  /**
+   * \brief A fixed pseudo-random number in [0, 1) per end device and channel, end devices whose number is below the
+   * share of the load of a congested channel to move off it get the channel disabled
+   */
+  static double GetDeviceChannelShare (uint32_t deviceAddr, uint8_t channelIndex);
+  /**
+   * \brief The uplink airtime received on a channel, in seconds, decaying exponentially with time constant ChannelLoadWindow
+   */
+  double GetChannelLoad (uint8_t channelIndex) const;
+  /**
+   * \brief Account the airtime of an uplink on a channel, called for every uplink the NS processes
+   */
+  void AddChannelLoad (uint8_t channelIndex, Time airtime);
 
   void PrintFinalDetails();
     
 private:
+  void ProcessUSPacket (uint64_t uplinkKey);
+  uint32_t EstimateDSPhyPayloadSize (const LoRaWANEndDeviceInfoNS& info) const;
+  void MergeLateDuplicate (LoRaWANEndDeviceInfoNS& info, Ptr<LoRaWANGatewayApplication> gateway, uint16_t frameCounter, Ptr<Packet> packet);
+
   static Ptr<LoRaWANNetworkServer> m_ptr;
   std::unordered_map <uint32_t, LoRaWANEndDeviceInfoNS> m_endDevices;
+  std::unordered_map <uint64_t, LoRaWANNSPendingUplink> m_pendingUplinks; //!< keyed on device address and frame counter
+  Time m_deduplicationWindow;
+  Ptr<LoRaWANDownlinkScheduler> m_downlinkScheduler;
+  Ptr<LoRaWANAdrPolicy> m_adrPolicy;
   uint16_t m_pktSize;
   bool m_generateDataDown;
   bool m_confirmedData;
@@ -199,6 +371,9 @@ private:
   TracedValue<uint32_t> m_nrRW2Sent; // number of times that a DS packet was sent in RW2 by this NS
   TracedValue<uint32_t> m_nrRW1Missed; // number of times that RW1 was missed for all end devices served by this NS
   TracedValue<uint32_t> m_nrRW2Missed; // number of times that RW2 was missed for all end devices served by this NS
+  TracedValue<uint32_t> m_nrPingSlotSent; // number of times that a DS packet was sent in a class B ping slot by this NS
+  TracedValue<uint32_t> m_nrPingSlotMissed; // number of times that no gateway was available in the next ping slots of a class B end device
+  uint8_t m_pingSlotPeriodicity;
 
   TracedCallback<uint32_t, uint8_t, uint8_t, Ptr<const Packet> > m_dsMsgGeneratedTrace;
   TracedCallback<uint32_t, uint8_t, uint8_t, Ptr<const Packet>, uint8_t > m_dsMsgTransmittedTrace;
@@ -210,6 +385,15 @@ private:
   static const std::vector<LoRaWANAdrSnrDrRequirement> m_adrSnrRequirementsVDA;
 
   bool m_snrCutoffValuesSource; //true for Semtech doc, false for VdA. //TODO: better documentation on this.
+
+  double m_adrTargetFrameLoss;
+  uint8_t m_adrMaxNbTrans;
+  bool m_adrChannelMask;
+  double m_adrChannelLoadMargin;
+  double m_adrChannelMinLoad;
+  Time m_channelLoadWindow;
+  std::vector<double> m_channelLoad; //!< per channel, decayed up to m_channelLoadUpdated
+  Time m_channelLoadUpdated;
 };
 
 class LoRaWANGatewayApplication : public Application
@@ -258,6 +442,24 @@ public:
 
   bool CanSendImmediatelyOnChannel (uint8_t channelIndex, uint8_t dataRateIndex);
   void SendDSPacket (Ptr<Packet> p);
+
+  /**
+   * \brief Called when a MAC of the gateway drops a downlink, see LoRaWANNetworkServer::DSPacketNotSent
+   */
+  void DSPacketDropped (Ptr<const Packet> p);
+
+  /**
+   * \brief Hand received uplinks to a callback instead of the LoRaWANNetworkServer
+   *
+   * Used by LoRaWANPacketForwarder to forward uplinks to an external network
+   * server. A null callback restores the in-process network server.
+   */
+  void SetUplinkCallback (Callback<void, Ptr<Packet> > uplinkCallback);
+
+  /**
+   * \brief The number of class B beacons sent by this gateway
+   */
+  uint32_t GetNBeaconsSent (void) const;
 protected:
   virtual void DoInitialize (void);
   virtual void DoDispose (void);
@@ -273,6 +475,12 @@ private:
    */
   void SendPacket ();
 
+  /**
+   * \brief Schedule the class B beacon at the start of the next beacon period
+   */
+  void ScheduleNextBeacon ();
+  void SendBeacon ();
+
   Ptr<Socket>     m_socket;       //!< Associated socket
   bool            m_connected;    //!< True if connected
   uint32_t        m_pktSize;      //!< Size of packets
@@ -290,6 +498,11 @@ private:
   TracedCallback<Ptr<const Packet> > m_txTrace;
 
   Ptr<LoRaWANNetworkServer> m_lorawanNSPtr; //!< Pointer to LoRaWANNetworkServer singleton
+  Callback<void, Ptr<Packet> > m_uplinkCallback; //!< Replaces the network server when set
+
+  bool            m_sendBeacons;  //!< Send class B beacons
+  EventId         m_beaconEvent;
+  uint32_t        m_nBeaconsSent;
 
 private:
   /**
@@ -0,0 +1,94 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+
+#include "lorawan-gateway-front-end.h"
+#include "lorawan-phy.h"
+
+#include <ns3/log.h>
+
+#include <algorithm>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("LoRaWANGatewayFrontEnd");
+
+LoRaWANGatewayFrontEnd::LoRaWANGatewayFrontEnd ()
+  : m_transmitting (false)
+{
+}
+
+bool
+LoRaWANGatewayFrontEnd::IsTransmitting (void) const
+{
+  return m_transmitting;
+}
+
+void
+LoRaWANGatewayFrontEnd::StartTx (void)
+{
+  NS_LOG_FUNCTION (this << m_receiving.size ());
+  NS_ASSERT_MSG (!m_transmitting, "The front-end of a gateway can only send one frame at a time");
+
+  m_transmitting = true;
+
+  // Forcing a PHY off takes it out of m_receiving through NotifyRx
+  std::vector<LoRaWANPhy *> receiving;
+  receiving.swap (m_receiving);
+  for (std::vector<LoRaWANPhy *>::iterator it = receiving.begin (); it != receiving.end (); ++it)
+    {
+      NS_LOG_LOGIC (this << " aborting the reception of " << *it);
+      (*it)->SetTRXStateRequest (LORAWAN_PHY_FORCE_TRX_OFF);
+      m_forcedOff.push_back (*it);
+    }
+}
+
+void
+LoRaWANGatewayFrontEnd::EndTx (void)
+{
+  NS_LOG_FUNCTION (this << m_forcedOff.size ());
+  NS_ASSERT (m_transmitting);
+
+  m_transmitting = false;
+
+  std::vector<LoRaWANPhy *> forcedOff;
+  forcedOff.swap (m_forcedOff);
+  for (std::vector<LoRaWANPhy *>::iterator it = forcedOff.begin (); it != forcedOff.end (); ++it)
+    {
+      // the PHY that transmitted is switched on by its MAC
+      if ((*it)->GetTRXState () == LORAWAN_PHY_TRX_OFF)
+        (*it)->SetTRXStateRequest (LORAWAN_PHY_RX_ON);
+    }
+}
+
+void
+LoRaWANGatewayFrontEnd::NotifyRx (LoRaWANPhy *phy, bool receiving)
+{
+  if (receiving) {
+    m_receiving.push_back (phy);
+  } else {
+    std::vector<LoRaWANPhy *>::iterator it = std::find (m_receiving.begin (), m_receiving.end (), phy);
+    if (it != m_receiving.end ()) {
+      *it = m_receiving.back ();
+      m_receiving.pop_back ();
+    }
+  }
+}
+
+} // namespace ns3
@@ -0,0 +1,94 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+
+#ifndef LORAWAN_GATEWAY_FRONT_END_H
+#define LORAWAN_GATEWAY_FRONT_END_H
+
+#include <ns3/simple-ref-count.h>
+
+#include <vector>
+
+namespace ns3 {
+
+class LoRaWANPhy;
+
+/**
+ * \ingroup lorawan
+ *
+ * \brief The radio front-end shared by the PHYs of a gateway
+ *
+ * A gateway has a PHY and MAC for every channel and data rate, but only one
+ * half-duplex radio: while one of its MACs transmits, none of its PHYs can
+ * receive. Instead of switching every MAC to MAC_UNAVAILABLE and every PHY
+ * off for each downlink, the LoRaWANNetDevice flips the state of the shared
+ * front-end, which the PHYs consult when a transmission arrives:
+ *
+ * - a PHY that is receiving when the transmission starts is forced off, as
+ *   before, so the reception is dropped as aborted when it ends. It is
+ *   switched back on when the transmission ends;
+ * - a PHY that is not receiving stays in RX_ON, but drops the transmissions
+ *   arriving while the front-end transmits as if it was off;
+ * - a MAC that has a frame to send while the front-end transmits drops it,
+ *   as the receive window of the frame is missed, and the network server
+ *   counts the window as missed.
+ *
+ * The frames received are the same as with the per-MAC switching, only the
+ * MacState and TrxState traces of the MACs and PHYs that do not take part in
+ * the transmission do not show it. The per-MAC switching instead holds such
+ * a downlink until the MAC is idle again, after its receive window.
+ */
+class LoRaWANGatewayFrontEnd : public SimpleRefCount<LoRaWANGatewayFrontEnd>
+{
+public:
+  LoRaWANGatewayFrontEnd ();
+
+  /**
+   * \return true while one of the MACs of the gateway transmits
+   */
+  bool IsTransmitting (void) const;
+
+  /**
+   * \brief Switch the front-end to TX, aborting the receptions in progress
+   */
+  void StartTx (void);
+
+  /**
+   * \brief Switch the front-end back to RX
+   *
+   * The PHYs forced off by StartTx are switched back on.
+   */
+  void EndTx (void);
+
+  /**
+   * \brief Called by a PHY when it starts or stops receiving a frame
+   */
+  void NotifyRx (LoRaWANPhy *phy, bool receiving);
+
+private:
+  bool m_transmitting;
+  /** The PHYs in BUSY_RX */
+  std::vector<LoRaWANPhy *> m_receiving;
+  /** The PHYs forced off by the current transmission */
+  std::vector<LoRaWANPhy *> m_forcedOff;
+};
+
+} // namespace ns3
+
+#endif /* LORAWAN_GATEWAY_FRONT_END_H */
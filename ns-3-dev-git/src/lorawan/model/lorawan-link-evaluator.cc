@@ -0,0 +1,363 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+
+
+#include "lorawan-link-evaluator.h"
+#include "lorawan-phy.h"
+#include "lorawan-spectrum-value-helper.h"
+#include "lorawan-phy-config-registry.h"
+#include <ns3/log.h>
+#include <ns3/uinteger.h>
+#include <ns3/spectrum-value.h>
+#include <ns3/rng-stream.h>
+#include <ns3/rng-seed-manager.h>
+#include <ns3/core-config.h>
+#ifdef HAVE_PTHREAD_H
+#include <ns3/system-thread.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <unistd.h>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("LoRaWANLinkEvaluator");
+
+NS_OBJECT_ENSURE_REGISTERED (LoRaWANLinkEvaluator);
+
+void
+LoRaWANLinkBatch::Add (double distance, uint8_t dataRateIndex, uint8_t codeRate, uint8_t phyPayloadSize, double txPower)
+{
+  m_distance.push_back (distance);
+  m_dataRateIndex.push_back (dataRateIndex);
+  m_codeRate.push_back (codeRate);
+  m_phyPayloadSize.push_back (phyPayloadSize);
+  m_txPower.push_back (txPower);
+}
+
+uint32_t
+LoRaWANLinkBatch::GetN (void) const
+{
+  return m_distance.size ();
+}
+
+void
+LoRaWANLinkBatch::Clear (void)
+{
+  m_distance.clear ();
+  m_dataRateIndex.clear ();
+  m_codeRate.clear ();
+  m_phyPayloadSize.clear ();
+  m_txPower.clear ();
+  m_rxPower.clear ();
+  m_snr.clear ();
+  m_successProbability.clear ();
+  m_nReceived.clear ();
+}
+
+/*
+ * The links [m_begin, m_end) of a batch that one thread draws the packets of
+ */
+typedef struct LoRaWANLinkSimulationJob {
+  LoRaWANLinkBatch* m_batch;
+  uint32_t m_begin;
+  uint32_t m_end;
+  uint32_t m_nPackets;
+  uint32_t m_seed;
+  uint64_t m_stream;
+  uint64_t m_firstSubstream;
+  RngStream::Type m_rngType;
+} LoRaWANLinkSimulationJob;
+
+static void
+SimulateLinks (LoRaWANLinkSimulationJob* job)
+{
+  // No logging in here: this runs outside of the simulator thread
+  LoRaWANLinkBatch& batch = *job->m_batch;
+  for (uint32_t i = job->m_begin; i < job->m_end; i++)
+    {
+      const double p = batch.m_successProbability[i];
+      if (p <= 0.0 || p >= 1.0)
+        {
+          batch.m_nReceived[i] = p >= 1.0 ? job->m_nPackets : 0;
+          continue;
+        }
+
+      // Same draw as LoRaWANPhy::CheckInterference: destroyed when U < PER
+      const double per = 1.0 - p;
+      RngStream rng (job->m_seed, job->m_stream, job->m_firstSubstream + i, job->m_rngType);
+      uint32_t nReceived = 0;
+      double u[64];
+      for (uint32_t n = 0; n < job->m_nPackets; n += 64)
+        {
+          const uint32_t nDraws = std::min (job->m_nPackets - n, 64u);
+          rng.RandU01 (u, nDraws);
+          for (uint32_t k = 0; k < nDraws; k++)
+            nReceived += !(u[k] < per);
+        }
+      batch.m_nReceived[i] = nReceived;
+    }
+}
+
+TypeId
+LoRaWANLinkEvaluator::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::LoRaWANLinkEvaluator")
+    .SetParent<Object> ()
+    .SetGroupName ("LoRaWAN")
+    .AddConstructor<LoRaWANLinkEvaluator> ()
+    .AddAttribute ("Threads",
+                   "The number of threads Simulate draws the packets on, 0 to use one thread per processor",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&LoRaWANLinkEvaluator::m_nThreads),
+                   MakeUintegerChecker<uint32_t> ())
+  ;
+  return tid;
+}
+
+LoRaWANLinkEvaluator::LoRaWANLinkEvaluator ()
+  : m_lossModel (CreateObject<LogDistancePropagationLossModel> ()),
+    m_gatewayMobility (CreateObject<ConstantPositionMobilityModel> ()),
+    m_endDeviceMobility (CreateObject<ConstantPositionMobilityModel> ()),
+    m_errorModel (LoRaWANPhyConfigRegistry::GetErrorModel ()),
+    m_nThreads (0),
+    m_stream (-1),
+    m_nLinksSimulated (0)
+{
+  NS_LOG_FUNCTION (this);
+
+  // The noise PSD of LoRaWANPhy is flat over all channels
+  LoRaWANSpectrumValueHelper psdHelper;
+  const uint32_t freq = LoRaWAN::m_supportedChannels [0].m_fc;
+  Ptr<SpectrumValue> noise = psdHelper.CreateNoisePowerSpectralDensity (freq);
+  m_noisePowerDbm = 10.0 * std::log10 (LoRaWANSpectrumValueHelper::TotalAvgPower (noise, freq)) + 30.0;
+}
+
+LoRaWANLinkEvaluator::~LoRaWANLinkEvaluator ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+LoRaWANLinkEvaluator::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  m_lossModel = 0;
+  m_gatewayMobility = 0;
+  m_endDeviceMobility = 0;
+  m_errorModel = 0;
+  Object::DoDispose ();
+}
+
+void
+LoRaWANLinkEvaluator::SetPropagationLossModel (Ptr<PropagationLossModel> lossModel)
+{
+  NS_LOG_FUNCTION (this << lossModel);
+  m_lossModel = lossModel;
+}
+
+Ptr<PropagationLossModel>
+LoRaWANLinkEvaluator::GetPropagationLossModel (void) const
+{
+  return m_lossModel;
+}
+
+double
+LoRaWANLinkEvaluator::GetNoisePower (void) const
+{
+  return m_noisePowerDbm;
+}
+
+uint32_t
+LoRaWANLinkEvaluator::GetNBits (uint8_t dataRateIndex, uint8_t codeRate, uint8_t phyPayloadSize)
+{
+  // As in LoRaWANPhy::CheckInterference at the end of an uninterrupted reception
+  const uint32_t bandwidth = LoRaWAN::m_supportedChannels [0].m_bw;
+  const LoRaSpreadingFactor sf = LoRaWAN::m_supportedDataRates [dataRateIndex].spreadingFactor;
+  const double nominalDataRate = sf * (bandwidth / pow (2.0, sf));
+  const double t = LoRaWANPhy::CalculateTxTime (phyPayloadSize, 0, dataRateIndex, codeRate, 8, true).ToDouble (Time::MS);
+  return ceil (t * (nominalDataRate / 1000));
+}
+
+void
+LoRaWANLinkEvaluator::Evaluate (LoRaWANLinkBatch& batch)
+{
+  const uint32_t n = batch.GetN ();
+  NS_LOG_FUNCTION (this << n);
+
+  NS_ASSERT (batch.m_dataRateIndex.size () == n && batch.m_codeRate.size () == n && batch.m_phyPayloadSize.size () == n && batch.m_txPower.size () == n);
+
+  batch.m_rxPower.resize (n);
+  batch.m_snr.resize (n);
+  batch.m_successProbability.resize (n);
+
+  // The loss model: serially, through the mobility models as the spectrum
+  // channel does. The channel computes the path gain for 0 dBm.
+  m_gatewayMobility->SetPosition (Vector (0.0, 0.0, 0.0));
+  for (uint32_t i = 0; i < n; i++)
+    {
+      m_endDeviceMobility->SetPosition (Vector (batch.m_distance[i], 0.0, 0.0));
+      const double gain = m_lossModel ? m_lossModel->CalcRxPower (0.0, m_endDeviceMobility, m_gatewayMobility) : 0.0;
+      batch.m_rxPower[i] = batch.m_txPower[i] + gain;
+    }
+
+  // Look up the error model parameters once per (data rate, code rate) and
+  // gather them into arrays, so that the loops below have no branches or calls
+  // other than math functions
+  double curveA[LORAWAN_ERROR_MODEL_NR_COEFF];
+  double curveB[LORAWAN_ERROR_MODEL_NR_COEFF];
+  double curveSnrMin[LORAWAN_ERROR_MODEL_NR_COEFF];
+  double cutoff[LORAWAN_ERROR_MODEL_NR_COEFF];
+  for (uint8_t dr = 0; dr < LORAWAN_ERROR_MODEL_NR_COEFF / 2; dr++)
+    {
+      if (LoRaWAN::m_supportedDataRates [dr].bandWith == 0)
+        continue; // RFU in the region in use, e.g. DR5 in US915
+      const LoRaSpreadingFactor sf = LoRaWAN::m_supportedDataRates [dr].spreadingFactor;
+      for (uint8_t c = 0; c < 2; c++)
+        {
+          const uint8_t codeRate = c == 0 ? 1 : 3;
+          const uint8_t index = dr * 2 + c;
+          m_errorModel->GetBERCurve (sf, codeRate, curveA[index], curveB[index], curveSnrMin[index]);
+          cutoff[index] = m_errorModel->getSNRCutoffForRX (LoRaWAN::m_supportedDataRates [dr].bandWith, sf, codeRate);
+        }
+    }
+
+  std::vector<double> a (n);
+  std::vector<double> b (n);
+  std::vector<double> snrMin (n);
+  std::vector<double> snrCutoff (n);
+  std::vector<double> nbits (n);
+  for (uint32_t i = 0; i < n; i++)
+    {
+      const uint8_t dr = batch.m_dataRateIndex[i];
+      const uint8_t codeRate = batch.m_codeRate[i];
+      if (dr >= LORAWAN_ERROR_MODEL_NR_COEFF / 2 || LoRaWAN::m_supportedDataRates [dr].bandWith == 0 || (codeRate != 1 && codeRate != 3))
+        {
+          NS_FATAL_ERROR (this << " link " << i << ": unsupported data rate index " << (unsigned)dr << " or code rate " << (unsigned)codeRate);
+        }
+      const uint8_t index = dr * 2 + (codeRate == 3);
+      a[i] = curveA[index];
+      b[i] = curveB[index];
+      snrMin[i] = curveSnrMin[index];
+      snrCutoff[i] = cutoff[index];
+      nbits[i] = GetNBits (dr, codeRate, batch.m_phyPayloadSize[i]);
+    }
+
+  const double noise = m_noisePowerDbm;
+  double* rxPower = batch.m_rxPower.data ();
+  double* snr = batch.m_snr.data ();
+  double* psr = batch.m_successProbability.data ();
+
+  for (uint32_t i = 0; i < n; i++)
+    snr[i] = rxPower[i] - noise;
+
+  // log10(BER) = a*exp(b*x), see LoRaWANErrorModel::getBER
+  for (uint32_t i = 0; i < n; i++)
+    {
+      const double x = std::min (std::max (snr[i], snrMin[i]), 0.0);
+      psr[i] = a[i] * std::exp (b[i] * x);
+    }
+
+  // PSR = (1-BER)^nbits if the SNR exceeds the cutoff, see LoRaWANErrorModel::GetChunkSuccessRate
+  for (uint32_t i = 0; i < n; i++)
+    {
+      const double ber = std::pow (10.0, psr[i]);
+      const double p = std::pow (1.0 - ber, nbits[i]);
+      psr[i] = snr[i] > snrCutoff[i] ? p : 0.0;
+    }
+}
+
+void
+LoRaWANLinkEvaluator::Simulate (LoRaWANLinkBatch& batch, uint32_t nPackets)
+{
+  const uint32_t n = batch.GetN ();
+  NS_LOG_FUNCTION (this << n << nPackets);
+
+  if (batch.m_successProbability.size () != n)
+    Evaluate (batch);
+
+  batch.m_nReceived.resize (n);
+
+  if (m_stream < 0)
+    m_stream = RngSeedManager::GetNextStreamIndex ();
+
+  // One substream per link: the run number selects a block of 2^32
+  // substreams, consecutive Simulate calls use consecutive links in the block
+  const uint64_t firstSubstream = (RngSeedManager::GetRun () << 32) + m_nLinksSimulated;
+  m_nLinksSimulated += n;
+
+  uint32_t nThreads = m_nThreads;
+  if (nThreads == 0)
+    {
+      const long nProcessors = sysconf (_SC_NPROCESSORS_ONLN);
+      nThreads = nProcessors > 0 ? nProcessors : 1;
+    }
+  nThreads = std::max (1u, std::min (nThreads, n));
+#ifndef HAVE_PTHREAD_H
+  nThreads = 1;
+#endif
+
+  std::vector<LoRaWANLinkSimulationJob> jobs (nThreads);
+  for (uint32_t t = 0; t < nThreads; t++)
+    {
+      jobs[t].m_batch = &batch;
+      jobs[t].m_begin = uint64_t (n) * t / nThreads;
+      jobs[t].m_end = uint64_t (n) * (t + 1) / nThreads;
+      jobs[t].m_nPackets = nPackets;
+      jobs[t].m_seed = RngSeedManager::GetSeed ();
+      jobs[t].m_stream = m_stream;
+      jobs[t].m_firstSubstream = firstSubstream;
+      jobs[t].m_rngType = RngSeedManager::GetRngType ();
+    }
+
+  NS_LOG_LOGIC (this << " drawing " << nPackets << " packets for " << n << " links on " << nThreads << " threads");
+
+#ifdef HAVE_PTHREAD_H
+  std::vector<Ptr<SystemThread> > threads;
+  for (uint32_t t = 1; t < nThreads; t++)
+    {
+      Ptr<SystemThread> thread = Create<SystemThread> (MakeBoundCallback (&SimulateLinks, &jobs[t]));
+      thread->Start ();
+      threads.push_back (thread);
+    }
+#endif
+
+  // The calling thread takes the first share
+  if (!jobs.empty ())
+    SimulateLinks (&jobs[0]);
+
+#ifdef HAVE_PTHREAD_H
+  for (auto& thread : threads)
+    thread->Join ();
+#endif
+}
+
+int64_t
+LoRaWANLinkEvaluator::AssignStreams (int64_t stream)
+{
+  NS_LOG_FUNCTION (this << stream);
+  m_stream = stream;
+  m_nLinksSimulated = 0;
+  return 1;
+}
+
+} // namespace ns3
@@ -0,0 +1,159 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+
+
+#ifndef LORAWAN_LINK_EVALUATOR_H
+#define LORAWAN_LINK_EVALUATOR_H
+
+#include "lorawan.h"
+#include "lorawan-error-model.h"
+#include <ns3/object.h>
+#include <ns3/propagation-loss-model.h>
+#include <ns3/constant-position-mobility-model.h>
+
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup lorawan
+ *
+ * A batch of end device to gateway links, stored as one array per field so
+ * that the evaluation loops run over contiguous memory.
+ *
+ * The inputs are filled in by the user (e.g. with Add), the outputs by
+ * LoRaWANLinkEvaluator::Evaluate and LoRaWANLinkEvaluator::Simulate.
+ */
+class LoRaWANLinkBatch
+{
+public:
+  /**
+   * \brief Append a link to the batch
+   *
+   * \param distance distance between end device and gateway in m
+   * \param dataRateIndex data rate index, only the 125 kHz data rates (0-5) are supported by the error model
+   * \param codeRate code rate (1 for 4/5 or 3 for 4/7), as in LoRaWANDataRequestParams
+   * \param phyPayloadSize size of the PHY payload in bytes (MAC header, MAC payload and MIC)
+   * \param txPower transmission power in dBm
+   */
+  void Add (double distance, uint8_t dataRateIndex, uint8_t codeRate, uint8_t phyPayloadSize, double txPower);
+
+  uint32_t GetN (void) const;
+  void Clear (void);
+
+  // Inputs
+  std::vector<double> m_distance;         //!< m
+  std::vector<uint8_t> m_dataRateIndex;
+  std::vector<uint8_t> m_codeRate;
+  std::vector<uint8_t> m_phyPayloadSize;  //!< bytes
+  std::vector<double> m_txPower;          //!< dBm
+
+  // Outputs of LoRaWANLinkEvaluator::Evaluate
+  std::vector<double> m_rxPower;          //!< dBm
+  std::vector<double> m_snr;              //!< dB
+  std::vector<double> m_successProbability;
+
+  // Output of LoRaWANLinkEvaluator::Simulate
+  std::vector<uint32_t> m_nReceived;
+};
+
+/**
+ * \ingroup lorawan
+ *
+ * Evaluates many links at once without going through the event loop, using
+ * the same reception model as LoRaWANPhy for a packet without interference:
+ * the packet is dropped when its SNR does not exceed the SNR cutoff of the
+ * error model, otherwise it is received with probability
+ * GetChunkSuccessRate (snr, nbits) where nbits is the number of bits sent at
+ * the nominal data rate during the time on air of the packet.
+ *
+ * The propagation loss model is evaluated once per link and in the calling
+ * thread, as loss models are not thread safe. Random loss models (e.g.
+ * shadowing or fading) are hence sampled once per link: to average over
+ * their distribution add the same link several times. The remainder of the
+ * evaluation runs in branch free loops over the batch arrays that the
+ * compiler can vectorize.
+ *
+ * Simulate draws the reception of nPackets packets for every link. The draws
+ * run in parallel on the number of threads set by the Threads attribute.
+ * Every link uses its own RngStream (derived from the seed, the run number,
+ * the stream of the evaluator and the index of the link) so that the outcome
+ * does not depend on the number of threads.
+ */
+class LoRaWANLinkEvaluator : public Object
+{
+public:
+  static TypeId GetTypeId (void);
+
+  LoRaWANLinkEvaluator ();
+  virtual ~LoRaWANLinkEvaluator ();
+
+  void SetPropagationLossModel (Ptr<PropagationLossModel> lossModel);
+  Ptr<PropagationLossModel> GetPropagationLossModel (void) const;
+
+  /**
+   * \brief Calculate the received power, SNR and success probability of every link in the batch
+   */
+  void Evaluate (LoRaWANLinkBatch& batch);
+
+  /**
+   * \brief Draw the reception of nPackets packets on every link in the batch
+   *
+   * Calls Evaluate first when the batch has not been evaluated yet.
+   */
+  void Simulate (LoRaWANLinkBatch& batch, uint32_t nPackets);
+
+  /**
+   * \brief Noise power in the 125 kHz channel bandwidth in dBm, as seen by LoRaWANPhy
+   */
+  double GetNoisePower (void) const;
+
+  /**
+   * \brief Number of bits LoRaWANPhy feeds to the error model for a packet received without interference
+   */
+  static uint32_t GetNBits (uint8_t dataRateIndex, uint8_t codeRate, uint8_t phyPayloadSize);
+
+  /**
+   * Assign a fixed random variable stream number to the random variables
+   * used by this model.  Return the number of streams (possibly zero) that
+   * have been assigned.
+   *
+   * \param stream first stream index to use
+   * \return the number of stream indices assigned by this model
+   */
+  int64_t AssignStreams (int64_t stream);
+
+private:
+  virtual void DoDispose (void);
+
+  Ptr<PropagationLossModel> m_lossModel;
+  Ptr<ConstantPositionMobilityModel> m_gatewayMobility;
+  Ptr<ConstantPositionMobilityModel> m_endDeviceMobility;
+  Ptr<LoRaWANErrorModel> m_errorModel;
+  double m_noisePowerDbm;
+
+  uint32_t m_nThreads;       //!< 0 to use all processors
+  int64_t m_stream;          //!< -1 until a stream is assigned or first needed
+  uint64_t m_nLinksSimulated; //!< offset of the substreams of the next Simulate call
+};
+
+} // namespace ns3
+
+#endif /* LORAWAN_LINK_EVALUATOR_H */
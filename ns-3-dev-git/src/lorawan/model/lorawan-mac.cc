@@ -22,11 +22,14 @@
 #include "lorawan-mac-header.h"
 #include "lorawan-net-device.h"
 #include "lorawan-frame-header.h"
+#include "lorawan-trace-source-accessor.h"
+#include "lorawan-gateway-front-end.h"
 #include <ns3/simulator.h>
 #include <ns3/log.h>
 #include <ns3/packet.h>
 #include <ns3/random-variable-stream.h>
 #include <ns3/double.h>
+#include <ns3/boolean.h>
 
 namespace ns3 {
 
@@ -58,6 +61,14 @@ LoRaWANMac::GetTypeId (void)
     .SetParent<Object> ()
     .SetGroupName ("LoRaWAN")
     .AddConstructor<LoRaWANMac> ()
+    .AddAttribute ("CompressReceiveWindows",
+                   "Let a class A end device wait for its receive windows without "
+                   "the intermediate MAC and PHY state changes, as long as nothing "
+                   "is sent on the channel and data rate of a window and no sink is "
+                   "connected to the MacState and TrxState trace sources",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&LoRaWANMac::m_compressReceiveWindows),
+                   MakeBooleanChecker ())
     .AddTraceSource ("MacTxEnqueue",
                      "Trace source indicating a packet has been "
                      "enqueued in the transaction queue",
@@ -115,7 +126,7 @@ LoRaWANMac::GetTypeId (void)
 // TODO: broken...
     .AddTraceSource ("MacState",
                      "The state of LoRaWAN Mac",
-                     MakeTraceSourceAccessor (&LoRaWANMac::m_LoRaWANMacState),
+                     MakeLoRaWANCountingTraceSourceAccessor (&LoRaWANMac::m_LoRaWANMacState, &LoRaWANMac::m_nMacStateSinks),
                      "ns3::TracedValueCallback::LoRaWANMacState")
     .AddTraceSource ("MacSentPkt",
                      "Trace source reporting some information about "
@@ -127,11 +138,11 @@ LoRaWANMac::GetTypeId (void)
 }
 
 LoRaWANMac::LoRaWANMac ()
+  : LoRaWANMac (0) // index not provided, assume 0
 {
-  LoRaWANMac (0); // index not provided, assume 0
 }
 
-LoRaWANMac::LoRaWANMac (uint8_t index) : m_index (index)
+LoRaWANMac::LoRaWANMac (uint8_t index) : m_index (index), m_nMacStateSinks (0), m_compressReceiveWindows (true), m_compressedRW (false)
 {
   // First set the state to a known value, call ChangeMacState to fire trace source.
   //m_LoRaWANMacState.push_back (MAC_IDLE);
@@ -171,6 +182,12 @@ LoRaWANMac::SetRDC (Ptr<LoRaWANMacRDC> macRDC)
   this->m_lorawanMacRDC = macRDC;
 }
 
+void
+LoRaWANMac::SetFrontEnd (Ptr<LoRaWANGatewayFrontEnd> frontEnd)
+{
+  m_frontEnd = frontEnd;
+}
+
 void
 LoRaWANMac::DoInitialize ()
 {
@@ -191,17 +208,29 @@ LoRaWANMac::sendTRXStateRequestForIdleMAC ()
   }
 }
 
+uint32_t
+LoRaWANMac::GetTxQueuePoolNInUse (void)
+{
+  return LoRaWANQueueElementPool<TxQueueElement>::GetNInUse ();
+}
+
+uint32_t
+LoRaWANMac::GetTxQueuePoolCapacity (void)
+{
+  return LoRaWANQueueElementPool<TxQueueElement>::GetCapacity ();
+}
+
 void
 LoRaWANMac::DoDispose ()
 {
   m_txPkt = 0;
-  for (uint32_t i = 0; i < m_txQueue.size (); i++)
-    {
-      m_txQueue[i]->txQPkt = 0;
-      delete m_txQueue[i];
-    }
-  m_txQueue.clear ();
+  m_txQueue.Clear (); // hand the queued elements back to the pool
+  m_pingSlotEvent.Cancel ();
+  m_setMacState.Cancel ();
+  if (m_phy)
+    m_phy->DisarmRx ();
   m_phy = 0;
+  m_frontEnd = 0;
   m_dataIndicationCallback = MakeNullCallback< void, LoRaWANDataIndicationParams, Ptr<Packet> > ();
   m_dataConfirmCallback = MakeNullCallback< void, LoRaWANDataConfirmParams > ();
 
@@ -259,7 +288,7 @@ LoRaWANMac::SetLoRaWANMacState (LoRaWANMacState macState)
   NS_LOG_FUNCTION (this << macState);
 
   if (macState == MAC_IDLE) {
-      NS_ASSERT (m_LoRaWANMacState == MAC_TX || m_LoRaWANMacState == MAC_RW1 || m_LoRaWANMacState == MAC_RW2 || m_LoRaWANMacState == MAC_ACK_TIMEOUT || m_LoRaWANMacState == MAC_UNAVAILABLE);
+      NS_ASSERT (m_LoRaWANMacState == MAC_TX || m_LoRaWANMacState == MAC_RW1 || m_LoRaWANMacState == MAC_RW2 || m_LoRaWANMacState == MAC_ACK_TIMEOUT || m_LoRaWANMacState == MAC_UNAVAILABLE || m_LoRaWANMacState == MAC_PINGSLOT);
 
       ChangeMacState (macState);
 
@@ -278,6 +307,13 @@ LoRaWANMac::SetLoRaWANMacState (LoRaWANMacState macState)
   } else if (macState == MAC_TX) {
       NS_ASSERT (m_LoRaWANMacState == MAC_IDLE);
 
+      if (m_frontEnd && m_frontEnd->IsTransmitting ()) {
+        // Another MAC of the gateway started transmitting since CheckQueue, the receive window of the frame is lost
+        DropFrameForBusyFrontEnd ();
+        CheckQueue ();
+        return;
+      }
+
       // for gateways: switch off other PHY/MACs on this net-device
       if (m_deviceType == LORAWAN_DT_GATEWAY) {
         NS_ASSERT (!this->m_beginTxCallback.IsNull ());
@@ -304,7 +340,11 @@ LoRaWANMac::SetLoRaWANMacState (LoRaWANMacState macState)
 
       // schedule a MAC event to open RW1
       Time receiveDelay = MicroSeconds (RECEIVE_DELAY1);
-      m_setMacState = Simulator::Schedule (receiveDelay, &LoRaWANMac::SetLoRaWANMacState, this, MAC_RW1);
+      m_rwOpen = Simulator::Now () + receiveDelay;
+      if (m_compressedRW)
+        ArmRW ();
+      else
+        m_setMacState = Simulator::Schedule (receiveDelay, &LoRaWANMac::SetLoRaWANMacState, this, MAC_RW1);
   } else if (macState == MAC_RW1) {
       NS_ASSERT (m_LoRaWANMacState == MAC_WAITFORRW1);
 
@@ -320,14 +360,18 @@ LoRaWANMac::SetLoRaWANMacState (LoRaWANMacState macState)
 
       // schedule a MAC event to open RW2
       // RW2 starts RECEIVE_DELAY2 after the end of the uplink modulation
-      Time receiveDelay = (m_lastUplinkBitTime + MicroSeconds (RECEIVE_DELAY2)) - Simulator::Now ();
-      if (receiveDelay >= 0)
+      m_rwOpen = m_lastUplinkBitTime + MicroSeconds (RECEIVE_DELAY2);
+      Time receiveDelay = m_rwOpen - Simulator::Now ();
+      if (receiveDelay >= 0 && m_compressedRW)
+        ArmRW ();
+      else if (receiveDelay >= 0)
         m_setMacState = Simulator::Schedule (receiveDelay, &LoRaWANMac::SetLoRaWANMacState, this, MAC_RW2);
       else {
         // the node missed the start of RW2 (e.g. a long packet was received in RW1 but was dropped after or during reception)
         // TODO: what to do?
         // For now try to continue gracefully by switching mac state to RW2 and immediately calling OpenRW() and CloseRW()
         NS_LOG_WARN (this << " MAC missed the start of RW2");
+        m_rwOpen = Simulator::Now ();
         ChangeMacState (MAC_RW2);
         OpenRW ();
         CloseRW ();
@@ -424,7 +468,7 @@ LoRaWANMac::PdDataIndication (uint32_t phyPayloadLength, Ptr<Packet> p, uint8_t
   // TODO: which state?
   //
   if (m_deviceType == LORAWAN_DT_END_DEVICE_CLASS_A) {
-    NS_ASSERT (m_LoRaWANMacState == MAC_RW1 || m_LoRaWANMacState == MAC_RW2); // gateway would be in MAC_IDLE, class A in either RW1 or RW2
+    NS_ASSERT (m_LoRaWANMacState == MAC_RW1 || m_LoRaWANMacState == MAC_RW2 || m_LoRaWANMacState == MAC_PINGSLOT); // gateway would be in MAC_IDLE, class A in either RW1 or RW2 (or a class B ping slot)
   } else if (m_deviceType == LORAWAN_DT_GATEWAY) {
     NS_ASSERT (m_LoRaWANMacState == MAC_IDLE);
   }  else {
@@ -491,7 +535,7 @@ LoRaWANMac::PdDataIndication (uint32_t phyPayloadLength, Ptr<Packet> p, uint8_t
           m_ackTimeOut.Cancel ();
           if (!m_dataConfirmCallback.IsNull ())
           { // Call callback, informing succesfull delivery of frame
-              TxQueueElement *txQElement = m_txQueue.front ();
+              TxQueueElement *txQElement = m_txQueue.Front ();
               LoRaWANDataConfirmParams confirmParams;
               confirmParams.m_requestHandle = txQElement->lorawanDataRequestParams.m_requestHandle;
               confirmParams.m_status = LORAWAN_SUCCESS;
@@ -506,7 +550,7 @@ LoRaWANMac::PdDataIndication (uint32_t phyPayloadLength, Ptr<Packet> p, uint8_t
         }
       }
 
-      // Update MAC state from RW1 or RW2 to IDLE, this will set the Phy TRX state to OFF
+      // Update MAC state from RW1, RW2 or the ping slot to IDLE, this will set the Phy TRX state to OFF
       m_setMacState.Cancel ();
       m_setMacState = Simulator::ScheduleNow (&LoRaWANMac::SetLoRaWANMacState, this, MAC_IDLE);
     } else if (m_deviceType == LORAWAN_DT_GATEWAY) {
@@ -562,7 +606,7 @@ LoRaWANMac::SetTRXStateConfirm (LoRaWANPhyEnumeration status)
       Ptr<Packet> p = m_txPkt;
 
       // Get airtime for TX of PHY frame and update RDC
-      TxQueueElement *txQElement = m_txQueue.front ();
+      TxQueueElement *txQElement = m_txQueue.Front ();
       Time airTime = m_phy->CalculateTxTime (p->GetSize ()); // which PHY does not matter here
       uint8_t subBandIndex = LoRaWAN::m_supportedChannels [txQElement->lorawanDataRequestParams.m_loraWANChannelIndex].m_subBandIndex;
       m_lorawanMacRDC->UpdateRDCTimerForSubBand (subBandIndex, airTime);
@@ -575,7 +619,7 @@ LoRaWANMac::SetTRXStateConfirm (LoRaWANPhyEnumeration status)
       NS_ASSERT (status == LORAWAN_PHY_IDLE);
       // Do nothing special when waiting for RW1/RW2
     }
-  else if (m_LoRaWANMacState == MAC_RW1 || m_LoRaWANMacState == MAC_RW2)
+  else if (m_LoRaWANMacState == MAC_RW1 || m_LoRaWANMacState == MAC_RW2 || m_LoRaWANMacState == MAC_PINGSLOT)
     {
       // Either we are at the beginning of the RW, during which the transceiver
       // is switched in RX ON or we are at the end of RW where the transceiver
@@ -607,7 +651,7 @@ LoRaWANMac::PdDataConfirm (LoRaWANPhyEnumeration status)
 {
   NS_ASSERT (m_LoRaWANMacState == MAC_TX);
 
-  NS_LOG_FUNCTION (this << status << m_txQueue.size ());
+  NS_LOG_FUNCTION (this << status << m_txQueue.GetSize ());
 
   NS_ASSERT (m_txPkt);
   LoRaWANMacHeader macHdr;
@@ -619,8 +663,8 @@ LoRaWANMac::PdDataConfirm (LoRaWANPhyEnumeration status)
 
   if (status == LORAWAN_PHY_SUCCESS)
     {
-      NS_ASSERT_MSG (m_txQueue.size () > 0, "TxQsize = 0");
-      TxQueueElement *txQElement = m_txQueue.front ();
+      NS_ASSERT_MSG (m_txQueue.GetSize () > 0, "TxQsize = 0");
+      TxQueueElement *txQElement = m_txQueue.Front ();
       // As no Ack is comming, notify upper layer that packet was sent and check if packet can be removed from queue
       if (!macHdr.IsConfirmed ())
       {
@@ -661,7 +705,11 @@ LoRaWANMac::PdDataConfirm (LoRaWANPhyEnumeration status)
       if (m_deviceType == LORAWAN_DT_END_DEVICE_CLASS_A) { // always go to WAITFORRW1 for Class A
         // Note that the Ack timeout timer will only start running at the beginning of RW2
         m_lastUplinkBitTime = Simulator::Now ();
-        m_setMacState = Simulator::ScheduleNow (&LoRaWANMac::SetLoRaWANMacState, this, MAC_WAITFORRW1);
+        m_compressedRW = UseCompressedReceiveWindows ();
+        if (m_compressedRW)
+          SetLoRaWANMacState (MAC_WAITFORRW1); // nobody traces the intermediate states, see ArmRW
+        else
+          m_setMacState = Simulator::ScheduleNow (&LoRaWANMac::SetLoRaWANMacState, this, MAC_WAITFORRW1);
       } else if (m_deviceType == LORAWAN_DT_GATEWAY) { // Gateway
         // Always go to IDLE state for gateway, retransmissions are handled by the network server
         m_setMacState = Simulator::ScheduleNow (&LoRaWANMac::SetLoRaWANMacState, this, MAC_IDLE);
@@ -762,10 +810,9 @@ LoRaWANMac::sendMACPayloadRequest (LoRaWANDataRequestParams params, Ptr<Packet>
   m_macTxEnqueueTrace (phyPayload);
 
   // All checks have been passed, add packet to the queue
-  TxQueueElement *txQElement = new TxQueueElement;
+  TxQueueElement *txQElement = m_txQueue.Emplace ();
   txQElement->lorawanDataRequestParams = params;
   txQElement->txQPkt = phyPayload;
-  m_txQueue.push_back (txQElement);
 
   CheckQueue ();
 }
@@ -792,12 +839,19 @@ LoRaWANMac::CheckQueue ()
 
   // Check if we can send a packet: MAC State, Phy state and RDC
 
-  NS_LOG_DEBUG (this << " INFO: tx queue size is equal to " << m_txQueue.size());
+  NS_LOG_DEBUG (this << " INFO: tx queue size is equal to " << m_txQueue.GetSize ());
 
-  if (m_LoRaWANMacState == MAC_IDLE && !m_txQueue.empty () && m_txPkt == 0 && !m_setMacState.IsRunning ())
+  if (m_LoRaWANMacState == MAC_IDLE && !m_txQueue.IsEmpty () && m_txPkt == 0 && !m_setMacState.IsRunning ())
   {
+    if (m_frontEnd && m_frontEnd->IsTransmitting ()) {
+      // The frame was meant for a receive window that starts now, it cannot wait for the front-end
+      DropFrameForBusyFrontEnd ();
+      CheckQueue ();
+      return;
+    }
+
     // Check RDC constraints for first packet in the queue
-    TxQueueElement *txQElement = m_txQueue.front ();
+    TxQueueElement *txQElement = m_txQueue.Front ();
     int8_t subBandIndex = m_lorawanMacRDC->GetSubBandIndexForChannelIndex (txQElement->lorawanDataRequestParams.m_loraWANChannelIndex);
     NS_ASSERT (subBandIndex >= 0);
     if (m_lorawanMacRDC->IsSubBandAvailable (subBandIndex))
@@ -821,7 +875,7 @@ LoRaWANMac::CheckQueue ()
   } else {
     if (m_LoRaWANMacState != MAC_IDLE)
       NS_LOG_DEBUG (this << " Cannot sent packet because MAC is not idle, MAC state is equal to " << m_LoRaWANMacState);
-    if (m_txQueue.empty ())
+    if (m_txQueue.IsEmpty ())
       NS_LOG_DEBUG (this << " tx queue is empty, so there is no packet to send.");
     if (m_txPkt)
       NS_LOG_DEBUG (this << " Cannot sent packet because of ongoing tx (m_txPkt is set)");
@@ -831,7 +885,7 @@ LoRaWANMac::CheckQueue ()
 
   // If a gateway can not send a packet immediately, then there is no use in trying to send it later as the RW of the end device will not be open later
   if (m_deviceType == LORAWAN_DT_GATEWAY) {
-    if (!m_txQueue.empty ()) {
+    if (!m_txQueue.IsEmpty ()) {
       // this is a dangereous state to be in, experience has shown that the gateway MACs gets stuck at this point
       this->RemoveFirstTxQElement (false);
       NS_FATAL_ERROR (this << " Gateway is unable to send packet immediately, aborting packet transmission.");
@@ -849,7 +903,7 @@ LoRaWANMac::CheckRetransmission ()
   NS_LOG_FUNCTION (this);
 
   // The packet:
-  TxQueueElement *txQElement = m_txQueue.front ();
+  TxQueueElement *txQElement = m_txQueue.Front ();
   NS_ASSERT (txQElement != 0);
   LoRaWANDataRequestParams params = txQElement->lorawanDataRequestParams;
 
@@ -907,26 +961,45 @@ LoRaWANMac::RemoveFirstTxQElement (bool sentPacket)
 {
   NS_LOG_FUNCTION (this);
 
-  TxQueueElement *txQElement = m_txQueue.front ();
+  TxQueueElement *txQElement = m_txQueue.Front ();
   Ptr<const Packet> p = txQElement->txQPkt;
 
   if (sentPacket)
     m_sentPktTrace (p, m_retransmission + 1);
 
-  txQElement->txQPkt = 0;
-  delete txQElement;
-  m_txQueue.pop_front ();
+  m_txQueue.PopFront ();
   m_txPkt = 0;
   m_retransmission = 0;
   m_macTxDequeueTrace (p);
 }
 
+void
+LoRaWANMac::DropFrameForBusyFrontEnd ()
+{
+  NS_LOG_FUNCTION (this);
+
+  TxQueueElement *txQElement = m_txQueue.Front ();
+  NS_ASSERT (txQElement != 0);
+  NS_LOG_DEBUG (this << " Dropping packet because the front-end of the gateway is transmitting");
+
+  m_macTxDropTrace (txQElement->txQPkt);
+  if (!m_dataConfirmCallback.IsNull ())
+  {
+    LoRaWANDataConfirmParams confirmParams;
+    confirmParams.m_requestHandle = txQElement->lorawanDataRequestParams.m_requestHandle;
+    confirmParams.m_status = LORAWAN_CHANNEL_ACCESS_FAILURE;
+    m_dataConfirmCallback (confirmParams);
+  }
+
+  RemoveFirstTxQElement (false);
+}
+
 bool
 LoRaWANMac::ConfigurePhyForTX () {
   NS_LOG_FUNCTION (this);
 
   if (m_txPkt != 0) {
-    TxQueueElement *txQElement = m_txQueue.front ();
+    TxQueueElement *txQElement = m_txQueue.Front ();
     // Select and configure PHY
     uint8_t channelIndex = txQElement->lorawanDataRequestParams.m_loraWANChannelIndex;
     uint8_t dataRateIndex = txQElement->lorawanDataRequestParams.m_loraWANDataRateIndex;
@@ -998,39 +1071,22 @@ LoRaWANMac::OpenRW ()
 
   NS_ASSERT (m_deviceType == LORAWAN_DT_END_DEVICE_CLASS_A);
 
-  if (m_LoRaWANMacState == MAC_RW1) {
-    // RW1 uses the same channel as the preceding uplink
-    // The data rate is a function of the uplink data rate and the RX1DROffset
-    uint8_t channelIndex = m_phy->GetCurrentChannelIndex ();
-    uint8_t dataRateIndex = LoRaWAN::GetRX1DataRateIndex (m_phy->GetCurrentDataRateIndex (), m_RX1DROffset);
-
-    uint8_t subBandIndex = LoRaWAN::m_supportedChannels [channelIndex].m_subBandIndex;
-    uint8_t maxTxPower = m_lorawanMacRDC->GetMaxPowerForSubBand (subBandIndex);
-
-    if (!m_phy->SetTxConf (maxTxPower, channelIndex, dataRateIndex, 3, 8, false, true) ) {
-      NS_LOG_ERROR (this << " unable to configure Phy");
-      return;
-    }
-  } else if (m_LoRaWANMacState == MAC_RW2) {
-    // The default fixed RW2 channel is 869.525 MHz / DR0 (SF12, 125kHz)
-    uint8_t channelIndex = LoRaWAN::m_RW2ChannelIndex;
-    uint8_t dataRateIndex = LoRaWAN::m_RW2DataRateIndex; // fixed
+  if (m_LoRaWANMacState == MAC_RW1 || m_LoRaWANMacState == MAC_RW2) {
+    uint8_t channelIndex;
+    uint8_t dataRateIndex;
+    GetRWConf (m_LoRaWANMacState, channelIndex, dataRateIndex);
 
     uint8_t subBandIndex = LoRaWAN::m_supportedChannels [channelIndex].m_subBandIndex;
     uint8_t maxTxPower = m_lorawanMacRDC->GetMaxPowerForSubBand (subBandIndex);
 
-    if (!m_phy->SetTxConf (maxTxPower, channelIndex, dataRateIndex, 3, 8, false, true) ) {
+    if (!m_phy->SetTxConf (maxTxPower, channelIndex, dataRateIndex, 3, RW_PREAMBLE_LENGTH, false, true) ) {
       NS_LOG_ERROR (this << " unable to configure Phy");
       return;
     }
 
     // For confirmed frames, start the ACK_TIMEOUT timer at the beginning of RW2
-    if (m_txPkt) { // if the transmitted packet was unconfirmed, then it has been removed in RemoveFirstTxQElement which set m_txPkt to NULL
-      LoRaWANMacHeader macHdr;
-      m_txPkt->PeekHeader (macHdr);
-      if (macHdr.IsConfirmed ()) {
-        StartAckTimeoutTimer ();
-      }
+    if (m_LoRaWANMacState == MAC_RW2 && IsTxPktConfirmed ()) {
+      StartAckTimeoutTimer (Simulator::Now () - m_rwOpen);
     }
   } else {
       NS_LOG_ERROR (this << " MAC state incorrect " << m_LoRaWANMacState);
@@ -1047,12 +1103,52 @@ LoRaWANMac::OpenRW ()
   // ii) a. frame is intended for end device -> Close RW1, process RX and go back to idle (skip RW2)
   // ii) b. frame is not inteded for ED -> Close RW1, continue to RW2
 
+  // The window is timed from its start, also when a compressed window was only opened later, see WakeRW
   Time preambleTime = m_phy->CalculatePreambleTime ();
-  m_preambleDetected = Simulator::Schedule (preambleTime, &LoRaWANMac::CheckPhyPreamble, this);
+  m_preambleDetected = Simulator::Schedule (m_rwOpen + preambleTime - Simulator::Now (), &LoRaWANMac::CheckPhyPreamble, this);
 
   // TODO: schedule backup timer to close RW in case Phy detects preamble but does not deliver a frame to the MAC?
 }
 
+void
+LoRaWANMac::SchedulePingSlot (Time at, uint8_t channelIndex, uint8_t dataRateIndex)
+{
+  NS_LOG_FUNCTION (this << at << static_cast<uint16_t> (channelIndex) << static_cast<uint16_t> (dataRateIndex));
+
+  NS_ASSERT (m_deviceType == LORAWAN_DT_END_DEVICE_CLASS_A);
+  NS_ASSERT (at >= Simulator::Now ());
+
+  m_pingSlotEvent.Cancel ();
+  m_pingSlotEvent = Simulator::Schedule (at - Simulator::Now (), &LoRaWANMac::OpenPingSlot, this, channelIndex, dataRateIndex);
+}
+
+void
+LoRaWANMac::OpenPingSlot (uint8_t channelIndex, uint8_t dataRateIndex)
+{
+  NS_LOG_FUNCTION (this << static_cast<uint16_t> (channelIndex) << static_cast<uint16_t> (dataRateIndex));
+
+  // A ping slot can not interrupt an uplink or the receive windows that follow it
+  if (m_LoRaWANMacState != MAC_IDLE || m_setMacState.IsRunning ()) {
+    NS_LOG_DEBUG (this << " Skipping ping slot, MAC state is equal to " << m_LoRaWANMacState);
+    return;
+  }
+
+  uint8_t subBandIndex = LoRaWAN::m_supportedChannels [channelIndex].m_subBandIndex;
+  uint8_t maxTxPower = m_lorawanMacRDC->GetMaxPowerForSubBand (subBandIndex);
+  if (!m_phy->SetTxConf (maxTxPower, channelIndex, dataRateIndex, 3, RW_PREAMBLE_LENGTH, false, true) ) {
+    NS_LOG_ERROR (this << " unable to configure Phy");
+    return;
+  }
+
+  ChangeMacState (MAC_PINGSLOT);
+
+  // As for RW1 and RW2: listen for a preamble and close the ping slot when none is detected
+  m_phy->SetTRXStateRequest (LORAWAN_PHY_RX_ON);
+
+  Time preambleTime = m_phy->CalculatePreambleTime ();
+  m_preambleDetected = Simulator::Schedule (preambleTime, &LoRaWANMac::CheckPhyPreamble, this);
+}
+
 void
 LoRaWANMac::CloseRW ()
 {
@@ -1067,28 +1163,9 @@ LoRaWANMac::CloseRW ()
     return;
 
   } else if (m_LoRaWANMacState == MAC_RW2) { // no frame received, retransmissions or idle?
-    bool confirmed = false;
-    if (m_txPkt) { // if the transmitted packet was unconfirmed, then it has been removed in RemoveFirstTxQElement which set m_txPkt to NULL
-      LoRaWANMacHeader macHdr;
-      m_txPkt->PeekHeader (macHdr);
-      confirmed = macHdr.IsConfirmed ();
-    }
-
-    if (confirmed) {
-      // We didn't receive a frame in RW2, so assume that no Ack is comming: go to MAC_ACK_TIMEOUT state
-      // Note that the Ack Timeout timer was started at the beginning of RW2
-      // Also note that in some cases the RW might only be closed after the Ack timeout timer has already
-      // expired (e.g. due to a long packet reception and a short ack timeout time interval),
-      // in these cases just go immediatly to MAC_IDLE
-      if (m_ackTimeOut.IsRunning ()) {
-        m_setMacState = Simulator::ScheduleNow (&LoRaWANMac::SetLoRaWANMacState, this, MAC_ACK_TIMEOUT);
-      } else {
-        NS_LOG_WARN (this << " Closing RW2 after Ack Timeout timer has expired. Skipping MAC_ACK_TIMEOUT state and going directly to MAC_IDLE state.");
-        m_setMacState = Simulator::ScheduleNow (&LoRaWANMac::SetLoRaWANMacState, this, MAC_IDLE);
-      }
-    } else {
-      m_setMacState = Simulator::ScheduleNow (&LoRaWANMac::SetLoRaWANMacState, this, MAC_IDLE);
-    }
+    m_setMacState = Simulator::ScheduleNow (&LoRaWANMac::SetLoRaWANMacState, this, GetStateAfterRW2 ());
+  } else if (m_LoRaWANMacState == MAC_PINGSLOT) { // no frame received in the ping slot
+    m_setMacState = Simulator::ScheduleNow (&LoRaWANMac::SetLoRaWANMacState, this, MAC_IDLE);
   } else {
     NS_LOG_ERROR (this << " MAC state incorrect " << m_LoRaWANMacState);
     return;
@@ -1101,6 +1178,135 @@ LoRaWANMac::CloseRW ()
   // phy->SetTRXStateRequest(LORAWAN_PHY_IDLE);
 }
 
+LoRaWANMacState
+LoRaWANMac::GetStateAfterRW2 () const
+{
+  if (IsTxPktConfirmed ()) {
+    // We didn't receive a frame in RW2, so assume that no Ack is comming: go to MAC_ACK_TIMEOUT state
+    // Note that the Ack Timeout timer was started at the beginning of RW2
+    // Also note that in some cases the RW might only be closed after the Ack timeout timer has already
+    // expired (e.g. due to a long packet reception and a short ack timeout time interval),
+    // in these cases just go immediatly to MAC_IDLE
+    if (m_ackTimeOut.IsRunning ()) {
+      return MAC_ACK_TIMEOUT;
+    } else {
+      NS_LOG_WARN (this << " Closing RW2 after Ack Timeout timer has expired. Skipping MAC_ACK_TIMEOUT state and going directly to MAC_IDLE state.");
+      return MAC_IDLE;
+    }
+  }
+  return MAC_IDLE;
+}
+
+bool
+LoRaWANMac::IsTxPktConfirmed () const
+{
+  if (!m_txPkt) // if the transmitted packet was unconfirmed, then it has been removed in RemoveFirstTxQElement which set m_txPkt to NULL
+    return false;
+
+  LoRaWANMacHeader macHdr;
+  m_txPkt->PeekHeader (macHdr);
+  return macHdr.IsConfirmed ();
+}
+
+void
+LoRaWANMac::GetRWConf (LoRaWANMacState window, uint8_t& channelIndex, uint8_t& dataRateIndex) const
+{
+  if (window == MAC_RW1) {
+    // RW1 uses the same channel as the preceding uplink in EU868, in general the channel is a function of the uplink channel
+    // The data rate is a function of the uplink data rate and the RX1DROffset
+    channelIndex = LoRaWAN::GetRX1ChannelIndex (m_phy->GetCurrentChannelIndex ());
+    dataRateIndex = LoRaWAN::GetRX1DataRateIndex (m_phy->GetCurrentDataRateIndex (), m_RX1DROffset);
+  } else {
+    NS_ASSERT (window == MAC_RW2);
+    // The fixed RW2 channel of the region, 869.525 MHz / DR0 (SF12, 125kHz) in EU868
+    channelIndex = LoRaWAN::m_RW2ChannelIndex;
+    dataRateIndex = LoRaWAN::m_RW2DataRateIndex; // fixed
+  }
+}
+
+bool
+LoRaWANMac::UseCompressedReceiveWindows () const
+{
+  return m_compressReceiveWindows && m_deviceType == LORAWAN_DT_END_DEVICE_CLASS_A
+         && m_nMacStateSinks == 0 && !m_phy->IsTrxStateTraced ();
+}
+
+void
+LoRaWANMac::ArmRW ()
+{
+  NS_LOG_FUNCTION (this);
+
+  NS_ASSERT (m_LoRaWANMacState == MAC_WAITFORRW1 || m_LoRaWANMacState == MAC_WAITFORRW2);
+  const LoRaWANMacState window = m_LoRaWANMacState == MAC_WAITFORRW1 ? MAC_RW1 : MAC_RW2;
+
+  // Instead of opening the remaining windows and checking for a preamble at
+  // their end, only check at the end of RW2 and let the channel wake the MAC
+  // when something is sent on the channel and data rate of a window before then
+  uint8_t channelIndex;
+  uint8_t dataRateIndex;
+  Callback<void> wake = MakeCallback (&LoRaWANMac::WakeRW, this);
+  bool armed = true;
+  if (window == MAC_RW1) {
+    GetRWConf (MAC_RW1, channelIndex, dataRateIndex);
+    m_rw1Close = m_rwOpen + LoRaWANPhy::CalculatePreambleTime (channelIndex, dataRateIndex, RW_PREAMBLE_LENGTH);
+    armed = m_phy->ArmRx (channelIndex, dataRateIndex, m_rw1Close, wake);
+  }
+
+  GetRWConf (MAC_RW2, channelIndex, dataRateIndex);
+  Time rw2Close = m_lastUplinkBitTime + MicroSeconds (RECEIVE_DELAY2)
+                  + LoRaWANPhy::CalculatePreambleTime (channelIndex, dataRateIndex, RW_PREAMBLE_LENGTH);
+  if (armed)
+    armed = m_phy->ArmRx (channelIndex, dataRateIndex, rw2Close, wake);
+
+  if (armed) {
+    m_setMacState = Simulator::Schedule (rw2Close - Simulator::Now (), &LoRaWANMac::CloseArmedRW, this);
+  } else {
+    // not on a LoRaWANSpectrumChannel, the PHY has to listen itself
+    m_setMacState = Simulator::Schedule (m_rwOpen - Simulator::Now (), &LoRaWANMac::SetLoRaWANMacState, this, window);
+  }
+}
+
+void
+LoRaWANMac::WakeRW ()
+{
+  NS_LOG_FUNCTION (this);
+
+  if (m_LoRaWANMacState != MAC_WAITFORRW1 && m_LoRaWANMacState != MAC_WAITFORRW2)
+    return;
+
+  // Something is sent on the channel and data rate of an armed window: from
+  // now on the windows are opened as usual
+  m_phy->DisarmRx ();
+  m_setMacState.Cancel ();
+  if (m_LoRaWANMacState == MAC_WAITFORRW1 && Simulator::Now () >= m_rw1Close) {
+    // nothing was sent in RW1, so it was closed without a preamble
+    ChangeMacState (MAC_WAITFORRW2);
+    m_rwOpen = m_lastUplinkBitTime + MicroSeconds (RECEIVE_DELAY2);
+  }
+
+  const LoRaWANMacState window = m_LoRaWANMacState == MAC_WAITFORRW1 ? MAC_RW1 : MAC_RW2;
+  if (Simulator::Now () < m_rwOpen)
+    m_setMacState = Simulator::Schedule (m_rwOpen - Simulator::Now (), &LoRaWANMac::SetLoRaWANMacState, this, window);
+  else
+    SetLoRaWANMacState (window); // the PHY rejoins the channel and gets the transmission replayed
+}
+
+void
+LoRaWANMac::CloseArmedRW ()
+{
+  NS_LOG_FUNCTION (this);
+
+  // Nothing was sent in the windows, so the PHY would not have detected a preamble in either
+  NS_ASSERT (m_LoRaWANMacState == MAC_WAITFORRW1 || m_LoRaWANMacState == MAC_WAITFORRW2);
+  m_phy->DisarmRx ();
+  m_rwOpen = m_lastUplinkBitTime + MicroSeconds (RECEIVE_DELAY2);
+  ChangeMacState (MAC_RW2);
+  if (IsTxPktConfirmed ()) {
+    StartAckTimeoutTimer (Simulator::Now () - m_rwOpen);
+  }
+  SetLoRaWANMacState (GetStateAfterRW2 ());
+}
+
 void
 LoRaWANMac::CheckPhyPreamble ()
 {
@@ -1113,17 +1319,17 @@ LoRaWANMac::CheckPhyPreamble ()
     // 1) The frame was succesfully received by the phy and phy calls data indication callback (where MAC might or might not accept the frame) or
     // 2) The frame was destroyed during reception (e.g. due to interference) and phy calls data destroyed callback (allowing MAC to handle this)
   } else {
-    // No ongoing transmission, in case we are in RW1 or RW2 state. Close RW
-    if (m_LoRaWANMacState == MAC_RW1 || m_LoRaWANMacState == MAC_RW2) {
+    // No ongoing transmission, in case we are in RW1, RW2 or a ping slot. Close RW
+    if (m_LoRaWANMacState == MAC_RW1 || m_LoRaWANMacState == MAC_RW2 || m_LoRaWANMacState == MAC_PINGSLOT) {
       CloseRW ();
     }
   }
 }
 
 void
-LoRaWANMac::StartAckTimeoutTimer ()
+LoRaWANMac::StartAckTimeoutTimer (Time elapsed)
 {
-  NS_LOG_FUNCTION (this);
+  NS_LOG_FUNCTION (this << elapsed);
 
   double min = -ACK_TIMEOUT_RANDOM;
   double max =  ACK_TIMEOUT_RANDOM;
@@ -1136,7 +1342,7 @@ LoRaWANMac::StartAckTimeoutTimer ()
   //
   double value = m_ackTimeOutRandomVariable->GetValue ();
 
-  Time ackTimeout = MicroSeconds (ACK_TIMEOUT + value);
+  Time ackTimeout = MicroSeconds (ACK_TIMEOUT + value) - elapsed;
 
   NS_LOG_LOGIC (this << " Starting ACK_TIMEOUT of " << ACK_TIMEOUT << " + " << m_ackTimeOutRandomVariable << " = " << ackTimeout);
 
@@ -1160,25 +1366,17 @@ LoRaWANMac::AckTimeoutExpired ()
 
 // LoRaWANMacRDC class implementation:
 LoRaWANMac::LoRaWANMacRDC::LoRaWANMacRDC (void) {
-  // init sub bands, EU868
-  LoRaWANSubBand g0 = {100, 14, Time (), Time ()}; // g(Note 7), 14dBm?
-  LoRaWANSubBand g1 = {100, 14, Time (), Time ()}; // 1%
-  LoRaWANSubBand g2 = {1000, 14, Time (), Time ()}; // 0.1%
-  LoRaWANSubBand g3 = {10, 27, Time (), Time ()}; // 10%, high power subband
-  LoRaWANSubBand g4 = {100, 14, Time (), Time ()}; // 1%
-
-  this->m_subBands.push_back (g0);
-  this->m_subBands.push_back (g1);
-  this->m_subBands.push_back (g2);
-  this->m_subBands.push_back (g3);
-  this->m_subBands.push_back (g4);
-
-  // init sub band timers:
-  this->m_subBandTimers.push_back (EventId ());
-  this->m_subBandTimers.push_back (EventId ());
-  this->m_subBandTimers.push_back (EventId ());
-  this->m_subBandTimers.push_back (EventId ());
-  this->m_subBandTimers.push_back (EventId ());
+  // init sub bands of the region in use, see LoRaWAN::SetRegion
+  // every end device has its own RDC, avoid growing the vectors element by element
+  this->m_subBands.reserve (LoRaWAN::m_subBands.size ());
+  this->m_subBandTimers.reserve (LoRaWAN::m_subBands.size ());
+  for (const LoRaWANSubBandLimits& limits : LoRaWAN::m_subBands) {
+    LoRaWANSubBand subBand = {limits.dutyCycleLimit, limits.maxTXPower, Time (), Time ()};
+    this->m_subBands.push_back (subBand);
+
+    // init sub band timers:
+    this->m_subBandTimers.push_back (EventId ());
+  }
 }
 
 int8_t
@@ -1197,6 +1395,12 @@ LoRaWANMac::LoRaWANMacRDC::GetMaxPowerForSubBand (uint8_t subBandIndex) const
   return m_subBands[subBandIndex].maxTXPower;
 }
 
+uint16_t
+LoRaWANMac::LoRaWANMacRDC::GetDutyCycleLimitForSubBand (uint8_t subBandIndex) const
+{
+  return m_subBands[subBandIndex].dutyCycleLimit;
+}
+
 bool
 LoRaWANMac::LoRaWANMacRDC::IsSubBandAvailable (uint8_t subBandIndex) const
 {
@@ -22,6 +22,7 @@
 
 #include "lorawan.h"
 #include "lorawan-phy.h"
+#include "lorawan-queue-pool.h"
 #include <ns3/object.h>
 #include <ns3/traced-callback.h>
 #include <ns3/traced-value.h>
@@ -34,10 +35,12 @@
 // Default settings for EU863-870
 #define ACK_TIMEOUT 2000000 // in uS
 #define ACK_TIMEOUT_RANDOM 1000000 // in uS
+#define RW_PREAMBLE_LENGTH 8 // in symbols, the preamble length of the downlinks in receive windows and ping slots
 
 namespace ns3 {
 
 class Packet;
+class LoRaWANGatewayFrontEnd;
 
 /* ... */
 /**
@@ -56,6 +59,7 @@ typedef enum
   //MAC_RX,              //!< MAC_RX
   MAC_ACK_TIMEOUT, 	 //!< MAC_ACK_TIMEOUT, MAC state during which the MAC is waiting for the ACK_TIMEOUT (no TX is allowed during this state)
   MAC_UNAVAILABLE, 	         //!< MAC_UNAVAILABLE, MAC is currently unavailable to perform any operation (e.g. other MAC on same device is currently sending)
+  MAC_PINGSLOT,          //!< MAC_PINGSLOT, class B end device is listening in a ping slot
 } LoRaWANMacState;
 
 namespace TracedValueCallback {
@@ -91,6 +95,7 @@ typedef struct LoRaWANSubBand {
 typedef enum
 {
   LORAWAN_SUCCESS                = 0,
+  LORAWAN_CHANNEL_ACCESS_FAILURE = 1, //!< gateways: another MAC of the gateway was transmitting
   LORAWAN_NO_ACK                 = 2,
 } LoRaWANMcpsDataConfirmStatus;
 
@@ -101,6 +106,9 @@ typedef enum
  */
 struct LoRaWANDataRequestParams
 {
+  LoRaWANDataRequestParams () : m_loraWANChannelIndex(0), m_loraWANDataRateIndex(0), m_loraWANCodeRate(0), m_loraWANTxPowerIndex(0),
+    m_msgType(LORAWAN_UNCONFIRMED_DATA_UP), m_requestHandle(0), m_numberOfTransmissions(1) {}
+
   uint8_t m_loraWANChannelIndex; 	//!< Index of LoRaWAN channel
   uint8_t m_loraWANDataRateIndex; 	//!< Index of LoRa Data Rate
   //LoRaWANChannel m_loraWANChannel; 				//!< LoRaWAN channel
@@ -206,6 +214,7 @@ public:
 
     int8_t GetSubBandIndexForChannelIndex (uint8_t channelIndex) const;
     int8_t GetMaxPowerForSubBand (uint8_t subBandIndex) const;
+    uint16_t GetDutyCycleLimitForSubBand (uint8_t subBandIndex) const;
     bool IsSubBandAvailable (uint8_t subBandIndex) const;
 
     void UpdateRDCTimerForSubBand (uint8_t subBandIndex, Time airTime);
@@ -256,6 +265,14 @@ public:
    */
   void SetRDC (Ptr<LoRaWANMacRDC> macRDC);
 
+  /**
+   * Set the front-end this MAC shares with the other MACs of its gateway.
+   * The MAC does not start a transmission while the front-end transmits.
+   *
+   * \param frontEnd the front-end
+   */
+  void SetFrontEnd (Ptr<LoRaWANGatewayFrontEnd> frontEnd);
+
   void SetLoRaWANMacState (LoRaWANMacState macState);
   LoRaWANMacState GetLoRaWANMacState () const  { return this->m_LoRaWANMacState; }
   bool IsLoRaWANMacStateRunning () const { return this->m_setMacState.IsRunning (); }
@@ -324,6 +341,30 @@ public:
    */
   int64_t AssignStreams (int64_t stream);
 
+  /**
+   * \return the number of tx queue elements in use by all MACs, used to check for leaks
+   */
+  static uint32_t GetTxQueuePoolNInUse (void);
+
+  /**
+   * \return the number of tx queue elements the pool shared by all MACs can hand out without allocating
+   */
+  static uint32_t GetTxQueuePoolCapacity (void);
+
+  /**
+   * \brief Open a class B ping slot at the given time
+   *
+   * Ping slots are only opened on request of the network server when it has a
+   * downlink queued for the end device, instead of at every ping slot of every
+   * beacon period. The ping slot is skipped when the MAC is not idle at that
+   * time (e.g. it is sending an uplink).
+   *
+   * \param at the start of the ping slot
+   * \param channelIndex the channel of the ping slot
+   * \param dataRateIndex the data rate of the ping slot
+   */
+  void SchedulePingSlot (Time at, uint8_t channelIndex, uint8_t dataRateIndex);
+
 protected:
   // Inherited from Object.
   virtual void DoInitialize (void);
@@ -335,17 +376,61 @@ protected:
   void CheckQueue ();
   void CheckRetransmission ();
   void RemoveFirstTxQElement (bool sentPacket);
+  /**
+   * \brief Drop the first frame of the tx queue because the front-end of the gateway transmits
+   *
+   * A downlink is sent in a receive window or ping slot of the end device,
+   * so it is dropped instead of waiting for the front-end: the MacTxDrop
+   * trace fires and the data confirm reports LORAWAN_CHANNEL_ACCESS_FAILURE.
+   */
+  void DropFrameForBusyFrontEnd ();
 
   bool ConfigurePhyForTX ();
 
   void SubBandTimerCallback ();
 
   void OpenRW ();
+  void OpenPingSlot (uint8_t channelIndex, uint8_t dataRateIndex);
   void CloseRW ();
   void CheckPhyPreamble ();
-  void StartAckTimeoutTimer ();
+  /**
+   * \param elapsed the time since the beginning of RW2, which is when the timer starts
+   */
+  void StartAckTimeoutTimer (Time elapsed);
   void AckTimeoutExpired ();
 
+  /**
+   * \return the state to go to when RW2 closes without a frame for this end device
+   */
+  LoRaWANMacState GetStateAfterRW2 () const;
+  bool IsTxPktConfirmed () const;
+  /**
+   * \brief Get the channel and data rate an end device listens on in a receive window
+   */
+  void GetRWConf (LoRaWANMacState window, uint8_t& channelIndex, uint8_t& dataRateIndex) const;
+
+  /**
+   * \return true if the receive windows of the uplink that just ended can be compressed, see ArmRW
+   */
+  bool UseCompressedReceiveWindows () const;
+  /**
+   * \brief Wait for the remaining receive windows without opening them
+   *
+   * Full receive windows cost seven events per uplink: the WAITFORRW1, RW1,
+   * WAITFORRW2, RW2 and IDLE state changes and the two preamble checks.
+   * Compressed windows only cost one, at the time the preamble check of RW2
+   * would run (CloseArmedRW), which goes to IDLE (or ACK_TIMEOUT) right away.
+   * The PHY stays detached and the LoRaWANSpectrumChannel wakes the MAC
+   * (WakeRW) when something is sent on the channel and data rate of a window,
+   * after which the windows are opened and timed as full ones.
+   * The frames received are the same, only the MacState and TrxState traces
+   * (and so the energy models) miss the intermediate states, which is why
+   * the windows are only compressed while nobody is connected to them.
+   */
+  void ArmRW ();
+  void WakeRW ();
+  void CloseArmedRW ();
+
   //void StartTransmission();
   //void EndTransmission();
 private:
@@ -433,6 +518,11 @@ private:
    */
   Ptr<LoRaWANMacRDC> m_lorawanMacRDC;
 
+  /*
+   * The front-end shared with the other MACs of the gateway, if any
+   */
+  Ptr<LoRaWANGatewayFrontEnd> m_frontEnd;
+
   /*
    * Maximum MACPayload size length as per $7.1.6
    */
@@ -454,6 +544,21 @@ private:
    */
   TracedValue<LoRaWANMacState> m_LoRaWANMacState;
 
+  /**
+   * The number of sinks connected to the MacState trace source.
+   */
+  uint32_t m_nMacStateSinks;
+
+  /**
+   * Compress the receive windows when possible, see ArmRW
+   */
+  bool m_compressReceiveWindows;
+
+  /**
+   * The receive windows of the last uplink are compressed
+   */
+  bool m_compressedRW;
+
   /**
    * This callback is used to switch off other MACs and PHYs objects, just prior to when this MAC object starts transmision
    * Only for gateways
@@ -484,12 +589,13 @@ private:
   {
     LoRaWANDataRequestParams lorawanDataRequestParams; //!< Data request Params
     Ptr<Packet> txQPkt;    //!< Queued packet
+    TxQueueElement* m_next; //!< Next element in m_txQueue
   };
 
   /**
-   * The transmit queue used by the MAC.
+   * The transmit queue used by the MAC, its elements are pooled across all MACs.
    */
-  std::deque<TxQueueElement*> m_txQueue;
+  LoRaWANIntrusiveQueue<TxQueueElement> m_txQueue;
 
   /**
    * The packet which is currently being sent by the MAC layer.
@@ -524,12 +630,27 @@ private:
    */
   EventId m_ackTimeOut;
 
+  /**
+   * Scheduler event for the opening of a class B ping slot
+   */
+  EventId m_pingSlotEvent;
+
   /**
    * The Time when the last uplink bit was transmitted
    * Only used in class A end devices for calculating the start of RW1 and RW2
    */
   Time m_lastUplinkBitTime;
 
+  /**
+   * The start of the current or next receive window, from which its preamble check is timed
+   */
+  Time m_rwOpen;
+
+  /**
+   * The time the preamble check of RW1 runs, see ArmRW
+   */
+  Time m_rw1Close;
+
   /**
    * The random variable used to calculate the random fraction of the Ack
    * time-out timer
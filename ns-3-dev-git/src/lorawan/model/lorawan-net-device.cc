@@ -20,6 +20,7 @@
 #include "lorawan.h"
 #include "lorawan-net-device.h"
 #include "lorawan-error-model.h"
+#include "lorawan-phy-config-registry.h"
 #include <ns3/abort.h>
 #include <ns3/assert.h>
 #include <ns3/node.h>
@@ -61,15 +62,26 @@ LoRaWANNetDevice::GetTypeId (void)
                    UintegerValue (1), // default value is one
                    MakeUintegerAccessor (&LoRaWANNetDevice::m_nbRep),
                    MakeUintegerChecker<uint8_t> (1, 15))
+    .AddAttribute ("SharedFrontEnd",
+                   "For gateways: when a MAC transmits, switch the front-end shared by the PHYs "
+                   "instead of switching every other MAC to MAC_UNAVAILABLE and its PHY off. "
+                   "The two modes send different frames: when true, a downlink that finds the "
+                   "front-end taken by another MAC is dropped and reported to the network server; "
+                   "when false, the downlink is held by the unavailable MAC and sent after the "
+                   "transmission, which may be outside its receive window. "
+                   "Set before the device is added to a node.",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&LoRaWANNetDevice::m_sharedFrontEnd),
+                   MakeBooleanChecker ())
   ;
   return tid;
 }
 
-LoRaWANNetDevice::LoRaWANNetDevice () : m_deviceType (LORAWAN_DT_END_DEVICE_CLASS_A), m_configComplete(false)
+LoRaWANNetDevice::LoRaWANNetDevice () : m_deviceType (LORAWAN_DT_END_DEVICE_CLASS_A), m_sharedFrontEnd (true), m_configComplete(false)
 {}
 
 LoRaWANNetDevice::LoRaWANNetDevice (LoRaWANDeviceType deviceType)
-  : m_deviceType (deviceType), m_configComplete (false)
+  : m_deviceType (deviceType), m_sharedFrontEnd (true), m_configComplete (false)
 {
   NS_LOG_FUNCTION (this);
 
@@ -79,16 +91,19 @@ LoRaWANNetDevice::LoRaWANNetDevice (LoRaWANDeviceType deviceType)
     m_mac = CreateObject<LoRaWANMac> (index);
     m_macRDC = CreateObject<LoRaWANMac::LoRaWANMacRDC> ();
   } else if (deviceType == LORAWAN_DT_GATEWAY) {
+    // one phy/mac for every data rate used on a channel of the region, e.g. 8x7 for EU868
     uint8_t index = 0;
     for (uint8_t i = 0; i < LoRaWAN::m_supportedChannels.size (); i++) {
-      for (uint8_t j = 0; j < LoRaWAN::m_supportedDataRates.size (); j++) {
-        index = i*LoRaWAN::m_supportedDataRates.size () + j;
+      const LoRaWANChannel& channel = LoRaWAN::m_supportedChannels[i];
+      m_macsIndexOfChannel.push_back (index);
+      for (uint8_t j = channel.m_minDataRateIndex; j <= channel.m_maxDataRateIndex; j++) {
         Ptr<LoRaWANPhy> phy = CreateObject<LoRaWANPhy> (index);
         Ptr<LoRaWANMac> mac = CreateObject<LoRaWANMac> (index);
-        // index in std::vector is i*LoRaWAN::m_supportedDataRates.size () + j
+        // index in std::vector is m_macsIndexOfChannel[i] + j - m_minDataRateIndex
         // phy and mac belong together
         m_phys.push_back (phy);
         m_macs.push_back (mac);
+        index++;
       }
     }
     m_macRDC = CreateObject<LoRaWANMac::LoRaWANMacRDC> ();
@@ -119,6 +134,7 @@ LoRaWANNetDevice::DoDispose (void)
 
     m_phys.clear ();
     m_macs.clear ();
+    m_frontEnd = 0;
   }
   m_macRDC = 0;
   m_node = 0;
@@ -171,8 +187,7 @@ LoRaWANNetDevice::CompleteConfig (void)
         NS_LOG_WARN ("LoRaWANNetDevice: no Mobility found on the node, probably it's not a good idea.");
       }
     m_phy->SetMobility (mobility);
-    Ptr<LoRaWANErrorModel> model = CreateObject<LoRaWANErrorModel> ();
-    m_phy->SetErrorModel (model);
+    m_phy->SetErrorModel (LoRaWANPhyConfigRegistry::GetErrorModel ());
     m_phy->SetDevice (this);
 
     m_phy->SetPdDataIndicationCallback (MakeCallback (&LoRaWANMac::PdDataIndication, m_mac));
@@ -190,6 +205,8 @@ LoRaWANNetDevice::CompleteConfig (void)
       {
         return;
       }
+    if (m_sharedFrontEnd)
+      m_frontEnd = Create<LoRaWANGatewayFrontEnd> ();
     for (uint8_t i = 0; i < m_macs.size (); i++) {
       Ptr<LoRaWANPhy> phy = m_phys[i];
       Ptr<LoRaWANMac> mac = m_macs[i];
@@ -197,9 +214,14 @@ LoRaWANNetDevice::CompleteConfig (void)
       NS_ASSERT(mac);
 
       // Phy: set channel and data rate for listining (using SetTxConf):
-      uint8_t channelIndex = i / LoRaWAN::m_supportedDataRates.size();
-      uint8_t dataRateIndex = i % LoRaWAN::m_supportedDataRates.size();
-      if (!phy->SetTxConf (2, channelIndex, dataRateIndex, 3, 8, false, true) ) {
+      uint8_t channelIndex = GetChannelIndexOfMac (i);
+      const LoRaWANChannel& channel = LoRaWAN::m_supportedChannels[channelIndex];
+      uint8_t dataRateIndex = channel.m_minDataRateIndex + i - m_macsIndexOfChannel[channelIndex];
+      // the tx power is set per transmission, listen with the lowest power of the sub band when 2dBm is not available
+      int8_t listenPower = 2;
+      if (!LoRaWAN::IsValidTxPower (listenPower))
+        listenPower = LoRaWAN::m_subBands[channel.m_subBandIndex].maxTXPower - 14;
+      if (!phy->SetTxConf (listenPower, channelIndex, dataRateIndex, 3, 8, false, true) ) {
         NS_LOG_ERROR (this << " Phy #" << static_cast<uint16_t>(i) << ": failed setting channelIndex to " << static_cast<uint16_t>(channelIndex) << " and dataRateIndex to " << static_cast<uint16_t>(dataRateIndex));
       }
 
@@ -211,6 +233,10 @@ LoRaWANNetDevice::CompleteConfig (void)
       // Set begin and end tx callbacks (only for gateway)
       mac->SetBeginTxCallback (MakeCallback (&LoRaWANNetDevice::MacBeginsTx, this));
       mac->SetEndTxCallback (MakeCallback (&LoRaWANNetDevice::MacEndsTx, this));
+      if (m_frontEnd) {
+        mac->SetFrontEnd (m_frontEnd);
+        phy->SetFrontEnd (m_frontEnd);
+      }
 
       Ptr<MobilityModel> mobility = m_node->GetObject<MobilityModel> ();
       if (!mobility)
@@ -218,8 +244,7 @@ LoRaWANNetDevice::CompleteConfig (void)
           NS_LOG_WARN ("LoRaWANNetDevice: no Mobility found on the node, probably it's not a good idea.");
         }
       phy->SetMobility (mobility);
-      Ptr<LoRaWANErrorModel> model = CreateObject<LoRaWANErrorModel> ();
-      phy->SetErrorModel (model);
+      phy->SetErrorModel (LoRaWANPhyConfigRegistry::GetErrorModel ());
       phy->SetDevice (this);
 
       phy->SetPdDataIndicationCallback (MakeCallback (&LoRaWANMac::PdDataIndication, mac));
@@ -262,11 +287,15 @@ LoRaWANNetDevice::SetChannel (Ptr<SpectrumChannel> channel)
   if (m_deviceType == LORAWAN_DT_END_DEVICE_CLASS_A) {
     m_phy->SetChannel (channel);
     channel->AddRx (m_phy);
+    // An end device only listens in its receive windows, gateway PHYs always listen
+    m_phy->SetDetachWhenSleeping (true);
   } else if (m_deviceType == LORAWAN_DT_GATEWAY) {
     for (uint8_t i = 0; i < m_phys.size (); i++) {
       Ptr<LoRaWANPhy> phy = m_phys[i];
       phy->SetChannel (channel);
-      channel->AddRx (phy);
+      // PHYs on downlink only channels (e.g. US915 500kHz channels) only transmit
+      if (LoRaWAN::m_supportedChannels[GetChannelIndexOfMac (i)].m_gatewayRx)
+        channel->AddRx (phy);
     }
   } else {
     NS_ASSERT_MSG (0, "Not implemented for non Class A end devices");
@@ -588,18 +617,37 @@ LoRaWANNetDevice::Send (Ptr<Packet> packet, const Address& dest, uint16_t protoc
 bool
 LoRaWANNetDevice::getMACSIndexForChannelAndDataRate (uint8_t& macsIndex, uint8_t channelIndex, uint8_t dataRateIndex)
 {
-  if (channelIndex >= LoRaWAN::m_supportedChannels.size() || dataRateIndex >= LoRaWAN::m_supportedDataRates.size())
+  if (channelIndex >= m_macsIndexOfChannel.size())
+    return false;
+
+  const LoRaWANChannel& channel = LoRaWAN::m_supportedChannels[channelIndex];
+  if (dataRateIndex < channel.m_minDataRateIndex || dataRateIndex > channel.m_maxDataRateIndex)
     return false;
 
-  macsIndex = channelIndex*LoRaWAN::m_supportedDataRates.size() + dataRateIndex;
+  macsIndex = m_macsIndexOfChannel[channelIndex] + dataRateIndex - channel.m_minDataRateIndex;
   return true;
 }
 
+uint8_t
+LoRaWANNetDevice::GetChannelIndexOfMac (uint8_t macsIndex) const
+{
+  NS_ASSERT (macsIndex < m_macs.size ());
+  uint8_t channelIndex = 0;
+  while (static_cast<size_t> (channelIndex) + 1 < m_macsIndexOfChannel.size () && m_macsIndexOfChannel[channelIndex + 1] <= macsIndex)
+    channelIndex++;
+  return channelIndex;
+}
+
 void
 LoRaWANNetDevice::MacBeginsTx (Ptr<LoRaWANMac> macPtr)
 {
   NS_ASSERT (m_deviceType == LORAWAN_DT_GATEWAY);
 
+  if (m_frontEnd) {
+    m_frontEnd->StartTx ();
+    return;
+  }
+
   // Switch all MACs (including macPtr) to MAC_UNAVAILABLE state
   for (uint8_t i = 0; i < m_macs.size (); i++) {
     Ptr<LoRaWANMac> mac = m_macs[i];
@@ -618,6 +666,11 @@ LoRaWANNetDevice::MacEndsTx (Ptr<LoRaWANMac> macPtr)
 {
   NS_ASSERT (m_deviceType == LORAWAN_DT_GATEWAY);
 
+  if (m_frontEnd) {
+    m_frontEnd->EndTx ();
+    return;
+  }
+
   // Switch all MACs and Phys except macPtr to MAC_IDLE state
   for (uint8_t i = 0; i < m_macs.size (); i++) {
     Ptr<LoRaWANMac> mac = m_macs[i];
@@ -640,8 +693,8 @@ LoRaWANNetDevice::CanSendImmediatelyOnChannel (uint8_t channelIndex, uint8_t dat
     if (this->m_macRDC->IsSubBandAvailable (subBandIndex)) {
       uint8_t macIndex = 0;
       if (getMACSIndexForChannelAndDataRate (macIndex, channelIndex, dataRateIndex)) {
-        // step2: check whether MAC object is in Idle state (could be in TX or unavailable)
-        if (this->m_macs[macIndex]->GetLoRaWANMacState () == MAC_IDLE) {
+        // step2: check whether MAC object is in Idle state (could be in TX or unavailable) and the front-end is not transmitting
+        if (this->m_macs[macIndex]->GetLoRaWANMacState () == MAC_IDLE && !(m_frontEnd && m_frontEnd->IsTransmitting ())) {
           // step3: check whether a MAC event is scheduled (MAC state could be scheduled to go to TX state)
           if (!this->m_macs[macIndex]->IsLoRaWANMacStateRunning ()) {
             return true;
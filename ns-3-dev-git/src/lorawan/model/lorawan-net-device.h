@@ -25,6 +25,7 @@
 #include <ns3/lorawan-phy.h>
 #include <ns3/lorawan-mac.h>
 #include <ns3/lorawan.h>
+#include <ns3/lorawan-gateway-front-end.h>
 
 namespace ns3 {
 
@@ -127,6 +128,12 @@ public:
   void SetMTUSpreadingFactor (LoRaSpreadingFactor sf) { this->m_mtuSpreadingFactor = sf; }
   LoRaSpreadingFactor GetMTUSpreadingFactor () { return this->m_mtuSpreadingFactor; }
 
+  /**
+   * \brief Set the number of transmissions of unconfirmed uplinks (NbTrans of LinkADRReq)
+   */
+  void SetNbRep (uint8_t nbRep) { NS_ASSERT (nbRep >= 1 && nbRep <= 15); this->m_nbRep = nbRep; }
+  uint8_t GetNbRep () const { return this->m_nbRep; }
+
 private:
   // Inherited from NetDevice/Object
   virtual void DoDispose (void);
@@ -155,6 +162,11 @@ private:
    */
   void CompleteConfig (void);
 
+  /**
+   * \return the channel a gateway mac/phy listens on
+   */
+  uint8_t GetChannelIndexOfMac (uint8_t macsIndex) const;
+
   Ptr<Node> m_node;
   // For end device: One phy/mac
   Ptr<LoRaWANPhy> m_phy;
@@ -162,10 +174,19 @@ private:
   // For gateways: multiple phys/macs (note one mac per phy)
   std::vector<Ptr<LoRaWANPhy> > m_phys;
   std::vector<Ptr<LoRaWANMac> > m_macs;
+  // For gateways: index in m_macs of the mac for the lowest data rate of every channel
+  std::vector<uint8_t> m_macsIndexOfChannel;
 
   Ptr<LoRaWANMac::LoRaWANMacRDC> m_macRDC;
   LoRaWANDeviceType m_deviceType;
 
+  /**
+   * For gateways: switch the shared front-end instead of every MAC and PHY
+   * when a MAC transmits, see LoRaWANGatewayFrontEnd.
+   */
+  bool m_sharedFrontEnd;
+  Ptr<LoRaWANGatewayFrontEnd> m_frontEnd;
+
   /**
    * True if MAC, PHY and CSMA/CA where successfully configured and the
    * NetDevice is ready for being used.
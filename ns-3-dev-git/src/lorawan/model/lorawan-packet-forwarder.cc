@@ -0,0 +1,534 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+
+#include "lorawan-packet-forwarder.h"
+#include "lorawan.h"
+#include "lorawan-mac-header.h"
+#include "lorawan-gateway-application.h"
+#include <ns3/log.h>
+#include <ns3/simulator.h>
+#include <ns3/node.h>
+#include <ns3/uinteger.h>
+#include <ns3/integer.h>
+#include <ns3/trace-source-accessor.h>
+
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("LoRaWANPacketForwarder");
+
+NS_OBJECT_ENSURE_REGISTERED (LoRaWANPacketForwarder);
+
+namespace {
+
+const char g_base64Alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/**
+ * Find the value of a field in a JSON object without nested objects of the
+ * same name, returning strings without their quotes
+ */
+bool
+GetJsonValue (const std::string& json, const std::string& field, std::string& value)
+{
+  const std::string key = "\"" + field + "\"";
+  std::string::size_type pos = json.find (key);
+  if (pos == std::string::npos)
+    return false;
+  pos = json.find_first_not_of (" \t\r\n", pos + key.size ());
+  if (pos == std::string::npos || json[pos] != ':')
+    return false;
+  pos = json.find_first_not_of (" \t\r\n", pos + 1);
+  if (pos == std::string::npos)
+    return false;
+
+  std::string::size_type end;
+  if (json[pos] == '"') {
+    pos++;
+    end = json.find ('"', pos);
+  } else {
+    end = json.find_first_of (",}] \t\r\n", pos);
+  }
+  if (end == std::string::npos)
+    return false;
+  value = json.substr (pos, end - pos);
+  return true;
+}
+
+} // unnamed namespace
+
+FdReader::Data
+LoRaWANPacketForwarderFdReader::DoRead (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  const uint32_t bufferSize = 65536;
+  uint8_t* buf = (uint8_t*)std::malloc (bufferSize);
+  NS_ABORT_MSG_IF (buf == 0, "malloc() failed");
+
+  ssize_t len = recv (m_fd, buf, bufferSize, 0);
+  if (len <= 0) {
+    // a connected UDP socket reports ICMP errors of earlier datagrams, e.g.
+    // while the server is not running yet, which should not stop the reader
+    const bool closed = len == 0 || (errno != ECONNREFUSED && errno != EINTR && errno != EAGAIN);
+    NS_LOG_INFO ("LoRaWANPacketForwarderFdReader::DoRead(): " << (closed ? "done" : std::strerror (errno)));
+    std::free (buf);
+    return FdReader::Data (0, closed ? 0 : -1);
+  }
+
+  return FdReader::Data (buf, len);
+}
+
+TypeId
+LoRaWANPacketForwarder::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::LoRaWANPacketForwarder")
+    .SetParent<Object> ()
+    .SetGroupName ("LoRaWAN")
+    .AddConstructor<LoRaWANPacketForwarder> ()
+    .AddAttribute ("ServerAddress",
+                   "The IPv4 address of the network server",
+                   Ipv4AddressValue (Ipv4Address::GetLoopback ()),
+                   MakeIpv4AddressAccessor (&LoRaWANPacketForwarder::m_serverAddress),
+                   MakeIpv4AddressChecker ())
+    .AddAttribute ("ServerPort",
+                   "The UDP port of the network server",
+                   UintegerValue (1700),
+                   MakeUintegerAccessor (&LoRaWANPacketForwarder::m_serverPort),
+                   MakeUintegerChecker<uint16_t> ())
+    .AddAttribute ("GatewayEui",
+                   "The EUI of the gateway, 0 to use the node id of the gateway",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&LoRaWANPacketForwarder::m_gatewayEui),
+                   MakeUintegerChecker<uint64_t> ())
+    .AddAttribute ("MaxBatchSize",
+                   "The maximum number of rxpk in a PUSH_DATA datagram",
+                   UintegerValue (16),
+                   MakeUintegerAccessor (&LoRaWANPacketForwarder::m_maxBatchSize),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("BatchInterval",
+                   "The longest time an uplink waits for other uplinks to be sent in the same PUSH_DATA datagram",
+                   TimeValue (MilliSeconds (10)),
+                   MakeTimeAccessor (&LoRaWANPacketForwarder::m_batchInterval),
+                   MakeTimeChecker (Seconds (0)))
+    .AddAttribute ("PullInterval",
+                   "The time between PULL_DATA datagrams, which keep the downlink path to the gateway open",
+                   TimeValue (Seconds (5)),
+                   MakeTimeAccessor (&LoRaWANPacketForwarder::m_pullInterval),
+                   MakeTimeChecker (MilliSeconds (1)))
+    .AddAttribute ("Rssi",
+                   "The RSSI in dBm reported for every uplink, as the PHY does not model it",
+                   IntegerValue (-100),
+                   MakeIntegerAccessor (&LoRaWANPacketForwarder::m_rssi),
+                   MakeIntegerChecker<int> ())
+    .AddTraceSource ("PushData",
+                     "A PUSH_DATA datagram has been sent, with the number of rxpk in it",
+                     MakeTraceSourceAccessor (&LoRaWANPacketForwarder::m_pushDataTrace),
+                     "ns3::TracedValueCallback::Uint32")
+    .AddTraceSource ("Downlink",
+                     "The txpk of a PULL_RESP datagram is handed to the gateway for transmission",
+                     MakeTraceSourceAccessor (&LoRaWANPacketForwarder::m_downlinkTrace),
+                     "ns3::Packet::TracedCallback")
+  ;
+  return tid;
+}
+
+LoRaWANPacketForwarder::LoRaWANPacketForwarder ()
+  : m_context (0),
+    m_socket (-1),
+    m_token (0),
+    m_batchSize (0),
+    m_nUplinks (0),
+    m_nDownlinks (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+LoRaWANPacketForwarder::~LoRaWANPacketForwarder ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+LoRaWANPacketForwarder::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  if (m_batchSize > 0 && m_socket >= 0)
+    SendPushData ();
+  m_batchEvent.Cancel ();
+  m_pullEvent.Cancel ();
+
+  if (m_fdReader) {
+    m_fdReader->Stop ();
+    m_fdReader = 0;
+  }
+  if (m_socket >= 0) {
+    close (m_socket);
+    m_socket = -1;
+  }
+
+  if (m_gateway) {
+    NS_LOG_INFO (this << " forwarded " << m_nUplinks << " uplinks and " << m_nDownlinks << " downlinks");
+    m_gateway->SetUplinkCallback (MakeNullCallback<void, Ptr<Packet> > ());
+    m_gateway = 0;
+  }
+  Object::DoDispose ();
+}
+
+bool
+LoRaWANPacketForwarder::Install (Ptr<LoRaWANGatewayApplication> gateway)
+{
+  NS_LOG_FUNCTION (this << gateway);
+  NS_ASSERT_MSG (!m_gateway, "A packet forwarder serves a single gateway");
+
+  m_socket = socket (AF_INET, SOCK_DGRAM, 0);
+  if (m_socket < 0) {
+    NS_LOG_ERROR (this << " Unable to create UDP socket: " << std::strerror (errno));
+    return false;
+  }
+
+  struct sockaddr_in server;
+  std::memset (&server, 0, sizeof (server));
+  server.sin_family = AF_INET;
+  server.sin_port = htons (m_serverPort);
+  server.sin_addr.s_addr = htonl (m_serverAddress.Get ());
+  // connected, so that only datagrams of the server are received
+  if (connect (m_socket, (struct sockaddr*)&server, sizeof (server)) < 0) {
+    NS_LOG_ERROR (this << " Unable to connect UDP socket to " << m_serverAddress << ":" << m_serverPort << ": " << std::strerror (errno));
+    close (m_socket);
+    m_socket = -1;
+    return false;
+  }
+
+  m_gateway = gateway;
+  m_context = gateway->GetNode ()->GetId ();
+  if (m_gatewayEui == 0)
+    m_gatewayEui = m_context;
+  m_gateway->SetUplinkCallback (MakeCallback (&LoRaWANPacketForwarder::ForwardUplink, this));
+
+  m_fdReader = Create<LoRaWANPacketForwarderFdReader> ();
+  m_fdReader->Start (m_socket, MakeCallback (&LoRaWANPacketForwarder::ReadCallback, this));
+
+  // in the context of the gateway, as Install may be called before Simulator::Run
+  Simulator::ScheduleWithContext (m_context, Seconds (0), &LoRaWANPacketForwarder::SendPullData, this);
+  return true;
+}
+
+uint64_t
+LoRaWANPacketForwarder::GetGatewayEui (void) const
+{
+  return m_gatewayEui;
+}
+
+void
+LoRaWANPacketForwarder::ForwardUplink (Ptr<Packet> packet)
+{
+  NS_LOG_FUNCTION (this << packet);
+
+  const uint32_t tmst = (uint32_t)Simulator::Now ().GetMicroSeconds ();
+  if (m_batchSize > 0)
+    m_batch += ",";
+  m_batch += EncodeRxpk (packet, tmst, m_rssi);
+  m_batchSize++;
+  m_nUplinks++;
+
+  if (m_batchSize >= m_maxBatchSize) {
+    m_batchEvent.Cancel ();
+    SendPushData ();
+  } else if (!m_batchEvent.IsRunning ()) {
+    m_batchEvent = Simulator::Schedule (m_batchInterval, &LoRaWANPacketForwarder::SendPushData, this);
+  }
+}
+
+void
+LoRaWANPacketForwarder::SendPushData (void)
+{
+  NS_LOG_FUNCTION (this << m_batchSize);
+
+  if (m_batchSize == 0)
+    return;
+
+  SendDatagram (PUSH_DATA, m_token++, "{\"rxpk\":[" + m_batch + "]}", true);
+  m_pushDataTrace (m_batchSize);
+  m_batch.clear ();
+  m_batchSize = 0;
+}
+
+void
+LoRaWANPacketForwarder::SendPullData (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (m_socket < 0)
+    return; // disposed
+
+  SendDatagram (PULL_DATA, m_token++, "", true);
+  m_pullEvent = Simulator::Schedule (m_pullInterval, &LoRaWANPacketForwarder::SendPullData, this);
+}
+
+void
+LoRaWANPacketForwarder::SendDatagram (uint8_t identifier, uint16_t token, const std::string& json, bool withEui)
+{
+  std::string datagram;
+  datagram.reserve (12 + json.size ());
+  datagram += (char)LORAWAN_SEMTECH_UDP_VERSION;
+  datagram += (char)(token >> 8);
+  datagram += (char)(token & 0xff);
+  datagram += (char)identifier;
+  if (withEui) {
+    for (int shift = 56; shift >= 0; shift -= 8)
+      datagram += (char)((m_gatewayEui >> shift) & 0xff);
+  }
+  datagram += json;
+
+  if (send (m_socket, datagram.data (), datagram.size (), 0) < 0)
+    NS_LOG_WARN (this << " Unable to send datagram " << (unsigned)identifier << " to the network server: " << std::strerror (errno));
+}
+
+void
+LoRaWANPacketForwarder::ReadCallback (uint8_t* buf, ssize_t len)
+{
+  // Called in the reader thread: copy and handle the datagram in the simulation
+  std::string datagram ((const char*)buf, len);
+  std::free (buf);
+  Simulator::ScheduleWithContext (m_context, Seconds (0), &LoRaWANPacketForwarder::HandleDatagram, this, datagram);
+}
+
+void
+LoRaWANPacketForwarder::HandleDatagram (std::string datagram)
+{
+  NS_LOG_FUNCTION (this << datagram.size ());
+
+  if (datagram.size () < 4 || datagram[0] != LORAWAN_SEMTECH_UDP_VERSION) {
+    NS_LOG_WARN (this << " Ignoring datagram that is not of version " << LORAWAN_SEMTECH_UDP_VERSION << " of the Semtech UDP protocol");
+    return;
+  }
+
+  const uint16_t token = ((uint8_t)datagram[1] << 8) | (uint8_t)datagram[2];
+  const uint8_t identifier = datagram[3];
+  if (identifier == PUSH_ACK || identifier == PULL_ACK) {
+    NS_LOG_LOGIC (this << " Received ack " << (unsigned)identifier << " for token " << token);
+    return;
+  } else if (identifier != PULL_RESP) {
+    NS_LOG_WARN (this << " Ignoring datagram with identifier " << (unsigned)identifier);
+    return;
+  }
+
+  bool immediate;
+  uint32_t tmst;
+  Ptr<Packet> packet = DecodeTxpk (datagram.substr (4), immediate, tmst);
+  if (!packet) {
+    NS_LOG_ERROR (this << " Unable to decode txpk of PULL_RESP");
+    SendDatagram (TX_ACK, token, "{\"txpk_ack\":{\"error\":\"TX_FREQ\"}}", true);
+    return;
+  }
+
+  Time delay = Seconds (0);
+  if (!immediate) {
+    // tmst wraps around every 71 minutes, so compare it to the current tmst as a signed difference
+    const int32_t difference = (int32_t)(tmst - (uint32_t)Simulator::Now ().GetMicroSeconds ());
+    if (difference < 0) {
+      NS_LOG_WARN (this << " Downlink for tmst " << tmst << " arrived " << -difference << " us too late");
+      SendDatagram (TX_ACK, token, "{\"txpk_ack\":{\"error\":\"TOO_LATE\"}}", true);
+      return;
+    }
+    delay = MicroSeconds (difference);
+  }
+
+  SendDatagram (TX_ACK, token, "{\"txpk_ack\":{\"error\":\"NONE\"}}", true);
+  Simulator::Schedule (delay, &LoRaWANPacketForwarder::SendDownlink, this, packet);
+}
+
+void
+LoRaWANPacketForwarder::SendDownlink (Ptr<Packet> packet)
+{
+  NS_LOG_FUNCTION (this << packet);
+  if (!m_gateway)
+    return;
+
+  m_nDownlinks++;
+  m_downlinkTrace (packet);
+  m_gateway->SendDSPacket (packet);
+}
+
+std::string
+LoRaWANPacketForwarder::EncodeRxpk (Ptr<const Packet> packet, uint32_t tmst, int rssi)
+{
+  LoRaWANPhyParamsTag phyParamsTag;
+  if (!packet->PeekPacketTag (phyParamsTag))
+    NS_LOG_WARN ("LoRaWANPhyParamsTag not found on uplink, assuming channel 0 and data rate 0");
+  LoRaWANMsgType msgType = LORAWAN_UNCONFIRMED_DATA_UP;
+  LoRaWANMsgTypeTag msgTypeTag;
+  if (packet->PeekPacketTag (msgTypeTag))
+    msgType = msgTypeTag.GetMsgType ();
+
+  // PHYPayload: MAC header, MACPayload and the MIC, which is not modelled and left zero
+  Ptr<Packet> phyPayload = packet->Copy ();
+  phyPayload->AddHeader (LoRaWANMacHeader (msgType, 0));
+  std::vector<uint8_t> data (phyPayload->GetSize () + 4, 0);
+  phyPayload->CopyData (data.data (), phyPayload->GetSize ());
+
+  const LoRaWANChannel& channel = LoRaWAN::m_supportedChannels[phyParamsTag.GetChannelIndex ()];
+  const LoRaWANDataRate& dataRate = LoRaWAN::m_supportedDataRates[phyParamsTag.GetDataRateIndex ()];
+
+  std::ostringstream os;
+  os << std::fixed
+     << "{\"tmst\":" << tmst
+     << ",\"chan\":" << (unsigned)phyParamsTag.GetChannelIndex ()
+     << ",\"rfch\":0"
+     << ",\"freq\":" << std::setprecision (6) << channel.m_fc / 1e6
+     << ",\"stat\":1,\"modu\":\"LORA\""
+     << ",\"datr\":\"SF" << (unsigned)dataRate.spreadingFactor << "BW" << dataRate.bandWith / 1000 << "\""
+     << ",\"codr\":\"4/" << 4 + (unsigned)phyParamsTag.GetCodeRate () << "\""
+     << ",\"rssi\":" << rssi
+     << ",\"lsnr\":" << std::setprecision (1) << phyParamsTag.GetSinrAvg ()
+     << ",\"size\":" << data.size ()
+     << ",\"data\":\"" << EncodeBase64 (data.data (), data.size ()) << "\"}";
+  return os.str ();
+}
+
+Ptr<Packet>
+LoRaWANPacketForwarder::DecodeTxpk (const std::string& json, bool& immediate, uint32_t& tmst)
+{
+  std::string::size_type start = json.find ("\"txpk\"");
+  if (start == std::string::npos)
+    return 0;
+  const std::string txpk = json.substr (start);
+
+  std::string value;
+  immediate = GetJsonValue (txpk, "imme", value) && value == "true";
+  tmst = 0;
+  if (!immediate) {
+    if (!GetJsonValue (txpk, "tmst", value))
+      return 0;
+    tmst = std::strtoul (value.c_str (), 0, 10);
+  }
+
+  // channel with the frequency closest to freq
+  if (!GetJsonValue (txpk, "freq", value))
+    return 0;
+  const double freq = std::atof (value.c_str ()) * 1e6;
+  uint8_t channelIndex = 0;
+  for (uint8_t i = 1; i < LoRaWAN::m_supportedChannels.size (); i++) {
+    if (std::fabs (LoRaWAN::m_supportedChannels[i].m_fc - freq) < std::fabs (LoRaWAN::m_supportedChannels[channelIndex].m_fc - freq))
+      channelIndex = i;
+  }
+  if (std::fabs (LoRaWAN::m_supportedChannels[channelIndex].m_fc - freq) > 1e3) {
+    NS_LOG_WARN ("No channel at frequency " << freq << " Hz");
+    return 0;
+  }
+
+  // datr is SF<spreading factor>BW<bandwidth in kHz>
+  unsigned sf, bw;
+  if (!GetJsonValue (txpk, "datr", value) || std::sscanf (value.c_str (), "SF%uBW%u", &sf, &bw) != 2)
+    return 0;
+  // the data rates of the channel only, e.g. SF8BW500 is DR12 on a US915 downlink channel, not DR4
+  const LoRaWANChannel& channel = LoRaWAN::m_supportedChannels[channelIndex];
+  uint8_t dataRateIndex = LoRaWAN::m_supportedDataRates.size ();
+  for (uint8_t i = channel.m_minDataRateIndex; i <= channel.m_maxDataRateIndex && i < LoRaWAN::m_supportedDataRates.size (); i++) {
+    if ((unsigned)LoRaWAN::m_supportedDataRates[i].spreadingFactor == sf && LoRaWAN::m_supportedDataRates[i].bandWith == bw * 1000) {
+      dataRateIndex = i;
+      break;
+    }
+  }
+  if (dataRateIndex == LoRaWAN::m_supportedDataRates.size ()) {
+    NS_LOG_WARN ("Unsupported data rate " << value);
+    return 0;
+  }
+
+  uint8_t codeRate = 1;
+  unsigned denominator;
+  if (GetJsonValue (txpk, "codr", value) && std::sscanf (value.c_str (), "4/%u", &denominator) == 1
+      && denominator >= 5 && denominator <= 8)
+    codeRate = denominator - 4;
+
+  std::string data;
+  if (!GetJsonValue (txpk, "data", value) || !DecodeBase64 (value, data) || data.size () < 5)
+    return 0;
+
+  Ptr<Packet> packet = Create<Packet> ((const uint8_t*)data.data (), data.size ());
+  LoRaWANMacHeader macHeader;
+  packet->RemoveHeader (macHeader);
+  packet->RemoveAtEnd (4); // MIC, added again by the gateway MAC
+
+  LoRaWANPhyParamsTag phyParamsTag;
+  phyParamsTag.SetChannelIndex (channelIndex);
+  phyParamsTag.SetDataRateIndex (dataRateIndex);
+  phyParamsTag.SetCodeRate (codeRate);
+  phyParamsTag.SetSinrAvg (0);
+  phyParamsTag.SetTxPowerIndex (0); // the gateway uses its maximum tx power, as for downlinks of the NS
+  packet->AddPacketTag (phyParamsTag);
+
+  LoRaWANMsgTypeTag msgTypeTag;
+  msgTypeTag.SetMsgType (macHeader.getLoRaWANMsgType ());
+  packet->AddPacketTag (msgTypeTag);
+  return packet;
+}
+
+std::string
+LoRaWANPacketForwarder::EncodeBase64 (const uint8_t* data, uint32_t size)
+{
+  std::string text;
+  text.reserve ((size + 2) / 3 * 4);
+  for (uint32_t i = 0; i < size; i += 3) {
+    const uint32_t n = (data[i] << 16) | ((i + 1 < size ? data[i + 1] : 0) << 8) | (i + 2 < size ? data[i + 2] : 0);
+    text += g_base64Alphabet[(n >> 18) & 0x3f];
+    text += g_base64Alphabet[(n >> 12) & 0x3f];
+    text += i + 1 < size ? g_base64Alphabet[(n >> 6) & 0x3f] : '=';
+    text += i + 2 < size ? g_base64Alphabet[n & 0x3f] : '=';
+  }
+  return text;
+}
+
+bool
+LoRaWANPacketForwarder::DecodeBase64 (const std::string& text, std::string& data)
+{
+  data.clear ();
+  uint32_t n = 0;
+  uint32_t bits = 0;
+  for (char c : text) {
+    if (c == '=')
+      break;
+    const char* p = std::strchr (g_base64Alphabet, c);
+    if (p == 0 || c == '\0')
+      return false;
+    n = (n << 6) | (p - g_base64Alphabet);
+    bits += 6;
+    if (bits >= 8) {
+      bits -= 8;
+      data += (char)((n >> bits) & 0xff);
+    }
+  }
+  return true;
+}
+
+} // namespace ns3
@@ -0,0 +1,187 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+
+#ifndef LORAWAN_PACKET_FORWARDER_H
+#define LORAWAN_PACKET_FORWARDER_H
+
+#include <ns3/object.h>
+#include <ns3/nstime.h>
+#include <ns3/event-id.h>
+#include <ns3/ipv4-address.h>
+#include <ns3/packet.h>
+#include <ns3/traced-callback.h>
+#include <ns3/unix-fd-reader.h>
+
+#include <string>
+
+#define LORAWAN_SEMTECH_UDP_VERSION 2
+
+namespace ns3 {
+
+class LoRaWANGatewayApplication;
+
+/**
+ * \ingroup lorawan
+ *
+ * Reads the datagrams of the network server from the UDP socket of a
+ * LoRaWANPacketForwarder in a separate thread
+ */
+class LoRaWANPacketForwarderFdReader : public FdReader
+{
+private:
+  FdReader::Data DoRead (void);
+};
+
+/**
+ * \ingroup lorawan
+ *
+ * Bridge between a simulated gateway and a real network server, using the
+ * Semtech UDP packet forwarder protocol (version 2).
+ *
+ * Once installed on a LoRaWANGatewayApplication, uplinks received by the
+ * gateway are no longer handed to the in-process LoRaWANNetworkServer but
+ * encoded as rxpk objects and sent to ServerAddress:ServerPort in PUSH_DATA
+ * datagrams. Up to MaxBatchSize rxpk are sent in one datagram, a batch is
+ * sent when it is full or BatchInterval after its first rxpk. PULL_DATA
+ * datagrams are sent every PullInterval so that the server can reach the
+ * gateway, PULL_RESP datagrams from the server are decoded and their txpk is
+ * transmitted by the gateway, immediately or at its tmst, and answered with
+ * a TX_ACK.
+ *
+ * The tmst of the gateway is the simulation time in microseconds, modulo
+ * 2^32. As the PHY does not model the received signal strength, rxpk carry
+ * the SNR of the uplink in lsnr and a fixed RSSI (Rssi attribute). MICs are
+ * not modelled either: the MIC of an uplink is zero and that of a downlink
+ * is ignored.
+ *
+ * Datagrams from the network server are read in a separate thread and
+ * handled in the simulation through Simulator::ScheduleWithContext, so the
+ * bridge is meant to run under RealtimeSimulatorImpl:
+ * \code
+ *   GlobalValue::Bind ("SimulatorImplementationType", StringValue ("ns3::RealtimeSimulatorImpl"));
+ *   Ptr<LoRaWANPacketForwarder> forwarder = CreateObject<LoRaWANPacketForwarder> ();
+ *   forwarder->SetAttribute ("ServerPort", UintegerValue (1700));
+ *   forwarder->Install (gatewayApp);
+ * \endcode
+ * A forwarder serves a single gateway.
+ */
+class LoRaWANPacketForwarder : public Object
+{
+public:
+  /** Identifiers of the datagrams of the Semtech UDP protocol */
+  enum Identifier
+  {
+    PUSH_DATA = 0x00,
+    PUSH_ACK = 0x01,
+    PULL_DATA = 0x02,
+    PULL_RESP = 0x03,
+    PULL_ACK = 0x04,
+    TX_ACK = 0x05
+  };
+
+  static TypeId GetTypeId (void);
+
+  LoRaWANPacketForwarder ();
+  virtual ~LoRaWANPacketForwarder ();
+
+  /**
+   * \brief Forward the uplinks of a gateway to the network server and transmit its downlinks
+   *
+   * Opens the UDP socket. The gateway EUI defaults to the node id of the
+   * gateway when the GatewayEui attribute is not set.
+   *
+   * \return false when the socket could not be opened
+   */
+  bool Install (Ptr<LoRaWANGatewayApplication> gateway);
+
+  /**
+   * \brief Add an uplink received by the gateway to the current PUSH_DATA batch
+   * \param packet the MACPayload of the uplink, with LoRaWANPhyParamsTag and LoRaWANMsgTypeTag
+   */
+  void ForwardUplink (Ptr<Packet> packet);
+
+  /**
+   * \brief Handle a datagram received from the network server
+   */
+  void HandleDatagram (std::string datagram);
+
+  uint64_t GetGatewayEui (void) const;
+
+  /**
+   * \brief Encode an uplink as an rxpk JSON object
+   * \param packet the MACPayload of the uplink, with LoRaWANPhyParamsTag and LoRaWANMsgTypeTag
+   * \param tmst the gateway timestamp of the end of the reception
+   * \param rssi the RSSI to report, in dBm
+   */
+  static std::string EncodeRxpk (Ptr<const Packet> packet, uint32_t tmst, int rssi);
+
+  /**
+   * \brief Decode the txpk JSON object of a PULL_RESP
+   * \param json the JSON of the PULL_RESP
+   * \param immediate set when the downlink should be sent right away
+   * \param tmst set to the gateway timestamp at which the downlink should be sent
+   * \return the MACPayload of the downlink with LoRaWANPhyParamsTag and
+   * LoRaWANMsgTypeTag, or 0 when the txpk is invalid
+   */
+  static Ptr<Packet> DecodeTxpk (const std::string& json, bool& immediate, uint32_t& tmst);
+
+  static std::string EncodeBase64 (const uint8_t* data, uint32_t size);
+  static bool DecodeBase64 (const std::string& text, std::string& data);
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  void SendPushData (void);
+  void SendPullData (void);
+  void SendDatagram (uint8_t identifier, uint16_t token, const std::string& json, bool withEui);
+  void ReadCallback (uint8_t* buf, ssize_t len);
+  void SendDownlink (Ptr<Packet> packet);
+
+  Ptr<LoRaWANGatewayApplication> m_gateway;
+  uint32_t m_context;  //!< node id of the gateway
+
+  Ipv4Address m_serverAddress;
+  uint16_t m_serverPort;
+  uint64_t m_gatewayEui;
+  uint32_t m_maxBatchSize;
+  Time m_batchInterval;
+  Time m_pullInterval;
+  int m_rssi;
+
+  int m_socket;
+  Ptr<LoRaWANPacketForwarderFdReader> m_fdReader;
+  uint16_t m_token;
+
+  std::string m_batch;  //!< comma separated rxpk objects of the next PUSH_DATA
+  uint32_t m_batchSize;
+  EventId m_batchEvent;
+  EventId m_pullEvent;
+
+  uint64_t m_nUplinks;
+  uint64_t m_nDownlinks;
+
+  TracedCallback<uint32_t> m_pushDataTrace;  //!< number of rxpk in a PUSH_DATA that was sent
+  TracedCallback<Ptr<const Packet> > m_downlinkTrace;
+};
+
+} // namespace ns3
+
+#endif /* LORAWAN_PACKET_FORWARDER_H */
@@ -0,0 +1,144 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+
+#include "lorawan-phy-config-registry.h"
+#include "lorawan.h"
+#include "lorawan-error-model.h"
+#include "lorawan-spectrum-value-helper.h"
+#include <ns3/log.h>
+#include <ns3/simulator.h>
+#include <ns3/spectrum-value.h>
+
+#include <map>
+#include <utility>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("LoRaWANPhyConfigRegistry");
+
+namespace {
+
+struct Registry
+{
+  Registry () : m_destroyScheduled (false) {}
+
+  bool m_destroyScheduled;
+  Ptr<LoRaWANErrorModel> m_errorModel;
+  std::map<std::pair<double, uint32_t>, Ptr<const SpectrumValue> > m_txPsds;
+  std::map<double, Ptr<const SpectrumValue> > m_noisePsds;
+};
+
+Registry&
+GetStorage (void)
+{
+  static Registry registry;
+  return registry;
+}
+
+void
+DestroyRegistry (void)
+{
+  LoRaWANPhyConfigRegistry::Clear ();
+  GetStorage ().m_destroyScheduled = false;
+}
+
+// Clear may also be called while the destroy event is pending (e.g. when the
+// region changes), so only the destroy event itself resets the flag
+Registry&
+GetRegistry (void)
+{
+  Registry& registry = GetStorage ();
+  if (!registry.m_destroyScheduled)
+    {
+      registry.m_destroyScheduled = true;
+      Simulator::ScheduleDestroy (&DestroyRegistry);
+    }
+  return registry;
+}
+
+} // unnamed namespace
+
+Ptr<LoRaWANErrorModel>
+LoRaWANPhyConfigRegistry::GetErrorModel (void)
+{
+  Registry& registry = GetRegistry ();
+  if (registry.m_errorModel == 0)
+    {
+      NS_LOG_LOGIC ("creating the shared error model");
+      registry.m_errorModel = CreateObject<LoRaWANErrorModel> ();
+    }
+  return registry.m_errorModel;
+}
+
+Ptr<const SpectrumValue>
+LoRaWANPhyConfigRegistry::GetTxPowerSpectralDensity (double txPower, uint32_t freq)
+{
+  Registry& registry = GetRegistry ();
+  std::pair<double, uint32_t> key (txPower, freq);
+  std::map<std::pair<double, uint32_t>, Ptr<const SpectrumValue> >::const_iterator it = registry.m_txPsds.find (key);
+  if (it != registry.m_txPsds.end ())
+    {
+      return it->second;
+    }
+
+  NS_LOG_LOGIC ("creating the shared TX PSD for " << txPower << " dBm at " << freq << " Hz");
+  LoRaWANSpectrumValueHelper psdHelper;
+  Ptr<const SpectrumValue> psd = psdHelper.CreateTxPowerSpectralDensity (txPower, freq);
+  registry.m_txPsds[key] = psd;
+  return psd;
+}
+
+Ptr<const SpectrumValue>
+LoRaWANPhyConfigRegistry::GetNoisePowerSpectralDensity (double noiseFactor)
+{
+  Registry& registry = GetRegistry ();
+  std::map<double, Ptr<const SpectrumValue> >::const_iterator it = registry.m_noisePsds.find (noiseFactor);
+  if (it != registry.m_noisePsds.end ())
+    {
+      return it->second;
+    }
+
+  NS_LOG_LOGIC ("creating the shared noise PSD for noise factor " << noiseFactor);
+  LoRaWANSpectrumValueHelper psdHelper;
+  psdHelper.UpdateNoiseFactor (noiseFactor);
+  // the noise PSD covers all channels, the frequency is not used
+  Ptr<const SpectrumValue> psd = psdHelper.CreateNoisePowerSpectralDensity (LoRaWAN::m_supportedChannels [0].m_fc);
+  registry.m_noisePsds[noiseFactor] = psd;
+  return psd;
+}
+
+uint32_t
+LoRaWANPhyConfigRegistry::GetNPowerSpectralDensities (void)
+{
+  Registry& registry = GetRegistry ();
+  return registry.m_txPsds.size () + registry.m_noisePsds.size ();
+}
+
+void
+LoRaWANPhyConfigRegistry::Clear (void)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+  Registry& registry = GetStorage ();
+  registry.m_errorModel = 0;
+  registry.m_txPsds.clear ();
+  registry.m_noisePsds.clear ();
+}
+
+} // namespace ns3
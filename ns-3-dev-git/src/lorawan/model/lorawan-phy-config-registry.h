@@ -0,0 +1,84 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+
+#ifndef LORAWAN_PHY_CONFIG_REGISTRY_H
+#define LORAWAN_PHY_CONFIG_REGISTRY_H
+
+#include <ns3/ptr.h>
+
+namespace ns3 {
+
+class SpectrumValue;
+class LoRaWANErrorModel;
+
+/**
+ * \ingroup lorawan
+ *
+ * \brief Hands out shared instances of the immutable configuration of
+ * LoRaWAN PHYs
+ *
+ * Every PHY used to create its own LoRaWANErrorModel, noise PSD and TX PSD,
+ * although they only depend on a few parameters: a gateway has a PHY for
+ * every channel and data rate, all with identical copies. The registry
+ * creates an instance for every distinct set of parameters and hands out
+ * the same instance to every caller asking for these parameters.
+ *
+ * The instances must not be modified. Spectrum channels copy the signal
+ * parameters of a transmission, including its PSD, before applying the
+ * propagation loss, so a shared TX PSD can be handed to a channel.
+ *
+ * The registry is emptied when the simulator is destroyed; instances still
+ * held by PHYs stay valid.
+ */
+class LoRaWANPhyConfigRegistry
+{
+public:
+  /**
+   * \return the error model shared by all PHYs
+   */
+  static Ptr<LoRaWANErrorModel> GetErrorModel (void);
+
+  /**
+   * \param txPower the transmission power in dBm
+   * \param freq the center frequency of the channel in Hz
+   * \return the shared TX PSD for the given power and channel
+   */
+  static Ptr<const SpectrumValue> GetTxPowerSpectralDensity (double txPower, uint32_t freq);
+
+  /**
+   * \param noiseFactor the noise factor of the receiver (linear)
+   * \return the shared noise PSD for the given noise factor
+   */
+  static Ptr<const SpectrumValue> GetNoisePowerSpectralDensity (double noiseFactor);
+
+  /**
+   * \return the number of distinct PSDs in the registry
+   */
+  static uint32_t GetNPowerSpectralDensities (void);
+
+  /**
+   * \brief Forget all instances, later calls create new ones
+   */
+  static void Clear (void);
+};
+
+} // namespace ns3
+
+#endif /* LORAWAN_PHY_CONFIG_REGISTRY_H */
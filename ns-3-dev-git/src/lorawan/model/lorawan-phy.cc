@@ -22,6 +22,10 @@
 #include "lorawan-spectrum-value-helper.h"
 #include "lorawan-error-model.h"
 #include "lorawan-lqi-tag.h"
+#include "lorawan-spectrum-channel.h"
+#include "lorawan-phy-config-registry.h"
+#include "lorawan-trace-source-accessor.h"
+#include "lorawan-gateway-front-end.h"
 #include <ns3/log.h>
 #include <ns3/abort.h>
 #include <ns3/simulator.h>
@@ -52,7 +56,7 @@ LoRaWANPhy::GetTypeId (void)
     .AddConstructor<LoRaWANPhy> ()
     .AddTraceSource ("TrxState",
                      "The state of the transceiver",
-                     MakeTraceSourceAccessor (&LoRaWANPhy::m_trxState),
+                     MakeLoRaWANCountingTraceSourceAccessor (&LoRaWANPhy::m_trxState, &LoRaWANPhy::m_nTrxStateSinks),
                      "ns3::TracedValueCallback::LoRaWANPhyEnumeration")
     .AddTraceSource ("TxPower",
                      "The transmit power of the transceiver, in dBm",
@@ -102,12 +106,12 @@ LoRaWANPhy::GetTypeId (void)
 }
 
 LoRaWANPhy::LoRaWANPhy (void)
+  : LoRaWANPhy (0)
 {
-  LoRaWANPhy (0);
 }
 
 LoRaWANPhy::LoRaWANPhy (uint8_t index)
-    : m_setTRXState (), m_index (index)
+    : m_detachWhenSleeping (false), m_detached (false), m_nTrxStateSinks (0), m_setTRXState (), m_index (index)
 {
   NS_LOG_FUNCTION (this << index);
 
@@ -127,11 +131,9 @@ LoRaWANPhy::LoRaWANPhy (uint8_t index)
   // energy detection or carrier sensing
   //m_rxSensitivity = pow (10.0, -106.58 / 10.0) / 1000.0;
 
-  LoRaWANSpectrumValueHelper psdHelper;
   const uint32_t freq = LoRaWAN::m_supportedChannels [m_currentChannelIndex].m_fc;
-  m_txPsd = psdHelper.CreateTxPowerSpectralDensity (m_txPower,
-                                                    freq);
-  m_noise = psdHelper.CreateNoisePowerSpectralDensity (freq); //TODO: does this make sense? Only noise at the centre frequency would be modeled, but the device can receive from different channels.
+  m_txPsd = LoRaWANPhyConfigRegistry::GetTxPowerSpectralDensity (m_txPower, freq);
+  m_noise = LoRaWANPhyConfigRegistry::GetNoisePowerSpectralDensity (1.0); // models noise across all channels
 
   m_signal = Create<LoRaWANInterferenceHelper> (m_noise->GetSpectrumModel ());
   m_rxLastUpdate = Seconds (0);
@@ -160,12 +162,16 @@ LoRaWANPhy::DoDispose (void)
 
   // Cancel pending transceiver state change, if one is in progress.
   m_setTRXState.Cancel ();
+  if (m_frontEnd && m_trxState == LORAWAN_PHY_BUSY_RX)
+    m_frontEnd->NotifyRx (this, false);
   m_trxState = LORAWAN_PHY_TRX_OFF;
   // m_trxStatePending = LORAWAN_PHY_IDLE;
 
   m_mobility = 0;
   m_device = 0;
   m_channel = 0;
+  m_loRaWANChannel = 0;
+  m_frontEnd = 0;
   m_txPsd = 0;
   m_noise = 0;
   m_signal = 0;
@@ -214,6 +220,16 @@ LoRaWANPhy::SetChannel (Ptr<SpectrumChannel> c)
 {
   NS_LOG_FUNCTION (this << c);
   m_channel = c;
+  m_loRaWANChannel = DynamicCast<LoRaWANSpectrumChannel> (c);
+  m_detached = false;
+}
+
+void
+LoRaWANPhy::SetDetachWhenSleeping (bool detach)
+{
+  NS_LOG_FUNCTION (this << detach);
+  m_detachWhenSleeping = detach;
+  UpdateChannelAttachment ();
 }
 
 
@@ -295,12 +311,12 @@ LoRaWANPhy::SetTxConf (int8_t power, uint8_t channelIndex, uint8_t dataRateIndex
 
   PrintCurrentTxConf();
 
-  const LoRaWANChannel* channel = &LoRaWAN::m_supportedChannels[channelIndex];
-  const LoRaWANDataRate* dataRate = &LoRaWAN::m_supportedDataRates[dataRateIndex];
-  if (channel == NULL || dataRate == NULL) {
+  if (channelIndex >= LoRaWAN::m_supportedChannels.size () || dataRateIndex >= LoRaWAN::m_supportedDataRates.size ()) {
     NS_LOG_ERROR(this << " Cannot set TX config due to invalid channel or data rate index");
     return false;
   }
+  const LoRaWANChannel* channel = &LoRaWAN::m_supportedChannels[channelIndex];
+  const LoRaWANDataRate* dataRate = &LoRaWAN::m_supportedDataRates[dataRateIndex];
 
   // Can only update TxConf when radio is not already transmitting
   if (m_trxState == LORAWAN_PHY_BUSY_TX || m_trxState == LORAWAN_PHY_TX_ON || m_setTRXState.IsRunning() ) {
@@ -312,14 +328,15 @@ LoRaWANPhy::SetTxConf (int8_t power, uint8_t channelIndex, uint8_t dataRateIndex
   bool validConf = true;
 
   // possible tx power values: 0, -2, -4, -6, -8, -10, -12, -14 (relative to max EIRP)
-  // max EIRP is 27 for high power band, otherwise 14dBm
-  // so possible tx power values are those listed below
+  // max EIRP depends on the sub band, e.g. 27 for the EU868 high power band, otherwise 14dBm
   //TODO: but because in other regions the tx pow indexes modify the pow by 3 each index, this should really be done relatively based on the deployed area
-  if (!(power == 27 || power == 25 || power == 23 || power == 21 || power == 19 || power == 17 || power == 15 || power == 13 
-     || power == 14 || power == 12 || power == 10 || power ==  8 || power ==  6 || power ==  4 || power == 2  || power ==  0 ))
+  if (!LoRaWAN::IsValidTxPower (power))
     validConf = false;
 
-  if (channel->m_bw != 125e3) // only 125KHz is supported for the moment
+  if (channel->m_bw != 125e3 && channel->m_bw != 250e3 && channel->m_bw != 500e3)
+    validConf = false;
+
+  if (dataRate->bandWith == 0) // RFU data rate
     validConf = false;
 
   if (codeRate != 1 && codeRate != 2 && codeRate != 3 && codeRate != 4) 
@@ -342,9 +359,7 @@ LoRaWANPhy::SetTxConf (int8_t power, uint8_t channelIndex, uint8_t dataRateIndex
   m_crcOn = crcOn;
 
   // update TX PSD
-  LoRaWANSpectrumValueHelper psdHelper;
-  m_txPsd = psdHelper.CreateTxPowerSpectralDensity (m_txPower,
-                                                    channel->m_fc);
+  m_txPsd = LoRaWANPhyConfigRegistry::GetTxPowerSpectralDensity (m_txPower, channel->m_fc);
   NS_LOG_DEBUG (this << ": updated TxConf");
 
   return true;
@@ -374,7 +389,8 @@ LoRaWANPhy::SetTRXStateRequest (LoRaWANPhyEnumeration state)
     }
 
   if (state == LORAWAN_PHY_TRX_OFF ) {
-    NS_ABORT_IF ( (m_trxState != LORAWAN_PHY_RX_ON ) );
+    // IDLE when a class A end device skipped its receive windows, see LoRaWANMac::ArmRW
+    NS_ABORT_IF ( (m_trxState != LORAWAN_PHY_RX_ON ) && (m_trxState != LORAWAN_PHY_IDLE) );
     ChangeTrxState (LORAWAN_PHY_TRX_OFF);
     if (!m_setTRXStateConfirmCallback.IsNull ())
       {
@@ -478,12 +494,74 @@ LoRaWANPhy::SetTRXStateRequest (LoRaWANPhyEnumeration state)
   return;
 }
 
+LoRaWANPhyEnumeration
+LoRaWANPhy::GetTRXState (void) const
+{
+  return m_trxState;
+}
+
 void
 LoRaWANPhy::ChangeTrxState (LoRaWANPhyEnumeration newState)
 {
   NS_LOG_LOGIC (this << " state: " << m_trxState << " -> " << newState);
   //m_trxStateLogger (Simulator::Now (), m_trxState, newState);
+  if (m_frontEnd && (m_trxState == LORAWAN_PHY_BUSY_RX) != (newState == LORAWAN_PHY_BUSY_RX))
+    m_frontEnd->NotifyRx (this, newState == LORAWAN_PHY_BUSY_RX);
   m_trxState = newState;
+  if (m_loRaWANChannel)
+    UpdateChannelAttachment ();
+}
+
+void
+LoRaWANPhy::UpdateChannelAttachment (void)
+{
+  if (!m_loRaWANChannel)
+    return;
+
+  bool listening = m_trxState == LORAWAN_PHY_RX_ON || m_trxState == LORAWAN_PHY_BUSY_RX;
+  if (!m_detached && m_detachWhenSleeping && !listening) {
+    NS_LOG_LOGIC (this << " detaching from the channel");
+    m_detached = true;
+    m_loRaWANChannel->DetachRx (this);
+  } else if (m_detached && (listening || !m_detachWhenSleeping)) {
+    NS_LOG_LOGIC (this << " rejoining the channel");
+    m_detached = false;
+    m_loRaWANChannel->AttachRx (this);
+  }
+}
+
+bool
+LoRaWANPhy::ArmRx (uint8_t channelIndex, uint8_t dataRateIndex, Time until, Callback<void> wake)
+{
+  NS_LOG_FUNCTION (this << static_cast<uint16_t> (channelIndex) << static_cast<uint16_t> (dataRateIndex) << until);
+
+  if (!m_loRaWANChannel || !m_detached)
+    return false;
+
+  m_loRaWANChannel->ArmRx (this, channelIndex, dataRateIndex, until, wake);
+  return true;
+}
+
+void
+LoRaWANPhy::DisarmRx (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  if (m_loRaWANChannel)
+    m_loRaWANChannel->DisarmRx (this);
+}
+
+bool
+LoRaWANPhy::IsTrxStateTraced (void) const
+{
+  return m_nTrxStateSinks > 0;
+}
+
+void
+LoRaWANPhy::SetFrontEnd (Ptr<LoRaWANGatewayFrontEnd> frontEnd)
+{
+  NS_LOG_FUNCTION (this << frontEnd);
+  m_frontEnd = frontEnd;
 }
 
 bool
@@ -562,7 +640,9 @@ LoRaWANPhy::StartRx (Ptr<SpectrumSignalParameters> spectrumRxParams)
   // Prevent PHY from receiving another packet while switching the transceiver state.
   
 
-  if (m_trxState == LORAWAN_PHY_RX_ON && !m_setTRXState.IsRunning ())
+  // A PHY in RX_ON does not receive while the front-end it shares transmits, as if it was off
+  bool blanked = m_frontEnd && m_frontEnd->IsTransmitting ();
+  if (m_trxState == LORAWAN_PHY_RX_ON && !m_setTRXState.IsRunning () && !blanked)
     {
       // The specification doesn't seem to refer to BUSY_RX, but vendor
       // data sheets suggest that this is a substate of the RX_ON state
@@ -759,6 +839,21 @@ LoRaWANPhy::CheckInterference (void)
   m_rxLastUpdate = Simulator::Now ();
 }
 
+void
+LoRaWANPhy::StartRxInterference (Ptr<SpectrumSignalParameters> params, Time remaining)
+{
+  NS_LOG_FUNCTION (this << params << remaining);
+
+  Ptr<LoRaWANSpectrumSignalParameters> loraWanRxParams = DynamicCast<LoRaWANSpectrumSignalParameters> (params);
+  if (loraWanRxParams && loraWanRxParams->channelIndex != m_currentChannelIndex) {
+    return; // as in StartRx
+  }
+
+  CheckInterference ();
+  m_signal->AddSignal (params->psd);
+  Simulator::Schedule (remaining, &LoRaWANPhy::EndRx, this, params);
+}
+
 void
 LoRaWANPhy::EndRx (Ptr<SpectrumSignalParameters> par)
 {
@@ -883,7 +978,8 @@ LoRaWANPhy::PdDataRequest (const uint32_t phyPayloadLength, Ptr<Packet> p)
       Ptr<LoRaWANSpectrumSignalParameters> txParams = Create<LoRaWANSpectrumSignalParameters> ();
       txParams->duration = CalculateTxTime (p->GetSize());
       txParams->txPhy = GetObject<SpectrumPhy> ();
-      txParams->psd = m_txPsd;
+      // the channel copies the PSD before applying the propagation loss
+      txParams->psd = ConstCast<SpectrumValue> (m_txPsd);
       txParams->txAntenna = m_antenna;
       txParams->packet = p;
       txParams->channelIndex = m_currentChannelIndex;
@@ -951,44 +1047,57 @@ LoRaWANPhy::EndTx (void)
 /* \param p is the PHYPayload as per the LoRaWAN spec */
 Time
 LoRaWANPhy::CalculateTxTime (uint8_t payloadLength)
+{
+  Time txTime = CalculateTxTime (payloadLength, m_currentChannelIndex, m_currentDataRateIndex, m_codeRate, m_preambleLength, m_crcOn);
+
+  NS_LOG_DEBUG(this << ": " << LoRaWAN::m_supportedDataRates [m_currentDataRateIndex].spreadingFactor << "|" << (uint16_t)m_codeRate  << "|" << (uint16_t)payloadLength
+      << "|" << (uint16_t) m_preambleLength << "|" << txTime);
+
+  return txTime;
+}
+
+Time
+LoRaWANPhy::CalculateTxTime (uint8_t payloadLength, uint8_t channelIndex, uint8_t dataRateIndex, uint8_t codeRate, uint8_t preambleLength, bool crcOn)
 {
   // calculations per $4.1.1.7 'Time on air' in sx1272 data sheet
-  const uint32_t bandwidth = LoRaWAN::m_supportedChannels [m_currentChannelIndex].m_bw;
-  const LoRaSpreadingFactor sf = LoRaWAN::m_supportedDataRates [m_currentDataRateIndex].spreadingFactor;
+  const uint32_t bandwidth = LoRaWAN::m_supportedChannels [channelIndex].m_bw;
+  const LoRaSpreadingFactor sf = LoRaWAN::m_supportedDataRates [dataRateIndex].spreadingFactor;
 
   double symbolRate = ((double)bandwidth)/pow(2.0, sf);
   double symbolPeriod = 1.0e6/symbolRate; // the symbol period in microseconds
 
-  double nSymbolsPreamble = m_preambleLength + 4.25;
+  double nSymbolsPreamble = preambleLength + 4.25;
   uint16_t nSymbolsPayload = 8;
   // LoRaWAN mandates no imlicit header, assume low data rate optimization (DE) is not used
   uint32_t crc = 1;
-  if (!m_crcOn)
+  if (!crcOn)
     crc = 0;
 
-  uint16_t nConditionalSymbolsPayload = ceil((8.0*payloadLength - 4.0*sf + 28 + 16*crc)/4.0/(double)sf)*(m_codeRate + 4);
+  uint16_t nConditionalSymbolsPayload = ceil((8.0*payloadLength - 4.0*sf + 28 + 16*crc)/4.0/(double)sf)*(codeRate + 4);
   if (nConditionalSymbolsPayload > 0.0)
     nSymbolsPayload += nConditionalSymbolsPayload;
 
   double txTime = (nSymbolsPreamble + nSymbolsPayload) * symbolPeriod;
 
-  NS_LOG_DEBUG(this << ": " << sf  << "|" << (uint16_t)m_codeRate  << "|" << (uint16_t)payloadLength
-      << "|" << (uint16_t) m_preambleLength  << "|" << nSymbolsPayload  << "|" << nConditionalSymbolsPayload
-      << "|" << txTime << "uS");
-
   return MicroSeconds(txTime);
 }
 
 Time
 LoRaWANPhy::CalculatePreambleTime ()
 {
-  const uint32_t bandwidth = LoRaWAN::m_supportedChannels [m_currentChannelIndex].m_bw;
-  const LoRaSpreadingFactor sf = LoRaWAN::m_supportedDataRates [m_currentDataRateIndex].spreadingFactor;
+  return CalculatePreambleTime (m_currentChannelIndex, m_currentDataRateIndex, m_preambleLength);
+}
+
+Time
+LoRaWANPhy::CalculatePreambleTime (uint8_t channelIndex, uint8_t dataRateIndex, uint8_t preambleLength)
+{
+  const uint32_t bandwidth = LoRaWAN::m_supportedChannels [channelIndex].m_bw;
+  const LoRaSpreadingFactor sf = LoRaWAN::m_supportedDataRates [dataRateIndex].spreadingFactor;
 
   double symbolRate = ((double)bandwidth)/pow(2.0, sf);
   double symbolPeriod = 1.0e6/symbolRate; // the symbol period in microseconds
 
-  double nSymbolsPreamble = m_preambleLength + 4.25;
+  double nSymbolsPreamble = preambleLength + 4.25;
   double timePreamble = nSymbolsPreamble * symbolPeriod;
 
   return MicroSeconds(timePreamble);
@@ -1021,10 +1130,19 @@ LoRaWANPhy::AssignStreams (int64_t stream)
 void 
 LoRaWANPhy::UpdateNoiseFactorAndNoisePowerSpectralDensity(double noiseFactor)
 {
-  LoRaWANSpectrumValueHelper psdHelper;
-  psdHelper.UpdateNoiseFactor(noiseFactor);
-  const uint32_t freq = LoRaWAN::m_supportedChannels [0].m_fc; 
-  m_noise = psdHelper.CreateNoisePowerSpectralDensity (freq); //note that this function has been modified to model noise across all channels.
+  m_noise = LoRaWANPhyConfigRegistry::GetNoisePowerSpectralDensity (noiseFactor); //note that the noise is modeled across all channels.
+}
+
+Ptr<const SpectrumValue>
+LoRaWANPhy::GetNoisePowerSpectralDensity (void) const
+{
+  return m_noise;
+}
+
+Ptr<const SpectrumValue>
+LoRaWANPhy::GetTxPowerSpectralDensity (void) const
+{
+  return m_txPsd;
 }
 
 } // namespace ns3
@@ -36,6 +36,8 @@ class LoRaWANErrorModel;
 struct LoRaWANSpectrumSignalParameters;
 class MobilityModel;
 class SpectrumChannel;
+class LoRaWANSpectrumChannel;
+class LoRaWANGatewayFrontEnd;
 class SpectrumModel;
 class AntennaModel;
 class NetDevice;
@@ -171,6 +173,7 @@ public:
 
   uint8_t GetCurrentChannelIndex () const { return m_currentChannelIndex; }
   uint8_t GetCurrentDataRateIndex () const { return m_currentDataRateIndex; }
+  double GetTxPower () const { return m_txPower; } //!< in dBm
 
   /**
    * Calculate the time for transmitting the given packet in microseconds
@@ -186,6 +189,25 @@ public:
    */
   Time CalculatePreambleTime();
 
+  /**
+   * Calculate the time on air of a frame for the given transmission parameters,
+   * without requiring a configured PHY
+   *
+   * \param payloadLength the PHYPayload length in bytes
+   * \param channelIndex index of the channel in LoRaWAN::m_supportedChannels
+   * \param dataRateIndex index of the data rate in LoRaWAN::m_supportedDataRates
+   * \param codeRate the code rate (1 to 4)
+   * \param preambleLength the number of preamble symbols
+   * \param crcOn whether the PHY CRC is present
+   * \return the transmit time in MicroSeconds
+   */
+  static Time CalculateTxTime (uint8_t payloadLength, uint8_t channelIndex, uint8_t dataRateIndex, uint8_t codeRate, uint8_t preambleLength, bool crcOn);
+
+  /**
+   * Calculate the time for transmitting a preamble for the given transmission parameters
+   */
+  static Time CalculatePreambleTime (uint8_t channelIndex, uint8_t dataRateIndex, uint8_t preambleLength);
+
   /**
    * Check whether PHY has detected a premable since it switched its state to RX_ON
    */
@@ -234,7 +256,7 @@ public:
    *
    * @return the Noise Power Spectral Density
    */
-  Ptr<const SpectrumValue> GetNoisePowerSpectralDensity (void);
+  Ptr<const SpectrumValue> GetNoisePowerSpectralDensity (void) const;
 
   /**
     * Notify the SpectrumPhy instance of an incoming waveform.
@@ -243,6 +265,50 @@ public:
     */
   virtual void StartRx (Ptr<SpectrumSignalParameters> params);
 
+  /**
+   * Add an incoming waveform that is already being received to the
+   * interference, without attempting to receive it. Used by the
+   * LoRaWANSpectrumChannel when the PHY rejoins the channel.
+   *
+   * @param params the SpectrumSignalParameters of the waveform at this PHY
+   * @param remaining the time until the end of the waveform
+   */
+  void StartRxInterference (Ptr<SpectrumSignalParameters> params, Time remaining);
+
+  /**
+   * Detach from a LoRaWANSpectrumChannel while the transceiver is not
+   * listening (i.e. neither in RX_ON nor in BUSY_RX), so that the channel
+   * does not deliver transmissions the PHY would only drop. Has no effect
+   * with other channels.
+   */
+  void SetDetachWhenSleeping (bool detach);
+
+  /**
+   * Have the LoRaWANSpectrumChannel call \p wake when a transmission with
+   * the given channel and data rate starts before \p until, instead of
+   * listening for it, see LoRaWANSpectrumChannel::ArmRx.
+   *
+   * \return false if the PHY is not detached from a LoRaWANSpectrumChannel,
+   *   in which case it has to listen itself
+   */
+  bool ArmRx (uint8_t channelIndex, uint8_t dataRateIndex, Time until, Callback<void> wake);
+
+  /**
+   * Cancel ArmRx
+   */
+  void DisarmRx (void);
+
+  /**
+   * \return true if a sink is connected to the TrxState trace source
+   */
+  bool IsTrxStateTraced (void) const;
+
+  /**
+   * Share the radio front-end of a gateway with its other PHYs: the PHY does
+   * not receive while the front-end transmits, see LoRaWANGatewayFrontEnd.
+   */
+  void SetFrontEnd (Ptr<LoRaWANGatewayFrontEnd> frontEnd);
+
   /**
    * set the error model to use
    *
@@ -262,6 +328,11 @@ public:
    */
   void SetTRXStateRequest (LoRaWANPhyEnumeration state);
 
+  /**
+   * \return the current transceiver state
+   */
+  LoRaWANPhyEnumeration GetTRXState (void) const;
+
   /**
    * set the callback for the end of a RX, as part of the
    * interconnections between the PHY and the MAC. The callback
@@ -335,7 +406,18 @@ public:
 
   uint8_t GetIndex (void) const;
 
+  /**
+   * Use the noise PSD of the given noise factor, shared through
+   * LoRaWANPhyConfigRegistry with the other PHYs with the same noise factor
+   *
+   * @param noiseFactor the noise factor (linear)
+   */
   void UpdateNoiseFactorAndNoisePowerSpectralDensity(double noiseFactor);
+
+  /**
+   * @return the TX PSD of the current tx power and channel
+   */
+  Ptr<const SpectrumValue> GetTxPowerSpectralDensity (void) const;
   
 protected:
 
@@ -355,6 +437,12 @@ private:
    */
   void ChangeTrxState (LoRaWANPhyEnumeration newState);
 
+  /**
+   * Detach from or rejoin the LoRaWANSpectrumChannel according to the
+   * transceiver state, if the PHY detaches when sleeping.
+   */
+  void UpdateChannelAttachment (void);
+
   /**
    * Finish the transmission of a frame. This is called at the end of a frame
    * transmission, applying possibly pending PHY state changes and fireing the
@@ -458,18 +546,33 @@ private:
    */
   Ptr<SpectrumChannel> m_channel;
 
+  /**
+   * The channel, if it is a LoRaWANSpectrumChannel.
+   */
+  Ptr<LoRaWANSpectrumChannel> m_loRaWANChannel;
+
+  bool m_detachWhenSleeping;
+  bool m_detached;  //!< not receiving transmissions from m_loRaWANChannel
+
+  /**
+   * The front-end shared with the other PHYs of a gateway, if any.
+   */
+  Ptr<LoRaWANGatewayFrontEnd> m_frontEnd;
+
   /**
    * The antenna used by the transceiver.
    */
   Ptr<AntennaModel> m_antenna;
 
   /**
-   * The transmit power spectral density.
+   * The transmit power spectral density, shared with the other PHYs with the
+   * same tx power and channel.
    */
-  Ptr<SpectrumValue> m_txPsd;
+  Ptr<const SpectrumValue> m_txPsd;
 
   /**
-   * The spectral density for for the noise.
+   * The spectral density for for the noise, shared with the other PHYs with
+   * the same noise factor.
    */
   Ptr<const SpectrumValue> m_noise;
 
@@ -484,6 +587,11 @@ private:
    */
   TracedValue<LoRaWANPhyEnumeration> m_trxState;
 
+  /**
+   * The number of sinks connected to the TrxState trace source.
+   */
+  uint32_t m_nTrxStateSinks;
+
   /**
    * The next pending state to applied after the current action of the PHY is
    * completed.
@@ -0,0 +1,233 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+
+#ifndef LORAWAN_QUEUE_POOL_H
+#define LORAWAN_QUEUE_POOL_H
+
+#include <ns3/assert.h>
+
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup lorawan
+ *
+ * Slab allocator for the elements of the LoRaWAN queues (the tx queue of
+ * LoRaWANMac and the downstream queues of LoRaWANNetworkServer).
+ *
+ * There is one pool per element type, shared by all queues of the module.
+ * Slots are carved out of slabs of SLAB_SIZE elements and returned to a free
+ * list when an element is released; slabs are only freed at the end of the
+ * program. Once the pool has grown to the largest number of elements queued
+ * at the same time, queueing does not allocate any more.
+ */
+template <typename T>
+class LoRaWANQueueElementPool
+{
+public:
+  static const uint32_t SLAB_SIZE = 256;
+
+  /**
+   * \brief Get a value-initialized element
+   */
+  static T* Allocate (void)
+  {
+    Pool& pool = GetPool ();
+    if (pool.m_free == 0)
+      pool.Grow ();
+
+    Slot* slot = pool.m_free;
+    pool.m_free = slot->m_next;
+    pool.m_nInUse++;
+    return new (&slot->m_storage) T ();
+  }
+
+  /**
+   * \brief Destroy an element and return its slot to the pool
+   */
+  static void Free (T* element)
+  {
+    if (element == 0)
+      return;
+
+    Pool& pool = GetPool ();
+    NS_ASSERT (pool.m_nInUse > 0);
+    element->~T ();
+    Slot* slot = reinterpret_cast<Slot*> (element);
+    slot->m_next = pool.m_free;
+    pool.m_free = slot;
+    pool.m_nInUse--;
+  }
+
+  /**
+   * \return the number of elements allocated and not yet freed, used to check for leaks
+   */
+  static uint32_t GetNInUse (void)
+  {
+    return GetPool ().m_nInUse;
+  }
+
+  /**
+   * \return the number of elements the pool can hand out without growing
+   */
+  static uint32_t GetCapacity (void)
+  {
+    return GetPool ().m_slabs.size () * SLAB_SIZE;
+  }
+
+private:
+  union Slot
+  {
+    Slot* m_next;
+    typename std::aligned_storage<sizeof (T), std::alignment_of<T>::value>::type m_storage;
+  };
+
+  struct Pool
+  {
+    Pool () : m_free (0), m_nInUse (0) {}
+
+    void Grow (void)
+    {
+      Slot* slab = new Slot[SLAB_SIZE];
+      m_slabs.push_back (slab);
+      for (uint32_t i = SLAB_SIZE; i > 0; i--) {
+        slab[i - 1].m_next = m_free;
+        m_free = &slab[i - 1];
+      }
+    }
+
+    std::vector<Slot*> m_slabs;
+    Slot* m_free;
+    uint32_t m_nInUse;
+  };
+
+  // The pool is never destroyed: elements may still be freed by static destructors that run after it would have been
+  static Pool& GetPool (void)
+  {
+    static Pool *pool = new Pool;
+    return *pool;
+  }
+};
+
+/**
+ * \ingroup lorawan
+ *
+ * Singly linked FIFO of elements that carry their own T* m_next link,
+ * allocated from LoRaWANQueueElementPool. The queue owns its elements:
+ * PopFront hands the first element back to the pool.
+ *
+ * A queue is small enough to be embedded in per device state. It can only be
+ * copied while it is empty, so that two queues never share elements.
+ */
+template <typename T>
+class LoRaWANIntrusiveQueue
+{
+public:
+  LoRaWANIntrusiveQueue () : m_head (0), m_tail (0), m_size (0) {}
+
+  LoRaWANIntrusiveQueue (const LoRaWANIntrusiveQueue& other) : m_head (0), m_tail (0), m_size (0)
+  {
+    NS_ASSERT_MSG (other.IsEmpty (), "Copying a non-empty LoRaWANIntrusiveQueue");
+  }
+
+  LoRaWANIntrusiveQueue (LoRaWANIntrusiveQueue&& other) : m_head (other.m_head), m_tail (other.m_tail), m_size (other.m_size)
+  {
+    other.m_head = other.m_tail = 0;
+    other.m_size = 0;
+  }
+
+  LoRaWANIntrusiveQueue& operator= (const LoRaWANIntrusiveQueue& other)
+  {
+    NS_ASSERT_MSG (other.IsEmpty (), "Copying a non-empty LoRaWANIntrusiveQueue");
+    Clear ();
+    return *this;
+  }
+
+  LoRaWANIntrusiveQueue& operator= (LoRaWANIntrusiveQueue&& other)
+  {
+    if (this != &other) {
+      Clear ();
+      m_head = other.m_head;
+      m_tail = other.m_tail;
+      m_size = other.m_size;
+      other.m_head = other.m_tail = 0;
+      other.m_size = 0;
+    }
+    return *this;
+  }
+
+  ~LoRaWANIntrusiveQueue ()
+  {
+    Clear ();
+  }
+
+  bool IsEmpty (void) const { return m_head == 0; }
+  uint32_t GetSize (void) const { return m_size; }
+  T* Front (void) const { return m_head; }
+
+  /**
+   * \brief Allocate an element from the pool and append it
+   * \return the new element, to be filled in by the caller
+   */
+  T* Emplace (void)
+  {
+    T* element = LoRaWANQueueElementPool<T>::Allocate ();
+    element->m_next = 0;
+    if (m_tail)
+      m_tail->m_next = element;
+    else
+      m_head = element;
+    m_tail = element;
+    m_size++;
+    return element;
+  }
+
+  /**
+   * \brief Remove the first element and return it to the pool
+   */
+  void PopFront (void)
+  {
+    NS_ASSERT_MSG (m_head, "PopFront on an empty LoRaWANIntrusiveQueue");
+    T* element = m_head;
+    m_head = element->m_next;
+    if (m_head == 0)
+      m_tail = 0;
+    m_size--;
+    LoRaWANQueueElementPool<T>::Free (element);
+  }
+
+  void Clear (void)
+  {
+    while (m_head)
+      PopFront ();
+  }
+
+private:
+  T* m_head;
+  T* m_tail;
+  uint32_t m_size;
+};
+
+} // namespace ns3
+
+#endif /* LORAWAN_QUEUE_POOL_H */
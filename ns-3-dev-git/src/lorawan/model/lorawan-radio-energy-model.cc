@@ -60,6 +60,11 @@ LoRaWANRadioEnergyModel::LoRaWANRadioEnergyModel ()
   m_currentState = LoRaWANPhyEnumeration::LORAWAN_PHY_TRX_OFF;  // initially LORAWAN_PHY_TRX_OFF; same as in lorawan-phy
   m_currentModel = NULL;
   m_lastUpdateTime = Seconds (0.0);
+  for (int state = LoRaWANPhyEnumeration::LORAWAN_PHY_TRX_OFF; state <= LoRaWANPhyEnumeration::LORAWAN_PHY_BUSY_TX; state++)
+    {
+      m_stateResidency[state] = Seconds (0.0);
+      m_stateEnergy[state] = 0.0;
+    }
   m_energyDepletionCallback.Nullify ();
   m_source = NULL;
 }
@@ -148,6 +153,44 @@ LoRaWANRadioEnergyModel::SetSleepCurrentA (double sleepCurrentA)
   m_currentModel->SetSleepCurrent(sleepCurrentA);
 }
 
+Time
+LoRaWANRadioEnergyModel::GetStateResidency (LoRaWANPhyEnumeration state) const
+{
+  NS_LOG_FUNCTION (this << state);
+  NS_ASSERT (state <= LoRaWANPhyEnumeration::LORAWAN_PHY_BUSY_TX);
+  Time residency = m_stateResidency[state];
+  if (state == m_currentState)
+    {
+      residency += Simulator::Now () - m_lastUpdateTime;
+    }
+  return residency;
+}
+
+double
+LoRaWANRadioEnergyModel::GetStateEnergy (LoRaWANPhyEnumeration state) const
+{
+  NS_LOG_FUNCTION (this << state);
+  NS_ASSERT (state <= LoRaWANPhyEnumeration::LORAWAN_PHY_BUSY_TX);
+  double energy = m_stateEnergy[state];
+  if (state == m_currentState && m_source != 0)
+    {
+      energy += (Simulator::Now () - m_lastUpdateTime).GetSeconds () * DoGetCurrentA () * m_source->GetSupplyVoltage ();
+    }
+  return energy;
+}
+
+double
+LoRaWANRadioEnergyModel::GetEnergyConsumptionNow (void) const
+{
+  NS_LOG_FUNCTION (this);
+  double energy = m_totalEnergyConsumption;
+  if (m_source != 0)
+    {
+      energy += (Simulator::Now () - m_lastUpdateTime).GetSeconds () * DoGetCurrentA () * m_source->GetSupplyVoltage ();
+    }
+  return energy;
+}
+
 LoRaWANPhyEnumeration
 LoRaWANRadioEnergyModel::GetCurrentState (void) const
 {
@@ -228,6 +271,8 @@ LoRaWANRadioEnergyModel::ChangeLoRaWANState (LoRaWANPhyEnumeration oldState, LoR
 
   // update total energy consumption
   m_totalEnergyConsumption += energyToDecrease;
+  m_stateResidency[m_currentState] += duration;
+  m_stateEnergy[m_currentState] += energyToDecrease;
 
   // update last update time stamp
   m_lastUpdateTime = Simulator::Now ();
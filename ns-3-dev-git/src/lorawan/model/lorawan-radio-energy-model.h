@@ -103,6 +103,28 @@ public:
   double GetSleepCurrentA (void) const;
   void SetSleepCurrentA (double sleepCurrentA);
 
+  /**
+   * \param state a radio state, from LORAWAN_PHY_TRX_OFF to LORAWAN_PHY_BUSY_TX
+   * \returns Time spent in the state so far, including the time spent in
+   * the current state since the last state change.
+   */
+  Time GetStateResidency (LoRaWANPhyEnumeration state) const;
+
+  /**
+   * \param state a radio state, from LORAWAN_PHY_TRX_OFF to LORAWAN_PHY_BUSY_TX
+   * \returns Energy consumed in the state so far (J), including the energy
+   * consumed in the current state since the last state change.
+   */
+  double GetStateEnergy (LoRaWANPhyEnumeration state) const;
+
+  /**
+   * \returns Total energy consumption of the LoRa device up to now (J).
+   *
+   * Unlike GetTotalEnergyConsumption, includes the energy consumed in the
+   * current state since the last state change.
+   */
+  double GetEnergyConsumptionNow (void) const;
+
   /**
    * \returns Current state.
    */
@@ -185,6 +207,10 @@ private:
 
   Time m_lastUpdateTime;          // time stamp of previous energy update
 
+  // Time spent and energy consumed in each state, up to m_lastUpdateTime
+  Time m_stateResidency[LoRaWANPhyEnumeration::LORAWAN_PHY_BUSY_TX + 1];
+  double m_stateEnergy[LoRaWANPhyEnumeration::LORAWAN_PHY_BUSY_TX + 1];
+
   // Energy depletion callback
   LoRaWANRadioEnergyDepletionCallback m_energyDepletionCallback;
 
@@ -0,0 +1,167 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+#include "lorawan-region.h"
+#include <ns3/log.h>
+
+#include <algorithm>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("LoRaWANRegion");
+
+/****************************************************************************
+ ******************************** EU868 *************************************
+ ****************************************************************************/
+
+const LoRaWANChannel LoRaWANRegionTraits<LORAWAN_REGION_EU868>::channels[] = {
+  {0, 868100000, 125000, 1, 0, 6, true},
+  {1, 868300000, 125000, 1, 0, 6, true},
+  {2, 868500000, 125000, 1, 0, 6, true},
+  {3, 867100000, 125000, 1, 0, 6, true},
+  {4, 867300000, 125000, 1, 0, 6, true},
+  {5, 867500000, 125000, 1, 0, 6, true},
+  {6, 867700000, 125000, 1, 0, 6, true},
+  // {7, 867900000, 125000, 1, 0, 6, true}, // sacrifice for high power channel on 869525000
+  {7, 869525000, 125000, 3, 0, 6, true}, // NOTE: always keep this special high power channel as the last element
+};
+
+const LoRaWANDataRate LoRaWANRegionTraits<LORAWAN_REGION_EU868>::dataRates[] = {
+  {0, LORAWAN_SF12, 125000},
+  {1, LORAWAN_SF11, 125000},
+  {2, LORAWAN_SF10, 125000},
+  {3, LORAWAN_SF9, 125000},
+  {4, LORAWAN_SF8, 125000},
+  {5, LORAWAN_SF7, 125000},
+  {6, LORAWAN_SF7, 250000}
+}; // other indexes are RFU
+
+const LoRaWANSubBandLimits LoRaWANRegionTraits<LORAWAN_REGION_EU868>::subBands[] = {
+  {100, 14}, // g(Note 7), 14dBm?
+  {100, 14}, // 1%
+  {1000, 14}, // 0.1%
+  {10, 27}, // 10%, high power subband
+  {100, 14}, // 1%
+};
+
+uint8_t
+LoRaWANRegionTraits<LORAWAN_REGION_EU868>::GetRX1DataRateIndex (uint8_t upstreamDRIndex, uint8_t rx1DROffset)
+{
+  if (rx1DROffset == 0 || rx1DROffset == 1 ||rx1DROffset == 2 ||rx1DROffset == 3 ||rx1DROffset == 4 ||rx1DROffset == 5)
+    if (upstreamDRIndex <= rx1DROffset)
+      return 0;
+    else
+      return upstreamDRIndex - rx1DROffset;
+  else {
+    NS_LOG_WARN ("LoRaWAN::GetRX1DataRateIndex Invalid rx1DROffset: " << static_cast<uint16_t>(rx1DROffset));
+    return upstreamDRIndex;
+  }
+}
+
+/****************************************************************************
+ ******************************** US915 *************************************
+ ****************************************************************************/
+
+const LoRaWANDataRate LoRaWANRegionTraits<LORAWAN_REGION_US915>::dataRates[] = {
+  {0, LORAWAN_SF10, 125000},
+  {1, LORAWAN_SF9, 125000},
+  {2, LORAWAN_SF8, 125000},
+  {3, LORAWAN_SF7, 125000},
+  {4, LORAWAN_SF8, 500000},
+  {5, LORAWAN_SF12, 0}, // RFU
+  {6, LORAWAN_SF12, 0}, // RFU
+  {7, LORAWAN_SF12, 0}, // RFU
+  {8, LORAWAN_SF12, 500000},
+  {9, LORAWAN_SF11, 500000},
+  {10, LORAWAN_SF10, 500000},
+  {11, LORAWAN_SF9, 500000},
+  {12, LORAWAN_SF8, 500000},
+  {13, LORAWAN_SF7, 500000}
+}; // other indexes are RFU
+
+const LoRaWANSubBandLimits LoRaWANRegionTraits<LORAWAN_REGION_US915>::subBands[] = {
+  {1, 30}, // uplink channels, no duty cycle limit
+  {1, 27}, // downlink channels
+};
+
+LoRaWANChannel
+LoRaWANRegionTraits<LORAWAN_REGION_US915>::GetChannel (uint8_t channelIndex, uint8_t channelSubBand)
+{
+  NS_ASSERT (channelIndex < nChannels);
+  NS_ASSERT (channelSubBand < nChannelSubBands);
+
+  if (channelIndex < nUplinkChannels) {
+    // uplink channel 8 * channelSubBand + channelIndex: 902.3 MHz + 200 kHz steps
+    LoRaWANChannel channel = {channelIndex, 902300000u + 200000u * (8 * channelSubBand + channelIndex), 125000, 0, 0, 3, true};
+    return channel;
+  } else {
+    // downlink channel channelIndex - 8: 923.3 MHz + 600 kHz steps
+    LoRaWANChannel channel = {channelIndex, 923300000u + 600000u * (channelIndex - nUplinkChannels), 500000, 1, 8, 13, false};
+    return channel;
+  }
+}
+
+uint8_t
+LoRaWANRegionTraits<LORAWAN_REGION_US915>::GetRX1DataRateIndex (uint8_t upstreamDRIndex, uint8_t rx1DROffset)
+{
+  // DR0-4 map onto DR10-13 for RX1DROffset 0, every offset step lowers the data rate by one
+  if (rx1DROffset > 3) {
+    NS_LOG_WARN ("LoRaWAN::GetRX1DataRateIndex Invalid rx1DROffset: " << static_cast<uint16_t>(rx1DROffset));
+    rx1DROffset = 0;
+  }
+  return std::min (13, std::max (8, 10 + upstreamDRIndex - rx1DROffset));
+}
+
+/****************************************************************************
+ ******************************** AS923 *************************************
+ ****************************************************************************/
+
+const LoRaWANChannel LoRaWANRegionTraits<LORAWAN_REGION_AS923>::channels[] = {
+  {0, 923200000, 125000, 0, 0, 6, true},
+  {1, 923400000, 125000, 0, 0, 6, true},
+  {2, 922200000, 125000, 0, 0, 6, true},
+  {3, 922400000, 125000, 0, 0, 6, true},
+  {4, 922600000, 125000, 0, 0, 6, true},
+  {5, 922800000, 125000, 0, 0, 6, true},
+  {6, 923000000, 125000, 0, 0, 6, true},
+  {7, 922000000, 125000, 0, 0, 6, true},
+};
+
+const LoRaWANDataRate LoRaWANRegionTraits<LORAWAN_REGION_AS923>::dataRates[] = {
+  {0, LORAWAN_SF12, 125000},
+  {1, LORAWAN_SF11, 125000},
+  {2, LORAWAN_SF10, 125000},
+  {3, LORAWAN_SF9, 125000},
+  {4, LORAWAN_SF8, 125000},
+  {5, LORAWAN_SF7, 125000},
+  {6, LORAWAN_SF7, 250000}
+}; // DR7 is FSK (not supported), other indexes are RFU
+
+const LoRaWANSubBandLimits LoRaWANRegionTraits<LORAWAN_REGION_AS923>::subBands[] = {
+  {100, 16}, // 1%, 16dBm EIRP
+};
+
+uint8_t
+LoRaWANRegionTraits<LORAWAN_REGION_AS923>::GetRX1DataRateIndex (uint8_t upstreamDRIndex, uint8_t rx1DROffset)
+{
+  // with DownlinkDwellTime 0, RX1DROffset 0-5 behave as in EU868 (6 and 7 are not supported)
+  return LoRaWANRegionTraits<LORAWAN_REGION_EU868>::GetRX1DataRateIndex (upstreamDRIndex, rx1DROffset);
+}
+
+} // namespace ns3
@@ -0,0 +1,147 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+#ifndef LORAWAN_REGION_H
+#define LORAWAN_REGION_H
+
+#include "lorawan.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup lorawan
+ *
+ * The channel plan of a region as per the LoRaWAN Regional Parameters, one
+ * specialization per LoRaWANRegion. LoRaWAN::SetRegion copies the tables of
+ * a specialization into LoRaWAN::m_supportedChannels and friends, so that the
+ * rest of the module is independent of the region.
+ *
+ * Every specialization has:
+ *  - nChannels, GetChannel (): the channels, uplink channels first
+ *  - nUplinkChannels: the number of uplink channels
+ *  - nChannelSubBands: the number of blocks of 8 uplink channels a gateway
+ *    can listen on, only the selected block is installed
+ *  - nDataRates, dataRates: the data rates, RFU data rates have bandwidth 0
+ *  - maxUplinkDataRateIndex: the highest data rate ADR assigns
+ *  - nSubBands, subBands: the duty cycle and max EIRP of every sub band
+ *  - the channel and data rate of RW2 and class B
+ *  - GetRX1ChannelIndex (), GetRX1DataRateIndex (): the RX1 mapping
+ *
+ * Dwell time limits, join channels and the channels an end device may add
+ * with NewChannelReq are not modelled.
+ */
+template <LoRaWANRegion region>
+struct LoRaWANRegionTraits;
+
+/**
+ * \ingroup lorawan
+ *
+ * EU863-870: the 3 default channels, 4 additional channels on 867.1-867.7 MHz
+ * and the high power RW2 channel on 869.525 MHz (sacrificing 867.9 MHz)
+ */
+template <>
+struct LoRaWANRegionTraits<LORAWAN_REGION_EU868>
+{
+  static const uint8_t nChannels = 8;
+  static const uint8_t nUplinkChannels = 7;
+  static const uint8_t nChannelSubBands = 1;
+  static const uint8_t nDataRates = 7;
+  static const uint8_t maxUplinkDataRateIndex = 5; // SF7
+  static const uint8_t nSubBands = 5;
+  static const uint8_t rw2ChannelIndex = 7; // high power channel
+  static const uint8_t rw2DataRateIndex = 0; // SF12
+  static const uint8_t classBChannelIndex = 7; // beacons are sent on the high power channel
+  static const uint8_t classBDataRateIndex = 3; // SF9
+
+  static const LoRaWANChannel channels[nChannels];
+  static const LoRaWANDataRate dataRates[nDataRates];
+  static const LoRaWANSubBandLimits subBands[nSubBands];
+
+  static LoRaWANChannel GetChannel (uint8_t channelIndex, uint8_t channelSubBand) { return channels[channelIndex]; }
+  static uint8_t GetRX1ChannelIndex (uint8_t upstreamChannelIndex) { return upstreamChannelIndex; }
+  static uint8_t GetRX1DataRateIndex (uint8_t upstreamDRIndex, uint8_t rx1DROffset);
+};
+
+/**
+ * \ingroup lorawan
+ *
+ * US902-928: 64 125kHz uplink channels (DR0-3) in 8 sub bands of 8 channels,
+ * and 8 500kHz downlink channels (DR8-13). Channels 0-7 are the uplink
+ * channels of the selected sub band, channels 8-15 the downlink channels.
+ * The 500kHz uplink channels (DR4) are not installed, as gateways only
+ * listen on them with a second radio.
+ *
+ * There is no duty cycle limit. As no gateway listens on the downlink
+ * channels, their PHYs are not attached to the spectrum channel, so an
+ * uplink costs no more to simulate than in EU868.
+ */
+template <>
+struct LoRaWANRegionTraits<LORAWAN_REGION_US915>
+{
+  static const uint8_t nChannels = 16;
+  static const uint8_t nUplinkChannels = 8;
+  static const uint8_t nChannelSubBands = 8;
+  static const uint8_t nDataRates = 14;
+  static const uint8_t maxUplinkDataRateIndex = 3; // SF7
+  static const uint8_t nSubBands = 2;
+  static const uint8_t rw2ChannelIndex = 8; // 923.3 MHz
+  static const uint8_t rw2DataRateIndex = 8; // SF12, 500kHz
+  static const uint8_t classBChannelIndex = 8; // no beacon frequency hopping
+  static const uint8_t classBDataRateIndex = 8; // SF12, 500kHz
+
+  static const LoRaWANDataRate dataRates[nDataRates];
+  static const LoRaWANSubBandLimits subBands[nSubBands];
+
+  static LoRaWANChannel GetChannel (uint8_t channelIndex, uint8_t channelSubBand);
+  static uint8_t GetRX1ChannelIndex (uint8_t upstreamChannelIndex) { return nUplinkChannels + upstreamChannelIndex % 8; }
+  static uint8_t GetRX1DataRateIndex (uint8_t upstreamDRIndex, uint8_t rx1DROffset);
+};
+
+/**
+ * \ingroup lorawan
+ *
+ * AS923: the 2 default channels on 923.2 and 923.4 MHz and 6 additional
+ * channels on 922.0-923.0 MHz, uplink dwell time limits off
+ */
+template <>
+struct LoRaWANRegionTraits<LORAWAN_REGION_AS923>
+{
+  static const uint8_t nChannels = 8;
+  static const uint8_t nUplinkChannels = 8;
+  static const uint8_t nChannelSubBands = 1;
+  static const uint8_t nDataRates = 7;
+  static const uint8_t maxUplinkDataRateIndex = 5; // SF7
+  static const uint8_t nSubBands = 1;
+  static const uint8_t rw2ChannelIndex = 0; // 923.2 MHz
+  static const uint8_t rw2DataRateIndex = 2; // SF10
+  static const uint8_t classBChannelIndex = 1; // 923.4 MHz
+  static const uint8_t classBDataRateIndex = 3; // SF9
+
+  static const LoRaWANChannel channels[nChannels];
+  static const LoRaWANDataRate dataRates[nDataRates];
+  static const LoRaWANSubBandLimits subBands[nSubBands];
+
+  static LoRaWANChannel GetChannel (uint8_t channelIndex, uint8_t channelSubBand) { return channels[channelIndex]; }
+  static uint8_t GetRX1ChannelIndex (uint8_t upstreamChannelIndex) { return upstreamChannelIndex; }
+  static uint8_t GetRX1DataRateIndex (uint8_t upstreamDRIndex, uint8_t rx1DROffset);
+};
+
+} // namespace ns3
+
+#endif /* LORAWAN_REGION_H */
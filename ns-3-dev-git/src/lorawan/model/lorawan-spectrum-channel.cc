@@ -0,0 +1,410 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+
+#include "lorawan-spectrum-channel.h"
+#include "lorawan-phy.h"
+#include "lorawan-spectrum-signal-parameters.h"
+
+#include <ns3/log.h>
+#include <ns3/simulator.h>
+#include <ns3/double.h>
+#include <ns3/node.h>
+#include <ns3/net-device.h>
+#include <ns3/mobility-model.h>
+#include <ns3/spectrum-phy.h>
+#include <ns3/spectrum-propagation-loss-model.h>
+#include <ns3/propagation-loss-model.h>
+#include <ns3/propagation-delay-model.h>
+#include <ns3/antenna-model.h>
+#include <ns3/angles.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("LoRaWANSpectrumChannel");
+
+NS_OBJECT_ENSURE_REGISTERED (LoRaWANSpectrumChannel);
+
+LoRaWANSpectrumChannel::LoRaWANSpectrumChannel ()
+  : m_nextTxId (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+TypeId
+LoRaWANSpectrumChannel::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::LoRaWANSpectrumChannel")
+    .SetParent<SpectrumChannel> ()
+    .SetGroupName ("LoRaWAN")
+    .AddConstructor<LoRaWANSpectrumChannel> ()
+    .AddAttribute ("MaxLossDb",
+                   "The maximum loss in dB for which transmissions are passed "
+                   "to the receiving PHY, as in SingleModelSpectrumChannel",
+                   DoubleValue (1.0e9),
+                   MakeDoubleAccessor (&LoRaWANSpectrumChannel::m_maxLossDb),
+                   MakeDoubleChecker<double> ())
+    .AddTraceSource ("PathLoss",
+                     "Fired whenever a new path loss value is calculated: "
+                     "the TX and RX SpectrumPhy and the loss in dB",
+                     MakeTraceSourceAccessor (&LoRaWANSpectrumChannel::m_pathLossTrace),
+                     "ns3::SpectrumChannel::LossTracedCallback")
+  ;
+  return tid;
+}
+
+void
+LoRaWANSpectrumChannel::DoDispose ()
+{
+  NS_LOG_FUNCTION (this);
+  m_phyList.clear ();
+  m_activeRx.clear ();
+  m_activeIndex.clear ();
+  m_detached.clear ();
+  m_inFlight.clear ();
+  m_armed.clear ();
+  m_spectrumModel = 0;
+  m_propagationDelay = 0;
+  m_propagationLoss = 0;
+  m_spectrumPropagationLoss = 0;
+  SpectrumChannel::DoDispose ();
+}
+
+void
+LoRaWANSpectrumChannel::AddRx (Ptr<SpectrumPhy> phy)
+{
+  NS_LOG_FUNCTION (this << phy);
+  m_phyList.push_back (phy);
+  m_activeIndex[PeekPointer (phy)] = m_activeRx.size ();
+  m_activeRx.push_back (phy);
+}
+
+void
+LoRaWANSpectrumChannel::DetachRx (Ptr<SpectrumPhy> phy)
+{
+  NS_LOG_FUNCTION (this << phy);
+
+  std::map<SpectrumPhy*, uint32_t>::iterator it = m_activeIndex.find (PeekPointer (phy));
+  if (it == m_activeIndex.end ()) {
+    return; // unknown or already detached
+  }
+
+  // swap with the last active receiver, the order of delivery does not matter
+  uint32_t index = it->second;
+  m_activeIndex.erase (it);
+  if (index != m_activeRx.size () - 1) {
+    m_activeRx[index] = m_activeRx.back ();
+    m_activeIndex[PeekPointer (m_activeRx[index])] = index;
+  }
+  m_activeRx.pop_back ();
+
+  m_detached[PeekPointer (phy)] = m_nextTxId;
+}
+
+void
+LoRaWANSpectrumChannel::AttachRx (Ptr<LoRaWANPhy> phy)
+{
+  NS_LOG_FUNCTION (this << phy);
+
+  std::map<SpectrumPhy*, uint64_t>::iterator it = m_detached.find (PeekPointer (phy));
+  if (it == m_detached.end ()) {
+    return; // unknown or already attached
+  }
+  uint64_t firstMissed = it->second;
+  m_detached.erase (it);
+
+  m_activeIndex[PeekPointer (phy)] = m_activeRx.size ();
+  m_activeRx.push_back (phy);
+
+  // replay the transmissions that were started while the PHY was detached
+  RemoveEndedTransmissions ();
+  const Time now = Simulator::Now ();
+  for (std::vector<InFlight>::const_iterator tx = m_inFlight.begin (); tx != m_inFlight.end (); ++tx)
+    {
+      if (tx->m_id < firstMissed || tx->m_txParams->txPhy == phy) {
+        continue;
+      }
+
+      Time delay;
+      Ptr<SpectrumSignalParameters> rxParams = GetRxParams (tx->m_txParams, phy, delay);
+      if (!rxParams) {
+        continue;
+      }
+
+      Time arrival = tx->m_start + delay;
+      Time end = arrival + rxParams->duration;
+      if (arrival >= now) {
+        ScheduleStartRx (rxParams, phy, arrival - now);
+      } else if (end > now) {
+        phy->StartRxInterference (rxParams, end - now);
+      }
+    }
+}
+
+uint32_t
+LoRaWANSpectrumChannel::GetNActiveRx (void) const
+{
+  return m_activeRx.size ();
+}
+
+void
+LoRaWANSpectrumChannel::ArmRx (Ptr<LoRaWANPhy> phy, uint8_t channelIndex, uint8_t dataRateIndex, Time until, Callback<void> wake)
+{
+  NS_LOG_FUNCTION (this << phy << static_cast<uint16_t> (channelIndex) << static_cast<uint16_t> (dataRateIndex) << until);
+  NS_ASSERT_MSG (m_detached.find (PeekPointer (phy)) != m_detached.end (), "Only a detached PHY can be armed");
+
+  ArmedRx armed;
+  armed.m_phy = phy;
+  armed.m_channelIndex = channelIndex;
+  armed.m_dataRateIndex = dataRateIndex;
+  armed.m_until = until;
+  armed.m_wake = wake;
+  m_armed.push_back (armed);
+}
+
+void
+LoRaWANSpectrumChannel::DisarmRx (Ptr<LoRaWANPhy> phy)
+{
+  NS_LOG_FUNCTION (this << phy);
+
+  uint32_t i = 0;
+  while (i < m_armed.size ())
+    {
+      if (m_armed[i].m_phy == phy) {
+        m_armed[i] = m_armed.back ();
+        m_armed.pop_back ();
+      } else {
+        i++;
+      }
+    }
+}
+
+void
+LoRaWANSpectrumChannel::WakeArmedRx (Ptr<SpectrumSignalParameters> txParams)
+{
+  Ptr<LoRaWANSpectrumSignalParameters> loraWanParams = DynamicCast<LoRaWANSpectrumSignalParameters> (txParams);
+  if (!loraWanParams) {
+    return; // only a LoRaWAN transmission can carry a downlink
+  }
+
+  const Time now = Simulator::Now ();
+  uint32_t i = 0;
+  while (i < m_armed.size ())
+    {
+      const ArmedRx& armed = m_armed[i];
+      if (armed.m_channelIndex != loraWanParams->channelIndex || armed.m_dataRateIndex != loraWanParams->dataRateIndex
+          || now >= armed.m_until || armed.m_phy == txParams->txPhy) {
+        i++;
+        continue;
+      }
+
+      NS_LOG_LOGIC (this << " waking " << armed.m_phy);
+      Ptr<NetDevice> netDev = armed.m_phy->GetDevice ();
+      if (netDev) {
+        Simulator::ScheduleWithContext (netDev->GetNode ()->GetId (), Seconds (0), &LoRaWANSpectrumChannel::Wake, armed.m_wake);
+      } else {
+        Simulator::ScheduleNow (&LoRaWANSpectrumChannel::Wake, armed.m_wake);
+      }
+      // the PHY is woken once, its other armed receptions are dropped as well
+      DisarmRx (armed.m_phy);
+      i = 0;
+    }
+}
+
+void
+LoRaWANSpectrumChannel::Wake (Callback<void> wake)
+{
+  wake ();
+}
+
+void
+LoRaWANSpectrumChannel::StartTx (Ptr<SpectrumSignalParameters> txParams)
+{
+  NS_LOG_FUNCTION (this << txParams->psd << txParams->duration << txParams->txPhy);
+  NS_ASSERT_MSG (txParams->psd, "NULL txPsd");
+  NS_ASSERT_MSG (txParams->txPhy, "NULL txPhy");
+
+  if (m_spectrumModel == 0) {
+    m_spectrumModel = txParams->psd->GetSpectrumModel ();
+  } else {
+    // all attached SpectrumPhy instances must use the same SpectrumModel
+    NS_ASSERT (*(txParams->psd->GetSpectrumModel ()) == *m_spectrumModel);
+  }
+
+  // Only a PHY that is currently detached can miss this transmission and ask for it later
+  if (!m_detached.empty ()) {
+    RemoveEndedTransmissions ();
+    InFlight tx;
+    tx.m_id = m_nextTxId;
+    tx.m_txParams = txParams;
+    tx.m_start = Simulator::Now ();
+    m_inFlight.push_back (tx);
+  }
+  m_nextTxId++;
+
+  for (std::vector<Ptr<SpectrumPhy> >::const_iterator rx = m_activeRx.begin (); rx != m_activeRx.end (); ++rx)
+    {
+      if (*rx == txParams->txPhy) {
+        continue;
+      }
+
+      Time delay;
+      Ptr<SpectrumSignalParameters> rxParams = GetRxParams (txParams, *rx, delay);
+      if (rxParams) {
+        ScheduleStartRx (rxParams, *rx, delay);
+      }
+    }
+
+  if (!m_armed.empty ()) {
+    WakeArmedRx (txParams);
+  }
+}
+
+Ptr<SpectrumSignalParameters>
+LoRaWANSpectrumChannel::GetRxParams (Ptr<SpectrumSignalParameters> txParams, Ptr<SpectrumPhy> receiver, Time& delay)
+{
+  NS_LOG_FUNCTION (this << txParams << receiver);
+
+  delay = MicroSeconds (0);
+  Ptr<SpectrumSignalParameters> rxParams = txParams->Copy ();
+
+  Ptr<MobilityModel> senderMobility = txParams->txPhy->GetMobility ();
+  Ptr<MobilityModel> receiverMobility = receiver->GetMobility ();
+  if (!senderMobility || !receiverMobility) {
+    return rxParams;
+  }
+
+  double pathLossDb = 0;
+  if (rxParams->txAntenna != 0) {
+    Angles txAngles (receiverMobility->GetPosition (), senderMobility->GetPosition ());
+    pathLossDb -= rxParams->txAntenna->GetGainDb (txAngles);
+  }
+  Ptr<AntennaModel> rxAntenna = receiver->GetRxAntenna ();
+  if (rxAntenna != 0) {
+    Angles rxAngles (senderMobility->GetPosition (), receiverMobility->GetPosition ());
+    pathLossDb -= rxAntenna->GetGainDb (rxAngles);
+  }
+  if (m_propagationLoss) {
+    pathLossDb -= m_propagationLoss->CalcRxPower (0, senderMobility, receiverMobility);
+  }
+  NS_LOG_LOGIC ("total pathLoss = " << pathLossDb << " dB");
+  m_pathLossTrace (txParams->txPhy, receiver, pathLossDb);
+  if (pathLossDb > m_maxLossDb) {
+    return 0; // beyond range
+  }
+  *(rxParams->psd) *= std::pow (10.0, (-pathLossDb) / 10.0);
+
+  if (m_spectrumPropagationLoss) {
+    rxParams->psd = m_spectrumPropagationLoss->CalcRxPowerSpectralDensity (rxParams->psd, senderMobility, receiverMobility);
+  }
+  if (m_propagationDelay) {
+    delay = m_propagationDelay->GetDelay (senderMobility, receiverMobility);
+  }
+  return rxParams;
+}
+
+void
+LoRaWANSpectrumChannel::ScheduleStartRx (Ptr<SpectrumSignalParameters> rxParams, Ptr<SpectrumPhy> receiver, Time delay)
+{
+  Ptr<NetDevice> netDev = receiver->GetDevice ();
+  if (netDev) {
+    // the receiver has a NetDevice, so we expect that it is attached to a Node
+    Simulator::ScheduleWithContext (netDev->GetNode ()->GetId (), delay,
+                                    &LoRaWANSpectrumChannel::StartRx, this, rxParams, receiver);
+  } else {
+    Simulator::Schedule (delay, &LoRaWANSpectrumChannel::StartRx, this, rxParams, receiver);
+  }
+}
+
+void
+LoRaWANSpectrumChannel::StartRx (Ptr<SpectrumSignalParameters> params, Ptr<SpectrumPhy> receiver)
+{
+  NS_LOG_FUNCTION (this << params);
+  receiver->StartRx (params);
+}
+
+void
+LoRaWANSpectrumChannel::RemoveEndedTransmissions (void)
+{
+  // Propagation delays within LoRaWAN cells are in the order of microseconds:
+  // a transmission that ended a millisecond ago has reached every receiver.
+  const Time horizon = Simulator::Now () - MilliSeconds (1);
+  std::vector<InFlight>::iterator it = m_inFlight.begin ();
+  for (std::vector<InFlight>::iterator tx = m_inFlight.begin (); tx != m_inFlight.end (); ++tx)
+    {
+      if (tx->m_start + tx->m_txParams->duration >= horizon) {
+        *it++ = *tx;
+      }
+    }
+  m_inFlight.erase (it, m_inFlight.end ());
+}
+
+uint32_t
+LoRaWANSpectrumChannel::GetNDevices (void) const
+{
+  return m_phyList.size ();
+}
+
+Ptr<NetDevice>
+LoRaWANSpectrumChannel::GetDevice (uint32_t i) const
+{
+  return m_phyList.at (i)->GetDevice ()->GetObject<NetDevice> ();
+}
+
+void
+LoRaWANSpectrumChannel::AddPropagationLossModel (Ptr<PropagationLossModel> loss)
+{
+  NS_LOG_FUNCTION (this << loss);
+  NS_ASSERT (m_propagationLoss == 0);
+  m_propagationLoss = loss;
+}
+
+void
+LoRaWANSpectrumChannel::SetPropagationLossModel (Ptr<PropagationLossModel> loss)
+{
+  NS_LOG_FUNCTION (this << loss);
+  m_propagationLoss = loss;
+}
+
+void
+LoRaWANSpectrumChannel::AddSpectrumPropagationLossModel (Ptr<SpectrumPropagationLossModel> loss)
+{
+  NS_LOG_FUNCTION (this << loss);
+  NS_ASSERT (m_spectrumPropagationLoss == 0);
+  m_spectrumPropagationLoss = loss;
+}
+
+void
+LoRaWANSpectrumChannel::SetPropagationDelayModel (Ptr<PropagationDelayModel> delay)
+{
+  NS_LOG_FUNCTION (this << delay);
+  NS_ASSERT (m_propagationDelay == 0);
+  m_propagationDelay = delay;
+}
+
+Ptr<SpectrumPropagationLossModel>
+LoRaWANSpectrumChannel::GetSpectrumPropagationLossModel (void)
+{
+  return m_spectrumPropagationLoss;
+}
+
+} // namespace ns3
@@ -0,0 +1,172 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+
+#ifndef LORAWAN_SPECTRUM_CHANNEL_H
+#define LORAWAN_SPECTRUM_CHANNEL_H
+
+#include <ns3/spectrum-channel.h>
+#include <ns3/spectrum-model.h>
+#include <ns3/traced-callback.h>
+#include <ns3/callback.h>
+#include <ns3/nstime.h>
+
+#include <map>
+#include <vector>
+
+namespace ns3 {
+
+class LoRaWANPhy;
+
+/**
+ * \ingroup lorawan
+ *
+ * \brief SpectrumChannel for a single spectrum model whose receivers can be
+ * detached while they are not listening
+ *
+ * This channel behaves as a SingleModelSpectrumChannel, except that a PHY
+ * can leave the set of active receivers with DetachRx. Transmissions are
+ * not delivered to detached PHYs, which saves a StartRx/EndRx pair (and
+ * the copy of the signal parameters and the path loss computation) per
+ * sleeping end device and uplink.
+ *
+ * The channel keeps the transmissions that are still on air. When a PHY
+ * rejoins with AttachRx, the transmissions it missed are replayed: those
+ * that have not reached the PHY yet are delivered as usual, those that
+ * are already arriving are added to the interference of the PHY for their
+ * remaining duration (see LoRaWANPhy::StartRxInterference).
+ */
+class LoRaWANSpectrumChannel : public SpectrumChannel
+{
+public:
+  LoRaWANSpectrumChannel ();
+
+  static TypeId GetTypeId (void);
+
+  // inherited from SpectrumChannel
+  virtual void AddPropagationLossModel (Ptr<PropagationLossModel> loss);
+  virtual void AddSpectrumPropagationLossModel (Ptr<SpectrumPropagationLossModel> loss);
+  virtual void SetPropagationDelayModel (Ptr<PropagationDelayModel> delay);
+  virtual void AddRx (Ptr<SpectrumPhy> phy);
+  virtual void StartTx (Ptr<SpectrumSignalParameters> params);
+  virtual Ptr<SpectrumPropagationLossModel> GetSpectrumPropagationLossModel (void);
+
+  // inherited from Channel
+  virtual uint32_t GetNDevices (void) const;
+  virtual Ptr<NetDevice> GetDevice (uint32_t i) const;
+
+  /**
+   * \brief Replace the propagation loss model of the channel
+   *
+   * Unlike AddPropagationLossModel, the channel may already have a loss model.
+   */
+  void SetPropagationLossModel (Ptr<PropagationLossModel> loss);
+
+  /**
+   * \brief Stop delivering transmissions to a PHY added with AddRx
+   */
+  void DetachRx (Ptr<SpectrumPhy> phy);
+
+  /**
+   * \brief Deliver transmissions to a detached PHY again
+   *
+   * The transmissions started while the PHY was detached and still on air
+   * are replayed to the PHY.
+   */
+  void AttachRx (Ptr<LoRaWANPhy> phy);
+
+  /**
+   * \return the number of PHYs to which transmissions are delivered
+   */
+  uint32_t GetNActiveRx (void) const;
+
+  /**
+   * \brief Call back a detached PHY when a transmission on a channel and data rate starts
+   *
+   * The first transmission with the given channel and data rate index that
+   * starts before \p until schedules \p wake right away, in the context of
+   * the node of the PHY, and disarms the PHY (a PHY can be armed for
+   * several channels and data rates at once). The PHY stays detached: when
+   * it rejoins with AttachRx the transmission is replayed to it as usual.
+   * This lets a class A end device skip its receive windows when nothing
+   * is sent in them, see LoRaWANMac.
+   */
+  void ArmRx (Ptr<LoRaWANPhy> phy, uint8_t channelIndex, uint8_t dataRateIndex, Time until, Callback<void> wake);
+
+  /**
+   * \brief Forget everything the PHY was armed for with ArmRx
+   */
+  void DisarmRx (Ptr<LoRaWANPhy> phy);
+
+private:
+  /** A transmission that may still be on air at some receiver */
+  struct InFlight
+  {
+    uint64_t m_id;
+    Ptr<SpectrumSignalParameters> m_txParams;
+    Time m_start;
+  };
+
+  /** A detached PHY waiting for a transmission, see ArmRx */
+  struct ArmedRx
+  {
+    Ptr<LoRaWANPhy> m_phy;
+    uint8_t m_channelIndex;
+    uint8_t m_dataRateIndex;
+    Time m_until;
+    Callback<void> m_wake;
+  };
+
+  virtual void DoDispose ();
+
+  /**
+   * \brief Compute the parameters of a transmission at a receiver
+   * \param delay set to the propagation delay to the receiver
+   * \return the parameters, or 0 when the receiver is out of range
+   */
+  Ptr<SpectrumSignalParameters> GetRxParams (Ptr<SpectrumSignalParameters> txParams,
+                                             Ptr<SpectrumPhy> receiver, Time& delay);
+  void ScheduleStartRx (Ptr<SpectrumSignalParameters> rxParams, Ptr<SpectrumPhy> receiver, Time delay);
+  void StartRx (Ptr<SpectrumSignalParameters> params, Ptr<SpectrumPhy> receiver);
+  void RemoveEndedTransmissions (void);
+  void WakeArmedRx (Ptr<SpectrumSignalParameters> txParams);
+  static void Wake (Callback<void> wake);
+
+  std::vector<Ptr<SpectrumPhy> > m_phyList;  //!< all PHYs, attached or not
+  std::vector<Ptr<SpectrumPhy> > m_activeRx;
+  std::map<SpectrumPhy*, uint32_t> m_activeIndex;  //!< position of an attached PHY in m_activeRx
+  std::map<SpectrumPhy*, uint64_t> m_detached;  //!< id of the first transmission a detached PHY missed
+
+  std::vector<InFlight> m_inFlight;  //!< ordered by id
+  uint64_t m_nextTxId;
+
+  std::vector<ArmedRx> m_armed;  //!< few entries: end devices between an uplink and its receive windows
+
+  Ptr<const SpectrumModel> m_spectrumModel;
+  Ptr<PropagationDelayModel> m_propagationDelay;
+  Ptr<PropagationLossModel> m_propagationLoss;
+  Ptr<SpectrumPropagationLossModel> m_spectrumPropagationLoss;
+  double m_maxLossDb;
+
+  TracedCallback<Ptr<SpectrumPhy>, Ptr<SpectrumPhy>, double > m_pathLossTrace;
+};
+
+} // namespace ns3
+
+#endif /* LORAWAN_SPECTRUM_CHANNEL_H */
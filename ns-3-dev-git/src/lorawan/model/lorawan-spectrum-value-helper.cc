@@ -32,50 +32,32 @@ Ptr<SpectrumModel> g_LoRaWANSpectrumModel; //!< Global object that stores the Lo
 
 /**
  * \ingroup lorawan
- * \brief Helper class used to automatically initialize the LoRaWAN Spectrum Model objects
+ * \brief Get the LoRaWAN Spectrum Model, with a band for every channel of the
+ * region in use. For EU868: the three default 125kHz data channels
+ * (868.10, 868.30 & 868.50MHz), four 125kHz channels (867.10 - 867.70MHz) and
+ * the 125kHz high power (27dBm) channel on 869.525MHz.
  */
-class LoRaWANSpectrumModelInitializer
+static Ptr<SpectrumModel>
+GetLoRaWANSpectrumModel (void)
 {
-public:
-  LoRaWANSpectrumModelInitializer(void)
-  {
-    NS_LOG_FUNCTION (this);
-
-    Bands bands;
-    // The three default 125kHz data channels available in EU863-870:
-    // 868.10, 868.30 & 868.50MHz
-    for (int i = 0; i < 3; i++)
-      {
-        BandInfo bi;
-        bi.fc = 868.10e6 + i * 200.0e3;
-        bi.fl = bi.fc - 62.5e3; // 62.5 kHz is half of 125 kHz bandwidth
-        bi.fh = bi.fc + 62.5e3;
-        bands.push_back (bi);
-      }
-
-    // Four 125kHz channels available in EU863-870:
-    // 867.10, 867.30 & 867.50 & 867.70MHz
-    for (int i = 0; i < 4; i++)
-      {
-        BandInfo bi;
-        bi.fc = 867.10e6 + i * 200.0e3;
-        bi.fl = bi.fc - 62.5e3; // 62.5 kHz is half of 125 kHz bandwidth
-        bi.fh = bi.fc + 62.5e3;
-        bands.push_back (bi);
-      }
-
-    // One 125kHz high power (27dBm) channel on 869.525MHz
+  if (g_LoRaWANSpectrumModel == 0)
     {
-        BandInfo bi;
-        bi.fc = 869.525e6;
-        bi.fl = bi.fc - 62.5e3; // 62.5 kHz is half of 125 kHz bandwidth
-        bi.fh = bi.fc + 62.5e3;
-        bands.push_back (bi);
+      NS_LOG_FUNCTION_NOARGS ();
+
+      Bands bands;
+      for (uint8_t i = 0; i < LoRaWAN::m_supportedChannels.size (); i++)
+        {
+          BandInfo bi;
+          bi.fc = LoRaWAN::m_supportedChannels[i].m_fc;
+          bi.fl = bi.fc - LoRaWAN::m_supportedChannels[i].m_bw / 2.0;
+          bi.fh = bi.fc + LoRaWAN::m_supportedChannels[i].m_bw / 2.0;
+          bands.push_back (bi);
+        }
+      g_LoRaWANSpectrumModel = Create<SpectrumModel> (bands);
     }
-    g_LoRaWANSpectrumModel = Create<SpectrumModel> (bands);
-  }
+  return g_LoRaWANSpectrumModel;
+}
 
-} g_LoRaWANSpectrumModelInitializerInstance; //!< Global object used to initialize the LoRaWAN Spectrum Model
 
 /* ... */
 LoRaWANSpectrumValueHelper::LoRaWANSpectrumValueHelper(void)
@@ -102,14 +84,15 @@ LoRaWANSpectrumValueHelper::CreateTxPowerSpectralDensity (double txPower, uint32
   // all signal power is concentrated in the channel
 
   NS_LOG_FUNCTION (this);
-  Ptr<SpectrumValue> txPsd = Create <SpectrumValue> (g_LoRaWANSpectrumModel);
+  Ptr<SpectrumValue> txPsd = Create <SpectrumValue> (GetLoRaWANSpectrumModel ());
 
   // txPower is expressed in dBm. We must convert it into natural unit (W).
   txPower = pow (10.0, (txPower - 30) / 10);
 
-  double txPowerDensity = txPower / 125e3;
+  const uint32_t index = LoRaWANSpectrumValueHelper::GetPsdIndexForCenterFrequency(freq);
+  double txPowerDensity = txPower / LoRaWAN::m_supportedChannels[index].m_bw;
 
-  (*txPsd)[LoRaWANSpectrumValueHelper::GetPsdIndexForCenterFrequency(freq)] = txPowerDensity;
+  (*txPsd)[index] = txPowerDensity;
 
   return txPsd;
 }
@@ -119,7 +102,7 @@ LoRaWANSpectrumValueHelper::CreateNoisePowerSpectralDensity (uint32_t freq)
 {
   // TODO: does this makes sense? this would only model noise in one channel.
   NS_LOG_FUNCTION (this);
-  Ptr<SpectrumValue> noisePsd = Create <SpectrumValue> (g_LoRaWANSpectrumModel);
+  Ptr<SpectrumValue> noisePsd = Create <SpectrumValue> (GetLoRaWANSpectrumModel ());
 
   static const double BOLTZMANN = 1.3803e-23;
   // Nt  is the power of thermal noise in W
@@ -136,6 +119,13 @@ LoRaWANSpectrumValueHelper::CreateNoisePowerSpectralDensity (uint32_t freq)
   return noisePsd;
 }
 
+void
+LoRaWANSpectrumValueHelper::ResetSpectrumModel (void)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+  g_LoRaWANSpectrumModel = 0;
+}
+
 void 
 LoRaWANSpectrumValueHelper::UpdateNoiseFactor(double noiseFactor)
 {
@@ -165,12 +155,13 @@ LoRaWANSpectrumValueHelper::TotalAvgPower (Ptr<const SpectrumValue> psd, uint32_
   NS_LOG_FUNCTION (psd);
   double totalAvgPower = 0.0;
 
-  NS_ASSERT (psd->GetSpectrumModel () == g_LoRaWANSpectrumModel);
+  NS_ASSERT (psd->GetSpectrumModel () == GetLoRaWANSpectrumModel ());
 
-  // numerically integrate to get area under psd using 125kHz resolution
+  // numerically integrate to get area under psd using the bandwidth of the channel as resolution
 
-  totalAvgPower += (*psd)[LoRaWANSpectrumValueHelper::GetPsdIndexForCenterFrequency(freq)];
-  totalAvgPower *= 125e3;
+  const uint32_t index = LoRaWANSpectrumValueHelper::GetPsdIndexForCenterFrequency(freq);
+  totalAvgPower += (*psd)[index];
+  totalAvgPower *= LoRaWAN::m_supportedChannels[index].m_bw;
 
   return totalAvgPower;
 }
@@ -64,6 +64,12 @@ public:
   static double TotalAvgPower (Ptr<const SpectrumValue> psd, uint32_t channel);
 
   void UpdateNoiseFactor(double noiseFactor);
+
+  /**
+   * \brief Rebuild the spectrum model from LoRaWAN::m_supportedChannels when
+   * it is next used, after the channels changed
+   */
+  static void ResetSpectrumModel (void);
   
 private:
   static uint32_t GetPsdIndexForCenterFrequency(uint32_t freq);
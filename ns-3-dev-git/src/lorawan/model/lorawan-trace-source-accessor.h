@@ -0,0 +1,117 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+
+#ifndef LORAWAN_TRACE_SOURCE_ACCESSOR_H
+#define LORAWAN_TRACE_SOURCE_ACCESSOR_H
+
+#include <ns3/trace-source-accessor.h>
+#include <ns3/traced-value.h>
+#include <ns3/ptr.h>
+
+#include <string>
+
+namespace ns3 {
+
+/**
+ * \ingroup lorawan
+ *
+ * TraceSourceAccessor for a TracedValue that also counts the sinks
+ * connected through it, so that the object owning the trace source can
+ * tell whether anybody listens (TracedCallback can not tell).
+ *
+ * Used for the MacState and TrxState trace sources: while they have no
+ * sinks, LoRaWANMac skips the intermediate steps of the class A receive
+ * windows.
+ */
+template <typename T, typename V>
+class LoRaWANCountingTraceSourceAccessor : public TraceSourceAccessor
+{
+public:
+  LoRaWANCountingTraceSourceAccessor (TracedValue<V> T::*source, uint32_t T::*nSinks)
+    : m_source (source), m_nSinks (nSinks)
+  {
+  }
+
+  virtual bool ConnectWithoutContext (ObjectBase *obj, const CallbackBase &cb) const
+  {
+    T *p = dynamic_cast<T *> (obj);
+    if (p == 0)
+      return false;
+    (p->*m_source).ConnectWithoutContext (cb);
+    (p->*m_nSinks)++;
+    return true;
+  }
+
+  virtual bool Connect (ObjectBase *obj, std::string context, const CallbackBase &cb) const
+  {
+    T *p = dynamic_cast<T *> (obj);
+    if (p == 0)
+      return false;
+    (p->*m_source).Connect (cb, context);
+    (p->*m_nSinks)++;
+    return true;
+  }
+
+  virtual bool DisconnectWithoutContext (ObjectBase *obj, const CallbackBase &cb) const
+  {
+    T *p = dynamic_cast<T *> (obj);
+    if (p == 0)
+      return false;
+    (p->*m_source).DisconnectWithoutContext (cb);
+    if (p->*m_nSinks > 0)
+      (p->*m_nSinks)--;
+    return true;
+  }
+
+  virtual bool Disconnect (ObjectBase *obj, std::string context, const CallbackBase &cb) const
+  {
+    T *p = dynamic_cast<T *> (obj);
+    if (p == 0)
+      return false;
+    (p->*m_source).Disconnect (cb, context);
+    if (p->*m_nSinks > 0)
+      (p->*m_nSinks)--;
+    return true;
+  }
+
+private:
+  TracedValue<V> T::*m_source;
+  uint32_t T::*m_nSinks;
+};
+
+/**
+ * \ingroup lorawan
+ *
+ * \brief Create a LoRaWANCountingTraceSourceAccessor
+ *
+ * \param source the TracedValue member
+ * \param nSinks the member that counts the sinks of \p source, must start at 0
+ * \return the accessor
+ */
+template <typename T, typename V>
+Ptr<const TraceSourceAccessor>
+MakeLoRaWANCountingTraceSourceAccessor (TracedValue<V> T::*source, uint32_t T::*nSinks)
+{
+  return Ptr<const TraceSourceAccessor> (new LoRaWANCountingTraceSourceAccessor<T, V> (source, nSinks), false);
+}
+
+} // namespace ns3
+
+#endif /* LORAWAN_TRACE_SOURCE_ACCESSOR_H */
@@ -0,0 +1,330 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+
+#include "lorawan-traffic-generator.h"
+#include <ns3/log.h>
+#include <ns3/simulator.h>
+#include <ns3/random-variable-stream.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("LoRaWANTrafficGenerator");
+
+NS_OBJECT_ENSURE_REGISTERED (LoRaWANTrafficGenerator);
+
+TypeId
+LoRaWANTrafficGenerator::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::LoRaWANTrafficGenerator")
+    .SetParent<Object> ()
+    .SetGroupName ("LoRaWAN")
+    .AddConstructor<LoRaWANTrafficGenerator> ()
+    .AddAttribute ("BucketWidth",
+                   "Width of the buckets in which the send times of sources with a non exponential inter arrival time are kept",
+                   TimeValue (Seconds (1.0)),
+                   MakeTimeAccessor (&LoRaWANTrafficGenerator::m_bucketWidth),
+                   MakeTimeChecker (NanoSeconds (1)))
+  ;
+  return tid;
+}
+
+LoRaWANTrafficGenerator::LoRaWANTrafficGenerator ()
+  : m_nSources (0),
+    m_nPoissonSources (0),
+    m_totalRate (0.0),
+    m_sortedBucket (std::numeric_limits<int64_t>::min ()),
+    m_poissonIAT (CreateObject<ExponentialRandomVariable> ()),
+    m_pick (CreateObject<UniformRandomVariable> ())
+{
+  NS_LOG_FUNCTION (this);
+}
+
+LoRaWANTrafficGenerator::~LoRaWANTrafficGenerator ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+LoRaWANTrafficGenerator::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  m_event.Cancel ();
+  m_sources.clear ();
+  m_rateTree.clear ();
+  m_buckets.clear ();
+  m_poissonIAT = 0;
+  m_pick = 0;
+  Object::DoDispose ();
+}
+
+int64_t
+LoRaWANTrafficGenerator::AssignStreams (int64_t stream)
+{
+  NS_LOG_FUNCTION (this << stream);
+  m_poissonIAT->SetStream (stream);
+  m_pick->SetStream (stream + 1);
+  return 2;
+}
+
+uint32_t
+LoRaWANTrafficGenerator::AddSource (Ptr<RandomVariableStream> iat, Time firstSend, Callback<void> send)
+{
+  NS_LOG_FUNCTION (this << iat << firstSend);
+  NS_ASSERT (iat);
+
+  Source source;
+  source.m_send = send;
+  source.m_iat = iat;
+  source.m_rate = 0.0;
+  source.m_generation = 0;
+  source.m_active = true;
+
+  // A bounded exponential variable is not memoryless, so it can not be part of the Poisson process
+  Ptr<ExponentialRandomVariable> exponential = DynamicCast<ExponentialRandomVariable> (iat);
+  if (exponential && exponential->GetBound () == 0.0 && exponential->GetMean () > 0.0)
+    source.m_rate = 1.0 / exponential->GetMean ();
+
+  const uint32_t id = m_sources.size ();
+  m_sources.push_back (source);
+  m_nSources++;
+
+  AddRate (id, source.m_rate);
+  if (source.m_rate > 0.0) {
+    m_nPoissonSources++;
+    DrawNextPoisson (); // memoryless, so redrawing on a rate change is exact
+  } else {
+    AddBucketEntry (id, Simulator::Now () + firstSend);
+  }
+
+  Reschedule ();
+  return id;
+}
+
+void
+LoRaWANTrafficGenerator::RemoveSource (uint32_t id)
+{
+  NS_LOG_FUNCTION (this << id);
+  NS_ASSERT (id < m_sources.size ());
+
+  Source& source = m_sources[id];
+  if (!source.m_active)
+    return;
+
+  source.m_active = false;
+  source.m_generation++;
+  m_nSources--;
+
+  if (source.m_rate > 0.0) {
+    m_nPoissonSources--;
+    if (m_nPoissonSources == 0) {
+      // do not leave the rounding errors of all additions and removals behind
+      std::fill (m_rateTree.begin (), m_rateTree.end (), 0.0);
+      m_totalRate = 0.0;
+    } else {
+      AddRate (id, -source.m_rate);
+    }
+    source.m_rate = 0.0;
+    DrawNextPoisson ();
+  }
+
+  Reschedule ();
+}
+
+void
+LoRaWANTrafficGenerator::ScheduleNext (uint32_t id)
+{
+  NS_LOG_FUNCTION (this << id);
+  NS_ASSERT (id < m_sources.size ());
+
+  const Source& source = m_sources[id];
+  if (!source.m_active || source.m_rate > 0.0)
+    return;
+
+  AddBucketEntry (id, Simulator::Now () + Seconds (source.m_iat->GetValue ()));
+  Reschedule ();
+}
+
+uint32_t
+LoRaWANTrafficGenerator::GetNSources (void) const
+{
+  return m_nSources;
+}
+
+uint32_t
+LoRaWANTrafficGenerator::GetNPoissonSources (void) const
+{
+  return m_nPoissonSources;
+}
+
+double
+LoRaWANTrafficGenerator::GetPoissonRate (void) const
+{
+  return m_totalRate;
+}
+
+void
+LoRaWANTrafficGenerator::Fire (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  BucketEntry entry;
+  const bool haveBucketEntry = GetEarliestBucketEntry (entry);
+  uint32_t id;
+
+  if (m_totalRate > 0.0 && (!haveBucketEntry || m_nextPoisson <= entry.first.first)) {
+    NS_ASSERT (m_nextPoisson == Simulator::Now ());
+    id = PickPoissonSource (m_pick->GetValue (0.0, m_totalRate));
+    DrawNextPoisson ();
+  } else {
+    NS_ASSERT (haveBucketEntry && entry.first.first == Simulator::Now ());
+    id = entry.first.second;
+    std::vector<BucketEntry>& bucket = m_buckets.begin ()->second;
+    bucket.pop_back ();
+    if (bucket.empty ())
+      m_buckets.erase (m_buckets.begin ());
+  }
+
+  NS_LOG_LOGIC (this << " uplink of source " << id);
+
+  // Reschedules itself, as the callback is likely to call ScheduleNext
+  m_sources[id].m_send ();
+  Reschedule ();
+}
+
+void
+LoRaWANTrafficGenerator::Reschedule (void)
+{
+  Time next = Time::Max ();
+  if (m_totalRate > 0.0)
+    next = m_nextPoisson;
+
+  BucketEntry entry;
+  if (GetEarliestBucketEntry (entry))
+    next = std::min (next, entry.first.first);
+
+  if (!m_event.IsExpired ()) {
+    if (m_event.GetTs () == (uint64_t)next.GetTimeStep ())
+      return;
+    Simulator::Remove (m_event);
+  }
+
+  if (next != Time::Max ())
+    m_event = Simulator::Schedule (next - Simulator::Now (), &LoRaWANTrafficGenerator::Fire, this);
+}
+
+void
+LoRaWANTrafficGenerator::DrawNextPoisson (void)
+{
+  if (m_totalRate > 0.0)
+    m_nextPoisson = Simulator::Now () + Seconds (m_poissonIAT->GetValue (1.0 / m_totalRate, 0.0));
+}
+
+void
+LoRaWANTrafficGenerator::AddBucketEntry (uint32_t id, Time when)
+{
+  const int64_t index = when.GetTimeStep () / m_bucketWidth.GetTimeStep ();
+  const BucketEntry entry (Entry (when, id), m_sources[id].m_generation);
+
+  std::vector<BucketEntry>& bucket = m_buckets[index];
+  if (index == m_sortedBucket) {
+    // latest first, so that the earliest entry can be popped from the back
+    bucket.insert (std::upper_bound (bucket.begin (), bucket.end (), entry, std::greater<BucketEntry> ()), entry);
+  } else {
+    bucket.push_back (entry);
+  }
+}
+
+bool
+LoRaWANTrafficGenerator::GetEarliestBucketEntry (BucketEntry& entry)
+{
+  while (!m_buckets.empty ()) {
+    auto it = m_buckets.begin ();
+    std::vector<BucketEntry>& bucket = it->second;
+    if (it->first != m_sortedBucket) {
+      std::sort (bucket.begin (), bucket.end (), std::greater<BucketEntry> ());
+      m_sortedBucket = it->first;
+    }
+
+    // drop the send times of removed sources
+    while (!bucket.empty () && bucket.back ().second != m_sources[bucket.back ().first.second].m_generation)
+      bucket.pop_back ();
+
+    if (!bucket.empty ()) {
+      entry = bucket.back ();
+      return true;
+    }
+    m_buckets.erase (it);
+  }
+  return false;
+}
+
+void
+LoRaWANTrafficGenerator::AddRate (uint32_t id, double rate)
+{
+  const uint32_t n = id + 1; // the tree is 1-based
+
+  if (n > m_rateTree.size ()) {
+    // append: the new node covers (n - lowbit (n), n], of which all but n itself are already in the tree
+    NS_ASSERT (n == m_rateTree.size () + 1);
+    double sum = rate;
+    const uint32_t lowest = n - (n & (~n + 1));
+    for (uint32_t i = n - 1; i > lowest; i -= (i & (~i + 1)))
+      sum += m_rateTree[i - 1];
+    m_rateTree.push_back (sum);
+  } else {
+    for (uint32_t i = n; i <= m_rateTree.size (); i += (i & (~i + 1)))
+      m_rateTree[i - 1] += rate;
+  }
+
+  m_totalRate += rate;
+}
+
+uint32_t
+LoRaWANTrafficGenerator::PickPoissonSource (double value) const
+{
+  // smallest index whose prefix sum exceeds value
+  const uint32_t size = m_rateTree.size ();
+  uint32_t step = 1;
+  while (step * 2 <= size)
+    step *= 2;
+
+  uint32_t pos = 0;
+  for (; step > 0; step /= 2) {
+    if (pos + step <= size && m_rateTree[pos + step - 1] <= value) {
+      pos += step;
+      value -= m_rateTree[pos - 1];
+    }
+  }
+
+  // rounding may push value past the last source with a rate
+  if (pos >= size)
+    pos = size - 1;
+  while (pos > 0 && m_sources[pos].m_rate == 0.0)
+    pos--;
+
+  NS_ASSERT (m_sources[pos].m_rate > 0.0);
+  return pos;
+}
+
+} // namespace ns3
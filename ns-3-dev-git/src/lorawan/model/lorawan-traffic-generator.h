@@ -0,0 +1,140 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+
+#ifndef LORAWAN_TRAFFIC_GENERATOR_H
+#define LORAWAN_TRAFFIC_GENERATOR_H
+
+#include <ns3/object.h>
+#include <ns3/nstime.h>
+#include <ns3/event-id.h>
+#include <ns3/callback.h>
+
+#include <map>
+#include <vector>
+
+namespace ns3 {
+
+class RandomVariableStream;
+class ExponentialRandomVariable;
+class UniformRandomVariable;
+
+/**
+ * \ingroup lorawan
+ *
+ * Fleet level uplink traffic source.
+ *
+ * Normally every end device application keeps its own pending SendPacket
+ * event, so the scheduler holds one event per end device at all times. End
+ * devices that share a traffic generator (see the TrafficGenerator attribute
+ * of LoRaWANEndDeviceApplication) register their send callback with it
+ * instead, and the generator keeps a single pending event for all of them:
+ *
+ * - Sources with an (unbounded) exponential inter arrival time form one
+ *   superposed Poisson process with the sum of their rates. The generator
+ *   draws the next uplink of that process and picks the source in proportion
+ *   to its rate. A source therefore joins the process as soon as it is added,
+ *   its first send offset is not used.
+ * - All other sources, e.g. the periodic default of UpstreamIAT, have their
+ *   next send time kept in buckets of BucketWidth. Only the earliest bucket
+ *   is kept sorted.
+ */
+class LoRaWANTrafficGenerator : public Object
+{
+public:
+  static TypeId GetTypeId (void);
+
+  LoRaWANTrafficGenerator ();
+  virtual ~LoRaWANTrafficGenerator ();
+
+  /**
+   * \brief Add a source of uplinks
+   *
+   * \param iat the inter arrival time of the uplinks of the source, in seconds
+   * \param firstSend delay until the first uplink, only used when iat is not exponential
+   * \param send called for every uplink of the source
+   * \return the id of the source
+   */
+  uint32_t AddSource (Ptr<RandomVariableStream> iat, Time firstSend, Callback<void> send);
+
+  /**
+   * \brief Stop generating uplinks for a source
+   */
+  void RemoveSource (uint32_t id);
+
+  /**
+   * \brief Schedule the next uplink of a source after it sent one
+   *
+   * The next send time of a bucketed source is drawn from its inter arrival
+   * time. Sources in the Poisson process stay in it, for them this is a
+   * no-op.
+   */
+  void ScheduleNext (uint32_t id);
+
+  uint32_t GetNSources (void) const;        //!< number of sources that were added and not removed
+  uint32_t GetNPoissonSources (void) const; //!< number of those that are part of the Poisson process
+  double GetPoissonRate (void) const;       //!< rate of the Poisson process, in uplinks per second
+
+  int64_t AssignStreams (int64_t stream);
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  typedef struct Source {
+    Callback<void> m_send;
+    Ptr<RandomVariableStream> m_iat;
+    double m_rate;          //!< rate in the Poisson process, 0 for bucketed sources
+    uint32_t m_generation;  //!< bumped on removal, invalidates bucket entries
+    bool m_active;
+  } Source;
+
+  typedef std::pair<Time, uint32_t> Entry; //!< send time and source id
+  typedef std::pair<Entry, uint32_t> BucketEntry; //!< and generation of the source
+
+  void Fire (void);
+  void Reschedule (void);
+  void DrawNextPoisson (void);
+  void AddBucketEntry (uint32_t id, Time when);
+  bool GetEarliestBucketEntry (BucketEntry& entry);
+
+  void AddRate (uint32_t id, double rate);
+  uint32_t PickPoissonSource (double value) const;
+
+  Time m_bucketWidth;
+
+  std::vector<Source> m_sources;
+  uint32_t m_nSources;
+  uint32_t m_nPoissonSources;
+
+  std::vector<double> m_rateTree; //!< Fenwick tree over the rates of the sources
+  double m_totalRate;
+  Time m_nextPoisson;             //!< next uplink of the Poisson process, if m_totalRate > 0
+
+  std::map<int64_t, std::vector<BucketEntry> > m_buckets; //!< bucketed send times per bucket index
+  int64_t m_sortedBucket; //!< index of the bucket that is kept sorted (latest first), if any
+
+  EventId m_event;
+  Ptr<ExponentialRandomVariable> m_poissonIAT;
+  Ptr<UniformRandomVariable> m_pick;
+};
+
+} // namespace ns3
+
+#endif /* LORAWAN_TRAFFIC_GENERATOR_H */
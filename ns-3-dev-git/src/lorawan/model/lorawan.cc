@@ -18,7 +18,15 @@
  * Author: Floris Van den Abeele <floris.vandenabeele@ugent.be>
  */
 #include "lorawan.h"
+#include "lorawan-region.h"
+#include "lorawan-spectrum-value-helper.h"
+#include "lorawan-phy-config-registry.h"
 #include <ns3/log.h>
+#include <ns3/assert.h>
+#include <ns3/random-variable-stream.h>
+#include <ns3/config.h>
+#include <ns3/string.h>
+#include <sstream>
 
 namespace ns3 {
 
@@ -26,44 +34,190 @@ NS_LOG_COMPONENT_DEFINE ("LoRaWAN");
 
 /* ... */
 
-const std::vector<LoRaWANChannel> LoRaWAN::m_supportedChannels = {
-  {0, 868100000, 125000, 1},
-  {1, 868300000, 125000, 1},
-  {2, 868500000, 125000, 1},
-  {3, 867100000, 125000, 1},
-  {4, 867300000, 125000, 1},
-  {5, 867500000, 125000, 1},
-  {6, 867700000, 125000, 1},
-  // {7, 867900000, 125000, 1}, // sacrifice for high power channel on 869525000
-  {7, 869525000, 125000, 3}, // NOTE: always keep this special high power channel as the last element in the m_supportedChannels vector
-};
-
-const std::vector<LoRaWANDataRate> LoRaWAN::m_supportedDataRates = {
-  {0, LORAWAN_SF12, 125000},
-  {1, LORAWAN_SF11, 125000},
-  {2, LORAWAN_SF10, 125000},
-  {3, LORAWAN_SF9, 125000},
-  {4, LORAWAN_SF8, 125000},
-  {5, LORAWAN_SF7, 125000},
-  {6, LORAWAN_SF7, 250000}
-}; // other indexes are RFU
-
-uint8_t LoRaWAN::m_RW2ChannelIndex = LoRaWAN::m_supportedChannels.size () - 1; // high power channel, assume this is last channel in m_supportedChannels
-uint8_t LoRaWAN::m_RW2DataRateIndex = 0; // lowest spreading factor
+typedef LoRaWANRegionTraits<LORAWAN_REGION_EU868> DefaultRegion;
+
+std::vector<LoRaWANChannel> LoRaWAN::m_supportedChannels (DefaultRegion::channels, DefaultRegion::channels + DefaultRegion::nChannels);
+std::vector<LoRaWANDataRate> LoRaWAN::m_supportedDataRates (DefaultRegion::dataRates, DefaultRegion::dataRates + DefaultRegion::nDataRates);
+std::vector<LoRaWANSubBandLimits> LoRaWAN::m_subBands (DefaultRegion::subBands, DefaultRegion::subBands + DefaultRegion::nSubBands);
+
+uint8_t LoRaWAN::m_nUplinkChannels = DefaultRegion::nUplinkChannels;
+uint8_t LoRaWAN::m_maxUplinkDataRateIndex = DefaultRegion::maxUplinkDataRateIndex;
+
+uint8_t LoRaWAN::m_RW2ChannelIndex = DefaultRegion::rw2ChannelIndex;
+uint8_t LoRaWAN::m_RW2DataRateIndex = DefaultRegion::rw2DataRateIndex;
+
+uint8_t LoRaWAN::m_classBChannelIndex = DefaultRegion::classBChannelIndex;
+uint8_t LoRaWAN::m_classBDataRateIndex = DefaultRegion::classBDataRateIndex;
+
+LoRaWANRegion LoRaWAN::m_region = LORAWAN_REGION_EU868;
+uint8_t (*LoRaWAN::m_getRX1DataRateIndex) (uint8_t, uint8_t) = &DefaultRegion::GetRX1DataRateIndex;
+uint8_t (*LoRaWAN::m_getRX1ChannelIndex) (uint8_t) = &DefaultRegion::GetRX1ChannelIndex;
+
+template <typename Traits>
+void
+LoRaWAN::InstallRegion (uint8_t channelSubBand)
+{
+  NS_ASSERT_MSG (channelSubBand < Traits::nChannelSubBands, "Invalid channel sub band " << static_cast<uint16_t>(channelSubBand));
+
+  m_supportedChannels.clear ();
+  for (uint8_t i = 0; i < Traits::nChannels; i++)
+    m_supportedChannels.push_back (Traits::GetChannel (i, channelSubBand));
+  m_supportedDataRates.assign (Traits::dataRates, Traits::dataRates + Traits::nDataRates);
+  m_subBands.assign (Traits::subBands, Traits::subBands + Traits::nSubBands);
+
+  m_nUplinkChannels = Traits::nUplinkChannels;
+  m_maxUplinkDataRateIndex = Traits::maxUplinkDataRateIndex;
+  m_RW2ChannelIndex = Traits::rw2ChannelIndex;
+  m_RW2DataRateIndex = Traits::rw2DataRateIndex;
+  m_classBChannelIndex = Traits::classBChannelIndex;
+  m_classBDataRateIndex = Traits::classBDataRateIndex;
+  m_getRX1DataRateIndex = &Traits::GetRX1DataRateIndex;
+  m_getRX1ChannelIndex = &Traits::GetRX1ChannelIndex;
+}
+
+void
+LoRaWAN::SetRegion (LoRaWANRegion region, uint8_t channelSubBand)
+{
+  NS_LOG_FUNCTION (region << static_cast<uint16_t>(channelSubBand));
+
+  switch (region) {
+    case LORAWAN_REGION_EU868:
+      InstallRegion<LoRaWANRegionTraits<LORAWAN_REGION_EU868> > (channelSubBand);
+      break;
+    case LORAWAN_REGION_US915:
+      InstallRegion<LoRaWANRegionTraits<LORAWAN_REGION_US915> > (channelSubBand);
+      break;
+    case LORAWAN_REGION_AS923:
+      InstallRegion<LoRaWANRegionTraits<LORAWAN_REGION_AS923> > (channelSubBand);
+      break;
+    default:
+      NS_FATAL_ERROR ("LoRaWAN::SetRegion unknown region " << region);
+  }
+  m_region = region;
+
+  // end devices pick the channel of an uplink among the uplink channels of the region
+  std::stringstream channelRandomVariableSS;
+  channelRandomVariableSS << "ns3::UniformRandomVariable[Min=0|Max=" << m_nUplinkChannels - 1 << "]";
+  Config::SetDefault ("ns3::LoRaWANEndDeviceApplication::ChannelRandomVariable", StringValue (channelRandomVariableSS.str ()));
+  Config::SetDefault ("ns3::LoRaWANCompactEndDeviceFleet::ChannelRandomVariable", StringValue (channelRandomVariableSS.str ()));
+
+  // the spectrum model has a band per channel, and the shared PSDs refer to it
+  LoRaWANSpectrumValueHelper::ResetSpectrumModel ();
+  LoRaWANPhyConfigRegistry::Clear ();
+}
+
+LoRaWANRegion
+LoRaWAN::GetRegion (void)
+{
+  return m_region;
+}
+
+uint16_t
+LoRaWAN::GetPingOffset (uint32_t beaconTime, uint32_t devAddr, uint16_t pingPeriod)
+{
+  NS_ASSERT (pingPeriod > 0);
+
+  uint64_t x = (static_cast<uint64_t> (beaconTime) << 32) | devAddr;
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  x ^= x >> 33;
+  return (x & 0xffff) % pingPeriod;
+}
+
+Time
+LoRaWAN::GetNextPingSlot (Time t, uint32_t devAddr, uint8_t periodicity)
+{
+  NS_ASSERT (periodicity <= 7);
+
+  const uint16_t pingNb = 1 << (7 - periodicity);
+  const uint16_t pingPeriod = PING_SLOT_COUNT / pingNb;
+
+  int64_t beaconStart = (t.GetMicroSeconds () / BEACON_PERIOD) * BEACON_PERIOD;
+  while (true) {
+    uint32_t beaconTime = beaconStart / 1000000;
+    uint16_t offset = GetPingOffset (beaconTime, devAddr, pingPeriod);
+    for (uint16_t n = 0; n < pingNb; n++) {
+      Time slot = MicroSeconds (beaconStart + BEACON_RESERVED + (offset + n * pingPeriod) * PING_SLOT_LENGTH);
+      if (slot >= t)
+        return slot;
+    }
+    beaconStart += BEACON_PERIOD;
+  }
+}
 
 uint8_t
 LoRaWAN::GetRX1DataRateIndex (uint8_t upstreamDRIndex, uint8_t rx1DROffset)
 {
-  if (rx1DROffset == 0 || rx1DROffset == 1 ||rx1DROffset == 2 ||rx1DROffset == 3 ||rx1DROffset == 4 ||rx1DROffset == 5)
-    if (upstreamDRIndex <= rx1DROffset)
-      return 0;
-    else
-      return upstreamDRIndex - rx1DROffset;
-  else {
-    NS_LOG_WARN ("LoRaWAN::GetRX1DataRateIndex Invalid rx1DROffset: " << static_cast<uint16_t>(rx1DROffset));
-    return upstreamDRIndex;
+  return m_getRX1DataRateIndex (upstreamDRIndex, rx1DROffset);
+}
+
+uint8_t
+LoRaWAN::GetRX1ChannelIndex (uint8_t upstreamChannelIndex)
+{
+  return m_getRX1ChannelIndex (upstreamChannelIndex);
+}
+
+bool
+LoRaWAN::IsValidTxPower (int8_t power)
+{
+  // possible tx power values: 0, -2, -4, -6, -8, -10, -12, -14 (relative to max EIRP)
+  if (power < 0)
+    return false;
+  for (const LoRaWANSubBandLimits& subBand : m_subBands) {
+    const int8_t belowMax = subBand.maxTXPower - power;
+    if (belowMax >= 0 && belowMax <= 14 && belowMax % 2 == 0)
+      return true;
   }
+  return false;
 }
+
+uint16_t
+LoRaWAN::GetDefaultUplinkChannelMask (void)
+{
+  // the uplink channels come first, e.g. all channels but the high power RW2 channel in EU868
+  return (1 << m_nUplinkChannels) - 1;
+}
+
+bool
+LoRaWAN::ApplyLinkADRChannelMask (uint16_t& channelMask, uint16_t chMask, uint8_t chMaskCntl)
+{
+  if (chMaskCntl == 6) {
+    channelMask = GetDefaultUplinkChannelMask ();
+    return true;
+  } else if (chMaskCntl != 0) {
+    NS_LOG_WARN ("LoRaWAN::ApplyLinkADRChannelMask unsupported ChMaskCntl: " << static_cast<uint16_t>(chMaskCntl));
+    return false;
+  }
+
+  if (chMask == 0 || (chMask & ~GetDefaultUplinkChannelMask ()) != 0) {
+    NS_LOG_WARN ("LoRaWAN::ApplyLinkADRChannelMask invalid ChMask: " << chMask);
+    return false;
+  }
+
+  channelMask = chMask;
+  return true;
+}
+
+uint8_t
+LoRaWAN::SelectUplinkChannel (Ptr<RandomVariableStream> rv, uint16_t channelMask)
+{
+  NS_ASSERT (channelMask != 0);
+
+  // rv may be constant, so give up after a while and take the first enabled channel
+  for (uint32_t i = 0; i < 16 * m_supportedChannels.size (); i++) {
+    uint32_t channelIndex = rv->GetInteger ();
+    if (channelIndex < 16 && (channelMask & (1 << channelIndex)))
+      return channelIndex;
+  }
+
+  uint8_t channelIndex = 0;
+  while (!(channelMask & (1 << channelIndex)))
+    channelIndex++;
+  return channelIndex;
+}
+
 /****************************************************************************
  ************************ LoRaWANMsgTypeTag *********************************
  ****************************************************************************/
@@ -23,6 +23,7 @@
 #include <ns3/uinteger.h>
 #include <ns3/packet.h>
 #include <ns3/flow-id-tag.h>
+#include <ns3/nstime.h>
 
 #include <vector>
 
@@ -34,8 +35,16 @@
 #define RECEIVE_DELAY1 1000000 // in uS
 #define RECEIVE_DELAY2 2000000 // in uS
 
+// Class B timing as per $13 of the LoRaWAN spec
+#define BEACON_PERIOD 128000000 // in uS
+#define BEACON_RESERVED 2120000 // in uS
+#define PING_SLOT_LENGTH 30000 // in uS
+#define PING_SLOT_COUNT 4096 // number of ping slot lengths in a beacon window
+
 namespace ns3 {
 
+class RandomVariableStream;
+
 /* ... */
 
   /**
@@ -49,6 +58,9 @@ namespace ns3 {
     uint32_t m_fc; // in Hz
     uint32_t m_bw;
     uint8_t m_subBandIndex;
+    uint8_t m_minDataRateIndex; // lowest data rate used on this channel
+    uint8_t m_maxDataRateIndex; // highest data rate used on this channel
+    bool m_gatewayRx; // false for channels that only carry downlink traffic, gateways do not listen on them
   } LoRaWANChannel;
 
   /**
@@ -76,9 +88,32 @@ namespace ns3 {
   {
     uint8_t dataRateIndex;
     LoRaSpreadingFactor spreadingFactor;
-    uint32_t bandWith;
+    uint32_t bandWith; // 0 for RFU data rates
   } LoRaWANDataRate;
 
+  /**
+   * \ingroup lorawan
+   *
+   * The regulatory limits of a sub band, see LoRaWANSubBand in lorawan-mac.h
+   */
+  typedef struct
+  {
+    uint16_t dutyCycleLimit; // Actual limit is 1 over this value: 10 -> 10%; 100 -> 1%; 1000 => 0.1%
+    int8_t maxTXPower;
+  } LoRaWANSubBandLimits;
+
+  /**
+   * \ingroup lorawan
+   *
+   * The regional parameters a simulation can use, see LoRaWANRegionTraits
+   */
+  typedef enum
+  {
+    LORAWAN_REGION_EU868 = 0,
+    LORAWAN_REGION_US915,
+    LORAWAN_REGION_AS923,
+  } LoRaWANRegion;
+
 
   /**
    * \ingroup lorawan
@@ -114,20 +149,66 @@ namespace ns3 {
 
   public:
     /**
-     * The supported LoRa channels
+     * The supported LoRa channels of the region in use. The uplink channels
+     * come first, see m_nUplinkChannels.
+     */
+    static std::vector<LoRaWANChannel> m_supportedChannels;
+
+    /**
+     * The supported LoRaWAN data rates of the region in use
+     */
+    static std::vector<LoRaWANDataRate> m_supportedDataRates;
+
+    /**
+     * The sub bands of the region in use, indexed by
+     * LoRaWANChannel::m_subBandIndex
+     */
+    static std::vector<LoRaWANSubBandLimits> m_subBands;
+
+    /**
+     * The number of channels end devices use for uplinks, these are the first
+     * channels of m_supportedChannels
+     */
+    static uint8_t m_nUplinkChannels;
+
+    /**
+     * The highest data rate of an uplink, and so the highest data rate ADR
+     * assigns
      */
-    static const std::vector<LoRaWANChannel> m_supportedChannels;
+    static uint8_t m_maxUplinkDataRateIndex;
 
     /**
-     * The supported LoRaWAN data rates
+     * Install the channels, data rates and sub bands of a region, EU868 is
+     * installed by default. Also sets the default ChannelRandomVariable of
+     * end devices to the uplink channels of the region. Must be called
+     * before any LoRaWAN object is created, as PHYs and MACs copy these
+     * tables when they are created.
+     *
+     * \param region the region to install
+     * \param channelSubBand the block of 8 uplink channels gateways listen
+     * on, for regions with more uplink channels than a gateway supports
+     * (US915: 0-7). Ignored for other regions.
      */
-    static const std::vector<LoRaWANDataRate> m_supportedDataRates;
+    static void SetRegion (LoRaWANRegion region, uint8_t channelSubBand = 0);
+    static LoRaWANRegion GetRegion (void);
 
     /*
-     * Get the RX1 receive window data rate, note frequency is always the same for RW1
+     * Get the RX1 receive window data rate
      */
     static uint8_t GetRX1DataRateIndex (uint8_t upstreamDRIndex, uint8_t rx1DROffset);
 
+    /*
+     * Get the RX1 receive window channel, e.g. the same channel as the uplink
+     * for EU868
+     */
+    static uint8_t GetRX1ChannelIndex (uint8_t upstreamChannelIndex);
+
+    /**
+     * Whether a tx power can be configured, i.e. the max EIRP of a sub band of
+     * the region minus an even number of dB, up to 14 dB (tx power index 7)
+     */
+    static bool IsValidTxPower (int8_t power);
+
     /**
      * The channel and data rate index for transmissions in the second receive
      * window (RW2) of a class A end device
@@ -135,6 +216,70 @@ namespace ns3 {
     static uint8_t m_RW2ChannelIndex;
     static uint8_t m_RW2DataRateIndex;
 
+    /**
+     * The channel and data rate index for beacons and class B ping slots
+     */
+    static uint8_t m_classBChannelIndex;
+    static uint8_t m_classBDataRateIndex;
+
+    /**
+     * Get the offset of the first ping slot of an end device in a beacon
+     * period, in ping slot lengths.
+     *
+     * The spec derives the offset from AES128(key=0, beaconTime | devAddr), a
+     * 64 bit mixing function is used instead as only its distribution matters
+     * here. Like the AES version, the offset is pseudo random per end device
+     * and beacon period, so that end devices sharing a periodicity don't
+     * collide in every period.
+     *
+     * \param beaconTime the time of the beacon starting the period, in seconds
+     * \param devAddr the address of the end device
+     * \param pingPeriod the number of ping slot lengths between two ping slots
+     */
+    static uint16_t GetPingOffset (uint32_t beaconTime, uint32_t devAddr, uint16_t pingPeriod);
+
+    /**
+     * Get the start of the first ping slot of an end device at or after t
+     *
+     * \param periodicity the ping slot periodicity (0-7), the end device has
+     * 2^(7-periodicity) ping slots per beacon period
+     */
+    static Time GetNextPingSlot (Time t, uint32_t devAddr, uint8_t periodicity);
+
+    /**
+     * The channel mask of an end device that may use every uplink channel,
+     * e.g. every channel but the high power RW2 channel in EU868. Bit i of a
+     * channel mask enables channel i.
+     */
+    static uint16_t GetDefaultUplinkChannelMask (void);
+
+    /**
+     * Apply the ChMask and ChMaskCntl of a LinkADRReq ($5.3) to the channel
+     * mask of an end device. ChMaskCntl 0 sets the mask to ChMask, 6 enables
+     * every uplink channel, other values are not supported.
+     *
+     * \return false when the request is rejected (ChMaskCntl not supported,
+     * or a mask that enables an undefined channel or no channel at all), in
+     * which case channelMask is left unchanged
+     */
+    static bool ApplyLinkADRChannelMask (uint16_t& channelMask, uint16_t chMask, uint8_t chMaskCntl);
+
+    /**
+     * Pick the channel of an uplink from the channels enabled in a channel
+     * mask. Values are drawn from rv until it gives an enabled channel, so
+     * that an end device with every channel enabled draws the same channels
+     * as before channel masks existed.
+     */
+    static uint8_t SelectUplinkChannel (Ptr<RandomVariableStream> rv, uint16_t channelMask);
+
+  private:
+    static LoRaWANRegion m_region;
+    static uint8_t (*m_getRX1DataRateIndex) (uint8_t, uint8_t);
+    static uint8_t (*m_getRX1ChannelIndex) (uint8_t);
+
+    template <typename Traits>
+    static void InstallRegion (uint8_t channelSubBand);
+
   }; // class LoRaWAN
 
   class LoRaWANMsgTypeTag : public Tag {
@@ -0,0 +1,291 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+#include <ns3/test.h>
+#include <ns3/log.h>
+#include <ns3/core-module.h>
+#include <ns3/lorawan-module.h>
+
+#include <cmath>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-adr-policy-test");
+
+static LoRaWANEndDeviceInfoNS*
+AddDevice (Ptr<LoRaWANNetworkServer> ns, uint32_t deviceAddr, double snr, uint8_t dataRateIndex,
+           uint32_t nUSPackets, Ptr<LoRaWANGatewayApplication> gateway)
+{
+  ns->AddEndDevice (Ipv4Address (deviceAddr));
+  LoRaWANEndDeviceInfoNS* info = ns->GetEndDeviceInfo (deviceAddr);
+  for (uint16_t f = 1; f <= 20; f++)
+    {
+      LoRaWANAdrSnrRow row = {f, snr, 1, 1, 1};
+      info->m_frameSNRHistory.insert (info->m_frameSNRHistory.begin (), row);
+    }
+  info->m_lastDataRateIndex = dataRateIndex;
+  info->m_lastTxPowerIndex = 0;
+  info->m_lastCodeRate = 1;
+  info->m_lastPhyPayloadSize = 23;
+  info->m_nUSPackets = nUSPackets;
+  info->m_lastGWs.push_back (gateway);
+  return info;
+}
+
+/**
+ * The network server runs the per device algorithm of Semtech by default
+ */
+class LoRaWANAdrPolicySemtechTestCase : public TestCase
+{
+public:
+  LoRaWANAdrPolicySemtechTestCase ();
+  virtual ~LoRaWANAdrPolicySemtechTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANAdrPolicySemtechTestCase::LoRaWANAdrPolicySemtechTestCase ()
+  : TestCase ("Test the default ADR policy")
+{
+}
+
+LoRaWANAdrPolicySemtechTestCase::~LoRaWANAdrPolicySemtechTestCase ()
+{
+}
+
+void
+LoRaWANAdrPolicySemtechTestCase::DoRun (void)
+{
+  Ptr<LoRaWANNetworkServer> ns = CreateObject<LoRaWANNetworkServer> ();
+  NS_TEST_ASSERT_MSG_NE (DynamicCast<LoRaWANSemtechAdrPolicy> (ns->GetAdrPolicy ()), 0, "The default policy is not the Semtech algorithm");
+
+  Ptr<LoRaWANGatewayApplication> gateway = CreateObject<LoRaWANGatewayApplication> ();
+  AddDevice (ns, 1, -5.0, 0, 20, gateway);
+
+  uint8_t dr = 0;
+  uint8_t tx = 0;
+  const double margin = -5.0 - ns->GetADRRequiredSNR (0) - 5;
+  LoRaWANNetworkServer::ApplyADRSteps (int (margin / 3), dr, tx);
+  LoRaWANADRAlgoritmResult adrRes = ns->AdaptiveDataRate (1);
+  NS_TEST_ASSERT_MSG_EQ (adrRes.status, true, "ADR failed");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)adrRes.dr, (uint16_t)dr, "Wrong data rate");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)adrRes.txPower, (uint16_t)tx, "Wrong tx power");
+  NS_TEST_ASSERT_MSG_EQ (ns->AdaptiveDataRate (2).status, false, "ADR ran for an unknown device");
+
+  ns->Dispose ();
+  Simulator::Destroy ();
+}
+
+/**
+ * The global policy moves end devices off a congested data rate, but only
+ * to data rates they can use, and leaves an idle network on the fastest
+ * data rates
+ */
+class LoRaWANAdrPolicyGlobalTestCase : public TestCase
+{
+public:
+  LoRaWANAdrPolicyGlobalTestCase ();
+  virtual ~LoRaWANAdrPolicyGlobalTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANAdrPolicyGlobalTestCase::LoRaWANAdrPolicyGlobalTestCase ()
+  : TestCase ("Test the network wide ADR policy")
+{
+}
+
+LoRaWANAdrPolicyGlobalTestCase::~LoRaWANAdrPolicyGlobalTestCase ()
+{
+}
+
+static double
+CellCost (double load, double airtimeWeight)
+{
+  return load * (1.0 - std::exp (-2.0 * load)) + airtimeWeight * load;
+}
+
+void
+LoRaWANAdrPolicyGlobalTestCase::DoRun (void)
+{
+  const uint32_t nDevices = 1000;
+  const uint32_t nUSPackets = 20;
+  const Time elapsed = Seconds (1000);
+  const uint8_t nUplinkChannels = LoRaWAN::m_supportedChannels.size () - 1;
+  const double deviceLoadDR5 = nUSPackets / elapsed.GetSeconds () * LoRaWANPhy::CalculateTxTime (23, 0, 5, 1, 8, true).GetSeconds () / nUplinkChannels;
+  const double deviceLoadDR0 = nUSPackets / elapsed.GetSeconds () * LoRaWANPhy::CalculateTxTime (23, 0, 0, 1, 8, true).GetSeconds () / nUplinkChannels;
+
+  Simulator::Stop (elapsed);
+  Simulator::Run ();
+
+  // a congested gateway: all end devices on DR5, and one far away end device that can only use DR0
+  Ptr<LoRaWANNetworkServer> ns = CreateObject<LoRaWANNetworkServer> ();
+  Ptr<LoRaWANGlobalAdrPolicy> policy = CreateObject<LoRaWANGlobalAdrPolicy> ();
+  ns->SetAttribute ("AdrPolicy", PointerValue (policy));
+  Ptr<LoRaWANGatewayApplication> gateway = CreateObject<LoRaWANGatewayApplication> ();
+  for (uint32_t i = 1; i <= nDevices; i++)
+    AddDevice (ns, i, 10.0, 5, nUSPackets, gateway);
+  LoRaWANEndDeviceInfoNS* farInfo = AddDevice (ns, nDevices + 1, -22.0, 0, nUSPackets, gateway);
+  const double initialCost = CellCost (nDevices * deviceLoadDR5, 0.1) + CellCost (deviceLoadDR0, 0.1);
+
+  policy->Optimize (*ns);
+  NS_TEST_ASSERT_MSG_LT (policy->GetCost (), initialCost, "The optimizer did not lower the cost");
+  NS_TEST_ASSERT_MSG_LT (policy->GetLoad (gateway, 5), nDevices * deviceLoadDR5, "No end device moved off DR5");
+
+  uint32_t nOffDR5 = 0;
+  double totalLoad = 0.0;
+  for (uint32_t i = 1; i <= nDevices; i++)
+    {
+      uint8_t dr;
+      uint8_t tx;
+      NS_TEST_ASSERT_MSG_EQ (policy->GetAssignment (i, dr, tx), true, "End device without assignment");
+      const double margin = 10.0 - 5 - ns->GetADRRequiredSNR (dr);
+      NS_TEST_ASSERT_MSG_EQ ((margin >= 0.0), true, "Data rate without margin assigned");
+      NS_TEST_ASSERT_MSG_EQ ((2.0 * tx <= margin), true, "Tx power lowered below the margin");
+      if (dr != 5)
+        {
+          nOffDR5++;
+          NS_TEST_ASSERT_MSG_EQ (ns->GetEndDeviceInfo (i)->m_setAdr, true, "Moved end device gets no LinkADRReq");
+          LoRaWANADRAlgoritmResult adrRes = ns->AdaptiveDataRate (i);
+          NS_TEST_ASSERT_MSG_EQ ((uint16_t)adrRes.dr, (uint16_t)dr, "ADR does not return the assignment");
+          NS_TEST_ASSERT_MSG_EQ ((uint16_t)adrRes.txPower, (uint16_t)tx, "ADR does not return the assignment");
+        }
+    }
+  for (uint8_t dr = 0; dr < ADR_N_DATA_RATES; dr++)
+    totalLoad += policy->GetLoad (gateway, dr);
+  NS_TEST_ASSERT_MSG_GT (nOffDR5, 0, "No end device moved");
+  NS_TEST_ASSERT_MSG_LT (nOffDR5, nDevices, "All end devices moved");
+  NS_TEST_ASSERT_MSG_GT (totalLoad, nDevices * deviceLoadDR5 + deviceLoadDR0, "Slower data rates without more airtime");
+
+  uint8_t dr;
+  uint8_t tx;
+  NS_TEST_ASSERT_MSG_EQ (policy->GetAssignment (nDevices + 1, dr, tx), true, "Far end device without assignment");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)dr, 0, "Far end device moved to a data rate it can not use");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)tx, 0, "Far end device lowered its tx power");
+  NS_TEST_ASSERT_MSG_EQ (farInfo->m_setAdr, false, "LinkADRReq for an unchanged end device");
+
+  ns->Dispose ();
+
+  // an idle gateway: every end device that can goes to DR5, where it spends the least airtime
+  ns = CreateObject<LoRaWANNetworkServer> ();
+  policy = CreateObject<LoRaWANGlobalAdrPolicy> ();
+  ns->SetAttribute ("AdrPolicy", PointerValue (policy));
+  for (uint32_t i = 1; i <= 10; i++)
+    AddDevice (ns, i, 10.0, i % ADR_N_DATA_RATES, nUSPackets, gateway);
+  policy->Optimize (*ns);
+  for (uint32_t i = 1; i <= 10; i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (policy->GetAssignment (i, dr, tx), true, "End device without assignment");
+      NS_TEST_ASSERT_MSG_EQ ((uint16_t)dr, 5, "End device not on the fastest data rate in an idle network");
+    }
+
+  ns->Dispose ();
+  Simulator::Destroy ();
+}
+
+/**
+ * The global policy counts an uplink heard by several gateways once in the
+ * load of each of them, and leaves end devices skipped by a round out of the
+ * cell loads
+ */
+class LoRaWANAdrPolicyGatewaysTestCase : public TestCase
+{
+public:
+  LoRaWANAdrPolicyGatewaysTestCase ();
+  virtual ~LoRaWANAdrPolicyGatewaysTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANAdrPolicyGatewaysTestCase::LoRaWANAdrPolicyGatewaysTestCase ()
+  : TestCase ("Test the network wide ADR policy with several gateways")
+{
+}
+
+LoRaWANAdrPolicyGatewaysTestCase::~LoRaWANAdrPolicyGatewaysTestCase ()
+{
+}
+
+void
+LoRaWANAdrPolicyGatewaysTestCase::DoRun (void)
+{
+  const uint32_t nUSPackets = 20;
+  const Time elapsed = Seconds (1000);
+  const uint8_t nUplinkChannels = LoRaWAN::m_supportedChannels.size () - 1;
+  const double deviceLoadDR5 = nUSPackets / elapsed.GetSeconds () * LoRaWANPhy::CalculateTxTime (23, 0, 5, 1, 8, true).GetSeconds () / nUplinkChannels;
+
+  Simulator::Stop (elapsed);
+  Simulator::Run ();
+
+  // end device 1 is heard by both gateways, every uplink reaches the NS twice
+  Ptr<LoRaWANNetworkServer> ns = CreateObject<LoRaWANNetworkServer> ();
+  Ptr<LoRaWANGlobalAdrPolicy> policy = CreateObject<LoRaWANGlobalAdrPolicy> ();
+  ns->SetAttribute ("AdrPolicy", PointerValue (policy));
+  Ptr<LoRaWANGatewayApplication> gateway1 = CreateObject<LoRaWANGatewayApplication> ();
+  Ptr<LoRaWANGatewayApplication> gateway2 = CreateObject<LoRaWANGatewayApplication> ();
+  LoRaWANEndDeviceInfoNS* info1 = AddDevice (ns, 1, 10.0, 5, 2 * nUSPackets, gateway1);
+  info1->m_lastGWs.push_back (gateway2);
+  info1->m_nUSDuplicates = nUSPackets;
+  LoRaWANEndDeviceInfoNS* info2 = AddDevice (ns, 2, 10.0, 5, nUSPackets, gateway1);
+
+  policy->Optimize (*ns);
+  NS_TEST_ASSERT_MSG_EQ_TOL (policy->GetLoad (gateway2, 5), deviceLoadDR5, 1e-9, "Gateway copies counted as uplinks");
+  NS_TEST_ASSERT_MSG_EQ_TOL (policy->GetLoad (gateway1, 5), 2 * deviceLoadDR5, 1e-9, "Wrong load of the shared gateway");
+
+  // end device 2 has no gateways for its last uplink, its load of the previous round is stale
+  Simulator::Stop (elapsed);
+  Simulator::Run ();
+  info1->m_nUSPackets += 2 * nUSPackets;
+  info1->m_nUSDuplicates += nUSPackets;
+  info2->m_nUSPackets += nUSPackets;
+  info2->m_lastGWs.clear ();
+  info2->m_setAdr = false; // the LinkADRReq of the first round was sent
+
+  policy->Optimize (*ns);
+  NS_TEST_ASSERT_MSG_EQ_TOL (policy->GetLoad (gateway1, 5), deviceLoadDR5, 1e-9, "Skipped end device in the cell load");
+  NS_TEST_ASSERT_MSG_EQ_TOL (policy->GetLoad (gateway2, 5), deviceLoadDR5, 1e-9, "Wrong uplink rate in the second round");
+  uint8_t dr;
+  uint8_t tx;
+  NS_TEST_ASSERT_MSG_EQ (policy->GetAssignment (2, dr, tx), true, "Skipped end device lost its assignment");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)dr, 5, "Skipped end device moved");
+  NS_TEST_ASSERT_MSG_EQ (info2->m_setAdr, false, "LinkADRReq for a skipped end device");
+
+  ns->Dispose ();
+  Simulator::Destroy ();
+}
+
+// ==============================================================================
+class LoRaWANAdrPolicyTestSuite : public TestSuite
+{
+public:
+  LoRaWANAdrPolicyTestSuite ();
+};
+
+LoRaWANAdrPolicyTestSuite::LoRaWANAdrPolicyTestSuite ()
+  : TestSuite ("lorawan-adr-policy", UNIT)
+{
+  AddTestCase (new LoRaWANAdrPolicySemtechTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANAdrPolicyGlobalTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANAdrPolicyGatewaysTestCase, TestCase::QUICK);
+}
+
+static LoRaWANAdrPolicyTestSuite lorawanAdrPolicyTestSuite;
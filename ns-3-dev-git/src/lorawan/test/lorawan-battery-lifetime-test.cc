@@ -0,0 +1,182 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+#include <ns3/test.h>
+#include <ns3/log.h>
+#include <ns3/core-module.h>
+#include <ns3/network-module.h>
+#include <ns3/mobility-module.h>
+#include <ns3/energy-module.h>
+#include <ns3/lorawan-module.h>
+
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-battery-lifetime-test");
+
+/**
+ * Project the lifetime of end devices after a short run and compare it with
+ * the time at which their batteries are actually depleted when the
+ * simulation goes on
+ */
+class LoRaWANBatteryLifetimeTestCase : public TestCase
+{
+public:
+  LoRaWANBatteryLifetimeTestCase ();
+  virtual ~LoRaWANBatteryLifetimeTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  static void Depleted (std::vector<Time>* depletion, uint32_t i);
+};
+
+LoRaWANBatteryLifetimeTestCase::LoRaWANBatteryLifetimeTestCase ()
+  : TestCase ("Test that the projected battery lifetime of end devices matches a brute-force run")
+{
+}
+
+LoRaWANBatteryLifetimeTestCase::~LoRaWANBatteryLifetimeTestCase ()
+{
+}
+
+void
+LoRaWANBatteryLifetimeTestCase::Depleted (std::vector<Time>* depletion, uint32_t i)
+{
+  if ((*depletion)[i].IsZero ())
+    (*depletion)[i] = Simulator::Now ();
+}
+
+void
+LoRaWANBatteryLifetimeTestCase::DoRun (void)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (1);
+
+  // a close end device with unconfirmed uplinks and a far one with confirmed
+  // uplinks, so that it also receives downlinks
+  const std::vector<double> distances = {250.0, 2300.0};
+  const double initialEnergy = 2.0; // J
+
+  NodeContainer endDeviceNodes;
+  NodeContainer gatewayNodes;
+  endDeviceNodes.Create (distances.size ());
+  gatewayNodes.Create (1);
+
+  Ptr<ListPositionAllocator> edPositions = CreateObject<ListPositionAllocator> ();
+  for (auto d : distances)
+    edPositions->Add (Vector (d, 0.0, 0.0));
+  MobilityHelper edMobility;
+  edMobility.SetPositionAllocator (edPositions);
+  edMobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  edMobility.Install (endDeviceNodes);
+  MobilityHelper gwMobility;
+  gwMobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  gwMobility.Install (gatewayNodes);
+
+  LoRaWANHelper lorawanHelper;
+  lorawanHelper.SetNbRep (1);
+  NetDeviceContainer endDeviceDevices = lorawanHelper.Install (endDeviceNodes);
+  lorawanHelper.SetDeviceType (LORAWAN_DT_GATEWAY);
+  lorawanHelper.Install (gatewayNodes);
+
+  BasicEnergySourceHelper sourceHelper;
+  sourceHelper.Set ("BasicEnergySourceInitialEnergyJ", DoubleValue (initialEnergy));
+  sourceHelper.Set ("BasicEnergyLowBatteryThreshold", DoubleValue (0.0));
+  EnergySourceContainer sources = sourceHelper.Install (endDeviceNodes);
+  LoRaWANRadioEnergyModelHelper radioHelper;
+  radioHelper.SetCurrentModel ("ns3::SX1272LoRaWANCurrentModel");
+  DeviceEnergyModelContainer models = radioHelper.Install (endDeviceDevices, sources);
+
+  std::vector<Time> depletion (distances.size ());
+  for (uint32_t i = 0; i < models.GetN (); i++)
+    {
+      Ptr<LoRaWANRadioEnergyModel> model = DynamicCast<LoRaWANRadioEnergyModel> (models.Get (i));
+      model->SetEnergyDepletionCallback (MakeBoundCallback (&LoRaWANBatteryLifetimeTestCase::Depleted, &depletion, i));
+    }
+
+  PacketSocketHelper packetSocket;
+  packetSocket.Install (endDeviceNodes);
+  packetSocket.Install (gatewayNodes);
+
+  LoRaWANEndDeviceHelper enddevicehelper;
+  enddevicehelper.SetAttribute ("UpstreamIAT", StringValue ("ns3::ConstantRandomVariable[Constant=60.0]"));
+  enddevicehelper.SetAttribute ("UpstreamSend", StringValue ("ns3::UniformRandomVariable[Min=0.0|Max=60.0]"));
+  enddevicehelper.SetConvergedStart (true);
+  enddevicehelper.SetPropagationLossModel (lorawanHelper.GetPropagationLossModel ());
+  ApplicationContainer enddeviceApps = enddevicehelper.Install (endDeviceNodes);
+  enddeviceApps.Get (1)->SetAttribute ("ConfirmedDataUp", BooleanValue (true));
+  LoRaWANGatewayHelper gatewayhelper;
+  gatewayhelper.Install (gatewayNodes);
+
+  LoRaWANBatteryLifetimeHelper lifetimeHelper;
+  lifetimeHelper.Install (endDeviceNodes);
+
+  // projection after a short run
+  Simulator::Stop (Seconds (1800));
+  Simulator::Run ();
+  std::vector<LoRaWANBatteryLifetimeHelper::Projection> projections = lifetimeHelper.GetProjections ();
+  NS_TEST_ASSERT_MSG_EQ (projections.size (), distances.size (), "Not all end devices are observed");
+
+  // brute force: run until both batteries are depleted
+  double maxLifetime = 0;
+  for (auto& p : projections)
+    maxLifetime = std::max (maxLifetime, p.m_lifetime);
+  Simulator::Stop (Seconds (maxLifetime * 1.2 - 1800));
+  Simulator::Run ();
+
+  for (uint32_t i = 0; i < projections.size (); i++)
+    {
+      const LoRaWANBatteryLifetimeHelper::Projection& p = projections[i];
+      NS_LOG_INFO ("end device " << i << ": " << p.m_cycles << " cycles, power " << p.m_power
+                   << " W [" << p.m_powerLow << ", " << p.m_powerHigh << "], downlinks/uplink " << p.m_downlinkRate
+                   << ", projected lifetime " << p.m_lifetime << " s [" << p.m_lifetimeLow << ", " << p.m_lifetimeHigh
+                   << "], depleted at " << depletion[i].GetSeconds () << " s");
+      NS_TEST_ASSERT_MSG_EQ (p.m_converged, true, "End device " << i << " should be converged");
+      NS_TEST_ASSERT_MSG_GT (p.m_power, 0.0, "No power for end device " << i);
+      NS_TEST_ASSERT_MSG_EQ ((p.m_powerLow <= p.m_power && p.m_power <= p.m_powerHigh), true, "Power outside of its bounds");
+      NS_TEST_ASSERT_MSG_EQ (depletion[i].IsZero (), false, "Battery of end device " << i << " not depleted");
+      NS_TEST_ASSERT_MSG_EQ_TOL (depletion[i].GetSeconds (), p.m_lifetime, 0.02 * p.m_lifetime,
+                                 "Wrong projected lifetime for end device " << i);
+      NS_TEST_ASSERT_MSG_EQ ((depletion[i].GetSeconds () >= 0.98 * p.m_lifetimeLow
+                              && depletion[i].GetSeconds () <= 1.02 * p.m_lifetimeHigh), true,
+                             "Depletion outside of the projected bounds for end device " << i);
+    }
+  NS_TEST_ASSERT_MSG_GT (projections[1].m_downlinkRate, 0.5, "End device with confirmed uplinks should receive downlinks");
+  NS_TEST_ASSERT_MSG_GT (projections[1].m_power, projections[0].m_power, "The far end device should use more power");
+
+  LoRaWANNetworkServer::clearLoRaWANNetworkServerPointer ();
+  Simulator::Destroy ();
+}
+
+// ==============================================================================
+class LoRaWANBatteryLifetimeTestSuite : public TestSuite
+{
+public:
+  LoRaWANBatteryLifetimeTestSuite ();
+};
+
+LoRaWANBatteryLifetimeTestSuite::LoRaWANBatteryLifetimeTestSuite ()
+  : TestSuite ("lorawan-battery-lifetime", UNIT)
+{
+  AddTestCase (new LoRaWANBatteryLifetimeTestCase, TestCase::QUICK);
+}
+
+static LoRaWANBatteryLifetimeTestSuite lorawanBatteryLifetimeTestSuite;
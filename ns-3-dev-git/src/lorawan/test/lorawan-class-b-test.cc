@@ -0,0 +1,232 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+#include <ns3/test.h>
+#include <ns3/log.h>
+#include <ns3/core-module.h>
+#include <ns3/network-module.h>
+#include <ns3/mobility-module.h>
+#include <ns3/lorawan-module.h>
+#include "ns3/rng-seed-manager.h"
+
+#include <map>
+#include <set>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-class-b-test");
+
+/**
+ * Ping slots lie in the ping slot window of a beacon period, are aligned on
+ * ping slot lengths, repeat every ping period and differ between end devices
+ */
+class LoRaWANPingSlotTestCase : public TestCase
+{
+public:
+  LoRaWANPingSlotTestCase ();
+  virtual ~LoRaWANPingSlotTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANPingSlotTestCase::LoRaWANPingSlotTestCase ()
+  : TestCase ("Test the ping slot computation")
+{
+}
+
+LoRaWANPingSlotTestCase::~LoRaWANPingSlotTestCase ()
+{
+}
+
+void
+LoRaWANPingSlotTestCase::DoRun (void)
+{
+  std::set<uint16_t> offsets;
+  for (uint32_t devAddr = 1; devAddr <= 100; devAddr++)
+    {
+      for (uint8_t periodicity = 0; periodicity <= 7; periodicity++)
+        {
+          const uint16_t pingPeriod = PING_SLOT_COUNT >> (7 - periodicity);
+          Time t = Seconds (1000.5);
+          Time slot = LoRaWAN::GetNextPingSlot (t, devAddr, periodicity);
+          NS_TEST_ASSERT_MSG_EQ ((slot >= t), true, "Ping slot in the past");
+
+          int64_t inPeriod = slot.GetMicroSeconds () % BEACON_PERIOD;
+          NS_TEST_ASSERT_MSG_GT_OR_EQ (inPeriod, BEACON_RESERVED, "Ping slot in the beacon reserved time");
+          NS_TEST_ASSERT_MSG_LT (inPeriod, BEACON_RESERVED + PING_SLOT_COUNT * PING_SLOT_LENGTH, "Ping slot after the ping slot window");
+          NS_TEST_ASSERT_MSG_EQ ((inPeriod - BEACON_RESERVED) % PING_SLOT_LENGTH, 0, "Ping slot not aligned");
+
+          // the next ping slot of a period follows one ping period later
+          Time next = LoRaWAN::GetNextPingSlot (slot + MicroSeconds (1), devAddr, periodicity);
+          if (next.GetMicroSeconds () / BEACON_PERIOD == slot.GetMicroSeconds () / BEACON_PERIOD)
+            NS_TEST_ASSERT_MSG_EQ ((next - slot).GetMicroSeconds (), static_cast<int64_t> (pingPeriod) * PING_SLOT_LENGTH, "Wrong ping period");
+          NS_TEST_ASSERT_MSG_EQ (LoRaWAN::GetNextPingSlot (slot, devAddr, periodicity), slot, "Ping slot not stable");
+
+          NS_TEST_ASSERT_MSG_LT (LoRaWAN::GetPingOffset (7, devAddr, pingPeriod), pingPeriod, "Ping offset out of range");
+        }
+      offsets.insert (LoRaWAN::GetPingOffset (7, devAddr, PING_SLOT_COUNT));
+    }
+  NS_TEST_ASSERT_MSG_GT (offsets.size (), 90, "Ping offsets of end devices collide");
+}
+
+/**
+ * Records the latency of the downlinks of the network server
+ */
+struct LoRaWANClassBTestLatency
+{
+  std::map<uint64_t, Time> m_generated; //!< keyed on the counter in the payload
+  uint32_t m_nPingSlot;
+  uint32_t m_nReceived;
+  Time m_totalLatency;
+};
+
+static uint64_t
+GetDSCounter (Ptr<const Packet> packet)
+{
+  uint64_t counter = 0;
+  if (packet->GetSize () >= sizeof (counter))
+    packet->CopyData (reinterpret_cast<uint8_t*> (&counter), sizeof (counter));
+  return counter;
+}
+
+static void
+DSMsgGenerated (LoRaWANClassBTestLatency* latency, uint32_t deviceAddr, uint8_t txRemaining, uint8_t msgType, Ptr<const Packet> packet)
+{
+  latency->m_generated[GetDSCounter (packet)] = Simulator::Now ();
+}
+
+static void
+DSMsgReceived (LoRaWANClassBTestLatency* latency, uint32_t deviceAddr, uint8_t msgType, Ptr<const Packet> packet, uint8_t rw)
+{
+  auto it = latency->m_generated.find (GetDSCounter (packet));
+  if (it == latency->m_generated.end ())
+    return;
+  latency->m_nReceived++;
+  if (rw == 0)
+    latency->m_nPingSlot++;
+  latency->m_totalLatency += Simulator::Now () - it->second;
+  latency->m_generated.erase (it);
+}
+
+/**
+ * Downlinks to class B end devices are delivered in ping slots, long before
+ * the next uplink opens RW1/RW2
+ */
+class LoRaWANClassBNetworkTestCase : public TestCase
+{
+public:
+  LoRaWANClassBNetworkTestCase ();
+  virtual ~LoRaWANClassBNetworkTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANClassBNetworkTestCase::LoRaWANClassBNetworkTestCase ()
+  : TestCase ("Test the delivery of downlinks in class B ping slots")
+{
+}
+
+LoRaWANClassBNetworkTestCase::~LoRaWANClassBNetworkTestCase ()
+{
+}
+
+void
+LoRaWANClassBNetworkTestCase::DoRun (void)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (1);
+
+  const Time stop = Seconds (3000);
+  const double uplinkPeriod = 600.0;
+
+  Ptr<LoRaWANNetworkServer> ns = LoRaWANNetworkServer::getLoRaWANNetworkServerPointer ();
+  ns->SetAttribute ("GenerateDataDown", BooleanValue (true));
+  ns->SetAttribute ("DownstreamIAT", StringValue ("ns3::ExponentialRandomVariable[Mean=300]"));
+  ns->SetAttribute ("PingSlotPeriodicity", UintegerValue (0));
+
+  NodeContainer endDeviceNodes;
+  NodeContainer gatewayNodes;
+  endDeviceNodes.Create (10);
+  gatewayNodes.Create (1);
+
+  MobilityHelper mobility;
+  mobility.SetPositionAllocator ("ns3::UniformDiscPositionAllocator",
+                                 "X", DoubleValue (0.0),
+                                 "Y", DoubleValue (0.0),
+                                 "rho", DoubleValue (500.0));
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (endDeviceNodes);
+  mobility.Install (gatewayNodes);
+
+  LoRaWANHelper lorawanHelper;
+  lorawanHelper.Install (endDeviceNodes);
+  lorawanHelper.SetDeviceType (LORAWAN_DT_GATEWAY);
+  lorawanHelper.Install (gatewayNodes);
+
+  PacketSocketHelper packetSocket;
+  packetSocket.Install (endDeviceNodes);
+  packetSocket.Install (gatewayNodes);
+
+  LoRaWANEndDeviceHelper enddevicehelper;
+  enddevicehelper.SetAttribute ("UpstreamIAT", StringValue ("ns3::ConstantRandomVariable[Constant=600]"));
+  enddevicehelper.SetAttribute ("UpstreamSend", StringValue ("ns3::UniformRandomVariable[Min=0.0|Max=600]"));
+  enddevicehelper.SetAttribute ("ClassB", BooleanValue (true));
+  ApplicationContainer endDeviceApps = enddevicehelper.Install (endDeviceNodes);
+  LoRaWANGatewayHelper gatewayhelper;
+  gatewayhelper.SetAttribute ("Beacons", BooleanValue (true));
+  ApplicationContainer gatewayApps = gatewayhelper.Install (gatewayNodes);
+
+  LoRaWANClassBTestLatency latency = {};
+  ns->TraceConnectWithoutContext ("DSMsgGenerated", MakeBoundCallback (&DSMsgGenerated, &latency));
+  for (ApplicationContainer::Iterator it = endDeviceApps.Begin (); it != endDeviceApps.End (); ++it)
+    (*it)->TraceConnectWithoutContext ("DSMsgReceived", MakeBoundCallback (&DSMsgReceived, &latency));
+
+  Simulator::Stop (stop);
+  Simulator::Run ();
+
+  Ptr<LoRaWANGatewayApplication> gatewayApp = DynamicCast<LoRaWANGatewayApplication> (gatewayApps.Get (0));
+  NS_TEST_ASSERT_MSG_EQ (gatewayApp->GetNBeaconsSent (), stop.GetMicroSeconds () / BEACON_PERIOD, "A beacon was not sent");
+
+  NS_TEST_ASSERT_MSG_GT (latency.m_nPingSlot, 0, "No downlinks were received in a ping slot");
+  NS_TEST_ASSERT_MSG_GT (latency.m_nPingSlot, latency.m_nReceived / 2, "Most downlinks were not received in a ping slot");
+  double meanLatency = latency.m_totalLatency.GetSeconds () / latency.m_nReceived;
+  NS_TEST_ASSERT_MSG_LT (meanLatency, uplinkPeriod / 10, "Downlink latency is not below the uplink period");
+
+  ns = 0;
+  LoRaWANNetworkServer::clearLoRaWANNetworkServerPointer ();
+  Simulator::Destroy ();
+}
+
+// ==============================================================================
+class LoRaWANClassBTestSuite : public TestSuite
+{
+public:
+  LoRaWANClassBTestSuite ();
+};
+
+LoRaWANClassBTestSuite::LoRaWANClassBTestSuite ()
+  : TestSuite ("lorawan-class-b", UNIT)
+{
+  AddTestCase (new LoRaWANPingSlotTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANClassBNetworkTestCase, TestCase::QUICK);
+}
+
+static LoRaWANClassBTestSuite lorawanClassBTestSuite;
@@ -0,0 +1,133 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+#include <ns3/test.h>
+#include <ns3/log.h>
+#include <ns3/core-module.h>
+#include <ns3/network-module.h>
+#include <ns3/mobility-module.h>
+#include <ns3/lorawan-module.h>
+#include "ns3/rng-seed-manager.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-compact-enddevice-test");
+
+class LoRaWANCompactEndDeviceTestCase : public TestCase
+{
+public:
+  LoRaWANCompactEndDeviceTestCase ();
+  virtual ~LoRaWANCompactEndDeviceTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void UplinkTransmitted (uint32_t devAddr, uint8_t msgType, Ptr<const Packet> packet);
+
+  uint32_t m_nUplinks;
+};
+
+LoRaWANCompactEndDeviceTestCase::LoRaWANCompactEndDeviceTestCase ()
+  : TestCase ("Test whether uplinks of compact end devices reach the network server"),
+    m_nUplinks (0)
+{
+}
+
+LoRaWANCompactEndDeviceTestCase::~LoRaWANCompactEndDeviceTestCase ()
+{
+}
+
+void
+LoRaWANCompactEndDeviceTestCase::UplinkTransmitted (uint32_t devAddr, uint8_t msgType, Ptr<const Packet> packet)
+{
+  m_nUplinks++;
+}
+
+void
+LoRaWANCompactEndDeviceTestCase::DoRun (void)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (1);
+
+  NodeContainer gatewayNodes;
+  gatewayNodes.Create (1);
+  MobilityHelper mobility;
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (gatewayNodes);
+
+  LoRaWANHelper lorawanHelper;
+  lorawanHelper.SetDeviceType (LORAWAN_DT_GATEWAY);
+  lorawanHelper.Install (gatewayNodes);
+
+  PacketSocketHelper packetSocket;
+  packetSocket.Install (gatewayNodes);
+
+  LoRaWANGatewayHelper gatewayhelper;
+  gatewayhelper.Install (gatewayNodes);
+
+  Ptr<ListPositionAllocator> positions = CreateObject<ListPositionAllocator> ();
+  positions->Add (Vector (100.0, 0.0, 0.0));
+  positions->Add (Vector (0.0, 200.0, 0.0));
+  positions->Add (Vector (-300.0, 0.0, 0.0));
+
+  LoRaWANCompactEndDeviceHelper compactHelper;
+  compactHelper.SetChannel (lorawanHelper.GetChannel ());
+  compactHelper.SetPropagationLossModel (lorawanHelper.GetPropagationLossModel ());
+  Ptr<LoRaWANCompactEndDeviceFleet> fleet = compactHelper.Install (positions, 3);
+  fleet->TraceConnectWithoutContext ("USMsgTransmitted", MakeCallback (&LoRaWANCompactEndDeviceTestCase::UplinkTransmitted, this));
+
+  NS_TEST_ASSERT_MSG_EQ (fleet->GetNEndDevices (), 3, "Fleet does not hold all end devices");
+  uint32_t devAddr = fleet->GetEndDevice (1).m_devAddr;
+  NS_TEST_ASSERT_MSG_EQ (fleet->FindEndDevice (devAddr), 1, "End device not found on its address");
+  NS_TEST_ASSERT_MSG_EQ (fleet->FindEndDevice (0), 3, "Unknown address found in the fleet");
+
+  // Every device sends its first uplink within 600s, and the next one 600s later
+  Simulator::Stop (Seconds (1300));
+  Simulator::Run ();
+
+  Ptr<LoRaWANNetworkServer> ns = LoRaWANNetworkServer::getLoRaWANNetworkServerPointer ();
+  for (uint32_t i = 0; i < fleet->GetNEndDevices (); i++)
+    {
+      const LoRaWANCompactEndDevice& dev = fleet->GetEndDevice (i);
+      NS_TEST_ASSERT_MSG_EQ ((dev.m_fCntUp >= 2), true, "End device " << i << " sent too few uplinks");
+
+      LoRaWANEndDeviceInfoNS* info = ns->GetEndDeviceInfo (dev.m_devAddr);
+      NS_TEST_ASSERT_MSG_EQ ((info != nullptr), true, "Network server does not know end device " << i);
+      NS_TEST_ASSERT_MSG_EQ (info->m_fCntUp, dev.m_fCntUp, "Network server missed the last uplink of end device " << i);
+      NS_TEST_ASSERT_MSG_EQ (info->m_nUniqueUSPackets, dev.m_fCntUp, "Network server missed uplinks of end device " << i);
+    }
+  NS_TEST_ASSERT_MSG_EQ ((m_nUplinks >= 6), true, "USMsgTransmitted trace did not fire for every uplink");
+
+  LoRaWANNetworkServer::clearLoRaWANNetworkServerPointer ();
+  Simulator::Destroy ();
+}
+
+// ==============================================================================
+class LoRaWANCompactEndDeviceTestSuite : public TestSuite
+{
+public:
+  LoRaWANCompactEndDeviceTestSuite ();
+};
+
+LoRaWANCompactEndDeviceTestSuite::LoRaWANCompactEndDeviceTestSuite ()
+  : TestSuite ("lorawan-compact-enddevice", UNIT)
+{
+  AddTestCase (new LoRaWANCompactEndDeviceTestCase, TestCase::QUICK);
+}
+
+static LoRaWANCompactEndDeviceTestSuite lorawanCompactEndDeviceTestSuite;
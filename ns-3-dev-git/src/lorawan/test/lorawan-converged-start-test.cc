@@ -0,0 +1,151 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+#include <ns3/test.h>
+#include <ns3/log.h>
+#include <ns3/core-module.h>
+#include <ns3/network-module.h>
+#include <ns3/mobility-module.h>
+#include <ns3/lorawan-module.h>
+
+#include <utility>
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-converged-start-test");
+
+class LoRaWANConvergedStartTestCase : public TestCase
+{
+public:
+  LoRaWANConvergedStartTestCase ();
+  virtual ~LoRaWANConvergedStartTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * Build a network with one gateway and end devices on a line, simulate it
+   * until stop and return the data rate and tx power index of every end device
+   */
+  std::vector<std::pair<uint32_t, uint32_t> > Run (bool convergedStart, Time stop);
+};
+
+LoRaWANConvergedStartTestCase::LoRaWANConvergedStartTestCase ()
+  : TestCase ("Test that end devices started by the link budget oracle start where ADR converges to")
+{
+}
+
+LoRaWANConvergedStartTestCase::~LoRaWANConvergedStartTestCase ()
+{
+}
+
+std::vector<std::pair<uint32_t, uint32_t> >
+LoRaWANConvergedStartTestCase::Run (bool convergedStart, Time stop)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (1);
+
+  // Distances from far out of reach at DR5 to close to the gateway, spread so
+  // that the devices do not end up on a boundary between two settings
+  const std::vector<double> distances = {4300.0, 3100.0, 2300.0, 1500.0, 900.0, 250.0};
+
+  NodeContainer endDeviceNodes;
+  NodeContainer gatewayNodes;
+  endDeviceNodes.Create (distances.size ());
+  gatewayNodes.Create (1);
+
+  Ptr<ListPositionAllocator> edPositions = CreateObject<ListPositionAllocator> ();
+  for (auto d : distances)
+    edPositions->Add (Vector (d, 0.0, 0.0));
+  MobilityHelper edMobility;
+  edMobility.SetPositionAllocator (edPositions);
+  edMobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  edMobility.Install (endDeviceNodes);
+  MobilityHelper gwMobility;
+  gwMobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  gwMobility.Install (gatewayNodes);
+
+  LoRaWANHelper lorawanHelper;
+  lorawanHelper.SetNbRep (1);
+  lorawanHelper.Install (endDeviceNodes);
+  lorawanHelper.SetDeviceType (LORAWAN_DT_GATEWAY);
+  lorawanHelper.Install (gatewayNodes);
+
+  PacketSocketHelper packetSocket;
+  packetSocket.Install (endDeviceNodes);
+  packetSocket.Install (gatewayNodes);
+
+  LoRaWANEndDeviceHelper enddevicehelper;
+  enddevicehelper.SetAttribute ("DataRateIndex", UintegerValue (0));
+  enddevicehelper.SetConvergedStart (convergedStart);
+  enddevicehelper.SetPropagationLossModel (lorawanHelper.GetPropagationLossModel ());
+  ApplicationContainer enddeviceApps = enddevicehelper.Install (endDeviceNodes);
+  LoRaWANGatewayHelper gatewayhelper;
+  gatewayhelper.Install (gatewayNodes);
+
+  Simulator::Stop (stop);
+  Simulator::Run ();
+
+  std::vector<std::pair<uint32_t, uint32_t> > settings;
+  for (ApplicationContainer::Iterator it = enddeviceApps.Begin (); it != enddeviceApps.End (); ++it)
+    {
+      Ptr<LoRaWANEndDeviceApplication> app = DynamicCast<LoRaWANEndDeviceApplication> (*it);
+      settings.push_back (std::make_pair (app->GetDataRateIndex (), (uint32_t)app->GetTxPowerIndex ()));
+    }
+
+  LoRaWANNetworkServer::clearLoRaWANNetworkServerPointer ();
+  Simulator::Destroy ();
+  return settings;
+}
+
+void
+LoRaWANConvergedStartTestCase::DoRun (void)
+{
+  const std::vector<std::pair<uint32_t, uint32_t> > start = Run (true, Seconds (1));
+  const std::vector<std::pair<uint32_t, uint32_t> > converged = Run (false, Seconds (600 * 100));
+
+  bool spread = false;
+  for (uint32_t i = 0; i < start.size (); i++)
+    {
+      NS_LOG_INFO ("end device " << i << ": converged start DR" << start[i].first << " tx " << start[i].second
+                   << ", after ADR DR" << converged[i].first << " tx " << converged[i].second);
+      NS_TEST_ASSERT_MSG_EQ (start[i].first, converged[i].first, "Wrong start data rate for end device " << i);
+      NS_TEST_ASSERT_MSG_EQ (start[i].second, converged[i].second, "Wrong start tx power index for end device " << i);
+      spread |= start[i].first != start[0].first;
+    }
+  NS_TEST_ASSERT_MSG_EQ (spread, true, "All end devices converge to the same data rate");
+  NS_TEST_ASSERT_MSG_EQ (start.back ().first, 5, "Closest end device should use DR5");
+  NS_TEST_ASSERT_MSG_GT (start.back ().second, 0, "Closest end device should lower its tx power");
+}
+
+// ==============================================================================
+class LoRaWANConvergedStartTestSuite : public TestSuite
+{
+public:
+  LoRaWANConvergedStartTestSuite ();
+};
+
+LoRaWANConvergedStartTestSuite::LoRaWANConvergedStartTestSuite ()
+  : TestSuite ("lorawan-converged-start", UNIT)
+{
+  AddTestCase (new LoRaWANConvergedStartTestCase, TestCase::QUICK);
+}
+
+static LoRaWANConvergedStartTestSuite lorawanConvergedStartTestSuite;
@@ -0,0 +1,135 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+#include <ns3/test.h>
+#include <ns3/log.h>
+#include <ns3/core-module.h>
+#include <ns3/network-module.h>
+#include <ns3/mobility-module.h>
+#include <ns3/lorawan-module.h>
+#include "ns3/rng-seed-manager.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-deduplication-test");
+
+/*
+ * Every uplink is received by three gateways, the network server should
+ * process it once with a gateway diversity of three, both when the copies
+ * are merged inside the deduplication window and when they arrive after it.
+ */
+class LoRaWANDeduplicationTestCase : public TestCase
+{
+public:
+  LoRaWANDeduplicationTestCase (Time deduplicationWindow);
+  virtual ~LoRaWANDeduplicationTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  Time m_deduplicationWindow;
+};
+
+LoRaWANDeduplicationTestCase::LoRaWANDeduplicationTestCase (Time deduplicationWindow)
+  : TestCase ("Test whether the network server merges the gateway copies of an uplink, window = " + std::to_string (deduplicationWindow.GetMilliSeconds ()) + "ms"),
+    m_deduplicationWindow (deduplicationWindow)
+{
+}
+
+LoRaWANDeduplicationTestCase::~LoRaWANDeduplicationTestCase ()
+{
+}
+
+void
+LoRaWANDeduplicationTestCase::DoRun (void)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (1);
+
+  Ptr<LoRaWANNetworkServer> ns = LoRaWANNetworkServer::getLoRaWANNetworkServerPointer ();
+  ns->SetAttribute ("DeduplicationWindow", TimeValue (m_deduplicationWindow));
+
+  NodeContainer gatewayNodes;
+  gatewayNodes.Create (3);
+  Ptr<ListPositionAllocator> gatewayPositions = CreateObject<ListPositionAllocator> ();
+  gatewayPositions->Add (Vector (0.0, 0.0, 0.0));
+  gatewayPositions->Add (Vector (500.0, 0.0, 0.0));
+  gatewayPositions->Add (Vector (0.0, 1000.0, 0.0));
+  MobilityHelper mobility;
+  mobility.SetPositionAllocator (gatewayPositions);
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (gatewayNodes);
+
+  LoRaWANHelper lorawanHelper;
+  lorawanHelper.SetDeviceType (LORAWAN_DT_GATEWAY);
+  lorawanHelper.Install (gatewayNodes);
+
+  PacketSocketHelper packetSocket;
+  packetSocket.Install (gatewayNodes);
+
+  LoRaWANGatewayHelper gatewayhelper;
+  gatewayhelper.Install (gatewayNodes);
+
+  Ptr<ListPositionAllocator> positions = CreateObject<ListPositionAllocator> ();
+  positions->Add (Vector (100.0, 0.0, 0.0));
+  positions->Add (Vector (0.0, 200.0, 0.0));
+
+  LoRaWANCompactEndDeviceHelper compactHelper;
+  compactHelper.SetChannel (lorawanHelper.GetChannel ());
+  compactHelper.SetPropagationLossModel (lorawanHelper.GetPropagationLossModel ());
+  Ptr<LoRaWANCompactEndDeviceFleet> fleet = compactHelper.Install (positions, 2);
+
+  Simulator::Stop (Seconds (1300));
+  Simulator::Run ();
+
+  for (uint32_t i = 0; i < fleet->GetNEndDevices (); i++)
+    {
+      const LoRaWANCompactEndDevice& dev = fleet->GetEndDevice (i);
+      NS_TEST_ASSERT_MSG_EQ ((dev.m_fCntUp >= 2), true, "End device " << i << " sent too few uplinks");
+
+      LoRaWANEndDeviceInfoNS* info = ns->GetEndDeviceInfo (dev.m_devAddr);
+      NS_TEST_ASSERT_MSG_EQ ((info != nullptr), true, "Network server does not know end device " << i);
+      NS_TEST_ASSERT_MSG_EQ (info->m_nUSPackets, 3 * dev.m_fCntUp, "Not every gateway forwarded the uplinks of end device " << i);
+      NS_TEST_ASSERT_MSG_EQ (info->m_nUniqueUSPackets, dev.m_fCntUp, "Uplinks of end device " << i << " were not processed exactly once");
+      NS_TEST_ASSERT_MSG_EQ (info->m_nUSRetransmission, 0, "Gateway copies of end device " << i << " were taken for retransmissions");
+      NS_TEST_ASSERT_MSG_EQ (info->m_nUSDuplicates, 2 * dev.m_fCntUp, "Gateway copies of end device " << i << " were not merged");
+      NS_TEST_ASSERT_MSG_EQ (info->m_lastGWs.size (), 3, "Not every receiving gateway is available for the downlink to end device " << i);
+      NS_TEST_ASSERT_MSG_EQ (info->m_frameSNRHistory.size (), dev.m_fCntUp, "SNR history of end device " << i << " does not hold one row per uplink");
+      NS_TEST_ASSERT_MSG_EQ ((uint32_t)info->m_frameSNRHistory.front ().gtwDiversity, 3, "Wrong gateway diversity for end device " << i);
+    }
+
+  LoRaWANNetworkServer::clearLoRaWANNetworkServerPointer ();
+  Simulator::Destroy ();
+}
+
+// ==============================================================================
+class LoRaWANDeduplicationTestSuite : public TestSuite
+{
+public:
+  LoRaWANDeduplicationTestSuite ();
+};
+
+LoRaWANDeduplicationTestSuite::LoRaWANDeduplicationTestSuite ()
+  : TestSuite ("lorawan-deduplication", UNIT)
+{
+  AddTestCase (new LoRaWANDeduplicationTestCase (MilliSeconds (200)), TestCase::QUICK);
+  AddTestCase (new LoRaWANDeduplicationTestCase (Seconds (0)), TestCase::QUICK);
+}
+
+static LoRaWANDeduplicationTestSuite lorawanDeduplicationTestSuite;
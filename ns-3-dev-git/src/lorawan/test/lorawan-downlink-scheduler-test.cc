@@ -0,0 +1,126 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+#include <ns3/test.h>
+#include <ns3/log.h>
+#include <ns3/core-module.h>
+#include <ns3/network-module.h>
+#include <ns3/mobility-module.h>
+#include <ns3/lorawan-module.h>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-downlink-scheduler-test");
+
+class LoRaWANDownlinkSchedulerTestCase : public TestCase
+{
+public:
+  LoRaWANDownlinkSchedulerTestCase ();
+  virtual ~LoRaWANDownlinkSchedulerTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void AlternativeGateway (uint32_t oldValue, uint32_t newValue);
+
+  uint32_t m_nrAlternativeGateway;
+};
+
+LoRaWANDownlinkSchedulerTestCase::LoRaWANDownlinkSchedulerTestCase ()
+  : TestCase ("Test TX occupancy and duty cycle tracking of the downlink scheduler"),
+    m_nrAlternativeGateway (0)
+{
+}
+
+LoRaWANDownlinkSchedulerTestCase::~LoRaWANDownlinkSchedulerTestCase ()
+{
+}
+
+void
+LoRaWANDownlinkSchedulerTestCase::AlternativeGateway (uint32_t oldValue, uint32_t newValue)
+{
+  m_nrAlternativeGateway = newValue;
+}
+
+void
+LoRaWANDownlinkSchedulerTestCase::DoRun (void)
+{
+  NodeContainer gatewayNodes;
+  gatewayNodes.Create (2);
+  MobilityHelper mobility;
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (gatewayNodes);
+
+  LoRaWANHelper lorawanHelper;
+  lorawanHelper.SetDeviceType (LORAWAN_DT_GATEWAY);
+  lorawanHelper.Install (gatewayNodes);
+
+  PacketSocketHelper packetSocket;
+  packetSocket.Install (gatewayNodes);
+
+  LoRaWANGatewayHelper gatewayhelper;
+  ApplicationContainer gatewayApps = gatewayhelper.Install (gatewayNodes);
+  Ptr<LoRaWANGatewayApplication> gw0 = DynamicCast<LoRaWANGatewayApplication> (gatewayApps.Get (0));
+  Ptr<LoRaWANGatewayApplication> gw1 = DynamicCast<LoRaWANGatewayApplication> (gatewayApps.Get (1));
+
+  Ptr<LoRaWANDownlinkScheduler> scheduler = CreateObject<LoRaWANDownlinkScheduler> ();
+  scheduler->TraceConnectWithoutContext ("nrAlternativeGateway", MakeCallback (&LoRaWANDownlinkSchedulerTestCase::AlternativeGateway, this));
+
+  // Channels 0 and 1 share the 1% sub band, channel 7 (RW2) is on the 10% sub band
+  const Time start = Seconds (10);
+  const uint32_t size = 20;
+  const Time airTime = LoRaWANDownlinkScheduler::GetAirTime (0, 5, size);
+
+  NS_TEST_ASSERT_MSG_EQ (scheduler->CanSend (gw0, 0, 5, start, size), true, "Idle gateway should be able to send");
+  scheduler->Reserve (gw0, 0, 5, start, size);
+  NS_TEST_ASSERT_MSG_EQ (scheduler->GetNReservations (gw0), 1, "Reservation not recorded");
+
+  NS_TEST_ASSERT_MSG_EQ (scheduler->CanSend (gw0, 7, 0, start + airTime / 2, size), false, "Gateway is transmitting another downlink");
+  NS_TEST_ASSERT_MSG_EQ (scheduler->CanSend (gw0, 7, 0, start + airTime, size), true, "Other sub band should be available after the downlink");
+  NS_TEST_ASSERT_MSG_EQ (scheduler->CanSend (gw0, 1, 5, start + airTime * 50, size), false, "Sub band should be in its off time");
+  NS_TEST_ASSERT_MSG_EQ (scheduler->CanSend (gw0, 1, 5, start + airTime * 100, size), true, "Sub band should be available after its off time");
+  NS_TEST_ASSERT_MSG_EQ (scheduler->CanSend (gw0, 0, 5, start - airTime * 10, size), false, "Off time would overlap with the reserved downlink");
+  NS_TEST_ASSERT_MSG_EQ (scheduler->CanSend (gw1, 0, 5, start, size), true, "Reservation on another gateway should not matter");
+
+  std::vector<Ptr<LoRaWANGatewayApplication> > gateways = {gw0, gw1};
+  NS_TEST_ASSERT_MSG_EQ (scheduler->SelectGateway (gateways, 0, 5, start + airTime / 2, size), gw1, "Busy gateway selected");
+  NS_TEST_ASSERT_MSG_EQ (m_nrAlternativeGateway, 1, "Alternative gateway not counted");
+  NS_TEST_ASSERT_MSG_EQ (scheduler->SelectGateway (gateways, 7, 0, start + airTime, size), gw0, "Most preferred gateway not selected");
+
+  NS_TEST_ASSERT_MSG_EQ (scheduler->Release (gw0, start), true, "Reservation not released");
+  NS_TEST_ASSERT_MSG_EQ (scheduler->Release (gw0, start), false, "Reservation released twice");
+  NS_TEST_ASSERT_MSG_EQ (scheduler->CanSend (gw0, 0, 5, start, size), true, "Released gateway should be able to send");
+
+  LoRaWANNetworkServer::clearLoRaWANNetworkServerPointer ();
+  Simulator::Destroy ();
+}
+
+// ==============================================================================
+class LoRaWANDownlinkSchedulerTestSuite : public TestSuite
+{
+public:
+  LoRaWANDownlinkSchedulerTestSuite ();
+};
+
+LoRaWANDownlinkSchedulerTestSuite::LoRaWANDownlinkSchedulerTestSuite ()
+  : TestSuite ("lorawan-downlink-scheduler", UNIT)
+{
+  AddTestCase (new LoRaWANDownlinkSchedulerTestCase, TestCase::QUICK);
+}
+
+static LoRaWANDownlinkSchedulerTestSuite lorawanDownlinkSchedulerTestSuite;
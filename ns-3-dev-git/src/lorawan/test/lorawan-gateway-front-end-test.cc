@@ -0,0 +1,341 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+#include <ns3/test.h>
+#include <ns3/log.h>
+#include <ns3/core-module.h>
+#include <ns3/lorawan-module.h>
+#include <ns3/propagation-loss-model.h>
+#include <ns3/propagation-delay-model.h>
+#include <ns3/constant-position-mobility-model.h>
+#include <ns3/node.h>
+
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-gateway-front-end-test");
+
+/**
+ * The scenario of lorawan-gateway-forceoff with and without the shared
+ * front-end: the downlink to node 0 aborts the reception of the uplink of
+ * node 1 on the same PHY either way, but the shared front-end does not
+ * switch the other PHYs of the gateway
+ */
+class LoRaWANGatewayFrontEndHalfDuplexTestCase : public TestCase
+{
+public:
+  LoRaWANGatewayFrontEndHalfDuplexTestCase ();
+  virtual ~LoRaWANGatewayFrontEndHalfDuplexTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  void Run (bool sharedFrontEnd);
+  void GatewayDataIndication (LoRaWANDataIndicationParams params, Ptr<Packet> p);
+  void EndDeviceDataIndication (LoRaWANDataIndicationParams params, Ptr<Packet> p);
+  static void CountTrxState (uint32_t *nStates, LoRaWANPhyEnumeration oldState, LoRaWANPhyEnumeration newState);
+
+  bool m_node0USReceived;
+  bool m_node1USReceived;
+  bool m_node0DSReceived;
+  uint32_t m_nGatewayTrxStates;
+  uint32_t m_nGatewayPhys;
+};
+
+LoRaWANGatewayFrontEndHalfDuplexTestCase::LoRaWANGatewayFrontEndHalfDuplexTestCase ()
+  : TestCase ("Test that a downlink aborts a reception with the shared front-end of a gateway"),
+    m_node0USReceived (false),
+    m_node1USReceived (false),
+    m_node0DSReceived (false),
+    m_nGatewayTrxStates (0),
+    m_nGatewayPhys (0)
+{
+}
+
+LoRaWANGatewayFrontEndHalfDuplexTestCase::~LoRaWANGatewayFrontEndHalfDuplexTestCase ()
+{
+}
+
+void
+LoRaWANGatewayFrontEndHalfDuplexTestCase::GatewayDataIndication (LoRaWANDataIndicationParams params, Ptr<Packet> p)
+{
+  LoRaWANFrameHeaderUplink frmHdr;
+  p->RemoveHeader (frmHdr);
+  if (frmHdr.getDevAddr () == Ipv4Address (0x00000001))
+    m_node0USReceived = true;
+  else if (frmHdr.getDevAddr () == Ipv4Address (0x00000002))
+    m_node1USReceived = true;
+}
+
+void
+LoRaWANGatewayFrontEndHalfDuplexTestCase::EndDeviceDataIndication (LoRaWANDataIndicationParams params, Ptr<Packet> p)
+{
+  m_node0DSReceived = true;
+}
+
+void
+LoRaWANGatewayFrontEndHalfDuplexTestCase::CountTrxState (uint32_t *nStates, LoRaWANPhyEnumeration oldState, LoRaWANPhyEnumeration newState)
+{
+  (*nStates)++;
+}
+
+void
+LoRaWANGatewayFrontEndHalfDuplexTestCase::Run (bool sharedFrontEnd)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (6);
+
+  m_node0USReceived = false;
+  m_node1USReceived = false;
+  m_node0DSReceived = false;
+  m_nGatewayTrxStates = 0;
+
+  Ptr<Node> n0 = CreateObject <Node> ();
+  Ptr<Node> n1 = CreateObject <Node> ();
+  Ptr<Node> gw = CreateObject <Node> ();
+  Ptr<LoRaWANNetDevice> dev0 = CreateObject<LoRaWANNetDevice> (LORAWAN_DT_END_DEVICE_CLASS_A);
+  Ptr<LoRaWANNetDevice> dev1 = CreateObject<LoRaWANNetDevice> (LORAWAN_DT_END_DEVICE_CLASS_A);
+  Ptr<LoRaWANNetDevice> devGw = CreateObject<LoRaWANNetDevice> (LORAWAN_DT_GATEWAY);
+  devGw->SetAttribute ("SharedFrontEnd", BooleanValue (sharedFrontEnd));
+  dev0->SetAddress (Ipv4Address (0x00000001));
+  dev1->SetAddress (Ipv4Address (0x00000002));
+
+  Ptr<LoRaWANSpectrumChannel> channel = CreateObject<LoRaWANSpectrumChannel> ();
+  channel->AddPropagationLossModel (CreateObject<LogDistancePropagationLossModel> ());
+  channel->SetPropagationDelayModel (CreateObject<ConstantSpeedPropagationDelayModel> ());
+  dev0->SetChannel (channel);
+  dev1->SetChannel (channel);
+  devGw->SetChannel (channel);
+  n0->AddDevice (dev0);
+  n1->AddDevice (dev1);
+  gw->AddDevice (devGw);
+  m_nGatewayPhys = devGw->GetPhys ().size ();
+
+  Ptr<ConstantPositionMobilityModel> mobility0 = CreateObject<ConstantPositionMobilityModel> ();
+  mobility0->SetPosition (Vector (0, 5, 0));
+  dev0->GetPhy ()->SetMobility (mobility0);
+  Ptr<ConstantPositionMobilityModel> mobility1 = CreateObject<ConstantPositionMobilityModel> ();
+  mobility1->SetPosition (Vector (5, 0, 0));
+  dev1->GetPhy ()->SetMobility (mobility1);
+  Ptr<ConstantPositionMobilityModel> mobilityGw = CreateObject<ConstantPositionMobilityModel> ();
+  mobilityGw->SetPosition (Vector (0, 0, 0));
+  for (auto &it : devGw->GetPhys ()) {
+    it->SetMobility (mobilityGw);
+    it->TraceConnectWithoutContext ("TrxState", MakeBoundCallback (&LoRaWANGatewayFrontEndHalfDuplexTestCase::CountTrxState, &m_nGatewayTrxStates));
+  }
+
+  dev0->GetMac ()->SetDataIndicationCallback (MakeCallback (&LoRaWANGatewayFrontEndHalfDuplexTestCase::EndDeviceDataIndication, this));
+  for (auto &it : devGw->GetMacs ())
+    it->SetDataIndicationCallback (MakeCallback (&LoRaWANGatewayFrontEndHalfDuplexTestCase::GatewayDataIndication, this));
+
+  LoRaWANDataRequestParams params;
+  params.m_loraWANChannelIndex = 0;
+  params.m_loraWANDataRateIndex = 5;
+  params.m_loraWANCodeRate = 3;
+  params.m_loraWANTxPowerIndex = 0;
+  params.m_msgType = LORAWAN_UNCONFIRMED_DATA_UP;
+  params.m_requestHandle = 1;
+  params.m_numberOfTransmissions = 1;
+
+  Ptr<Packet> p0 = Create<Packet> (20);
+  LoRaWANFrameHeaderUplink frmHdr0;
+  frmHdr0.setDevAddr (Ipv4Address (0x00000001));
+  frmHdr0.setFrameCounter (1);
+  p0->AddHeader (frmHdr0);
+  Simulator::ScheduleNow (&LoRaWANMac::sendMACPayloadRequest, dev0->GetMac (), params, p0);
+
+  // The uplink of node 1 is still on air when the gateway sends to node 0 in its RW1, on the same channel and data rate
+  Ptr<Packet> p1 = Create<Packet> (20);
+  LoRaWANFrameHeaderUplink frmHdr1;
+  frmHdr1.setDevAddr (Ipv4Address (0x00000002));
+  frmHdr1.setFrameCounter (1);
+  p1->AddHeader (frmHdr1);
+  params.m_requestHandle = 2;
+  Simulator::Schedule (Seconds (1.100 - 0.040), &LoRaWANMac::sendMACPayloadRequest, dev1->GetMac (), params, p1);
+
+  Ptr<Packet> p2 = Create<Packet> (20);
+  LoRaWANFrameHeaderDownlink frmHdr2;
+  frmHdr2.setDevAddr (Ipv4Address (0x00000001));
+  frmHdr2.setFrameCounter (1);
+  p2->AddHeader (frmHdr2);
+  params.m_msgType = LORAWAN_UNCONFIRMED_DATA_DOWN;
+  params.m_requestHandle = 3;
+  uint8_t macIndex = 0;
+  NS_ASSERT (devGw->getMACSIndexForChannelAndDataRate (macIndex, params.m_loraWANChannelIndex, params.m_loraWANDataRateIndex));
+  Simulator::Schedule (Seconds (1.100), &LoRaWANMac::sendMACPayloadRequest, devGw->GetMacs ()[macIndex], params, p2);
+
+  Simulator::Stop (Seconds (10.11));
+  Simulator::Run ();
+  Simulator::Destroy ();
+}
+
+void
+LoRaWANGatewayFrontEndHalfDuplexTestCase::DoRun (void)
+{
+  Run (false);
+  uint32_t nTrxStatesPerMac = m_nGatewayTrxStates;
+  NS_TEST_ASSERT_MSG_EQ (m_node0USReceived, true, "Failed to receive US packet from node 0 at GW");
+  NS_TEST_ASSERT_MSG_EQ (m_node1USReceived, false, "Received US packet from node 1 at GW during the DS TX");
+  NS_TEST_ASSERT_MSG_EQ (m_node0DSReceived, true, "Failed to receive DS packet from GW at node 0");
+
+  Run (true);
+  NS_TEST_ASSERT_MSG_EQ (m_node0USReceived, true, "Failed to receive US packet from node 0 at GW with the shared front-end");
+  NS_TEST_ASSERT_MSG_EQ (m_node1USReceived, false, "Received US packet from node 1 at GW during the DS TX with the shared front-end");
+  NS_TEST_ASSERT_MSG_EQ (m_node0DSReceived, true, "Failed to receive DS packet from GW at node 0 with the shared front-end");
+  // Without the shared front-end, the PHYs not taking part in the downlink are switched off and back on
+  NS_TEST_ASSERT_MSG_EQ (nTrxStatesPerMac - m_nGatewayTrxStates, 2 * (m_nGatewayPhys - 1), "The shared front-end still switches the other PHYs of the gateway");
+}
+
+/**
+ * A MAC of the gateway that has a frame to send while another one transmits
+ * drops it, as the receive window of the frame is missed
+ */
+class LoRaWANGatewayFrontEndDroppedTxTestCase : public TestCase
+{
+public:
+  LoRaWANGatewayFrontEndDroppedTxTestCase ();
+  virtual ~LoRaWANGatewayFrontEndDroppedTxTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  static void PhyTxBegin (std::vector<Time> *times, Ptr<const Packet> p);
+  static void PhyTxEnd (std::vector<Time> *times, Ptr<const Packet> p);
+  static void MacTxDrop (uint32_t *nDrops, Ptr<const Packet> p);
+  static void DataConfirm (std::vector<LoRaWANDataConfirmParams> *confirms, LoRaWANDataConfirmParams params);
+};
+
+LoRaWANGatewayFrontEndDroppedTxTestCase::LoRaWANGatewayFrontEndDroppedTxTestCase ()
+  : TestCase ("Test downlinks requested on two MACs of a gateway at once")
+{
+}
+
+LoRaWANGatewayFrontEndDroppedTxTestCase::~LoRaWANGatewayFrontEndDroppedTxTestCase ()
+{
+}
+
+void
+LoRaWANGatewayFrontEndDroppedTxTestCase::PhyTxBegin (std::vector<Time> *times, Ptr<const Packet> p)
+{
+  times->push_back (Simulator::Now ());
+}
+
+void
+LoRaWANGatewayFrontEndDroppedTxTestCase::PhyTxEnd (std::vector<Time> *times, Ptr<const Packet> p)
+{
+  times->push_back (Simulator::Now ());
+}
+
+void
+LoRaWANGatewayFrontEndDroppedTxTestCase::MacTxDrop (uint32_t *nDrops, Ptr<const Packet> p)
+{
+  (*nDrops)++;
+}
+
+void
+LoRaWANGatewayFrontEndDroppedTxTestCase::DataConfirm (std::vector<LoRaWANDataConfirmParams> *confirms, LoRaWANDataConfirmParams params)
+{
+  confirms->push_back (params);
+}
+
+void
+LoRaWANGatewayFrontEndDroppedTxTestCase::DoRun (void)
+{
+  Ptr<Node> gw = CreateObject <Node> ();
+  Ptr<LoRaWANNetDevice> devGw = CreateObject<LoRaWANNetDevice> (LORAWAN_DT_GATEWAY);
+  Ptr<LoRaWANSpectrumChannel> channel = CreateObject<LoRaWANSpectrumChannel> ();
+  channel->AddPropagationLossModel (CreateObject<LogDistancePropagationLossModel> ());
+  channel->SetPropagationDelayModel (CreateObject<ConstantSpeedPropagationDelayModel> ());
+  devGw->SetChannel (channel);
+  gw->AddDevice (devGw);
+
+  std::vector<Time> txBegin;
+  std::vector<Time> txEnd;
+  Ptr<ConstantPositionMobilityModel> mobilityGw = CreateObject<ConstantPositionMobilityModel> ();
+  for (auto &it : devGw->GetPhys ()) {
+    it->SetMobility (mobilityGw);
+    it->TraceConnectWithoutContext ("PhyTxBegin", MakeBoundCallback (&LoRaWANGatewayFrontEndDroppedTxTestCase::PhyTxBegin, &txBegin));
+    it->TraceConnectWithoutContext ("PhyTxEnd", MakeBoundCallback (&LoRaWANGatewayFrontEndDroppedTxTestCase::PhyTxEnd, &txEnd));
+  }
+  uint32_t nDrops = 0;
+  std::vector<LoRaWANDataConfirmParams> confirms;
+  for (auto &it : devGw->GetMacs ()) {
+    it->TraceConnectWithoutContext ("MacTxDrop", MakeBoundCallback (&LoRaWANGatewayFrontEndDroppedTxTestCase::MacTxDrop, &nDrops));
+    it->SetDataConfirmCallback (MakeBoundCallback (&LoRaWANGatewayFrontEndDroppedTxTestCase::DataConfirm, &confirms));
+  }
+
+  LoRaWANDataRequestParams params;
+  params.m_loraWANCodeRate = 3;
+  params.m_loraWANTxPowerIndex = 0;
+  params.m_msgType = LORAWAN_UNCONFIRMED_DATA_DOWN;
+  params.m_numberOfTransmissions = 1;
+
+  // One downlink in RW1 of an uplink on channel 0 and one in RW2, in another sub band
+  uint8_t channelIndex[2] = {0, LoRaWAN::m_RW2ChannelIndex};
+  uint8_t dataRateIndex[2] = {5, LoRaWAN::m_RW2DataRateIndex};
+  for (uint8_t i = 0; i < 2; i++) {
+    params.m_loraWANChannelIndex = channelIndex[i];
+    params.m_loraWANDataRateIndex = dataRateIndex[i];
+    params.m_requestHandle = i + 1;
+
+    Ptr<Packet> p = Create<Packet> (20);
+    LoRaWANFrameHeaderDownlink frmHdr;
+    frmHdr.setDevAddr (Ipv4Address (i + 1));
+    frmHdr.setFrameCounter (1);
+    p->AddHeader (frmHdr);
+
+    uint8_t macIndex = 0;
+    NS_ASSERT (devGw->getMACSIndexForChannelAndDataRate (macIndex, params.m_loraWANChannelIndex, params.m_loraWANDataRateIndex));
+    Simulator::Schedule (Seconds (1), &LoRaWANMac::sendMACPayloadRequest, devGw->GetMacs ()[macIndex], params, p);
+  }
+
+  const uint32_t nInUse = LoRaWANMac::GetTxQueuePoolNInUse ();
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (txBegin.size (), 1, "The gateway sent the second downlink after its receive window");
+  NS_TEST_ASSERT_MSG_EQ (txEnd.size (), 1, "The gateway did not finish the first downlink");
+  NS_TEST_ASSERT_MSG_EQ (txBegin[0], Seconds (1), "The first downlink was not sent right away");
+  NS_TEST_ASSERT_MSG_EQ (nDrops, 1, "The second downlink was not dropped");
+  // The second downlink is dropped when its MAC finds the front-end transmitting, before the first one ends
+  NS_TEST_ASSERT_MSG_EQ (confirms.size (), 2, "Both downlinks were not confirmed");
+  NS_TEST_ASSERT_MSG_EQ (confirms[0].m_requestHandle, 2, "The second downlink was not confirmed first");
+  NS_TEST_ASSERT_MSG_EQ ((confirms[0].m_status == LORAWAN_CHANNEL_ACCESS_FAILURE), true, "The second downlink was not confirmed as failed, status = " << confirms[0].m_status);
+  NS_TEST_ASSERT_MSG_EQ (confirms[1].m_requestHandle, 1, "The first downlink was not confirmed last");
+  NS_TEST_ASSERT_MSG_EQ ((confirms[1].m_status == LORAWAN_SUCCESS), true, "The first downlink was not confirmed as sent, status = " << confirms[1].m_status);
+  NS_TEST_ASSERT_MSG_EQ (LoRaWANMac::GetTxQueuePoolNInUse (), nInUse, "The second downlink is still queued");
+
+  Simulator::Destroy ();
+}
+
+// ==============================================================================
+class LoRaWANGatewayFrontEndTestSuite : public TestSuite
+{
+public:
+  LoRaWANGatewayFrontEndTestSuite ();
+};
+
+LoRaWANGatewayFrontEndTestSuite::LoRaWANGatewayFrontEndTestSuite ()
+  : TestSuite ("lorawan-gateway-front-end", UNIT)
+{
+  AddTestCase (new LoRaWANGatewayFrontEndHalfDuplexTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANGatewayFrontEndDroppedTxTestCase, TestCase::QUICK);
+}
+
+static LoRaWANGatewayFrontEndTestSuite lorawanGatewayFrontEndTestSuite;
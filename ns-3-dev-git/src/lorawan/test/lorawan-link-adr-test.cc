@@ -0,0 +1,237 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+#include <ns3/test.h>
+#include <ns3/log.h>
+#include <ns3/core-module.h>
+#include <ns3/lorawan-module.h>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-link-adr-test");
+
+/**
+ * The NbTrans and channel mask fields of LinkADRReq survive serialization,
+ * and end devices only accept channel masks of existing uplink channels
+ */
+class LoRaWANLinkAdrChannelMaskTestCase : public TestCase
+{
+public:
+  LoRaWANLinkAdrChannelMaskTestCase ();
+  virtual ~LoRaWANLinkAdrChannelMaskTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANLinkAdrChannelMaskTestCase::LoRaWANLinkAdrChannelMaskTestCase ()
+  : TestCase ("Test the channel mask and NbTrans of LinkADRReq")
+{
+}
+
+LoRaWANLinkAdrChannelMaskTestCase::~LoRaWANLinkAdrChannelMaskTestCase ()
+{
+}
+
+void
+LoRaWANLinkAdrChannelMaskTestCase::DoRun (void)
+{
+  LoRaWANFrameHeaderDownlink fhdr;
+  fhdr.setDevAddr (Ipv4Address (42));
+  NS_TEST_ASSERT_MSG_EQ (fhdr.AddLoRaADRReq (3, 2, 0x05, 0, 12), true, "LinkADRReq not added");
+
+  Ptr<Packet> p = Create<Packet> (10);
+  p->AddHeader (fhdr);
+  LoRaWANFrameHeaderDownlink received;
+  p->RemoveHeader (received);
+  NS_TEST_ASSERT_MSG_EQ (received.m_macCommandsNS[LinkADRReq].m_isBeingUsed, true, "LinkADRReq not deserialized");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)received.m_dataRateIndex, 3, "Wrong data rate");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)received.m_txPowerIndex, 2, "Wrong tx power");
+  NS_TEST_ASSERT_MSG_EQ (received.m_channelMaskBytes, 0x05, "Wrong channel mask");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)received.m_chMaskCntl, 0, "Wrong ChMaskCntl");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)received.m_nbTrans, 12, "Wrong NbTrans");
+
+  // channels 0 and 2 only
+  const uint16_t defaultMask = LoRaWAN::GetDefaultUplinkChannelMask ();
+  uint16_t channelMask = defaultMask;
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::ApplyLinkADRChannelMask (channelMask, received.m_channelMaskBytes, received.m_chMaskCntl), true, "Channel mask rejected");
+  NS_TEST_ASSERT_MSG_EQ (channelMask, 0x05, "Channel mask not applied");
+
+  Ptr<UniformRandomVariable> rv = CreateObject<UniformRandomVariable> ();
+  rv->SetAttribute ("Min", DoubleValue (0));
+  rv->SetAttribute ("Max", DoubleValue (LoRaWAN::m_supportedChannels.size () - 2));
+  std::vector<uint32_t> nUplinks (LoRaWAN::m_supportedChannels.size (), 0);
+  for (uint32_t i = 0; i < 1000; i++)
+    nUplinks[LoRaWAN::SelectUplinkChannel (rv, channelMask)]++;
+  NS_TEST_ASSERT_MSG_EQ (nUplinks[0] + nUplinks[2], 1000, "Uplink on a disabled channel");
+  NS_TEST_ASSERT_MSG_GT (nUplinks[0], 400, "Channel 0 not used");
+  NS_TEST_ASSERT_MSG_GT (nUplinks[2], 400, "Channel 2 not used");
+
+  // no channel, the high power RW2 channel and unsupported ChMaskCntl are rejected
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::ApplyLinkADRChannelMask (channelMask, 0, 0), false, "Empty channel mask accepted");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::ApplyLinkADRChannelMask (channelMask, 1 << LoRaWAN::m_RW2ChannelIndex, 0), false, "RW2 channel accepted");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::ApplyLinkADRChannelMask (channelMask, 0x01, 5), false, "ChMaskCntl 5 accepted");
+  NS_TEST_ASSERT_MSG_EQ (channelMask, 0x05, "Rejected channel mask was applied");
+
+  // ChMaskCntl 6 enables all uplink channels
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::ApplyLinkADRChannelMask (channelMask, 0, 6), true, "ChMaskCntl 6 rejected");
+  NS_TEST_ASSERT_MSG_EQ (channelMask, defaultMask, "Not all channels enabled");
+}
+
+/**
+ * The network server sets NbTrans from the transmissions that it received
+ * and masks congested channels
+ */
+class LoRaWANLinkAdrNetworkServerTestCase : public TestCase
+{
+public:
+  LoRaWANLinkAdrNetworkServerTestCase ();
+  virtual ~LoRaWANLinkAdrNetworkServerTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANLinkAdrNetworkServerTestCase::LoRaWANLinkAdrNetworkServerTestCase ()
+  : TestCase ("Test the NbTrans and channel mask selected by the network server")
+{
+}
+
+LoRaWANLinkAdrNetworkServerTestCase::~LoRaWANLinkAdrNetworkServerTestCase ()
+{
+}
+
+static void
+FillHistory (LoRaWANEndDeviceInfoNS& info, uint32_t nFrames, uint32_t lostEvery, uint8_t nTransmissions)
+{
+  info.m_frameSNRHistory.clear ();
+  for (uint16_t f = 1; info.m_frameSNRHistory.size () < nFrames; f++)
+    {
+      if (lostEvery && f % lostEvery == 0)
+        continue;
+      LoRaWANAdrSnrRow row = {f, 5.0, 1, info.m_nbTrans, nTransmissions};
+      info.m_frameSNRHistory.insert (info.m_frameSNRHistory.begin (), row);
+    }
+}
+
+void
+LoRaWANLinkAdrNetworkServerTestCase::DoRun (void)
+{
+  Ptr<LoRaWANNetworkServer> ns = CreateObject<LoRaWANNetworkServer> ();
+  LoRaWANEndDeviceInfoNS info;
+
+  // every other frame lost: a transmission is lost half of the time, so the
+  // most repetitions are needed to get close to the target frame loss
+  FillHistory (info, 20, 2, 1);
+  NS_TEST_ASSERT_MSG_EQ_TOL (LoRaWANNetworkServer::GetFrameLossRate (info.m_frameSNRHistory), 19.0 / 39.0, 1e-9, "Wrong frame loss");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)ns->ComputeNbTrans (info), 1, "Uplinks repeated by default");
+  ns->SetAttribute ("AdrMaxNbTrans", UintegerValue (3));
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)ns->ComputeNbTrans (info), 3, "Lossy link should use the maximum NbTrans");
+
+  // one frame in five lost: 0.2^2 = 4% frame loss
+  FillHistory (info, 20, 5, 1);
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)ns->ComputeNbTrans (info), 2, "Wrong NbTrans for 20% transmission loss");
+
+  // all transmissions received, NbTrans is lowered one step at a time
+  info.m_nbTrans = 3;
+  FillHistory (info, 20, 0, 3);
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)ns->ComputeNbTrans (info), 2, "NbTrans should be lowered by one step");
+
+  // with NbTrans 3 and one in three transmissions lost, all frames get
+  // through but fewer transmissions would not meet the target frame loss
+  FillHistory (info, 20, 0, 2);
+  NS_TEST_ASSERT_MSG_EQ_TOL (LoRaWANNetworkServer::GetFrameLossRate (info.m_frameSNRHistory), 0.0, 1e-9, "Wrong frame loss");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)ns->ComputeNbTrans (info), 3, "NbTrans lowered while its transmissions are lost");
+
+  ns->SetAttribute ("AdrMaxNbTrans", UintegerValue (1));
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)ns->ComputeNbTrans (info), 1, "NbTrans above AdrMaxNbTrans");
+
+  // channel masks
+  const uint16_t defaultMask = LoRaWAN::GetDefaultUplinkChannelMask ();
+  for (uint8_t i = 0; i < LoRaWAN::m_supportedChannels.size () - 1; i++)
+    ns->AddChannelLoad (i, Seconds (1));
+  ns->AddChannelLoad (1, Seconds (2));
+  NS_TEST_ASSERT_MSG_EQ (ns->ComputeChannelMask (info), defaultMask, "Channels masked by default");
+  ns->SetAttribute ("AdrChannelMask", BooleanValue (true));
+  ns->SetAttribute ("AdrChannelMinLoad", DoubleValue (0.0));
+
+  // only the share of the end devices that brings the load of channel 1 down to the congestion limit is moved off it
+  double meanLoad = 0.0;
+  for (uint8_t i = 0; i < LoRaWAN::m_nUplinkChannels; i++)
+    meanLoad += ns->GetChannelLoad (i);
+  meanLoad /= LoRaWAN::m_nUplinkChannels;
+  const double load = ns->GetChannelLoad (1);
+  const double expectedShare = (load - 1.5 * meanLoad) / load;
+  const uint16_t expectedMask = defaultMask & ~(1 << 1);
+  const uint32_t nDevices = 2000;
+  uint32_t nMasked = 0;
+  LoRaWANEndDeviceInfoNS maskedInfo;
+  for (uint32_t d = 1; d <= nDevices; d++)
+    {
+      info.m_deviceAddress = Ipv4Address (d);
+      const uint16_t mask = ns->ComputeChannelMask (info);
+      NS_TEST_ASSERT_MSG_EQ ((mask == defaultMask || mask == expectedMask), true, "Channel other than 1 masked for device " << d);
+      NS_TEST_ASSERT_MSG_EQ (ns->ComputeChannelMask (info), mask, "Mask of device " << d << " changes between calls");
+      if (mask == expectedMask)
+        {
+          nMasked++;
+          maskedInfo.m_deviceAddress = info.m_deviceAddress;
+        }
+    }
+  NS_TEST_ASSERT_MSG_EQ_TOL (double (nMasked) / nDevices, expectedShare, 0.03, "Wrong share of devices moved off congested channel 1");
+
+  // a device stays off channel 1 while it is above the mean load, also when it would not have been moved off it
+  info.m_deviceAddress = Ipv4Address (1);
+  info.m_channelMask = expectedMask;
+  NS_TEST_ASSERT_MSG_EQ (ns->ComputeChannelMask (info), expectedMask, "Device moved back to a channel above the mean load");
+  maskedInfo.m_channelMask = expectedMask;
+  ns->SetAttribute ("AdrChannelMinLoad", DoubleValue (0.01));
+  NS_TEST_ASSERT_MSG_EQ (ns->ComputeChannelMask (maskedInfo), defaultMask, "Channel masked below AdrChannelMinLoad");
+  info.m_channelMask = defaultMask;
+  NS_TEST_ASSERT_MSG_EQ (ns->ComputeChannelMask (info), defaultMask, "Channel masked below AdrChannelMinLoad");
+  ns->SetAttribute ("AdrChannelMinLoad", DoubleValue (0.0));
+
+  // and moves back once channel 1 is down to the mean load
+  for (uint8_t i = 0; i < LoRaWAN::m_supportedChannels.size () - 1; i++)
+    if (i != 1)
+      ns->AddChannelLoad (i, Seconds (2));
+  NS_TEST_ASSERT_MSG_EQ (ns->ComputeChannelMask (maskedInfo), defaultMask, "Device not moved back to a channel at the mean load");
+
+  ns->SetAttribute ("AdrChannelMask", BooleanValue (false));
+  NS_TEST_ASSERT_MSG_EQ (ns->ComputeChannelMask (info), defaultMask, "Channels masked while AdrChannelMask is false");
+
+  ns->Dispose ();
+  Simulator::Destroy ();
+}
+
+// ==============================================================================
+class LoRaWANLinkAdrTestSuite : public TestSuite
+{
+public:
+  LoRaWANLinkAdrTestSuite ();
+};
+
+LoRaWANLinkAdrTestSuite::LoRaWANLinkAdrTestSuite ()
+  : TestSuite ("lorawan-link-adr", UNIT)
+{
+  AddTestCase (new LoRaWANLinkAdrChannelMaskTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANLinkAdrNetworkServerTestCase, TestCase::QUICK);
+}
+
+static LoRaWANLinkAdrTestSuite lorawanLinkAdrTestSuite;
@@ -0,0 +1,196 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+#include <ns3/test.h>
+#include <ns3/log.h>
+#include <ns3/core-module.h>
+#include <ns3/mobility-module.h>
+#include <ns3/propagation-loss-model.h>
+#include <ns3/lorawan-module.h>
+
+#include <cmath>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-link-evaluator-test");
+
+class LoRaWANLinkEvaluatorTestCase : public TestCase
+{
+public:
+  LoRaWANLinkEvaluatorTestCase ();
+  virtual ~LoRaWANLinkEvaluatorTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANLinkEvaluatorTestCase::LoRaWANLinkEvaluatorTestCase ()
+  : TestCase ("Test the batch link evaluation against the error model and the loss model")
+{
+}
+
+LoRaWANLinkEvaluatorTestCase::~LoRaWANLinkEvaluatorTestCase ()
+{
+}
+
+void
+LoRaWANLinkEvaluatorTestCase::DoRun (void)
+{
+  Ptr<LoRaWANLinkEvaluator> evaluator = CreateObject<LoRaWANLinkEvaluator> ();
+  Ptr<LogDistancePropagationLossModel> lossModel = CreateObject<LogDistancePropagationLossModel> ();
+  evaluator->SetPropagationLossModel (lossModel);
+
+  LoRaWANLinkBatch batch;
+  for (uint8_t dr = 0; dr <= 5; dr++)
+    for (double distance = 500.0; distance <= 8000.0; distance += 250.0)
+      {
+        batch.Add (distance, dr, 1, 25, 14.0);
+        batch.Add (distance, dr, 3, 51, 8.0);
+      }
+  evaluator->Evaluate (batch);
+
+  Ptr<LoRaWANErrorModel> errorModel = CreateObject<LoRaWANErrorModel> ();
+  Ptr<ConstantPositionMobilityModel> a = CreateObject<ConstantPositionMobilityModel> ();
+  Ptr<ConstantPositionMobilityModel> b = CreateObject<ConstantPositionMobilityModel> ();
+  uint32_t nPartial = 0;
+  for (uint32_t i = 0; i < batch.GetN (); i++)
+    {
+      b->SetPosition (Vector (batch.m_distance[i], 0.0, 0.0));
+      const double rxPower = lossModel->CalcRxPower (batch.m_txPower[i], a, b);
+      NS_TEST_ASSERT_MSG_EQ_TOL (batch.m_rxPower[i], rxPower, 1e-9, "Wrong received power for link " << i);
+      NS_TEST_ASSERT_MSG_EQ_TOL (batch.m_snr[i], rxPower - evaluator->GetNoisePower (), 1e-9, "Wrong SNR for link " << i);
+
+      const LoRaSpreadingFactor sf = LoRaWAN::m_supportedDataRates [batch.m_dataRateIndex[i]].spreadingFactor;
+      double psr = 0.0;
+      if (batch.m_snr[i] > errorModel->getSNRCutoffForRX (125000, sf, batch.m_codeRate[i]))
+        {
+          const uint32_t nbits = LoRaWANLinkEvaluator::GetNBits (batch.m_dataRateIndex[i], batch.m_codeRate[i], batch.m_phyPayloadSize[i]);
+          psr = errorModel->GetChunkSuccessRate (batch.m_snr[i], nbits, 125000, sf, batch.m_codeRate[i]);
+        }
+      NS_TEST_ASSERT_MSG_EQ_TOL (batch.m_successProbability[i], psr, 1e-12, "Wrong success probability for link " << i);
+      if (psr > 0.01 && psr < 0.99)
+        nPartial++;
+    }
+  NS_TEST_ASSERT_MSG_GT (nPartial, 10, "Distances do not cover the transition region of the PSR curves");
+
+  // 2000 m, SF7, CR 4/7, 20B MAC payload, 14 dBm: lorawan-error-model-test
+  // receives 954 out of 1000 packets through the event loop
+  LoRaWANLinkBatch reference;
+  reference.Add (2000.0, 5, 3, 20 + 5, 14.0);
+  evaluator->Evaluate (reference);
+  const double expected = 1000 * reference.m_successProbability[0];
+  const double sigma = std::sqrt (expected * (1.0 - reference.m_successProbability[0]));
+  NS_TEST_ASSERT_MSG_EQ_TOL (expected, 954, 3 * sigma, "Success probability does not match the event driven path");
+}
+
+// ==============================================================================
+class LoRaWANLinkEvaluatorSimulateTestCase : public TestCase
+{
+public:
+  LoRaWANLinkEvaluatorSimulateTestCase ();
+  virtual ~LoRaWANLinkEvaluatorSimulateTestCase ();
+
+private:
+  virtual void DoRun (void);
+  std::vector<uint32_t> Simulate (const LoRaWANLinkBatch& links, uint32_t nThreads);
+};
+
+LoRaWANLinkEvaluatorSimulateTestCase::LoRaWANLinkEvaluatorSimulateTestCase ()
+  : TestCase ("Test that the Monte Carlo draws do not depend on the number of threads")
+{
+}
+
+LoRaWANLinkEvaluatorSimulateTestCase::~LoRaWANLinkEvaluatorSimulateTestCase ()
+{
+}
+
+std::vector<uint32_t>
+LoRaWANLinkEvaluatorSimulateTestCase::Simulate (const LoRaWANLinkBatch& links, uint32_t nThreads)
+{
+  Ptr<LoRaWANLinkEvaluator> evaluator = CreateObject<LoRaWANLinkEvaluator> ();
+  evaluator->SetAttribute ("Threads", UintegerValue (nThreads));
+  evaluator->AssignStreams (0);
+
+  LoRaWANLinkBatch batch = links;
+  evaluator->Simulate (batch, 1000);
+  return batch.m_nReceived;
+}
+
+void
+LoRaWANLinkEvaluatorSimulateTestCase::DoRun (void)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (1);
+
+  LoRaWANLinkBatch links;
+  for (uint8_t dr = 0; dr <= 5; dr++)
+    for (double distance = 1000.0; distance <= 6000.0; distance += 100.0)
+      links.Add (distance, dr, 1, 25, 14.0);
+
+  const std::vector<uint32_t> serial = Simulate (links, 1);
+  const std::vector<uint32_t> parallel = Simulate (links, 4);
+  NS_TEST_ASSERT_MSG_EQ (serial.size (), links.GetN (), "Not every link was simulated");
+  NS_TEST_ASSERT_MSG_EQ ((serial == parallel), true, "Draws depend on the number of threads");
+
+  // The draws follow the success probability
+  Ptr<LoRaWANLinkEvaluator> evaluator = CreateObject<LoRaWANLinkEvaluator> ();
+  LoRaWANLinkBatch batch = links;
+  evaluator->Evaluate (batch);
+  double expected = 0.0;
+  uint32_t received = 0;
+  for (uint32_t i = 0; i < batch.GetN (); i++)
+    {
+      expected += 1000 * batch.m_successProbability[i];
+      received += serial[i];
+      if (batch.m_successProbability[i] == 0.0)
+        NS_TEST_ASSERT_MSG_EQ (serial[i], 0, "Packet received on a link below the SNR cutoff");
+    }
+  NS_TEST_ASSERT_MSG_EQ_TOL (received, expected, 0.01 * expected, "Draws do not follow the success probability");
+
+  // A different run gives different draws
+  RngSeedManager::SetRun (2);
+  const std::vector<uint32_t> otherRun = Simulate (links, 4);
+  NS_TEST_ASSERT_MSG_EQ ((serial == otherRun), false, "Draws do not depend on the run number");
+
+  // Also with the Philox generator, which keeps the run number in the upper half of the substream
+  RngSeedManager::SetRngType (RngStream::PHILOX);
+  RngSeedManager::SetRun (1);
+  const std::vector<uint32_t> philox = Simulate (links, 4);
+  RngSeedManager::SetRun (2);
+  const std::vector<uint32_t> otherPhiloxRun = Simulate (links, 4);
+  RngSeedManager::SetRngType (RngStream::MRG32K3A);
+  NS_TEST_ASSERT_MSG_EQ ((philox == otherPhiloxRun), false, "Philox draws do not depend on the run number");
+  RngSeedManager::SetRun (1);
+}
+
+// ==============================================================================
+class LoRaWANLinkEvaluatorTestSuite : public TestSuite
+{
+public:
+  LoRaWANLinkEvaluatorTestSuite ();
+};
+
+LoRaWANLinkEvaluatorTestSuite::LoRaWANLinkEvaluatorTestSuite ()
+  : TestSuite ("lorawan-link-evaluator", UNIT)
+{
+  AddTestCase (new LoRaWANLinkEvaluatorTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANLinkEvaluatorSimulateTestCase, TestCase::QUICK);
+}
+
+static LoRaWANLinkEvaluatorTestSuite lorawanLinkEvaluatorTestSuite;
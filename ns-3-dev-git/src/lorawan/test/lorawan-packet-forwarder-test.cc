@@ -0,0 +1,272 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+#include <ns3/test.h>
+#include <ns3/log.h>
+#include <ns3/core-module.h>
+#include <ns3/network-module.h>
+#include <ns3/lorawan-module.h>
+
+#include <cstring>
+#include <string>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-packet-forwarder-test");
+
+/**
+ * Encoding of rxpk and decoding of txpk objects
+ */
+class LoRaWANPacketForwarderCodecTestCase : public TestCase
+{
+public:
+  LoRaWANPacketForwarderCodecTestCase ();
+  virtual ~LoRaWANPacketForwarderCodecTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANPacketForwarderCodecTestCase::LoRaWANPacketForwarderCodecTestCase ()
+  : TestCase ("Encode rxpk and decode txpk of the Semtech UDP protocol")
+{
+}
+
+LoRaWANPacketForwarderCodecTestCase::~LoRaWANPacketForwarderCodecTestCase ()
+{
+}
+
+void
+LoRaWANPacketForwarderCodecTestCase::DoRun (void)
+{
+  // base64, with and without padding
+  const uint8_t bytes[] = { 'f', 'o', 'o', 'b', 'a', 'r' };
+  NS_TEST_ASSERT_MSG_EQ (LoRaWANPacketForwarder::EncodeBase64 (bytes, 6), "Zm9vYmFy", "Wrong base64 encoding");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWANPacketForwarder::EncodeBase64 (bytes, 4), "Zm9vYg==", "Wrong base64 encoding");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWANPacketForwarder::EncodeBase64 (bytes, 5), "Zm9vYmE=", "Wrong base64 encoding");
+  std::string decoded;
+  NS_TEST_ASSERT_MSG_EQ (LoRaWANPacketForwarder::DecodeBase64 ("Zm9vYg==", decoded), true, "Valid base64 rejected");
+  NS_TEST_ASSERT_MSG_EQ (decoded, "foob", "Wrong base64 decoding");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWANPacketForwarder::DecodeBase64 ("Zm9v!", decoded), false, "Invalid base64 accepted");
+
+  // rxpk of a 3 byte uplink on 868.1 MHz at DR5
+  const uint8_t payload[] = { 0x01, 0x02, 0x03 };
+  Ptr<Packet> uplink = Create<Packet> (payload, 3);
+  LoRaWANPhyParamsTag phyParamsTag;
+  phyParamsTag.SetChannelIndex (0);
+  phyParamsTag.SetDataRateIndex (5);
+  phyParamsTag.SetCodeRate (1);
+  phyParamsTag.SetTxPowerIndex (0);
+  phyParamsTag.SetSinrAvg (7.5);
+  uplink->AddPacketTag (phyParamsTag);
+  LoRaWANMsgTypeTag msgTypeTag;
+  msgTypeTag.SetMsgType (LORAWAN_CONFIRMED_DATA_UP);
+  uplink->AddPacketTag (msgTypeTag);
+
+  const std::string rxpk = LoRaWANPacketForwarder::EncodeRxpk (uplink, 1234, -90);
+  NS_TEST_ASSERT_MSG_NE (rxpk.find ("\"tmst\":1234,"), std::string::npos, "Wrong tmst in " << rxpk);
+  NS_TEST_ASSERT_MSG_NE (rxpk.find ("\"freq\":868.100000,"), std::string::npos, "Wrong freq in " << rxpk);
+  NS_TEST_ASSERT_MSG_NE (rxpk.find ("\"datr\":\"SF7BW125\""), std::string::npos, "Wrong datr in " << rxpk);
+  NS_TEST_ASSERT_MSG_NE (rxpk.find ("\"codr\":\"4/5\""), std::string::npos, "Wrong codr in " << rxpk);
+  NS_TEST_ASSERT_MSG_NE (rxpk.find ("\"rssi\":-90,"), std::string::npos, "Wrong rssi in " << rxpk);
+  NS_TEST_ASSERT_MSG_NE (rxpk.find ("\"lsnr\":7.5,"), std::string::npos, "Wrong lsnr in " << rxpk);
+  NS_TEST_ASSERT_MSG_NE (rxpk.find ("\"size\":8,"), std::string::npos, "Wrong size in " << rxpk);
+  // MHDR 0x80 (confirmed data up), payload and a zero MIC
+  const uint8_t phyPayload[] = { 0x80, 0x01, 0x02, 0x03, 0x00, 0x00, 0x00, 0x00 };
+  NS_TEST_ASSERT_MSG_NE (rxpk.find ("\"data\":\"" + LoRaWANPacketForwarder::EncodeBase64 (phyPayload, 8) + "\""),
+                         std::string::npos, "Wrong data in " << rxpk);
+
+  // txpk of a PULL_RESP: unconfirmed data down on 869.525 MHz at DR0
+  const uint8_t downlinkPayload[] = { 0x60, 0x0a, 0x0b, 0x11, 0x22, 0x33, 0x44 };
+  const std::string txpk = "{\"txpk\":{\"imme\":false,\"tmst\":5000000,\"freq\":869.525,\"rfch\":0,\"powe\":14,"
+    "\"modu\":\"LORA\",\"datr\":\"SF12BW125\",\"codr\":\"4/6\",\"ipol\":true,\"size\":7,\"data\":\""
+    + LoRaWANPacketForwarder::EncodeBase64 (downlinkPayload, 7) + "\"}}";
+  bool immediate = true;
+  uint32_t tmst = 0;
+  Ptr<Packet> downlink = LoRaWANPacketForwarder::DecodeTxpk (txpk, immediate, tmst);
+  NS_TEST_ASSERT_MSG_NE (downlink, 0, "Valid txpk rejected");
+  NS_TEST_ASSERT_MSG_EQ (immediate, false, "Wrong imme");
+  NS_TEST_ASSERT_MSG_EQ (tmst, 5000000, "Wrong tmst");
+  NS_TEST_ASSERT_MSG_EQ (downlink->GetSize (), 2, "MHDR and MIC not removed");
+
+  uint8_t macPayload[2];
+  downlink->CopyData (macPayload, 2);
+  NS_TEST_ASSERT_MSG_EQ (macPayload[0], 0x0a, "Wrong MACPayload");
+  NS_TEST_ASSERT_MSG_EQ (macPayload[1], 0x0b, "Wrong MACPayload");
+  NS_TEST_ASSERT_MSG_EQ (downlink->PeekPacketTag (phyParamsTag), true, "LoRaWANPhyParamsTag missing");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::m_supportedChannels[phyParamsTag.GetChannelIndex ()].m_fc, 869.525e6, "Wrong channel");
+  NS_TEST_ASSERT_MSG_EQ ((unsigned)phyParamsTag.GetDataRateIndex (), 0, "Wrong data rate");
+  NS_TEST_ASSERT_MSG_EQ ((unsigned)phyParamsTag.GetCodeRate (), 2, "Wrong code rate");
+  NS_TEST_ASSERT_MSG_EQ (downlink->PeekPacketTag (msgTypeTag), true, "LoRaWANMsgTypeTag missing");
+  NS_TEST_ASSERT_MSG_EQ (msgTypeTag.GetMsgType (), LORAWAN_UNCONFIRMED_DATA_DOWN, "Wrong message type");
+
+  // unknown frequency
+  const std::string invalid = "{\"txpk\":{\"imme\":true,\"freq\":915.2,\"datr\":\"SF12BW125\",\"data\":\"YAoLESIzRA==\"}}";
+  NS_TEST_ASSERT_MSG_EQ (LoRaWANPacketForwarder::DecodeTxpk (invalid, immediate, tmst), 0, "txpk on an unknown frequency accepted");
+}
+
+/**
+ * Datagrams exchanged with a network server on the loopback interface
+ */
+class LoRaWANPacketForwarderLoopbackTestCase : public TestCase
+{
+public:
+  LoRaWANPacketForwarderLoopbackTestCase ();
+  virtual ~LoRaWANPacketForwarderLoopbackTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void PushData (uint32_t size);
+  /** Receive a datagram on the server socket, with a timeout of one second */
+  std::string Receive (void);
+
+  int m_server;
+  uint32_t m_nPushData;
+  uint32_t m_nRxpk;
+};
+
+LoRaWANPacketForwarderLoopbackTestCase::LoRaWANPacketForwarderLoopbackTestCase ()
+  : TestCase ("Exchange Semtech UDP datagrams with a server on the loopback interface"),
+    m_server (-1),
+    m_nPushData (0),
+    m_nRxpk (0)
+{
+}
+
+LoRaWANPacketForwarderLoopbackTestCase::~LoRaWANPacketForwarderLoopbackTestCase ()
+{
+}
+
+void
+LoRaWANPacketForwarderLoopbackTestCase::PushData (uint32_t size)
+{
+  m_nPushData++;
+  m_nRxpk += size;
+}
+
+std::string
+LoRaWANPacketForwarderLoopbackTestCase::Receive (void)
+{
+  char buf[65536];
+  ssize_t len = recv (m_server, buf, sizeof (buf), 0);
+  return len > 0 ? std::string (buf, len) : std::string ();
+}
+
+void
+LoRaWANPacketForwarderLoopbackTestCase::DoRun (void)
+{
+  m_server = socket (AF_INET, SOCK_DGRAM, 0);
+  NS_TEST_ASSERT_MSG_GT (m_server, -1, "Unable to create server socket");
+  struct sockaddr_in address;
+  std::memset (&address, 0, sizeof (address));
+  address.sin_family = AF_INET;
+  address.sin_port = 0;
+  address.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+  NS_TEST_ASSERT_MSG_EQ (bind (m_server, (struct sockaddr*)&address, sizeof (address)), 0, "Unable to bind server socket");
+  socklen_t addressLen = sizeof (address);
+  getsockname (m_server, (struct sockaddr*)&address, &addressLen);
+  struct timeval timeout = { 1, 0 };
+  setsockopt (m_server, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof (timeout));
+
+  // the gateway application is not started, as only its uplink callback is used
+  Ptr<Node> node = CreateObject<Node> ();
+  Ptr<LoRaWANGatewayApplication> gateway = CreateObject<LoRaWANGatewayApplication> ();
+  gateway->SetNode (node);
+
+  Ptr<LoRaWANPacketForwarder> forwarder = CreateObject<LoRaWANPacketForwarder> ();
+  forwarder->SetAttribute ("ServerPort", UintegerValue (ntohs (address.sin_port)));
+  forwarder->SetAttribute ("GatewayEui", UintegerValue (0x0102030405060708ULL));
+  forwarder->SetAttribute ("MaxBatchSize", UintegerValue (2));
+  forwarder->TraceConnectWithoutContext ("PushData", MakeCallback (&LoRaWANPacketForwarderLoopbackTestCase::PushData, this));
+  NS_TEST_ASSERT_MSG_EQ (forwarder->Install (gateway), true, "Unable to install packet forwarder");
+
+  // three uplinks: a full batch of two and a batch of one sent after BatchInterval
+  for (uint32_t i = 0; i < 3; i++)
+    {
+      Ptr<Packet> uplink = Create<Packet> (10 + i);
+      LoRaWANPhyParamsTag phyParamsTag;
+      phyParamsTag.SetChannelIndex (i);
+      phyParamsTag.SetDataRateIndex (5);
+      phyParamsTag.SetCodeRate (1);
+      phyParamsTag.SetTxPowerIndex (0);
+      phyParamsTag.SetSinrAvg (0);
+      uplink->AddPacketTag (phyParamsTag);
+      Simulator::Schedule (Seconds (1), &LoRaWANPacketForwarder::ForwardUplink, forwarder, uplink);
+    }
+
+  // a PULL_RESP with a tmst in the past is answered with TOO_LATE
+  std::string pullResp ("\x02\xab\xcd\x03", 4);
+  pullResp += "{\"txpk\":{\"imme\":false,\"tmst\":1000,\"freq\":868.1,\"datr\":\"SF7BW125\",\"codr\":\"4/5\",\"data\":\"YAoLESIzRA==\"}}";
+  Simulator::Schedule (Seconds (2), &LoRaWANPacketForwarder::HandleDatagram, forwarder, pullResp);
+
+  Simulator::Stop (Seconds (3));
+  Simulator::Run ();
+
+  // PULL_DATA at start
+  std::string datagram = Receive ();
+  NS_TEST_ASSERT_MSG_EQ (datagram.size (), 12, "Wrong PULL_DATA size");
+  NS_TEST_ASSERT_MSG_EQ ((unsigned)(uint8_t)datagram[0], LORAWAN_SEMTECH_UDP_VERSION, "Wrong protocol version");
+  NS_TEST_ASSERT_MSG_EQ ((unsigned)(uint8_t)datagram[3], LoRaWANPacketForwarder::PULL_DATA, "Expected PULL_DATA");
+  NS_TEST_ASSERT_MSG_EQ (datagram.substr (4, 8), std::string ("\x01\x02\x03\x04\x05\x06\x07\x08", 8), "Wrong gateway EUI");
+
+  // the two PUSH_DATA
+  datagram = Receive ();
+  NS_TEST_ASSERT_MSG_EQ ((unsigned)(uint8_t)datagram[3], LoRaWANPacketForwarder::PUSH_DATA, "Expected PUSH_DATA");
+  NS_TEST_ASSERT_MSG_EQ (datagram.compare (12, 9, "{\"rxpk\":["), 0, "Wrong PUSH_DATA JSON " << datagram.substr (12));
+  NS_TEST_ASSERT_MSG_NE (datagram.find ("\"freq\":868.100000"), std::string::npos, "First rxpk missing");
+  NS_TEST_ASSERT_MSG_NE (datagram.find ("\"freq\":868.300000"), std::string::npos, "Second rxpk missing");
+  datagram = Receive ();
+  NS_TEST_ASSERT_MSG_EQ ((unsigned)(uint8_t)datagram[3], LoRaWANPacketForwarder::PUSH_DATA, "Expected PUSH_DATA");
+  NS_TEST_ASSERT_MSG_NE (datagram.find ("\"freq\":868.500000"), std::string::npos, "Third rxpk missing");
+  NS_TEST_ASSERT_MSG_EQ (m_nPushData, 2, "Wrong number of PUSH_DATA");
+  NS_TEST_ASSERT_MSG_EQ (m_nRxpk, 3, "Wrong number of rxpk");
+
+  // TX_ACK with the token of the PULL_RESP
+  datagram = Receive ();
+  NS_TEST_ASSERT_MSG_EQ ((unsigned)(uint8_t)datagram[3], LoRaWANPacketForwarder::TX_ACK, "Expected TX_ACK");
+  NS_TEST_ASSERT_MSG_EQ (datagram.substr (1, 2), std::string ("\xab\xcd", 2), "Wrong TX_ACK token");
+  NS_TEST_ASSERT_MSG_NE (datagram.find ("TOO_LATE"), std::string::npos, "Expected TOO_LATE error");
+
+  forwarder->Dispose ();
+  gateway->Dispose ();
+  Simulator::Destroy ();
+  close (m_server);
+}
+
+// ==============================================================================
+class LoRaWANPacketForwarderTestSuite : public TestSuite
+{
+public:
+  LoRaWANPacketForwarderTestSuite ();
+};
+
+LoRaWANPacketForwarderTestSuite::LoRaWANPacketForwarderTestSuite ()
+  : TestSuite ("lorawan-packet-forwarder", UNIT)
+{
+  AddTestCase (new LoRaWANPacketForwarderCodecTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANPacketForwarderLoopbackTestCase, TestCase::QUICK);
+}
+
+static LoRaWANPacketForwarderTestSuite lorawanPacketForwarderTestSuite;
@@ -0,0 +1,183 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+#include <ns3/test.h>
+#include <ns3/log.h>
+#include <ns3/core-module.h>
+#include <ns3/network-module.h>
+#include <ns3/mobility-module.h>
+#include <ns3/spectrum-value.h>
+#include <ns3/lorawan-module.h>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-phy-config-registry-test");
+
+/**
+ * The PHYs of end devices and gateways share their error model and PSDs,
+ * which have the values the PHYs used to compute for themselves
+ */
+class LoRaWANPhyConfigRegistryTestCase : public TestCase
+{
+public:
+  LoRaWANPhyConfigRegistryTestCase ();
+  virtual ~LoRaWANPhyConfigRegistryTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANPhyConfigRegistryTestCase::LoRaWANPhyConfigRegistryTestCase ()
+  : TestCase ("Test that PHYs share their immutable configuration")
+{
+}
+
+LoRaWANPhyConfigRegistryTestCase::~LoRaWANPhyConfigRegistryTestCase ()
+{
+}
+
+void
+LoRaWANPhyConfigRegistryTestCase::DoRun (void)
+{
+  NodeContainer endDeviceNodes;
+  NodeContainer gatewayNodes;
+  endDeviceNodes.Create (2);
+  gatewayNodes.Create (2);
+  MobilityHelper mobility;
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (endDeviceNodes);
+  mobility.Install (gatewayNodes);
+
+  LoRaWANHelper lorawanHelper;
+  NetDeviceContainer endDevices = lorawanHelper.Install (endDeviceNodes);
+  lorawanHelper.SetDeviceType (LORAWAN_DT_GATEWAY);
+  NetDeviceContainer gateways = lorawanHelper.Install (gatewayNodes);
+
+  Ptr<LoRaWANErrorModel> errorModel = LoRaWANPhyConfigRegistry::GetErrorModel ();
+  Ptr<const SpectrumValue> noise = LoRaWANPhyConfigRegistry::GetNoisePowerSpectralDensity (1.0);
+
+  std::vector<Ptr<LoRaWANPhy> > phys;
+  for (uint32_t i = 0; i < endDevices.GetN (); i++)
+    phys.push_back (DynamicCast<LoRaWANNetDevice> (endDevices.Get (i))->GetPhy ());
+  std::vector<Ptr<LoRaWANPhy> > gateway0 = DynamicCast<LoRaWANNetDevice> (gateways.Get (0))->GetPhys ();
+  std::vector<Ptr<LoRaWANPhy> > gateway1 = DynamicCast<LoRaWANNetDevice> (gateways.Get (1))->GetPhys ();
+  NS_TEST_ASSERT_MSG_EQ (gateway0.size (), gateway1.size (), "Gateways should have the same PHYs");
+  phys.insert (phys.end (), gateway0.begin (), gateway0.end ());
+  phys.insert (phys.end (), gateway1.begin (), gateway1.end ());
+
+  LoRaWANSpectrumValueHelper psdHelper;
+  for (auto phy : phys)
+    {
+      NS_TEST_ASSERT_MSG_EQ (phy->GetErrorModel (), errorModel, "PHY does not use the shared error model");
+      NS_TEST_ASSERT_MSG_EQ (phy->GetNoisePowerSpectralDensity (), noise, "PHY does not use the shared noise PSD");
+    }
+
+  // the PHYs of both gateways listen on the same channels with the same tx power
+  for (uint32_t i = 0; i < gateway0.size (); i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (gateway0[i]->GetTxPowerSpectralDensity (), gateway1[i]->GetTxPowerSpectralDensity (),
+                             "Gateway PHYs " << i << " do not share their TX PSD");
+      uint8_t channelIndex = i / LoRaWAN::m_supportedDataRates.size ();
+      Ptr<SpectrumValue> expected = psdHelper.CreateTxPowerSpectralDensity (2, LoRaWAN::m_supportedChannels [channelIndex].m_fc);
+      Ptr<const SpectrumValue> psd = gateway0[i]->GetTxPowerSpectralDensity ();
+      for (uint32_t band = 0; band < LoRaWAN::m_supportedChannels.size (); band++)
+        NS_TEST_ASSERT_MSG_EQ ((*psd)[band], (*expected)[band], "Wrong TX PSD for gateway PHY " << i);
+    }
+  NS_TEST_ASSERT_MSG_EQ (LoRaWANPhyConfigRegistry::GetNPowerSpectralDensities (), LoRaWAN::m_supportedChannels.size () + 1,
+                         "One TX PSD per channel and one noise PSD expected");
+
+  // a different noise factor gives a different PSD, shared by the PHYs with that factor
+  phys[0]->UpdateNoiseFactorAndNoisePowerSpectralDensity (1.78);
+  phys[1]->UpdateNoiseFactorAndNoisePowerSpectralDensity (1.78);
+  NS_TEST_ASSERT_MSG_NE (phys[0]->GetNoisePowerSpectralDensity (), noise, "Noise PSD not updated");
+  NS_TEST_ASSERT_MSG_EQ (phys[0]->GetNoisePowerSpectralDensity (), phys[1]->GetNoisePowerSpectralDensity (), "Noise PSD not shared");
+  NS_TEST_ASSERT_MSG_EQ (phys[2]->GetNoisePowerSpectralDensity (), noise, "Noise PSD of other PHYs changed");
+  psdHelper.UpdateNoiseFactor (1.78);
+  Ptr<SpectrumValue> expectedNoise = psdHelper.CreateNoisePowerSpectralDensity (LoRaWAN::m_supportedChannels [0].m_fc);
+  for (uint32_t band = 0; band < LoRaWAN::m_supportedChannels.size (); band++)
+    NS_TEST_ASSERT_MSG_EQ ((*phys[0]->GetNoisePowerSpectralDensity ())[band], (*expectedNoise)[band], "Wrong noise PSD");
+
+  Simulator::Destroy ();
+
+  // the registry is emptied with the simulator
+  NS_TEST_ASSERT_MSG_NE (LoRaWANPhyConfigRegistry::GetErrorModel (), errorModel, "Registry not cleared");
+  Simulator::Destroy ();
+}
+
+// ==============================================================================
+/**
+ * Clearing the registry while its destroy event is pending (e.g. when the
+ * region changes) empties it without scheduling another destroy event, so
+ * that Simulator::Destroy terminates
+ */
+class LoRaWANPhyConfigRegistryClearTestCase : public TestCase
+{
+public:
+  LoRaWANPhyConfigRegistryClearTestCase ();
+  virtual ~LoRaWANPhyConfigRegistryClearTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANPhyConfigRegistryClearTestCase::LoRaWANPhyConfigRegistryClearTestCase ()
+  : TestCase ("Test clearing the registry before the simulator is destroyed")
+{
+}
+
+LoRaWANPhyConfigRegistryClearTestCase::~LoRaWANPhyConfigRegistryClearTestCase ()
+{
+}
+
+void
+LoRaWANPhyConfigRegistryClearTestCase::DoRun (void)
+{
+  Ptr<LoRaWANErrorModel> errorModel = LoRaWANPhyConfigRegistry::GetErrorModel ();
+  LoRaWANPhyConfigRegistry::GetNoisePowerSpectralDensity (1.0);
+  NS_TEST_ASSERT_MSG_EQ (LoRaWANPhyConfigRegistry::GetNPowerSpectralDensities (), 1, "Noise PSD not registered");
+
+  LoRaWANPhyConfigRegistry::Clear ();
+  NS_TEST_ASSERT_MSG_EQ (LoRaWANPhyConfigRegistry::GetNPowerSpectralDensities (), 0, "PSDs not cleared");
+  Ptr<LoRaWANErrorModel> otherErrorModel = LoRaWANPhyConfigRegistry::GetErrorModel ();
+  NS_TEST_ASSERT_MSG_NE (otherErrorModel, errorModel, "Error model not cleared");
+  LoRaWANPhyConfigRegistry::GetNoisePowerSpectralDensity (1.0);
+
+  // returns, and empties the registry once
+  Simulator::Destroy ();
+
+  NS_TEST_ASSERT_MSG_NE (LoRaWANPhyConfigRegistry::GetErrorModel (), otherErrorModel, "Registry not cleared on destroy");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWANPhyConfigRegistry::GetNPowerSpectralDensities (), 0, "PSDs not cleared on destroy");
+  Simulator::Destroy ();
+}
+
+// ==============================================================================
+class LoRaWANPhyConfigRegistryTestSuite : public TestSuite
+{
+public:
+  LoRaWANPhyConfigRegistryTestSuite ();
+};
+
+LoRaWANPhyConfigRegistryTestSuite::LoRaWANPhyConfigRegistryTestSuite ()
+  : TestSuite ("lorawan-phy-config-registry", UNIT)
+{
+  AddTestCase (new LoRaWANPhyConfigRegistryTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANPhyConfigRegistryClearTestCase, TestCase::QUICK);
+}
+
+static LoRaWANPhyConfigRegistryTestSuite lorawanPhyConfigRegistryTestSuite;
@@ -0,0 +1,232 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+#include <ns3/test.h>
+#include <ns3/log.h>
+#include <ns3/core-module.h>
+#include <ns3/network-module.h>
+#include <ns3/mobility-module.h>
+#include <ns3/lorawan-module.h>
+#include "ns3/rng-seed-manager.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-queue-pool-test");
+
+struct LoRaWANQueuePoolTestElement
+{
+  uint32_t m_value;
+  Ptr<Packet> m_packet;
+  LoRaWANQueuePoolTestElement* m_next;
+};
+
+typedef LoRaWANQueueElementPool<LoRaWANQueuePoolTestElement> LoRaWANQueuePoolTestPool;
+typedef LoRaWANIntrusiveQueue<LoRaWANQueuePoolTestElement> LoRaWANQueuePoolTestQueue;
+
+/**
+ * FIFO order, slot reuse and leak accounting of the pooled intrusive queue
+ */
+class LoRaWANQueuePoolTestCase : public TestCase
+{
+public:
+  LoRaWANQueuePoolTestCase ();
+  virtual ~LoRaWANQueuePoolTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANQueuePoolTestCase::LoRaWANQueuePoolTestCase ()
+  : TestCase ("Test the pooled intrusive queue")
+{
+}
+
+LoRaWANQueuePoolTestCase::~LoRaWANQueuePoolTestCase ()
+{
+}
+
+void
+LoRaWANQueuePoolTestCase::DoRun (void)
+{
+  const uint32_t n = LoRaWANQueuePoolTestPool::SLAB_SIZE + 10;
+  {
+    LoRaWANQueuePoolTestQueue queue;
+    for (uint32_t i = 0; i < n; i++)
+      {
+        LoRaWANQueuePoolTestElement* element = queue.Emplace ();
+        NS_TEST_ASSERT_MSG_EQ ((element->m_packet == 0), true, "Element not value-initialized");
+        element->m_value = i;
+        element->m_packet = Create<Packet> (10);
+      }
+    NS_TEST_ASSERT_MSG_EQ (queue.GetSize (), n, "Wrong queue size");
+    NS_TEST_ASSERT_MSG_EQ (LoRaWANQueuePoolTestPool::GetNInUse (), n, "Wrong number of elements in use");
+    NS_TEST_ASSERT_MSG_EQ (LoRaWANQueuePoolTestPool::GetCapacity (), 2 * LoRaWANQueuePoolTestPool::SLAB_SIZE, "Pool did not grow by slabs");
+
+    for (uint32_t i = 0; i < 10; i++)
+      {
+        NS_TEST_ASSERT_MSG_EQ (queue.Front ()->m_value, i, "Queue is not FIFO");
+        queue.PopFront ();
+      }
+
+    // a freed slot is handed out again, without growing the pool
+    LoRaWANQueuePoolTestElement* front = queue.Front ();
+    queue.PopFront ();
+    NS_TEST_ASSERT_MSG_EQ (queue.Emplace (), front, "Freed slot not reused");
+    for (uint32_t k = 0; k < 10 * n; k++)
+      {
+        queue.PopFront ();
+        queue.Emplace ()->m_value = k;
+      }
+    NS_TEST_ASSERT_MSG_EQ (LoRaWANQueuePoolTestPool::GetCapacity (), 2 * LoRaWANQueuePoolTestPool::SLAB_SIZE, "Steady state queueing allocated");
+
+    // moving hands over the elements
+    LoRaWANQueuePoolTestQueue moved (std::move (queue));
+    NS_TEST_ASSERT_MSG_EQ (queue.IsEmpty (), true, "Moved-from queue is not empty");
+    NS_TEST_ASSERT_MSG_EQ (moved.GetSize (), n - 10, "Elements lost in move");
+    NS_TEST_ASSERT_MSG_EQ (LoRaWANQueuePoolTestPool::GetNInUse (), n - 10, "Wrong number of elements in use");
+
+    LoRaWANQueuePoolTestQueue copy (queue);
+    NS_TEST_ASSERT_MSG_EQ (copy.IsEmpty (), true, "Copy of an empty queue is not empty");
+  }
+  // destroying the queues returns their elements
+  NS_TEST_ASSERT_MSG_EQ (LoRaWANQueuePoolTestPool::GetNInUse (), 0, "Queue elements leaked");
+}
+
+static void
+RecordDSSent (uint32_t* sent, uint32_t oldValue, uint32_t newValue)
+{
+  *sent = newValue;
+}
+
+/**
+ * Downlinks generated by the network server go through the DS queues and the
+ * tx queues of the gateway and end device MACs: once the pools are warmed up,
+ * they should not grow, and every element should be returned when the
+ * simulation is destroyed.
+ */
+class LoRaWANQueuePoolNetworkTestCase : public TestCase
+{
+public:
+  LoRaWANQueuePoolNetworkTestCase ();
+  virtual ~LoRaWANQueuePoolNetworkTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void RecordCapacity (void);
+
+  uint32_t m_dsCapacity;
+  uint32_t m_txCapacity;
+};
+
+LoRaWANQueuePoolNetworkTestCase::LoRaWANQueuePoolNetworkTestCase ()
+  : TestCase ("Test that steady state queueing in a network does not allocate queue elements"),
+    m_dsCapacity (0),
+    m_txCapacity (0)
+{
+}
+
+LoRaWANQueuePoolNetworkTestCase::~LoRaWANQueuePoolNetworkTestCase ()
+{
+}
+
+void
+LoRaWANQueuePoolNetworkTestCase::RecordCapacity (void)
+{
+  m_dsCapacity = LoRaWANQueueElementPool<LoRaWANNSDSQueueElement>::GetCapacity ();
+  m_txCapacity = LoRaWANMac::GetTxQueuePoolCapacity ();
+}
+
+void
+LoRaWANQueuePoolNetworkTestCase::DoRun (void)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (1);
+
+  const uint32_t txInUse = LoRaWANMac::GetTxQueuePoolNInUse ();
+
+  Ptr<LoRaWANNetworkServer> ns = LoRaWANNetworkServer::getLoRaWANNetworkServerPointer ();
+  ns->SetAttribute ("GenerateDataDown", BooleanValue (true));
+  ns->SetAttribute ("DownstreamIAT", StringValue ("ns3::ExponentialRandomVariable[Mean=400]"));
+  ns = 0;
+
+  NodeContainer endDeviceNodes;
+  NodeContainer gatewayNodes;
+  endDeviceNodes.Create (20);
+  gatewayNodes.Create (1);
+
+  MobilityHelper mobility;
+  mobility.SetPositionAllocator ("ns3::UniformDiscPositionAllocator",
+                                 "X", DoubleValue (0.0),
+                                 "Y", DoubleValue (0.0),
+                                 "rho", DoubleValue (500.0));
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (endDeviceNodes);
+  mobility.Install (gatewayNodes);
+
+  LoRaWANHelper lorawanHelper;
+  lorawanHelper.Install (endDeviceNodes);
+  lorawanHelper.SetDeviceType (LORAWAN_DT_GATEWAY);
+  lorawanHelper.Install (gatewayNodes);
+
+  PacketSocketHelper packetSocket;
+  packetSocket.Install (endDeviceNodes);
+  packetSocket.Install (gatewayNodes);
+
+  LoRaWANEndDeviceHelper enddevicehelper;
+  enddevicehelper.SetAttribute ("UpstreamIAT", StringValue ("ns3::ConstantRandomVariable[Constant=100]"));
+  enddevicehelper.SetAttribute ("UpstreamSend", StringValue ("ns3::UniformRandomVariable[Min=0.0|Max=100]"));
+  enddevicehelper.Install (endDeviceNodes);
+  LoRaWANGatewayHelper gatewayhelper;
+  gatewayhelper.Install (gatewayNodes);
+
+  uint32_t dsSent = 0;
+  LoRaWANNetworkServer::getLoRaWANNetworkServerPointer ()->TraceConnectWithoutContext ("nrRW1Sent", MakeBoundCallback (&RecordDSSent, &dsSent));
+
+  Simulator::Schedule (Seconds (1000), &LoRaWANQueuePoolNetworkTestCase::RecordCapacity, this);
+  Simulator::Stop (Seconds (3000));
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_GT (dsSent, 0, "No downlinks were sent");
+  NS_TEST_ASSERT_MSG_GT (m_dsCapacity, 0, "DS queue pool not used");
+  NS_TEST_ASSERT_MSG_GT (m_txCapacity, 0, "Tx queue pool not used");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWANQueueElementPool<LoRaWANNSDSQueueElement>::GetCapacity (), m_dsCapacity, "DS queue pool grew in steady state");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWANMac::GetTxQueuePoolCapacity (), m_txCapacity, "Tx queue pool grew in steady state");
+
+  LoRaWANNetworkServer::clearLoRaWANNetworkServerPointer ();
+  Simulator::Destroy ();
+
+  NS_TEST_ASSERT_MSG_EQ (LoRaWANQueueElementPool<LoRaWANNSDSQueueElement>::GetNInUse (), 0, "DS queue elements leaked");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWANMac::GetTxQueuePoolNInUse (), txInUse, "Tx queue elements leaked");
+}
+
+// ==============================================================================
+class LoRaWANQueuePoolTestSuite : public TestSuite
+{
+public:
+  LoRaWANQueuePoolTestSuite ();
+};
+
+LoRaWANQueuePoolTestSuite::LoRaWANQueuePoolTestSuite ()
+  : TestSuite ("lorawan-queue-pool", UNIT)
+{
+  AddTestCase (new LoRaWANQueuePoolTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANQueuePoolNetworkTestCase, TestCase::QUICK);
+}
+
+static LoRaWANQueuePoolTestSuite lorawanQueuePoolTestSuite;
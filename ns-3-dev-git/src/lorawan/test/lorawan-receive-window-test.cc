@@ -0,0 +1,333 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+#include <ns3/test.h>
+#include <ns3/log.h>
+#include <ns3/core-module.h>
+#include <ns3/lorawan-module.h>
+#include <ns3/default-simulator-impl.h>
+#include <ns3/propagation-loss-model.h>
+#include <ns3/propagation-delay-model.h>
+#include <ns3/constant-position-mobility-model.h>
+#include <ns3/node.h>
+
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-receive-window-test");
+
+static Ptr<LoRaWANNetDevice>
+CreateEndDevice (Ptr<LoRaWANSpectrumChannel> channel)
+{
+  Ptr<Node> n0 = CreateObject <Node> ();
+  Ptr<LoRaWANNetDevice> dev0 = CreateObject<LoRaWANNetDevice> (LORAWAN_DT_END_DEVICE_CLASS_A);
+  dev0->SetAddress (Ipv4Address (0x00000001));
+  dev0->SetChannel (channel);
+  n0->AddDevice (dev0);
+
+  Ptr<ConstantPositionMobilityModel> mobility0 = CreateObject<ConstantPositionMobilityModel> ();
+  mobility0->SetPosition (Vector (0, 100, 0));
+  dev0->GetPhy ()->SetMobility (mobility0);
+  return dev0;
+}
+
+static Ptr<LoRaWANSpectrumChannel>
+CreateChannel (void)
+{
+  Ptr<LoRaWANSpectrumChannel> channel = CreateObject<LoRaWANSpectrumChannel> ();
+  channel->AddPropagationLossModel (CreateObject<LogDistancePropagationLossModel> ());
+  channel->SetPropagationDelayModel (CreateObject<ConstantSpeedPropagationDelayModel> ());
+  return channel;
+}
+
+static void
+SendUplinks (Ptr<LoRaWANNetDevice> dev0, LoRaWANMsgType msgType, uint8_t numberOfTransmissions, uint32_t nUplinks)
+{
+  LoRaWANDataRequestParams params;
+  params.m_loraWANChannelIndex = 0;
+  params.m_loraWANDataRateIndex = 5; // SF7
+  params.m_loraWANCodeRate = 3;
+  params.m_loraWANTxPowerIndex = 1;
+  params.m_msgType = msgType;
+  params.m_requestHandle = 1;
+  params.m_numberOfTransmissions = numberOfTransmissions;
+  for (uint32_t i = 0; i < nUplinks; i++)
+    Simulator::Schedule (Seconds (10 * i), &LoRaWANMac::sendMACPayloadRequest, dev0->GetMac (), params, Create<Packet> (20));
+}
+
+static void
+CountMacState (uint32_t *nStates, LoRaWANMacState oldState, LoRaWANMacState newState)
+{
+  (*nStates)++;
+}
+
+/**
+ * Compressed receive windows cut the events an uplink costs the end device
+ * by more than half, unless the MacState trace is connected
+ */
+class LoRaWANReceiveWindowEventsTestCase : public TestCase
+{
+public:
+  LoRaWANReceiveWindowEventsTestCase ();
+  virtual ~LoRaWANReceiveWindowEventsTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * \return the number of events processed to send the uplinks
+   */
+  uint64_t Run (bool compress, bool traced, uint32_t &nStates);
+};
+
+LoRaWANReceiveWindowEventsTestCase::LoRaWANReceiveWindowEventsTestCase ()
+  : TestCase ("Test the events saved by compressed receive windows")
+{
+}
+
+LoRaWANReceiveWindowEventsTestCase::~LoRaWANReceiveWindowEventsTestCase ()
+{
+}
+
+uint64_t
+LoRaWANReceiveWindowEventsTestCase::Run (bool compress, bool traced, uint32_t &nStates)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (1);
+  Config::SetDefault ("ns3::LoRaWANMac::CompressReceiveWindows", BooleanValue (compress));
+  Config::SetGlobal ("EventProfilerSamplingPeriod", UintegerValue (1));
+
+  // No gateway, so that all events are the end device's
+  Ptr<LoRaWANNetDevice> dev0 = CreateEndDevice (CreateChannel ());
+  nStates = 0;
+  if (traced)
+    dev0->GetMac ()->TraceConnectWithoutContext ("MacState", MakeBoundCallback (&CountMacState, &nStates));
+  SendUplinks (dev0, LORAWAN_UNCONFIRMED_DATA_UP, 1, 10);
+
+  Simulator::Run ();
+
+  DefaultSimulatorImpl::ProfileSummary handlers;
+  uint64_t events = 0;
+  Ptr<DefaultSimulatorImpl> impl = DynamicCast<DefaultSimulatorImpl> (Simulator::GetImplementation ());
+  NS_TEST_EXPECT_MSG_NE (impl, 0, "Not running on the DefaultSimulatorImpl");
+  if (impl)
+    events = impl->GetProfile (handlers);
+
+  Config::SetGlobal ("EventProfilerSamplingPeriod", UintegerValue (0));
+  Config::SetDefault ("ns3::LoRaWANMac::CompressReceiveWindows", BooleanValue (true));
+  Simulator::Destroy ();
+  return events;
+}
+
+void
+LoRaWANReceiveWindowEventsTestCase::DoRun (void)
+{
+  uint32_t nStates;
+  uint64_t full = Run (false, false, nStates);
+  uint64_t compressed = Run (true, false, nStates);
+  uint64_t traced = Run (true, true, nStates);
+
+  NS_TEST_ASSERT_MSG_GT (full, 0, "No events were profiled");
+  NS_TEST_ASSERT_MSG_LT (compressed * 2, full, "Compressed receive windows save too few events (" << compressed << " vs " << full << ")");
+  NS_TEST_ASSERT_MSG_EQ (traced, full, "The receive windows were compressed while the MacState trace was connected");
+  // MAC_TX, WAITFORRW1, RW1, WAITFORRW2, RW2 and IDLE
+  NS_TEST_ASSERT_MSG_EQ (nStates, 10 * 6, "The MacState trace missed state changes");
+}
+
+/**
+ * A downlink in RW1 or RW2 wakes compressed receive windows and is received
+ */
+class LoRaWANReceiveWindowAckTestCase : public TestCase
+{
+public:
+  LoRaWANReceiveWindowAckTestCase (LoRaWANMacState window);
+  virtual ~LoRaWANReceiveWindowAckTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  void GatewayDataIndication (Ptr<LoRaWANNetDevice> gateway, LoRaWANDataIndicationParams params, Ptr<Packet> p);
+  void EndDeviceDataConfirm (LoRaWANDataConfirmParams params);
+
+  LoRaWANMacState m_window;
+  LoRaWANMcpsDataConfirmStatus m_confirmStatus;
+};
+
+LoRaWANReceiveWindowAckTestCase::LoRaWANReceiveWindowAckTestCase (LoRaWANMacState window)
+  : TestCase (window == MAC_RW1 ? "Test an ack in a compressed RW1" : "Test an ack in a compressed RW2"),
+    m_window (window),
+    m_confirmStatus (LORAWAN_NO_ACK)
+{
+}
+
+LoRaWANReceiveWindowAckTestCase::~LoRaWANReceiveWindowAckTestCase ()
+{
+}
+
+void
+LoRaWANReceiveWindowAckTestCase::GatewayDataIndication (Ptr<LoRaWANNetDevice> gateway, LoRaWANDataIndicationParams params, Ptr<Packet> p)
+{
+  Ptr<Packet> ack = Create<Packet> (0);
+  LoRaWANFrameHeaderUplink frmHdr;
+  frmHdr.setDevAddr (Ipv4Address (0x00000001));
+  frmHdr.setAck (true);
+  frmHdr.setFrameCounter (1);
+  ack->AddHeader (frmHdr);
+
+  LoRaWANDataRequestParams ackParams;
+  Time delay;
+  if (m_window == MAC_RW1) {
+    ackParams.m_loraWANChannelIndex = LoRaWAN::GetRX1ChannelIndex (params.m_channelIndex);
+    ackParams.m_loraWANDataRateIndex = LoRaWAN::GetRX1DataRateIndex (params.m_dataRateIndex, 0);
+    delay = MicroSeconds (RECEIVE_DELAY1) + MilliSeconds (1);
+  } else {
+    ackParams.m_loraWANChannelIndex = LoRaWAN::m_RW2ChannelIndex;
+    ackParams.m_loraWANDataRateIndex = LoRaWAN::m_RW2DataRateIndex;
+    delay = MicroSeconds (RECEIVE_DELAY2) + MilliSeconds (1);
+  }
+  ackParams.m_loraWANCodeRate = 3;
+  ackParams.m_loraWANTxPowerIndex = 0;
+  ackParams.m_msgType = LORAWAN_UNCONFIRMED_DATA_DOWN;
+  ackParams.m_requestHandle = 2;
+  ackParams.m_numberOfTransmissions = 1;
+
+  uint8_t macIndex = 0;
+  NS_ASSERT_MSG (gateway->getMACSIndexForChannelAndDataRate (macIndex, ackParams.m_loraWANChannelIndex, ackParams.m_loraWANDataRateIndex),
+                 "Unable to find corresponding MAC object on GW for sending DS transmission");
+  Simulator::Schedule (delay, &LoRaWANMac::sendMACPayloadRequest, gateway->GetMacs ()[macIndex], ackParams, ack);
+}
+
+void
+LoRaWANReceiveWindowAckTestCase::EndDeviceDataConfirm (LoRaWANDataConfirmParams params)
+{
+  m_confirmStatus = params.m_status;
+}
+
+void
+LoRaWANReceiveWindowAckTestCase::DoRun (void)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (1);
+
+  Ptr<LoRaWANSpectrumChannel> channel = CreateChannel ();
+  Ptr<LoRaWANNetDevice> dev0 = CreateEndDevice (channel);
+  Ptr<Node> gw = CreateObject <Node> ();
+  Ptr<LoRaWANNetDevice> dev1 = CreateObject<LoRaWANNetDevice> (LORAWAN_DT_GATEWAY);
+  dev1->SetChannel (channel);
+  gw->AddDevice (dev1);
+
+  Ptr<ConstantPositionMobilityModel> mobility1 = CreateObject<ConstantPositionMobilityModel> ();
+  mobility1->SetPosition (Vector (0, 0, 0));
+  for (auto &it : dev1->GetPhys ())
+    it->SetMobility (mobility1);
+
+  dev0->GetMac ()->SetDataConfirmCallback (MakeCallback (&LoRaWANReceiveWindowAckTestCase::EndDeviceDataConfirm, this));
+  for (auto &it : dev1->GetMacs ())
+    it->SetDataIndicationCallback (MakeCallback (&LoRaWANReceiveWindowAckTestCase::GatewayDataIndication, this).Bind (dev1));
+  SendUplinks (dev0, LORAWAN_CONFIRMED_DATA_UP, 1, 1);
+
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ ((m_confirmStatus == LORAWAN_SUCCESS), true, "The ack was not received, status = " << m_confirmStatus);
+
+  Simulator::Destroy ();
+}
+
+/**
+ * Confirmed uplinks that are not acked are retransmitted at the same times
+ * with and without compressed receive windows, as the ack time-out timer
+ * starts at the beginning of RW2 in both cases
+ */
+class LoRaWANReceiveWindowRetransmissionTestCase : public TestCase
+{
+public:
+  LoRaWANReceiveWindowRetransmissionTestCase ();
+  virtual ~LoRaWANReceiveWindowRetransmissionTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  void Run (bool compress, std::vector<Time> &txTimes);
+  static void PhyTxBegin (std::vector<Time> *txTimes, Ptr<const Packet> p);
+};
+
+LoRaWANReceiveWindowRetransmissionTestCase::LoRaWANReceiveWindowRetransmissionTestCase ()
+  : TestCase ("Test retransmissions after compressed receive windows")
+{
+}
+
+LoRaWANReceiveWindowRetransmissionTestCase::~LoRaWANReceiveWindowRetransmissionTestCase ()
+{
+}
+
+void
+LoRaWANReceiveWindowRetransmissionTestCase::PhyTxBegin (std::vector<Time> *txTimes, Ptr<const Packet> p)
+{
+  txTimes->push_back (Simulator::Now ());
+}
+
+void
+LoRaWANReceiveWindowRetransmissionTestCase::Run (bool compress, std::vector<Time> &txTimes)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (1);
+  Config::SetDefault ("ns3::LoRaWANMac::CompressReceiveWindows", BooleanValue (compress));
+
+  Ptr<LoRaWANNetDevice> dev0 = CreateEndDevice (CreateChannel ());
+  dev0->GetPhy ()->TraceConnectWithoutContext ("PhyTxBegin", MakeBoundCallback (&LoRaWANReceiveWindowRetransmissionTestCase::PhyTxBegin, &txTimes));
+  SendUplinks (dev0, LORAWAN_CONFIRMED_DATA_UP, 3, 2);
+
+  Simulator::Run ();
+
+  Config::SetDefault ("ns3::LoRaWANMac::CompressReceiveWindows", BooleanValue (true));
+  Simulator::Destroy ();
+}
+
+void
+LoRaWANReceiveWindowRetransmissionTestCase::DoRun (void)
+{
+  std::vector<Time> full;
+  std::vector<Time> compressed;
+  Run (false, full);
+  Run (true, compressed);
+
+  NS_TEST_ASSERT_MSG_EQ (full.size (), 2 * 3, "Unexpected number of transmissions");
+  NS_TEST_ASSERT_MSG_EQ (compressed.size (), full.size (), "Unexpected number of transmissions with compressed receive windows");
+  for (uint32_t i = 0; i < full.size (); i++)
+    NS_TEST_ASSERT_MSG_EQ (compressed[i], full[i], "Transmission " << i << " at a different time with compressed receive windows");
+}
+
+// ==============================================================================
+class LoRaWANReceiveWindowTestSuite : public TestSuite
+{
+public:
+  LoRaWANReceiveWindowTestSuite ();
+};
+
+LoRaWANReceiveWindowTestSuite::LoRaWANReceiveWindowTestSuite ()
+  : TestSuite ("lorawan-receive-window", UNIT)
+{
+  AddTestCase (new LoRaWANReceiveWindowEventsTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANReceiveWindowAckTestCase (MAC_RW1), TestCase::QUICK);
+  AddTestCase (new LoRaWANReceiveWindowAckTestCase (MAC_RW2), TestCase::QUICK);
+  AddTestCase (new LoRaWANReceiveWindowRetransmissionTestCase, TestCase::QUICK);
+}
+
+static LoRaWANReceiveWindowTestSuite lorawanReceiveWindowTestSuite;
@@ -0,0 +1,329 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+#include <ns3/test.h>
+#include <ns3/log.h>
+#include <ns3/core-module.h>
+#include <ns3/lorawan-module.h>
+#include <ns3/propagation-loss-model.h>
+#include <ns3/propagation-delay-model.h>
+#include <ns3/constant-position-mobility-model.h>
+#include <ns3/node.h>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-region-test");
+
+/**
+ * The tables installed by LoRaWAN::SetRegion and the RX1 mapping of every
+ * region
+ */
+class LoRaWANRegionTablesTestCase : public TestCase
+{
+public:
+  LoRaWANRegionTablesTestCase ();
+  virtual ~LoRaWANRegionTablesTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANRegionTablesTestCase::LoRaWANRegionTablesTestCase ()
+  : TestCase ("Test the channel plans of the EU868, US915 and AS923 regions")
+{
+}
+
+LoRaWANRegionTablesTestCase::~LoRaWANRegionTablesTestCase ()
+{
+}
+
+void
+LoRaWANRegionTablesTestCase::DoRun (void)
+{
+  // EU868 is the default
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::GetRegion (), LORAWAN_REGION_EU868, "EU868 is not the default region");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::m_supportedChannels.size (), 8, "Wrong number of EU868 channels");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)LoRaWAN::m_nUplinkChannels, 7, "Wrong number of EU868 uplink channels");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::m_supportedChannels[LoRaWAN::m_RW2ChannelIndex].m_fc, 869525000, "Wrong EU868 RW2 channel");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)LoRaWAN::GetRX1ChannelIndex (4), 4, "EU868 RX1 does not use the uplink channel");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)LoRaWAN::GetRX1DataRateIndex (5, 2), 3, "Wrong EU868 RX1 data rate");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::IsValidTxPower (27), true, "High power not accepted");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::IsValidTxPower (11), false, "11dBm accepted in EU868");
+
+  // US915 sub band 1: uplink channels 8-15 first, then the 8 downlink channels
+  LoRaWAN::SetRegion (LORAWAN_REGION_US915, 1);
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::GetRegion (), LORAWAN_REGION_US915, "Region not set");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::m_supportedChannels.size (), 16, "Wrong number of US915 channels");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)LoRaWAN::m_nUplinkChannels, 8, "Wrong number of US915 uplink channels");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::m_supportedChannels[0].m_fc, 903900000, "Wrong first uplink channel of sub band 1");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::m_supportedChannels[7].m_fc, 905300000, "Wrong last uplink channel of sub band 1");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::m_supportedChannels[8].m_fc, 923300000, "Wrong first downlink channel");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::m_supportedChannels[15].m_bw, 500000, "Downlink channels are 500kHz");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::GetDefaultUplinkChannelMask (), 0xff, "Wrong US915 uplink channel mask");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)LoRaWAN::m_maxUplinkDataRateIndex, 3, "Wrong US915 max uplink data rate");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)LoRaWAN::GetRX1ChannelIndex (3), 11, "Wrong US915 RX1 channel");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)LoRaWAN::GetRX1DataRateIndex (0, 0), 10, "Wrong US915 RX1 data rate for DR0");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)LoRaWAN::GetRX1DataRateIndex (3, 0), 13, "Wrong US915 RX1 data rate for DR3");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)LoRaWAN::GetRX1DataRateIndex (4, 0), 13, "Wrong US915 RX1 data rate for DR4");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)LoRaWAN::GetRX1DataRateIndex (1, 3), 8, "Wrong US915 RX1 data rate for DR1 and offset 3");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)LoRaWAN::m_RW2DataRateIndex, 8, "Wrong US915 RW2 data rate");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::IsValidTxPower (30), true, "30dBm not accepted in US915");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::IsValidTxPower (2), false, "2dBm accepted in US915");
+
+  // end devices pick their uplink channels among the 8 of the sub band
+  Ptr<LoRaWANEndDeviceApplication> app = CreateObject<LoRaWANEndDeviceApplication> ();
+  PointerValue channelRandomVariable;
+  app->GetAttribute ("ChannelRandomVariable", channelRandomVariable);
+  Ptr<UniformRandomVariable> channelUniform = channelRandomVariable.Get<UniformRandomVariable> ();
+  NS_TEST_ASSERT_MSG_NE (channelUniform, 0, "Channel random variable is not uniform");
+  NS_TEST_ASSERT_MSG_EQ_TOL (channelUniform->GetMax (), 7.0, 1e-9, "Channel random variable does not cover the US915 uplink channels");
+
+  // the ADR SNR requirements follow the spreading factor: DR0 is SF10 in US915
+  Ptr<LoRaWANNetworkServer> ns = CreateObject<LoRaWANNetworkServer> ();
+  ns->SetAttribute ("SnrCutoffValuesSource", BooleanValue (true));
+  NS_TEST_ASSERT_MSG_EQ_TOL (ns->GetADRRequiredSNR (0), -15.0, 1e-9, "Wrong SNR requirement of US915 DR0");
+  uint8_t dr = 2;
+  uint8_t tx = 0;
+  LoRaWANNetworkServer::ApplyADRSteps (3, dr, tx);
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)dr, 3, "ADR raised the data rate above DR3");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)tx, 2, "ADR did not lower the tx power");
+  ns->Dispose ();
+
+  // AS923
+  LoRaWAN::SetRegion (LORAWAN_REGION_AS923);
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::m_supportedChannels.size (), 8, "Wrong number of AS923 channels");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)LoRaWAN::m_nUplinkChannels, 8, "Wrong number of AS923 uplink channels");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::m_supportedChannels[LoRaWAN::m_RW2ChannelIndex].m_fc, 923200000, "Wrong AS923 RW2 channel");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)LoRaWAN::m_RW2DataRateIndex, 2, "Wrong AS923 RW2 data rate");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)LoRaWAN::GetRX1ChannelIndex (6), 6, "AS923 RX1 does not use the uplink channel");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::IsValidTxPower (16), true, "16dBm not accepted in AS923");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::IsValidTxPower (14), true, "14dBm not accepted in AS923");
+
+  LoRaWAN::SetRegion (LORAWAN_REGION_EU868);
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::m_supportedChannels.size (), 8, "EU868 not restored");
+  NS_TEST_ASSERT_MSG_EQ (LoRaWAN::m_supportedChannels[LoRaWAN::m_RW2ChannelIndex].m_fc, 869525000, "EU868 not restored");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)LoRaWAN::GetRX1DataRateIndex (5, 2), 3, "EU868 RX1 mapping not restored");
+
+  Simulator::Destroy ();
+}
+
+/**
+ * A gateway has a MAC for every data rate of every channel, and only
+ * listens on the uplink channels
+ */
+class LoRaWANRegionGatewayTestCase : public TestCase
+{
+public:
+  LoRaWANRegionGatewayTestCase ();
+  virtual ~LoRaWANRegionGatewayTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANRegionGatewayTestCase::LoRaWANRegionGatewayTestCase ()
+  : TestCase ("Test the MACs and receivers of a gateway in EU868 and US915")
+{
+}
+
+LoRaWANRegionGatewayTestCase::~LoRaWANRegionGatewayTestCase ()
+{
+}
+
+void
+LoRaWANRegionGatewayTestCase::DoRun (void)
+{
+  // EU868: 8 channels x 7 data rates, all listening
+  Ptr<LoRaWANSpectrumChannel> channel = CreateObject<LoRaWANSpectrumChannel> ();
+  Ptr<LoRaWANNetDevice> gateway = CreateObject<LoRaWANNetDevice> (LORAWAN_DT_GATEWAY);
+  gateway->SetChannel (channel);
+  CreateObject<Node> ()->AddDevice (gateway); // completes the configuration of the PHYs
+  NS_TEST_ASSERT_MSG_EQ (gateway->GetMacs ().size (), 56, "Wrong number of EU868 gateway MACs");
+  NS_TEST_ASSERT_MSG_EQ (channel->GetNActiveRx (), 56, "Wrong number of EU868 gateway receivers");
+  uint8_t macIndex = 0;
+  NS_TEST_ASSERT_MSG_EQ (gateway->getMACSIndexForChannelAndDataRate (macIndex, 3, 4), true, "No MAC for channel 3 and DR4");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)macIndex, 3 * 7 + 4, "The EU868 MAC index changed");
+  gateway->Dispose ();
+
+  // US915: 8 uplink channels x DR0-3 listening, 8 downlink channels x DR8-13 transmitting only
+  LoRaWAN::SetRegion (LORAWAN_REGION_US915, 0);
+  channel = CreateObject<LoRaWANSpectrumChannel> ();
+  gateway = CreateObject<LoRaWANNetDevice> (LORAWAN_DT_GATEWAY);
+  gateway->SetChannel (channel);
+  CreateObject<Node> ()->AddDevice (gateway); // completes the configuration of the PHYs
+  NS_TEST_ASSERT_MSG_EQ (gateway->GetMacs ().size (), 8 * 4 + 8 * 6, "Wrong number of US915 gateway MACs");
+  NS_TEST_ASSERT_MSG_EQ (channel->GetNActiveRx (), 8 * 4, "Gateway should only listen on the uplink channels");
+  NS_TEST_ASSERT_MSG_EQ (gateway->getMACSIndexForChannelAndDataRate (macIndex, 2, 3), true, "No MAC for channel 2 and DR3");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)gateway->GetPhys ()[macIndex]->GetCurrentChannelIndex (), 2, "MAC on the wrong channel");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)gateway->GetPhys ()[macIndex]->GetCurrentDataRateIndex (), 3, "MAC on the wrong data rate");
+  NS_TEST_ASSERT_MSG_EQ (gateway->getMACSIndexForChannelAndDataRate (macIndex, 9, 11), true, "No MAC for channel 9 and DR11");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)gateway->GetPhys ()[macIndex]->GetCurrentChannelIndex (), 9, "MAC on the wrong channel");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)gateway->GetPhys ()[macIndex]->GetCurrentDataRateIndex (), 11, "MAC on the wrong data rate");
+  NS_TEST_ASSERT_MSG_EQ (gateway->getMACSIndexForChannelAndDataRate (macIndex, 2, 8), false, "MAC for a downlink data rate on an uplink channel");
+  NS_TEST_ASSERT_MSG_EQ (gateway->getMACSIndexForChannelAndDataRate (macIndex, 9, 3), false, "MAC for an uplink data rate on a downlink channel");
+  gateway->Dispose ();
+
+  LoRaWAN::SetRegion (LORAWAN_REGION_EU868);
+  Simulator::Destroy ();
+}
+
+/**
+ * A confirmed uplink on a US915 125kHz channel is acknowledged in RW1 on the
+ * 500kHz downlink channel and data rate given by the RX1 mapping
+ */
+class LoRaWANRegionUS915AckTestCase : public TestCase
+{
+public:
+  LoRaWANRegionUS915AckTestCase ();
+  virtual ~LoRaWANRegionUS915AckTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  void GatewayDataIndication (Ptr<LoRaWANNetDevice> gateway, LoRaWANDataIndicationParams params, Ptr<Packet> p);
+  void EndDeviceDataConfirm (LoRaWANDataConfirmParams params);
+
+  Ipv4Address m_nodeAddr;
+  uint32_t m_nUplinks;
+  uint8_t m_uplinkChannelIndex;
+  uint8_t m_uplinkDataRateIndex;
+  LoRaWANMcpsDataConfirmStatus m_confirmStatus;
+};
+
+LoRaWANRegionUS915AckTestCase::LoRaWANRegionUS915AckTestCase ()
+  : TestCase ("Test an acknowledged uplink in US915"),
+    m_nodeAddr (Ipv4Address (0x00000001)),
+    m_nUplinks (0),
+    m_uplinkChannelIndex (0),
+    m_uplinkDataRateIndex (0),
+    m_confirmStatus (LORAWAN_NO_ACK)
+{
+}
+
+LoRaWANRegionUS915AckTestCase::~LoRaWANRegionUS915AckTestCase ()
+{
+}
+
+void
+LoRaWANRegionUS915AckTestCase::GatewayDataIndication (Ptr<LoRaWANNetDevice> gateway, LoRaWANDataIndicationParams params, Ptr<Packet> p)
+{
+  m_nUplinks++;
+  m_uplinkChannelIndex = params.m_channelIndex;
+  m_uplinkDataRateIndex = params.m_dataRateIndex;
+
+  // Ack in RW1, which opens RECEIVE_DELAY1 after the end of the uplink
+  Ptr<Packet> ack = Create<Packet> (0);
+  LoRaWANFrameHeaderUplink frmHdr;
+  frmHdr.setDevAddr (m_nodeAddr);
+  frmHdr.setAck (true);
+  frmHdr.setFrameCounter (1);
+  ack->AddHeader (frmHdr);
+
+  LoRaWANDataRequestParams ackParams;
+  ackParams.m_loraWANChannelIndex = LoRaWAN::GetRX1ChannelIndex (params.m_channelIndex);
+  ackParams.m_loraWANDataRateIndex = LoRaWAN::GetRX1DataRateIndex (params.m_dataRateIndex, 0);
+  ackParams.m_loraWANCodeRate = 3;
+  ackParams.m_loraWANTxPowerIndex = 0;
+  ackParams.m_msgType = LORAWAN_UNCONFIRMED_DATA_DOWN;
+  ackParams.m_requestHandle = 2;
+  ackParams.m_numberOfTransmissions = 1;
+
+  uint8_t macIndex = 0;
+  NS_ASSERT_MSG (gateway->getMACSIndexForChannelAndDataRate (macIndex, ackParams.m_loraWANChannelIndex, ackParams.m_loraWANDataRateIndex),
+                 "Unable to find corresponding MAC object on GW for sending DS transmission");
+  Simulator::Schedule (MicroSeconds (RECEIVE_DELAY1) + MilliSeconds (1), &LoRaWANMac::sendMACPayloadRequest, gateway->GetMacs ()[macIndex], ackParams, ack);
+}
+
+void
+LoRaWANRegionUS915AckTestCase::EndDeviceDataConfirm (LoRaWANDataConfirmParams params)
+{
+  m_confirmStatus = params.m_status;
+}
+
+void
+LoRaWANRegionUS915AckTestCase::DoRun (void)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (1);
+
+  LoRaWAN::SetRegion (LORAWAN_REGION_US915, 1);
+
+  Ptr<Node> n0 = CreateObject <Node> ();
+  Ptr<Node> gw = CreateObject <Node> ();
+  Ptr<LoRaWANNetDevice> dev0 = CreateObject<LoRaWANNetDevice> (LORAWAN_DT_END_DEVICE_CLASS_A);
+  Ptr<LoRaWANNetDevice> dev1 = CreateObject<LoRaWANNetDevice> (LORAWAN_DT_GATEWAY);
+  dev0->SetAddress (m_nodeAddr);
+
+  Ptr<LoRaWANSpectrumChannel> channel = CreateObject<LoRaWANSpectrumChannel> ();
+  channel->AddPropagationLossModel (CreateObject<LogDistancePropagationLossModel> ());
+  channel->SetPropagationDelayModel (CreateObject<ConstantSpeedPropagationDelayModel> ());
+  dev0->SetChannel (channel);
+  dev1->SetChannel (channel);
+  n0->AddDevice (dev0);
+  gw->AddDevice (dev1);
+
+  Ptr<ConstantPositionMobilityModel> mobility0 = CreateObject<ConstantPositionMobilityModel> ();
+  mobility0->SetPosition (Vector (0, 100, 0));
+  dev0->GetPhy ()->SetMobility (mobility0);
+  Ptr<ConstantPositionMobilityModel> mobility1 = CreateObject<ConstantPositionMobilityModel> ();
+  mobility1->SetPosition (Vector (0, 0, 0));
+  for (auto &it : dev1->GetPhys ())
+    it->SetMobility (mobility1);
+
+  dev0->GetMac ()->SetDataConfirmCallback (MakeCallback (&LoRaWANRegionUS915AckTestCase::EndDeviceDataConfirm, this));
+  for (auto &it : dev1->GetMacs ())
+    it->SetDataIndicationCallback (MakeCallback (&LoRaWANRegionUS915AckTestCase::GatewayDataIndication, this).Bind (dev1));
+
+  LoRaWANDataRequestParams params;
+  params.m_loraWANChannelIndex = 5;
+  params.m_loraWANDataRateIndex = 3; // SF7, 125kHz
+  params.m_loraWANCodeRate = 3;
+  params.m_loraWANTxPowerIndex = 0;
+  params.m_msgType = LORAWAN_CONFIRMED_DATA_UP;
+  params.m_requestHandle = 1;
+  params.m_numberOfTransmissions = 1;
+  Simulator::ScheduleNow (&LoRaWANMac::sendMACPayloadRequest, dev0->GetMac (), params, Create<Packet> (20));
+
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (m_nUplinks, 1, "The gateway did not receive the uplink once");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)m_uplinkChannelIndex, 5, "Uplink received on the wrong channel");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)m_uplinkDataRateIndex, 3, "Uplink received at the wrong data rate");
+  NS_TEST_ASSERT_MSG_EQ ((m_confirmStatus == LORAWAN_SUCCESS), true, "The ack on the downlink channel was not received, status = " << m_confirmStatus);
+
+  Simulator::Destroy ();
+  LoRaWAN::SetRegion (LORAWAN_REGION_EU868);
+}
+
+// ==============================================================================
+class LoRaWANRegionTestSuite : public TestSuite
+{
+public:
+  LoRaWANRegionTestSuite ();
+};
+
+LoRaWANRegionTestSuite::LoRaWANRegionTestSuite ()
+  : TestSuite ("lorawan-region", UNIT)
+{
+  AddTestCase (new LoRaWANRegionTablesTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANRegionGatewayTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANRegionUS915AckTestCase, TestCase::QUICK);
+}
+
+static LoRaWANRegionTestSuite lorawanRegionTestSuite;
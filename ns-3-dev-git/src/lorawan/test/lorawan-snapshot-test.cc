@@ -0,0 +1,201 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+#include <ns3/test.h>
+#include <ns3/log.h>
+#include <ns3/core-module.h>
+#include <ns3/lorawan-module.h>
+#include <ns3/simulator.h>
+#include <ns3/single-model-spectrum-channel.h>
+#include <ns3/node.h>
+#include <ns3/pointer.h>
+#include "ns3/rng-seed-manager.h"
+
+#include <cstdio>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-snapshot-test");
+
+class LoRaWANSnapshotTestCase : public TestCase
+{
+public:
+  LoRaWANSnapshotTestCase ();
+  virtual ~LoRaWANSnapshotTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  NodeContainer BuildEndDevices (void);
+  static Ptr<LoRaWANEndDeviceApplication> GetApplication (Ptr<Node> node);
+  static Ptr<RandomVariableStream> GetRandomVariable (Ptr<Object> object, std::string attribute);
+};
+
+LoRaWANSnapshotTestCase::LoRaWANSnapshotTestCase ()
+  : TestCase ("Test whether the ADR state of a LoRaWAN network survives a snapshot save and restore")
+{
+}
+
+LoRaWANSnapshotTestCase::~LoRaWANSnapshotTestCase ()
+{
+}
+
+NodeContainer
+LoRaWANSnapshotTestCase::BuildEndDevices (void)
+{
+  // Use fixed device addresses, as LoRaWANHelper keeps counting addresses over topologies
+  NodeContainer nodes;
+  nodes.Create (2);
+
+  Ptr<SingleModelSpectrumChannel> channel = CreateObject<SingleModelSpectrumChannel> ();
+  for (uint32_t i = 0; i < nodes.GetN (); i++)
+    {
+      Ptr<LoRaWANNetDevice> dev = CreateObject<LoRaWANNetDevice> (LORAWAN_DT_END_DEVICE_CLASS_A);
+      dev->SetAddress (Ipv4Address (i + 1));
+      dev->SetChannel (channel);
+      nodes.Get (i)->AddDevice (dev);
+    }
+
+  LoRaWANEndDeviceHelper enddevicehelper;
+  enddevicehelper.Install (nodes);
+  return nodes;
+}
+
+Ptr<LoRaWANEndDeviceApplication>
+LoRaWANSnapshotTestCase::GetApplication (Ptr<Node> node)
+{
+  return DynamicCast<LoRaWANEndDeviceApplication> (node->GetApplication (0));
+}
+
+Ptr<RandomVariableStream>
+LoRaWANSnapshotTestCase::GetRandomVariable (Ptr<Object> object, std::string attribute)
+{
+  PointerValue ptr;
+  object->GetAttribute (attribute, ptr);
+  return ptr.Get<RandomVariableStream> ();
+}
+
+void
+LoRaWANSnapshotTestCase::DoRun (void)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (1);
+
+  std::string filename = CreateTempDirFilename ("lorawan-snapshot-test.snap");
+  LoRaWANSnapshotHelper snapshotHelper;
+
+  // Build a network and move it away from its initial state
+  NodeContainer nodes = BuildEndDevices ();
+  Ptr<LoRaWANNetworkServer> ns = LoRaWANNetworkServer::getLoRaWANNetworkServerPointer ();
+  ns->PopulateEndDevices ();
+
+  Ptr<LoRaWANEndDeviceApplication> app = GetApplication (nodes.Get (1));
+  app->SetDataRateIndex (4);
+  app->SetTxPowerIndex (3);
+  app->SetFrameCounterUp (421);
+  app->SetAdrAckCounter (37);
+  app->SetChannelMask (0x15);
+  DynamicCast<LoRaWANNetDevice> (nodes.Get (1)->GetDevice (0))->SetNbRep (2);
+  GetRandomVariable (app, "UpstreamSend")->GetValue ();
+  GetRandomVariable (app, "ChannelRandomVariable")->GetInteger ();
+
+  LoRaWANEndDeviceInfoNS* info = ns->GetEndDeviceInfo (2);
+  NS_TEST_ASSERT_MSG_EQ ((info != nullptr), true, "Network server does not know end device 2");
+  info->m_lastDataRateIndex = 4;
+  info->m_lastTxPowerIndex = 3;
+  info->m_fCntUp = 421;
+  info->m_fCntDown = 17;
+  info->m_nUniqueUSPackets = 400;
+  info->m_setAdr = true;
+  info->m_nbTrans = 2;
+  info->m_channelMask = 0x15;
+  for (uint16_t f = 402; f <= 421; f++)
+    {
+      LoRaWANAdrSnrRow row = {f, -10.0 + 0.25 * (f % 7), static_cast<uint8_t> (1 + f % 3), 2, static_cast<uint8_t> (1 + f % 2)};
+      info->m_frameSNRHistory.insert (info->m_frameSNRHistory.begin (), row);
+    }
+  GetRandomVariable (ns, "DownstreamIAT")->GetValue ();
+
+  NS_TEST_ASSERT_MSG_EQ (snapshotHelper.Save (filename, nodes), true, "Saving snapshot failed");
+
+  // The values drawn right after the snapshot should be drawn again after the restore
+  double expectedSend = GetRandomVariable (app, "UpstreamSend")->GetValue ();
+  uint32_t expectedChannel = GetRandomVariable (app, "ChannelRandomVariable")->GetInteger ();
+  double expectedDownstreamIAT = GetRandomVariable (ns, "DownstreamIAT")->GetValue ();
+  std::vector<LoRaWANAdrSnrRow> expectedHistory = info->m_frameSNRHistory;
+
+  LoRaWANNetworkServer::clearLoRaWANNetworkServerPointer ();
+  Simulator::Destroy ();
+
+  // Build the same network again and restore the snapshot into it
+  nodes = BuildEndDevices ();
+  NS_TEST_ASSERT_MSG_EQ (snapshotHelper.Restore (filename, nodes), true, "Restoring snapshot failed");
+
+  ns = LoRaWANNetworkServer::getLoRaWANNetworkServerPointer ();
+  app = GetApplication (nodes.Get (1));
+  NS_TEST_ASSERT_MSG_EQ (app->GetDataRateIndex (), 4, "Data rate index not restored");
+  NS_TEST_ASSERT_MSG_EQ (app->GetTxPowerIndex (), 3, "Tx power index not restored");
+  NS_TEST_ASSERT_MSG_EQ (app->GetFrameCounterUp (), 421, "Uplink frame counter not restored");
+  NS_TEST_ASSERT_MSG_EQ (app->GetAdrAckCounter (), 37, "ADR ack counter not restored");
+  NS_TEST_ASSERT_MSG_EQ (app->GetChannelMask (), 0x15, "Channel mask not restored");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)DynamicCast<LoRaWANNetDevice> (nodes.Get (1)->GetDevice (0))->GetNbRep (), 2, "NbRep not restored");
+  NS_TEST_ASSERT_MSG_EQ (GetApplication (nodes.Get (0))->GetFrameCounterUp (), 0, "Untouched end device was modified");
+
+  info = ns->GetEndDeviceInfo (2);
+  NS_TEST_ASSERT_MSG_EQ ((info != nullptr), true, "Network server does not know end device 2 after restore");
+  NS_TEST_ASSERT_MSG_EQ (info->m_lastDataRateIndex, 4, "NS data rate index not restored");
+  NS_TEST_ASSERT_MSG_EQ (info->m_lastTxPowerIndex, 3, "NS tx power index not restored");
+  NS_TEST_ASSERT_MSG_EQ (info->m_fCntUp, 421, "NS uplink frame counter not restored");
+  NS_TEST_ASSERT_MSG_EQ (info->m_fCntDown, 17, "NS downlink frame counter not restored");
+  NS_TEST_ASSERT_MSG_EQ (info->m_nUniqueUSPackets, 400, "NS unique packet counter not restored");
+  NS_TEST_ASSERT_MSG_EQ (info->m_setAdr, true, "NS ADR flag not restored");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t)info->m_nbTrans, 2, "NS NbTrans not restored");
+  NS_TEST_ASSERT_MSG_EQ (info->m_channelMask, 0x15, "NS channel mask not restored");
+  NS_TEST_ASSERT_MSG_EQ (info->m_frameSNRHistory.size (), expectedHistory.size (), "SNR history size not restored");
+  for (uint32_t i = 0; i < expectedHistory.size (); i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (info->m_frameSNRHistory[i].frameCounter, expectedHistory[i].frameCounter, "SNR history frame counter not restored");
+      NS_TEST_ASSERT_MSG_EQ (info->m_frameSNRHistory[i].snrMax, expectedHistory[i].snrMax, "SNR history snr not restored");
+      NS_TEST_ASSERT_MSG_EQ (info->m_frameSNRHistory[i].gtwDiversity, expectedHistory[i].gtwDiversity, "SNR history gateway diversity not restored");
+      NS_TEST_ASSERT_MSG_EQ (info->m_frameSNRHistory[i].nTransmissions, expectedHistory[i].nTransmissions, "SNR history transmissions not restored");
+    }
+
+  NS_TEST_ASSERT_MSG_EQ (GetRandomVariable (app, "UpstreamSend")->GetValue (), expectedSend, "UpstreamSend stream position not restored");
+  NS_TEST_ASSERT_MSG_EQ (GetRandomVariable (app, "ChannelRandomVariable")->GetInteger (), expectedChannel, "Channel stream position not restored");
+  NS_TEST_ASSERT_MSG_EQ (GetRandomVariable (ns, "DownstreamIAT")->GetValue (), expectedDownstreamIAT, "DownstreamIAT stream position not restored");
+
+  LoRaWANNetworkServer::clearLoRaWANNetworkServerPointer ();
+  Simulator::Destroy ();
+  std::remove (filename.c_str ());
+}
+
+// ==============================================================================
+class LoRaWANSnapshotTestSuite : public TestSuite
+{
+public:
+  LoRaWANSnapshotTestSuite ();
+};
+
+LoRaWANSnapshotTestSuite::LoRaWANSnapshotTestSuite ()
+  : TestSuite ("lorawan-snapshot", UNIT)
+{
+  AddTestCase (new LoRaWANSnapshotTestCase, TestCase::QUICK);
+}
+
+static LoRaWANSnapshotTestSuite lorawanSnapshotTestSuite;
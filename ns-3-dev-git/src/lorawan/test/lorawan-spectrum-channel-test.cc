@@ -0,0 +1,333 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+#include <ns3/test.h>
+#include <ns3/log.h>
+#include <ns3/core-module.h>
+#include <ns3/network-module.h>
+#include <ns3/mobility-module.h>
+#include <ns3/propagation-module.h>
+#include <ns3/lorawan-module.h>
+#include "ns3/rng-seed-manager.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-spectrum-channel-test");
+
+/**
+ * Counts the receptions of a PHY
+ */
+struct LoRaWANSpectrumChannelTestCounts
+{
+  uint32_t m_rxBegin;
+  uint32_t m_rxEnd;
+  uint32_t m_sinrTooLow;
+  uint32_t m_notInRxState;
+};
+
+static void
+CountRxBegin (LoRaWANSpectrumChannelTestCounts* counts, Ptr<const Packet> packet)
+{
+  counts->m_rxBegin++;
+}
+
+static void
+CountRxEnd (LoRaWANSpectrumChannelTestCounts* counts, Ptr<const Packet> packet, double lqi)
+{
+  counts->m_rxEnd++;
+}
+
+static void
+CountRxDrop (LoRaWANSpectrumChannelTestCounts* counts, Ptr<const Packet> packet, LoRaWANPhyDropRxReason reason)
+{
+  if (reason == LORAWAN_RX_DROP_SINR_TOO_LOW)
+    counts->m_sinrTooLow++;
+  else if (reason == LORAWAN_RX_DROP_NOT_IN_RX_STATE)
+    counts->m_notInRxState++;
+}
+
+static void
+ConnectCounts (Ptr<LoRaWANPhy> phy, LoRaWANSpectrumChannelTestCounts* counts)
+{
+  phy->TraceConnectWithoutContext ("PhyRxBegin", MakeBoundCallback (&CountRxBegin, counts));
+  phy->TraceConnectWithoutContext ("PhyRxEnd", MakeBoundCallback (&CountRxEnd, counts));
+  phy->TraceConnectWithoutContext ("PhyRxDrop", MakeBoundCallback (&CountRxDrop, counts));
+}
+
+static void
+Send (Ptr<LoRaWANPhy> phy, uint32_t size)
+{
+  Ptr<Packet> p = Create<Packet> (size);
+  phy->PdDataRequest (p->GetSize (), p);
+}
+
+static void
+CheckNActiveRx (Ptr<LoRaWANSpectrumChannel> channel, uint32_t* nActiveRx)
+{
+  *nActiveRx = channel->GetNActiveRx ();
+}
+
+/**
+ * A PHY that rejoins the channel in the middle of a transmission does not
+ * receive it, but the transmission still interferes with the next one
+ */
+class LoRaWANSpectrumChannelRejoinTestCase : public TestCase
+{
+public:
+  LoRaWANSpectrumChannelRejoinTestCase ();
+  virtual ~LoRaWANSpectrumChannelRejoinTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANSpectrumChannelRejoinTestCase::LoRaWANSpectrumChannelRejoinTestCase ()
+  : TestCase ("Test the interference seen by a PHY rejoining the channel")
+{
+}
+
+LoRaWANSpectrumChannelRejoinTestCase::~LoRaWANSpectrumChannelRejoinTestCase ()
+{
+}
+
+void
+LoRaWANSpectrumChannelRejoinTestCase::DoRun (void)
+{
+  Ptr<LoRaWANSpectrumChannel> channel = CreateObject<LoRaWANSpectrumChannel> ();
+  channel->AddPropagationLossModel (CreateObject<LogDistancePropagationLossModel> ());
+  channel->SetPropagationDelayModel (CreateObject<ConstantSpeedPropagationDelayModel> ());
+
+  // the interferer is next to the receiver, the sender 500 m away
+  Ptr<LoRaWANPhy> interferer = CreateObject<LoRaWANPhy> ();
+  Ptr<LoRaWANPhy> receiver = CreateObject<LoRaWANPhy> ();
+  Ptr<LoRaWANPhy> sender = CreateObject<LoRaWANPhy> ();
+  const double x[] = { 0.0, 1.0, 501.0 };
+  Ptr<LoRaWANPhy> phys[] = { interferer, receiver, sender };
+  for (uint32_t i = 0; i < 3; i++)
+    {
+      Ptr<ConstantPositionMobilityModel> mobility = CreateObject<ConstantPositionMobilityModel> ();
+      mobility->SetPosition (Vector (x[i], 0.0, 0.0));
+      phys[i]->SetMobility (mobility);
+      phys[i]->SetChannel (channel);
+      phys[i]->SetErrorModel (CreateObject<LoRaWANErrorModel> ());
+      phys[i]->SetTxConf (14, 0, 0, 3, 8, false, true);
+      channel->AddRx (phys[i]);
+    }
+  interferer->SetTRXStateRequest (LORAWAN_PHY_TX_ON);
+  sender->SetTRXStateRequest (LORAWAN_PHY_TX_ON);
+
+  receiver->SetDetachWhenSleeping (true);
+  NS_TEST_ASSERT_MSG_EQ (channel->GetNActiveRx (), 2, "The sleeping PHY did not detach");
+  NS_TEST_ASSERT_MSG_EQ (channel->GetNDevices (), 3, "A detached PHY is no longer on the channel");
+
+  LoRaWANSpectrumChannelTestCounts counts = {};
+  ConnectCounts (receiver, &counts);
+
+  // the interferer sends a long SF12 frame while the receiver sleeps, the
+  // receiver wakes up during the frame and the sender starts its frame
+  // while the interferer is still on air
+  Simulator::Schedule (Seconds (1.0), &Send, interferer, 50);
+  Simulator::Schedule (Seconds (1.5), &LoRaWANPhy::SetTRXStateRequest, receiver, LORAWAN_PHY_RX_ON);
+  Simulator::Schedule (Seconds (2.0), &Send, sender, 10);
+  // once the interferer is done, the next frame of the sender is received
+  Simulator::Schedule (Seconds (9.0), &LoRaWANPhy::SetTRXStateRequest, sender, LORAWAN_PHY_IDLE);
+  Simulator::Schedule (Seconds (9.0), &LoRaWANPhy::SetTRXStateRequest, sender, LORAWAN_PHY_TX_ON);
+  Simulator::Schedule (Seconds (10.0), &Send, sender, 10);
+  Simulator::Schedule (Seconds (15.0), &LoRaWANPhy::SetTRXStateRequest, receiver, LORAWAN_PHY_TRX_OFF);
+  uint32_t nActiveRx = 0;
+  uint32_t nActiveRxAsleep = 0;
+  Simulator::Schedule (Seconds (1.6), &CheckNActiveRx, channel, &nActiveRx);
+  Simulator::Schedule (Seconds (16.0), &CheckNActiveRx, channel, &nActiveRxAsleep);
+
+  Simulator::Stop (Seconds (20.0));
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (nActiveRx, 3, "The listening PHY did not rejoin");
+  NS_TEST_ASSERT_MSG_EQ (nActiveRxAsleep, 2, "The PHY did not detach again");
+  NS_TEST_ASSERT_MSG_EQ (counts.m_notInRxState, 0, "A transmission was delivered to the sleeping PHY");
+  NS_TEST_ASSERT_MSG_EQ (counts.m_sinrTooLow, 1, "The frame sent during the interference was not lost to it");
+  NS_TEST_ASSERT_MSG_EQ (counts.m_rxBegin, 1, "The PHY locked onto a frame that started before it woke up");
+  NS_TEST_ASSERT_MSG_EQ (counts.m_rxEnd, 1, "The frame sent after the interference was not received");
+
+  Simulator::Destroy ();
+}
+
+static void
+DSMsgReceived (uint32_t* nReceived, uint32_t deviceAddr, uint8_t msgType, Ptr<const Packet> packet, uint8_t rw)
+{
+  (*nReceived)++;
+}
+
+static void
+SampleNActiveRx (Ptr<LoRaWANSpectrumChannel> channel, uint32_t* minActiveRx)
+{
+  *minActiveRx = std::min (*minActiveRx, channel->GetNActiveRx ());
+  Simulator::Schedule (Seconds (1), &SampleNActiveRx, channel, minActiveRx);
+}
+
+/**
+ * In a network built by the LoRaWANHelper, end device PHYs only receive the
+ * transmissions that start while their receive windows are open, and still
+ * receive their downlinks
+ */
+class LoRaWANSpectrumChannelNetworkTestCase : public TestCase
+{
+public:
+  LoRaWANSpectrumChannelNetworkTestCase ();
+  virtual ~LoRaWANSpectrumChannelNetworkTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANSpectrumChannelNetworkTestCase::LoRaWANSpectrumChannelNetworkTestCase ()
+  : TestCase ("Test that sleeping end devices do not receive uplinks")
+{
+}
+
+LoRaWANSpectrumChannelNetworkTestCase::~LoRaWANSpectrumChannelNetworkTestCase ()
+{
+}
+
+void
+LoRaWANSpectrumChannelNetworkTestCase::DoRun (void)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (1);
+
+  const uint32_t nEndDevices = 20;
+
+  Ptr<LoRaWANNetworkServer> ns = LoRaWANNetworkServer::getLoRaWANNetworkServerPointer ();
+  ns->SetAttribute ("GenerateDataDown", BooleanValue (true));
+  ns->SetAttribute ("DownstreamIAT", StringValue ("ns3::ExponentialRandomVariable[Mean=300]"));
+
+  NodeContainer endDeviceNodes;
+  NodeContainer gatewayNodes;
+  endDeviceNodes.Create (nEndDevices);
+  gatewayNodes.Create (1);
+
+  MobilityHelper mobility;
+  mobility.SetPositionAllocator ("ns3::UniformDiscPositionAllocator",
+                                 "X", DoubleValue (0.0),
+                                 "Y", DoubleValue (0.0),
+                                 "rho", DoubleValue (500.0));
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (endDeviceNodes);
+  mobility.Install (gatewayNodes);
+
+  LoRaWANHelper lorawanHelper;
+  Ptr<LoRaWANSpectrumChannel> channel = DynamicCast<LoRaWANSpectrumChannel> (lorawanHelper.GetChannel ());
+  NS_TEST_ASSERT_MSG_NE (channel, 0, "The helper does not create a LoRaWANSpectrumChannel");
+  NetDeviceContainer endDeviceDevices = lorawanHelper.Install (endDeviceNodes);
+  lorawanHelper.SetDeviceType (LORAWAN_DT_GATEWAY);
+  lorawanHelper.Install (gatewayNodes);
+  const uint32_t nGatewayPhys = channel->GetNDevices () - nEndDevices;
+
+  PacketSocketHelper packetSocket;
+  packetSocket.Install (endDeviceNodes);
+  packetSocket.Install (gatewayNodes);
+
+  LoRaWANEndDeviceHelper enddevicehelper;
+  enddevicehelper.SetAttribute ("UpstreamIAT", StringValue ("ns3::ConstantRandomVariable[Constant=120]"));
+  ApplicationContainer endDeviceApps = enddevicehelper.Install (endDeviceNodes);
+  LoRaWANGatewayHelper gatewayhelper;
+  gatewayhelper.Install (gatewayNodes);
+
+  LoRaWANSpectrumChannelTestCounts counts = {};
+  for (NetDeviceContainer::Iterator it = endDeviceDevices.Begin (); it != endDeviceDevices.End (); ++it)
+    ConnectCounts (DynamicCast<LoRaWANNetDevice> (*it)->GetPhy (), &counts);
+  uint32_t nDSReceived = 0;
+  for (ApplicationContainer::Iterator it = endDeviceApps.Begin (); it != endDeviceApps.End (); ++it)
+    (*it)->TraceConnectWithoutContext ("DSMsgReceived", MakeBoundCallback (&DSMsgReceived, &nDSReceived));
+  uint32_t minActiveRx = channel->GetNDevices ();
+  Simulator::Schedule (Seconds (0.5), &SampleNActiveRx, channel, &minActiveRx);
+
+  Simulator::Stop (Seconds (1800));
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (minActiveRx, nGatewayPhys, "End devices did not detach while sleeping");
+  NS_TEST_ASSERT_MSG_EQ (counts.m_notInRxState, 0, "A transmission was delivered to a sleeping end device");
+  NS_TEST_ASSERT_MSG_GT (nDSReceived, 0, "No downlinks were received");
+
+  ns = 0;
+  LoRaWANNetworkServer::clearLoRaWANNetworkServerPointer ();
+  Simulator::Destroy ();
+}
+
+/**
+ * LoRaWANHelper::SetPropagationLossModel sets the loss model on the channel
+ * passed to SetChannel instead of replacing the channel
+ */
+class LoRaWANSpectrumChannelHelperLossTestCase : public TestCase
+{
+public:
+  LoRaWANSpectrumChannelHelperLossTestCase ();
+  virtual ~LoRaWANSpectrumChannelHelperLossTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANSpectrumChannelHelperLossTestCase::LoRaWANSpectrumChannelHelperLossTestCase ()
+  : TestCase ("Test that the helper keeps its channel when the loss model is replaced")
+{
+}
+
+LoRaWANSpectrumChannelHelperLossTestCase::~LoRaWANSpectrumChannelHelperLossTestCase ()
+{
+}
+
+void
+LoRaWANSpectrumChannelHelperLossTestCase::DoRun (void)
+{
+  Ptr<LoRaWANSpectrumChannel> channel = CreateObject<LoRaWANSpectrumChannel> ();
+  channel->SetAttribute ("MaxLossDb", DoubleValue (150.0));
+  channel->AddPropagationLossModel (CreateObject<LogDistancePropagationLossModel> ());
+  channel->SetPropagationDelayModel (CreateObject<ConstantSpeedPropagationDelayModel> ());
+
+  LoRaWANHelper lorawanHelper;
+  lorawanHelper.SetChannel (channel);
+  Ptr<PropagationLossModel> lossModel = CreateObject<FriisPropagationLossModel> ();
+  lorawanHelper.SetPropagationLossModel (lossModel);
+
+  NS_TEST_ASSERT_MSG_EQ (lorawanHelper.GetChannel (), channel, "The helper replaced the channel passed to SetChannel");
+  NS_TEST_ASSERT_MSG_EQ (lorawanHelper.GetPropagationLossModel (), lossModel, "The helper does not report the new loss model");
+  DoubleValue maxLossDb;
+  channel->GetAttribute ("MaxLossDb", maxLossDb);
+  NS_TEST_ASSERT_MSG_EQ (maxLossDb.Get (), 150.0, "The attributes of the channel were lost");
+
+  Simulator::Destroy ();
+}
+
+// ==============================================================================
+class LoRaWANSpectrumChannelTestSuite : public TestSuite
+{
+public:
+  LoRaWANSpectrumChannelTestSuite ();
+};
+
+LoRaWANSpectrumChannelTestSuite::LoRaWANSpectrumChannelTestSuite ()
+  : TestSuite ("lorawan-spectrum-channel", UNIT)
+{
+  AddTestCase (new LoRaWANSpectrumChannelRejoinTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANSpectrumChannelNetworkTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANSpectrumChannelHelperLossTestCase, TestCase::QUICK);
+}
+
+static LoRaWANSpectrumChannelTestSuite lorawanSpectrumChannelTestSuite;
@@ -0,0 +1,245 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+#include <ns3/test.h>
+#include <ns3/log.h>
+#include <ns3/core-module.h>
+#include <ns3/network-module.h>
+#include <ns3/mobility-module.h>
+#include <ns3/lorawan-module.h>
+
+#include <cmath>
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-traffic-generator-test");
+
+/**
+ * A source of the traffic generator that records its send times
+ */
+class LoRaWANTrafficGeneratorTestSource
+{
+public:
+  void Send (void)
+  {
+    m_times.push_back (Simulator::Now ());
+    m_generator->ScheduleNext (m_id);
+  }
+
+  Ptr<LoRaWANTrafficGenerator> m_generator;
+  uint32_t m_id;
+  std::vector<Time> m_times;
+};
+
+class LoRaWANTrafficGeneratorTestCase : public TestCase
+{
+public:
+  LoRaWANTrafficGeneratorTestCase ();
+  virtual ~LoRaWANTrafficGeneratorTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoRaWANTrafficGeneratorTestCase::LoRaWANTrafficGeneratorTestCase ()
+  : TestCase ("Test the Poisson process and bucketed send times of the traffic generator")
+{
+}
+
+LoRaWANTrafficGeneratorTestCase::~LoRaWANTrafficGeneratorTestCase ()
+{
+}
+
+void
+LoRaWANTrafficGeneratorTestCase::DoRun (void)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (1);
+
+  const uint32_t nPeriodic = 200;
+  const uint32_t nPoisson = 300;
+  const double period = 100.0;
+  const double mean = 50.0;
+  const Time stop = Seconds (1000);
+  const Time removal = Seconds (250);
+
+  Ptr<LoRaWANTrafficGenerator> generator = CreateObject<LoRaWANTrafficGenerator> ();
+  generator->AssignStreams (0);
+
+  std::vector<LoRaWANTrafficGeneratorTestSource> sources (nPeriodic + nPoisson);
+  for (uint32_t i = 0; i < sources.size (); i++)
+    {
+      Ptr<RandomVariableStream> iat;
+      if (i < nPeriodic)
+        iat = CreateObjectWithAttributes<ConstantRandomVariable> ("Constant", DoubleValue (period));
+      else
+        iat = CreateObjectWithAttributes<ExponentialRandomVariable> ("Mean", DoubleValue (mean));
+
+      sources[i].m_generator = generator;
+      sources[i].m_id = generator->AddSource (iat, Seconds (0.37 * i),
+                                              MakeCallback (&LoRaWANTrafficGeneratorTestSource::Send, &sources[i]));
+    }
+  NS_TEST_ASSERT_MSG_EQ (generator->GetNPoissonSources (), nPoisson, "Wrong number of sources in the Poisson process");
+  NS_TEST_ASSERT_MSG_EQ_TOL (generator->GetPoissonRate (), nPoisson / mean, 1e-9, "Rate of the Poisson process should be the sum of the source rates");
+
+  // one periodic and one Poisson source stop half way
+  Simulator::Schedule (removal, &LoRaWANTrafficGenerator::RemoveSource, generator, sources[0].m_id);
+  Simulator::Schedule (removal, &LoRaWANTrafficGenerator::RemoveSource, generator, sources[nPeriodic].m_id);
+
+  Simulator::Stop (stop);
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (generator->GetNSources (), nPeriodic + nPoisson - 2, "Removed sources still counted");
+
+  // Periodic sources keep their exact send times
+  for (uint32_t i = 0; i < nPeriodic; i++)
+    {
+      const Time end = i == 0 ? removal : stop;
+      const uint32_t expected = std::ceil ((end - Seconds (0.37 * i)).GetSeconds () / period);
+      NS_TEST_ASSERT_MSG_EQ (sources[i].m_times.size (), expected, "Wrong number of uplinks for periodic source " << i);
+      for (uint32_t k = 0; k < sources[i].m_times.size (); k++)
+        NS_TEST_ASSERT_MSG_EQ (sources[i].m_times[k], Seconds (0.37 * i) + Seconds (period * k), "Wrong send time for periodic source " << i);
+    }
+
+  // The Poisson process generates rate * time uplinks, within 4 standard deviations
+  uint32_t nPoissonUplinks = 0;
+  for (uint32_t i = nPeriodic; i < sources.size (); i++)
+    {
+      nPoissonUplinks += sources[i].m_times.size ();
+      for (auto t : sources[i].m_times)
+        NS_TEST_ASSERT_MSG_EQ ((i == nPeriodic && t > removal), false, "Removed source sent an uplink");
+    }
+  const double expected = (nPoisson * stop.GetSeconds () - (stop - removal).GetSeconds ()) / mean;
+  NS_TEST_ASSERT_MSG_EQ_TOL (nPoissonUplinks, expected, 4 * std::sqrt (expected), "Wrong number of uplinks in the Poisson process");
+
+  Simulator::Destroy ();
+}
+
+// ==============================================================================
+static void
+RecordUplink (std::vector<Time>* uplinks, uint32_t devAddr, uint8_t msgType, Ptr<const Packet> packet)
+{
+  uplinks->push_back (Simulator::Now ());
+}
+
+class LoRaWANTrafficGeneratorEndDeviceTestCase : public TestCase
+{
+public:
+  LoRaWANTrafficGeneratorEndDeviceTestCase ();
+  virtual ~LoRaWANTrafficGeneratorEndDeviceTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * Simulate end devices with the default periodic traffic and return the
+   * send times of the uplinks of every end device
+   */
+  std::vector<std::vector<Time> > Run (bool useTrafficGenerator);
+};
+
+LoRaWANTrafficGeneratorEndDeviceTestCase::LoRaWANTrafficGeneratorEndDeviceTestCase ()
+  : TestCase ("Test that end devices that share a traffic generator send at the same times as on their own")
+{
+}
+
+LoRaWANTrafficGeneratorEndDeviceTestCase::~LoRaWANTrafficGeneratorEndDeviceTestCase ()
+{
+}
+
+std::vector<std::vector<Time> >
+LoRaWANTrafficGeneratorEndDeviceTestCase::Run (bool useTrafficGenerator)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (1);
+
+  NodeContainer endDeviceNodes;
+  NodeContainer gatewayNodes;
+  endDeviceNodes.Create (20);
+  gatewayNodes.Create (1);
+
+  MobilityHelper mobility;
+  mobility.SetPositionAllocator ("ns3::UniformDiscPositionAllocator",
+                                 "rho", DoubleValue (2000.0));
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (endDeviceNodes);
+  mobility.Install (gatewayNodes);
+
+  LoRaWANHelper lorawanHelper;
+  lorawanHelper.SetNbRep (1);
+  lorawanHelper.Install (endDeviceNodes);
+  lorawanHelper.SetDeviceType (LORAWAN_DT_GATEWAY);
+  lorawanHelper.Install (gatewayNodes);
+
+  PacketSocketHelper packetSocket;
+  packetSocket.Install (endDeviceNodes);
+  packetSocket.Install (gatewayNodes);
+
+  LoRaWANEndDeviceHelper enddevicehelper;
+  if (useTrafficGenerator)
+    enddevicehelper.SetAttribute ("TrafficGenerator", PointerValue (CreateObject<LoRaWANTrafficGenerator> ()));
+  ApplicationContainer enddeviceApps = enddevicehelper.Install (endDeviceNodes);
+  enddevicehelper.AssignStreams (enddeviceApps, 0); // the generator takes streams of its own
+  LoRaWANGatewayHelper gatewayhelper;
+  gatewayhelper.Install (gatewayNodes);
+
+  // Device addresses differ between runs, so record the uplinks per application
+  std::vector<std::vector<Time> > uplinks (enddeviceApps.GetN ());
+  for (uint32_t i = 0; i < enddeviceApps.GetN (); i++)
+    enddeviceApps.Get (i)->TraceConnectWithoutContext ("USMsgTransmitted", MakeBoundCallback (&RecordUplink, &uplinks[i]));
+
+  Simulator::Stop (Seconds (3000));
+  Simulator::Run ();
+
+  LoRaWANNetworkServer::clearLoRaWANNetworkServerPointer ();
+  Simulator::Destroy ();
+  return uplinks;
+}
+
+void
+LoRaWANTrafficGeneratorEndDeviceTestCase::DoRun (void)
+{
+  const std::vector<std::vector<Time> > own = Run (false);
+  const std::vector<std::vector<Time> > shared = Run (true);
+
+  for (uint32_t i = 0; i < own.size (); i++)
+    {
+      NS_TEST_ASSERT_MSG_GT (own[i].size (), 0, "End device " << i << " did not send any uplink");
+      NS_TEST_ASSERT_MSG_EQ (shared[i].size (), own[i].size (), "Wrong number of uplinks for end device " << i);
+      for (uint32_t k = 0; k < own[i].size () && k < shared[i].size (); k++)
+        NS_TEST_ASSERT_MSG_EQ (shared[i][k], own[i][k], "Wrong send time for end device " << i);
+    }
+}
+
+// ==============================================================================
+class LoRaWANTrafficGeneratorTestSuite : public TestSuite
+{
+public:
+  LoRaWANTrafficGeneratorTestSuite ();
+};
+
+LoRaWANTrafficGeneratorTestSuite::LoRaWANTrafficGeneratorTestSuite ()
+  : TestSuite ("lorawan-traffic-generator", UNIT)
+{
+  AddTestCase (new LoRaWANTrafficGeneratorTestCase, TestCase::QUICK);
+  AddTestCase (new LoRaWANTrafficGeneratorEndDeviceTestCase, TestCase::QUICK);
+}
+
+static LoRaWANTrafficGeneratorTestSuite lorawanTrafficGeneratorTestSuite;
@@ -0,0 +1,325 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+#include <ns3/test.h>
+#include <ns3/log.h>
+#include <ns3/core-module.h>
+#include <ns3/network-module.h>
+#include <ns3/mobility-module.h>
+#include <ns3/lorawan-module.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <set>
+#include <string>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("lorawan-visual-trace-test");
+
+/**
+ * Counts of the receptions at the gateways, taken from the PHY traces directly
+ */
+struct LoRaWANVisualTraceTestCounts
+{
+  LoRaWANVisualTraceTestCounts () : m_uplinks (0), m_rx (0), m_interfered (0), m_cellRx (0), m_cellInterfered (0), m_cells (0), m_tx (0), m_rxRecords (0) {}
+
+  uint32_t m_uplinks;
+  uint32_t m_rx;
+  uint32_t m_interfered;
+
+  // as read back from the visual trace
+  uint32_t m_cellRx;
+  uint32_t m_cellInterfered;
+  uint32_t m_cells;
+  uint32_t m_tx;
+  uint32_t m_rxRecords;
+  std::set<uint64_t> m_txIds;
+  std::set<uint64_t> m_rxIds;
+};
+
+static void
+CountUplink (LoRaWANVisualTraceTestCounts* counts, Ptr<const Packet> packet)
+{
+  counts->m_uplinks++;
+}
+
+static void
+CountRxEnd (LoRaWANVisualTraceTestCounts* counts, Ptr<const Packet> packet, double lqi)
+{
+  counts->m_rx++;
+}
+
+static void
+CountRxDrop (LoRaWANVisualTraceTestCounts* counts, Ptr<const Packet> packet, LoRaWANPhyDropRxReason reason)
+{
+  if (reason == LORAWAN_RX_DROP_PACKET_DESTOYED) {
+    counts->m_rx--;
+    counts->m_interfered++;
+  } else if (reason == LORAWAN_RX_DROP_PACKET_ABORTED || reason == LORAWAN_RX_DROP_ABORTED) {
+    counts->m_rx--;
+  }
+}
+
+/** The value of field in a line of NDJSON written by the helper, which has no nested objects */
+static std::string
+GetField (const std::string& line, const std::string& field)
+{
+  const std::string key = "\"" + field + "\":";
+  std::string::size_type pos = line.find (key);
+  if (pos == std::string::npos)
+    return "";
+  pos += key.size ();
+  std::string::size_type end = line.find_first_of (",}", pos);
+  std::string value = line.substr (pos, end - pos);
+  if (!value.empty () && value[0] == '"')
+    value = value.substr (1, value.size () - 2);
+  return value;
+}
+
+template <typename T>
+static bool
+ReadValue (std::istream& is, T& value)
+{
+  is.read (reinterpret_cast<char*> (&value), sizeof (T));
+  return is.good ();
+}
+
+class LoRaWANVisualTraceTestCase : public TestCase
+{
+public:
+  LoRaWANVisualTraceTestCase ();
+  virtual ~LoRaWANVisualTraceTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  /** Simulate a small network, write its visual trace to filename and count the receptions */
+  void Run (std::string filename, LoRaWANVisualTraceHelper::Format format, LoRaWANVisualTraceTestCounts& counts);
+  void ReadNdjson (std::string filename, LoRaWANVisualTraceTestCounts& counts);
+  void ReadBinary (std::string filename, LoRaWANVisualTraceTestCounts& counts);
+};
+
+LoRaWANVisualTraceTestCase::LoRaWANVisualTraceTestCase ()
+  : TestCase ("Test that the visual trace aggregates the receptions at the gateways and samples packets in both formats")
+{
+}
+
+LoRaWANVisualTraceTestCase::~LoRaWANVisualTraceTestCase ()
+{
+}
+
+void
+LoRaWANVisualTraceTestCase::Run (std::string filename, LoRaWANVisualTraceHelper::Format format, LoRaWANVisualTraceTestCounts& counts)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (1);
+
+  NodeContainer endDeviceNodes;
+  NodeContainer gatewayNodes;
+  endDeviceNodes.Create (40);
+  gatewayNodes.Create (1);
+
+  MobilityHelper mobility;
+  mobility.SetPositionAllocator ("ns3::UniformDiscPositionAllocator",
+                                 "rho", DoubleValue (3000.0));
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (endDeviceNodes);
+  mobility.Install (gatewayNodes);
+
+  LoRaWANHelper lorawanHelper;
+  lorawanHelper.SetNbRep (1);
+  NetDeviceContainer endDevices = lorawanHelper.Install (endDeviceNodes);
+  lorawanHelper.SetDeviceType (LORAWAN_DT_GATEWAY);
+  NetDeviceContainer gateways = lorawanHelper.Install (gatewayNodes);
+
+  PacketSocketHelper packetSocket;
+  packetSocket.Install (endDeviceNodes);
+  packetSocket.Install (gatewayNodes);
+
+  LoRaWANEndDeviceHelper enddevicehelper;
+  enddevicehelper.SetAttribute ("DataRateIndex", UintegerValue (5)); // short airtimes, so that uplinks collide
+  enddevicehelper.SetAttribute ("UpstreamIAT", StringValue ("ns3::ExponentialRandomVariable[Mean=60.0]"));
+  ApplicationContainer enddeviceApps = enddevicehelper.Install (endDeviceNodes);
+  enddevicehelper.AssignStreams (enddeviceApps, 0);
+  LoRaWANGatewayHelper gatewayhelper;
+  gatewayhelper.Install (gatewayNodes);
+
+  for (uint32_t i = 0; i < endDevices.GetN (); i++)
+    DynamicCast<LoRaWANNetDevice> (endDevices.Get (i))->GetPhy ()->TraceConnectWithoutContext ("PhyTxBegin", MakeBoundCallback (&CountUplink, &counts));
+  for (uint32_t i = 0; i < gateways.GetN (); i++)
+    for (auto phy : DynamicCast<LoRaWANNetDevice> (gateways.Get (i))->GetPhys ()) {
+      phy->TraceConnectWithoutContext ("PhyRxEnd", MakeBoundCallback (&CountRxEnd, &counts));
+      phy->TraceConnectWithoutContext ("PhyRxDrop", MakeBoundCallback (&CountRxDrop, &counts));
+    }
+
+  LoRaWANVisualTraceHelper visualTrace;
+  visualTrace.SetBinWidth (Seconds (300));
+  visualTrace.SetPacketSampling (5);
+  NS_TEST_ASSERT_MSG_EQ (visualTrace.Open (filename, format), true, "Unable to open the visual trace");
+  visualTrace.Install (endDeviceNodes, gatewayNodes);
+
+  Simulator::Stop (Seconds (1000));
+  Simulator::Run ();
+  visualTrace.Close ();
+
+  LoRaWANNetworkServer::clearLoRaWANNetworkServerPointer ();
+  Simulator::Destroy ();
+}
+
+void
+LoRaWANVisualTraceTestCase::ReadNdjson (std::string filename, LoRaWANVisualTraceTestCounts& counts)
+{
+  std::ifstream is (filename.c_str ());
+  std::string line;
+  uint32_t nLines = 0;
+  uint32_t nNodes = 0;
+  while (std::getline (is, line)) {
+    NS_TEST_ASSERT_MSG_EQ ((line.size () > 2 && line[0] == '{' && line[line.size () - 1] == '}'), true, "Not a JSON object: " << line);
+    const std::string type = GetField (line, "type");
+    if (nLines++ == 0) {
+      NS_TEST_ASSERT_MSG_EQ (type, "header", "The trace should start with its header");
+      NS_TEST_ASSERT_MSG_EQ (GetField (line, "binWidth"), "300", "Wrong bin width in the header");
+    } else if (type == "node") {
+      nNodes++;
+    } else if (type == "cell") {
+      counts.m_cells++;
+      counts.m_cellRx += std::atoi (GetField (line, "rx").c_str ());
+      counts.m_cellInterfered += std::atoi (GetField (line, "interfered").c_str ());
+      NS_TEST_ASSERT_MSG_EQ ((std::atof (GetField (line, "t").c_str ()) <= 1000.0), true, "Cell after the end of the simulation");
+    } else if (type == "tx") {
+      counts.m_tx++;
+      counts.m_txIds.insert (std::strtoull (GetField (line, "id").c_str (), 0, 10));
+    } else if (type == "rx") {
+      counts.m_rxRecords++;
+      counts.m_rxIds.insert (std::strtoull (GetField (line, "id").c_str (), 0, 10));
+    } else {
+      NS_TEST_ASSERT_MSG_EQ (type, "setting", "Unknown record type");
+    }
+  }
+  NS_TEST_ASSERT_MSG_EQ (nNodes, 41, "Every end device and gateway should have a node record");
+}
+
+void
+LoRaWANVisualTraceTestCase::ReadBinary (std::string filename, LoRaWANVisualTraceTestCounts& counts)
+{
+  std::ifstream is (filename.c_str (), std::ios::binary);
+  char magic[4];
+  is.read (magic, sizeof (magic));
+  NS_TEST_ASSERT_MSG_EQ (std::string (magic, sizeof (magic)), "LWVT", "Wrong magic");
+  uint8_t version;
+  int64_t binWidth;
+  ReadValue (is, version);
+  ReadValue (is, binWidth);
+  NS_TEST_ASSERT_MSG_EQ ((uint32_t)version, LORAWAN_VISUAL_TRACE_VERSION, "Wrong version");
+  NS_TEST_ASSERT_MSG_EQ (binWidth, Seconds (300).GetNanoSeconds (), "Wrong bin width");
+
+  char type;
+  double t, d;
+  uint32_t u32;
+  uint64_t id;
+  uint8_t u8;
+  while (ReadValue (is, type)) {
+    switch (type) {
+      case 'N':
+        ReadValue (is, u32); ReadValue (is, u8); ReadValue (is, d); ReadValue (is, d); ReadValue (is, d);
+        break;
+      case 'C':
+        counts.m_cells++;
+        ReadValue (is, t); ReadValue (is, u32); ReadValue (is, u8);
+        ReadValue (is, u32);
+        counts.m_cellRx += u32;
+        ReadValue (is, u32);
+        counts.m_cellInterfered += u32;
+        ReadValue (is, u32); ReadValue (is, u32); ReadValue (is, u32); ReadValue (is, d); ReadValue (is, d);
+        break;
+      case 'S':
+        ReadValue (is, t); ReadValue (is, u32); ReadValue (is, u8); ReadValue (is, d);
+        break;
+      case 'T':
+        counts.m_tx++;
+        ReadValue (is, t); ReadValue (is, u32); ReadValue (is, id); ReadValue (is, u8); ReadValue (is, u8); ReadValue (is, u32);
+        counts.m_txIds.insert (id);
+        break;
+      case 'R':
+        counts.m_rxRecords++;
+        ReadValue (is, t); ReadValue (is, u32); ReadValue (is, id); ReadValue (is, u8);
+        NS_TEST_ASSERT_MSG_LT ((uint32_t)u8, 5, "Unknown reception outcome");
+        counts.m_rxIds.insert (id);
+        break;
+      default:
+        NS_TEST_ASSERT_MSG_EQ (type, 'N', "Unknown record type");
+        return;
+    }
+    NS_TEST_ASSERT_MSG_EQ (is.good (), true, "Truncated record of type " << type);
+  }
+}
+
+void
+LoRaWANVisualTraceTestCase::DoRun (void)
+{
+  std::string ndjsonFilename = CreateTempDirFilename ("lorawan-visual-trace-test.ndjson");
+  std::string binaryFilename = CreateTempDirFilename ("lorawan-visual-trace-test.bin");
+
+  LoRaWANVisualTraceTestCounts ndjson;
+  Run (ndjsonFilename, LoRaWANVisualTraceHelper::NDJSON, ndjson);
+  ReadNdjson (ndjsonFilename, ndjson);
+
+  LoRaWANVisualTraceTestCounts binary;
+  Run (binaryFilename, LoRaWANVisualTraceHelper::BINARY, binary);
+  ReadBinary (binaryFilename, binary);
+
+  LoRaWANVisualTraceTestCounts* runs[] = {&ndjson, &binary};
+  for (auto counts : runs) {
+    NS_TEST_ASSERT_MSG_GT (counts->m_rx, 0, "No uplink was received");
+    NS_TEST_ASSERT_MSG_GT (counts->m_interfered, 0, "No uplinks collided, the test does not cover interference");
+    NS_TEST_ASSERT_MSG_EQ (counts->m_cellRx, counts->m_rx, "The cells do not add up to the receptions at the gateway");
+    NS_TEST_ASSERT_MSG_EQ (counts->m_cellInterfered, counts->m_interfered, "The cells do not add up to the collisions at the gateway");
+    NS_TEST_ASSERT_MSG_GT (counts->m_cells, 3, "Expected a cell in each bin");
+
+    // one in every five uplinks is sampled, starting at the first
+    NS_TEST_ASSERT_MSG_EQ (counts->m_tx, (counts->m_uplinks + 4) / 5, "Wrong number of sampled uplinks");
+    NS_TEST_ASSERT_MSG_GT (counts->m_rxRecords, 0, "No reception of a sampled uplink was written");
+    for (auto id : counts->m_rxIds)
+      NS_TEST_ASSERT_MSG_EQ (counts->m_txIds.count (id), 1, "Reception of a packet that was not sampled: " << id);
+  }
+
+  // both formats hold the same trace
+  NS_TEST_ASSERT_MSG_EQ (binary.m_cells, ndjson.m_cells, "Formats differ in the number of cells");
+  NS_TEST_ASSERT_MSG_EQ (binary.m_rxRecords, ndjson.m_rxRecords, "Formats differ in the number of reception records");
+
+  std::remove (ndjsonFilename.c_str ());
+  std::remove (binaryFilename.c_str ());
+}
+
+// ==============================================================================
+class LoRaWANVisualTraceTestSuite : public TestSuite
+{
+public:
+  LoRaWANVisualTraceTestSuite ();
+};
+
+LoRaWANVisualTraceTestSuite::LoRaWANVisualTraceTestSuite ()
+  : TestSuite ("lorawan-visual-trace", UNIT)
+{
+  AddTestCase (new LoRaWANVisualTraceTestCase, TestCase::QUICK);
+}
+
+static LoRaWANVisualTraceTestSuite lorawanVisualTraceTestSuite;
@@ -22,11 +22,253 @@
 #include <ns3/spectrum-value.h>
 #include <ns3/math.h>
 #include <ns3/log.h>
+#include <algorithm>
+#include <cstring>
+#include <stdlib.h> // for posix_memalign ()
+
+#if defined (__AVX__) || defined (__SSE2__)
+#include <immintrin.h>
+#endif
 
 namespace ns3 {
 
 NS_LOG_COMPONENT_DEFINE ("SpectrumValue");
 
+Values::Values ()
+  : m_data (m_inline),
+    m_size (0)
+{
+}
+
+Values::Values (size_type n)
+  : m_data (m_inline),
+    m_size (0)
+{
+  Resize (n);
+  std::fill (m_data, m_data + n, 0.0);
+}
+
+Values::Values (const Values& o)
+  : m_data (m_inline),
+    m_size (0)
+{
+  Resize (o.m_size);
+  std::memcpy (m_data, o.m_data, m_size * sizeof (double));
+}
+
+Values::Values (Values&& o)
+  : m_data (m_inline),
+    m_size (0)
+{
+  *this = std::move (o);
+}
+
+Values::~Values ()
+{
+  Release ();
+}
+
+Values&
+Values::operator= (const Values& o)
+{
+  if (this != &o)
+    {
+      Resize (o.m_size);
+      std::memcpy (m_data, o.m_data, m_size * sizeof (double));
+    }
+  return *this;
+}
+
+Values&
+Values::operator= (Values&& o)
+{
+  if (this == &o)
+    {
+      return *this;
+    }
+  if (o.IsOnHeap ())
+    {
+      // take over the heap buffer
+      Release ();
+      m_data = o.m_data;
+      m_size = o.m_size;
+      o.m_data = o.m_inline;
+      o.m_size = 0;
+    }
+  else
+    {
+      Resize (o.m_size);
+      std::memcpy (m_data, o.m_data, m_size * sizeof (double));
+    }
+  return *this;
+}
+
+void
+Values::Resize (size_type n)
+{
+  if (n == m_size)
+    {
+      return;
+    }
+  Release ();
+  if (n > INLINE_CAPACITY)
+    {
+      void* buffer = 0;
+      if (posix_memalign (&buffer, ALIGNMENT, n * sizeof (double)) != 0)
+        {
+          NS_FATAL_ERROR ("Could not allocate " << n << " spectrum values");
+        }
+      m_data = static_cast<double*> (buffer);
+    }
+  m_size = n;
+}
+
+void
+Values::Release ()
+{
+  if (IsOnHeap ())
+    {
+      free (m_data);
+      m_data = m_inline;
+    }
+  m_size = 0;
+}
+
+namespace {
+
+/*
+ * Element-wise kernels of the arithmetic operators. With AVX or SSE2, four
+ * or two values are processed per instruction, the remaining values one by
+ * one. Unaligned loads are used: the inline values of a SpectrumValue
+ * allocated with new are only guaranteed to be 16 byte aligned.
+ */
+
+struct AddOp
+{
+  static double Apply (double a, double b)
+  {
+    return a + b;
+  }
+#if defined (__AVX__)
+  static __m256d Apply (__m256d a, __m256d b)
+  {
+    return _mm256_add_pd (a, b);
+  }
+#elif defined (__SSE2__)
+  static __m128d Apply (__m128d a, __m128d b)
+  {
+    return _mm_add_pd (a, b);
+  }
+#endif
+};
+
+struct SubtractOp
+{
+  static double Apply (double a, double b)
+  {
+    return a - b;
+  }
+#if defined (__AVX__)
+  static __m256d Apply (__m256d a, __m256d b)
+  {
+    return _mm256_sub_pd (a, b);
+  }
+#elif defined (__SSE2__)
+  static __m128d Apply (__m128d a, __m128d b)
+  {
+    return _mm_sub_pd (a, b);
+  }
+#endif
+};
+
+struct MultiplyOp
+{
+  static double Apply (double a, double b)
+  {
+    return a * b;
+  }
+#if defined (__AVX__)
+  static __m256d Apply (__m256d a, __m256d b)
+  {
+    return _mm256_mul_pd (a, b);
+  }
+#elif defined (__SSE2__)
+  static __m128d Apply (__m128d a, __m128d b)
+  {
+    return _mm_mul_pd (a, b);
+  }
+#endif
+};
+
+struct DivideOp
+{
+  static double Apply (double a, double b)
+  {
+    return a / b;
+  }
+#if defined (__AVX__)
+  static __m256d Apply (__m256d a, __m256d b)
+  {
+    return _mm256_div_pd (a, b);
+  }
+#elif defined (__SSE2__)
+  static __m128d Apply (__m128d a, __m128d b)
+  {
+    return _mm_div_pd (a, b);
+  }
+#endif
+};
+
+/// x[i] = x[i] op y[i]; x and y may be the same array
+template <class Op>
+void
+ApplyElementWise (double* x, const double* y, std::size_t n)
+{
+  std::size_t i = 0;
+#if defined (__AVX__)
+  for (; i + 4 <= n; i += 4)
+    {
+      _mm256_storeu_pd (x + i, Op::Apply (_mm256_loadu_pd (x + i), _mm256_loadu_pd (y + i)));
+    }
+#elif defined (__SSE2__)
+  for (; i + 2 <= n; i += 2)
+    {
+      _mm_storeu_pd (x + i, Op::Apply (_mm_loadu_pd (x + i), _mm_loadu_pd (y + i)));
+    }
+#endif
+  for (; i < n; i++)
+    {
+      x[i] = Op::Apply (x[i], y[i]);
+    }
+}
+
+/// x[i] = x[i] op s
+template <class Op>
+void
+ApplyScalar (double* x, double s, std::size_t n)
+{
+  std::size_t i = 0;
+#if defined (__AVX__)
+  const __m256d vs = _mm256_set1_pd (s);
+  for (; i + 4 <= n; i += 4)
+    {
+      _mm256_storeu_pd (x + i, Op::Apply (_mm256_loadu_pd (x + i), vs));
+    }
+#elif defined (__SSE2__)
+  const __m128d vs = _mm_set1_pd (s);
+  for (; i + 2 <= n; i += 2)
+    {
+      _mm_storeu_pd (x + i, Op::Apply (_mm_loadu_pd (x + i), vs));
+    }
+#endif
+  for (; i < n; i++)
+    {
+      x[i] = Op::Apply (x[i], s);
+    }
+}
+
+} // unnamed namespace
+
 SpectrumValue::SpectrumValue ()
 {
 }
@@ -106,31 +348,16 @@ SpectrumValue::ConstBandsEnd () const
 void
 SpectrumValue::Add (const SpectrumValue& x)
 {
-  Values::iterator it1 = m_values.begin ();
-  Values::const_iterator it2 = x.m_values.begin ();
-
   NS_ASSERT (m_spectrumModel == x.m_spectrumModel);
-
-  while (it1 != m_values.end ())
-    {
-      NS_ASSERT ( it2 != x.m_values.end ());
-      *it1 += *it2;
-      ++it1;
-      ++it2;
-    }
+  NS_ASSERT (m_values.size () == x.m_values.size ());
+  ApplyElementWise<AddOp> (m_values.data (), x.m_values.data (), m_values.size ());
 }
 
 
 void
 SpectrumValue::Add (double s)
 {
-  Values::iterator it1 = m_values.begin ();
-
-  while (it1 != m_values.end ())
-    {
-      *it1 += s;
-      ++it1;
-    }
+  ApplyScalar<AddOp> (m_values.data (), s, m_values.size ());
 }
 
 
@@ -138,18 +365,9 @@ SpectrumValue::Add (double s)
 void
 SpectrumValue::Subtract (const SpectrumValue& x)
 {
-  Values::iterator it1 = m_values.begin ();
-  Values::const_iterator it2 = x.m_values.begin ();
-
   NS_ASSERT (m_spectrumModel == x.m_spectrumModel);
-
-  while (it1 != m_values.end ())
-    {
-      NS_ASSERT ( it2 != x.m_values.end ());
-      *it1 -= *it2;
-      ++it1;
-      ++it2;
-    }
+  NS_ASSERT (m_values.size () == x.m_values.size ());
+  ApplyElementWise<SubtractOp> (m_values.data (), x.m_values.data (), m_values.size ());
 }
 
 
@@ -164,31 +382,16 @@ SpectrumValue::Subtract (double s)
 void
 SpectrumValue::Multiply (const SpectrumValue& x)
 {
-  Values::iterator it1 = m_values.begin ();
-  Values::const_iterator it2 = x.m_values.begin ();
-
   NS_ASSERT (m_spectrumModel == x.m_spectrumModel);
-
-  while (it1 != m_values.end ())
-    {
-      NS_ASSERT ( it2 != x.m_values.end ());
-      *it1 *= *it2;
-      ++it1;
-      ++it2;
-    }
+  NS_ASSERT (m_values.size () == x.m_values.size ());
+  ApplyElementWise<MultiplyOp> (m_values.data (), x.m_values.data (), m_values.size ());
 }
 
 
 void
 SpectrumValue::Multiply (double s)
 {
-  Values::iterator it1 = m_values.begin ();
-
-  while (it1 != m_values.end ())
-    {
-      *it1 *= s;
-      ++it1;
-    }
+  ApplyScalar<MultiplyOp> (m_values.data (), s, m_values.size ());
 }
 
 
@@ -197,18 +400,9 @@ SpectrumValue::Multiply (double s)
 void
 SpectrumValue::Divide (const SpectrumValue& x)
 {
-  Values::iterator it1 = m_values.begin ();
-  Values::const_iterator it2 = x.m_values.begin ();
-
   NS_ASSERT (m_spectrumModel == x.m_spectrumModel);
-
-  while (it1 != m_values.end ())
-    {
-      NS_ASSERT ( it2 != x.m_values.end ());
-      *it1 /= *it2;
-      ++it1;
-      ++it2;
-    }
+  NS_ASSERT (m_values.size () == x.m_values.size ());
+  ApplyElementWise<DivideOp> (m_values.data (), x.m_values.data (), m_values.size ());
 }
 
 
@@ -216,13 +410,7 @@ void
 SpectrumValue::Divide (double s)
 {
   NS_LOG_FUNCTION (this << s);
-  Values::iterator it1 = m_values.begin ();
-
-  while (it1 != m_values.end ())
-    {
-      *it1 /= s;
-      ++it1;
-    }
+  ApplyScalar<DivideOp> (m_values.data (), s, m_values.size ());
 }
 
 
@@ -231,13 +419,7 @@ SpectrumValue::Divide (double s)
 void
 SpectrumValue::ChangeSign ()
 {
-  Values::iterator it1 = m_values.begin ();
-
-  while (it1 != m_values.end ())
-    {
-      *it1 = -(*it1);
-      ++it1;
-    }
+  ApplyScalar<MultiplyOp> (m_values.data (), -1.0, m_values.size ());
 }
 
 
@@ -408,11 +590,7 @@ Integral (const SpectrumValue& arg)
 Ptr<SpectrumValue>
 SpectrumValue::Copy () const
 {
-  Ptr<SpectrumValue> p = Create<SpectrumValue> (m_spectrumModel);
-  *p = *this;
-  return p;
-
-  //  return Copy<SpectrumValue> (*this)
+  return Create<SpectrumValue> (*this);
 }
 
 
@@ -664,13 +842,7 @@ SpectrumValue::operator/= (double rhs)
 SpectrumValue&
 SpectrumValue::operator= (double rhs)
 {
-  Values::iterator it1 = m_values.begin ();
-
-  while (it1 != m_values.end ())
-    {
-      *it1 = rhs;
-      ++it1;
-    }
+  std::fill (m_values.begin (), m_values.end (), rhs);
   return *this;
 }
 
@@ -24,14 +24,123 @@
 #include <ns3/ptr.h>
 #include <ns3/simple-ref-count.h>
 #include <ns3/spectrum-model.h>
+#include <ns3/abort.h>
 #include <ostream>
 #include <vector>
 
 namespace ns3 {
 
 
-/// Container for element values
-typedef std::vector<double> Values;
+/**
+ * \ingroup spectrum
+ *
+ * \brief Container for element values
+ *
+ * A fixed size array of doubles. The values of spectrum models with up to
+ * INLINE_CAPACITY bands are stored inside the container, so that copying a
+ * SpectrumValue of such a model does not allocate memory; the values of
+ * larger models are stored in a heap buffer aligned on ALIGNMENT bytes.
+ * Iterators are plain pointers, so the values can be processed with
+ * vector instructions.
+ */
+class Values
+{
+public:
+  typedef double value_type;
+  typedef double* iterator;
+  typedef const double* const_iterator;
+  typedef std::size_t size_type;
+
+  /// Number of values stored without a heap allocation
+  static const size_type INLINE_CAPACITY = 16;
+  /// Alignment of the heap buffer, in bytes
+  static const size_type ALIGNMENT = 32;
+
+  Values ();
+  /**
+   * \param n the number of values, all initialized to zero
+   */
+  explicit Values (size_type n);
+  Values (const Values& o);
+  Values (Values&& o);
+  ~Values ();
+  Values& operator= (const Values& o);
+  Values& operator= (Values&& o);
+
+  size_type size () const
+  {
+    return m_size;
+  }
+  bool empty () const
+  {
+    return m_size == 0;
+  }
+  /**
+   * \return true when the values are stored in a heap buffer
+   */
+  bool IsOnHeap () const
+  {
+    return m_data != m_inline;
+  }
+
+  double* data ()
+  {
+    return m_data;
+  }
+  const double* data () const
+  {
+    return m_data;
+  }
+  iterator begin ()
+  {
+    return m_data;
+  }
+  iterator end ()
+  {
+    return m_data + m_size;
+  }
+  const_iterator begin () const
+  {
+    return m_data;
+  }
+  const_iterator end () const
+  {
+    return m_data + m_size;
+  }
+
+  double& operator[] (size_type i)
+  {
+    return m_data[i];
+  }
+  const double& operator[] (size_type i) const
+  {
+    return m_data[i];
+  }
+  /**
+   * Access a value, aborting when the index is out of range
+   */
+  double& at (size_type i)
+  {
+    NS_ABORT_MSG_IF (i >= m_size, "Values index " << i << " out of range");
+    return m_data[i];
+  }
+  const double& at (size_type i) const
+  {
+    NS_ABORT_MSG_IF (i >= m_size, "Values index " << i << " out of range");
+    return m_data[i];
+  }
+
+private:
+  /**
+   * Make room for n values, whose content is undefined afterwards
+   */
+  void Resize (size_type n);
+  void Release ();
+
+  double* m_data;    //!< m_inline or the heap buffer
+  size_type m_size;
+  alignas (16) double m_inline[INLINE_CAPACITY];
+};
 
 /**
  * \ingroup spectrum
@@ -82,6 +82,78 @@ SpectrumValueTestCase::DoRun (void)
 
 
 
+/**
+ * The arithmetic operators give the same results with inline and heap
+ * values, for any number of values, and copies do not share values
+ */
+class SpectrumValueStorageTestCase : public TestCase
+{
+public:
+  SpectrumValueStorageTestCase ();
+  virtual ~SpectrumValueStorageTestCase ();
+  virtual void DoRun (void);
+};
+
+SpectrumValueStorageTestCase::SpectrumValueStorageTestCase ()
+  : TestCase ("SpectrumValue inline and heap storage")
+{
+}
+
+SpectrumValueStorageTestCase::~SpectrumValueStorageTestCase ()
+{
+}
+
+void
+SpectrumValueStorageTestCase::DoRun (void)
+{
+  const uint32_t nBands[] = { 2, 3, 8, Values::INLINE_CAPACITY, Values::INLINE_CAPACITY + 1, 37 };
+  for (uint32_t k = 0; k < sizeof (nBands) / sizeof (nBands[0]); k++)
+    {
+      const uint32_t n = nBands[k];
+      std::vector<double> freqs;
+      for (uint32_t i = 0; i < n; i++)
+        {
+          freqs.push_back (i + 1);
+        }
+      Ptr<SpectrumModel> m = Create<SpectrumModel> (freqs);
+
+      SpectrumValue a (m), b (m);
+      std::vector<double> ra (n), rb (n);
+      for (uint32_t i = 0; i < n; i++)
+        {
+          a[i] = ra[i] = 0.5 + i;
+          b[i] = rb[i] = 2.0 - 0.25 * i;
+        }
+
+      Ptr<SpectrumValue> c = a.Copy ();
+      NS_TEST_ASSERT_MSG_EQ (c->ConstValuesEnd () - c->ConstValuesBegin (), (int) n, "Wrong number of values");
+      (*c)[0] = -1;
+      NS_TEST_ASSERT_MSG_EQ (a[0], ra[0], "A copy shares its values");
+
+      SpectrumValue sum = a + b;
+      SpectrumValue diff = a - b;
+      SpectrumValue prod = a * b;
+      SpectrumValue quot = a / b;
+      SpectrumValue scaled = a * 3.0;
+      SpectrumValue shifted = a + 1.5;
+      SpectrumValue negated = -a;
+      SpectrumValue doubled = a;
+      doubled += doubled;
+      for (uint32_t i = 0; i < n; i++)
+        {
+          NS_TEST_ASSERT_MSG_EQ_TOL (sum[i], ra[i] + rb[i], TOLERANCE, "Wrong sum for " << n << " bands");
+          NS_TEST_ASSERT_MSG_EQ_TOL (diff[i], ra[i] - rb[i], TOLERANCE, "Wrong difference for " << n << " bands");
+          NS_TEST_ASSERT_MSG_EQ_TOL (prod[i], ra[i] * rb[i], TOLERANCE, "Wrong product for " << n << " bands");
+          NS_TEST_ASSERT_MSG_EQ_TOL (quot[i], ra[i] / rb[i], TOLERANCE, "Wrong quotient for " << n << " bands");
+          NS_TEST_ASSERT_MSG_EQ_TOL (scaled[i], ra[i] * 3.0, TOLERANCE, "Wrong scaling for " << n << " bands");
+          NS_TEST_ASSERT_MSG_EQ_TOL (shifted[i], ra[i] + 1.5, TOLERANCE, "Wrong offset for " << n << " bands");
+          NS_TEST_ASSERT_MSG_EQ_TOL (negated[i], -ra[i], TOLERANCE, "Wrong negation for " << n << " bands");
+          NS_TEST_ASSERT_MSG_EQ_TOL (doubled[i], 2 * ra[i], TOLERANCE, "Wrong sum with itself for " << n << " bands");
+        }
+    }
+}
+
+
 class SpectrumValueTestSuite : public TestSuite
 {
 public:
@@ -241,6 +313,8 @@ SpectrumValueTestSuite::SpectrumValueTestSuite ()
   tv1rs3 = v1 >> 3;
   AddTestCase (new SpectrumValueTestCase (tv1rs3, v1rs3, "tv1rs3 = v1 >> 3"), TestCase::QUICK);
 
+  AddTestCase (new SpectrumValueStorageTestCase, TestCase::QUICK);
+
 
 }
 
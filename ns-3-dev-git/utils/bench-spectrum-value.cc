@@ -0,0 +1,177 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 National University of Ireland, Maynooth
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Joseph Finnegan <joseph.finnegan@mu.ie>
+ */
+#include "ns3/command-line.h"
+#include "ns3/system-wall-clock-ms.h"
+#include "ns3/spectrum-value.h"
+#include <iostream>
+#include <vector>
+#include <stdlib.h> // for exit ()
+#include <limits>
+#include <algorithm>
+
+using namespace ns3;
+
+static Ptr<SpectrumModel> g_model;
+static Ptr<SpectrumValue> g_psd;    //!< a transmitted signal
+static Ptr<SpectrumValue> g_sum;    //!< the sum of the signals at a receiver
+static std::vector<double> g_vectorPsd;
+static std::vector<double> g_vectorSum;
+static double g_sink = 0;           //!< keeps the compiler from removing the benchmarks
+
+static void
+benchCopy (uint32_t n)
+{
+  for (uint32_t i = 0; i < n; i++)
+    {
+      Ptr<SpectrumValue> rx = g_psd->Copy ();
+      g_sink += (*rx)[0];
+    }
+}
+
+// what the spectrum channels do for every receiver of a transmission
+static void
+benchCopyAndScale (uint32_t n)
+{
+  for (uint32_t i = 0; i < n; i++)
+    {
+      Ptr<SpectrumValue> rx = g_psd->Copy ();
+      *rx *= 1e-9;
+      g_sink += (*rx)[0];
+    }
+}
+
+// what an interference helper does at the start and end of every signal
+static void
+benchAddSubtract (uint32_t n)
+{
+  for (uint32_t i = 0; i < n; i++)
+    {
+      *g_sum += *g_psd;
+      *g_sum -= *g_psd;
+    }
+  g_sink += (*g_sum)[0];
+}
+
+// the copy and scaling of a heap allocated std::vector, as SpectrumValue did before
+static void
+benchVectorCopyAndScale (uint32_t n)
+{
+  for (uint32_t i = 0; i < n; i++)
+    {
+      std::vector<double>* rx = new std::vector<double> (g_vectorPsd);
+      for (std::vector<double>::iterator it = rx->begin (); it != rx->end (); ++it)
+        {
+          *it *= 1e-9;
+        }
+      g_sink += (*rx)[0];
+      delete rx;
+    }
+}
+
+static void
+benchVectorAddSubtract (uint32_t n)
+{
+  for (uint32_t i = 0; i < n; i++)
+    {
+      for (size_t j = 0; j < g_vectorSum.size (); j++)
+        {
+          g_vectorSum[j] += g_vectorPsd[j];
+        }
+      for (size_t j = 0; j < g_vectorSum.size (); j++)
+        {
+          g_vectorSum[j] -= g_vectorPsd[j];
+        }
+    }
+  g_sink += g_vectorSum[0];
+}
+
+static uint64_t
+runBenchOneIteration (void (*bench) (uint32_t), uint32_t n)
+{
+  SystemWallClockMs time;
+  time.Start ();
+  (*bench) (n);
+  uint64_t deltaMs = time.End ();
+  return deltaMs;
+}
+
+static void
+runBench (void (*bench) (uint32_t), uint32_t n, uint32_t minIterations, char const *name)
+{
+  uint64_t minDelay = std::numeric_limits<uint64_t>::max();
+  for (uint32_t i = 0; i < minIterations; i++)
+    {
+      uint64_t delay = runBenchOneIteration(bench, n);
+      minDelay = std::min(minDelay, delay);
+    }
+  double ops = n;
+  ops *= 1000;
+  ops /= std::max<uint64_t> (minDelay, 1);
+  std::cout << ops << " ops/s"
+            << " (" << minDelay << " ms elapsed)\t"
+            << name
+            << std::endl;
+}
+
+int main (int argc, char *argv[])
+{
+  uint32_t n = 1000000;
+  uint32_t bands = 8;
+  uint32_t minIterations = 1;
+
+  CommandLine cmd;
+  cmd.Usage ("Benchmark SpectrumValue class");
+  cmd.AddValue ("n", "number of iterations", n);
+  cmd.AddValue ("bands", "number of bands of the spectrum model (8 for LoRaWAN)", bands);
+  cmd.AddValue ("min-iterations", "number of subiterations to minimize iteration time over", minIterations);
+  cmd.Parse (argc, argv);
+
+  if (bands < 2)
+    {
+      std::cerr << "Error-- the spectrum model needs at least two bands" << std::endl;
+      exit (1);
+    }
+
+  std::vector<double> centerFreqs;
+  for (uint32_t i = 0; i < bands; i++)
+    {
+      centerFreqs.push_back (868.1e6 + i * 200e3);
+    }
+  g_model = Create<SpectrumModel> (centerFreqs);
+  g_psd = Create<SpectrumValue> (g_model);
+  g_sum = Create<SpectrumValue> (g_model);
+  *g_psd = 1e-3;
+  *g_sum = 1e-12;
+  g_vectorPsd.assign (bands, 1e-3);
+  g_vectorSum.assign (bands, 1e-12);
+
+  std::cout << "Running bench-spectrum-value with n=" << n << " bands=" << bands
+            << (bands <= Values::INLINE_CAPACITY ? " (inline values)" : " (heap values)") << std::endl;
+
+  runBench (&benchCopy, n, minIterations, "Copy");
+  runBench (&benchCopyAndScale, n, minIterations, "Copy and scale");
+  runBench (&benchVectorCopyAndScale, n, minIterations, "Copy and scale std::vector (reference)");
+  runBench (&benchAddSubtract, n, minIterations, "Add and subtract");
+  runBench (&benchVectorAddSubtract, n, minIterations, "Add and subtract std::vector (reference)");
+
+  std::cout << "(" << g_sink << ")" << std::endl;
+
+  return 0;
+}